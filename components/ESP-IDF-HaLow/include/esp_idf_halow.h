@@ -0,0 +1,138 @@
+/**
+ * @file esp_idf_halow.h
+ * @brief Standard Wi-Fi fallback implementation of IHaLow interface
+ *
+ * EspIdfHaLow carries AirCom traffic over an ordinary 2.4 GHz Wi-Fi
+ * network using the ESP-IDF station driver. It is the failover backend
+ * when the HaLow module cannot be brought up or stops responding: range is
+ * shorter, but voice and messages keep flowing.
+ *
+ * Peers find each other with UDP multicast beacons on the shared network,
+ * as with the simulator. Broadcasts go to the multicast group; unicasts go
+ * straight to the address a peer's beacon came from. Peers are dropped after
+ * three missed beacons.
+ *
+ * Connection events are network level: "connected" once the station has an
+ * IP address, "disconnected" when it loses the access point. The peer ID in
+ * those events is the access point BSSID.
+ *
+ * @author AirCom Development Team
+ * @version 2.0.0
+ * @date 2024
+ */
+
+#ifndef ESP_IDF_HALOW_H
+#define ESP_IDF_HALOW_H
+
+#include "halow_interface.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_event.h"
+#include <map>
+
+/**
+ * @brief Standard Wi-Fi implementation of IHaLow interface
+ */
+class EspIdfHaLow : public IHaLow {
+public:
+    EspIdfHaLow();
+    ~EspIdfHaLow() override;
+
+    // IHaLow interface implementation
+    bool initialize(const HaLowConfig& config) override;
+    void deinitialize() override;
+    bool startDiscovery() override;
+    void stopDiscovery() override;
+    bool connectToPeer(const std::string& peer_id) override;
+    bool disconnectFromPeer(const std::string& peer_id) override;
+    bool sendData(const std::string& peer_id, const std::vector<uint8_t>& data) override;
+    bool broadcastData(const std::vector<uint8_t>& data) override;
+    std::vector<HaLowPeerInfo> getDiscoveredPeers() override;
+    std::vector<HaLowPeerInfo> getConnectedPeers() override;
+    HaLowNetworkInfo getNetworkInfo() override;
+    void setConnectionCallback(ConnectionCallback callback) override;
+    void setDataCallback(DataCallback callback) override;
+    void setDiscoveryCallback(DiscoveryCallback callback) override;
+    void setEventCallback(EventCallback callback) override;
+    std::string getImplementationName() const override;
+    std::vector<std::string> getSupportedHardware() const override;
+    bool isInitialized() const override;
+    bool isConnected() const override;
+    std::string getVersion() const override;
+
+    /**
+     * @brief Debug commands
+     *
+     * - "rssi"          {}  access point RSSI
+     * - "set_link_rate" {}  accepted and ignored (the AP picks the rate)
+     */
+    std::string sendRawCommand(const std::string& command, const std::vector<std::string>& params) override;
+
+    // Multicast group for peer discovery and broadcasts
+    static constexpr const char* MULTICAST_GROUP = "239.255.42.100";
+    static constexpr uint16_t MULTICAST_PORT = 42100;
+
+private:
+    enum FrameType : uint8_t {
+        FRAME_BEACON = 1,
+        FRAME_UNICAST = 2,
+        FRAME_BROADCAST = 3
+    };
+
+    struct PeerState {
+        uint32_t address;           ///< IPv4 address in network byte order
+        int64_t lastSeenUs;
+        uint32_t connectTime;
+    };
+
+    // Wi-Fi and IP event handling
+    static void wifiEventHandler(void* arg, esp_event_base_t base, int32_t id, void* data);
+    void handleWifiEvent(esp_event_base_t base, int32_t id, void* data);
+
+    // Socket handling
+    bool openSocket();
+    void closeSocket();
+    bool sendFrame(FrameType type, const std::string& dest, uint32_t address,
+                   const uint8_t* payload, size_t length);
+
+    // Receive task: frames, beacons and peer expiry
+    static void receiveTask(void* arg);
+    void receiveLoop();
+    void handleFrame(const uint8_t* frame, size_t length, uint32_t address);
+    void expirePeers(int64_t now);
+
+    void notifyConnection(bool connected);
+    int32_t apRssi() const;
+    HaLowPeerInfo makePeerInfo(const std::string& peer_id, const PeerState& state) const;
+
+    std::string m_nodeId;
+    std::string m_bssid;
+    HaLowConfig m_config;
+    int m_socket;
+
+    volatile bool m_initialized;
+    volatile bool m_running;
+    volatile bool m_connected;
+    volatile bool m_discovering;
+    bool m_wifiStarted;
+
+    TaskHandle_t m_receiveTask;
+    SemaphoreHandle_t m_taskDone;
+    esp_event_handler_instance_t m_wifiHandler;
+    esp_event_handler_instance_t m_ipHandler;
+
+    // Peers, guarded by m_mutex
+    SemaphoreHandle_t m_mutex;
+    std::map<std::string, PeerState> m_peers;
+    bool m_peersChanged;
+    int64_t m_nextBeaconUs;
+
+    // Callbacks
+    ConnectionCallback m_connectionCallback;
+    DataCallback m_dataCallback;
+    DiscoveryCallback m_discoveryCallback;
+    EventCallback m_eventCallback;
+};
+
+#endif // ESP_IDF_HALOW_H
@@ -0,0 +1,614 @@
+/**
+ * @file esp_idf_halow.cpp
+ * @brief Standard Wi-Fi fallback implementation of IHaLow interface
+ *
+ * @author AirCom Development Team
+ * @version 2.0.0
+ * @date 2024
+ */
+
+#include "esp_idf_halow.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+static const char* TAG = "ESP_IDF_HALOW";
+
+// Wire format: [magic 2][version][type][src_len][src][dst_len][dst][payload]
+static const uint8_t FRAME_MAGIC_0 = 'E';
+static const uint8_t FRAME_MAGIC_1 = 'W';
+static const uint8_t FRAME_VERSION = 1;
+static const size_t FRAME_FIXED_HEADER = 4;
+static const size_t MAX_FRAME_SIZE = 1472;     // One Ethernet-sized UDP datagram
+
+// Peers are dropped after this many missed beacons
+static const uint32_t BEACON_MISS_LIMIT = 3;
+static const uint32_t DEFAULT_BEACON_INTERVAL_MS = 1000;
+
+// Receive timeout so the receive task notices shutdown and sends beacons
+static const int RECEIVE_TIMEOUT_MS = 100;
+
+#define RECEIVE_TASK_STACK_SIZE 4096
+#define RECEIVE_TASK_PRIORITY 4
+#define PEER_MUTEX_TIMEOUT pdMS_TO_TICKS(100)
+
+// The station netif can only be created once per boot
+static esp_netif_t* s_staNetif = nullptr;
+
+EspIdfHaLow::EspIdfHaLow()
+    : m_config()
+    , m_socket(-1)
+    , m_initialized(false)
+    , m_running(false)
+    , m_connected(false)
+    , m_discovering(false)
+    , m_wifiStarted(false)
+    , m_receiveTask(nullptr)
+    , m_wifiHandler(nullptr)
+    , m_ipHandler(nullptr)
+    , m_peersChanged(false)
+    , m_nextBeaconUs(0) {
+    m_mutex = xSemaphoreCreateMutex();
+    m_taskDone = xSemaphoreCreateBinary();
+}
+
+EspIdfHaLow::~EspIdfHaLow() {
+    deinitialize();
+    if (m_mutex) {
+        vSemaphoreDelete(m_mutex);
+        m_mutex = NULL;
+    }
+    if (m_taskDone) {
+        vSemaphoreDelete(m_taskDone);
+        m_taskDone = NULL;
+    }
+}
+
+bool EspIdfHaLow::initialize(const HaLowConfig& config) {
+    if (m_initialized) {
+        ESP_LOGW(TAG, "Standard Wi-Fi backend already initialized");
+        return true;
+    }
+
+    if (config.ssid.empty() || config.ssid.size() >= 32 || config.password.size() >= 64) {
+        ESP_LOGE(TAG, "Invalid SSID or password");
+        return false;
+    }
+
+    m_config = config;
+    if (m_config.heartbeat_interval == 0) {
+        m_config.heartbeat_interval = DEFAULT_BEACON_INTERVAL_MS;
+    }
+
+    esp_err_t err = esp_netif_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_netif_init failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Event loop creation failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    if (!s_staNetif) {
+        s_staNetif = esp_netif_create_default_wifi_sta();
+    }
+
+    wifi_init_config_t init_config = WIFI_INIT_CONFIG_DEFAULT();
+    err = esp_wifi_init(&init_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_init failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &EspIdfHaLow::wifiEventHandler,
+                                        this, &m_wifiHandler);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &EspIdfHaLow::wifiEventHandler,
+                                        this, &m_ipHandler);
+
+    wifi_config_t wifi_config = {};
+    memcpy(wifi_config.sta.ssid, m_config.ssid.c_str(), m_config.ssid.size());
+    memcpy(wifi_config.sta.password, m_config.password.c_str(), m_config.password.size());
+    wifi_config.sta.threshold.authmode = m_config.password.empty() ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+    wifi_config.sta.listen_interval = 10;   // Beacons between wakes under WIFI_PS_MAX_MODEM, ~1 s
+
+    uint8_t mac[6];
+    char node_id[16];
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    snprintf(node_id, sizeof(node_id), "%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    m_nodeId = node_id;
+
+    m_running = true;
+    if (esp_wifi_set_mode(WIFI_MODE_STA) != ESP_OK ||
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config) != ESP_OK ||
+        esp_wifi_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start Wi-Fi station");
+        m_running = false;
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, m_wifiHandler);
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, m_ipHandler);
+        esp_wifi_deinit();
+        return false;
+    }
+    m_wifiStarted = true;
+
+    if (!openSocket()) {
+        deinitialize();
+        return false;
+    }
+
+    m_nextBeaconUs = esp_timer_get_time();
+    if (xTaskCreate(&EspIdfHaLow::receiveTask, "WifiFallbackRx", RECEIVE_TASK_STACK_SIZE,
+                    this, RECEIVE_TASK_PRIORITY, &m_receiveTask) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create receive task");
+        m_receiveTask = nullptr;
+        deinitialize();
+        return false;
+    }
+
+    m_initialized = true;
+    ESP_LOGI(TAG, "Standard Wi-Fi backend started as node %s (SSID %s)",
+             m_nodeId.c_str(), m_config.ssid.c_str());
+    return true;
+}
+
+void EspIdfHaLow::deinitialize() {
+    if (!m_running && !m_wifiStarted) {
+        return;
+    }
+
+    m_running = false;
+    if (m_receiveTask) {
+        xSemaphoreTake(m_taskDone, portMAX_DELAY);
+        m_receiveTask = nullptr;
+    }
+    closeSocket();
+
+    if (m_wifiHandler) {
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, m_wifiHandler);
+        m_wifiHandler = nullptr;
+    }
+    if (m_ipHandler) {
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, m_ipHandler);
+        m_ipHandler = nullptr;
+    }
+    if (m_wifiStarted) {
+        esp_wifi_disconnect();
+        esp_wifi_stop();
+        esp_wifi_deinit();
+        m_wifiStarted = false;
+    }
+
+    if (xSemaphoreTake(m_mutex, portMAX_DELAY) == pdTRUE) {
+        m_peers.clear();
+        xSemaphoreGive(m_mutex);
+    }
+    m_initialized = false;
+    m_connected = false;
+    m_discovering = false;
+
+    ESP_LOGI(TAG, "Standard Wi-Fi backend stopped");
+}
+
+bool EspIdfHaLow::startDiscovery() {
+    if (!m_initialized) {
+        ESP_LOGE(TAG, "Cannot start discovery: not initialized");
+        return false;
+    }
+    m_discovering = true;
+    // Announce ourselves on the next receive timeout
+    m_nextBeaconUs = esp_timer_get_time();
+    return true;
+}
+
+void EspIdfHaLow::stopDiscovery() {
+    m_discovering = false;
+}
+
+bool EspIdfHaLow::connectToPeer(const std::string& peer_id) {
+    // Every peer on the network is reachable once it has been heard
+    bool known = false;
+    if (xSemaphoreTake(m_mutex, PEER_MUTEX_TIMEOUT) == pdTRUE) {
+        known = m_peers.find(peer_id) != m_peers.end();
+        xSemaphoreGive(m_mutex);
+    }
+    return m_initialized && known;
+}
+
+bool EspIdfHaLow::disconnectFromPeer(const std::string& peer_id) {
+    return m_initialized;
+}
+
+bool EspIdfHaLow::sendData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (!m_initialized || !m_connected) {
+        return false;
+    }
+
+    uint32_t address = 0;
+    if (xSemaphoreTake(m_mutex, PEER_MUTEX_TIMEOUT) == pdTRUE) {
+        auto it = m_peers.find(peer_id);
+        if (it != m_peers.end()) {
+            address = it->second.address;
+        }
+        xSemaphoreGive(m_mutex);
+    }
+    if (address == 0) {
+        ESP_LOGW(TAG, "Peer %s not discovered", peer_id.c_str());
+        return false;
+    }
+    return sendFrame(FRAME_UNICAST, peer_id, address, data.data(), data.size());
+}
+
+bool EspIdfHaLow::broadcastData(const std::vector<uint8_t>& data) {
+    if (!m_initialized || !m_connected) {
+        return false;
+    }
+    return sendFrame(FRAME_BROADCAST, std::string(), 0, data.data(), data.size());
+}
+
+std::vector<HaLowPeerInfo> EspIdfHaLow::getDiscoveredPeers() {
+    std::vector<HaLowPeerInfo> peers;
+    if (xSemaphoreTake(m_mutex, PEER_MUTEX_TIMEOUT) == pdTRUE) {
+        for (const auto& entry : m_peers) {
+            peers.push_back(makePeerInfo(entry.first, entry.second));
+        }
+        xSemaphoreGive(m_mutex);
+    }
+    return peers;
+}
+
+std::vector<HaLowPeerInfo> EspIdfHaLow::getConnectedPeers() {
+    return m_connected ? getDiscoveredPeers() : std::vector<HaLowPeerInfo>();
+}
+
+HaLowNetworkInfo EspIdfHaLow::getNetworkInfo() {
+    HaLowNetworkInfo info;
+    info.network_id = m_config.ssid;
+    info.device_id = m_nodeId;
+    info.channel = 0;
+    info.bandwidth = 20;
+    info.rssi = apRssi();
+    info.connected_peers = (uint32_t)getConnectedPeers().size();
+    info.mesh_enabled = false;
+    info.sdk_version = esp_get_idf_version();
+    info.hardware_type = "ESP32 Wi-Fi";
+
+    wifi_ap_record_t ap;
+    if (m_connected && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        info.channel = ap.primary;
+    }
+    return info;
+}
+
+void EspIdfHaLow::setConnectionCallback(ConnectionCallback callback) {
+    m_connectionCallback = callback;
+}
+
+void EspIdfHaLow::setDataCallback(DataCallback callback) {
+    m_dataCallback = callback;
+}
+
+void EspIdfHaLow::setDiscoveryCallback(DiscoveryCallback callback) {
+    m_discoveryCallback = callback;
+}
+
+void EspIdfHaLow::setEventCallback(EventCallback callback) {
+    m_eventCallback = callback;
+}
+
+std::string EspIdfHaLow::getImplementationName() const {
+    return "ESP-IDF";
+}
+
+std::vector<std::string> EspIdfHaLow::getSupportedHardware() const {
+    return {"XIAO_ESP32S3", "XIAO_ESP32C3", "XIAO_ESP32C6",
+            "HELTEC_HT_HC32", "HELTEC_HT_IT01", "HELTEC_GENERIC", "ESP32_GENERIC"};
+}
+
+bool EspIdfHaLow::isInitialized() const {
+    return m_initialized;
+}
+
+bool EspIdfHaLow::isConnected() const {
+    return m_connected;
+}
+
+std::string EspIdfHaLow::getVersion() const {
+    return "1.0.0";
+}
+
+std::string EspIdfHaLow::sendRawCommand(const std::string& command, const std::vector<std::string>& params) {
+    if (command == "rssi") {
+        return std::to_string(apRssi());
+    }
+    if (command == "set_link_rate") {
+        // The access point runs its own rate control on 2.4 GHz
+        return "IGNORED: rate is chosen by the access point";
+    }
+    if (command == "set_power_save") {
+        // Station modem sleep: waking for every DTIM beacon, or only at
+        // the listen interval when the node is idle
+        if (params.empty()) {
+            return "ERROR: set_power_save <wake_ms>";
+        }
+        bool dozing = strtoul(params[0].c_str(), nullptr, 10) > 0;
+        esp_err_t err = esp_wifi_set_ps(dozing ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+        return err == ESP_OK ? "OK" : std::string("ERROR: ") + esp_err_to_name(err);
+    }
+    return "ERROR: unknown command " + command;
+}
+
+// Wi-Fi and IP event handling
+
+void EspIdfHaLow::wifiEventHandler(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    static_cast<EspIdfHaLow*>(arg)->handleWifiEvent(base, id, data);
+}
+
+void EspIdfHaLow::handleWifiEvent(esp_event_base_t base, int32_t id, void* data) {
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START) {
+        esp_wifi_connect();
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED) {
+        const wifi_event_sta_connected_t* event = static_cast<const wifi_event_sta_connected_t*>(data);
+        char bssid[18];
+        snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 event->bssid[0], event->bssid[1], event->bssid[2],
+                 event->bssid[3], event->bssid[4], event->bssid[5]);
+        m_bssid = bssid;
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        const wifi_event_sta_disconnected_t* event = static_cast<const wifi_event_sta_disconnected_t*>(data);
+        if (m_connected) {
+            ESP_LOGW(TAG, "Disconnected from %s (reason %d)", m_config.ssid.c_str(), event->reason);
+            m_connected = false;
+            notifyConnection(false);
+        }
+        if (m_running) {
+            esp_wifi_connect();
+        }
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        ESP_LOGI(TAG, "Connected to %s", m_config.ssid.c_str());
+        m_connected = true;
+        m_nextBeaconUs = esp_timer_get_time();
+        notifyConnection(true);
+    }
+}
+
+void EspIdfHaLow::notifyConnection(bool connected) {
+    if (m_connectionCallback) {
+        m_connectionCallback(m_bssid, connected);
+    }
+    if (m_eventCallback) {
+        m_eventCallback(connected ? "connected" : "disconnected", nullptr);
+    }
+}
+
+// Socket handling
+
+bool EspIdfHaLow::openSocket() {
+    m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_socket < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(MULTICAST_PORT);
+    if (bind(m_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind port %u: errno %d", MULTICAST_PORT, errno);
+        closeSocket();
+        return false;
+    }
+
+    // Membership is per interface, but the station is the only one
+    struct ip_mreq mreq = {};
+    inet_aton(MULTICAST_GROUP, &mreq.imr_multiaddr);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        ESP_LOGE(TAG, "Failed to join multicast group: errno %d", errno);
+        closeSocket();
+        return false;
+    }
+
+    uint8_t ttl = 1;
+    setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = RECEIVE_TIMEOUT_MS * 1000;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    return true;
+}
+
+void EspIdfHaLow::closeSocket() {
+    if (m_socket >= 0) {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+bool EspIdfHaLow::sendFrame(FrameType type, const std::string& dest, uint32_t address,
+                            const uint8_t* payload, size_t length) {
+    size_t frame_size = FRAME_FIXED_HEADER + 1 + m_nodeId.size() + 1 + dest.size() + length;
+    if (dest.size() > 0xFF || frame_size > MAX_FRAME_SIZE) {
+        ESP_LOGE(TAG, "Frame too large: %d bytes", (int)frame_size);
+        return false;
+    }
+
+    std::vector<uint8_t> frame;
+    frame.reserve(frame_size);
+    frame.push_back(FRAME_MAGIC_0);
+    frame.push_back(FRAME_MAGIC_1);
+    frame.push_back(FRAME_VERSION);
+    frame.push_back(type);
+    frame.push_back((uint8_t)m_nodeId.size());
+    frame.insert(frame.end(), m_nodeId.begin(), m_nodeId.end());
+    frame.push_back((uint8_t)dest.size());
+    frame.insert(frame.end(), dest.begin(), dest.end());
+    if (length > 0) {
+        frame.insert(frame.end(), payload, payload + length);
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(MULTICAST_PORT);
+    if (address != 0) {
+        addr.sin_addr.s_addr = address;
+    } else {
+        inet_aton(MULTICAST_GROUP, &addr.sin_addr);
+    }
+
+    int sent = sendto(m_socket, frame.data(), frame.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+    if (sent < 0) {
+        ESP_LOGE(TAG, "sendto failed: errno %d", errno);
+        return false;
+    }
+    return true;
+}
+
+// Receive task
+
+void EspIdfHaLow::receiveTask(void* arg) {
+    EspIdfHaLow* self = static_cast<EspIdfHaLow*>(arg);
+    self->receiveLoop();
+    xSemaphoreGive(self->m_taskDone);
+    vTaskDelete(NULL);
+}
+
+void EspIdfHaLow::receiveLoop() {
+    std::vector<uint8_t> buffer(MAX_FRAME_SIZE);
+
+    while (m_running) {
+        struct sockaddr_in from = {};
+        socklen_t from_len = sizeof(from);
+        int received = recvfrom(m_socket, buffer.data(), buffer.size(), 0,
+                                (struct sockaddr*)&from, &from_len);
+        if (received > 0) {
+            handleFrame(buffer.data(), (size_t)received, from.sin_addr.s_addr);
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now < m_nextBeaconUs) {
+            continue;
+        }
+        m_nextBeaconUs = now + (int64_t)m_config.heartbeat_interval * 1000;
+
+        if (m_connected) {
+            sendFrame(FRAME_BEACON, std::string(), 0, nullptr, 0);
+        }
+
+        std::vector<std::string> peer_list;
+        bool changed = false;
+        if (xSemaphoreTake(m_mutex, PEER_MUTEX_TIMEOUT) == pdTRUE) {
+            expirePeers(now);
+            changed = m_peersChanged;
+            m_peersChanged = false;
+            if (changed) {
+                for (const auto& entry : m_peers) {
+                    peer_list.push_back(entry.first);
+                }
+            }
+            xSemaphoreGive(m_mutex);
+        }
+        if (changed && m_discovering && m_discoveryCallback) {
+            m_discoveryCallback(peer_list);
+        }
+    }
+}
+
+void EspIdfHaLow::handleFrame(const uint8_t* frame, size_t length, uint32_t address) {
+    if (length < FRAME_FIXED_HEADER + 2 ||
+        frame[0] != FRAME_MAGIC_0 || frame[1] != FRAME_MAGIC_1 || frame[2] != FRAME_VERSION) {
+        return;
+    }
+
+    size_t offset = FRAME_FIXED_HEADER;
+    size_t src_len = frame[offset++];
+    if (offset + src_len + 1 > length) {
+        return;
+    }
+    std::string source(reinterpret_cast<const char*>(frame + offset), src_len);
+    offset += src_len;
+
+    size_t dst_len = frame[offset++];
+    if (offset + dst_len > length) {
+        return;
+    }
+    std::string dest(reinterpret_cast<const char*>(frame + offset), dst_len);
+    offset += dst_len;
+
+    // Our own broadcasts come back through the multicast group
+    if (source == m_nodeId) {
+        return;
+    }
+
+    if (xSemaphoreTake(m_mutex, PEER_MUTEX_TIMEOUT) == pdTRUE) {
+        auto it = m_peers.find(source);
+        if (it == m_peers.end()) {
+            PeerState state;
+            state.address = address;
+            state.lastSeenUs = esp_timer_get_time();
+            state.connectTime = (uint32_t)time(nullptr);
+            m_peers.emplace(source, state);
+            m_peersChanged = true;
+            // Report the new peer right away rather than on the next beacon
+            m_nextBeaconUs = 0;
+        } else {
+            it->second.address = address;
+            it->second.lastSeenUs = esp_timer_get_time();
+        }
+        xSemaphoreGive(m_mutex);
+    }
+
+    FrameType type = (FrameType)frame[3];
+    if (type == FRAME_BEACON || (type == FRAME_UNICAST && dest != m_nodeId)) {
+        return;
+    }
+
+    if (m_dataCallback) {
+        m_dataCallback(source, std::vector<uint8_t>(frame + offset, frame + length));
+    }
+}
+
+void EspIdfHaLow::expirePeers(int64_t now) {
+    int64_t timeout_us = (int64_t)m_config.heartbeat_interval * BEACON_MISS_LIMIT * 1000;
+    for (auto it = m_peers.begin(); it != m_peers.end();) {
+        if (now - it->second.lastSeenUs > timeout_us) {
+            ESP_LOGI(TAG, "Peer %s timed out", it->first.c_str());
+            it = m_peers.erase(it);
+            m_peersChanged = true;
+        } else {
+            ++it;
+        }
+    }
+}
+
+int32_t EspIdfHaLow::apRssi() const {
+    wifi_ap_record_t ap;
+    if (m_connected && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        return ap.rssi;
+    }
+    return 0;
+}
+
+HaLowPeerInfo EspIdfHaLow::makePeerInfo(const std::string& peer_id, const PeerState& state) const {
+    HaLowPeerInfo info;
+    info.peer_id = peer_id;
+    info.mac_address = "";
+    info.ipv6_address = "";
+    // Peers are reached through the access point; its RSSI bounds every link
+    info.rssi = apRssi();
+    info.connection_time = state.connectTime;
+    info.is_connected = m_connected;
+    info.device_type = "ESP32 Wi-Fi";
+    return info;
+}
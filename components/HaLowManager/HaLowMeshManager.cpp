@@ -1,272 +1,824 @@
 #include "include/HaLowMeshManager.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "../../main/include/config.h" // Access config for TAG
-#include "../../main/include/safe_callback.h" // Safe callback system
-#include "mm_iot_sdk.h" // Include the MM-IoT-SDK wrapper
+#include "../../main/include/event_executor.h" // Deferred radio event processing
+#include "../../main/include/halow_factory.h"
+#include "../../main/include/link_adaptation.h"
+#include <algorithm>
+#include <new>
+
+// Payloads copied out of radio callbacks for deferred processing
+struct ConnectionEventPayload {
+    uint32_t generation;
+    std::string peerId;
+    bool connected;
+};
+
+struct DataEventPayload {
+    uint32_t generation;
+    std::string peerId;
+    std::vector<uint8_t> data;
+};
+
+struct DiscoveryEventPayload {
+    uint32_t generation;
+    std::vector<std::string> peers;
+};
+
+template<typename T>
+static void releasePayload(void* arg) {
+    delete static_cast<T*>(arg);
+}
+
+// Mutex timeout for the offline message cache
+#define MESSAGE_CACHE_MUTEX_TIMEOUT pdMS_TO_TICKS(100)
+// Mutex timeout for radio access from send paths
+#define RADIO_MUTEX_TIMEOUT pdMS_TO_TICKS(100)
+
+// Oldest messages are dropped once the cache holds more than this many
+// bytes, counting payload, destination and per-message overhead
+#define MESSAGE_CACHE_MAX_BYTES (32 * 1024)
+
+// Failure triggers
+#define SEND_FAILURE_LIMIT 5            // Consecutive failed sends
+#define LINK_LOSS_FAILOVER_MS 20000     // Disconnected this long with another backend available
 
 // Private constructor for singleton
 HaLowMeshManager::HaLowMeshManager()
     : isInitialized(false)
     , isConnected(false)
-    , m_mmSDK(nullptr)
-    , m_callbackOwner("HaLowMeshManager") {
-    // Constructor body
+    , m_cacheBytes(0)
+    , m_backendIndex(0)
+    , m_networkConfig()
+    , m_radioWakeMs(0)
+    , m_radioPowerSave(true)
+    , m_generation(0)
+    , m_failoverRequested(false)
+    , m_failureUs(0)
+    , m_consecutiveSendFailures(0)
+    , m_droppedMessages(0)
+    , m_stats()
+    , m_totalReconnectMs(0) {
+    messageCacheMutex = xSemaphoreCreateMutex();
+    m_radioMutex = xSemaphoreCreateRecursiveMutex();
+
+    // Construct the link adaptation singleton first so it outlives this one;
+    // the destructor detaches the radio from it
+    LinkAdaptation::getInstance();
 }
 
 HaLowMeshManager::~HaLowMeshManager() {
     // Destructor body
-    if (m_mmSDK) {
-        delete m_mmSDK;
-        m_mmSDK = nullptr;
+    m_generation++;
+    LinkAdaptation::getInstance().setRadio(nullptr);
+    if (m_radio) {
+        m_radio->deinitialize();
+        m_radio.reset();
+    }
+    m_binding.reset();
+    if (messageCacheMutex) {
+        vSemaphoreDelete(messageCacheMutex);
+        messageCacheMutex = NULL;
+    }
+    if (m_radioMutex) {
+        vSemaphoreDelete(m_radioMutex);
+        m_radioMutex = NULL;
     }
 }
 
 bool HaLowMeshManager::begin() {
-    ESP_LOGI(TAG, "Initializing HaLowMeshManager with MM-IoT-SDK...");
-
-    // Initialize MM-IoT-SDK
-    m_mmSDK = new MMIoTSDK();
-
-    // Get configuration from config.h
-    std::string ssid = "AirCom-HaLow";
-    std::string password = "aircom2024";
-    std::string country_code = "00"; // Default country code
-
-    if (m_mmSDK->initialize(ssid, password, country_code)) {
-        isInitialized = true;
-        isConnected = false; // Will be updated by callbacks
-
-        // Set up safe callbacks using the callback manager
-        m_connectionCallback = createConnectionCallback(
-            [this](const std::string& peer_id, bool connected) {
-                this->handleConnectionEvent(peer_id, connected);
-            },
-            m_callbackOwner.getOwnerId()
-        );
-
-        m_dataCallback = createDataCallback(
-            [this](const std::string& peer_id, const std::vector<uint8_t>& data) {
-                this->handleDataEvent(peer_id, data);
-            },
-            m_callbackOwner.getOwnerId()
-        );
-
-        m_discoveryCallback = createDiscoveryCallback(
-            [this](const std::vector<std::string>& peer_list) {
-                this->handleDiscoveryEvent(peer_list);
-            },
-            m_callbackOwner.getOwnerId()
-        );
-
-        // Register callbacks with MM-IoT-SDK (using raw function pointers for compatibility)
-        m_mmSDK->setConnectionCallback([this](const std::string& peer_id, bool connected) {
-            if (m_connectionCallback && m_connectionCallback->isValid()) {
-                m_connectionCallback->execute(peer_id, connected);
-            }
-        });
+    if (isInitialized) {
+        return true;
+    }
 
-        m_mmSDK->setDataCallback([this](const std::string& peer_id, const std::vector<uint8_t>& data) {
-            if (m_dataCallback && m_dataCallback->isValid()) {
-                m_dataCallback->execute(peer_id, data);
-            }
-        });
+    loadNetworkConfig();
 
-        m_mmSDK->setDiscoveryCallback([this](const std::vector<std::string>& peer_list) {
-            if (m_discoveryCallback && m_discoveryCallback->isValid()) {
-                m_discoveryCallback->execute(peer_list);
-            }
-        });
+    HaLowFactory& factory = HaLowFactory::getInstance();
+    m_backends = factory.getFailoverOrder();
+    if (m_backends.empty()) {
+        ESP_LOGE(TAG, "No radio backend available for this hardware");
+        return false;
+    }
+
+    std::unique_ptr<IHaLow> radio = factory.createOptimalHaLow();
+    size_t index = 0;
+    if (radio) {
+        auto it = std::find(m_backends.begin(), m_backends.end(), radio->getImplementationName());
+        index = it != m_backends.end() ? (size_t)(it - m_backends.begin()) : 0;
+        ESP_LOGI(TAG, "Initializing HaLowMeshManager with %s...", radio->getImplementationName().c_str());
+        if (installRadio(std::move(radio), index)) {
+            isInitialized = true;
+            ESP_LOGI(TAG, "HaLowMeshManager initialized successfully.");
+            return true;
+        }
+    }
+
+    // The preferred backend did not come up: try the rest in order
+    for (size_t next = index + 1; next < m_backends.size(); next++) {
+        radio = factory.createByName(m_backends[next]);
+        if (radio && installRadio(std::move(radio), next)) {
+            isInitialized = true;
+            xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+            m_stats.failovers++;
+            xSemaphoreGiveRecursive(m_radioMutex);
+            ESP_LOGW(TAG, "HaLowMeshManager running on fallback backend %s", m_backends[next].c_str());
+            return true;
+        }
+    }
+
+    ESP_LOGE(TAG, "Failed to initialize any radio backend");
+    return false;
+}
 
-        ESP_LOGI(TAG, "HaLowMeshManager initialized successfully with safe callback system.");
+bool HaLowMeshManager::begin(std::unique_ptr<IHaLow> radio) {
+    if (isInitialized) {
         return true;
-    } else {
-        ESP_LOGE(TAG, "Failed to initialize MM-IoT-SDK");
-        delete m_mmSDK;
-        m_mmSDK = nullptr;
+    }
+    if (!radio) {
         return false;
     }
+
+    loadNetworkConfig();
+
+    m_backends.assign(1, radio->getImplementationName());
+    ESP_LOGI(TAG, "Initializing HaLowMeshManager with %s...", m_backends[0].c_str());
+    if (!installRadio(std::move(radio), 0)) {
+        ESP_LOGE(TAG, "Failed to initialize radio backend %s", m_backends[0].c_str());
+        return false;
+    }
+    isInitialized = true;
+    return true;
 }
 
-void HaLowMeshManager::setConnectionStatus(bool status) {
-    if (isConnected != status) {
-        isConnected = status;
-        ESP_LOGI(TAG, "Connection status changed to: %s", isConnected ? "Connected" : "Disconnected");
+void HaLowMeshManager::loadNetworkConfig() {
+    // Credentials and radio parameters come from the config manager; fall
+    // back to the platform defaults if it has not been loaded
+    if (!config_manager_get_network_config(&m_networkConfig)) {
+        ESP_LOGW(TAG, "Config manager not initialized, using platform network defaults");
+        aircom_config_t defaults;
+        config_manager_get_defaults(config_manager_detect_hardware(), &defaults);
+        m_networkConfig = defaults.network;
     }
 }
 
-bool HaLowMeshManager::get_connection_status() const {
-    return isConnected;
+HaLowConfig HaLowMeshManager::makeRadioConfig(const std::string& backend) const {
+    HaLowConfig config;
+    config.ssid = m_networkConfig.ssid;
+    config.password = m_networkConfig.password;
+    config.country_code = m_networkConfig.country_code;
+    config.channel = m_networkConfig.channel;
+    config.bandwidth = m_networkConfig.bandwidth;
+    config.enable_mesh = m_networkConfig.enable_mesh;
+    config.max_connections = m_networkConfig.max_connections;
+    config.heartbeat_interval = m_networkConfig.heartbeat_interval;
+    config.discovery_timeout = m_networkConfig.discovery_timeout;
+    config.enable_encryption = m_networkConfig.enable_encryption;
+    config.encryption_key = m_networkConfig.encryption_key;
+    config.allowed_peer_ids = m_networkConfig.allowed_peer_ids;
+
+    // Standard Wi-Fi joins its own network if one is configured
+    if (backend == "ESP-IDF" && !m_networkConfig.fallback_ssid.empty()) {
+        config.ssid = m_networkConfig.fallback_ssid;
+        config.password = m_networkConfig.fallback_password;
+    }
+    return config;
 }
 
-bool HaLowMeshManager::sendUdpMulticast(const uint8_t* data, size_t size, uint16_t port) {
-    if (!isInitialized || !m_mmSDK) {
-        ESP_LOGE(TAG, "Cannot send UDP multicast, manager not initialized.");
+bool HaLowMeshManager::installRadio(std::unique_ptr<IHaLow> radio, size_t backendIndex) {
+    const std::string name = m_backends[backendIndex];
+    uint32_t generation = ++m_generation;
+
+    std::unique_ptr<RadioBinding> binding(new (std::nothrow) RadioBinding{this, generation});
+    if (!binding) {
+        ESP_LOGE(TAG, "Out of memory for radio binding");
+        return false;
+    }
+    RadioBinding* events = binding.get();
+    radio->setConnectionCallback(ConnectionCallback::fromMethod<RadioBinding, &RadioBinding::onConnection>(events));
+    radio->setDataCallback(DataCallback::fromMethod<RadioBinding, &RadioBinding::onData>(events));
+    radio->setDiscoveryCallback(DiscoveryCallback::fromMethod<RadioBinding, &RadioBinding::onDiscovery>(events));
+    radio->setEventCallback(EventCallback::fromMethod<RadioBinding, &RadioBinding::onEvent>(events));
+
+    if (!radio->initialize(makeRadioConfig(name))) {
+        ESP_LOGW(TAG, "Radio backend %s failed to initialize", name.c_str());
+        // The radio goes before the binding its callbacks point at
+        radio.reset();
         return false;
     }
+    radio->startDiscovery();
+
+    xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+    m_radio = std::move(radio);
+    m_binding = std::move(binding);
+    m_backendIndex = backendIndex;
+    m_consecutiveSendFailures = 0;
+    m_stats.activeBackend = name;
+    bool connected = m_radio->isConnected();
+    m_radioPowerSave = true;
+    if (m_radioWakeMs != 0) {
+        applyRadioWakeInterval();
+    }
+    xSemaphoreGiveRecursive(m_radioMutex);
 
-    if (!isConnected) {
-        ESP_LOGI(TAG, "Connection is down. Caching multicast message (%d bytes).", size);
-        CachedMessage msg;
-        msg.data.assign(data, data + size);
-        msg.port = port;
-        msg.isMulticast = true;
-        messageCache.push_back(msg);
-        return true; // Return true as the message is "handled" by caching it
+    LinkAdaptation::getInstance().setRadio(m_radio.get());
+
+    // Some backends are up as soon as initialize() returns and never raise a
+    // connection event for it
+    if (connected) {
+        handleConnectionEvent(generation, std::string(), true);
     }
+    return true;
+}
 
-    // Use MM-IoT-SDK to broadcast data
-    std::vector<uint8_t> dataVec(data, data + size);
-    bool success = m_mmSDK->broadcastData(dataVec);
+void HaLowMeshManager::requestFailover(const char* reason) {
+    if (m_failoverRequested) {
+        return;
+    }
+    // The outage is stamped before the request is visible to checkRadioHealth()
+    noteOutage();
+    if (!m_failoverRequested.exchange(true)) {
+        ESP_LOGW(TAG, "Radio %s failed (%s), failover requested", backendName().c_str(), reason);
+    }
+}
 
+void HaLowMeshManager::noteOutage() {
+    // Reconnect time is measured from the first sign of trouble
+    int64_t none = 0;
+    m_failureUs.compare_exchange_strong(none, esp_timer_get_time());
+}
+
+void HaLowMeshManager::noteSendResult(bool success) {
     if (success) {
-        ESP_LOGI(TAG, "Sent %d bytes via MM-IoT-SDK broadcast", size);
-    } else {
-        ESP_LOGE(TAG, "Failed to send multicast via MM-IoT-SDK");
+        m_consecutiveSendFailures = 0;
+    } else if (++m_consecutiveSendFailures >= SEND_FAILURE_LIMIT) {
+        requestFailover("repeated send failures");
     }
+}
 
-    return success;
+void HaLowMeshManager::checkRadioHealth() {
+    if (!isInitialized) {
+        return;
+    }
+
+    int64_t failureUs = m_failureUs;
+    if (!m_failoverRequested && !isConnected && failureUs != 0 && m_backends.size() > 1 &&
+        esp_timer_get_time() - failureUs > (int64_t)LINK_LOSS_FAILOVER_MS * 1000) {
+        requestFailover("link lost");
+    }
+    if (!m_failoverRequested.exchange(false)) {
+        return;
+    }
+
+    // Retire the failed radio. Bumping the generation first drops any event
+    // it raises while shutting down; cached traffic stays in messageCache.
+    std::unique_ptr<IHaLow> failed;
+    std::unique_ptr<RadioBinding> failedBinding;
+    xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+    m_generation++;
+    failed = std::move(m_radio);
+    failedBinding = std::move(m_binding);
+    xSemaphoreGiveRecursive(m_radioMutex);
+
+    LinkAdaptation::getInstance().setRadio(nullptr);
+    setConnectionStatus(false);
+    if (failed) {
+        failed->deinitialize();
+        failed.reset();
+    }
+    failedBinding.reset();
+
+    // Next backend in priority order, wrapping around so a recovered HaLow
+    // radio is retried after the fallback; the last attempt restarts the
+    // backend that just failed
+    HaLowFactory& factory = HaLowFactory::getInstance();
+    for (size_t attempt = 1; attempt <= m_backends.size(); attempt++) {
+        size_t index = (m_backendIndex + attempt) % m_backends.size();
+        std::unique_ptr<IHaLow> radio = factory.createByName(m_backends[index]);
+        if (radio && installRadio(std::move(radio), index)) {
+            xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+            m_stats.failovers++;
+            xSemaphoreGiveRecursive(m_radioMutex);
+            ESP_LOGW(TAG, "Failed over to %s", m_backends[index].c_str());
+            return;
+        }
+    }
+
+    ESP_LOGE(TAG, "No radio backend could be started, retrying");
+    m_failoverRequested = true;
+}
+
+void HaLowMeshManager::setRadioWakeInterval(uint32_t wake_ms) {
+    xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+    bool changed = wake_ms != m_radioWakeMs;
+    m_radioWakeMs = wake_ms;
+    if (changed) {
+        applyRadioWakeInterval();
+    }
+    xSemaphoreGiveRecursive(m_radioMutex);
+}
+
+// Under m_radioMutex
+void HaLowMeshManager::applyRadioWakeInterval() {
+    if (!m_radio || !m_radioPowerSave) {
+        return;
+    }
+    std::string result = m_radio->sendRawCommand("set_power_save", { std::to_string(m_radioWakeMs) });
+    if (result.compare(0, sizeof(HALOW_RESULT_UNSUPPORTED) - 1, HALOW_RESULT_UNSUPPORTED) == 0) {
+        m_radioPowerSave = false;
+        ESP_LOGW(TAG, "Radio has no power save, it stays awake: %s", result.c_str());
+    } else if (result.compare(0, 5, "ERROR") == 0) {
+        ESP_LOGW(TAG, "Radio rejected power save: %s", result.c_str());
+    }
+}
+
+HaLowFailoverStats HaLowMeshManager::getFailoverStats() {
+    HaLowFailoverStats stats;
+    xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+    stats = m_stats;
+    xSemaphoreGiveRecursive(m_radioMutex);
+    stats.droppedMessages = m_droppedMessages;
+
+    if (messageCacheMutex && xSemaphoreTake(messageCacheMutex, MESSAGE_CACHE_MUTEX_TIMEOUT) == pdTRUE) {
+        stats.cachedMessages = messageCache.size();
+        stats.cachedBytes = m_cacheBytes;
+        xSemaphoreGive(messageCacheMutex);
+    }
+    return stats;
+}
+
+std::string HaLowMeshManager::sendRadioCommand(const std::string& command, const std::vector<std::string>& params) {
+    std::string result;
+    xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+    if (m_radio) {
+        result = m_radio->sendRawCommand(command, params);
+    }
+    xSemaphoreGiveRecursive(m_radioMutex);
+    return result;
+}
+
+void HaLowMeshManager::setConnectionStatus(bool status) {
+    if (isConnected.exchange(status) != status) {
+        ESP_LOGI(TAG, "Connection status changed to: %s", status ? "Connected" : "Disconnected");
+    }
+}
+
+bool HaLowMeshManager::get_connection_status() const {
+    return isConnected;
+}
+
+bool HaLowMeshManager::sendUdpMulticast(const uint8_t* data, size_t size, uint16_t port) {
+    if (!isInitialized) {
+        ESP_LOGE(TAG, "Cannot send UDP multicast, manager not initialized.");
+        return false;
+    }
+
+    notifySend(port, size);
+
+    CachedMessage msg;
+    msg.data.assign(data, data + size);
+    msg.port = port;
+    msg.isMulticast = true;
+    transmit(std::move(msg));
+    return true; // A message that could not go out now is cached
 }
 
 bool HaLowMeshManager::sendUdpUnicast(const std::string& destIp, const uint8_t* data, size_t size, uint16_t port) {
-    if (!isInitialized || !m_mmSDK) {
+    if (!isInitialized) {
         ESP_LOGE(TAG, "Cannot send UDP unicast, manager not initialized.");
         return false;
     }
 
+    notifySend(port, size);
+
+    CachedMessage msg;
+    msg.data.assign(data, data + size);
+    msg.port = port;
+    msg.destIp = destIp;
+    msg.isMulticast = false;
+    transmit(std::move(msg));
+    return true; // A message that could not go out now is cached
+}
+
+void HaLowMeshManager::transmit(CachedMessage&& msg) {
+    size_t size = msg.data.size();
     if (!isConnected) {
-        ESP_LOGI(TAG, "Connection is down. Caching unicast message for %s (%d bytes).", destIp.c_str(), size);
-        CachedMessage msg;
-        msg.data.assign(data, data + size);
-        msg.port = port;
-        msg.destIp = destIp;
-        msg.isMulticast = false;
-        messageCache.push_back(msg);
-        return true; // Return true as the message is "handled" by caching it
+        if (msg.isMulticast) {
+            ESP_LOGI(TAG, "Connection is down. Caching multicast message (%d bytes).", size);
+        } else {
+            ESP_LOGI(TAG, "Connection is down. Caching unicast message for %s (%d bytes).", msg.destIp.c_str(), size);
+        }
+        cacheMessage(std::move(msg));
+        return;
     }
 
-    // Use MM-IoT-SDK to send unicast data
-    std::vector<uint8_t> dataVec(data, data + size);
-    bool success = m_mmSDK->sendData(destIp, dataVec);
+    bool success = false;
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        if (m_radio) {
+            success = msg.isMulticast ? m_radio->broadcastData(msg.data) : m_radio->sendData(msg.destIp, msg.data);
+        }
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
+    noteSendResult(success);
 
-    if (success) {
-        ESP_LOGI(TAG, "Sent %d bytes via MM-IoT-SDK unicast to %s", size, destIp.c_str());
+    if (!success) {
+        // Keep the message for the next radio rather than losing it
+        if (msg.isMulticast) {
+            ESP_LOGE(TAG, "Failed to send multicast, caching %d bytes", size);
+        } else {
+            ESP_LOGE(TAG, "Failed to send unicast to %s, caching %d bytes", msg.destIp.c_str(), size);
+        }
+        cacheMessage(std::move(msg));
+        return;
+    }
+
+    if (msg.isMulticast) {
+        ESP_LOGI(TAG, "Sent %d bytes via %s broadcast", size, backendName().c_str());
     } else {
-        ESP_LOGE(TAG, "Failed to send unicast via MM-IoT-SDK to %s", destIp.c_str());
+        ESP_LOGI(TAG, "Sent %d bytes via %s unicast to %s", size, backendName().c_str(), msg.destIp.c_str());
     }
+}
 
-    return success;
+static size_t cachedMessageBytes(const CachedMessage& msg) {
+    return sizeof(CachedMessage) + msg.data.size() + msg.destIp.size();
+}
+
+void HaLowMeshManager::cacheMessage(CachedMessage&& msg) {
+    size_t bytes = cachedMessageBytes(msg);
+    if (bytes > MESSAGE_CACHE_MAX_BYTES) {
+        ESP_LOGW(TAG, "Message of %d bytes exceeds the cache, dropping it.", msg.data.size());
+        m_droppedMessages++;
+        return;
+    }
+    if (!messageCacheMutex || xSemaphoreTake(messageCacheMutex, MESSAGE_CACHE_MUTEX_TIMEOUT) != pdTRUE) {
+        ESP_LOGW(TAG, "Message cache busy, dropping %d byte message.", msg.data.size());
+        m_droppedMessages++;
+        return;
+    }
+
+    // Make room by dropping the oldest messages, all in one erase
+    size_t drop = 0;
+    while (m_cacheBytes + bytes > MESSAGE_CACHE_MAX_BYTES) {
+        m_cacheBytes -= cachedMessageBytes(messageCache[drop]);
+        drop++;
+    }
+    if (drop > 0) {
+        messageCache.erase(messageCache.begin(), messageCache.begin() + drop);
+        m_droppedMessages += (uint32_t)drop;
+        ESP_LOGW(TAG, "Message cache full, dropped %d oldest messages.", drop);
+    }
+
+    messageCache.push_back(std::move(msg));
+    m_cacheBytes += bytes;
+    xSemaphoreGive(messageCacheMutex);
 }
 
 void HaLowMeshManager::sendCachedMessages() {
-    if (messageCache.empty()) {
+    // Take the whole cache under the lock and replay it without holding it, so
+    // senders are not blocked and a new disconnect can re-cache safely
+    std::vector<CachedMessage> pending;
+    if (!messageCacheMutex || xSemaphoreTake(messageCacheMutex, MESSAGE_CACHE_MUTEX_TIMEOUT) != pdTRUE) {
+        ESP_LOGW(TAG, "Message cache busy, deferring replay.");
         return;
     }
+    pending.swap(messageCache);
+    m_cacheBytes = 0;
+    xSemaphoreGive(messageCacheMutex);
 
-    ESP_LOGI(TAG, "Connection restored. Sending %d cached messages...", messageCache.size());
+    if (pending.empty()) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Connection restored. Sending %d cached messages...", pending.size());
 
-    for (const auto& msg : messageCache) {
+    // Send listeners already heard about these when they were first sent
+    for (auto& msg : pending) {
         if (msg.isMulticast) {
             ESP_LOGI(TAG, "Sending cached multicast message (%d bytes) to port %d.", msg.data.size(), msg.port);
-            sendUdpMulticast(msg.data.data(), msg.data.size(), msg.port);
         } else {
             ESP_LOGI(TAG, "Sending cached unicast message (%d bytes) to %s:%d.", msg.data.size(), msg.destIp.c_str(), msg.port);
-            sendUdpUnicast(msg.destIp, msg.data.data(), msg.data.size(), msg.port);
         }
+        transmit(std::move(msg));
     }
 
-    messageCache.clear();
     ESP_LOGI(TAG, "Message cache cleared.");
 }
 
 std::vector<MeshNodeInfo> HaLowMeshManager::getMeshNodes() {
     std::vector<MeshNodeInfo> nodes;
-    if (!isInitialized || !m_mmSDK) {
+    if (!isInitialized) {
         ESP_LOGE(TAG, "Cannot get nodes, manager not initialized.");
         return nodes;
     }
 
-    // Get discovered peers from MM-IoT-SDK
-    auto peers = m_mmSDK->getDiscoveredPeers();
+    std::vector<HaLowPeerInfo> peers;
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        if (m_radio) {
+            peers = m_radio->getDiscoveredPeers();
+        }
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
 
-    // Convert to MeshNodeInfo format
+    // The peer ID is the radio address used by sendUdpUnicast(); the callsign
+    // is filled in later from the node's discovery message
     for (const auto& peer : peers) {
         MeshNodeInfo node;
-        node.macAddress = "MM:IO:T-" + peer.substr(0, 8); // Generate MAC-like address from peer ID
-        node.ipv6Address = "fe80::mmiot:" + peer.substr(0, 4) + ":" + peer.substr(4, 4);
+        node.callsign = peer.peer_id;
+        node.ipAddress = peer.peer_id;
         nodes.push_back(node);
     }
 
-    ESP_LOGI(TAG, "Fetched %d mesh nodes from MM-IoT-SDK", nodes.size());
+    ESP_LOGI(TAG, "Fetched %d mesh nodes from %s", nodes.size(), backendName().c_str());
     return nodes;
 }
 
-// Additional methods for MM-IoT-SDK integration
+std::vector<std::string> HaLowMeshManager::getReachablePeers() {
+    std::vector<std::string> peerIds;
+    if (!isInitialized) {
+        return peerIds;
+    }
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        if (m_radio) {
+            for (const auto& peer : m_radio->getConnectedPeers()) {
+                peerIds.push_back(peer.peer_id);
+            }
+        }
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
+    return peerIds;
+}
+
+std::string HaLowMeshManager::getLocalPeerId() {
+    std::string peerId;
+    if (!isInitialized) {
+        return peerId;
+    }
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        if (m_radio) {
+            peerId = m_radio->getNetworkInfo().device_id;
+        }
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
+    return peerId;
+}
+
 bool HaLowMeshManager::startDiscovery() {
-    if (!isInitialized || !m_mmSDK) {
+    if (!isInitialized) {
         ESP_LOGE(TAG, "Cannot start discovery, manager not initialized.");
         return false;
     }
 
-    return m_mmSDK->startDiscovery();
+    bool success = false;
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        success = m_radio && m_radio->startDiscovery();
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
+    return success;
 }
 
 void HaLowMeshManager::stopDiscovery() {
-    if (!isInitialized || !m_mmSDK) {
+    if (!isInitialized) {
         ESP_LOGE(TAG, "Cannot stop discovery, manager not initialized.");
         return;
     }
 
-    m_mmSDK->stopDiscovery();
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        if (m_radio) {
+            m_radio->stopDiscovery();
+        }
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
 }
 
 bool HaLowMeshManager::connectToPeer(const std::string& peer_id) {
-    if (!isInitialized || !m_mmSDK) {
+    if (!isInitialized) {
         ESP_LOGE(TAG, "Cannot connect to peer, manager not initialized.");
         return false;
     }
 
-    return m_mmSDK->connectToPeer(peer_id);
+    bool success = false;
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        success = m_radio && m_radio->connectToPeer(peer_id);
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
+    return success;
 }
 
 bool HaLowMeshManager::disconnectFromPeer(const std::string& peer_id) {
-    if (!isInitialized || !m_mmSDK) {
+    if (!isInitialized) {
         ESP_LOGE(TAG, "Cannot disconnect from peer, manager not initialized.");
         return false;
     }
 
-    return m_mmSDK->disconnectFromPeer(peer_id);
+    bool success = false;
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        success = m_radio && m_radio->disconnectFromPeer(peer_id);
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
+    return success;
+}
+
+void HaLowMeshManager::RadioBinding::onConnection(const std::string& peer_id, bool connected) {
+    manager->handleConnectionEvent(generation, peer_id, connected);
 }
 
-// Callback handlers for MM-IoT-SDK events
-void HaLowMeshManager::handleConnectionEvent(const std::string& peer_id, bool connected) {
-    ESP_LOGI(TAG, "MM-IoT-SDK connection event: %s %s",
-             peer_id.c_str(), connected ? "connected" : "disconnected");
+void HaLowMeshManager::RadioBinding::onData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    manager->handleDataEvent(generation, peer_id, data);
+}
 
-    setConnectionStatus(connected);
+void HaLowMeshManager::RadioBinding::onDiscovery(const std::vector<std::string>& peer_list) {
+    manager->handleDiscoveryEvent(generation, peer_list);
+}
 
-    if (connected) {
-        // Send any cached messages now that we're connected
-        sendCachedMessages();
+void HaLowMeshManager::RadioBinding::onEvent(const std::string& event, void* data) {
+    manager->handleRadioEvent(generation, event);
+}
 
-        // Start discovery if not already started
-        if (m_mmSDK && !m_mmSDK->isInitialized()) {
-            m_mmSDK->startDiscovery();
+// Callback handlers for radio events. They run on the radio's thread, so
+// they only copy the event and hand it to the EventExecutor. If the executor
+// is not running (e.g. standalone tests) the event is processed inline.
+void HaLowMeshManager::handleConnectionEvent(uint32_t generation, const std::string& peer_id, bool connected) {
+    if (generation != m_generation) {
+        return;
+    }
+
+    ConnectionEventPayload* payload = new (std::nothrow) ConnectionEventPayload{generation, peer_id, connected};
+    if (!payload) {
+        ESP_LOGE(TAG, "Out of memory for connection event");
+        return;
+    }
+
+    EventHandler handler = EventHandler::fromMethod<HaLowMeshManager, &HaLowMeshManager::processConnectionEvent>(this);
+    EventExecutor& executor = EventExecutor::getInstance();
+    if (!executor.isRunning()) {
+        processConnectionEvent(payload);
+        releasePayload<ConnectionEventPayload>(payload);
+        return;
+    }
+    executor.post(EVENT_PRIORITY_HIGH, handler, payload, releasePayload<ConnectionEventPayload>);
+}
+
+void HaLowMeshManager::handleDataEvent(uint32_t generation, const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (generation != m_generation) {
+        return;
+    }
+
+    DataEventPayload* payload = new (std::nothrow) DataEventPayload{generation, peer_id, data};
+    if (!payload) {
+        ESP_LOGE(TAG, "Out of memory for data event (%d bytes)", data.size());
+        return;
+    }
+
+    EventHandler handler = EventHandler::fromMethod<HaLowMeshManager, &HaLowMeshManager::processDataEvent>(this);
+    EventExecutor& executor = EventExecutor::getInstance();
+    if (!executor.isRunning()) {
+        processDataEvent(payload);
+        releasePayload<DataEventPayload>(payload);
+        return;
+    }
+    executor.post(EVENT_PRIORITY_NORMAL, handler, payload, releasePayload<DataEventPayload>);
+}
+
+void HaLowMeshManager::handleDiscoveryEvent(uint32_t generation, const std::vector<std::string>& peer_list) {
+    if (generation != m_generation) {
+        return;
+    }
+
+    DiscoveryEventPayload* payload = new (std::nothrow) DiscoveryEventPayload{generation, peer_list};
+    if (!payload) {
+        ESP_LOGE(TAG, "Out of memory for discovery event");
+        return;
+    }
+
+    EventHandler handler = EventHandler::fromMethod<HaLowMeshManager, &HaLowMeshManager::processDiscoveryEvent>(this);
+    EventExecutor& executor = EventExecutor::getInstance();
+    if (!executor.isRunning()) {
+        processDiscoveryEvent(payload);
+        releasePayload<DiscoveryEventPayload>(payload);
+        return;
+    }
+    executor.post(EVENT_PRIORITY_LOW, handler, payload, releasePayload<DiscoveryEventPayload>);
+}
+
+void HaLowMeshManager::handleRadioEvent(uint32_t generation, const std::string& event) {
+    // Only sets a flag; the switch itself happens in checkRadioHealth()
+    if (generation == m_generation && event == "error") {
+        requestFailover("radio reported an error");
+    }
+}
+
+void HaLowMeshManager::processConnectionEvent(void* arg) {
+    const ConnectionEventPayload* event = static_cast<const ConnectionEventPayload*>(arg);
+    if (event->generation != m_generation) {
+        return;
+    }
+    ESP_LOGI(TAG, "Radio connection event: %s %s",
+             event->peerId.c_str(), event->connected ? "connected" : "disconnected");
+
+    // One peer leaving does not take the link down while others remain
+    bool linkUp = event->connected;
+    if (xSemaphoreTakeRecursive(m_radioMutex, RADIO_MUTEX_TIMEOUT) == pdTRUE) {
+        if (m_radio) {
+            linkUp = m_radio->isConnected();
         }
+        xSemaphoreGiveRecursive(m_radioMutex);
+    }
+    setConnectionStatus(linkUp);
+
+    if (!event->connected && !event->peerId.empty()) {
+        LinkAdaptation::getInstance().removeLink(event->peerId);
+    }
+    if (!event->peerId.empty()) {
+        notifyPeer(event->peerId, event->connected);
+    }
+
+    if (!linkUp) {
+        noteOutage();
+        return;
+    }
+
+    int64_t failureUs = m_failureUs.exchange(0);
+    if (failureUs != 0) {
+        uint32_t reconnectMs = (uint32_t)((esp_timer_get_time() - failureUs) / 1000);
+
+        xSemaphoreTakeRecursive(m_radioMutex, portMAX_DELAY);
+        m_stats.reconnects++;
+        m_stats.lastReconnectMs = reconnectMs;
+        m_stats.maxReconnectMs = std::max(m_stats.maxReconnectMs, reconnectMs);
+        m_totalReconnectMs += reconnectMs;
+        m_stats.avgReconnectMs = (uint32_t)(m_totalReconnectMs / m_stats.reconnects);
+        xSemaphoreGiveRecursive(m_radioMutex);
+
+        ESP_LOGI(TAG, "Link restored on %s after %u ms", backendName().c_str(), (unsigned)reconnectMs);
+    }
+
+    // Send any cached messages now that we're connected
+    sendCachedMessages();
+}
+
+void HaLowMeshManager::processDataEvent(void* arg) {
+    const DataEventPayload* event = static_cast<const DataEventPayload*>(arg);
+    if (event->generation != m_generation) {
+        return;
     }
+    ESP_LOGD(TAG, "Radio data event: %d bytes from %s", event->data.size(), event->peerId.c_str());
+
+    m_dataListeners.invokeAll(event->peerId, event->data);
 }
 
-void HaLowMeshManager::handleDataEvent(const std::string& peer_id, const std::vector<uint8_t>& data) {
-    ESP_LOGI(TAG, "MM-IoT-SDK data event: %d bytes from %s", data.size(), peer_id.c_str());
+DelegateHandle HaLowMeshManager::addDataListener(const DataCallback& listener) {
+    DelegateHandle handle = m_dataListeners.add(listener);
+    if (!handle.isValid()) {
+        ESP_LOGE(TAG, "Data listener table full");
+    }
+    return handle;
+}
 
-    // Handle incoming data - this could be extended to integrate with the main message queue
-    // For now, just log the event
+DelegateHandle HaLowMeshManager::addSendListener(const SendListener& listener) {
+    DelegateHandle handle = m_sendListeners.add(listener);
+    if (!handle.isValid()) {
+        ESP_LOGE(TAG, "Send listener table full");
+    }
+    return handle;
 }
 
-void HaLowMeshManager::handleDiscoveryEvent(const std::vector<std::string>& peer_list) {
-    ESP_LOGI(TAG, "MM-IoT-SDK discovery event: found %d peers", peer_list.size());
+DelegateHandle HaLowMeshManager::addPeerListener(const PeerListener& listener) {
+    DelegateHandle handle = m_peerListeners.add(listener);
+    if (!handle.isValid()) {
+        ESP_LOGE(TAG, "Peer listener table full");
+    }
+    return handle;
+}
+
+bool HaLowMeshManager::removeDataListener(DelegateHandle handle) {
+    return m_dataListeners.remove(handle);
+}
+
+bool HaLowMeshManager::removeSendListener(DelegateHandle handle) {
+    return m_sendListeners.remove(handle);
+}
+
+bool HaLowMeshManager::removePeerListener(DelegateHandle handle) {
+    return m_peerListeners.remove(handle);
+}
+
+void HaLowMeshManager::notifyPeer(const std::string& peer_id, bool reachable) {
+    m_peerListeners.invokeAll(peer_id, reachable);
+}
+
+void HaLowMeshManager::notifySend(uint16_t port, size_t size) {
+    m_sendListeners.invokeAll(port, size);
+}
+
+void HaLowMeshManager::processDiscoveryEvent(void* arg) {
+    const DiscoveryEventPayload* event = static_cast<const DiscoveryEventPayload*>(arg);
+    if (event->generation != m_generation) {
+        return;
+    }
+    ESP_LOGI(TAG, "Radio discovery event: found %d peers", event->peers.size());
 
-    // Discovery event handling - could update peer lists, etc.
-    for (const auto& peer : peer_list) {
+    for (const auto& peer : event->peers) {
         ESP_LOGD(TAG, "Discovered peer: %s", peer.c_str());
+        notifyPeer(peer, true);
     }
 }
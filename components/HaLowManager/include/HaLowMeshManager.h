@@ -1,15 +1,17 @@
 #ifndef HALOW_MESH_MANAGER_H
 #define HALOW_MESH_MANAGER_H
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
 #include <string>
 #include <memory>
 #include "shared_data.h"
-#include "safe_callback.h"
-
-// Forward declaration for MM-IoT-SDK
-class MMIoTSDK;
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "delegate.h"
+#include "halow_interface.h"
+#include "config_manager.h"
 
 // Structure to hold a cached message
 struct CachedMessage {
@@ -19,6 +21,19 @@ struct CachedMessage {
     bool isMulticast;
 };
 
+// Radio failover and reconnect statistics
+struct HaLowFailoverStats {
+    std::string activeBackend;      // Implementation name of the current radio
+    uint32_t failovers;             // Backend switches (including restarts of the same backend)
+    uint32_t reconnects;            // Outages that ended with a connected radio
+    uint32_t lastReconnectMs;       // Failure detection to first connected event
+    uint32_t maxReconnectMs;
+    uint32_t avgReconnectMs;
+    uint32_t cachedMessages;        // Messages waiting for the link to come back
+    uint32_t cachedBytes;           // Their share of the cache budget
+    uint32_t droppedMessages;       // Messages dropped because the cache was full
+};
+
 class HaLowMeshManager {
 public:
     // Singleton access method
@@ -31,9 +46,15 @@ public:
     HaLowMeshManager(const HaLowMeshManager&) = delete;
     void operator=(const HaLowMeshManager&) = delete;
 
-    // Initialize the HaLow radio and SDK
+    // Create the best radio for this board (HaLowFactory) and bring it up with
+    // the credentials from the config manager. Falls over to the next backend
+    // if the preferred one fails to initialize.
     bool begin();
 
+    // Bring the manager up on a caller-supplied radio instead of the factory's
+    // choice (host tools and benchmarks). There is no backend to fail over to.
+    bool begin(std::unique_ptr<IHaLow> radio);
+
     // Send a UDP packet to a multicast address
     bool sendUdpMulticast(const uint8_t* data, size_t size, uint16_t port);
 
@@ -43,6 +64,10 @@ public:
     // Get a list of discovered mesh nodes
     std::vector<MeshNodeInfo> getMeshNodes();
 
+    // Peers the radio has a link to now, and this node's own radio address
+    std::vector<std::string> getReachablePeers();
+    std::string getLocalPeerId();
+
     // Connection status management
     void setConnectionStatus(bool status);
     bool get_connection_status() const;
@@ -62,6 +87,49 @@ public:
     // Disconnect from a specific peer
     bool disconnectFromPeer(const std::string& peer_id);
 
+    // Switch to the next backend if the radio has failed. Call periodically
+    // from a task that may block for a radio restart (not from radio callbacks).
+    void checkRadioHealth();
+
+    // Radio failover and reconnect statistics
+    HaLowFailoverStats getFailoverStats();
+
+    // Pass a command to the active radio's sendRawCommand() (diagnostics
+    // and simulator control). Empty if there is no radio.
+    std::string sendRadioCommand(const std::string& command, const std::vector<std::string>& params);
+
+    // How often the radio wakes to receive: 0 keeps it awake, otherwise a
+    // TWT or listen interval where the backend has one. Kept across
+    // failovers. A radio that answers HALOW_RESULT_UNSUPPORTED stays awake
+    // and is not asked again until the next failover.
+    void setRadioWakeInterval(uint32_t wake_ms);
+
+    // False once the active radio has said it cannot doze, so current
+    // estimates count it as awake in every power state
+    bool radioPowerSaveSupported() const { return m_radioPowerSave.load(); }
+
+    // Services that consume mesh traffic (OTA distribution) register here,
+    // at any time: boot stages add theirs while the radio comes up, and a
+    // listener sees the frames that arrive after it was added. Data
+    // listeners see every frame received, on an EventExecutor worker; send
+    // listeners see the port and size of every frame sent or cached, on the
+    // sending task. Both must return quickly. Adding returns a handle for
+    // removal, or an invalid handle if the table is full.
+    typedef Delegate<void(uint16_t port, size_t size)> SendListener;
+    DelegateHandle addDataListener(const DataCallback& listener);
+    DelegateHandle addSendListener(const SendListener& listener);
+
+    // Neighbour table changes: a peer connected, was discovered or
+    // disconnected. Called on an EventExecutor worker; must return quickly.
+    typedef Delegate<void(const std::string& peer_id, bool reachable)> PeerListener;
+    DelegateHandle addPeerListener(const PeerListener& listener);
+
+    // Stale handles are ignored. A dispatch already running on another task
+    // may still call the listener once.
+    bool removeDataListener(DelegateHandle handle);
+    bool removeSendListener(DelegateHandle handle);
+    bool removePeerListener(DelegateHandle handle);
+
 private:
     // Private constructor for singleton
     HaLowMeshManager();
@@ -69,25 +137,94 @@ private:
 
     // Flag to track initialization status
     bool isInitialized;
-    // Flag to track mesh connection status
-    bool isConnected;
+    // Flag to track mesh connection status; written by the executor and the
+    // health check, read by every sender
+    std::atomic<bool> isConnected;
 
-    // Cache for messages to be sent when connection is restored
+    // Cache for messages to be sent when connection is restored, bounded by
+    // the bytes it holds rather than the message count
     std::vector<CachedMessage> messageCache;
-
-    // MM-IoT-SDK instance
-    MMIoTSDK* m_mmSDK;
-
-    // Safe callback system
-    CallbackOwner m_callbackOwner;
-    std::shared_ptr<ConnectionCallback> m_connectionCallback;
-    std::shared_ptr<DataCallback> m_dataCallback;
-    std::shared_ptr<DiscoveryCallback> m_discoveryCallback;
-
-    // Callback handlers for MM-IoT-SDK events
-    void handleConnectionEvent(const std::string& peer_id, bool connected);
-    void handleDataEvent(const std::string& peer_id, const std::vector<uint8_t>& data);
-    void handleDiscoveryEvent(const std::vector<std::string>& peer_list);
+    size_t m_cacheBytes;
+    SemaphoreHandle_t messageCacheMutex;
+
+    // Routes one radio's events to the manager, tagged with the generation
+    // the radio was installed under. Each radio gets its own binding, which
+    // is destroyed only after the radio is.
+    struct RadioBinding {
+        HaLowMeshManager* manager;
+        uint32_t generation;
+
+        void onConnection(const std::string& peer_id, bool connected);
+        void onData(const std::string& peer_id, const std::vector<uint8_t>& data);
+        void onDiscovery(const std::vector<std::string>& peer_list);
+        void onEvent(const std::string& event, void* data);
+    };
+
+    // Active radio and the backends to fail over to, best first. The radio
+    // mutex is recursive because some backends report events synchronously
+    // from inside calls made under it.
+    std::unique_ptr<RadioBinding> m_binding;
+    std::unique_ptr<IHaLow> m_radio;
+    SemaphoreHandle_t m_radioMutex;
+    std::vector<std::string> m_backends;      // Fixed once begin() returns
+    std::atomic<size_t> m_backendIndex;
+    network_config_t m_networkConfig;
+    uint32_t m_radioWakeMs;
+    std::atomic<bool> m_radioPowerSave;
+
+    // Events carry the generation of the radio that raised them; events from
+    // a radio that has since been replaced are dropped
+    std::atomic<uint32_t> m_generation;
+
+    // Failure detection. Raised from senders, radio callbacks and executor
+    // workers, so these are atomic; m_stats is only touched under m_radioMutex.
+    std::atomic<bool> m_failoverRequested;
+    std::atomic<int64_t> m_failureUs;           // When the current outage was detected, 0 if none
+    std::atomic<uint32_t> m_consecutiveSendFailures;
+    std::atomic<uint32_t> m_droppedMessages;
+    HaLowFailoverStats m_stats;
+    uint64_t m_totalReconnectMs;
+
+    // Name of the active backend, for logs
+    const std::string& backendName() const { return m_backends[m_backendIndex]; }
+
+    // Listener tables: O(1) registration from any task, lock-free dispatch
+    static const size_t MAX_LISTENERS = 8;
+    DelegateTable<void(const std::string&, const std::vector<uint8_t>&), MAX_LISTENERS> m_dataListeners;
+    DelegateTable<void(uint16_t, size_t), MAX_LISTENERS> m_sendListeners;
+    DelegateTable<void(const std::string&, bool), MAX_LISTENERS> m_peerListeners;
+    void notifySend(uint16_t port, size_t size);
+    void notifyPeer(const std::string& peer_id, bool reachable);
+
+    // Load m_networkConfig from the config manager or platform defaults
+    void loadNetworkConfig();
+
+    // Bring up a radio and make it current
+    bool installRadio(std::unique_ptr<IHaLow> radio, size_t backendIndex);
+    HaLowConfig makeRadioConfig(const std::string& backend) const;
+    void applyRadioWakeInterval();
+    void requestFailover(const char* reason);
+    void noteOutage();
+    void noteSendResult(bool success);
+
+    // Send a message on the radio, or cache it if the radio is down or the
+    // send fails. Does not notify send listeners
+    void transmit(CachedMessage&& msg);
+
+    // Add a message to the offline cache
+    void cacheMessage(CachedMessage&& msg);
+
+    // Callback handlers for radio events. These run on the radio's thread
+    // and only copy the event into the EventExecutor.
+    void handleConnectionEvent(uint32_t generation, const std::string& peer_id, bool connected);
+    void handleDataEvent(uint32_t generation, const std::string& peer_id, const std::vector<uint8_t>& data);
+    void handleDiscoveryEvent(uint32_t generation, const std::vector<std::string>& peer_list);
+    void handleRadioEvent(uint32_t generation, const std::string& event);
+
+    // Deferred event processing, run on EventExecutor worker tasks
+    void processConnectionEvent(void* arg);
+    void processDataEvent(void* arg);
+    void processDiscoveryEvent(void* arg);
 };
 
 #endif // HALOW_MESH_MANAGER_H
@@ -0,0 +1,203 @@
+/**
+ * @file fgh100m_spi_transport.h
+ * @brief Pipelined SPI DMA transport for the FGH100M-H HaLow module
+ *
+ * All bus traffic is owned by a single transport task. Outgoing frames are
+ * copied into one of two DMA-capable TX buffers: while one buffer is on the
+ * bus the other collects frames, so small frames queued while the bus is
+ * busy go out together in one transaction. Transactions are queued with
+ * spi_device_queue_trans() and completion is signalled from the driver's
+ * post-transaction callback, so the task never polls.
+ *
+ * Receive is interrupt driven: the module pulls INT low when it has data,
+ * the GPIO ISR wakes the task, which reads the pending length with a
+ * STATUS transaction and then fetches the batch with a READ transaction.
+ *
+ * Bus batch layout (TX and RX):
+ *   [cmd][frame_count][total_len_lo][total_len_hi]   (FGH100M_HEADER_SIZE)
+ *   repeated: [len_lo][len_hi][payload...]
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef FGH100M_SPI_TRANSPORT_H
+#define FGH100M_SPI_TRANSPORT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "delegate.h"
+
+// Per-frame length prefix inside a batch
+#define FGH100M_FRAME_PREFIX_SIZE 2
+
+/**
+ * @brief Handler for a frame received from the module
+ */
+using Fgh100mRxHandler = Delegate<void(const uint8_t*, size_t)>;
+
+/**
+ * @brief Transport configuration
+ */
+struct Fgh100mTransportConfig {
+    spi_host_device_t host;
+    int pin_mosi;
+    int pin_miso;
+    int pin_sclk;
+    int pin_cs;
+    int pin_int;
+    int clock_speed_hz;
+    int spi_mode;
+    size_t buffer_size;             ///< Size of each DMA buffer (TX and RX)
+    uint32_t batch_window_us;       ///< Extra time to wait for more frames before submitting (0 = submit as soon as the bus is free)
+    uint32_t task_stack_size;
+    UBaseType_t task_priority;
+    BaseType_t task_core;
+};
+
+/**
+ * @brief Transport statistics
+ */
+struct Fgh100mTransportStats {
+    uint32_t tx_frames;             ///< Frames written to the module
+    uint32_t tx_batches;            ///< SPI write transactions
+    uint32_t tx_bytes;              ///< Payload bytes written
+    uint32_t tx_dropped;            ///< Frames rejected because both buffers were busy/full
+    uint32_t rx_frames;             ///< Frames read from the module
+    uint32_t rx_batches;            ///< SPI read transactions
+    uint32_t rx_bytes;              ///< Payload bytes read
+    uint32_t rx_errors;             ///< Malformed RX batches
+    uint32_t avg_frame_latency_us;  ///< Mean time from sendFrame() to end of its transaction
+    uint32_t max_frame_latency_us;  ///< Worst time from sendFrame() to end of its transaction
+};
+
+class Fgh100mSpiTransport {
+public:
+    Fgh100mSpiTransport();
+    ~Fgh100mSpiTransport();
+
+    Fgh100mSpiTransport(const Fgh100mSpiTransport&) = delete;
+    void operator=(const Fgh100mSpiTransport&) = delete;
+
+    /**
+     * @brief Get the default configuration for the current board
+     */
+    static Fgh100mTransportConfig defaultConfig();
+
+    /**
+     * @brief Initialize the bus, DMA buffers, INT interrupt and transport task
+     */
+    esp_err_t begin(const Fgh100mTransportConfig& config);
+
+    /**
+     * @brief Stop the task and release the bus
+     */
+    void end();
+
+    bool isRunning() const { return m_task != NULL; }
+
+    /**
+     * @brief Queue a frame for transmission without waiting for the bus
+     * @return true if the frame was accepted
+     */
+    bool sendFrame(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Queue a frame assembled from a header and a payload, copied
+     *        straight into the DMA buffer without an intermediate copy
+     * @return true if the frame was accepted
+     */
+    bool sendFrame(const uint8_t* header, size_t header_length,
+                   const uint8_t* payload, size_t payload_length);
+
+    /**
+     * @brief Largest frame accepted by sendFrame()
+     */
+    size_t maxFrameSize() const;
+
+    /**
+     * @brief Set the handler for received frames (called on the transport task)
+     */
+    void setRxHandler(const Fgh100mRxHandler& handler) { m_rxHandler = handler; }
+
+    Fgh100mTransportStats getStats() const;
+    void resetStats();
+
+private:
+    enum TxState : uint8_t {
+        TX_IDLE,
+        TX_FILLING,
+        TX_ON_BUS
+    };
+
+    enum RxState : uint8_t {
+        RX_IDLE,
+        RX_STATUS,
+        RX_READ
+    };
+
+    struct TxBuffer {
+        uint8_t* data;
+        size_t used;                ///< Bytes including batch header
+        uint16_t frameCount;
+        TxState state;
+        int64_t firstEnqueueUs;
+        int64_t enqueueSumUs;       ///< Sum of frame enqueue times, for mean latency
+    };
+
+    static void taskEntry(void* pvParameters);
+    static void IRAM_ATTR onTransactionDone(spi_transaction_t* trans);
+    static void IRAM_ATTR onIntPin(void* arg);
+
+    void run();
+    TickType_t submitTx();
+    void startRxStatus();
+    void startRxRead(size_t length);
+    void completeTx();
+    void completeRx();
+    void deliverRxBatch(const uint8_t* batch, size_t length);
+    void recordLatency(const TxBuffer& buffer, int64_t now);
+    static void resetTxBuffer(TxBuffer& buffer);
+
+    Fgh100mTransportConfig m_config;
+    spi_device_handle_t m_device;
+    bool m_busInitialized;
+    TaskHandle_t m_task;
+    std::atomic<bool> m_stopRequested;
+    std::atomic<bool> m_taskExited;
+
+    SemaphoreHandle_t m_txMutex;
+    TxBuffer m_tx[2];
+    int m_fillIndex;                ///< Buffer currently collecting frames
+    int m_busIndex;                 ///< Buffer currently on the bus, or -1
+    spi_transaction_t m_txTrans;
+
+    uint8_t* m_rxBuffer;
+    uint8_t* m_rxCmd;               ///< DMA-capable TX side of RX transactions (command, then zero fill)
+    RxState m_rxState;
+    spi_transaction_t m_rxTrans;
+
+    Fgh100mRxHandler m_rxHandler;
+
+    std::atomic<uint32_t> m_txFrames;
+    std::atomic<uint32_t> m_txBatches;
+    std::atomic<uint32_t> m_txBytes;
+    std::atomic<uint32_t> m_txDropped;
+    std::atomic<uint32_t> m_rxFrames;
+    std::atomic<uint32_t> m_rxBatches;
+    std::atomic<uint32_t> m_rxBytes;
+    std::atomic<uint32_t> m_rxErrors;
+    std::atomic<uint64_t> m_latencySumUs;
+    std::atomic<uint32_t> m_maxLatencyUs;
+};
+
+#endif // FGH100M_SPI_TRANSPORT_H
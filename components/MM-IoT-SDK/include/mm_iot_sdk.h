@@ -16,10 +16,12 @@
 #include <cstdint>
 #include <vector>
 #include <string>
-#include <functional>
 
 // ESP-IDF includes
 #include "esp_err.h"
+#include "xiao_esp32_config.h"
+#include "fgh100m_spi_transport.h"
+#include "delegate.h"
 
 // Forward declarations for MM-IoT-SDK types (to be defined when SDK is available)
 struct mm_halow_config_t;
@@ -27,16 +29,21 @@ struct mm_network_info_t;
 struct mm_peer_info_t;
 typedef void* mm_handle_t;
 
-// Callback function types
-typedef std::function<void(const std::string& peer_id, bool connected)> ConnectionCallback;
-typedef std::function<void(const std::string& peer_id, const std::vector<uint8_t>& data)> DataCallback;
-typedef std::function<void(const std::vector<std::string>& peer_list)> DiscoveryCallback;
+struct MMIoTNetworkInfo;
+
+// Event delegate signatures
+typedef Delegate<void(const std::string& peer_id, bool connected)> ConnectionDelegate;
+typedef Delegate<void(const std::string& peer_id, const std::vector<uint8_t>& data)> DataDelegate;
+typedef Delegate<void(const std::vector<std::string>& peer_list)> DiscoveryDelegate;
 
 /**
  * @brief MM-IoT-SDK wrapper class for Wi-Fi HaLow functionality
  */
 class MMIoTSDK {
 public:
+    // Maximum listeners per event type
+    static constexpr size_t MAX_LISTENERS = 8;
+
     // Singleton access
     static MMIoTSDK& getInstance() {
         static MMIoTSDK instance;
@@ -117,25 +124,41 @@ public:
      * @brief Get network information
      * @return Network info structure
      */
-    mm_network_info_t getNetworkInfo();
+    MMIoTNetworkInfo getNetworkInfo();
+
+    /**
+     * @brief Register a connection listener
+     * @param listener Delegate to call on connection events
+     * @return Handle for removeConnectionListener(), invalid if the table is full
+     */
+    DelegateHandle addConnectionListener(const ConnectionDelegate& listener);
 
     /**
-     * @brief Set connection callback
-     * @param callback Function to call on connection events
+     * @brief Register a data listener
+     * @param listener Delegate to call on data reception
+     * @return Handle for removeDataListener(), invalid if the table is full
      */
-    void setConnectionCallback(ConnectionCallback callback);
+    DelegateHandle addDataListener(const DataDelegate& listener);
 
     /**
-     * @brief Set data callback
-     * @param callback Function to call on data reception
+     * @brief Register a discovery listener
+     * @param listener Delegate to call on discovery events
+     * @return Handle for removeDiscoveryListener(), invalid if the table is full
      */
-    void setDataCallback(DataCallback callback);
+    DelegateHandle addDiscoveryListener(const DiscoveryDelegate& listener);
 
     /**
-     * @brief Set discovery callback
-     * @param callback Function to call on discovery events
+     * @brief Unregister a listener; stale handles are ignored
+     * @return true if the handle referred to a live registration
      */
-    void setDiscoveryCallback(DiscoveryCallback callback);
+    bool removeConnectionListener(DelegateHandle handle);
+    bool removeDataListener(DelegateHandle handle);
+    bool removeDiscoveryListener(DelegateHandle handle);
+
+    /**
+     * @brief Get SPI transport statistics (throughput, batching, per-frame latency)
+     */
+    Fgh100mTransportStats getTransportStats() const { return m_transport.getStats(); }
 
     /**
      * @brief Get SDK initialization status
@@ -165,10 +188,13 @@ private:
     std::string m_password;
     std::string m_country_code;
 
-    // Callbacks
-    ConnectionCallback m_connectionCallback;
-    DataCallback m_dataCallback;
-    DiscoveryCallback m_discoveryCallback;
+    // SPI DMA transport to the FGH100M-H module
+    Fgh100mSpiTransport m_transport;
+
+    // Listener tables (O(1) registration, lock-free dispatch)
+    DelegateTable<void(const std::string&, bool), MAX_LISTENERS> m_connectionListeners;
+    DelegateTable<void(const std::string&, const std::vector<uint8_t>&), MAX_LISTENERS> m_dataListeners;
+    DelegateTable<void(const std::vector<std::string>&), MAX_LISTENERS> m_discoveryListeners;
 
     // Internal helper methods
     bool configureSPI();
@@ -178,18 +204,22 @@ private:
     void handleDataEvent(const std::string& peer_id, const std::vector<uint8_t>& data);
     void handleDiscoveryEvent(const std::vector<std::string>& peer_list);
 
-    // SPI configuration for FGH100M-H module
-    static const int SPI_HOST = 1;
-    static const int SPI_CLOCK_SPEED = 1000000; // 1 MHz
-    static const int SPI_MODE = 0;
-
-    // XIAO ESP32 pin assignments (from configuration file)
-    static const int PIN_MOSI = get_spi_mosi_pin();
-    static const int PIN_MISO = get_spi_miso_pin();
-    static const int PIN_SCLK = get_spi_sclk_pin();
-    static const int PIN_CS = get_spi_cs_pin();
-    static const int PIN_RESET = get_spi_reset_pin();
-    static const int PIN_INT = get_spi_int_pin();
+    // Link frames carried over the SPI transport
+    bool sendLinkFrame(uint8_t kind, const std::string& peer_id, const std::vector<uint8_t>& data);
+    void handleTransportFrame(const uint8_t* frame, size_t length);
+
+    // Link frame kinds: [kind][peer_id_len][peer_id...][payload...]
+    static const uint8_t LINK_FRAME_UNICAST = 0x01;
+    static const uint8_t LINK_FRAME_BROADCAST = 0x02;
+    static const size_t LINK_FRAME_HEADER_SIZE = 2;
+
+    // FGH100M-H pins of the board (board_profile.h)
+    static constexpr int PIN_MOSI = Board::pin_halow_mosi;
+    static constexpr int PIN_MISO = Board::pin_halow_miso;
+    static constexpr int PIN_SCLK = Board::pin_halow_sclk;
+    static constexpr int PIN_CS = Board::pin_halow_cs;
+    static constexpr int PIN_RESET = Board::pin_halow_reset;
+    static constexpr int PIN_INT = Board::pin_halow_int;
 };
 
 /**
@@ -49,8 +49,8 @@ public:
     std::string sendRawCommand(const std::string& command, const std::vector<std::string>& params) override;
 
 private:
-    // MM-IoT-SDK instance
-    std::unique_ptr<MMIoTSDK> m_mmSDK;
+    // MM-IoT-SDK singleton (owns the SPI transport to the module)
+    MMIoTSDK* m_mmSDK;
 
     // Configuration
     HaLowConfig m_config;
@@ -65,10 +65,16 @@ private:
     bool m_initialized;
     bool m_discovering;
 
+    // Registrations with the SDK's listener tables
+    DelegateHandle m_connectionHandle;
+    DelegateHandle m_dataHandle;
+    DelegateHandle m_discoveryHandle;
+
     // Callback handlers
     void handleConnectionEvent(const std::string& peer_id, bool connected);
     void handleDataEvent(const std::string& peer_id, const std::vector<uint8_t>& data);
     void handleDiscoveryEvent(const std::vector<std::string>& peer_list);
+    void removeSdkListeners();
 
     // Helper methods
     HaLowPeerInfo convertPeerInfo(const std::string& peer_id) const;
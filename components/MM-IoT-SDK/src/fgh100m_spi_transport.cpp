@@ -0,0 +1,597 @@
+/**
+ * @file fgh100m_spi_transport.cpp
+ * @brief Pipelined SPI DMA transport for the FGH100M-H HaLow module
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "fgh100m_spi_transport.h"
+#include "xiao_esp32_config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include <cstring>
+
+static const char* TAG = "FGH100M_SPI";
+
+// Transport task notification bits
+#define NOTIFY_TX_PENDING   (1u << 0)
+#define NOTIFY_TRANS_DONE   (1u << 1)
+#define NOTIFY_RX_READY     (1u << 2)
+#define NOTIFY_STOP         (1u << 3)
+
+// Mutex timeout for the TX fill buffer; frames are dropped rather than blocking the caller
+#define TX_MUTEX_TIMEOUT pdMS_TO_TICKS(10)
+
+// Time allowed for in-flight transactions and the task to finish on shutdown
+#define STOP_POLL_MS 10
+#define STOP_TIMEOUT_MS FGH100M_SPI_TIMEOUT
+
+// A board's DMA buffers must hold at least one full 1500-byte link frame
+static_assert(Board::halow_spi_buffer >= FGH100M_HEADER_SIZE + FGH100M_FRAME_PREFIX_SIZE + 1500,
+              "Board::halow_spi_buffer is smaller than one link frame");
+
+Fgh100mSpiTransport::Fgh100mSpiTransport()
+    : m_config(defaultConfig())
+    , m_device(nullptr)
+    , m_busInitialized(false)
+    , m_task(NULL)
+    , m_stopRequested(false)
+    , m_taskExited(true)
+    , m_txMutex(NULL)
+    , m_fillIndex(0)
+    , m_busIndex(-1)
+    , m_rxBuffer(nullptr)
+    , m_rxCmd(nullptr)
+    , m_rxState(RX_IDLE) {
+    memset(m_tx, 0, sizeof(m_tx));
+    memset(&m_txTrans, 0, sizeof(m_txTrans));
+    memset(&m_rxTrans, 0, sizeof(m_rxTrans));
+    resetStats();
+}
+
+Fgh100mSpiTransport::~Fgh100mSpiTransport() {
+    end();
+}
+
+Fgh100mTransportConfig Fgh100mSpiTransport::defaultConfig() {
+    Fgh100mTransportConfig config = {};
+    config.host = static_cast<spi_host_device_t>(Board::halow_spi_host);
+    config.pin_mosi = Board::pin_halow_mosi;
+    config.pin_miso = Board::pin_halow_miso;
+    config.pin_sclk = Board::pin_halow_sclk;
+    config.pin_cs = Board::pin_halow_cs;
+    config.pin_int = Board::pin_halow_int;
+    config.clock_speed_hz = FGH100M_SPI_CLOCK_SPEED;
+    config.spi_mode = FGH100M_SPI_MODE;
+    config.buffer_size = Board::halow_spi_buffer;
+    config.batch_window_us = 0;
+    config.task_stack_size = 4096;
+    config.task_priority = 6;   // Above network tasks so the bus never starves
+    config.task_core = 0;
+    return config;
+}
+
+esp_err_t Fgh100mSpiTransport::begin(const Fgh100mTransportConfig& config) {
+    if (isRunning()) {
+        return ESP_OK;
+    }
+
+    if (config.buffer_size <= FGH100M_HEADER_SIZE + FGH100M_FRAME_PREFIX_SIZE ||
+        config.buffer_size > 0xFFFF) {
+        ESP_LOGE(TAG, "Invalid buffer size: %d", (int)config.buffer_size);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    m_config = config;
+
+    // DMA-capable buffers: two for TX double buffering, one for RX
+    for (int i = 0; i < 2; i++) {
+        m_tx[i].data = static_cast<uint8_t*>(heap_caps_malloc(config.buffer_size, MALLOC_CAP_DMA));
+        resetTxBuffer(m_tx[i]);
+    }
+    m_rxBuffer = static_cast<uint8_t*>(heap_caps_malloc(config.buffer_size, MALLOC_CAP_DMA));
+    // Full-duplex reads clock out as many bytes as they read, so the command
+    // buffer spans a whole batch and stays zero past the header
+    m_rxCmd = static_cast<uint8_t*>(heap_caps_calloc(1, config.buffer_size, MALLOC_CAP_DMA));
+    m_txMutex = xSemaphoreCreateMutex();
+
+    if (!m_tx[0].data || !m_tx[1].data || !m_rxBuffer || !m_rxCmd || !m_txMutex) {
+        ESP_LOGE(TAG, "Failed to allocate DMA buffers");
+        end();
+        return ESP_ERR_NO_MEM;
+    }
+
+    m_fillIndex = 0;
+    m_busIndex = -1;
+    m_rxState = RX_IDLE;
+
+    spi_bus_config_t buscfg = {};
+    buscfg.mosi_io_num = config.pin_mosi;
+    buscfg.miso_io_num = config.pin_miso;
+    buscfg.sclk_io_num = config.pin_sclk;
+    buscfg.quadwp_io_num = -1;
+    buscfg.quadhd_io_num = -1;
+    buscfg.max_transfer_sz = config.buffer_size;
+
+    esp_err_t ret = spi_bus_initialize(config.host, &buscfg,
+                                       static_cast<spi_dma_chan_t>(Board::halow_spi_dma));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize SPI bus: %s", esp_err_to_name(ret));
+        end();
+        return ret;
+    }
+    m_busInitialized = true;
+
+    spi_device_interface_config_t devcfg = {};
+    devcfg.clock_speed_hz = config.clock_speed_hz;
+    devcfg.mode = config.spi_mode;
+    devcfg.spics_io_num = config.pin_cs;
+    devcfg.queue_size = FGH100M_SPI_QUEUE_SIZE;
+    devcfg.pre_cb = nullptr;
+    devcfg.post_cb = onTransactionDone;
+
+    ret = spi_bus_add_device(config.host, &devcfg, &m_device);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add SPI device: %s", esp_err_to_name(ret));
+        m_device = nullptr;
+        end();
+        return ret;
+    }
+
+    m_stopRequested.store(false, std::memory_order_release);
+    m_taskExited.store(false, std::memory_order_release);
+    BaseType_t result = xTaskCreatePinnedToCore(taskEntry, "FGH100M", config.task_stack_size,
+                                                this, config.task_priority, &m_task, config.task_core);
+    if (result != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create transport task");
+        m_task = NULL;
+        m_taskExited.store(true, std::memory_order_release);
+        end();
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The module pulls INT low when it has data for us. The pin may not
+    // reset to an input, so set it up before attaching the handler
+    gpio_config_t int_conf = {};
+    int_conf.pin_bit_mask = 1ULL << config.pin_int;
+    int_conf.mode = GPIO_MODE_INPUT;
+    int_conf.pull_up_en = GPIO_PULLUP_ENABLE;
+    int_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+    int_conf.intr_type = GPIO_INTR_NEGEDGE;
+    ret = gpio_config(&int_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure INT pin %d: %s", config.pin_int, esp_err_to_name(ret));
+        end();
+        return ret;
+    }
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+        end();
+        return ret;
+    }
+    ret = gpio_isr_handler_add(static_cast<gpio_num_t>(config.pin_int), onIntPin, this);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add INT pin handler: %s", esp_err_to_name(ret));
+        end();
+        return ret;
+    }
+
+    // Data may already be pending from before the handler was attached
+    xTaskNotify(m_task, NOTIFY_RX_READY, eSetBits);
+
+    ESP_LOGI(TAG, "SPI transport started: %d Hz, %d byte DMA buffers",
+             config.clock_speed_hz, (int)config.buffer_size);
+    return ESP_OK;
+}
+
+void Fgh100mSpiTransport::end() {
+    if (m_task) {
+        gpio_isr_handler_remove(static_cast<gpio_num_t>(m_config.pin_int));
+        m_stopRequested.store(true, std::memory_order_release);
+        xTaskNotify(m_task, NOTIFY_STOP, eSetBits);
+
+        int waited_ms = 0;
+        while (!m_taskExited.load(std::memory_order_acquire) && waited_ms < STOP_TIMEOUT_MS) {
+            vTaskDelay(pdMS_TO_TICKS(STOP_POLL_MS));
+            waited_ms += STOP_POLL_MS;
+        }
+        if (!m_taskExited.load(std::memory_order_acquire)) {
+            ESP_LOGW(TAG, "Transport task did not exit within %d ms", STOP_TIMEOUT_MS);
+        }
+        m_task = NULL;
+    }
+
+    if (m_device) {
+        spi_bus_remove_device(m_device);
+        m_device = nullptr;
+    }
+    if (m_busInitialized) {
+        spi_bus_free(m_config.host);
+        m_busInitialized = false;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (m_tx[i].data) {
+            heap_caps_free(m_tx[i].data);
+            m_tx[i].data = nullptr;
+        }
+    }
+    if (m_rxBuffer) {
+        heap_caps_free(m_rxBuffer);
+        m_rxBuffer = nullptr;
+    }
+    if (m_rxCmd) {
+        heap_caps_free(m_rxCmd);
+        m_rxCmd = nullptr;
+    }
+    if (m_txMutex) {
+        vSemaphoreDelete(m_txMutex);
+        m_txMutex = NULL;
+    }
+}
+
+size_t Fgh100mSpiTransport::maxFrameSize() const {
+    return m_config.buffer_size - FGH100M_HEADER_SIZE - FGH100M_FRAME_PREFIX_SIZE;
+}
+
+bool Fgh100mSpiTransport::sendFrame(const uint8_t* data, size_t length) {
+    return sendFrame(data, length, nullptr, 0);
+}
+
+bool Fgh100mSpiTransport::sendFrame(const uint8_t* header, size_t header_length,
+                                    const uint8_t* payload, size_t payload_length) {
+    size_t length = header_length + payload_length;
+    if (!isRunning() || length == 0 || length > maxFrameSize() ||
+        (header_length > 0 && !header) || (payload_length > 0 && !payload)) {
+        return false;
+    }
+
+    if (xSemaphoreTake(m_txMutex, TX_MUTEX_TIMEOUT) != pdTRUE) {
+        m_txDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Frames always go into the fill buffer; the other one may be on the bus
+    TxBuffer& buffer = m_tx[m_fillIndex];
+    if (buffer.used + FGH100M_FRAME_PREFIX_SIZE + length > m_config.buffer_size ||
+        buffer.frameCount == 0xFF) {
+        xSemaphoreGive(m_txMutex);
+        m_txDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (buffer.frameCount == 0) {
+        buffer.firstEnqueueUs = now;
+        buffer.state = TX_FILLING;
+    }
+    buffer.enqueueSumUs += now;
+
+    uint8_t* out = buffer.data + buffer.used;
+    out[0] = (uint8_t)(length & 0xFF);
+    out[1] = (uint8_t)(length >> 8);
+    if (header_length > 0) {
+        memcpy(out + FGH100M_FRAME_PREFIX_SIZE, header, header_length);
+    }
+    if (payload_length > 0) {
+        memcpy(out + FGH100M_FRAME_PREFIX_SIZE + header_length, payload, payload_length);
+    }
+    buffer.used += FGH100M_FRAME_PREFIX_SIZE + length;
+    buffer.frameCount++;
+
+    xSemaphoreGive(m_txMutex);
+
+    xTaskNotify(m_task, NOTIFY_TX_PENDING, eSetBits);
+    return true;
+}
+
+void Fgh100mSpiTransport::taskEntry(void* pvParameters) {
+    static_cast<Fgh100mSpiTransport*>(pvParameters)->run();
+}
+
+void IRAM_ATTR Fgh100mSpiTransport::onTransactionDone(spi_transaction_t* trans) {
+    Fgh100mSpiTransport* self = static_cast<Fgh100mSpiTransport*>(trans->user);
+    BaseType_t woken = pdFALSE;
+    if (self && self->m_task) {
+        xTaskNotifyFromISR(self->m_task, NOTIFY_TRANS_DONE, eSetBits, &woken);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void IRAM_ATTR Fgh100mSpiTransport::onIntPin(void* arg) {
+    Fgh100mSpiTransport* self = static_cast<Fgh100mSpiTransport*>(arg);
+    BaseType_t woken = pdFALSE;
+    if (self->m_task) {
+        xTaskNotifyFromISR(self->m_task, NOTIFY_RX_READY, eSetBits, &woken);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void Fgh100mSpiTransport::run() {
+    TickType_t wait = portMAX_DELAY;
+
+    while (!m_stopRequested.load(std::memory_order_acquire)) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, wait);
+
+        if (bits & NOTIFY_TRANS_DONE) {
+            spi_transaction_t* done = nullptr;
+            while (spi_device_get_trans_result(m_device, &done, 0) == ESP_OK) {
+                if (done == &m_txTrans) {
+                    completeTx();
+                } else if (done == &m_rxTrans) {
+                    completeRx();
+                }
+            }
+        }
+
+        // INT is level-low while data is pending, so also re-check it after each read
+        if (m_rxState == RX_IDLE &&
+            ((bits & NOTIFY_RX_READY) || gpio_get_level(static_cast<gpio_num_t>(m_config.pin_int)) == 0)) {
+            startRxStatus();
+        }
+
+        wait = submitTx();
+    }
+
+    // Let in-flight transactions finish before the bus is torn down
+    int waited_ms = 0;
+    while ((m_busIndex >= 0 || m_rxState != RX_IDLE) && waited_ms < STOP_TIMEOUT_MS) {
+        spi_transaction_t* done = nullptr;
+        if (spi_device_get_trans_result(m_device, &done, pdMS_TO_TICKS(STOP_POLL_MS)) == ESP_OK) {
+            if (done == &m_txTrans) {
+                m_busIndex = -1;
+            } else if (done == &m_rxTrans) {
+                m_rxState = RX_IDLE;
+            }
+        } else {
+            waited_ms += STOP_POLL_MS;
+        }
+    }
+
+    m_taskExited.store(true, std::memory_order_release);
+    vTaskDelete(NULL);
+}
+
+TickType_t Fgh100mSpiTransport::submitTx() {
+    if (xSemaphoreTake(m_txMutex, TX_MUTEX_TIMEOUT) != pdTRUE) {
+        return 1;
+    }
+
+    // Double buffering: only one TX buffer is on the bus at a time
+    TxBuffer& buffer = m_tx[m_fillIndex];
+    if (m_busIndex >= 0 || buffer.frameCount == 0) {
+        xSemaphoreGive(m_txMutex);
+        return portMAX_DELAY;
+    }
+
+    // Optionally hold the batch open a little longer to coalesce more frames
+    if (m_config.batch_window_us > 0) {
+        int64_t age = esp_timer_get_time() - buffer.firstEnqueueUs;
+        bool full = buffer.used + FGH100M_FRAME_PREFIX_SIZE >= m_config.buffer_size;
+        if (!full && age < (int64_t)m_config.batch_window_us) {
+            xSemaphoreGive(m_txMutex);
+            TickType_t ticks = pdMS_TO_TICKS((m_config.batch_window_us - age + 999) / 1000);
+            return ticks > 0 ? ticks : 1;
+        }
+    }
+
+    size_t payload = buffer.used - FGH100M_HEADER_SIZE;
+    buffer.data[0] = FGH100M_CMD_WRITE;
+    buffer.data[1] = (uint8_t)buffer.frameCount;
+    buffer.data[2] = (uint8_t)(payload & 0xFF);
+    buffer.data[3] = (uint8_t)(payload >> 8);
+    buffer.state = TX_ON_BUS;
+
+    m_busIndex = m_fillIndex;
+    m_fillIndex = 1 - m_fillIndex;
+    xSemaphoreGive(m_txMutex);
+
+    memset(&m_txTrans, 0, sizeof(m_txTrans));
+    m_txTrans.length = buffer.used * 8;
+    m_txTrans.tx_buffer = buffer.data;
+    m_txTrans.rx_buffer = nullptr;
+    m_txTrans.user = this;
+
+    esp_err_t ret = spi_device_queue_trans(m_device, &m_txTrans, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to queue TX transaction: %s", esp_err_to_name(ret));
+        m_txDropped.fetch_add(buffer.frameCount, std::memory_order_relaxed);
+        xSemaphoreTake(m_txMutex, portMAX_DELAY);
+        resetTxBuffer(buffer);
+        m_busIndex = -1;
+        xSemaphoreGive(m_txMutex);
+    }
+
+    return portMAX_DELAY;
+}
+
+void Fgh100mSpiTransport::completeTx() {
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(m_txMutex, portMAX_DELAY);
+    if (m_busIndex >= 0) {
+        TxBuffer& buffer = m_tx[m_busIndex];
+        recordLatency(buffer, now);
+        m_txFrames.fetch_add(buffer.frameCount, std::memory_order_relaxed);
+        m_txBatches.fetch_add(1, std::memory_order_relaxed);
+        m_txBytes.fetch_add(buffer.used - FGH100M_HEADER_SIZE - buffer.frameCount * FGH100M_FRAME_PREFIX_SIZE,
+                            std::memory_order_relaxed);
+        resetTxBuffer(buffer);
+        m_busIndex = -1;
+    }
+    xSemaphoreGive(m_txMutex);
+}
+
+void Fgh100mSpiTransport::startRxStatus() {
+    m_rxCmd[0] = FGH100M_CMD_STATUS;
+    m_rxCmd[1] = 0;
+    m_rxCmd[2] = 0;
+    m_rxCmd[3] = 0;
+
+    memset(&m_rxTrans, 0, sizeof(m_rxTrans));
+    m_rxTrans.length = FGH100M_HEADER_SIZE * 8;
+    m_rxTrans.tx_buffer = m_rxCmd;
+    m_rxTrans.rx_buffer = m_rxBuffer;
+    m_rxTrans.user = this;
+
+    if (spi_device_queue_trans(m_device, &m_rxTrans, 0) == ESP_OK) {
+        m_rxState = RX_STATUS;
+    } else {
+        ESP_LOGE(TAG, "Failed to queue RX status transaction");
+    }
+}
+
+void Fgh100mSpiTransport::startRxRead(size_t length) {
+    m_rxCmd[0] = FGH100M_CMD_READ;
+    m_rxCmd[1] = 0;
+    m_rxCmd[2] = (uint8_t)(length & 0xFF);
+    m_rxCmd[3] = (uint8_t)(length >> 8);
+
+    // The module shifts out the batch header while it clocks in our command,
+    // so the whole read is header plus payload in a single transaction
+    memset(&m_rxTrans, 0, sizeof(m_rxTrans));
+    m_rxTrans.length = (FGH100M_HEADER_SIZE + length) * 8;
+    m_rxTrans.tx_buffer = m_rxCmd;
+    m_rxTrans.rxlength = m_rxTrans.length;
+    m_rxTrans.rx_buffer = m_rxBuffer;
+    m_rxTrans.user = this;
+
+    if (spi_device_queue_trans(m_device, &m_rxTrans, 0) == ESP_OK) {
+        m_rxState = RX_READ;
+    } else {
+        ESP_LOGE(TAG, "Failed to queue RX read transaction");
+        m_rxState = RX_IDLE;
+    }
+}
+
+void Fgh100mSpiTransport::completeRx() {
+    if (m_rxState == RX_STATUS) {
+        // Status reply: [status][frame_count][len_lo][len_hi]
+        size_t pending = (size_t)m_rxBuffer[2] | ((size_t)m_rxBuffer[3] << 8);
+        m_rxState = RX_IDLE;
+        if (pending == 0) {
+            return;
+        }
+        if (pending + FGH100M_HEADER_SIZE > m_config.buffer_size) {
+            ESP_LOGW(TAG, "Module reports %d pending bytes, larger than RX buffer", (int)pending);
+            m_rxErrors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        startRxRead(pending);
+        return;
+    }
+
+    if (m_rxState == RX_READ) {
+        size_t length = m_rxTrans.length / 8;
+        m_rxState = RX_IDLE;
+        deliverRxBatch(m_rxBuffer, length);
+
+        // More data may have arrived while we were reading
+        if (gpio_get_level(static_cast<gpio_num_t>(m_config.pin_int)) == 0) {
+            startRxStatus();
+        }
+    }
+}
+
+void Fgh100mSpiTransport::deliverRxBatch(const uint8_t* batch, size_t length) {
+    if (length < FGH100M_HEADER_SIZE) {
+        m_rxErrors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint8_t frame_count = batch[1];
+    size_t payload = (size_t)batch[2] | ((size_t)batch[3] << 8);
+    if (payload + FGH100M_HEADER_SIZE > length) {
+        m_rxErrors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_rxBatches.fetch_add(1, std::memory_order_relaxed);
+
+    size_t offset = FGH100M_HEADER_SIZE;
+    size_t end = FGH100M_HEADER_SIZE + payload;
+    for (uint8_t i = 0; i < frame_count; i++) {
+        if (offset + FGH100M_FRAME_PREFIX_SIZE > end) {
+            m_rxErrors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        size_t frame_len = (size_t)batch[offset] | ((size_t)batch[offset + 1] << 8);
+        offset += FGH100M_FRAME_PREFIX_SIZE;
+        if (offset + frame_len > end) {
+            m_rxErrors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_rxFrames.fetch_add(1, std::memory_order_relaxed);
+        m_rxBytes.fetch_add(frame_len, std::memory_order_relaxed);
+        if (m_rxHandler.isSet()) {
+            m_rxHandler(batch + offset, frame_len);
+        }
+        offset += frame_len;
+    }
+}
+
+void Fgh100mSpiTransport::recordLatency(const TxBuffer& buffer, int64_t now) {
+    if (buffer.frameCount == 0) {
+        return;
+    }
+
+    // Sum over frames of (now - enqueue) without storing per-frame timestamps
+    int64_t total = now * buffer.frameCount - buffer.enqueueSumUs;
+    if (total > 0) {
+        m_latencySumUs.fetch_add((uint64_t)total, std::memory_order_relaxed);
+    }
+
+    int64_t worst = now - buffer.firstEnqueueUs;
+    uint32_t worst_us = worst > 0 ? (uint32_t)worst : 0;
+    uint32_t max_us = m_maxLatencyUs.load(std::memory_order_relaxed);
+    while (worst_us > max_us &&
+           !m_maxLatencyUs.compare_exchange_weak(max_us, worst_us, std::memory_order_relaxed)) {
+    }
+}
+
+void Fgh100mSpiTransport::resetTxBuffer(TxBuffer& buffer) {
+    buffer.used = FGH100M_HEADER_SIZE;
+    buffer.frameCount = 0;
+    buffer.state = TX_IDLE;
+    buffer.firstEnqueueUs = 0;
+    buffer.enqueueSumUs = 0;
+}
+
+Fgh100mTransportStats Fgh100mSpiTransport::getStats() const {
+    Fgh100mTransportStats stats = {};
+    stats.tx_frames = m_txFrames.load(std::memory_order_relaxed);
+    stats.tx_batches = m_txBatches.load(std::memory_order_relaxed);
+    stats.tx_bytes = m_txBytes.load(std::memory_order_relaxed);
+    stats.tx_dropped = m_txDropped.load(std::memory_order_relaxed);
+    stats.rx_frames = m_rxFrames.load(std::memory_order_relaxed);
+    stats.rx_batches = m_rxBatches.load(std::memory_order_relaxed);
+    stats.rx_bytes = m_rxBytes.load(std::memory_order_relaxed);
+    stats.rx_errors = m_rxErrors.load(std::memory_order_relaxed);
+    stats.max_frame_latency_us = m_maxLatencyUs.load(std::memory_order_relaxed);
+    uint64_t sum = m_latencySumUs.load(std::memory_order_relaxed);
+    stats.avg_frame_latency_us = stats.tx_frames > 0 ? (uint32_t)(sum / stats.tx_frames) : 0;
+    return stats;
+}
+
+void Fgh100mSpiTransport::resetStats() {
+    m_txFrames.store(0, std::memory_order_relaxed);
+    m_txBatches.store(0, std::memory_order_relaxed);
+    m_txBytes.store(0, std::memory_order_relaxed);
+    m_txDropped.store(0, std::memory_order_relaxed);
+    m_rxFrames.store(0, std::memory_order_relaxed);
+    m_rxBatches.store(0, std::memory_order_relaxed);
+    m_rxBytes.store(0, std::memory_order_relaxed);
+    m_rxErrors.store(0, std::memory_order_relaxed);
+    m_latencySumUs.store(0, std::memory_order_relaxed);
+    m_maxLatencyUs.store(0, std::memory_order_relaxed);
+}
@@ -91,6 +91,8 @@ void MMIoTSDK::deinitialize() {
 
     stopDiscovery();
 
+    m_transport.end();
+
     // TODO: Deinitialize MM-IoT-SDK
     // if (m_handle) {
     //     mm_deinitialize(m_handle);
@@ -152,9 +154,7 @@ bool MMIoTSDK::connectToPeer(const std::string& peer_id) {
 
     // Simulate connection for development
     m_connected = true;
-    if (m_connectionCallback) {
-        m_connectionCallback(peer_id, true);
-    }
+    m_connectionListeners.invokeAll(peer_id, true);
 
     return true;
 }
@@ -172,9 +172,7 @@ bool MMIoTSDK::disconnectFromPeer(const std::string& peer_id) {
 
     // Simulate disconnection for development
     m_connected = false;
-    if (m_connectionCallback) {
-        m_connectionCallback(peer_id, false);
-    }
+    m_connectionListeners.invokeAll(peer_id, false);
 
     return true;
 }
@@ -185,13 +183,9 @@ bool MMIoTSDK::sendData(const std::string& peer_id, const std::vector<uint8_t>&
         return false;
     }
 
-    ESP_LOGI(TAG, "Sending %zu bytes to peer: %s", data.size(), peer_id.c_str());
+    ESP_LOGD(TAG, "Sending %zu bytes to peer: %s", data.size(), peer_id.c_str());
 
-    // TODO: Send data to peer with MM-IoT-SDK
-    // return mm_send_data(m_handle, peer_id.c_str(), data.data(), data.size()) == MM_OK;
-
-    // Simulate successful send for development
-    return true;
+    return sendLinkFrame(LINK_FRAME_UNICAST, peer_id, data);
 }
 
 bool MMIoTSDK::broadcastData(const std::vector<uint8_t>& data) {
@@ -200,15 +194,52 @@ bool MMIoTSDK::broadcastData(const std::vector<uint8_t>& data) {
         return false;
     }
 
-    ESP_LOGI(TAG, "Broadcasting %zu bytes to all peers", data.size());
+    ESP_LOGD(TAG, "Broadcasting %zu bytes to all peers", data.size());
 
-    // TODO: Broadcast data with MM-IoT-SDK
-    // return mm_broadcast_data(m_handle, data.data(), data.size()) == MM_OK;
+    return sendLinkFrame(LINK_FRAME_BROADCAST, std::string(), data);
+}
 
-    // Simulate successful broadcast for development
+bool MMIoTSDK::sendLinkFrame(uint8_t kind, const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (peer_id.size() > 0xFF) {
+        ESP_LOGE(TAG, "Peer ID too long: %zu", peer_id.size());
+        return false;
+    }
+
+    size_t frame_size = LINK_FRAME_HEADER_SIZE + peer_id.size() + data.size();
+    if (frame_size > m_transport.maxFrameSize()) {
+        ESP_LOGE(TAG, "Frame too large for SPI transport: %zu bytes", frame_size);
+        return false;
+    }
+
+    // Only the small link header is built here; the payload is copied once,
+    // straight into the transport's DMA buffer
+    uint8_t header[LINK_FRAME_HEADER_SIZE + 0xFF];
+    header[0] = kind;
+    header[1] = (uint8_t)peer_id.size();
+    memcpy(header + LINK_FRAME_HEADER_SIZE, peer_id.data(), peer_id.size());
+
+    if (!m_transport.sendFrame(header, LINK_FRAME_HEADER_SIZE + peer_id.size(),
+                               data.data(), data.size())) {
+        ESP_LOGW(TAG, "SPI transport busy, frame dropped (%zu bytes)", frame_size);
+        return false;
+    }
     return true;
 }
 
+void MMIoTSDK::handleTransportFrame(const uint8_t* frame, size_t length) {
+    if (length < LINK_FRAME_HEADER_SIZE || LINK_FRAME_HEADER_SIZE + frame[1] > length) {
+        ESP_LOGW(TAG, "Malformed link frame (%zu bytes)", length);
+        return;
+    }
+
+    size_t peer_len = frame[1];
+    std::string peer_id(reinterpret_cast<const char*>(frame + LINK_FRAME_HEADER_SIZE), peer_len);
+    const uint8_t* payload = frame + LINK_FRAME_HEADER_SIZE + peer_len;
+    std::vector<uint8_t> data(payload, frame + length);
+
+    handleDataEvent(peer_id, data);
+}
+
 std::vector<std::string> MMIoTSDK::getDiscoveredPeers() {
     std::vector<std::string> peers;
 
@@ -246,26 +277,56 @@ std::vector<std::string> MMIoTSDK::getConnectedPeers() {
     return peers;
 }
 
-mm_network_info_t MMIoTSDK::getNetworkInfo() {
+MMIoTNetworkInfo MMIoTSDK::getNetworkInfo() {
     // TODO: Get network info from MM-IoT-SDK
     // return mm_get_network_info(m_handle);
 
     // Return mock data for development
-    static mm_network_info_t info;
-    // Initialize with default values
+    MMIoTNetworkInfo info;
+    info.network_id = m_ssid;
+    info.device_id = "";
+    info.channel = 0;
+    info.bandwidth = 0;
+    info.rssi = 0;
+    info.connected_peers = m_initialized ? getConnectedPeers().size() : 0;
+    info.mesh_enabled = true;
     return info;
 }
 
-void MMIoTSDK::setConnectionCallback(ConnectionCallback callback) {
-    m_connectionCallback = callback;
+DelegateHandle MMIoTSDK::addConnectionListener(const ConnectionDelegate& listener) {
+    DelegateHandle handle = m_connectionListeners.add(listener);
+    if (!handle.isValid()) {
+        ESP_LOGE(TAG, "Connection listener table full");
+    }
+    return handle;
+}
+
+DelegateHandle MMIoTSDK::addDataListener(const DataDelegate& listener) {
+    DelegateHandle handle = m_dataListeners.add(listener);
+    if (!handle.isValid()) {
+        ESP_LOGE(TAG, "Data listener table full");
+    }
+    return handle;
 }
 
-void MMIoTSDK::setDataCallback(DataCallback callback) {
-    m_dataCallback = callback;
+DelegateHandle MMIoTSDK::addDiscoveryListener(const DiscoveryDelegate& listener) {
+    DelegateHandle handle = m_discoveryListeners.add(listener);
+    if (!handle.isValid()) {
+        ESP_LOGE(TAG, "Discovery listener table full");
+    }
+    return handle;
 }
 
-void MMIoTSDK::setDiscoveryCallback(DiscoveryCallback callback) {
-    m_discoveryCallback = callback;
+bool MMIoTSDK::removeConnectionListener(DelegateHandle handle) {
+    return m_connectionListeners.remove(handle);
+}
+
+bool MMIoTSDK::removeDataListener(DelegateHandle handle) {
+    return m_dataListeners.remove(handle);
+}
+
+bool MMIoTSDK::removeDiscoveryListener(DelegateHandle handle) {
+    return m_discoveryListeners.remove(handle);
 }
 
 // Private helper methods
@@ -301,39 +362,22 @@ esp_err_t MMIoTSDK::initializeHardware() {
 }
 
 bool MMIoTSDK::configureSPI() {
-    spi_bus_config_t buscfg = {};
-    buscfg.mosi_io_num = PIN_MOSI;
-    buscfg.miso_io_num = PIN_MISO;
-    buscfg.sclk_io_num = PIN_SCLK;
-    buscfg.quadwp_io_num = -1;
-    buscfg.quadhd_io_num = -1;
-    buscfg.max_transfer_sz = 4096;
-
-    esp_err_t ret = spi_bus_initialize(static_cast<spi_host_device_t>(SPI_HOST), &buscfg, SPI_DMA_CH_AUTO);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize SPI bus: %s", esp_err_to_name(ret));
-        return false;
-    }
+    Fgh100mTransportConfig config = Fgh100mSpiTransport::defaultConfig();
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_sclk = PIN_SCLK;
+    config.pin_cs = PIN_CS;
+    config.pin_int = PIN_INT;
+
+    m_transport.setRxHandler(
+        Fgh100mRxHandler::fromMethod<MMIoTSDK, &MMIoTSDK::handleTransportFrame>(this));
 
-    // Configure SPI device
-    spi_device_interface_config_t devcfg = {};
-    devcfg.clock_speed_hz = SPI_CLOCK_SPEED;
-    devcfg.mode = SPI_MODE;
-    devcfg.spics_io_num = PIN_CS;
-    devcfg.queue_size = 7;
-    devcfg.pre_cb = nullptr;
-    devcfg.post_cb = nullptr;
-
-    spi_device_handle_t spi_handle;
-    ret = spi_bus_add_device(static_cast<spi_host_device_t>(SPI_HOST), &devcfg, &spi_handle);
+    esp_err_t ret = m_transport.begin(config);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to add SPI device: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to start SPI transport: %s", esp_err_to_name(ret));
         return false;
     }
 
-    // TODO: Store spi_handle for later use
-    // m_spi_handle = spi_handle;
-
     return true;
 }
 
@@ -349,21 +393,15 @@ bool MMIoTSDK::configurePins() {
 }
 
 void MMIoTSDK::handleConnectionEvent(const std::string& peer_id, bool connected) {
-    if (m_connectionCallback) {
-        m_connectionCallback(peer_id, connected);
-    }
+    m_connectionListeners.invokeAll(peer_id, connected);
 }
 
 void MMIoTSDK::handleDataEvent(const std::string& peer_id, const std::vector<uint8_t>& data) {
-    if (m_dataCallback) {
-        m_dataCallback(peer_id, data);
-    }
+    m_dataListeners.invokeAll(peer_id, data);
 }
 
 void MMIoTSDK::handleDiscoveryEvent(const std::vector<std::string>& peer_list) {
-    if (m_discoveryCallback) {
-        m_discoveryCallback(peer_list);
-    }
+    m_discoveryListeners.invokeAll(peer_list);
 }
 
 // Board-specific implementations can be added here as needed
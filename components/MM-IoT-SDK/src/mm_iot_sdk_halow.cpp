@@ -0,0 +1,237 @@
+/**
+ * @file mm_iot_sdk_halow.cpp
+ * @brief MM-IoT-SDK implementation of IHaLow interface
+ *
+ * @author AirCom Development Team
+ * @version 2.0.0
+ * @date 2024
+ */
+
+#include "mm_iot_sdk_halow.h"
+#include "esp_log.h"
+
+static const char* TAG = "MM_IOT_HALOW";
+
+MMIoTSDKHaLow::MMIoTSDKHaLow()
+    : m_mmSDK(&MMIoTSDK::getInstance())
+    , m_initialized(false)
+    , m_discovering(false) {
+}
+
+MMIoTSDKHaLow::~MMIoTSDKHaLow() {
+    deinitialize();
+}
+
+bool MMIoTSDKHaLow::initialize(const HaLowConfig& config) {
+    if (m_initialized) {
+        return true;
+    }
+
+    if (!validateConfig(config)) {
+        ESP_LOGE(TAG, "Invalid HaLow configuration");
+        return false;
+    }
+    m_config = config;
+
+    // Route SDK events through this adapter before the radio comes up
+    m_connectionHandle = m_mmSDK->addConnectionListener(
+        ConnectionDelegate::fromMethod<MMIoTSDKHaLow, &MMIoTSDKHaLow::handleConnectionEvent>(this));
+    m_dataHandle = m_mmSDK->addDataListener(
+        DataDelegate::fromMethod<MMIoTSDKHaLow, &MMIoTSDKHaLow::handleDataEvent>(this));
+    m_discoveryHandle = m_mmSDK->addDiscoveryListener(
+        DiscoveryDelegate::fromMethod<MMIoTSDKHaLow, &MMIoTSDKHaLow::handleDiscoveryEvent>(this));
+
+    if (!m_connectionHandle.isValid() || !m_dataHandle.isValid() || !m_discoveryHandle.isValid() ||
+        !m_mmSDK->initialize(config.ssid, config.password, config.country_code)) {
+        removeSdkListeners();
+        return false;
+    }
+
+    m_initialized = true;
+    return true;
+}
+
+void MMIoTSDKHaLow::deinitialize() {
+    if (!m_initialized) {
+        return;
+    }
+
+    removeSdkListeners();
+    m_mmSDK->deinitialize();
+
+    m_initialized = false;
+    m_discovering = false;
+}
+
+bool MMIoTSDKHaLow::startDiscovery() {
+    if (!m_initialized) {
+        return false;
+    }
+    m_discovering = m_mmSDK->startDiscovery();
+    return m_discovering;
+}
+
+void MMIoTSDKHaLow::stopDiscovery() {
+    if (!m_initialized) {
+        return;
+    }
+    m_mmSDK->stopDiscovery();
+    m_discovering = false;
+}
+
+bool MMIoTSDKHaLow::connectToPeer(const std::string& peer_id) {
+    return m_initialized && m_mmSDK->connectToPeer(peer_id);
+}
+
+bool MMIoTSDKHaLow::disconnectFromPeer(const std::string& peer_id) {
+    return m_initialized && m_mmSDK->disconnectFromPeer(peer_id);
+}
+
+bool MMIoTSDKHaLow::sendData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    return m_initialized && m_mmSDK->sendData(peer_id, data);
+}
+
+bool MMIoTSDKHaLow::broadcastData(const std::vector<uint8_t>& data) {
+    return m_initialized && m_mmSDK->broadcastData(data);
+}
+
+std::vector<HaLowPeerInfo> MMIoTSDKHaLow::getDiscoveredPeers() {
+    std::vector<HaLowPeerInfo> peers;
+    if (!m_initialized) {
+        return peers;
+    }
+    for (const std::string& peer_id : m_mmSDK->getDiscoveredPeers()) {
+        peers.push_back(convertPeerInfo(peer_id));
+    }
+    return peers;
+}
+
+std::vector<HaLowPeerInfo> MMIoTSDKHaLow::getConnectedPeers() {
+    std::vector<HaLowPeerInfo> peers;
+    if (!m_initialized) {
+        return peers;
+    }
+    for (const std::string& peer_id : m_mmSDK->getConnectedPeers()) {
+        HaLowPeerInfo info = convertPeerInfo(peer_id);
+        info.is_connected = true;
+        peers.push_back(info);
+    }
+    return peers;
+}
+
+HaLowNetworkInfo MMIoTSDKHaLow::getNetworkInfo() {
+    return convertNetworkInfo();
+}
+
+void MMIoTSDKHaLow::setConnectionCallback(ConnectionCallback callback) {
+    m_connectionCallback = callback;
+}
+
+void MMIoTSDKHaLow::setDataCallback(DataCallback callback) {
+    m_dataCallback = callback;
+}
+
+void MMIoTSDKHaLow::setDiscoveryCallback(DiscoveryCallback callback) {
+    m_discoveryCallback = callback;
+}
+
+void MMIoTSDKHaLow::setEventCallback(EventCallback callback) {
+    m_eventCallback = callback;
+}
+
+std::string MMIoTSDKHaLow::getImplementationName() const {
+    return "MM-IoT-SDK";
+}
+
+std::vector<std::string> MMIoTSDKHaLow::getSupportedHardware() const {
+    return {"XIAO_ESP32S3", "XIAO_ESP32C3", "XIAO_ESP32C6"};
+}
+
+bool MMIoTSDKHaLow::isInitialized() const {
+    return m_initialized && m_mmSDK->isInitialized();
+}
+
+bool MMIoTSDKHaLow::isConnected() const {
+    return m_initialized && m_mmSDK->isConnected();
+}
+
+std::string MMIoTSDKHaLow::getVersion() const {
+    return "2.0.0";
+}
+
+std::string MMIoTSDKHaLow::sendRawCommand(const std::string& command, const std::vector<std::string>& params) {
+    if (command == "transport_stats") {
+        Fgh100mTransportStats stats = m_mmSDK->getTransportStats();
+        return "tx_frames=" + std::to_string(stats.tx_frames) +
+               " rx_frames=" + std::to_string(stats.rx_frames);
+    }
+    if (command == "set_link_rate") {
+        // The SDK build in this tree has no per-station rate control; the
+        // module firmware's own rate control stays in charge
+        return HALOW_RESULT_UNSUPPORTED ": set_link_rate needs the MM-IoT-SDK rate control API";
+    }
+    if (command == "set_power_save") {
+        // The SDK build in this tree has no TWT or power save API, so the
+        // module stays awake whatever the power policy asks for
+        return HALOW_RESULT_UNSUPPORTED ": set_power_save needs the MM-IoT-SDK TWT API";
+    }
+    return "ERROR: unknown command " + command;
+}
+
+void MMIoTSDKHaLow::handleConnectionEvent(const std::string& peer_id, bool connected) {
+    if (m_connectionCallback) {
+        m_connectionCallback(peer_id, connected);
+    }
+}
+
+void MMIoTSDKHaLow::handleDataEvent(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (m_dataCallback) {
+        m_dataCallback(peer_id, data);
+    }
+}
+
+void MMIoTSDKHaLow::handleDiscoveryEvent(const std::vector<std::string>& peer_list) {
+    if (m_discoveryCallback) {
+        m_discoveryCallback(peer_list);
+    }
+}
+
+void MMIoTSDKHaLow::removeSdkListeners() {
+    // Stale or invalid handles are ignored by the SDK's tables
+    m_mmSDK->removeConnectionListener(m_connectionHandle);
+    m_mmSDK->removeDataListener(m_dataHandle);
+    m_mmSDK->removeDiscoveryListener(m_discoveryHandle);
+    m_connectionHandle = DelegateHandle();
+    m_dataHandle = DelegateHandle();
+    m_discoveryHandle = DelegateHandle();
+}
+
+HaLowPeerInfo MMIoTSDKHaLow::convertPeerInfo(const std::string& peer_id) const {
+    HaLowPeerInfo info;
+    info.peer_id = peer_id;
+    info.rssi = 0;
+    info.connection_time = 0;
+    info.is_connected = false;
+    info.device_type = "MM-IoT-SDK";
+    return info;
+}
+
+HaLowNetworkInfo MMIoTSDKHaLow::convertNetworkInfo() const {
+    MMIoTNetworkInfo sdkInfo = m_mmSDK->getNetworkInfo();
+
+    HaLowNetworkInfo info;
+    info.network_id = sdkInfo.network_id.empty() ? m_config.ssid : sdkInfo.network_id;
+    info.device_id = sdkInfo.device_id;
+    info.channel = sdkInfo.channel ? sdkInfo.channel : m_config.channel;
+    info.bandwidth = sdkInfo.bandwidth ? sdkInfo.bandwidth : m_config.bandwidth;
+    info.rssi = sdkInfo.rssi;
+    info.connected_peers = sdkInfo.connected_peers;
+    info.mesh_enabled = m_config.enable_mesh;
+    info.sdk_version = getVersion();
+    info.hardware_type = "FGH100M-H";
+    return info;
+}
+
+bool MMIoTSDKHaLow::validateConfig(const HaLowConfig& config) const {
+    return !config.ssid.empty() && config.country_code.size() == 2;
+}
@@ -1,7 +1,9 @@
 #include "audio_codec.h"
+#include "metrics_registry.h"
 #include "opus.h"
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include <esp_log.h>
 #include <esp_timer.h>
 
@@ -13,7 +15,6 @@ static const char* TAG = "AUDIO_CODEC";
 
 static bool g_initialized = false;
 static audio_codec_config_t g_config = {0};
-static audio_codec_stats_t g_stats = {0};
 static OpusEncoder* g_encoder = NULL;
 static OpusDecoder* g_decoder = NULL;
 static audio_codec_type_t g_current_type = AUDIO_CODEC_TYPE_AUTO;
@@ -99,31 +100,21 @@ static void update_stats(bool is_encode, uint32_t processing_time_us,
                         size_t input_size, size_t output_size, bool success) {
     if (is_encode) {
         if (success) {
-            g_stats.total_encoded_frames++;
-            g_stats.total_bytes_encoded += output_size;
+            metrics_counter_inc(METRIC_AUDIO_ENCODED_FRAMES);
+            metrics_counter_add(METRIC_AUDIO_PCM_BYTES_IN, (uint32_t)input_size);
+            metrics_counter_add(METRIC_AUDIO_BYTES_ENCODED, (uint32_t)output_size);
         } else {
-            g_stats.encode_errors++;
-        }
-        g_stats.avg_encode_time_us = ((g_stats.avg_encode_time_us * (g_stats.total_encoded_frames - 1)) + processing_time_us) / g_stats.total_encoded_frames;
-        if (processing_time_us > g_stats.max_encode_time_us) {
-            g_stats.max_encode_time_us = processing_time_us;
+            metrics_counter_inc(METRIC_AUDIO_ENCODE_ERRORS);
         }
+        metrics_histogram_record(METRIC_AUDIO_ENCODE_TIME_US, processing_time_us);
     } else {
         if (success) {
-            g_stats.total_decoded_frames++;
-            g_stats.total_bytes_decoded += input_size;
+            metrics_counter_inc(METRIC_AUDIO_DECODED_FRAMES);
+            metrics_counter_add(METRIC_AUDIO_BYTES_DECODED, (uint32_t)input_size);
         } else {
-            g_stats.decode_errors++;
-        }
-        g_stats.avg_decode_time_us = ((g_stats.avg_decode_time_us * (g_stats.total_decoded_frames - 1)) + processing_time_us) / g_stats.total_decoded_frames;
-        if (processing_time_us > g_stats.max_decode_time_us) {
-            g_stats.max_decode_time_us = processing_time_us;
+            metrics_counter_inc(METRIC_AUDIO_DECODE_ERRORS);
         }
-    }
-
-    // Update compression ratio for encoding
-    if (is_encode && success && g_stats.total_encoded_frames > 0) {
-        g_stats.avg_compression_ratio = (float)g_stats.total_bytes_encoded / (g_stats.total_encoded_frames * input_size * sizeof(int16_t));
+        metrics_histogram_record(METRIC_AUDIO_DECODE_TIME_US, processing_time_us);
     }
 }
 
@@ -205,7 +196,7 @@ int audio_codec_init(const audio_codec_config_t* config) {
 
     if (result == AUDIO_CODEC_OK) {
         g_initialized = true;
-        memset(&g_stats, 0, sizeof(g_stats));
+        audio_codec_reset_stats();
         ESP_LOGI(TAG, "Audio codec initialized with type: %d", g_current_type);
     }
 
@@ -363,12 +354,41 @@ int audio_codec_get_stats(audio_codec_stats_t* stats) {
         return AUDIO_CODEC_ERROR_INVALID_PARAM;
     }
 
-    memcpy(stats, &g_stats, sizeof(audio_codec_stats_t));
+    metrics_histogram_summary_t encode_time;
+    metrics_histogram_summary_t decode_time;
+    metrics_histogram_get(METRIC_AUDIO_ENCODE_TIME_US, &encode_time);
+    metrics_histogram_get(METRIC_AUDIO_DECODE_TIME_US, &decode_time);
+
+    stats->total_encoded_frames = metrics_counter_get(METRIC_AUDIO_ENCODED_FRAMES);
+    stats->total_decoded_frames = metrics_counter_get(METRIC_AUDIO_DECODED_FRAMES);
+    stats->encode_errors = metrics_counter_get(METRIC_AUDIO_ENCODE_ERRORS);
+    stats->decode_errors = metrics_counter_get(METRIC_AUDIO_DECODE_ERRORS);
+    stats->encode_retries = metrics_counter_get(METRIC_AUDIO_ENCODE_RETRIES);
+    stats->decode_retries = metrics_counter_get(METRIC_AUDIO_DECODE_RETRIES);
+    stats->avg_encode_time_us = encode_time.mean;
+    stats->avg_decode_time_us = decode_time.mean;
+    stats->max_encode_time_us = encode_time.max;
+    stats->max_decode_time_us = decode_time.max;
+    stats->total_bytes_encoded = metrics_counter_get(METRIC_AUDIO_BYTES_ENCODED);
+    stats->total_bytes_decoded = metrics_counter_get(METRIC_AUDIO_BYTES_DECODED);
+
+    uint32_t pcm_bytes = metrics_counter_get(METRIC_AUDIO_PCM_BYTES_IN);
+    stats->avg_compression_ratio = pcm_bytes ? (float)stats->total_bytes_encoded / pcm_bytes : 0.0f;
     return AUDIO_CODEC_OK;
 }
 
 void audio_codec_reset_stats(void) {
-    memset(&g_stats, 0, sizeof(g_stats));
+    metrics_counter_reset(METRIC_AUDIO_ENCODED_FRAMES);
+    metrics_counter_reset(METRIC_AUDIO_DECODED_FRAMES);
+    metrics_counter_reset(METRIC_AUDIO_ENCODE_ERRORS);
+    metrics_counter_reset(METRIC_AUDIO_DECODE_ERRORS);
+    metrics_counter_reset(METRIC_AUDIO_ENCODE_RETRIES);
+    metrics_counter_reset(METRIC_AUDIO_DECODE_RETRIES);
+    metrics_counter_reset(METRIC_AUDIO_PCM_BYTES_IN);
+    metrics_counter_reset(METRIC_AUDIO_BYTES_ENCODED);
+    metrics_counter_reset(METRIC_AUDIO_BYTES_DECODED);
+    metrics_histogram_reset(METRIC_AUDIO_ENCODE_TIME_US);
+    metrics_histogram_reset(METRIC_AUDIO_DECODE_TIME_US);
 }
 
 bool audio_codec_is_ready(void) {
@@ -0,0 +1,227 @@
+/**
+ * @file sim_halow.h
+ * @brief Simulated Wi-Fi HaLow implementation of IHaLow interface for Linux hosts
+ *
+ * SimHaLow lets many AirCom node instances share a virtual HaLow channel on
+ * one machine. Every node joins the same UDP multicast group (one group port
+ * per channel); a frame sent by any node is seen by all others. Each receiver
+ * applies its own per-link impairments before delivering a frame:
+ *
+ * - loss:      independent drop probability per frame
+ * - delay:     fixed one-way latency
+ * - jitter:    uniform +/- variation added to the delay
+ * - bandwidth: serialization time at a fixed link rate, queued per link
+ *
+ * Links are keyed by sending node ID, with a default profile for all links
+ * that have no override. A fixed random seed makes loss and jitter
+ * reproducible between runs.
+ *
+ * Senders may pick an 802.11ah MCS and channel width per destination with
+ * the "set_link_rate" command. The choice travels in the frame header, and
+ * the receiver then derives the link rate and an extra packet error rate
+ * from the link's RSSI using the tables in halow_phy.h, so a rate that is
+ * too aggressive for the signal level loses frames just as a real radio
+ * would.
+ *
+ * Discovery is beacon based: nodes announce themselves every
+ * heartbeat_interval and are dropped after three missed beacons.
+ *
+ * @author AirCom Development Team
+ * @version 2.0.0
+ * @date 2024
+ */
+
+#ifndef SIM_HALOW_H
+#define SIM_HALOW_H
+
+#include "halow_interface.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+
+/**
+ * @brief Impairments applied to frames received over one simulated link
+ */
+struct SimLinkProfile {
+    float loss;             ///< Drop probability, 0.0 - 1.0
+    uint32_t delay_ms;      ///< Fixed one-way delay
+    uint32_t jitter_ms;     ///< Uniform jitter, +/- this value
+    uint32_t rate_kbps;     ///< Link rate; 0 = unlimited
+    int32_t rssi;           ///< Reported RSSI for peers on this link
+};
+
+/**
+ * @brief Simulator statistics
+ */
+struct SimHaLowStats {
+    uint32_t frames_sent;
+    uint32_t bytes_sent;
+    uint32_t frames_received;       ///< Frames addressed to us before impairments
+    uint32_t frames_lost;           ///< Frames dropped by the loss model
+    uint32_t frames_phy_errors;     ///< Of those, frames lost to the MCS/RSSI error model
+    uint32_t frames_delivered;      ///< Frames handed to the data callback
+    uint32_t bytes_delivered;
+    uint32_t max_queue_depth;       ///< Largest number of frames waiting for delivery
+};
+
+/**
+ * @brief Simulated Wi-Fi HaLow implementation of IHaLow interface
+ */
+class SimHaLow : public IHaLow {
+public:
+    /**
+     * @param node_id Node identifier; if empty, AIRCOM_SIM_NODE_ID or a
+     *                random ID is used
+     * @param seed    Seed for the impairment model (0 = time based)
+     */
+    explicit SimHaLow(const std::string& node_id = "", uint32_t seed = 0);
+    ~SimHaLow() override;
+
+    // IHaLow interface implementation
+    bool initialize(const HaLowConfig& config) override;
+    void deinitialize() override;
+    bool startDiscovery() override;
+    void stopDiscovery() override;
+    bool connectToPeer(const std::string& peer_id) override;
+    bool disconnectFromPeer(const std::string& peer_id) override;
+    bool sendData(const std::string& peer_id, const std::vector<uint8_t>& data) override;
+    bool broadcastData(const std::vector<uint8_t>& data) override;
+    std::vector<HaLowPeerInfo> getDiscoveredPeers() override;
+    std::vector<HaLowPeerInfo> getConnectedPeers() override;
+    HaLowNetworkInfo getNetworkInfo() override;
+    void setConnectionCallback(ConnectionCallback callback) override;
+    void setDataCallback(DataCallback callback) override;
+    void setDiscoveryCallback(DiscoveryCallback callback) override;
+    void setEventCallback(EventCallback callback) override;
+    std::string getImplementationName() const override;
+    std::vector<std::string> getSupportedHardware() const override;
+    bool isInitialized() const override;
+    bool isConnected() const override;
+    std::string getVersion() const override;
+
+    /**
+     * @brief Simulator control commands
+     *
+     * - "set_link"     {peer_id|*, loss, delay_ms, jitter_ms, rate_kbps[, rssi]}
+     * - "set_link_rate" {peer_id|*, mcs, bandwidth_mhz}  (transmit side; * = broadcasts and default)
+     * - "clear_link"   {peer_id}
+     * - "set_power_save" {wake_ms}  (0 = always awake; recorded only, delivery is not delayed)
+     * - "seed"         {value}
+     * - "stats"        {}
+     * - "reset_stats"  {}
+     * - "fail"         {}  (module hangs: sends fail, frames are ignored and an
+     *                       "error" event is raised until deinitialize())
+     */
+    std::string sendRawCommand(const std::string& command, const std::vector<std::string>& params) override;
+
+    // Simulator-specific configuration
+    void setDefaultLinkProfile(const SimLinkProfile& profile);
+    void setLinkProfile(const std::string& peer_id, const SimLinkProfile& profile);
+    void clearLinkProfile(const std::string& peer_id);
+    SimLinkProfile getLinkProfile(const std::string& peer_id) const;
+
+    SimHaLowStats getStats() const;
+    void resetStats();
+
+    const std::string& getNodeId() const { return m_nodeId; }
+
+    // Multicast group shared by all simulated nodes; the port is offset by channel
+    static constexpr const char* MULTICAST_GROUP = "239.255.42.99";
+    static constexpr uint16_t MULTICAST_BASE_PORT = 42000;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum FrameType : uint8_t {
+        FRAME_BEACON = 1,
+        FRAME_UNICAST = 2,
+        FRAME_BROADCAST = 3
+    };
+
+    // Rate selected by the sender, carried in every frame
+    struct TxRate {
+        uint8_t mcs;
+        uint8_t bandwidth_mhz;
+    };
+
+    static constexpr uint8_t RATE_UNSET = 0xFF;
+
+    struct PendingFrame {
+        Clock::time_point due;
+        uint64_t sequence;          ///< Tie breaker keeps FIFO order for equal due times
+        std::string source;
+        std::vector<uint8_t> payload;
+
+        bool operator>(const PendingFrame& other) const {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+
+    struct PeerState {
+        Clock::time_point lastSeen;
+        Clock::time_point linkBusyUntil;    ///< Bandwidth model: when the link is free again
+        uint32_t connectTime;
+        bool connected;
+    };
+
+    // Socket handling
+    bool openSocket();
+    void closeSocket();
+    bool sendFrame(FrameType type, const std::string& dest, const uint8_t* payload, size_t length);
+
+    // Worker threads
+    void receiveLoop();
+    void scheduleLoop();
+    void handleFrame(const uint8_t* frame, size_t length);
+    void scheduleDelivery(const std::string& source, TxRate rate, const uint8_t* payload, size_t length);
+    TxRate txRateFor(const std::string& dest) const;
+    void sendBeacon();
+    void expirePeers(Clock::time_point now);
+    void notePeerSeen(const std::string& peer_id, Clock::time_point now);
+
+    HaLowPeerInfo makePeerInfo(const std::string& peer_id, const PeerState& state) const;
+    uint32_t networkHash() const;
+
+    std::string m_nodeId;
+    HaLowConfig m_config;
+    int m_socket;
+    uint16_t m_port;
+
+    std::atomic<bool> m_initialized;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_discovering;
+    std::atomic<bool> m_failed;     ///< Set by "fail"
+
+    std::thread m_receiveThread;
+    std::thread m_scheduleThread;
+
+    // Peers, links and delivery queue; all guarded by m_mutex
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::map<std::string, PeerState> m_peers;
+    std::map<std::string, SimLinkProfile> m_linkProfiles;
+    std::map<std::string, TxRate> m_txRates;  ///< Per destination, "*" for broadcasts and the default
+    SimLinkProfile m_defaultProfile;
+    std::priority_queue<PendingFrame, std::vector<PendingFrame>, std::greater<PendingFrame>> m_pending;
+    uint64_t m_sequence;
+    bool m_newPeers;                ///< Set when a peer is first heard; handled by the scheduler
+    uint32_t m_wakeIntervalMs;      ///< From "set_power_save"
+    bool m_failureReported;         ///< The "error" event for "fail" was raised
+    std::mt19937 m_rng;
+    Clock::time_point m_nextBeacon;
+    SimHaLowStats m_stats;
+
+    // Callbacks (invoked on the scheduler thread, never with m_mutex held)
+    std::mutex m_callbackMutex;
+    ConnectionCallback m_connectionCallback;
+    DataCallback m_dataCallback;
+    DiscoveryCallback m_discoveryCallback;
+    EventCallback m_eventCallback;
+};
+
+#endif // SIM_HALOW_H
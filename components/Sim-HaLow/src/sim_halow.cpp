@@ -0,0 +1,876 @@
+/**
+ * @file sim_halow.cpp
+ * @brief Simulated Wi-Fi HaLow implementation for Linux hosts
+ *
+ * @author AirCom Development Team
+ * @version 2.0.0
+ * @date 2024
+ */
+
+#include "sim_halow.h"
+#include "halow_phy.h"
+#include "esp_log.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+// Tag for logging
+static const char* TAG = "SIM_HALOW";
+
+// Wire format: [magic 2][version][type][network hash 4][mcs][bandwidth]
+//              [src_len][src][dst_len][dst][payload]
+// mcs is RATE_UNSET when the sender has not selected a rate
+static const uint8_t FRAME_MAGIC_0 = 'S';
+static const uint8_t FRAME_MAGIC_1 = 'H';
+static const uint8_t FRAME_VERSION = 2;
+static const size_t FRAME_FIXED_HEADER = 10;
+static const size_t MAX_FRAME_SIZE = 65000;
+
+// Peers are dropped after this many missed beacons
+static const uint32_t BEACON_MISS_LIMIT = 3;
+static const uint32_t DEFAULT_BEACON_INTERVAL_MS = 1000;
+
+// Receive timeout so the receive thread notices shutdown
+static const int RECEIVE_TIMEOUT_MS = 100;
+
+SimHaLow::SimHaLow(const std::string& node_id, uint32_t seed)
+    : m_nodeId(node_id)
+    , m_config()
+    , m_socket(-1)
+    , m_port(MULTICAST_BASE_PORT)
+    , m_initialized(false)
+    , m_running(false)
+    , m_discovering(false)
+    , m_failed(false)
+    , m_defaultProfile{0.0f, 0, 0, 0, -60}
+    , m_sequence(0)
+    , m_newPeers(false)
+    , m_wakeIntervalMs(0)
+    , m_failureReported(false)
+    , m_rng(seed != 0 ? seed : (uint32_t)Clock::now().time_since_epoch().count())
+    , m_stats() {
+    if (m_nodeId.empty()) {
+        const char* env_id = getenv("AIRCOM_SIM_NODE_ID");
+        if (env_id && env_id[0] != '\0') {
+            m_nodeId = env_id;
+        } else {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "sim-%06x", (unsigned)(m_rng() & 0xFFFFFF));
+            m_nodeId = buf;
+        }
+    }
+}
+
+SimHaLow::~SimHaLow() {
+    deinitialize();
+}
+
+bool SimHaLow::initialize(const HaLowConfig& config) {
+    if (m_initialized) {
+        ESP_LOGW(TAG, "SimHaLow already initialized");
+        return true;
+    }
+
+    if (config.ssid.empty()) {
+        ESP_LOGE(TAG, "Invalid SSID");
+        return false;
+    }
+
+    if (m_nodeId.size() > 0xFF) {
+        ESP_LOGE(TAG, "Node ID too long");
+        return false;
+    }
+
+    m_config = config;
+    if (m_config.heartbeat_interval == 0) {
+        m_config.heartbeat_interval = DEFAULT_BEACON_INTERVAL_MS;
+    }
+    m_port = (uint16_t)(MULTICAST_BASE_PORT + (config.channel % 1000));
+
+    if (!openSocket()) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_peers.clear();
+        m_pending = decltype(m_pending)();
+        m_nextBeacon = Clock::now();
+        m_failureReported = false;
+    }
+
+    m_failed = false;
+    m_running = true;
+    m_initialized = true;
+    m_receiveThread = std::thread(&SimHaLow::receiveLoop, this);
+    m_scheduleThread = std::thread(&SimHaLow::scheduleLoop, this);
+
+    ESP_LOGI(TAG, "SimHaLow node %s initialized on %s:%u (SSID %s)",
+             m_nodeId.c_str(), MULTICAST_GROUP, m_port, m_config.ssid.c_str());
+    return true;
+}
+
+void SimHaLow::deinitialize() {
+    if (!m_initialized) {
+        return;
+    }
+
+    m_running = false;
+    m_wake.notify_all();
+    if (m_receiveThread.joinable()) {
+        m_receiveThread.join();
+    }
+    if (m_scheduleThread.joinable()) {
+        m_scheduleThread.join();
+    }
+    closeSocket();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_peers.clear();
+    m_pending = decltype(m_pending)();
+    m_initialized = false;
+    m_discovering = false;
+
+    ESP_LOGI(TAG, "SimHaLow node %s deinitialized", m_nodeId.c_str());
+}
+
+bool SimHaLow::startDiscovery() {
+    if (!m_initialized) {
+        ESP_LOGE(TAG, "Cannot start discovery: not initialized");
+        return false;
+    }
+
+    m_discovering = true;
+    {
+        // Announce ourselves right away instead of waiting for the next beacon
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_nextBeacon = Clock::now();
+    }
+    m_wake.notify_all();
+    return true;
+}
+
+void SimHaLow::stopDiscovery() {
+    m_discovering = false;
+}
+
+bool SimHaLow::connectToPeer(const std::string& peer_id) {
+    if (!m_initialized) {
+        ESP_LOGE(TAG, "Cannot connect to peer: not initialized");
+        return false;
+    }
+
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_peers.find(peer_id);
+        if (it == m_peers.end()) {
+            ESP_LOGW(TAG, "Peer %s not discovered", peer_id.c_str());
+            return false;
+        }
+        if (!it->second.connected) {
+            it->second.connected = true;
+            it->second.connectTime = (uint32_t)time(nullptr);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        std::lock_guard<std::mutex> lock(m_callbackMutex);
+        if (m_connectionCallback) {
+            m_connectionCallback(peer_id, true);
+        }
+    }
+    return true;
+}
+
+bool SimHaLow::disconnectFromPeer(const std::string& peer_id) {
+    if (!m_initialized) {
+        ESP_LOGE(TAG, "Cannot disconnect from peer: not initialized");
+        return false;
+    }
+
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_peers.find(peer_id);
+        if (it != m_peers.end() && it->second.connected) {
+            it->second.connected = false;
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        std::lock_guard<std::mutex> lock(m_callbackMutex);
+        if (m_connectionCallback) {
+            m_connectionCallback(peer_id, false);
+        }
+    }
+    return true;
+}
+
+bool SimHaLow::sendData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (!m_initialized) {
+        ESP_LOGE(TAG, "Cannot send data: not initialized");
+        return false;
+    }
+    return sendFrame(FRAME_UNICAST, peer_id, data.data(), data.size());
+}
+
+bool SimHaLow::broadcastData(const std::vector<uint8_t>& data) {
+    if (!m_initialized) {
+        ESP_LOGE(TAG, "Cannot broadcast data: not initialized");
+        return false;
+    }
+    return sendFrame(FRAME_BROADCAST, std::string(), data.data(), data.size());
+}
+
+std::vector<HaLowPeerInfo> SimHaLow::getDiscoveredPeers() {
+    std::vector<HaLowPeerInfo> peers;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : m_peers) {
+        peers.push_back(makePeerInfo(entry.first, entry.second));
+    }
+    return peers;
+}
+
+std::vector<HaLowPeerInfo> SimHaLow::getConnectedPeers() {
+    std::vector<HaLowPeerInfo> peers;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : m_peers) {
+        if (entry.second.connected) {
+            peers.push_back(makePeerInfo(entry.first, entry.second));
+        }
+    }
+    return peers;
+}
+
+HaLowNetworkInfo SimHaLow::getNetworkInfo() {
+    HaLowNetworkInfo info;
+    info.network_id = m_config.ssid;
+    info.device_id = m_nodeId;
+    info.channel = m_config.channel;
+    info.bandwidth = m_config.bandwidth;
+    info.mesh_enabled = m_config.enable_mesh;
+    info.sdk_version = getVersion();
+    info.hardware_type = "LINUX_SIM";
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int64_t rssi_sum = 0;
+    uint32_t connected = 0;
+    for (const auto& entry : m_peers) {
+        if (entry.second.connected) {
+            auto profile = m_linkProfiles.find(entry.first);
+            rssi_sum += (profile != m_linkProfiles.end() ? profile->second : m_defaultProfile).rssi;
+            connected++;
+        }
+    }
+    info.connected_peers = connected;
+    info.rssi = connected > 0 ? (int32_t)(rssi_sum / connected) : 0;
+    return info;
+}
+
+void SimHaLow::setConnectionCallback(ConnectionCallback callback) {
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+    m_connectionCallback = callback;
+}
+
+void SimHaLow::setDataCallback(DataCallback callback) {
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+    m_dataCallback = callback;
+}
+
+void SimHaLow::setDiscoveryCallback(DiscoveryCallback callback) {
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+    m_discoveryCallback = callback;
+}
+
+void SimHaLow::setEventCallback(EventCallback callback) {
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+    m_eventCallback = callback;
+}
+
+std::string SimHaLow::getImplementationName() const {
+    return "Sim-HaLow";
+}
+
+std::vector<std::string> SimHaLow::getSupportedHardware() const {
+    return {"LINUX_SIM"};
+}
+
+bool SimHaLow::isInitialized() const {
+    return m_initialized;
+}
+
+bool SimHaLow::isConnected() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : m_peers) {
+        if (entry.second.connected) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string SimHaLow::getVersion() const {
+    return "sim-1.0";
+}
+
+std::string SimHaLow::sendRawCommand(const std::string& command, const std::vector<std::string>& params) {
+    if (command == "set_link") {
+        if (params.size() < 5) {
+            return "ERROR: set_link <peer|*> <loss> <delay_ms> <jitter_ms> <rate_kbps> [rssi]";
+        }
+        SimLinkProfile profile = getLinkProfile(params[0]);
+        profile.loss = strtof(params[1].c_str(), nullptr);
+        profile.delay_ms = (uint32_t)strtoul(params[2].c_str(), nullptr, 10);
+        profile.jitter_ms = (uint32_t)strtoul(params[3].c_str(), nullptr, 10);
+        profile.rate_kbps = (uint32_t)strtoul(params[4].c_str(), nullptr, 10);
+        if (params.size() > 5) {
+            profile.rssi = (int32_t)strtol(params[5].c_str(), nullptr, 10);
+        }
+        if (params[0] == "*") {
+            setDefaultLinkProfile(profile);
+        } else {
+            setLinkProfile(params[0], profile);
+        }
+        return "OK";
+    }
+
+    if (command == "set_link_rate") {
+        if (params.size() < 3) {
+            return "ERROR: set_link_rate <peer|*> <mcs> <bandwidth_mhz>";
+        }
+        TxRate rate;
+        rate.mcs = (uint8_t)strtoul(params[1].c_str(), nullptr, 10);
+        rate.bandwidth_mhz = (uint8_t)strtoul(params[2].c_str(), nullptr, 10);
+        if (halow_phy_rate_kbps(rate.mcs, rate.bandwidth_mhz) == 0) {
+            return "ERROR: invalid MCS/bandwidth";
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_txRates[params[0]] = rate;
+        return "OK";
+    }
+
+    if (command == "set_power_save") {
+        if (params.empty()) {
+            return "ERROR: set_power_save <wake_ms>";
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakeIntervalMs = (uint32_t)strtoul(params[0].c_str(), nullptr, 10);
+        return "OK";
+    }
+
+    if (command == "clear_link") {
+        if (params.empty()) {
+            return "ERROR: clear_link <peer>";
+        }
+        clearLinkProfile(params[0]);
+        return "OK";
+    }
+
+    if (command == "seed") {
+        if (params.empty()) {
+            return "ERROR: seed <value>";
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_rng.seed((uint32_t)strtoul(params[0].c_str(), nullptr, 10));
+        return "OK";
+    }
+
+    if (command == "stats") {
+        SimHaLowStats stats = getStats();
+        uint32_t wakeMs;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            wakeMs = m_wakeIntervalMs;
+        }
+        std::ostringstream out;
+        out << "sent=" << stats.frames_sent
+            << " sent_bytes=" << stats.bytes_sent
+            << " received=" << stats.frames_received
+            << " lost=" << stats.frames_lost
+            << " phy_errors=" << stats.frames_phy_errors
+            << " delivered=" << stats.frames_delivered
+            << " delivered_bytes=" << stats.bytes_delivered
+            << " max_queue=" << stats.max_queue_depth
+            << " wake_ms=" << wakeMs;
+        return out.str();
+    }
+
+    if (command == "reset_stats") {
+        resetStats();
+        return "OK";
+    }
+
+    if (command == "fail") {
+        // Reported from the scheduler thread, like any other radio event
+        m_failed = true;
+        m_wake.notify_all();
+        return "OK";
+    }
+
+    return "ERROR: unknown command";
+}
+
+void SimHaLow::setDefaultLinkProfile(const SimLinkProfile& profile) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_defaultProfile = profile;
+}
+
+void SimHaLow::setLinkProfile(const std::string& peer_id, const SimLinkProfile& profile) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_linkProfiles[peer_id] = profile;
+}
+
+void SimHaLow::clearLinkProfile(const std::string& peer_id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_linkProfiles.erase(peer_id);
+}
+
+SimLinkProfile SimHaLow::getLinkProfile(const std::string& peer_id) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_linkProfiles.find(peer_id);
+    return it != m_linkProfiles.end() ? it->second : m_defaultProfile;
+}
+
+SimHaLowStats SimHaLow::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void SimHaLow::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = SimHaLowStats();
+}
+
+// Socket handling
+
+bool SimHaLow::openSocket() {
+    m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: %s", strerror(errno));
+        return false;
+    }
+
+    // Every node on the host binds the same port
+    int reuse = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_REUSEPORT
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+#endif
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(m_port);
+    if (bind(m_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind port %u: %s", m_port, strerror(errno));
+        closeSocket();
+        return false;
+    }
+
+    // Keep simulated traffic on the loopback interface of this host
+    struct in_addr loopback = {};
+    loopback.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+
+    unsigned char loop = 1;
+    setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    unsigned char ttl = 0;
+    setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    struct ip_mreq mreq = {};
+    inet_pton(AF_INET, MULTICAST_GROUP, &mreq.imr_multiaddr);
+    mreq.imr_interface = loopback;
+    if (setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        ESP_LOGE(TAG, "Failed to join multicast group: %s", strerror(errno));
+        closeSocket();
+        return false;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = RECEIVE_TIMEOUT_MS * 1000;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    return true;
+}
+
+void SimHaLow::closeSocket() {
+    if (m_socket >= 0) {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+bool SimHaLow::sendFrame(FrameType type, const std::string& dest, const uint8_t* payload, size_t length) {
+    if (m_failed) {
+        return false;
+    }
+
+    size_t frame_size = FRAME_FIXED_HEADER + 1 + m_nodeId.size() + 1 + dest.size() + length;
+    if (dest.size() > 0xFF || frame_size > MAX_FRAME_SIZE) {
+        ESP_LOGE(TAG, "Frame too large: %zu bytes", frame_size);
+        return false;
+    }
+
+    std::vector<uint8_t> frame;
+    frame.reserve(frame_size);
+    uint32_t hash = networkHash();
+    TxRate rate = txRateFor(dest);
+    frame.push_back(FRAME_MAGIC_0);
+    frame.push_back(FRAME_MAGIC_1);
+    frame.push_back(FRAME_VERSION);
+    frame.push_back(type);
+    frame.push_back((uint8_t)(hash >> 24));
+    frame.push_back((uint8_t)(hash >> 16));
+    frame.push_back((uint8_t)(hash >> 8));
+    frame.push_back((uint8_t)hash);
+    frame.push_back(rate.mcs);
+    frame.push_back(rate.bandwidth_mhz);
+    frame.push_back((uint8_t)m_nodeId.size());
+    frame.insert(frame.end(), m_nodeId.begin(), m_nodeId.end());
+    frame.push_back((uint8_t)dest.size());
+    frame.insert(frame.end(), dest.begin(), dest.end());
+    if (length > 0) {
+        frame.insert(frame.end(), payload, payload + length);
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_port);
+    inet_pton(AF_INET, MULTICAST_GROUP, &addr.sin_addr);
+
+    ssize_t sent = sendto(m_socket, frame.data(), frame.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+    if (sent < 0) {
+        ESP_LOGE(TAG, "sendto failed: %s", strerror(errno));
+        return false;
+    }
+
+    if (type != FRAME_BEACON) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.frames_sent++;
+        m_stats.bytes_sent += (uint32_t)length;
+    }
+    return true;
+}
+
+// Worker threads
+
+void SimHaLow::receiveLoop() {
+    std::vector<uint8_t> buffer(MAX_FRAME_SIZE);
+
+    while (m_running) {
+        ssize_t received = recv(m_socket, buffer.data(), buffer.size(), 0);
+        if (received < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                ESP_LOGE(TAG, "recv failed: %s", strerror(errno));
+            }
+            continue;
+        }
+        handleFrame(buffer.data(), (size_t)received);
+    }
+}
+
+void SimHaLow::handleFrame(const uint8_t* frame, size_t length) {
+    if (m_failed) {
+        return;
+    }
+    if (length < FRAME_FIXED_HEADER + 2 ||
+        frame[0] != FRAME_MAGIC_0 || frame[1] != FRAME_MAGIC_1 || frame[2] != FRAME_VERSION) {
+        return;
+    }
+
+    // Frames from other simulated networks share the group but are ignored
+    uint32_t hash = ((uint32_t)frame[4] << 24) | ((uint32_t)frame[5] << 16) |
+                    ((uint32_t)frame[6] << 8) | (uint32_t)frame[7];
+    if (hash != networkHash()) {
+        return;
+    }
+
+    size_t offset = FRAME_FIXED_HEADER;
+    size_t src_len = frame[offset++];
+    if (offset + src_len + 1 > length) {
+        return;
+    }
+    std::string source(reinterpret_cast<const char*>(frame + offset), src_len);
+    offset += src_len;
+
+    size_t dst_len = frame[offset++];
+    if (offset + dst_len > length) {
+        return;
+    }
+    std::string dest(reinterpret_cast<const char*>(frame + offset), dst_len);
+    offset += dst_len;
+
+    // Our own frames come back through multicast loopback
+    if (source == m_nodeId) {
+        return;
+    }
+
+    FrameType type = (FrameType)frame[3];
+    Clock::time_point now = Clock::now();
+
+    if (type == FRAME_BEACON) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        notePeerSeen(source, now);
+        return;
+    }
+
+    if (type == FRAME_UNICAST && dest != m_nodeId) {
+        return;
+    }
+
+    if (type == FRAME_UNICAST || type == FRAME_BROADCAST) {
+        TxRate rate = { frame[8], frame[9] };
+        scheduleDelivery(source, rate, frame + offset, length - offset);
+    }
+}
+
+void SimHaLow::scheduleDelivery(const std::string& source, TxRate rate, const uint8_t* payload, size_t length) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Clock::time_point now = Clock::now();
+    m_stats.frames_received++;
+
+    // Any traffic counts as proof of life, not just beacons
+    notePeerSeen(source, now);
+
+    auto link = m_linkProfiles.find(source);
+    const SimLinkProfile& profile = link != m_linkProfiles.end() ? link->second : m_defaultProfile;
+
+    std::uniform_real_distribution<float> loss_dist(0.0f, 1.0f);
+    if (profile.loss > 0.0f && loss_dist(m_rng) < profile.loss) {
+        m_stats.frames_lost++;
+        return;
+    }
+
+    // With a rate in the frame, the PHY model decides both speed and errors
+    uint32_t rate_kbps = profile.rate_kbps;
+    uint32_t phy_kbps = rate.mcs != RATE_UNSET ? halow_phy_rate_kbps(rate.mcs, rate.bandwidth_mhz) : 0;
+    if (phy_kbps > 0) {
+        float per = halow_packet_error_rate(rate.mcs, rate.bandwidth_mhz, (float)profile.rssi);
+        if (loss_dist(m_rng) < per) {
+            m_stats.frames_lost++;
+            m_stats.frames_phy_errors++;
+            return;
+        }
+        if (rate_kbps == 0 || phy_kbps < rate_kbps) {
+            rate_kbps = phy_kbps;
+        }
+    }
+
+    int64_t delay_us = (int64_t)profile.delay_ms * 1000;
+    if (profile.jitter_ms > 0) {
+        std::uniform_int_distribution<int64_t> jitter_dist(-(int64_t)profile.jitter_ms * 1000,
+                                                           (int64_t)profile.jitter_ms * 1000);
+        delay_us += jitter_dist(m_rng);
+        if (delay_us < 0) {
+            delay_us = 0;
+        }
+    }
+
+    // Bandwidth cap: frames on one link serialize back to back, then propagate
+    Clock::time_point departure = now;
+    if (rate_kbps > 0) {
+        PeerState& peer = m_peers[source];
+        int64_t serialize_us = (int64_t)length * 8 * 1000 / rate_kbps;
+        Clock::time_point start = peer.linkBusyUntil > now ? peer.linkBusyUntil : now;
+        peer.linkBusyUntil = start + std::chrono::microseconds(serialize_us);
+        departure = peer.linkBusyUntil;
+    }
+
+    PendingFrame pending;
+    pending.due = departure + std::chrono::microseconds(delay_us);
+    pending.sequence = m_sequence++;
+    pending.source = source;
+    pending.payload.assign(payload, payload + length);
+    m_pending.push(std::move(pending));
+
+    if (m_pending.size() > m_stats.max_queue_depth) {
+        m_stats.max_queue_depth = (uint32_t)m_pending.size();
+    }
+    m_wake.notify_all();
+}
+
+void SimHaLow::scheduleLoop() {
+    std::vector<PendingFrame> due;
+    std::vector<std::pair<std::string, bool>> connection_events;
+
+    while (m_running) {
+        bool send_beacon = false;
+        bool peers_changed = false;
+        bool report_failure = false;
+        std::vector<std::string> peer_list;
+        due.clear();
+        connection_events.clear();
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            Clock::time_point wake_at = m_nextBeacon;
+            if (!m_pending.empty() && m_pending.top().due < wake_at) {
+                wake_at = m_pending.top().due;
+            }
+            m_wake.wait_until(lock, wake_at);
+            if (!m_running) {
+                break;
+            }
+
+            Clock::time_point now = Clock::now();
+            while (!m_pending.empty() && m_pending.top().due <= now) {
+                due.push_back(m_pending.top());
+                m_pending.pop();
+            }
+
+            if (now >= m_nextBeacon) {
+                send_beacon = true;
+                m_nextBeacon = now + std::chrono::milliseconds(m_config.heartbeat_interval);
+
+                size_t before = m_peers.size();
+                std::vector<std::string> connected_before;
+                for (const auto& entry : m_peers) {
+                    if (entry.second.connected) {
+                        connected_before.push_back(entry.first);
+                    }
+                }
+                expirePeers(now);
+                for (const auto& peer_id : connected_before) {
+                    if (m_peers.find(peer_id) == m_peers.end()) {
+                        connection_events.emplace_back(peer_id, false);
+                    }
+                }
+
+                peers_changed = m_peers.size() != before;
+            }
+
+            // New peers are announced as soon as they are heard, not on the
+            // next beacon; in mesh mode every discovered peer is a link
+            if (m_newPeers) {
+                m_newPeers = false;
+                for (auto& entry : m_peers) {
+                    if (entry.second.connectTime == 0) {
+                        entry.second.connectTime = (uint32_t)time(nullptr);
+                        peers_changed = true;
+                        if (m_config.enable_mesh && !entry.second.connected) {
+                            entry.second.connected = true;
+                            connection_events.emplace_back(entry.first, true);
+                        }
+                    }
+                }
+            }
+
+            if (peers_changed) {
+                for (const auto& entry : m_peers) {
+                    peer_list.push_back(entry.first);
+                }
+            }
+
+            if (m_failed && !m_failureReported) {
+                m_failureReported = true;
+                report_failure = true;
+            }
+
+            m_stats.frames_delivered += (uint32_t)due.size();
+            for (const auto& frame : due) {
+                m_stats.bytes_delivered += (uint32_t)frame.payload.size();
+            }
+        }
+
+        if (send_beacon) {
+            sendBeacon();
+        }
+
+        std::lock_guard<std::mutex> lock(m_callbackMutex);
+        if (report_failure && m_eventCallback) {
+            m_eventCallback("error", nullptr);
+        }
+        for (const auto& event : connection_events) {
+            if (m_connectionCallback) {
+                m_connectionCallback(event.first, event.second);
+            }
+        }
+        if (peers_changed && m_discovering && m_discoveryCallback) {
+            m_discoveryCallback(peer_list);
+        }
+        for (const auto& frame : due) {
+            if (m_dataCallback) {
+                m_dataCallback(frame.source, frame.payload);
+            }
+        }
+    }
+}
+
+void SimHaLow::sendBeacon() {
+    sendFrame(FRAME_BEACON, std::string(), nullptr, 0);
+}
+
+void SimHaLow::expirePeers(Clock::time_point now) {
+    auto timeout = std::chrono::milliseconds(m_config.heartbeat_interval * BEACON_MISS_LIMIT);
+    for (auto it = m_peers.begin(); it != m_peers.end();) {
+        if (now - it->second.lastSeen > timeout) {
+            ESP_LOGI(TAG, "Peer %s timed out", it->first.c_str());
+            it = m_peers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SimHaLow::notePeerSeen(const std::string& peer_id, Clock::time_point now) {
+    auto it = m_peers.find(peer_id);
+    if (it == m_peers.end()) {
+        PeerState state;
+        state.lastSeen = now;
+        state.linkBusyUntil = now;
+        state.connectTime = 0;     // Reported as new on the next scheduler pass
+        state.connected = false;
+        m_peers.emplace(peer_id, state);
+        m_newPeers = true;
+        m_wake.notify_all();
+        return;
+    }
+    it->second.lastSeen = now;
+}
+
+SimHaLow::TxRate SimHaLow::txRateFor(const std::string& dest) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = dest.empty() ? m_txRates.end() : m_txRates.find(dest);
+    if (it == m_txRates.end()) {
+        it = m_txRates.find("*");
+    }
+    if (it == m_txRates.end()) {
+        return TxRate{ RATE_UNSET, 0 };
+    }
+    return it->second;
+}
+
+HaLowPeerInfo SimHaLow::makePeerInfo(const std::string& peer_id, const PeerState& state) const {
+    HaLowPeerInfo info;
+    info.peer_id = peer_id;
+    info.mac_address = "";
+    info.ipv6_address = "";
+    auto profile = m_linkProfiles.find(peer_id);
+    info.rssi = (profile != m_linkProfiles.end() ? profile->second : m_defaultProfile).rssi;
+    info.connection_time = state.connectTime;
+    info.is_connected = state.connected;
+    info.device_type = "LINUX_SIM";
+    return info;
+}
+
+uint32_t SimHaLow::networkHash() const {
+    // FNV-1a over SSID so separate simulated networks can share a channel
+    uint32_t hash = 2166136261u;
+    for (char c : m_config.ssid) {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -1 +1,471 @@
-// This is an empty stub file to allow the project to compile.
+/**
+ * @file AirCom.pb-c.cpp
+ * @brief Protobuf wire-format codec for the AirComPacket fields in AirCom.pb-c.h
+ *
+ * Hand-written stand-in for the protoc-c output until protobuf-c is part of
+ * the build. Only the fields declared in AirCom.pb-c.h are encoded; field
+ * numbers and wire types follow AirCom.proto, so packets interoperate with
+ * generated code for the same fields. Unknown fields are skipped on unpack.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "AirCom.pb-c.h"
+#include <cstdlib>
+#include <cstring>
+
+// Field numbers from AirCom.proto
+enum {
+    FIELD_PACKET_FROM_NODE = 1,
+    FIELD_PACKET_NODE_INFO = 5,
+    FIELD_PACKET_TEXT_MESSAGE = 6,
+    FIELD_PACKET_NETWORK_HEALTH = 7,
+    FIELD_PACKET_COT_MESSAGE = 9,
+
+    FIELD_NODE_INFO_CALLSIGN = 1,
+    FIELD_NODE_INFO_NODE_ID = 2,
+    FIELD_NODE_INFO_BATTERY_LEVEL = 3,
+    FIELD_NODE_INFO_BATTERY_MINUTES = 8,
+
+    FIELD_TEXT_MESSAGE_TEXT = 1,
+
+    FIELD_HEALTH_RSSI = 1,
+    FIELD_HEALTH_PACKET_LOSS = 2,
+    FIELD_HEALTH_LATENCY_MS = 3,
+    FIELD_HEALTH_MESH_STATUS = 4,
+};
+
+enum {
+    WIRE_VARINT = 0,
+    WIRE_FIXED64 = 1,
+    WIRE_LENGTH_DELIMITED = 2,
+    WIRE_FIXED32 = 5,
+};
+
+// ============================================================================
+// SIZE CALCULATION
+// ============================================================================
+
+static size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static size_t tag_size(uint32_t field) {
+    return varint_size((uint64_t)field << 3);
+}
+
+// proto3 omits empty strings and zero scalars
+static size_t string_field_size(uint32_t field, const char* value) {
+    if (!value || !value[0]) {
+        return 0;
+    }
+    size_t len = strlen(value);
+    return tag_size(field) + varint_size(len) + len;
+}
+
+static size_t uint32_field_size(uint32_t field, uint32_t value) {
+    return value ? tag_size(field) + varint_size(value) : 0;
+}
+
+static size_t message_field_size(uint32_t field, size_t body) {
+    return tag_size(field) + varint_size(body) + body;
+}
+
+static size_t node_info_size(const NodeInfo* info) {
+    return string_field_size(FIELD_NODE_INFO_CALLSIGN, info->callsign) +
+           string_field_size(FIELD_NODE_INFO_NODE_ID, info->node_id) +
+           uint32_field_size(FIELD_NODE_INFO_BATTERY_LEVEL, info->battery_level) +
+           uint32_field_size(FIELD_NODE_INFO_BATTERY_MINUTES, info->battery_minutes);
+}
+
+static size_t text_message_size(const TextMessage* message) {
+    return string_field_size(FIELD_TEXT_MESSAGE_TEXT, message->text);
+}
+
+static size_t network_health_size(const NetworkHealth* health) {
+    return uint32_field_size(FIELD_HEALTH_RSSI, (uint32_t)health->rssi) +
+           uint32_field_size(FIELD_HEALTH_PACKET_LOSS, health->packet_loss) +
+           uint32_field_size(FIELD_HEALTH_LATENCY_MS, health->latency_ms) +
+           string_field_size(FIELD_HEALTH_MESH_STATUS, health->mesh_status);
+}
+
+size_t air_com_packet__get_packed_size(const AirComPacket* packet) {
+    if (!packet) {
+        return 0;
+    }
+
+    size_t size = string_field_size(FIELD_PACKET_FROM_NODE, packet->from_node);
+    switch (packet->payload_variant_case) {
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO:
+            if (packet->node_info) {
+                size += message_field_size(FIELD_PACKET_NODE_INFO, node_info_size(packet->node_info));
+            }
+            break;
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE:
+            if (packet->text_message) {
+                size += message_field_size(FIELD_PACKET_TEXT_MESSAGE, text_message_size(packet->text_message));
+            }
+            break;
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_NETWORK_HEALTH:
+            if (packet->network_health) {
+                size += message_field_size(FIELD_PACKET_NETWORK_HEALTH, network_health_size(packet->network_health));
+            }
+            break;
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE:
+            // A oneof member is sent even when empty so the case survives
+            if (packet->cot_message && packet->cot_message[0]) {
+                size += string_field_size(FIELD_PACKET_COT_MESSAGE, packet->cot_message);
+            } else {
+                size += message_field_size(FIELD_PACKET_COT_MESSAGE, 0);
+            }
+            break;
+        default:
+            break;
+    }
+    return size;
+}
+
+// ============================================================================
+// PACKING
+// ============================================================================
+
+static uint8_t* put_varint(uint8_t* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static uint8_t* put_tag(uint8_t* out, uint32_t field, uint32_t wire_type) {
+    return put_varint(out, ((uint64_t)field << 3) | wire_type);
+}
+
+static uint8_t* put_string(uint8_t* out, uint32_t field, const char* value) {
+    if (!value || !value[0]) {
+        return out;
+    }
+    size_t len = strlen(value);
+    out = put_tag(out, field, WIRE_LENGTH_DELIMITED);
+    out = put_varint(out, len);
+    memcpy(out, value, len);
+    return out + len;
+}
+
+static uint8_t* put_uint32(uint8_t* out, uint32_t field, uint32_t value) {
+    if (!value) {
+        return out;
+    }
+    out = put_tag(out, field, WIRE_VARINT);
+    return put_varint(out, value);
+}
+
+static uint8_t* put_message_header(uint8_t* out, uint32_t field, size_t body) {
+    out = put_tag(out, field, WIRE_LENGTH_DELIMITED);
+    return put_varint(out, body);
+}
+
+void air_com_packet__pack(const AirComPacket* packet, uint8_t* out) {
+    if (!packet || !out) {
+        return;
+    }
+
+    out = put_string(out, FIELD_PACKET_FROM_NODE, packet->from_node);
+    switch (packet->payload_variant_case) {
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO:
+            if (packet->node_info) {
+                const NodeInfo* info = packet->node_info;
+                out = put_message_header(out, FIELD_PACKET_NODE_INFO, node_info_size(info));
+                out = put_string(out, FIELD_NODE_INFO_CALLSIGN, info->callsign);
+                out = put_string(out, FIELD_NODE_INFO_NODE_ID, info->node_id);
+                out = put_uint32(out, FIELD_NODE_INFO_BATTERY_LEVEL, info->battery_level);
+                out = put_uint32(out, FIELD_NODE_INFO_BATTERY_MINUTES, info->battery_minutes);
+            }
+            break;
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE:
+            if (packet->text_message) {
+                const TextMessage* message = packet->text_message;
+                out = put_message_header(out, FIELD_PACKET_TEXT_MESSAGE, text_message_size(message));
+                out = put_string(out, FIELD_TEXT_MESSAGE_TEXT, message->text);
+            }
+            break;
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_NETWORK_HEALTH:
+            if (packet->network_health) {
+                const NetworkHealth* health = packet->network_health;
+                out = put_message_header(out, FIELD_PACKET_NETWORK_HEALTH, network_health_size(health));
+                out = put_uint32(out, FIELD_HEALTH_RSSI, (uint32_t)health->rssi);
+                out = put_uint32(out, FIELD_HEALTH_PACKET_LOSS, health->packet_loss);
+                out = put_uint32(out, FIELD_HEALTH_LATENCY_MS, health->latency_ms);
+                out = put_string(out, FIELD_HEALTH_MESH_STATUS, health->mesh_status);
+            }
+            break;
+        case AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE:
+            if (packet->cot_message && packet->cot_message[0]) {
+                out = put_string(out, FIELD_PACKET_COT_MESSAGE, packet->cot_message);
+            } else {
+                out = put_message_header(out, FIELD_PACKET_COT_MESSAGE, 0);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// ============================================================================
+// UNPACKING
+// ============================================================================
+
+struct Reader {
+    const uint8_t* pos;
+    const uint8_t* end;
+};
+
+static bool get_varint(Reader* reader, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && reader->pos < reader->end; shift += 7) {
+        uint8_t byte = *reader->pos++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads a length-delimited body, leaving the reader after it
+static bool get_bytes(Reader* reader, Reader* body) {
+    uint64_t len;
+    if (!get_varint(reader, &len) || len > (uint64_t)(reader->end - reader->pos)) {
+        return false;
+    }
+    body->pos = reader->pos;
+    body->end = reader->pos + len;
+    reader->pos += len;
+    return true;
+}
+
+static bool get_string(Reader* reader, char** value) {
+    Reader body;
+    if (!get_bytes(reader, &body)) {
+        return false;
+    }
+    size_t len = (size_t)(body.end - body.pos);
+    char* copy = (char*)malloc(len + 1);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, body.pos, len);
+    copy[len] = '\0';
+    free(*value);   // a repeated field keeps the last value
+    *value = copy;
+    return true;
+}
+
+static bool skip_field(Reader* reader, uint32_t wire_type) {
+    uint64_t ignored;
+    Reader body;
+    switch (wire_type) {
+        case WIRE_VARINT:
+            return get_varint(reader, &ignored);
+        case WIRE_FIXED64:
+            if (reader->end - reader->pos < 8) return false;
+            reader->pos += 8;
+            return true;
+        case WIRE_LENGTH_DELIMITED:
+            return get_bytes(reader, &body);
+        case WIRE_FIXED32:
+            if (reader->end - reader->pos < 4) return false;
+            reader->pos += 4;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool get_tag(Reader* reader, uint32_t* field, uint32_t* wire_type) {
+    uint64_t tag;
+    if (!get_varint(reader, &tag) || (tag >> 3) == 0 || (tag >> 3) > 0x1FFFFFFF) {
+        return false;
+    }
+    *field = (uint32_t)(tag >> 3);
+    *wire_type = (uint32_t)(tag & 0x07);
+    return true;
+}
+
+static bool unpack_node_info(Reader reader, NodeInfo* info) {
+    while (reader.pos < reader.end) {
+        uint32_t field, wire_type;
+        if (!get_tag(&reader, &field, &wire_type)) return false;
+        uint64_t value = 0;
+        bool ok;
+        if (field == FIELD_NODE_INFO_CALLSIGN && wire_type == WIRE_LENGTH_DELIMITED) {
+            ok = get_string(&reader, &info->callsign);
+        } else if (field == FIELD_NODE_INFO_NODE_ID && wire_type == WIRE_LENGTH_DELIMITED) {
+            ok = get_string(&reader, &info->node_id);
+        } else if (field == FIELD_NODE_INFO_BATTERY_LEVEL && wire_type == WIRE_VARINT) {
+            ok = get_varint(&reader, &value);
+            info->battery_level = (uint32_t)value;
+        } else if (field == FIELD_NODE_INFO_BATTERY_MINUTES && wire_type == WIRE_VARINT) {
+            ok = get_varint(&reader, &value);
+            info->battery_minutes = (uint32_t)value;
+        } else {
+            ok = skip_field(&reader, wire_type);
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static bool unpack_text_message(Reader reader, TextMessage* message) {
+    while (reader.pos < reader.end) {
+        uint32_t field, wire_type;
+        if (!get_tag(&reader, &field, &wire_type)) return false;
+        bool ok;
+        if (field == FIELD_TEXT_MESSAGE_TEXT && wire_type == WIRE_LENGTH_DELIMITED) {
+            ok = get_string(&reader, &message->text);
+        } else {
+            ok = skip_field(&reader, wire_type);
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static bool unpack_network_health(Reader reader, NetworkHealth* health) {
+    while (reader.pos < reader.end) {
+        uint32_t field, wire_type;
+        if (!get_tag(&reader, &field, &wire_type)) return false;
+        uint64_t value = 0;
+        bool ok;
+        if (field == FIELD_HEALTH_MESH_STATUS && wire_type == WIRE_LENGTH_DELIMITED) {
+            ok = get_string(&reader, &health->mesh_status);
+        } else if (field >= FIELD_HEALTH_RSSI && field <= FIELD_HEALTH_LATENCY_MS && wire_type == WIRE_VARINT) {
+            ok = get_varint(&reader, &value);
+            if (field == FIELD_HEALTH_RSSI) {
+                health->rssi = (int)(uint32_t)value;
+            } else if (field == FIELD_HEALTH_PACKET_LOSS) {
+                health->packet_loss = (uint32_t)value;
+            } else {
+                health->latency_ms = (uint32_t)value;
+            }
+        } else {
+            ok = skip_field(&reader, wire_type);
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Drops the current oneof member so a later one can replace it
+static void clear_payload(AirComPacket* packet) {
+    if (packet->node_info) {
+        free(packet->node_info->callsign);
+        free(packet->node_info->node_id);
+        free(packet->node_info);
+        packet->node_info = NULL;
+    }
+    if (packet->text_message) {
+        free(packet->text_message->text);
+        free(packet->text_message);
+        packet->text_message = NULL;
+    }
+    if (packet->network_health) {
+        free(packet->network_health->mesh_status);
+        free(packet->network_health);
+        packet->network_health = NULL;
+    }
+    free(packet->cot_message);
+    packet->cot_message = NULL;
+    packet->payload_variant_case = 0;
+}
+
+AirComPacket* air_com_packet__unpack(void* allocator, size_t len, const uint8_t* data) {
+    (void)allocator;    // protobuf-c allocator; the system allocator is always used
+    if (!data && len) {
+        return NULL;
+    }
+
+    AirComPacket* packet = (AirComPacket*)calloc(1, sizeof(AirComPacket));
+    if (!packet) {
+        return NULL;
+    }
+
+    Reader reader = {data, data + len};
+    while (reader.pos < reader.end) {
+        uint32_t field, wire_type;
+        if (!get_tag(&reader, &field, &wire_type)) {
+            air_com_packet__free_unpacked(packet, NULL);
+            return NULL;
+        }
+
+        bool ok = true;
+        Reader body;
+        if (field == FIELD_PACKET_FROM_NODE && wire_type == WIRE_LENGTH_DELIMITED) {
+            ok = get_string(&reader, &packet->from_node);
+        } else if (field == FIELD_PACKET_NODE_INFO && wire_type == WIRE_LENGTH_DELIMITED) {
+            clear_payload(packet);
+            packet->payload_variant_case = AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO;
+            packet->node_info = (NodeInfo*)calloc(1, sizeof(NodeInfo));
+            ok = packet->node_info && get_bytes(&reader, &body) && unpack_node_info(body, packet->node_info);
+        } else if (field == FIELD_PACKET_TEXT_MESSAGE && wire_type == WIRE_LENGTH_DELIMITED) {
+            clear_payload(packet);
+            packet->payload_variant_case = AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE;
+            packet->text_message = (TextMessage*)calloc(1, sizeof(TextMessage));
+            ok = packet->text_message && get_bytes(&reader, &body) && unpack_text_message(body, packet->text_message);
+        } else if (field == FIELD_PACKET_NETWORK_HEALTH && wire_type == WIRE_LENGTH_DELIMITED) {
+            clear_payload(packet);
+            packet->payload_variant_case = AIR_COM_PACKET__PAYLOAD_VARIANT_NETWORK_HEALTH;
+            packet->network_health = (NetworkHealth*)calloc(1, sizeof(NetworkHealth));
+            ok = packet->network_health && get_bytes(&reader, &body) && unpack_network_health(body, packet->network_health);
+        } else if (field == FIELD_PACKET_COT_MESSAGE && wire_type == WIRE_LENGTH_DELIMITED) {
+            clear_payload(packet);
+            packet->payload_variant_case = AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE;
+            ok = get_string(&reader, &packet->cot_message);
+        } else {
+            ok = skip_field(&reader, wire_type);
+        }
+
+        if (!ok) {
+            air_com_packet__free_unpacked(packet, NULL);
+            return NULL;
+        }
+    }
+
+    // Readers expect strings, never NULL, for the fields they print
+    if (!packet->from_node) {
+        packet->from_node = (char*)calloc(1, 1);
+    }
+    if (packet->node_info) {
+        if (!packet->node_info->callsign) packet->node_info->callsign = (char*)calloc(1, 1);
+        if (!packet->node_info->node_id) packet->node_info->node_id = (char*)calloc(1, 1);
+    }
+    if (packet->text_message && !packet->text_message->text) {
+        packet->text_message->text = (char*)calloc(1, 1);
+    }
+    if (packet->network_health && !packet->network_health->mesh_status) {
+        packet->network_health->mesh_status = (char*)calloc(1, 1);
+    }
+    if (packet->payload_variant_case == AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE && !packet->cot_message) {
+        packet->cot_message = (char*)calloc(1, 1);
+    }
+    return packet;
+}
+
+void air_com_packet__free_unpacked(AirComPacket* packet, void* allocator) {
+    (void)allocator;
+    if (!packet) {
+        return;
+    }
+    clear_payload(packet);
+    free(packet->from_node);
+    free(packet);
+}
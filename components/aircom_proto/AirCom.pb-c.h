@@ -22,6 +22,8 @@ struct _AirComPacket {
 struct _NodeInfo {
     char* callsign;
     char* node_id;
+    uint32_t battery_level;     // Percent; 0 when unknown
+    uint32_t battery_minutes;   // Estimated runtime left; 0 when unknown
 };
 
 struct _TextMessage {
@@ -30,17 +32,21 @@ struct _TextMessage {
 
 struct _NetworkHealth {
     int rssi;
+    uint32_t packet_loss;
+    uint32_t latency_ms;
+    char* mesh_status;
 };
 
 #define AIR_COM_PACKET__INIT {0,0,0,0,0,0}
-#define NODE_INFO__INIT {0,0}
+#define NODE_INFO__INIT {0,0,0,0}
 #define TEXT_MESSAGE__INIT {0}
+#define NETWORK_HEALTH__INIT {0,0,0,0}
 #define AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO 1
 #define AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE 2
 #define AIR_COM_PACKET__PAYLOAD_VARIANT_NETWORK_HEALTH 3
 #define AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE 4
 
-// Dummy function prototypes
+// Codec, see AirCom.pb-c.cpp
 size_t air_com_packet__get_packed_size(const AirComPacket*);
 void air_com_packet__pack(const AirComPacket*, uint8_t*);
 AirComPacket* air_com_packet__unpack(void*, size_t, const uint8_t*);
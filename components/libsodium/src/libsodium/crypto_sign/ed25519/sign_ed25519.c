@@ -0,0 +1,602 @@
+#include "sodium.h"
+#include <stdint.h>
+#include <string.h>
+
+// ============================================================================
+// Ed25519 SIGNATURES AND SHA-512
+// ============================================================================
+// Detached Ed25519 signatures (RFC 8032) for the mesh OTA manifest. The
+// field and group arithmetic follows TweetNaCl (public domain): 16 limbs of
+// 16 bits, constant-time conditional swaps and no tables, which keeps the
+// code small at the cost of speed. A verification runs once per update.
+
+// ============================================================================
+// SHA-512
+// ============================================================================
+
+typedef struct {
+    uint64_t state[8];
+    uint64_t total;                 // Bytes hashed so far
+    uint8_t buffer[128];
+} sha512_context_t;
+
+static const uint64_t SHA512_K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static uint64_t load64_be(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void store64_be(uint8_t *p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static void sha512_block(uint64_t state[8], const uint8_t *block) {
+    uint64_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = load64_be(block + 8 * i);
+    }
+    for (int i = 16; i < 80; i++) {
+        uint64_t s0 = ROTR64(w[i - 15], 1) ^ ROTR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+        uint64_t s1 = ROTR64(w[i - 2], 19) ^ ROTR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 80; i++) {
+        uint64_t t1 = h + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) + ((e & f) ^ (~e & g)) +
+                      SHA512_K[i] + w[i];
+        uint64_t t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha512_init(sha512_context_t *ctx) {
+    static const uint64_t iv[8] = {
+        0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+        0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+    };
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->total = 0;
+}
+
+static void sha512_update(sha512_context_t *ctx, const uint8_t *in, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    size_t used = (size_t)(ctx->total % 128);
+    ctx->total += len;
+    if (used > 0) {
+        size_t take = 128 - used < len ? 128 - used : len;
+        memcpy(ctx->buffer + used, in, take);
+        in += take;
+        len -= take;
+        if (used + take < 128) {
+            return;
+        }
+        sha512_block(ctx->state, ctx->buffer);
+    }
+    for (; len >= 128; in += 128, len -= 128) {
+        sha512_block(ctx->state, in);
+    }
+    memcpy(ctx->buffer, in, len);
+}
+
+static void sha512_final(sha512_context_t *ctx, uint8_t out[64]) {
+    size_t used = (size_t)(ctx->total % 128);
+    uint64_t bits = ctx->total * 8;
+    ctx->buffer[used++] = 0x80;
+    if (used > 112) {
+        memset(ctx->buffer + used, 0, 128 - used);
+        sha512_block(ctx->state, ctx->buffer);
+        used = 0;
+    }
+    memset(ctx->buffer + used, 0, 120 - used);
+    store64_be(ctx->buffer + 120, bits);
+    sha512_block(ctx->state, ctx->buffer);
+    for (int i = 0; i < 8; i++) {
+        store64_be(out + 8 * i, ctx->state[i]);
+    }
+}
+
+/**
+ * @brief SHA-512 of a message
+ *
+ * @param out Pointer to output buffer (crypto_hash_sha512_BYTES bytes)
+ * @param in Pointer to input message buffer
+ * @param inlen Length of the input message
+ * @return 0 on success
+ */
+int crypto_hash_sha512(unsigned char *out, const unsigned char *in, unsigned long long inlen) {
+    sha512_context_t ctx;
+    sha512_init(&ctx);
+    sha512_update(&ctx, in, (size_t)inlen);
+    sha512_final(&ctx, out);
+    return 0;
+}
+
+// ============================================================================
+// FIELD ARITHMETIC MOD 2^255 - 19
+// ============================================================================
+
+typedef int64_t gf[16];
+
+static const gf gf0 = {0};
+static const gf gf1 = {1};
+static const gf D = {
+    0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070,
+    0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203
+};
+static const gf D2 = {
+    0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0,
+    0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406
+};
+static const gf X = {
+    0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c,
+    0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169
+};
+static const gf Y = {
+    0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666,
+    0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666
+};
+static const gf I = {
+    0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43,
+    0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83
+};
+
+// Group order L, little endian
+static const int64_t L[32] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10
+};
+
+// Constant time: 0 if equal, -1 if not
+static int verify_32(const uint8_t *x, const uint8_t *y) {
+    uint32_t d = 0;
+    for (int i = 0; i < 32; i++) {
+        d |= x[i] ^ y[i];
+    }
+    return (1 & ((d - 1) >> 8)) - 1;
+}
+
+static void set25519(gf r, const gf a) {
+    for (int i = 0; i < 16; i++) {
+        r[i] = a[i];
+    }
+}
+
+static void car25519(gf o) {
+    for (int i = 0; i < 16; i++) {
+        o[i] += (int64_t)1 << 16;
+        int64_t c = o[i] >> 16;
+        o[(i + 1) * (i < 15)] += c - 1 + 37 * (c - 1) * (i == 15);
+        o[i] -= c * 65536;
+    }
+}
+
+static void sel25519(gf p, gf q, int b) {
+    int64_t c = ~(int64_t)(b - 1);
+    for (int i = 0; i < 16; i++) {
+        int64_t t = c & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+static void pack25519(uint8_t *o, const gf n) {
+    gf m, t;
+    set25519(t, n);
+    car25519(t);
+    car25519(t);
+    car25519(t);
+    for (int j = 0; j < 2; j++) {
+        m[0] = t[0] - 0xffed;
+        for (int i = 1; i < 15; i++) {
+            m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+            m[i - 1] &= 0xffff;
+        }
+        m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+        int b = (int)((m[15] >> 16) & 1);
+        m[14] &= 0xffff;
+        sel25519(t, m, 1 - b);
+    }
+    for (int i = 0; i < 16; i++) {
+        o[2 * i] = (uint8_t)(t[i] & 0xff);
+        o[2 * i + 1] = (uint8_t)(t[i] >> 8);
+    }
+}
+
+static int neq25519(const gf a, const gf b) {
+    uint8_t c[32], d[32];
+    pack25519(c, a);
+    pack25519(d, b);
+    return verify_32(c, d);
+}
+
+static uint8_t par25519(const gf a) {
+    uint8_t d[32];
+    pack25519(d, a);
+    return d[0] & 1;
+}
+
+static void unpack25519(gf o, const uint8_t *n) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = n[2 * i] + ((int64_t)n[2 * i + 1] << 8);
+    }
+    o[15] &= 0x7fff;
+}
+
+static void fe_add(gf o, const gf a, const gf b) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = a[i] + b[i];
+    }
+}
+
+static void fe_sub(gf o, const gf a, const gf b) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = a[i] - b[i];
+    }
+}
+
+static void fe_mul(gf o, const gf a, const gf b) {
+    int64_t t[31] = {0};
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            t[i + j] += a[i] * b[j];
+        }
+    }
+    for (int i = 0; i < 15; i++) {
+        t[i] += 38 * t[i + 16];
+    }
+    for (int i = 0; i < 16; i++) {
+        o[i] = t[i];
+    }
+    car25519(o);
+    car25519(o);
+}
+
+static void fe_sq(gf o, const gf a) {
+    fe_mul(o, a, a);
+}
+
+static void inv25519(gf o, const gf i) {
+    gf c;
+    set25519(c, i);
+    for (int a = 253; a >= 0; a--) {
+        fe_sq(c, c);
+        if (a != 2 && a != 4) {
+            fe_mul(c, c, i);
+        }
+    }
+    set25519(o, c);
+}
+
+static void pow2523(gf o, const gf i) {
+    gf c;
+    set25519(c, i);
+    for (int a = 250; a >= 0; a--) {
+        fe_sq(c, c);
+        if (a != 1) {
+            fe_mul(c, c, i);
+        }
+    }
+    set25519(o, c);
+}
+
+// ============================================================================
+// GROUP ARITHMETIC: extended coordinates (X, Y, Z, T)
+// ============================================================================
+
+static void point_add(gf p[4], gf q[4]) {
+    gf a, b, c, d, t, e, f, g, h;
+    fe_sub(a, p[1], p[0]);
+    fe_sub(t, q[1], q[0]);
+    fe_mul(a, a, t);
+    fe_add(b, p[0], p[1]);
+    fe_add(t, q[0], q[1]);
+    fe_mul(b, b, t);
+    fe_mul(c, p[3], q[3]);
+    fe_mul(c, c, D2);
+    fe_mul(d, p[2], q[2]);
+    fe_add(d, d, d);
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+    fe_mul(p[0], e, f);
+    fe_mul(p[1], h, g);
+    fe_mul(p[2], g, f);
+    fe_mul(p[3], e, h);
+}
+
+static void point_cswap(gf p[4], gf q[4], uint8_t b) {
+    for (int i = 0; i < 4; i++) {
+        sel25519(p[i], q[i], b);
+    }
+}
+
+static void point_pack(uint8_t *r, gf p[4]) {
+    gf tx, ty, zi;
+    inv25519(zi, p[2]);
+    fe_mul(tx, p[0], zi);
+    fe_mul(ty, p[1], zi);
+    pack25519(r, ty);
+    r[31] ^= (uint8_t)(par25519(tx) << 7);
+}
+
+static void scalarmult(gf p[4], gf q[4], const uint8_t *s) {
+    set25519(p[0], gf0);
+    set25519(p[1], gf1);
+    set25519(p[2], gf1);
+    set25519(p[3], gf0);
+    for (int i = 255; i >= 0; i--) {
+        uint8_t b = (s[i / 8] >> (i & 7)) & 1;
+        point_cswap(p, q, b);
+        point_add(q, p);
+        point_add(p, p);
+        point_cswap(p, q, b);
+    }
+}
+
+static void scalarbase(gf p[4], const uint8_t *s) {
+    gf q[4];
+    set25519(q[0], X);
+    set25519(q[1], Y);
+    set25519(q[2], gf1);
+    fe_mul(q[3], X, Y);
+    scalarmult(p, q, s);
+}
+
+// Decode a point and negate it; -1 if the bytes are not on the curve
+static int point_unpack_neg(gf r[4], const uint8_t p[32]) {
+    gf t, chk, num, den, den2, den4, den6;
+    set25519(r[2], gf1);
+    unpack25519(r[1], p);
+    fe_sq(num, r[1]);
+    fe_mul(den, num, D);
+    fe_sub(num, num, r[2]);
+    fe_add(den, r[2], den);
+
+    fe_sq(den2, den);
+    fe_sq(den4, den2);
+    fe_mul(den6, den4, den2);
+    fe_mul(t, den6, num);
+    fe_mul(t, t, den);
+
+    pow2523(t, t);
+    fe_mul(t, t, num);
+    fe_mul(t, t, den);
+    fe_mul(t, t, den);
+    fe_mul(r[0], t, den);
+
+    fe_sq(chk, r[0]);
+    fe_mul(chk, chk, den);
+    if (neq25519(chk, num)) {
+        fe_mul(r[0], r[0], I);
+    }
+    fe_sq(chk, r[0]);
+    fe_mul(chk, chk, den);
+    if (neq25519(chk, num)) {
+        return -1;
+    }
+    if (par25519(r[0]) == (p[31] >> 7)) {
+        fe_sub(r[0], gf0, r[0]);
+    }
+    fe_mul(r[3], r[0], r[1]);
+    return 0;
+}
+
+// ============================================================================
+// SCALARS MOD L
+// ============================================================================
+
+static void mod_l(uint8_t *r, int64_t x[64]) {
+    int64_t carry;
+    int i, j;
+    for (i = 63; i >= 32; i--) {
+        carry = 0;
+        for (j = i - 32; j < i - 12; j++) {
+            x[j] += carry - 16 * x[i] * L[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+    carry = 0;
+    for (j = 0; j < 32; j++) {
+        x[j] += carry - (x[31] >> 4) * L[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+    for (j = 0; j < 32; j++) {
+        x[j] -= carry * L[j];
+    }
+    for (i = 0; i < 32; i++) {
+        x[i + 1] += x[i] >> 8;
+        r[i] = (uint8_t)(x[i] & 255);
+    }
+}
+
+// Reduce a 64-byte hash mod L into its first 32 bytes
+static void reduce(uint8_t *r) {
+    int64_t x[64];
+    for (int i = 0; i < 64; i++) {
+        x[i] = r[i];
+    }
+    for (int i = 0; i < 64; i++) {
+        r[i] = 0;
+    }
+    mod_l(r, x);
+}
+
+// S must be below L, or a signature could be altered and still verify
+static int scalar_is_canonical(const uint8_t *s) {
+    for (int i = 31; i >= 0; i--) {
+        if (s[i] != L[i]) {
+            return s[i] < L[i];
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// LIBSODIUM FUNCTION IMPLEMENTATIONS
+// ============================================================================
+
+/**
+ * @brief Derive an Ed25519 key pair from a 32-byte seed
+ *
+ * @param pk Pointer to output public key (crypto_sign_PUBLICKEYBYTES bytes)
+ * @param sk Pointer to output secret key (crypto_sign_SECRETKEYBYTES bytes: seed, then public key)
+ * @param seed Pointer to seed (crypto_sign_SEEDBYTES bytes)
+ * @return 0 on success
+ */
+int crypto_sign_seed_keypair(unsigned char *pk, unsigned char *sk, const unsigned char *seed) {
+    uint8_t d[64];
+    gf p[4];
+    crypto_hash_sha512(d, seed, crypto_sign_SEEDBYTES);
+    d[0] &= 248;
+    d[31] &= 127;
+    d[31] |= 64;
+    scalarbase(p, d);
+    point_pack(pk, p);
+    memcpy(sk, seed, crypto_sign_SEEDBYTES);
+    memcpy(sk + crypto_sign_SEEDBYTES, pk, crypto_sign_PUBLICKEYBYTES);
+    memset(d, 0, sizeof(d));
+    return 0;
+}
+
+/**
+ * @brief Sign a message, returning the signature separately
+ *
+ * @param sig Pointer to output signature (crypto_sign_BYTES bytes)
+ * @param siglen_p Set to crypto_sign_BYTES; may be NULL
+ * @param m Pointer to message buffer
+ * @param mlen Length of the message
+ * @param sk Pointer to secret key (crypto_sign_SECRETKEYBYTES bytes)
+ * @return 0 on success
+ */
+int crypto_sign_detached(unsigned char *sig, unsigned long long *siglen_p,
+                         const unsigned char *m, unsigned long long mlen,
+                         const unsigned char *sk) {
+    uint8_t d[64], r[64], h[64];
+    int64_t x[64];
+    gf p[4];
+    sha512_context_t ctx;
+
+    crypto_hash_sha512(d, sk, crypto_sign_SEEDBYTES);
+    d[0] &= 248;
+    d[31] &= 127;
+    d[31] |= 64;
+
+    // r = H(prefix || M), R = rB
+    sha512_init(&ctx);
+    sha512_update(&ctx, d + 32, 32);
+    sha512_update(&ctx, m, (size_t)mlen);
+    sha512_final(&ctx, r);
+    reduce(r);
+    scalarbase(p, r);
+    point_pack(sig, p);
+
+    // S = r + H(R || A || M) * a mod L
+    sha512_init(&ctx);
+    sha512_update(&ctx, sig, 32);
+    sha512_update(&ctx, sk + crypto_sign_SEEDBYTES, crypto_sign_PUBLICKEYBYTES);
+    sha512_update(&ctx, m, (size_t)mlen);
+    sha512_final(&ctx, h);
+    reduce(h);
+
+    for (int i = 0; i < 64; i++) {
+        x[i] = i < 32 ? r[i] : 0;
+    }
+    for (int i = 0; i < 32; i++) {
+        for (int j = 0; j < 32; j++) {
+            x[i + j] += (int64_t)h[i] * d[j];
+        }
+    }
+    mod_l(sig + 32, x);
+
+    memset(d, 0, sizeof(d));
+    memset(r, 0, sizeof(r));
+    if (siglen_p != NULL) {
+        *siglen_p = crypto_sign_BYTES;
+    }
+    return 0;
+}
+
+/**
+ * @brief Verify a detached signature
+ *
+ * @param sig Pointer to signature (crypto_sign_BYTES bytes)
+ * @param m Pointer to message buffer
+ * @param mlen Length of the message
+ * @param pk Pointer to public key (crypto_sign_PUBLICKEYBYTES bytes)
+ * @return 0 if the signature is valid, -1 if not
+ */
+int crypto_sign_verify_detached(const unsigned char *sig, const unsigned char *m,
+                                unsigned long long mlen, const unsigned char *pk) {
+    uint8_t h[64], check[32];
+    gf p[4], q[4];
+    sha512_context_t ctx;
+
+    if (sig == NULL || pk == NULL || (m == NULL && mlen > 0)) {
+        return -1;
+    }
+    if (!scalar_is_canonical(sig + 32) || point_unpack_neg(q, pk) != 0) {
+        return -1;
+    }
+
+    sha512_init(&ctx);
+    sha512_update(&ctx, sig, 32);
+    sha512_update(&ctx, pk, crypto_sign_PUBLICKEYBYTES);
+    sha512_update(&ctx, m, (size_t)mlen);
+    sha512_final(&ctx, h);
+    reduce(h);
+
+    // SB - hA must equal R
+    scalarmult(p, q, h);
+    scalarbase(q, sig + 32);
+    point_add(p, q);
+    point_pack(check, p);
+    return verify_32(sig, check);
+}
@@ -1,6 +1,8 @@
 #ifndef SODIUM_H
 #define SODIUM_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,6 +16,15 @@ extern "C" {
 #define crypto_secretbox_NONCEBYTES 24U
 #define crypto_secretbox_MACBYTES 16U
 
+// Public-key signatures (crypto_sign, Ed25519)
+#define crypto_sign_BYTES 64U
+#define crypto_sign_SEEDBYTES 32U
+#define crypto_sign_PUBLICKEYBYTES 32U
+#define crypto_sign_SECRETKEYBYTES 64U
+
+// Hashing (crypto_hash_sha512)
+#define crypto_hash_sha512_BYTES 64U
+
 // ============================================================================
 // LIBSODIUM FUNCTION DECLARATIONS
 // ============================================================================
@@ -70,6 +81,57 @@ int crypto_secretbox_open_easy(unsigned char *m, const unsigned char *c,
                                unsigned long long clen, const unsigned char *n,
                                const unsigned char *k);
 
+/**
+ * @brief SHA-512 of a message
+ *
+ * @param out Pointer to output buffer (crypto_hash_sha512_BYTES bytes)
+ * @param in Pointer to input message buffer
+ * @param inlen Length of the input message
+ * @return 0 on success
+ */
+int crypto_hash_sha512(unsigned char *out, const unsigned char *in,
+                       unsigned long long inlen);
+
+/**
+ * @brief Derive an Ed25519 key pair from a seed
+ *
+ * The same seed always gives the same key pair, so only the seed needs to
+ * be kept secret.
+ *
+ * @param pk Pointer to output public key (crypto_sign_PUBLICKEYBYTES bytes)
+ * @param sk Pointer to output secret key (crypto_sign_SECRETKEYBYTES bytes)
+ * @param seed Pointer to seed buffer (crypto_sign_SEEDBYTES bytes)
+ * @return 0 on success
+ */
+int crypto_sign_seed_keypair(unsigned char *pk, unsigned char *sk,
+                             const unsigned char *seed);
+
+/**
+ * @brief Sign a message with Ed25519, returning the signature separately
+ *
+ * @param sig Pointer to output signature (crypto_sign_BYTES bytes)
+ * @param siglen_p Set to the signature length; may be NULL
+ * @param m Pointer to message buffer
+ * @param mlen Length of the message
+ * @param sk Pointer to secret key (crypto_sign_SECRETKEYBYTES bytes)
+ * @return 0 on success
+ */
+int crypto_sign_detached(unsigned char *sig, unsigned long long *siglen_p,
+                         const unsigned char *m, unsigned long long mlen,
+                         const unsigned char *sk);
+
+/**
+ * @brief Verify a detached Ed25519 signature
+ *
+ * @param sig Pointer to signature (crypto_sign_BYTES bytes)
+ * @param m Pointer to message buffer
+ * @param mlen Length of the message
+ * @param pk Pointer to public key (crypto_sign_PUBLICKEYBYTES bytes)
+ * @return 0 if the signature is valid, -1 if not
+ */
+int crypto_sign_verify_detached(const unsigned char *sig, const unsigned char *m,
+                                unsigned long long mlen, const unsigned char *pk);
+
 #ifdef __cplusplus
 }
 #endif
@@ -160,15 +160,15 @@ int crypto_secretbox_easy(unsigned char *c, const unsigned char *m,
     chacha20_init(&ctx, k, n);
 
     // Generate keystream for message
+    // chacha20_block() writes whole 64-byte blocks, so round the buffer up
     size_t keystream_len = (size_t)mlen + crypto_secretbox_MACBYTES;
-    unsigned char *keystream = (unsigned char *)malloc(keystream_len);
+    unsigned char *keystream = (unsigned char *)malloc((keystream_len + 63) & ~(size_t)63);
     if (keystream == NULL) {
         return -1;
     }
 
     // Generate keystream blocks
     for (size_t i = 0; i < keystream_len; i += 64) {
-        size_t block_size = (keystream_len - i) > 64 ? 64 : (keystream_len - i);
         chacha20_block(&ctx, keystream + i);
     }
 
@@ -219,14 +219,14 @@ int crypto_secretbox_open_easy(unsigned char *m, const unsigned char *c,
     chacha20_init(&ctx, k, n);
 
     // Generate keystream for message
-    unsigned char *keystream = (unsigned char *)malloc(mlen);
+    // Whole 64-byte blocks, as in crypto_secretbox_easy()
+    unsigned char *keystream = (unsigned char *)malloc((mlen + 63) & ~(size_t)63);
     if (keystream == NULL) {
         return -1;
     }
 
     // Generate keystream blocks
     for (size_t i = 0; i < mlen; i += 64) {
-        size_t block_size = (mlen - i) > 64 ? 64 : (mlen - i);
         chacha20_block(&ctx, keystream + i);
     }
 
@@ -0,0 +1,500 @@
+/**
+ * @file audio_pipeline_sim.cpp
+ * @brief Voice through the audio pipeline while talking and listening, one task against lanes per core
+ *
+ * Runs the firmware's AudioPipeline, with the stages and lanes of
+ * audio_pipeline_build() and audio_pipeline_profile(), in virtual time.
+ * What each stage does to a frame is modelled: it costs the time in
+ * STAGE_US below (--encode-us and --decode-us set the codec's share) and
+ * the payload is not touched.
+ *
+ * The PTT is held for --talk-s, released for --listen-s, and so on; the
+ * mic has a frame every 20 ms while it is held. A remote talker's frames
+ * arrive every 20 ms the whole run, with up to --jitter-ms of extra
+ * delay, so both directions run at once while the PTT is held. The mic
+ * keeps --mic-frames frames in DMA before the oldest is overwritten; the
+ * socket queues --socket-frames.
+ *
+ * Three layouts:
+ *
+ * - "task": the audio task before the pipeline. One loop on one core,
+ *   one frame per 20 ms tick: sent while the PTT is held, received
+ *   otherwise. The socket is not read while talking, so what queued there
+ *   plays late after release
+ * - "single": the pipeline as one lane, the profile for one core
+ * - "dual": a TX lane and an RX lane on their own cores, the profile for
+ *   two cores
+ *
+ * The pipelines run as the firmware's: the socket is read while talking,
+ * sidetone takes the newest mic frame, and the jitter buffer discards
+ * frames older than AUDIO_RX_MAX_LATENCY_US. A lane's tick runs its
+ * stages in turn; the next starts 20 ms after the last began, or at once
+ * if the tick ran over.
+ *
+ * Reported per layout: the share of frames that got through each way,
+ * latency from mic or arrival to send or playout (mean, p99), the same
+ * for received frames played in the first second after each release,
+ * sidetone latency, each core's load and the frames lost; then each stage
+ * of the dual layout.
+ *
+ * Exit status: 0 if the dual layout carried at least 99% of the frames
+ * each way, dropped none between stages and kept the p99 latency each way
+ * and after release within --budget-ms; 1 if not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "audio_pipeline.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+static const int64_t FRAME_US = 20000;
+static const size_t FRAME_BYTES = 640;              // 320 samples of 16-bit PCM
+static const int64_t MIC_PHASE_US = 7000;           // Mic frames are not aligned with the ticks
+static const int64_t NET_DELAY_US = 5000;           // Sender to socket, before jitter
+static const int RX_MAX_PER_TICK = 4;               // As the firmware's receive stage
+static const int64_t RELEASE_WINDOW_US = 1000000;   // As the firmware's release latency histogram
+
+// Modelled cost of one frame through each stage on the XIAO ESP32S3 at 240 MHz, in us
+static uint32_t STAGE_US[AUDIO_STAGE_COUNT] = {
+    150,    // capture: i2s_read of one frame
+    350,    // dsp: high-pass biquad over 320 samples
+    6000,   // encode: a voice codec at 24 kbit/s; --encode-us
+    600,    // send: talkgroup header, lwIP, recorder copy
+    500,    // receive: recvfrom, talkgroup filter, recorder copy
+    20,     // jitter
+    2500,   // decode; --decode-us
+    60,     // sidetone: gain over 320 samples
+    150,    // mix: duck and add the sidetone
+    150,    // playout: i2s_write
+};
+static const uint32_t POLL_US = 20;                 // A source stage that finds nothing
+
+struct Options {
+    double seconds = 30;
+    double talkS = 4;
+    double listenS = 2;
+    double jitterMs = 15;
+    int micFrames = 4;
+    int socketFrames = 8;
+    double budgetMs = 80;
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+struct Result {
+    std::string name;
+    uint32_t micFrames = 0;
+    uint32_t rxFrames = 0;
+    uint32_t sent = 0;
+    uint32_t played = 0;
+    SimStat txMs;
+    SimStat rxMs;
+    SimStat releaseMs;
+    SimStat sidetoneMs;
+    double coreLoad[2] = {0, 0};
+    uint32_t micDropped = 0;
+    uint32_t socketDropped = 0;
+    uint32_t discarded = 0;                         // Too old for the jitter buffer
+    uint32_t ringDropped = 0;
+};
+
+// ============================================================================
+// TRAFFIC
+// ============================================================================
+
+static int64_t g_now = 0;
+
+static int64_t sim_clock(void) {
+    return g_now;
+}
+
+// The PTT, the mic's DMA buffers and the voice socket, as virtual time passes
+struct Traffic {
+    const Options& options;
+    int64_t endUs;
+    int64_t cycleUs;
+    int64_t talkUs;
+    int64_t nextMicUs = MIC_PHASE_US;
+    std::deque<int64_t> mic;                        // Ready times
+    std::vector<int64_t> arrivals;                  // Sorted
+    size_t nextArrival = 0;
+    std::deque<int64_t> socket;                     // Arrival times
+    Result& result;
+
+    Traffic(const Options& o, Result& r)
+        : options(o), endUs((int64_t)(o.seconds * 1e6)), cycleUs((int64_t)((o.talkS + o.listenS) * 1e6)),
+          talkUs((int64_t)(o.talkS * 1e6)), result(r) {
+        std::mt19937 rng(o.seed);
+        std::uniform_real_distribution<double> jitter(0, o.jitterMs * 1000);
+        for (int64_t sent = 3000; sent < endUs; sent += FRAME_US) {
+            arrivals.push_back(sent + NET_DELAY_US + (int64_t)jitter(rng));
+        }
+        std::sort(arrivals.begin(), arrivals.end());
+    }
+
+    bool talking(int64_t t) const { return t % cycleUs < talkUs; }
+
+    // Received voice played now counts towards release latency
+    bool afterRelease(int64_t t) const {
+        int64_t sinceRelease = t % cycleUs - talkUs;
+        return t >= talkUs && sinceRelease >= 0 && sinceRelease < RELEASE_WINDOW_US;
+    }
+
+    void feed(int64_t now) {
+        for (; nextMicUs <= now && nextMicUs < endUs; nextMicUs += FRAME_US) {
+            if (!talking(nextMicUs)) {
+                continue;
+            }
+            result.micFrames++;
+            mic.push_back(nextMicUs);
+            if ((int)mic.size() > options.micFrames) {
+                mic.pop_front();                    // DMA overwrote it
+                result.micDropped++;
+            }
+        }
+        for (; nextArrival < arrivals.size() && arrivals[nextArrival] <= now; nextArrival++) {
+            result.rxFrames++;
+            if ((int)socket.size() < options.socketFrames) {
+                socket.push_back(arrivals[nextArrival]);
+            } else {
+                result.socketDropped++;
+            }
+        }
+        if (!talking(now)) {
+            mic.clear();                            // I2S is not read after release
+        }
+    }
+
+    bool takeMic(int64_t* readyUs) {
+        feed(g_now);
+        if (mic.empty()) {
+            return false;
+        }
+        *readyUs = mic.front();
+        mic.pop_front();
+        return true;
+    }
+
+    bool takeSocket(int64_t* arrivalUs) {
+        feed(g_now);
+        if (socket.empty()) {
+            return false;
+        }
+        *arrivalUs = socket.front();
+        socket.pop_front();
+        return true;
+    }
+
+    void played(int64_t arrivalUs) {
+        double ms = std::max((g_now - arrivalUs) / 1000.0, 0.0);
+        result.played++;
+        result.rxMs.add(ms);
+        if (afterRelease(g_now)) {
+            result.releaseMs.add(ms);
+        }
+    }
+};
+
+// ============================================================================
+// STAGES
+// ============================================================================
+
+static uint8_t s_payload[AUDIO_PIPELINE_MAX_FRAME];
+
+static int sim_source(AudioPipeline& pipeline, int stage, Traffic* traffic) {
+    int handled = 0;
+    int limit = stage == AUDIO_STAGE_RECEIVE ? RX_MAX_PER_TICK : 1;
+    int64_t originUs;
+    while (handled < limit &&
+           (stage == AUDIO_STAGE_RECEIVE ? traffic->takeSocket(&originUs) : traffic->takeMic(&originUs))) {
+        g_now += STAGE_US[stage];
+        audio_frame_t frame = {};
+        frame.origin_us = originUs;
+        frame.length = FRAME_BYTES;
+        frame.flags = stage == AUDIO_STAGE_RECEIVE ? AUDIO_FRAME_LIVE : AUDIO_FRAME_PCM;
+        pipeline.push(stage, frame, s_payload);
+        handled++;
+    }
+    if (handled == 0) {
+        g_now += POLL_US;
+    }
+    return handled;
+}
+
+// Every frame waiting, at the stage's cost each; sinks count theirs
+static int sim_filter(AudioPipeline& pipeline, int stage, Traffic* traffic) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_payload, sizeof(s_payload)) > 0) {
+        g_now += STAGE_US[stage];
+        if (stage == AUDIO_STAGE_SEND) {
+            pipeline.done(stage, frame);
+            traffic->result.sent++;
+            traffic->result.txMs.add(std::max((g_now - frame.origin_us) / 1000.0, 0.0));
+        } else if (stage == AUDIO_STAGE_PLAYOUT) {
+            pipeline.done(stage, frame);
+            traffic->played(frame.origin_us);
+        } else {
+            pipeline.push(stage, frame, s_payload);
+        }
+        handled++;
+    }
+    return handled;
+}
+
+static bool s_jitterPrimed = false;
+
+// The firmware's jitter buffer: primes, then one frame per tick, discarding a stale backlog
+static int sim_jitter(AudioPipeline& pipeline, int stage, Traffic* traffic) {
+    uint32_t depth = pipeline.depth(stage);
+    if (depth == 0) {
+        s_jitterPrimed = false;
+        return 0;
+    }
+    if (!s_jitterPrimed && depth < AUDIO_JITTER_PRIME_FRAMES) {
+        return 0;
+    }
+    s_jitterPrimed = true;
+    audio_frame_t frame;
+    while (pipeline.pop(stage, &frame, s_payload, sizeof(s_payload)) > 0) {
+        g_now += STAGE_US[stage];
+        if (g_now - frame.origin_us <= AUDIO_RX_MAX_LATENCY_US) {
+            pipeline.push(stage, frame, s_payload);
+            return 1;
+        }
+        traffic->result.discarded++;
+    }
+    return 0;
+}
+
+// The newest mic frame only; it plays in this tick's mix
+static int sim_sidetone(AudioPipeline& pipeline, int stage, Traffic* traffic) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_payload, sizeof(s_payload)) > 0) {
+        handled++;
+        if (pipeline.depth(stage) == 0) {
+            g_now += STAGE_US[stage];
+            pipeline.done(stage, frame);
+            traffic->result.sidetoneMs.add(std::max(
+                (g_now + STAGE_US[AUDIO_STAGE_MIX] + STAGE_US[AUDIO_STAGE_PLAYOUT] - frame.origin_us) / 1000.0, 0.0));
+        }
+    }
+    return handled;
+}
+
+static int sim_stage(AudioPipeline& pipeline, int stage, void* ctx) {
+    Traffic* traffic = (Traffic*)ctx;
+    switch (stage) {
+    case AUDIO_STAGE_CAPTURE:
+    case AUDIO_STAGE_RECEIVE:
+        return sim_source(pipeline, stage, traffic);
+    case AUDIO_STAGE_JITTER:
+        return sim_jitter(pipeline, stage, traffic);
+    case AUDIO_STAGE_SIDETONE:
+        return sim_sidetone(pipeline, stage, traffic);
+    default:
+        return sim_filter(pipeline, stage, traffic);
+    }
+}
+
+// ============================================================================
+// LAYOUTS
+// ============================================================================
+
+// The pipeline in the profile's lanes, each lane on its own core
+static void run_pipeline(const Options& options, int cores, Result* result, AudioPipeline* pipeline) {
+    Traffic traffic(options, *result);
+    audio_stage_fn_t fns[AUDIO_STAGE_COUNT];
+    void* ctx[AUDIO_STAGE_COUNT];
+    for (int id = 0; id < AUDIO_STAGE_COUNT; id++) {
+        fns[id] = sim_stage;
+        ctx[id] = &traffic;
+    }
+    const audio_profile_t& profile = audio_pipeline_profile(cores);
+    result->name = profile.name;
+    g_now = 0;
+    s_jitterPrimed = false;
+    if (!audio_pipeline_build(pipeline, fns, ctx) || !pipeline->configure(profile)) {
+        fprintf(stderr, "Pipeline setup failed\n");
+        exit(1);
+    }
+
+    // Lanes run side by side; the one whose tick is due first goes next
+    std::vector<int64_t> next(profile.lanes, 0);
+    for (;;) {
+        int lane = (int)(std::min_element(next.begin(), next.end()) - next.begin());
+        if (next[lane] >= traffic.endUs) {
+            break;
+        }
+        g_now = next[lane];
+        pipeline->runLane(lane);
+        next[lane] = std::max(next[lane] + FRAME_US, g_now);
+    }
+
+    for (int lane = 0; lane < profile.lanes; lane++) {
+        result->coreLoad[profile.lane[lane].core] = 100.0 * pipeline->laneStats(lane).busyUs / traffic.endUs;
+    }
+    for (int id = 0; id < AUDIO_STAGE_COUNT; id++) {
+        result->ringDropped += pipeline->stage(id).dropped;
+    }
+}
+
+// The audio task before the pipeline: one frame per tick, sent while
+// talking, received otherwise
+static void run_task(const Options& options, Result* result) {
+    Traffic traffic(options, *result);
+    result->name = "task";
+    uint64_t busyUs = 0;
+    for (int64_t tick = 0; tick < traffic.endUs;) {
+        g_now = tick;
+        traffic.feed(g_now);
+        int64_t originUs;
+        if (traffic.talking(g_now)) {
+            if (traffic.takeMic(&originUs)) {
+                g_now += STAGE_US[AUDIO_STAGE_CAPTURE] + STAGE_US[AUDIO_STAGE_ENCODE] + STAGE_US[AUDIO_STAGE_SEND];
+                result->sent++;
+                result->txMs.add(std::max((g_now - originUs) / 1000.0, 0.0));
+            } else {
+                g_now += POLL_US;
+            }
+        } else if (traffic.takeSocket(&originUs)) {
+            g_now += STAGE_US[AUDIO_STAGE_RECEIVE] + STAGE_US[AUDIO_STAGE_DECODE] + STAGE_US[AUDIO_STAGE_PLAYOUT];
+            traffic.played(originUs);
+        } else {
+            g_now += POLL_US;
+        }
+        busyUs += g_now - tick;
+        tick = std::max(tick + FRAME_US, g_now);
+    }
+    result->coreLoad[1] = 100.0 * busyUs / traffic.endUs;       // audioTask was pinned to core 1
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static void print_stages(const AudioPipeline& pipeline) {
+    printf("\ndual stages:\n");
+    printf("  %-8s %4s %7s %10s %10s %10s %8s\n", "stage", "lane", "frames", "latency ms", "run us",
+           "max run us", "dropped");
+    for (int id = 0; id < AUDIO_STAGE_COUNT; id++) {
+        const audio_stage_t& stage = pipeline.stage(id);
+        printf("  %-8s %4d %7u %10.1f %10.0f %10u %8u\n", stage.name, stage.lane, (unsigned)stage.frames,
+               stage.frames ? stage.latencyUs / 1000.0 / stage.frames : 0.0,
+               stage.runs ? (double)stage.busyUs / stage.runs : 0.0, (unsigned)stage.maxRunUs,
+               (unsigned)stage.dropped);
+    }
+}
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<Result>& results,
+                       const AudioPipeline& pipeline) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("seconds", options.seconds);
+    json.add("talk_s", options.talkS);
+    json.add("listen_s", options.listenS);
+    json.add("jitter_ms", options.jitterMs);
+    json.add("budget_ms", options.budgetMs);
+    json.beginObject("stage_us");
+    for (int id = 0; id < AUDIO_STAGE_COUNT; id++) {
+        json.add(pipeline.stage(id).name, STAGE_US[id]);
+    }
+    json.endObject();
+    json.beginArray("layouts");
+    for (const Result& r : results) {
+        json.beginObject();
+        json.add("name", r.name);
+        json.add("tx_pct", sim_share(r.sent, r.micFrames));
+        json.add("rx_pct", sim_share(r.played, r.rxFrames));
+        json.add("tx_mean_ms", r.txMs.mean());
+        json.add("tx_p99_ms", r.txMs.pct(0.99));
+        json.add("rx_mean_ms", r.rxMs.mean());
+        json.add("rx_p99_ms", r.rxMs.pct(0.99));
+        json.add("release_p99_ms", r.releaseMs.pct(0.99));
+        json.add("release_max_ms", r.releaseMs.max());
+        json.add("sidetone_mean_ms", r.sidetoneMs.mean());
+        json.add("core0_load_pct", r.coreLoad[0]);
+        json.add("core1_load_pct", r.coreLoad[1]);
+        json.add("mic_dropped", r.micDropped);
+        json.add("socket_dropped", r.socketDropped);
+        json.add("discarded", r.discarded);
+        json.add("ring_dropped", r.ringDropped);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--seconds", "S", &options.seconds);
+    args.add("--talk-s", "S", &options.talkS);
+    args.add("--listen-s", "S", &options.listenS);
+    args.add("--jitter-ms", "MS", &options.jitterMs);
+    args.add("--encode-us", "US", &STAGE_US[AUDIO_STAGE_ENCODE]);
+    args.add("--decode-us", "US", &STAGE_US[AUDIO_STAGE_DECODE]);
+    args.add("--mic-frames", "N", &options.micFrames);
+    args.add("--socket-frames", "N", &options.socketFrames);
+    args.add("--budget-ms", "MS", &options.budgetMs);
+    args.add("--seed", "N", &options.seed);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv) ||
+        !args.check(options.seconds >= 1 && options.seconds <= 3600 && options.talkS > 0 && options.listenS > 0 &&
+                    options.jitterMs >= 0 && options.micFrames >= 1 && options.socketFrames >= 1 &&
+                    options.budgetMs > 0)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    std::vector<Result> results(3);
+    run_task(options, &results[0]);
+    AudioPipeline single(sim_clock);
+    run_pipeline(options, 1, &results[1], &single);
+    AudioPipeline dual(sim_clock);
+    run_pipeline(options, 2, &results[2], &dual);
+
+    printf("%.0f s, PTT %.1f s held / %.1f s released, jitter up to %.0f ms, encode %u us, decode %u us\n\n",
+           options.seconds, options.talkS, options.listenS, options.jitterMs,
+           (unsigned)STAGE_US[AUDIO_STAGE_ENCODE], (unsigned)STAGE_US[AUDIO_STAGE_DECODE]);
+    printf("  %-7s %6s %6s %12s %12s %15s %8s %7s %7s %14s\n", "layout", "tx %", "rx %", "tx ms",
+           "rx ms", "release ms", "sidetone", "core0 %", "core1 %", "lost mic/rx/old");
+    for (const Result& r : results) {
+        printf("  %-7s %6.1f %6.1f %5.1f/%6.1f %5.1f/%6.1f %7.1f/%7.1f %8.1f %7.1f %7.1f %6u/%u/%u\n",
+               r.name.c_str(), sim_share(r.sent, r.micFrames), sim_share(r.played, r.rxFrames), r.txMs.mean(),
+               r.txMs.pct(0.99), r.rxMs.mean(), r.rxMs.pct(0.99), r.releaseMs.pct(0.99), r.releaseMs.max(),
+               r.sidetoneMs.mean(), r.coreLoad[0], r.coreLoad[1], (unsigned)r.micDropped,
+               (unsigned)r.socketDropped, (unsigned)r.discarded);
+    }
+    printf("  tx and rx: mean/p99; release: p99/max in the first second after release; sidetone: mean ms\n");
+    printf("  modelled stage costs; single is the one-core profile, task ran on core 1\n");
+    print_stages(dual);
+
+    const Result& d = results[2];
+    bool ok = sim_share(d.sent, d.micFrames) >= 99.0 && sim_share(d.played, d.rxFrames) >= 99.0 && d.ringDropped == 0 &&
+              d.txMs.pct(0.99) <= options.budgetMs && d.rxMs.pct(0.99) <= options.budgetMs &&
+              d.releaseMs.pct(0.99) <= options.budgetMs;
+    printf("\ndual: %.1f%% tx, %.1f%% rx, p99 %.1f / %.1f ms, %.1f ms after release, against a %.0f ms budget%s\n",
+           sim_share(d.sent, d.micFrames), sim_share(d.played, d.rxFrames), d.txMs.pct(0.99), d.rxMs.pct(0.99),
+           d.releaseMs.pct(0.99), options.budgetMs, ok ? "" : " -- CHECK FAILED");
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, results, dual)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return ok ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
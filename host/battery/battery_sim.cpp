@@ -0,0 +1,364 @@
+/**
+ * @file battery_sim.cpp
+ * @brief Fuel gauge accuracy, runtime estimate and charge levels over a recorded discharge
+ *
+ * Replays a discharge curve (--curve, CSV of time_s, battery_mv and
+ * current_ma; default host/battery/data/lipo_1500mah_discharge.csv)
+ * through BatteryGauge the way battery_service.cpp feeds it: one sample
+ * every --sample-s seconds of the pin voltage behind the 1:2 divider, with
+ * --noise-mv of ADC noise and 12-bit quantisation, and the load current
+ * from the current model. Within each recorded minute the load is not
+ * steady: with probability --burst a sample lands on a transmit burst
+ * (150 mA above the minute's mean, the other samples correspondingly
+ * below it), and the terminal voltage moves by the cell's --cell-mohm.
+ * The current model is --model-error off (0.2: it reads 20% high).
+ *
+ * The truth comes from the curve itself: the charge left at each moment is
+ * the current integrated from there to the cutoff, and the time left is
+ * the time to the cutoff.
+ *
+ * Two gauges run side by side:
+ * - "gauge": battery_gauge_default_config(), with --capacity-mah if given.
+ * - "raw": the same table on each reading as it comes, without load
+ *   compensation or smoothing.
+ *
+ * Reported at every 10% of true charge: the gauge's and raw reading,
+ * true and estimated minutes left, and the level. Then per gauge: mean and
+ * worst charge error, runtime error at 50% and 20%, and each level change
+ * with the true charge at that moment.
+ *
+ * Exit status: 0 if the gauge stays within 10 points of the true charge,
+ * reaches CRITICAL and changes level no more than twice (NORMAL, LOW,
+ * CRITICAL, without flapping), 1 if not, 2 on bad arguments or an
+ * unreadable curve.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "battery_gauge.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef AIRCOM_BATTERY_DATA_DIR
+#define AIRCOM_BATTERY_DATA_DIR "host/battery/data"
+#endif
+
+static const double BURST_MA = 150;                 // Transmit burst above the minute's mean
+static const double ADC_FULL_SCALE_MV = 3100;       // battery_service.cpp, 12 dB attenuation
+static const double MAX_ERROR_POINTS = 10;
+static const size_t MAX_CHANGES_PRINTED = 6;
+
+struct Options {
+    std::string curvePath = std::string(AIRCOM_BATTERY_DATA_DIR) + "/lipo_1500mah_discharge.csv";
+    double sampleS = 5;
+    double noiseMv = 8;
+    double cellMohm = 180;
+    double modelError = 0.2;
+    double burst = 0.1;
+    double capacityMah = 0;                         // 0: the gauge's default
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+struct Row {
+    double timeS;
+    double mv;
+    double ma;
+};
+
+struct Curve {
+    std::vector<Row> rows;
+    std::vector<double> remainingMah;               // From each row to the cutoff
+    double totalMah = 0;
+};
+
+struct LevelChange {
+    double timeH;
+    double truePercent;
+    battery_level_t level;
+};
+
+struct Checkpoint {
+    int truePercent;
+    double timeH;
+    double gaugePercent;
+    double rawPercent;
+    double trueMinutes;
+    uint32_t gaugeMinutes;
+    battery_level_t level;
+};
+
+struct GaugeResult {
+    std::string name;
+    double sumError = 0;
+    double maxError = 0;
+    uint32_t samples = 0;
+    double runtimeError50 = NAN;                    // Estimated / true minutes - 1
+    double runtimeError20 = NAN;
+    std::vector<LevelChange> changes;
+    battery_level_t finalLevel = BATTERY_LEVEL_NORMAL;
+
+    double meanError() const { return samples ? sumError / samples : 0; }
+};
+
+// ============================================================================
+// CURVE
+// ============================================================================
+
+static bool load_curve(const std::string& path, Curve* curve) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        Row row;
+        if (line[0] == '#' || sscanf(line, "%lf,%lf,%lf", &row.timeS, &row.mv, &row.ma) != 3) {
+            continue;                               // Comments and the column header
+        }
+        if (!curve->rows.empty() && row.timeS <= curve->rows.back().timeS) {
+            fclose(file);
+            return false;
+        }
+        curve->rows.push_back(row);
+    }
+    fclose(file);
+    if (curve->rows.size() < 2) {
+        return false;
+    }
+
+    // Each row's current flows until the next row
+    size_t n = curve->rows.size();
+    curve->remainingMah.assign(n, 0.0);
+    for (size_t i = n - 1; i-- > 0;) {
+        double hours = (curve->rows[i + 1].timeS - curve->rows[i].timeS) / 3600.0;
+        curve->remainingMah[i] = curve->remainingMah[i + 1] + curve->rows[i].ma * hours;
+    }
+    curve->totalMah = curve->remainingMah[0];
+    return true;
+}
+
+// Row values and true charge left at time t, interpolated
+static void curve_at(const Curve& curve, double t, double* mv, double* ma, double* remainingMah) {
+    const std::vector<Row>& rows = curve.rows;
+    size_t i = 0;
+    while (i + 2 < rows.size() && rows[i + 1].timeS <= t) {
+        i++;
+    }
+    double f = (t - rows[i].timeS) / (rows[i + 1].timeS - rows[i].timeS);
+    f = std::min(1.0, std::max(0.0, f));
+    *mv = rows[i].mv + f * (rows[i + 1].mv - rows[i].mv);
+    *ma = rows[i].ma;
+    *remainingMah = curve.remainingMah[i] - f * (curve.remainingMah[i] - curve.remainingMah[i + 1]);
+}
+
+// ============================================================================
+// REPLAY
+// ============================================================================
+
+static battery_gauge_config_t raw_config(const battery_gauge_config_t& config) {
+    battery_gauge_config_t raw = config;
+    raw.voltage_alpha = 1.0f;
+    raw.current_alpha = 1.0f;
+    raw.internal_mohm = 0.0f;
+    return raw;
+}
+
+static void track(GaugeResult* result, const BatteryGauge& gauge, bool changed, double t, double truePercent,
+                  double trueMinutes) {
+    const battery_status_t& status = gauge.status();
+    double error = std::fabs(status.percent - truePercent);
+    result->sumError += error;
+    result->maxError = std::max(result->maxError, error);
+    result->samples++;
+    if (std::isnan(result->runtimeError50) && truePercent <= 50) {
+        result->runtimeError50 = status.minutes / trueMinutes - 1;
+    }
+    if (std::isnan(result->runtimeError20) && truePercent <= 20) {
+        result->runtimeError20 = status.minutes / trueMinutes - 1;
+    }
+    if (changed) {
+        result->changes.push_back({ t / 3600.0, truePercent, status.level });
+    }
+    result->finalLevel = status.level;
+}
+
+static void replay(const Options& options, const Curve& curve, const battery_gauge_config_t& config,
+                   GaugeResult* gaugeResult, GaugeResult* rawResult, std::vector<Checkpoint>* checkpoints) {
+    std::mt19937 rng(options.seed);
+    std::normal_distribution<double> noise(0.0, options.noiseMv);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    BatteryGauge gauge(config);
+    BatteryGauge raw(raw_config(config));
+    gaugeResult->name = "gauge";
+    rawResult->name = "raw";
+
+    double end = curve.rows.back().timeS;
+    int nextCheckpoint = 100;
+    for (double t = 0; t < end; t += options.sampleS) {
+        double mv, ma, remainingMah;
+        curve_at(curve, t, &mv, &ma, &remainingMah);
+
+        // What the ADC sees at this instant, and what the model says is drawn.
+        // Bursts are part of the minute's mean, so the rest of it is lower.
+        double quietMa = options.burst < 1 ? std::max(0.0, ma - options.burst * BURST_MA / (1 - options.burst)) : ma;
+        double loadMa = uniform(rng) < options.burst ? ma + BURST_MA : quietMa;
+        double terminalMv = mv - (loadMa - ma) * options.cellMohm / 1000.0;
+        double pinMv = terminalMv / config.divider + noise(rng);
+        int adcRaw = (int)std::lround(pinMv * 4095 / ADC_FULL_SCALE_MV);
+        adcRaw = std::min(4095, std::max(0, adcRaw));
+        uint32_t reading = (uint32_t)(adcRaw * (int)ADC_FULL_SCALE_MV / 4095);
+        float modelMa = (float)(loadMa * (1.0 + options.modelError));
+
+        bool gaugeChanged = gauge.addSample(reading, modelMa);
+        bool rawChanged = raw.addSample(reading, modelMa);
+
+        double truePercent = 100.0 * remainingMah / curve.totalMah;
+        double trueMinutes = (end - t) / 60.0;
+        track(gaugeResult, gauge, gaugeChanged, t, truePercent, trueMinutes);
+        track(rawResult, raw, rawChanged, t, truePercent, trueMinutes);
+
+        while (nextCheckpoint >= 0 && truePercent <= nextCheckpoint) {
+            checkpoints->push_back({ nextCheckpoint, t / 3600.0, gauge.status().percent, raw.status().percent,
+                                     trueMinutes, gauge.status().minutes, gauge.status().level });
+            nextCheckpoint -= 10;
+        }
+    }
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static void print_result(const GaugeResult& r) {
+    printf("%s: charge error mean %.1f, worst %.1f points; runtime %+.0f%% at 50%%, %+.0f%% at 20%%\n",
+           r.name.c_str(), r.meanError(), r.maxError, 100.0 * r.runtimeError50, 100.0 * r.runtimeError20);
+    for (size_t i = 0; i < r.changes.size() && i < MAX_CHANGES_PRINTED; i++) {
+        const LevelChange& change = r.changes[i];
+        printf("  %6.2f h  -> %-8s at true %.1f%%\n", change.timeH, battery_level_name(change.level),
+               change.truePercent);
+    }
+    if (r.changes.size() > MAX_CHANGES_PRINTED) {
+        printf("  ... %zu level changes in all\n", r.changes.size());
+    }
+}
+
+static void write_result_json(SimJson& json, const GaugeResult& r) {
+    json.beginObject();
+    json.add("name", r.name);
+    json.add("mean_error", r.meanError(), 2);
+    json.add("max_error", r.maxError, 2);
+    json.add("runtime_error_50", r.runtimeError50, 3);
+    json.add("runtime_error_20", r.runtimeError20, 3);
+    json.beginArray("level_changes");
+    for (const LevelChange& change : r.changes) {
+        json.beginObject();
+        json.add("time_h", change.timeH, 3);
+        json.add("true_percent", change.truePercent);
+        json.add("level", battery_level_name(change.level));
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+}
+
+static bool write_json(const std::string& path, const Options& options, const Curve& curve,
+                       const std::vector<Checkpoint>& checkpoints, const GaugeResult& gauge,
+                       const GaugeResult& raw) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("curve", options.curvePath);
+    json.add("hours", curve.rows.back().timeS / 3600.0, 2);
+    json.add("delivered_mah", curve.totalMah);
+    json.add("sample_s", options.sampleS);
+    json.add("noise_mv", options.noiseMv);
+    json.add("cell_mohm", options.cellMohm, 0);
+    json.add("model_error", options.modelError, 2);
+    json.add("burst", options.burst, 2);
+    json.beginArray("checkpoints");
+    for (const Checkpoint& c : checkpoints) {
+        json.beginObject();
+        json.add("true_percent", c.truePercent);
+        json.add("time_h", c.timeH, 3);
+        json.add("gauge_percent", c.gaugePercent);
+        json.add("raw_percent", c.rawPercent);
+        json.add("true_minutes", c.trueMinutes, 0);
+        json.add("gauge_minutes", c.gaugeMinutes);
+        json.add("level", battery_level_name(c.level));
+        json.endObject();
+    }
+    json.endArray();
+    json.beginArray("gauges");
+    write_result_json(json, gauge);
+    write_result_json(json, raw);
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--curve", "FILE", &options.curvePath);
+    args.add("--sample-s", "S", &options.sampleS);
+    args.add("--noise-mv", "MV", &options.noiseMv);
+    args.add("--cell-mohm", "R", &options.cellMohm);
+    args.add("--model-error", "F", &options.modelError);
+    args.add("--burst", "P", &options.burst);
+    args.add("--capacity-mah", "N", &options.capacityMah);
+    args.add("--seed", "N", &options.seed);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv) ||
+        !args.check(options.sampleS > 0 && options.noiseMv >= 0 && options.cellMohm >= 0 && options.modelError > -1 &&
+                    options.burst >= 0 && options.burst <= 1 && options.capacityMah >= 0)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    Curve curve;
+    if (!load_curve(options.curvePath, &curve)) {
+        fprintf(stderr, "Cannot read discharge curve %s\n", options.curvePath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    battery_gauge_config_t config = battery_gauge_default_config();
+    if (options.capacityMah > 0) {
+        config.capacity_mah = (float)options.capacityMah;
+    }
+    printf("%s: %zu rows, %.1f h, %.0f mAh delivered; gauge assumes %.0f mAh\n\n", options.curvePath.c_str(),
+           curve.rows.size(), curve.rows.back().timeS / 3600.0, curve.totalMah, config.capacity_mah);
+
+    GaugeResult gauge;
+    GaugeResult raw;
+    std::vector<Checkpoint> checkpoints;
+    replay(options, curve, config, &gauge, &raw, &checkpoints);
+
+    printf("%6s %8s %7s %7s %9s %9s  %s\n", "true", "time-h", "gauge", "raw", "true-min", "est-min", "level");
+    for (const Checkpoint& c : checkpoints) {
+        printf("%5d%% %8.2f %6.1f%% %6.1f%% %9.0f %9u  %s\n", c.truePercent, c.timeH, c.gaugePercent,
+               c.rawPercent, c.trueMinutes, (unsigned)c.gaugeMinutes, battery_level_name(c.level));
+    }
+    printf("\n");
+    print_result(gauge);
+    print_result(raw);
+
+    bool ok = gauge.maxError <= MAX_ERROR_POINTS && gauge.finalLevel == BATTERY_LEVEL_CRITICAL &&
+              gauge.changes.size() <= 2;
+    printf("\ngauge: %s\n", ok ? "within bounds" : "CHECK FAILED");
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, curve, checkpoints, gauge, raw)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return ok ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
@@ -0,0 +1,802 @@
+/**
+ * @file aircom_bench.cpp
+ * @brief Microbenchmarks for the firmware hot paths (host build)
+ *
+ * Covers protobuf packing, encryption, CoT generation and parsing, NMEA
+ * decoding, the logging system, the memory tracker, the mesh manager send
+ * path on a null radio, radio event dispatch through delegates and through
+ * the SafeCallback chain they replaced, a tick of the voice pipeline
+ * lanes, the metrics registry (alone and with two contending writers), the
+ * talkgroup receive filter and the voice recorder capture. Results are printed, optionally written as JSON and compared
+ * with a stored baseline:
+ *
+ *   aircom_bench [--filter TEXT] [--json FILE] [--baseline FILE]
+ *                [--tolerance PERCENT] [--sample-ms MS] [--samples N]
+ *                [--nmea FILE]
+ *
+ * Exit status is 1 if any case is slower than the baseline by more than
+ * the tolerance (default 25%), 2 on usage or I/O errors. To refresh the
+ * stored baseline, run a Release build with --json host/bench/baseline.json
+ * on the reference machine.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "bench_harness.h"
+#include "delegate_dispatch.h"
+#include "sim_harness.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "audio_pipeline.h"
+#include "config.h"
+#include "cot_message.h"
+#include "crypto.h"
+#include "dsp_kernels.h"
+#include "logging_system.h"
+#include "memory_tracker.h"
+#include "metrics_registry.h"
+#include "talkgroup.h"
+#include "frame_ring.h"
+#include "HaLowMeshManager.h"
+#include "AirCom.pb-c.h"
+#include "TinyGPS++.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifndef AIRCOM_BENCH_DATA_DIR
+#define AIRCOM_BENCH_DATA_DIR "host/bench/data"
+#endif
+
+static const double DEFAULT_TOLERANCE = 0.25;
+static const size_t PACK_BUFFER_SIZE = 2048;
+
+// Same framing as audioTask: 20 ms of 16 kHz mono PCM
+static const uint32_t AUDIO_FRAME_SAMPLES = 320;
+
+// ============================================================================
+// NULL RADIO
+// ============================================================================
+
+// Accepts every frame and drops it, so the mesh manager's own cost is measured
+class NullHaLow : public IHaLow {
+public:
+    bool initialize(const HaLowConfig&) override { m_initialized = true; return true; }
+    void deinitialize() override { m_initialized = false; }
+    bool startDiscovery() override { return true; }
+    void stopDiscovery() override {}
+    bool connectToPeer(const std::string&) override { return true; }
+    bool disconnectFromPeer(const std::string&) override { return true; }
+    bool sendData(const std::string&, const std::vector<uint8_t>& data) override {
+        m_bytes += data.size();
+        return true;
+    }
+    bool broadcastData(const std::vector<uint8_t>& data) override {
+        m_bytes += data.size();
+        return true;
+    }
+    std::vector<HaLowPeerInfo> getDiscoveredPeers() override { return {}; }
+    std::vector<HaLowPeerInfo> getConnectedPeers() override { return {}; }
+    HaLowNetworkInfo getNetworkInfo() override { return HaLowNetworkInfo(); }
+    void setConnectionCallback(ConnectionCallback) override {}
+    void setDataCallback(DataCallback) override {}
+    void setDiscoveryCallback(DiscoveryCallback) override {}
+    void setEventCallback(EventCallback) override {}
+    std::string getImplementationName() const override { return "Null"; }
+    std::vector<std::string> getSupportedHardware() const override { return {}; }
+    bool isInitialized() const override { return m_initialized; }
+    // Reported down so begin() does not go through the event executor; the
+    // benchmark marks the link up itself
+    bool isConnected() const override { return false; }
+    std::string getVersion() const override { return "0"; }
+    std::string sendRawCommand(const std::string&, const std::vector<std::string>&) override { return ""; }
+
+private:
+    bool m_initialized = false;
+    uint64_t m_bytes = 0;
+};
+
+// ============================================================================
+// FIXTURES
+// ============================================================================
+
+static std::string load_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+static GPSData sample_fix() {
+    GPSData fix;
+    fix.latitude = 48.117300;
+    fix.longitude = 11.516667;
+    fix.altitude = 545.4;
+    fix.satellites = 8;
+    fix.isValid = true;
+    return fix;
+}
+
+// Packets for each payload variant, pointing into static storage
+struct PacketFixtures {
+    NodeInfo node_info = NODE_INFO__INIT;
+    TextMessage text_message = TEXT_MESSAGE__INIT;
+    NetworkHealth network_health = NETWORK_HEALTH__INIT;
+    std::string cot;
+    char from_node[32] = "ESP32-a1c001";
+    char node_id[32] = "ESP32-a1c001";
+    char text[128] = "Moving to checkpoint bravo, ETA ten minutes. Hold position until then.";
+    char mesh_status[32] = "connected";
+
+    AirComPacket make(int variant) {
+        AirComPacket packet = AIR_COM_PACKET__INIT;
+        packet.payload_variant_case = variant;
+        packet.from_node = from_node;
+        switch (variant) {
+            case AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO:
+                node_info.callsign = (char*)CALLSIGN;
+                node_info.node_id = node_id;
+                packet.node_info = &node_info;
+                break;
+            case AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE:
+                text_message.text = text;
+                packet.text_message = &text_message;
+                break;
+            case AIR_COM_PACKET__PAYLOAD_VARIANT_NETWORK_HEALTH:
+                network_health.rssi = -78;
+                network_health.packet_loss = 3;
+                network_health.latency_ms = 42;
+                network_health.mesh_status = mesh_status;
+                packet.network_health = &network_health;
+                break;
+            case AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE:
+                packet.cot_message = (char*)cot.c_str();
+                break;
+        }
+        return packet;
+    }
+};
+
+static PacketFixtures g_packets;
+
+// ============================================================================
+// CASES
+// ============================================================================
+
+static void add_proto_cases(BenchRunner& runner) {
+    static const struct {
+        const char* name;
+        int variant;
+    } variants[] = {
+        {"node_info", AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO},
+        {"text_message", AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE},
+        {"network_health", AIR_COM_PACKET__PAYLOAD_VARIANT_NETWORK_HEALTH},
+        {"cot_message", AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE},
+    };
+
+    for (const auto& variant : variants) {
+        int variant_case = variant.variant;
+
+        // Size, allocate and pack, as the senders do
+        runner.add(std::string("proto/pack/") + variant.name, [variant_case](uint64_t n) {
+            AirComPacket packet = g_packets.make(variant_case);
+            for (uint64_t i = 0; i < n; i++) {
+                size_t size = air_com_packet__get_packed_size(&packet);
+                uint8_t* buffer = (uint8_t*)malloc(size);
+                air_com_packet__pack(&packet, buffer);
+                bench_do_not_optimize(buffer[size - 1]);
+                free(buffer);
+            }
+        });
+
+        runner.add(std::string("proto/unpack/") + variant.name, [variant_case](uint64_t n) {
+            AirComPacket packet = g_packets.make(variant_case);
+            uint8_t buffer[PACK_BUFFER_SIZE];
+            size_t size = air_com_packet__get_packed_size(&packet);
+            air_com_packet__pack(&packet, buffer);
+            for (uint64_t i = 0; i < n; i++) {
+                AirComPacket* unpacked = air_com_packet__unpack(NULL, size, buffer);
+                bench_do_not_optimize(unpacked->payload_variant_case);
+                air_com_packet__free_unpacked(unpacked, NULL);
+            }
+        });
+    }
+}
+
+static void add_crypto_cases(BenchRunner& runner) {
+    static const size_t sizes[] = {64, 256, 1024};
+    for (size_t size : sizes) {
+        std::string plaintext(size, 'a');
+        runner.add("crypto/encrypt_message/" + std::to_string(size), [plaintext](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::vector<uint8_t> payload = encrypt_message(plaintext);
+                bench_do_not_optimize(payload.data());
+            }
+        });
+
+        runner.add("crypto/decrypt_message/" + std::to_string(size), [plaintext](uint64_t n) {
+            const std::vector<uint8_t> payload = encrypt_message(plaintext);
+            for (uint64_t i = 0; i < n; i++) {
+                std::string decrypted = decrypt_message(payload);
+                bench_do_not_optimize(decrypted.data());
+            }
+        });
+    }
+}
+
+static void add_cot_cases(BenchRunner& runner) {
+    runner.add("cot/generateCoT", [](uint64_t n) {
+        const GPSData fix = sample_fix();
+        for (uint64_t i = 0; i < n; i++) {
+            std::string cot = generateCoT(fix);
+            bench_do_not_optimize(cot.data());
+        }
+    });
+
+    // The three lookups atak_processor_task does per received message
+    runner.add("cot/parse_cot_value/x3", [](uint64_t n) {
+        const std::string cot = g_packets.cot;
+        for (uint64_t i = 0; i < n; i++) {
+            std::string callsign = parse_cot_value(cot, "callsign=\"");
+            std::string lat = parse_cot_value(cot, "lat=\"");
+            std::string lon = parse_cot_value(cot, "lon=\"");
+            bench_do_not_optimize(callsign.size() + lat.size() + lon.size());
+        }
+    });
+}
+
+static void add_gps_cases(BenchRunner& runner, const std::string& nmea_log) {
+    // One operation is one received character, as gpsTask feeds them
+    runner.add("gps/tinygps_encode_char", [nmea_log](uint64_t n) {
+        TinyGPSPlus gps;
+        const char* data = nmea_log.data();
+        const size_t length = nmea_log.size();
+        size_t pos = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            bench_do_not_optimize(gps.encode(data[pos]));
+            if (++pos == length) {
+                pos = 0;
+            }
+        }
+        bench_do_not_optimize(gps.location.isValid());
+    });
+}
+
+static void add_logging_cases(BenchRunner& runner) {
+    // Enabled levels format and count the message; debug and verbose are
+    // filtered at the default level, which is what most call sites hit
+    runner.add("logging/log_error", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            LOG_ERROR("BENCH", ERROR_NONE, "Send failed on port %d: errno %d", VOICE_PORT, (int)i);
+        }
+    });
+    runner.add("logging/log_warning", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            LOG_WARNING("BENCH", "Queue %s is %u%% full", "audio", (unsigned)(i & 0x7F));
+        }
+    });
+    runner.add("logging/log_info", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            LOG_INFO("BENCH", "Received %u bytes from %s", (unsigned)(i & 0x3FF), "ESP32-a1c001");
+        }
+    });
+    runner.add("logging/log_debug_filtered", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            LOG_DEBUG("BENCH_QUIET", "Transmitted %d audio bytes from I2S", (int)i);
+        }
+    });
+    runner.add("logging/log_verbose_filtered", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            LOG_VERBOSE("BENCH_QUIET", "Frame %u", (unsigned)i);
+        }
+    });
+}
+
+static void add_memory_cases(BenchRunner& runner) {
+    // Paired with a deallocation so the record table stays at steady state
+    runner.add("memory/track_allocation+deallocation", [](uint64_t n) {
+        static uint8_t pool[64][32];
+        for (uint64_t i = 0; i < n; i++) {
+            void* ptr = pool[i & 63];
+            memory_tracker_track_allocation(ptr, 32, __FILE__, __LINE__);
+            memory_tracker_track_deallocation(ptr, __FILE__, __LINE__);
+        }
+    });
+}
+
+static void add_mesh_cases(BenchRunner& runner) {
+    static const size_t sizes[] = {64, 640, 1400};
+    for (size_t size : sizes) {
+        runner.add("mesh/sendUdpMulticast/" + std::to_string(size), [size](uint64_t n) {
+            std::vector<uint8_t> payload(size, 0x5A);
+            HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+            for (uint64_t i = 0; i < n; i++) {
+                mesh.sendUdpMulticast(payload.data(), payload.size(), VOICE_PORT);
+            }
+        });
+    }
+}
+
+// One received voice frame handed from the radio to the mesh manager's
+// data handler. Code size of each path: the delegate_code_size target.
+static void add_delegate_cases(BenchRunner& runner) {
+    runner.add("delegate/dispatch/delegate_table", [](uint64_t n) {
+        const std::string peer_id = "02:00:00:00:00:01";
+        const std::vector<uint8_t> frame(AUDIO_FRAME_SAMPLES * 2, 0x5A);
+        dispatch_table::setup();
+        for (uint64_t i = 0; i < n; i++) {
+            dispatch_table::dispatch(peer_id, frame);
+        }
+        bench_do_not_optimize(dispatch_table::received());
+    });
+    runner.add("delegate/dispatch/safe_callback_chain", [](uint64_t n) {
+        const std::string peer_id = "02:00:00:00:00:01";
+        const std::vector<uint8_t> frame(AUDIO_FRAME_SAMPLES * 2, 0x5A);
+        dispatch_chain::setup();
+        for (uint64_t i = 0; i < n; i++) {
+            dispatch_chain::dispatch(peer_id, frame);
+        }
+        bench_do_not_optimize(dispatch_chain::received());
+    });
+}
+
+// ============================================================================
+// VOICE LANES
+// ============================================================================
+
+// The firmware's pipeline (audio_pipeline_build, the dual-core profile) with
+// the stages of audio_task.cpp minus the driver calls: the mic yields a
+// synthetic frame where i2s_read would, the socket a talkgroup frame where
+// recvfrom would, and playout ends where i2s_write would start. The kernels,
+// rings, talkgroup send and filter, and latency metrics are the real ones.
+namespace voice_lanes {
+
+static const float MIC_HIGHPASS_HZ = 80.0f;
+static const int16_t SIDETONE_GAIN = DSP_GAIN_UNITY / 4;
+static const int16_t RX_DUCK_GAIN = DSP_GAIN_UNITY / 2;
+
+static bool s_transmitting = false;
+static bool s_jitterPrimed = false;
+static dsp_biquad_s16_t s_micHighpass;
+static int16_t s_mic[AUDIO_FRAME_SAMPLES];
+static uint8_t s_rxFrame[TALKGROUP_HEADER_SIZE + AUDIO_FRAME_SAMPLES * 2];
+static uint8_t s_buf[TALKGROUP_HEADER_SIZE + AUDIO_PIPELINE_MAX_FRAME];
+static int16_t s_sidetone[AUDIO_FRAME_SAMPLES];
+static size_t s_sidetoneLength = 0;
+static int16_t s_mix[AUDIO_PIPELINE_MAX_FRAME / sizeof(int16_t)];
+
+static int capture(AudioPipeline& pipeline, int stage, void*) {
+    if (!s_transmitting) {
+        return 0;
+    }
+    audio_frame_t frame = {};
+    frame.origin_us = pipeline.now();
+    frame.group = talkgroup_get_tx();
+    frame.length = sizeof(s_mic);
+    frame.flags = AUDIO_FRAME_PCM;
+    pipeline.push(stage, frame, s_mic);
+    return 1;
+}
+
+static int dsp(AudioPipeline& pipeline, int stage, void*) {
+    audio_frame_t frame;
+    int16_t* pcm = (int16_t*)s_buf;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_buf, AUDIO_PIPELINE_MAX_FRAME) > 0) {
+        dsp_biquad_s16(&s_micHighpass, pcm, pcm, frame.length / sizeof(int16_t));
+        pipeline.push(stage, frame, s_buf);
+        handled++;
+    }
+    return handled;
+}
+
+static int encode(AudioPipeline& pipeline, int stage, void*) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_buf + TALKGROUP_HEADER_SIZE, AUDIO_PIPELINE_MAX_FRAME) > 0) {
+        memset(s_buf, 0, TALKGROUP_HEADER_SIZE);
+        frame.length += TALKGROUP_HEADER_SIZE;
+        pipeline.push(stage, frame, s_buf);
+        handled++;
+    }
+    return handled;
+}
+
+static int send(AudioPipeline& pipeline, int stage, void*) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_buf, sizeof(s_buf)) > TALKGROUP_HEADER_SIZE) {
+        talkgroup_send(TALKGROUP_KIND_VOICE, s_buf, frame.length, VOICE_PORT);
+        pipeline.done(stage, frame);
+        metrics_histogram_record(METRIC_AUDIO_TX_LATENCY_US, (uint32_t)(pipeline.now() - frame.origin_us));
+        handled++;
+    }
+    return handled;
+}
+
+static int receive(AudioPipeline& pipeline, int stage, void*) {
+    size_t voice_len = 0;
+    const uint8_t* voice = talkgroup_accept(s_rxFrame, sizeof(s_rxFrame), &voice_len);
+    if (!voice || voice_len == 0) {
+        return 1;
+    }
+    audio_frame_t frame = {};
+    frame.origin_us = pipeline.now();
+    frame.length = (uint16_t)voice_len;
+    frame.group = TALKGROUP_ALL;
+    frame.flags = AUDIO_FRAME_LIVE;
+    pipeline.push(stage, frame, voice);
+    return 1;
+}
+
+static int jitter(AudioPipeline& pipeline, int stage, void*) {
+    uint32_t depth = pipeline.depth(stage);
+    if (depth == 0) {
+        s_jitterPrimed = false;
+        return 0;
+    }
+    if (!s_jitterPrimed && depth < AUDIO_JITTER_PRIME_FRAMES) {
+        return 0;
+    }
+    s_jitterPrimed = true;
+    audio_frame_t frame;
+    int64_t now = pipeline.now();
+    while (pipeline.pop(stage, &frame, s_buf, sizeof(s_buf)) > 0) {
+        if (now - frame.origin_us <= AUDIO_RX_MAX_LATENCY_US) {
+            pipeline.push(stage, frame, s_buf);
+            return 1;
+        }
+        metrics_counter_inc(METRIC_AUDIO_RX_DISCARDED);
+    }
+    return 0;
+}
+
+static int decode(AudioPipeline& pipeline, int stage, void*) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_buf, sizeof(s_buf)) > 0) {
+        frame.length &= ~1u;
+        if (frame.length > 0) {
+            pipeline.push(stage, frame, s_buf);
+        }
+        handled++;
+    }
+    return handled;
+}
+
+static int sidetone(AudioPipeline& pipeline, int stage, void*) {
+    audio_frame_t frame;
+    int16_t in[AUDIO_FRAME_SAMPLES];
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, (uint8_t*)in, sizeof(in)) > 0) {
+        handled++;
+        if (pipeline.depth(stage) > 0) {
+            continue;
+        }
+        size_t samples = frame.length / sizeof(int16_t);
+        dsp_gain_s16(in, s_sidetone, samples, SIDETONE_GAIN);
+        s_sidetoneLength = samples * sizeof(int16_t);
+        pipeline.done(stage, frame);
+        metrics_histogram_record(METRIC_AUDIO_SIDETONE_LATENCY_US, (uint32_t)(pipeline.now() - frame.origin_us));
+    }
+    return handled;
+}
+
+static int mix(AudioPipeline& pipeline, int stage, void*) {
+    audio_frame_t frame = {};
+    if (pipeline.pop(stage, &frame, (uint8_t*)s_mix, sizeof(s_mix)) == 0) {
+        return 0;
+    }
+    frame.length &= ~1u;
+    size_t samples = frame.length / sizeof(int16_t);
+    if (s_transmitting) {
+        dsp_gain_s16(s_mix, s_mix, samples, RX_DUCK_GAIN);
+    }
+    if (s_sidetoneLength > 0) {
+        size_t sidetone_samples = s_sidetoneLength / sizeof(int16_t);
+        dsp_add_sat_s16(s_mix, s_sidetone, s_mix, samples < sidetone_samples ? samples : sidetone_samples);
+        s_sidetoneLength = 0;
+    }
+    pipeline.push(stage, frame, s_mix);
+    return 1;
+}
+
+static int playout(AudioPipeline& pipeline, int stage, void*) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_buf, sizeof(s_buf)) > 0) {
+        pipeline.done(stage, frame);
+        metrics_histogram_record(METRIC_AUDIO_RX_LATENCY_US, (uint32_t)(pipeline.now() - frame.origin_us));
+        handled++;
+    }
+    return handled;
+}
+
+// A pipeline in the dual-core layout with the PTT held or released
+static AudioPipeline* build(bool transmitting) {
+    static const audio_stage_fn_t fns[AUDIO_STAGE_COUNT] = {
+        capture, dsp, encode, send, receive, jitter, decode, sidetone, mix, playout,
+    };
+    for (uint32_t i = 0; i < AUDIO_FRAME_SAMPLES; i++) {
+        s_mic[i] = (int16_t)(8000 * sin(2 * M_PI * 440 * i / 16000.0));
+    }
+    talkgroup_write_header(TALKGROUP_KIND_VOICE, TALKGROUP_ALL, s_rxFrame, sizeof(s_rxFrame));
+    memcpy(s_rxFrame + TALKGROUP_HEADER_SIZE, s_mic, sizeof(s_mic));
+    dsp_biquad_s16_highpass(&s_micHighpass, MIC_HIGHPASS_HZ, 16000.0f, 0.707f);
+    s_transmitting = transmitting;
+    s_jitterPrimed = false;
+    s_sidetoneLength = 0;
+
+    AudioPipeline* pipeline = new AudioPipeline(esp_timer_get_time);
+    if (!audio_pipeline_build(pipeline, fns, nullptr) || !pipeline->configure(audio_pipeline_profile(2))) {
+        fprintf(stderr, "Cannot build the voice pipeline\n");
+        abort();
+    }
+    return pipeline;
+}
+
+} // namespace voice_lanes
+
+static void add_audio_cases(BenchRunner& runner) {
+    // One 20 ms tick of both lanes: a frame out and a frame in while the
+    // PTT is held, and a frame in while it is released
+    struct Case {
+        const char* name;
+        bool transmitting;
+    };
+    static const Case cases[] = {
+        {"audio/lanes_tick/talking", true},
+        {"audio/lanes_tick/listening", false},
+    };
+    for (const Case& c : cases) {
+        bool transmitting = c.transmitting;
+        runner.add(c.name, [transmitting](uint64_t n) {
+            std::unique_ptr<AudioPipeline> pipeline(voice_lanes::build(transmitting));
+            int handled = 0;
+            for (uint64_t i = 0; i < n; i++) {
+                for (int lane = 0; lane < pipeline->profile().lanes; lane++) {
+                    handled += pipeline->runLane(lane);
+                }
+            }
+            bench_do_not_optimize(handled);
+        });
+    }
+}
+
+static void metrics_counter_loop(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        metrics_counter_inc(METRIC_NET_MESSAGES_SENT);
+    }
+}
+
+static void metrics_histogram_loop(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        metrics_histogram_record(METRIC_AUDIO_ENCODE_TIME_US, (uint32_t)((i * 2654435761u) >> 18));
+    }
+}
+
+// Runs body(n) on a second thread alongside the caller, so the cost per
+// operation includes two writers sharing the host's single counter block
+static void run_contended(void (*body)(uint64_t), uint64_t n) {
+    std::thread other(body, n);
+    body(n);
+    other.join();
+}
+
+static void add_metrics_cases(BenchRunner& runner) {
+    runner.add("metrics/counter_inc", metrics_counter_loop);
+    runner.add("metrics/histogram_record", metrics_histogram_loop);
+    runner.add("metrics/counter_inc_contended", [](uint64_t n) {
+        run_contended(metrics_counter_loop, n);
+    });
+    runner.add("metrics/histogram_record_contended", [](uint64_t n) {
+        run_contended(metrics_histogram_loop, n);
+    });
+
+    // Reference for the contended cases: the mutex the registry avoids
+    static std::mutex counter_mutex;
+    static uint64_t locked_counter = 0;
+    runner.add("metrics/mutex_inc_contended", [](uint64_t n) {
+        run_contended([](uint64_t count) {
+            for (uint64_t i = 0; i < count; i++) {
+                std::lock_guard<std::mutex> lock(counter_mutex);
+                locked_counter++;
+            }
+        }, n);
+        bench_do_not_optimize(locked_counter);
+    });
+}
+
+static void add_talkgroup_cases(BenchRunner& runner) {
+    static const uint8_t OTHER_GROUP = 7;           // Not joined in the bench
+
+    runner.add("talkgroup/accept_member", [](uint64_t n) {
+        uint8_t frame[TALKGROUP_HEADER_SIZE + AUDIO_FRAME_SAMPLES * 2] = {};
+        talkgroup_write_header(TALKGROUP_KIND_VOICE, TALKGROUP_ALL, frame, sizeof(frame));
+        for (uint64_t i = 0; i < n; i++) {
+            size_t length = 0;
+            bench_do_not_optimize(talkgroup_accept(frame, sizeof(frame), &length));
+        }
+    });
+    runner.add("talkgroup/accept_nonmember", [](uint64_t n) {
+        uint8_t frame[TALKGROUP_HEADER_SIZE + AUDIO_FRAME_SAMPLES * 2] = {};
+        talkgroup_write_header(TALKGROUP_KIND_VOICE, OTHER_GROUP, frame, sizeof(frame));
+        for (uint64_t i = 0; i < n; i++) {
+            size_t length = 0;
+            bench_do_not_optimize(talkgroup_accept(frame, sizeof(frame), &length));
+        }
+    });
+
+    // A CoT frame for another group: what atak_processor_task spent on it
+    // before the filter (unpack and parse, then discard) against the drop
+    runner.add("talkgroup/rx_cot_nonmember/unfiltered", [](uint64_t n) {
+        AirComPacket packet = g_packets.make(AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE);
+        uint8_t buffer[PACK_BUFFER_SIZE];
+        size_t size = air_com_packet__get_packed_size(&packet);
+        air_com_packet__pack(&packet, buffer);
+        for (uint64_t i = 0; i < n; i++) {
+            AirComPacket* unpacked = air_com_packet__unpack(NULL, size, buffer);
+            std::string cot_xml = unpacked->cot_message;
+            std::string callsign = parse_cot_value(cot_xml, "callsign=\"");
+            double lat = std::stod(parse_cot_value(cot_xml, "lat=\""));
+            double lon = std::stod(parse_cot_value(cot_xml, "lon=\""));
+            bench_do_not_optimize(callsign.size() + lat + lon);
+            air_com_packet__free_unpacked(unpacked, NULL);
+        }
+    });
+    runner.add("talkgroup/rx_cot_nonmember/filtered", [](uint64_t n) {
+        AirComPacket packet = g_packets.make(AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE);
+        uint8_t buffer[TALKGROUP_HEADER_SIZE + PACK_BUFFER_SIZE];
+        talkgroup_write_header(TALKGROUP_KIND_DATA, OTHER_GROUP, buffer, sizeof(buffer));
+        size_t size = TALKGROUP_HEADER_SIZE + air_com_packet__get_packed_size(&packet);
+        air_com_packet__pack(&packet, buffer + TALKGROUP_HEADER_SIZE);
+        for (uint64_t i = 0; i < n; i++) {
+            size_t cot_len = 0;
+            const uint8_t* cot = talkgroup_accept(buffer, size, &cot_len);
+            if (cot) {
+                AirComPacket* unpacked = air_com_packet__unpack(NULL, cot_len, cot);
+                bench_do_not_optimize(unpacked);
+                air_com_packet__free_unpacked(unpacked, NULL);
+            }
+            bench_do_not_optimize(cot);
+        }
+    });
+}
+
+// What recording costs audioTask per frame: one push into the capture
+// ring. The ring is drained whenever it fills, as the recorder task does.
+static void add_recorder_cases(BenchRunner& runner) {
+    static const size_t CAPTURE_HEAD_SIZE = 11 + 9;  // Head and an IPv4 talker
+    static const size_t OPUS_FRAME_BYTES = 60;
+
+    struct Case {
+        const char* name;
+        size_t frameBytes;
+    };
+    static const Case cases[] = {
+        {"recorder/capture_pcm_frame", AUDIO_FRAME_SAMPLES * 2},
+        {"recorder/capture_opus_frame", OPUS_FRAME_BYTES},
+    };
+    for (const Case& c : cases) {
+        size_t frameBytes = c.frameBytes;
+        runner.add(c.name, [frameBytes](uint64_t n) {
+            static FrameRing ring(16 * 1024);
+            uint8_t head[CAPTURE_HEAD_SIZE] = {};
+            uint8_t frame[AUDIO_FRAME_SAMPLES * 2] = {};
+            uint8_t out[sizeof(head) + sizeof(frame)];
+            for (uint64_t i = 0; i < n; i++) {
+                if (!ring.push(head, sizeof(head), frame, frameBytes)) {
+                    while (ring.pop(out, sizeof(out))) {
+                    }
+                }
+            }
+        });
+    }
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+static bool setup_environment() {
+    // Keep console output out of the measurements: the logging system still
+    // formats and counts BENCH messages, everything else is filtered
+    esp_log_level_set("*", ESP_LOG_WARN);
+    logging_system_init(LOG_LEVEL_INFO);
+    logging_system_set_console_output(false);
+    logging_system_set_component_level("BENCH", LOG_LEVEL_VERBOSE);
+    logging_system_set_component_level("BENCH_QUIET", LOG_LEVEL_INFO);
+    logging_system_set_component_level("AUDIO", LOG_LEVEL_INFO);
+
+    memory_tracker_init();
+
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    if (!mesh.begin(std::unique_ptr<IHaLow>(new NullHaLow()))) {
+        fprintf(stderr, "Cannot start the mesh manager on the null radio\n");
+        return false;
+    }
+    mesh.setConnectionStatus(true);
+    talkgroup_init();
+
+    g_packets.cot = generateCoT(sample_fix());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string json_path;
+    std::string baseline_path;
+    std::string nmea_path = std::string(AIRCOM_BENCH_DATA_DIR) + "/nmea_sample.log";
+    double tolerance_percent = DEFAULT_TOLERANCE * 100.0;
+    uint32_t sample_ms = 0;
+    uint32_t samples = 0;
+
+    SimArgs args;
+    args.add("--filter", "TEXT", &filter);
+    args.add("--json", "FILE", &json_path);
+    args.add("--baseline", "FILE", &baseline_path);
+    args.add("--tolerance", "PERCENT", &tolerance_percent);
+    args.add("--sample-ms", "MS", &sample_ms);
+    args.add("--samples", "N", &samples);
+    args.add("--nmea", "FILE", &nmea_path);
+    if (!args.parse(argc, argv) || !args.check(tolerance_percent >= 0)) {
+        return SIM_EXIT_USAGE;
+    }
+    double tolerance = tolerance_percent / 100.0;
+
+    std::string nmea_log = load_file(nmea_path);
+    if (nmea_log.empty()) {
+        fprintf(stderr, "Cannot read NMEA log %s\n", nmea_path.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    if (!setup_environment()) {
+        return SIM_EXIT_USAGE;
+    }
+
+    BenchRunner runner;
+    add_proto_cases(runner);
+    add_crypto_cases(runner);
+    add_cot_cases(runner);
+    add_gps_cases(runner, nmea_log);
+    add_logging_cases(runner);
+    add_memory_cases(runner);
+    add_mesh_cases(runner);
+    add_delegate_cases(runner);
+    add_audio_cases(runner);
+    add_metrics_cases(runner);
+    add_talkgroup_cases(runner);
+    add_recorder_cases(runner);
+
+    runner.setFilter(filter);
+    if (sample_ms) runner.setSampleTimeMs(sample_ms);
+    if (samples) runner.setSamples(samples);
+
+    runner.run();
+
+    // Compare first: cases re-measured there are written with their final result
+    bool passed = true;
+    if (!baseline_path.empty()) {
+        std::map<std::string, double> baseline;
+        if (!BenchRunner::loadResults(baseline_path, &baseline)) {
+            fprintf(stderr, "Cannot read baseline %s\n", baseline_path.c_str());
+            return SIM_EXIT_USAGE;
+        }
+        passed = runner.compareWithBaseline(baseline_path, tolerance);
+    }
+    if (!json_path.empty() && !runner.writeJson(json_path)) {
+        return SIM_EXIT_USAGE;
+    }
+    return passed ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
@@ -0,0 +1,244 @@
+/**
+ * @file bench_harness.cpp
+ * @brief Microbenchmark runner, JSON writer and baseline comparison
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "bench_harness.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static const uint32_t DEFAULT_SAMPLE_TIME_MS = 20;
+static const uint32_t DEFAULT_SAMPLES = 9;
+static const uint32_t DEFAULT_REGRESSION_RETRIES = 2;
+static const uint64_t MAX_ITERATIONS = 1ULL << 32;
+static const int RESULTS_SCHEMA_VERSION = 1;
+
+static double elapsed_ns(const BenchRunner::BenchFunction& body, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+BenchRunner::BenchRunner()
+    : m_sampleTimeMs(DEFAULT_SAMPLE_TIME_MS), m_samples(DEFAULT_SAMPLES),
+      m_retries(DEFAULT_REGRESSION_RETRIES) {
+}
+
+void BenchRunner::add(const std::string& name, BenchFunction body) {
+    m_cases.push_back({name, std::move(body)});
+}
+
+BenchResult BenchRunner::measure(const Case& benchCase) const {
+    // Grow the iteration count until one sample lasts the sample time; the
+    // calibration runs double as warm-up
+    const double target_ns = m_sampleTimeMs * 1e6;
+    uint64_t iterations = 1;
+    double ns = elapsed_ns(benchCase.body, iterations);
+    while (ns < target_ns && iterations < MAX_ITERATIONS) {
+        double scale = ns > 0 ? target_ns / ns : 100.0;
+        uint64_t next = (uint64_t)(iterations * std::min(std::max(scale * 1.2, 2.0), 100.0));
+        iterations = std::min(next, MAX_ITERATIONS);
+        ns = elapsed_ns(benchCase.body, iterations);
+    }
+
+    std::vector<double> per_op;
+    per_op.reserve(m_samples);
+    for (uint32_t i = 0; i < m_samples; i++) {
+        per_op.push_back(elapsed_ns(benchCase.body, iterations) / iterations);
+    }
+    std::sort(per_op.begin(), per_op.end());
+
+    BenchResult result;
+    result.name = benchCase.name;
+    result.ns_per_op = per_op[per_op.size() / 2];
+    result.min_ns_per_op = per_op.front();
+    result.max_ns_per_op = per_op.back();
+    result.iterations = iterations;
+    result.samples = m_samples;
+    return result;
+}
+
+const std::vector<BenchResult>& BenchRunner::run() {
+    m_results.clear();
+    printf("%-44s %12s %12s %12s %12s\n", "benchmark", "ns/op", "min", "max", "iterations");
+    for (const Case& benchCase : m_cases) {
+        if (!m_filter.empty() && benchCase.name.find(m_filter) == std::string::npos) {
+            continue;
+        }
+        BenchResult result = measure(benchCase);
+        printf("%-44s %12.1f %12.1f %12.1f %12llu\n", result.name.c_str(), result.ns_per_op,
+               result.min_ns_per_op, result.max_ns_per_op, (unsigned long long)result.iterations);
+        fflush(stdout);
+        m_results.push_back(result);
+    }
+    return m_results;
+}
+
+bool BenchRunner::writeJson(const std::string& path) const {
+    SimJson json;
+    if (!json.open(path)) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return false;
+    }
+
+    json.add("suite", "aircom_bench");
+    json.add("schema_version", RESULTS_SCHEMA_VERSION);
+#ifdef __VERSION__
+    json.add("compiler", __VERSION__);
+#endif
+    json.add("sample_time_ms", m_sampleTimeMs);
+    json.beginArray("results");
+    for (const BenchResult& r : m_results) {
+        json.beginObject();
+        json.add("name", r.name);
+        json.add("ns_per_op", r.ns_per_op, 2);
+        json.add("min_ns_per_op", r.min_ns_per_op, 2);
+        json.add("max_ns_per_op", r.max_ns_per_op, 2);
+        json.add("iterations", r.iterations);
+        json.add("samples", r.samples);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+// Reads the quoted string starting at text[pos] (pos at the opening quote)
+static bool read_json_string(const std::string& text, size_t* pos, std::string* value) {
+    if (*pos >= text.size() || text[*pos] != '"') {
+        return false;
+    }
+    value->clear();
+    for (size_t i = *pos + 1; i < text.size(); i++) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            *value += text[++i];
+        } else if (text[i] == '"') {
+            *pos = i + 1;
+            return true;
+        } else {
+            *value += text[i];
+        }
+    }
+    return false;
+}
+
+// Finds "key": after pos and returns the position of its value
+static size_t find_json_value(const std::string& text, const char* key, size_t pos, size_t limit) {
+    std::string quoted = std::string("\"") + key + "\"";
+    size_t at = text.find(quoted, pos);
+    if (at == std::string::npos || at >= limit) {
+        return std::string::npos;
+    }
+    at = text.find(':', at + quoted.size());
+    if (at == std::string::npos || at >= limit) {
+        return std::string::npos;
+    }
+    at = text.find_first_not_of(" \t\r\n", at + 1);
+    return at < limit ? at : std::string::npos;
+}
+
+bool BenchRunner::loadResults(const std::string& path, std::map<std::string, double>* results) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+
+    // Each result is a flat object; only name and ns_per_op are needed
+    results->clear();
+    size_t pos = text.find("\"results\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    while ((pos = text.find('{', pos)) != std::string::npos) {
+        size_t end = text.find('}', pos);
+        if (end == std::string::npos) {
+            return false;
+        }
+        size_t name_at = find_json_value(text, "name", pos, end);
+        size_t ns_at = find_json_value(text, "ns_per_op", pos, end);
+        std::string name;
+        if (name_at == std::string::npos || ns_at == std::string::npos ||
+            !read_json_string(text, &name_at, &name)) {
+            return false;
+        }
+        (*results)[name] = strtod(text.c_str() + ns_at, nullptr);
+        pos = end + 1;
+    }
+    return true;
+}
+
+bool BenchRunner::compareWithBaseline(const std::string& path, double tolerance,
+                                      std::vector<BenchComparison>* comparisons) {
+    std::map<std::string, double> baseline;
+    if (!loadResults(path, &baseline)) {
+        fprintf(stderr, "Cannot read baseline %s\n", path.c_str());
+        return false;
+    }
+
+    // Re-measure apparent regressions before reporting them
+    for (BenchResult& result : m_results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0) {
+            continue;
+        }
+        for (uint32_t retry = 0; retry < m_retries && result.ns_per_op / it->second - 1.0 > tolerance; retry++) {
+            for (const Case& benchCase : m_cases) {
+                if (benchCase.name == result.name) {
+                    BenchResult again = measure(benchCase);
+                    if (again.ns_per_op < result.ns_per_op) {
+                        result = again;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    printf("\nComparison with %s (tolerance %+.0f%%)\n", path.c_str(), tolerance * 100);
+    printf("%-44s %12s %12s %9s  %s\n", "benchmark", "baseline", "current", "change", "status");
+
+    int regressions = 0;
+    for (const BenchResult& result : m_results) {
+        BenchComparison comparison;
+        comparison.name = result.name;
+        comparison.current_ns = result.ns_per_op;
+        auto it = baseline.find(result.name);
+        comparison.baseline_ns = it != baseline.end() ? it->second : 0.0;
+        comparison.change = comparison.baseline_ns > 0 ? result.ns_per_op / comparison.baseline_ns - 1.0 : 0.0;
+        comparison.regression = comparison.baseline_ns > 0 && comparison.change > tolerance;
+
+        const char* status = "ok";
+        if (comparison.baseline_ns <= 0) {
+            status = "new";
+        } else if (comparison.regression) {
+            status = "REGRESSION";
+            regressions++;
+        } else if (comparison.change < -tolerance) {
+            status = "faster";
+        }
+        printf("%-44s %12.1f %12.1f %+8.1f%%  %s\n", result.name.c_str(), comparison.baseline_ns,
+               comparison.current_ns, comparison.change * 100, status);
+
+        if (comparisons) {
+            comparisons->push_back(comparison);
+        }
+    }
+
+    if (regressions) {
+        printf("\n%d benchmark(s) regressed by more than %.0f%%\n", regressions, tolerance * 100);
+    }
+    return regressions == 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file bench_harness.h
+ * @brief Minimal microbenchmark runner with JSON output and baseline checks
+ *
+ * Each case is a function that performs an operation n times. The runner
+ * calibrates n so one sample lasts at least the sample time, takes several
+ * samples and reports the median cost per operation. Results can be written
+ * as JSON and compared against a stored baseline; a case slower than the
+ * baseline by more than the tolerance is a regression.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Keeps a computed value alive without the compiler seeing it used
+template <typename T>
+inline void bench_do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Result of one benchmark case
+struct BenchResult {
+    std::string name;
+    double ns_per_op;           // Median over all samples
+    double min_ns_per_op;
+    double max_ns_per_op;
+    uint64_t iterations;        // Operations per sample
+    uint32_t samples;
+};
+
+// Outcome of comparing one case with the baseline
+struct BenchComparison {
+    std::string name;
+    double baseline_ns;         // 0 if the case is not in the baseline
+    double current_ns;
+    double change;              // current / baseline - 1
+    bool regression;
+};
+
+class BenchRunner {
+public:
+    typedef std::function<void(uint64_t iterations)> BenchFunction;
+
+    BenchRunner();
+
+    // Register a case. Names are "group/case" and must be unique.
+    void add(const std::string& name, BenchFunction body);
+
+    // Case selection and sampling
+    void setFilter(const std::string& substring) { m_filter = substring; }
+    void setSampleTimeMs(uint32_t ms) { m_sampleTimeMs = ms; }
+    void setSamples(uint32_t samples) { m_samples = samples; }
+
+    // Run the selected cases, printing one line per case
+    const std::vector<BenchResult>& run();
+
+    // Write the last results as JSON; returns false on I/O error
+    bool writeJson(const std::string& path) const;
+
+    // Compare the last results with a baseline file written by writeJson().
+    // A case over the tolerance (0.25 = 25% slower) is measured again up to
+    // the retry count and keeps its best result, so one noisy sample set
+    // does not fail the run. Prints a table and returns false if any case
+    // still regressed or the baseline could not be read.
+    bool compareWithBaseline(const std::string& path, double tolerance,
+                             std::vector<BenchComparison>* comparisons = nullptr);
+    void setRegressionRetries(uint32_t retries) { m_retries = retries; }
+
+    // Read the name -> ns_per_op map from a results file
+    static bool loadResults(const std::string& path, std::map<std::string, double>* results);
+
+private:
+    struct Case {
+        std::string name;
+        BenchFunction body;
+    };
+
+    BenchResult measure(const Case& benchCase) const;
+
+    std::vector<Case> m_cases;
+    std::vector<BenchResult> m_results;
+    std::string m_filter;
+    uint32_t m_sampleTimeMs;
+    uint32_t m_samples;
+    uint32_t m_retries;
+};
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,94 @@
+/**
+ * @file delegate_dispatch.cpp
+ * @brief One received-frame dispatch path, selected at build time
+ *
+ * Built with AIRCOM_DISPATCH_TABLE or AIRCOM_DISPATCH_CHAIN; see
+ * delegate_dispatch.h.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "delegate_dispatch.h"
+
+// Stands in for HaLowMeshManager::handleDataEvent
+class FrameReceiver {
+public:
+    __attribute__((noinline)) void onData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+        m_bytes += peer_id.size() + data.size();
+    }
+    uint64_t bytes() const { return m_bytes; }
+
+private:
+    uint64_t m_bytes = 0;
+};
+
+static FrameReceiver g_receiver;
+
+#if defined(AIRCOM_DISPATCH_TABLE)
+
+#include "delegate.h"
+
+namespace dispatch_table {
+
+typedef Delegate<void(const std::string&, const std::vector<uint8_t>&)> DataDelegate;
+static DelegateTable<void(const std::string&, const std::vector<uint8_t>&), 8> g_listeners;
+
+void setup() {
+    if (g_listeners.size() == 0) {
+        g_listeners.add(DataDelegate::fromMethod<FrameReceiver, &FrameReceiver::onData>(&g_receiver));
+    }
+}
+
+void dispatch(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    g_listeners.invokeAll(peer_id, data);
+}
+
+uint64_t received() {
+    return g_receiver.bytes();
+}
+
+} // namespace dispatch_table
+
+#elif defined(AIRCOM_DISPATCH_CHAIN)
+
+#include "safe_callback.h"
+
+namespace dispatch_chain {
+
+// As HaLowMeshManager::begin() registered it before delegates
+static std::shared_ptr<DataCallback> g_callback;
+static std::function<void(const std::string&, const std::vector<uint8_t>&)> g_sdkCallback;
+
+void setup() {
+    if (g_callback) {
+        return;
+    }
+    g_callback = createDataCallback(
+        [](const std::string& peer_id, const std::vector<uint8_t>& data) {
+            g_receiver.onData(peer_id, data);
+        },
+        "aircom_bench");
+    g_sdkCallback = [](const std::string& peer_id, const std::vector<uint8_t>& data) {
+        if (g_callback && g_callback->isValid()) {
+            g_callback->execute(peer_id, data);
+        }
+    };
+}
+
+void dispatch(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (g_sdkCallback) {
+        g_sdkCallback(peer_id, data);
+    }
+}
+
+uint64_t received() {
+    return g_receiver.bytes();
+}
+
+} // namespace dispatch_chain
+
+#else
+#error "Define AIRCOM_DISPATCH_TABLE or AIRCOM_DISPATCH_CHAIN"
+#endif
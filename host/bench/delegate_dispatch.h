@@ -0,0 +1,40 @@
+/**
+ * @file delegate_dispatch.h
+ * @brief Received-frame dispatch, old and new, for aircom_bench
+ *
+ * A frame from the radio reaches the mesh manager's data handler either
+ * through a DelegateTable (delegate.h, what the radios use now) or through
+ * the lambda -> SafeCallback -> std::function chain it replaced.
+ * delegate_dispatch.cpp is built once per path, so the two are separate
+ * objects: aircom_bench times a dispatch through each and the
+ * delegate_code_size target prints the size of each object. They cannot
+ * share a translation unit because safe_callback.h and halow_interface.h
+ * both define DataCallback.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef DELEGATE_DISPATCH_H
+#define DELEGATE_DISPATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// DelegateTable with the handler bound by Delegate::fromMethod
+namespace dispatch_table {
+void setup();
+void dispatch(const std::string& peer_id, const std::vector<uint8_t>& data);
+uint64_t received();
+}
+
+// SDK std::function -> SafeCallback::execute -> std::function -> handler
+namespace dispatch_chain {
+void setup();
+void dispatch(const std::string& peer_id, const std::vector<uint8_t>& data);
+uint64_t received();
+}
+
+#endif // DELEGATE_DISPATCH_H
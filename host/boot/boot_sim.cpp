@@ -0,0 +1,289 @@
+/**
+ * @file boot_sim.cpp
+ * @brief Time from power-on to first voice, sequential against staged boot
+ *
+ * Stage durations are modelled, not measured on a board (STAGE_MS below,
+ * override any with --stage NAME=MS). With --jitter F each run scales
+ * every duration by a random factor in [1 - F, 1 + F]; --runs N repeats
+ * the boot that many times.
+ *
+ * Each run is booted three ways:
+ *
+ * - "sequential": the firmware before the boot graph. app_main ran every
+ *   init in turn, Bluetooth and the camera sensor included, then created
+ *   the tasks. The network task brought the radio up while the audio
+ *   task set up I2S, and the network health task slept 10 s.
+ * - "staged-1": boot_sequence_build() on one worker. Bluetooth is lazy,
+ *   the camera sensor starts on first capture, and the tasks start
+ *   before the radio is up.
+ * - "staged": the same on BOOT_SEQUENCE_WORKERS workers, as the firmware
+ *   runs it.
+ *
+ * The staged runs schedule with BootGraph itself, in virtual time. The
+ * audio task starts when the tasks stage ends, sets up I2S and then waits
+ * for the radio stage: voice is ready when both are done. Link
+ * adaptation starts when the health task begins its loop.
+ *
+ * Reported per run: time to first voice, when every stage has ended,
+ * and when link adaptation starts, as mean and max over the runs; then the
+ * timeline of the first staged run.
+ *
+ * Exit status: 0 if the staged boot reached voice sooner than the
+ * sequential one in every run, 1 if not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "boot_sequence.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Modelled stage durations on the XIAO ESP32S3 at 240 MHz, in ms
+static uint32_t STAGE_MS[BOOT_STAGE_COUNT] = {
+    25,     // nvs: init, erase on a version change is not modelled
+    10,     // config
+    2,      // errors
+    3,      // executor
+    5,      // power
+    1800,   // radio: module firmware download, association, mesh join
+    1,      // shared_data
+    120,    // storage: SPIFFS mount
+    5,      // talkgroup
+    3,      // floor
+    60,     // outbox: replay the pending messages from flash
+    2,      // telemetry
+    40,     // recorder: index of the voice ring in flash
+    80,     // history: conversation index
+    8,      // battery
+    5,      // tasks
+    10,     // camera: bulk service and receive path
+    450,    // ota: SHA-256 of the running image, update store
+    900,    // bluetooth: controller, Bluedroid, HFP
+};
+
+// Work outside the graph
+static const uint32_t CAMERA_SENSOR_MS = 350;       // esp_camera_init(); at boot before, on first capture now
+static const uint32_t I2S_MS = 30;
+static const uint32_t HEALTH_SLEEP_MS = 10000;      // The network health task's old fixed delay
+
+struct Options {
+    int runs = 1;
+    double jitter = 0.0;
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+struct Boot {
+    uint32_t voiceMs = 0;
+    uint32_t endedMs = 0;
+    uint32_t healthMs = 0;
+};
+
+struct Result {
+    std::string name;
+    SimStat voice;
+    SimStat ended;
+    SimStat health;
+};
+
+static int find_stage(const char* name) {
+    static const boot_stage_fn_t none[BOOT_STAGE_COUNT] = {};
+    BootGraph graph;
+    boot_sequence_build(&graph, none);
+    for (int id = 0; id < BOOT_STAGE_COUNT; id++) {
+        if (strcmp(graph.stage(id).name, name) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+// app_main before the boot graph, in its order; then the tasks
+static Boot boot_sequential(const uint32_t ms[BOOT_STAGE_COUNT]) {
+    static const int ORDER[] = {
+        BOOT_STAGE_NVS, BOOT_STAGE_CONFIG, BOOT_STAGE_SHARED_DATA, BOOT_STAGE_TELEMETRY, BOOT_STAGE_ERRORS,
+        BOOT_STAGE_EXECUTOR, BOOT_STAGE_BLUETOOTH, BOOT_STAGE_STORAGE, BOOT_STAGE_OTA, BOOT_STAGE_CAMERA,
+        BOOT_STAGE_OUTBOX, BOOT_STAGE_TALKGROUP, BOOT_STAGE_FLOOR, BOOT_STAGE_RECORDER, BOOT_STAGE_HISTORY,
+        BOOT_STAGE_POWER, BOOT_STAGE_BATTERY, BOOT_STAGE_TASKS,
+    };
+    uint32_t t = 0;
+    for (int id : ORDER) {
+        t += ms[id];
+        if (id == BOOT_STAGE_CAMERA) {
+            t += CAMERA_SENSOR_MS;
+        }
+    }
+    Boot boot;
+    uint32_t radioMs = t + ms[BOOT_STAGE_RADIO];
+    boot.voiceMs = std::max(radioMs, t + I2S_MS);
+    boot.endedMs = std::max(boot.voiceMs, radioMs);
+    boot.healthMs = std::max(t + HEALTH_SLEEP_MS, radioMs);
+    return boot;
+}
+
+// BootGraph in virtual time, a stage per worker at a time
+static Boot boot_staged(const uint32_t ms[BOOT_STAGE_COUNT], int workers, BootGraph* graph) {
+    static const boot_stage_fn_t none[BOOT_STAGE_COUNT] = {};
+    boot_sequence_build(graph, none);
+
+    std::vector<int> running(workers, -1);
+    std::vector<uint32_t> endsAt(workers, 0);
+    uint32_t now = 0;
+    for (;;) {
+        for (int w = 0; w < workers; w++) {
+            if (running[w] < 0) {
+                running[w] = graph->take((int64_t)now * 1000, w);
+                endsAt[w] = running[w] >= 0 ? now + ms[running[w]] : 0;
+            }
+        }
+        int next = -1;
+        for (int w = 0; w < workers; w++) {
+            if (running[w] >= 0 && (next < 0 || endsAt[w] < endsAt[next])) {
+                next = w;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        now = endsAt[next];
+        graph->finish(running[next], 0, (int64_t)now * 1000);
+        running[next] = -1;
+    }
+
+    Boot boot;
+    uint32_t radioMs = (uint32_t)(graph->stage(BOOT_STAGE_RADIO).end_us / 1000);
+    uint32_t tasksMs = (uint32_t)(graph->stage(BOOT_STAGE_TASKS).end_us / 1000);
+    boot.voiceMs = std::max(radioMs, tasksMs + I2S_MS);
+    boot.endedMs = std::max(now, boot.voiceMs);
+    boot.healthMs = std::max(radioMs, tasksMs);
+    return boot;
+}
+
+static void print_timeline(const BootGraph& graph, uint32_t voiceMs) {
+    printf("staged timeline (ms):\n");
+    printf("  %-12s %6s %6s %6s %6s\n", "stage", "worker", "start", "end", "ms");
+    for (int id = 0; id < BOOT_STAGE_COUNT; id++) {
+        const boot_stage_t& stage = graph.stage(id);
+        if (stage.state == BOOT_STAGE_PENDING) {
+            printf("  %-12s %6s\n", stage.name, "lazy");
+            continue;
+        }
+        printf("  %-12s %6d %6u %6u %6u\n", stage.name, stage.core, (unsigned)(stage.start_us / 1000),
+               (unsigned)(stage.end_us / 1000), (unsigned)((stage.end_us - stage.start_us) / 1000));
+    }
+    printf("  %-12s %6s %6s %6u\n\n", "voice ready", "", "", (unsigned)voiceMs);
+}
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<Result>& results) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("runs", options.runs);
+    json.add("jitter", options.jitter, 2);
+    json.add("workers", BOOT_SEQUENCE_WORKERS);
+    static const boot_stage_fn_t none[BOOT_STAGE_COUNT] = {};
+    BootGraph graph;
+    boot_sequence_build(&graph, none);
+    json.beginObject("stage_ms");
+    for (int id = 0; id < BOOT_STAGE_COUNT; id++) {
+        json.add(graph.stage(id).name, STAGE_MS[id]);
+    }
+    json.endObject();
+    json.beginArray("boots");
+    for (const Result& r : results) {
+        json.beginObject();
+        json.add("name", r.name);
+        json.add("voice_mean_ms", r.voice.mean(), 0);
+        json.add("voice_max_ms", r.voice.max(), 0);
+        json.add("ended_mean_ms", r.ended.mean(), 0);
+        json.add("health_mean_ms", r.health.mean(), 0);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--runs", "N", &options.runs);
+    args.add("--jitter", "F", &options.jitter);
+    args.add("--seed", "N", &options.seed);
+    args.add("--stage", "NAME=MS", [](const char* text) {
+        std::string value = text;
+        size_t eq = value.find('=');
+        int id = eq == std::string::npos ? -1 : find_stage(value.substr(0, eq).c_str());
+        if (id < 0) {
+            return false;
+        }
+        STAGE_MS[id] = (uint32_t)atoi(value.c_str() + eq + 1);
+        return true;
+    });
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv) ||
+        !args.check(options.runs >= 1 && options.runs <= 100000 && options.jitter >= 0 && options.jitter < 1)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    std::vector<Result> results(3);
+    results[0].name = "sequential";
+    results[1].name = "staged-1";
+    results[2].name = "staged";
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<double> scale(1.0 - options.jitter, 1.0 + options.jitter);
+    bool ok = true;
+    BootGraph firstGraph;
+    uint32_t firstVoiceMs = 0;
+    for (int run = 0; run < options.runs; run++) {
+        uint32_t ms[BOOT_STAGE_COUNT];
+        for (int id = 0; id < BOOT_STAGE_COUNT; id++) {
+            ms[id] = (uint32_t)(STAGE_MS[id] * scale(rng) + 0.5);
+        }
+        BootGraph one;
+        BootGraph graph;
+        Boot boots[3] = {
+            boot_sequential(ms),
+            boot_staged(ms, 1, &one),
+            boot_staged(ms, BOOT_SEQUENCE_WORKERS, &graph),
+        };
+        for (int i = 0; i < 3; i++) {
+            results[i].voice.add(boots[i].voiceMs);
+            results[i].ended.add(boots[i].endedMs);
+            results[i].health.add(boots[i].healthMs);
+        }
+        ok = ok && boots[2].voiceMs < boots[0].voiceMs;
+        if (run == 0) {
+            firstGraph = graph;
+            firstVoiceMs = boots[2].voiceMs;
+        }
+    }
+
+    printf("%d boot%s, jitter %.0f%%, %d workers\n\n", options.runs, options.runs == 1 ? "" : "s",
+           100.0 * options.jitter, BOOT_SEQUENCE_WORKERS);
+    print_timeline(firstGraph, firstVoiceMs);
+    printf("  %-12s %14s %14s %14s\n", "boot", "voice ms", "all ended ms", "link adapt ms");
+    for (const Result& r : results) {
+        printf("  %-12s %6.0f / %5.0f %6.0f / %5.0f %6.0f / %5.0f\n", r.name.c_str(), r.voice.mean(),
+               r.voice.max(), r.ended.mean(), r.ended.max(), r.health.mean(), r.health.max());
+    }
+    printf("  mean / max; modelled stage times, Bluetooth not started in the staged boots\n");
+    printf("staged: first voice %.0f ms sooner (%.1fx)%s\n", results[0].voice.mean() - results[2].voice.mean(),
+           results[0].voice.mean() / results[2].voice.mean(), ok ? "" : " -- CHECK FAILED");
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, results)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return ok ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
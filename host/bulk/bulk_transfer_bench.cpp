@@ -0,0 +1,492 @@
+/**
+ * @file bulk_transfer_bench.cpp
+ * @brief Unicast versus multicast bulk transfer to a team on simulated radios
+ *
+ * One sender and --receivers receivers run as Sim-HaLow nodes in this
+ * process, in real time. Every node transmits through one shared channel
+ * at --rate-kbps: frames take their airtime one after another, and each
+ * node may have at most a few frames waiting, as in a radio's transmit
+ * queue. Sim-HaLow then delays each frame by --delay-ms and drops it with
+ * the probability being measured, independently at every receiver.
+ *
+ * For each loss rate the same payload goes to all receivers twice: as one
+ * unicast transfer per receiver (BulkSender, running side by side) and as
+ * one multicast transfer (BulkMulticastSender) whose stragglers are
+ * finished by unicast, as bulk_service.cpp does. Reported per run: time
+ * until the sender knows every receiver has everything, channel airtime
+ * used by the sender and by receiver feedback, retransmissions, NACKs
+ * sent and suppressed, and the largest congestion window or final
+ * multicast rate.
+ *
+ * Exit status: 0 if every receiver got an identical copy in every run,
+ * 1 if not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "bulk_transfer.h"
+#include "sim_halow.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t TICK_MS = 2;
+static const uint32_t FRAME_OVERHEAD_BYTES = 60;    // MAC, IP and UDP headers per frame
+static const size_t TX_QUEUE_FRAMES = 16;           // Per node
+static const uint32_t SIM_CHANNEL = 733;            // Away from the channels other tools use
+
+// ============================================================================
+// SHARED CHANNEL
+// ============================================================================
+
+/**
+ * @brief One radio channel shared by every node: frames go out one at a time
+ */
+class SharedChannel {
+public:
+    explicit SharedChannel(uint32_t rateKbps) : m_rateKbps(rateKbps), m_running(true) {
+        m_thread = std::thread(&SharedChannel::run, this);
+    }
+
+    ~SharedChannel() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    // Queue a frame; empty dest broadcasts. False if the node's queue is full.
+    bool send(SimHaLow* radio, const std::string& dest, const std::vector<uint8_t>& data) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queued[radio] >= TX_QUEUE_FRAMES) {
+            return false;
+        }
+        m_queued[radio]++;
+        m_frames.push_back(Frame{radio, dest, data});
+        m_wake.notify_one();
+        return true;
+    }
+
+    void resetStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bytes.clear();
+    }
+
+    // Bytes sent by one node since the last reset, headers included
+    uint64_t bytesFrom(SimHaLow* radio) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytes[radio];
+    }
+
+    double airtimeMs(uint64_t bytes) const { return bytes * 8.0 / m_rateKbps; }
+
+private:
+    struct Frame {
+        SimHaLow* radio;
+        std::string dest;
+        std::vector<uint8_t> data;
+    };
+
+    void run() {
+        Clock::time_point busyUntil = Clock::now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running) {
+            if (m_frames.empty()) {
+                m_wake.wait(lock);
+                continue;
+            }
+            Frame frame = m_frames.front();
+            m_frames.pop_front();
+            uint64_t bytes = frame.data.size() + FRAME_OVERHEAD_BYTES;
+            m_bytes[frame.radio] += bytes;
+            lock.unlock();
+
+            // On air for its airtime, then handed to the radio
+            busyUntil = std::max(busyUntil, Clock::now()) + std::chrono::microseconds(bytes * 8000 / m_rateKbps);
+            std::this_thread::sleep_until(busyUntil);
+            if (frame.dest.empty()) {
+                frame.radio->broadcastData(frame.data);
+            } else {
+                frame.radio->sendData(frame.dest, frame.data);
+            }
+
+            lock.lock();
+            m_queued[frame.radio]--;
+        }
+    }
+
+    uint32_t m_rateKbps;
+    bool m_running;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Frame> m_frames;
+    std::map<SimHaLow*, size_t> m_queued;
+    std::map<SimHaLow*, uint64_t> m_bytes;
+    std::thread m_thread;
+};
+
+// ============================================================================
+// NODES
+// ============================================================================
+
+struct Node {
+    std::string id;
+    std::mutex inboxMutex;
+    std::deque<std::pair<std::string, std::vector<uint8_t>>> inbox;
+    std::unique_ptr<SimHaLow> radio;    // Last, so its threads stop first
+
+    void onData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+        if (bulk_is_frame(data.data(), data.size())) {
+            std::lock_guard<std::mutex> lock(inboxMutex);
+            inbox.emplace_back(peer_id, data);
+        }
+    }
+
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> takeInbox() {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> frames(inbox.begin(), inbox.end());
+        inbox.clear();
+        return frames;
+    }
+};
+
+static bool start_node(Node* node, const std::string& id, uint32_t seed) {
+    node->id = id;
+    node->radio.reset(new SimHaLow(id, seed));
+    HaLowConfig config = HaLowConfig();
+    config.ssid = "bulk-bench";
+    config.channel = SIM_CHANNEL;
+    config.heartbeat_interval = 1000;
+    if (!node->radio->initialize(config)) {
+        return false;
+    }
+    node->radio->setDataCallback(DataCallback::fromMethod<Node, &Node::onData>(node));
+    return true;
+}
+
+// ============================================================================
+// RUNS
+// ============================================================================
+
+struct Options {
+    uint32_t receivers = 4;
+    uint32_t size = 100000;
+    std::vector<double> losses = {0.0, 0.05, 0.1, 0.2, 0.3};
+    uint32_t rateKbps = 2000;
+    uint32_t delayMs = 10;
+    uint32_t timeoutS = 120;
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+struct RunResult {
+    double loss = 0;
+    bool multicast = false;
+    bool delivered = false;
+    uint32_t complete_ms = 0;
+    double sender_airtime_ms = 0;
+    double feedback_airtime_ms = 0;
+    uint32_t chunks_sent = 0;
+    uint32_t retransmits = 0;
+    uint32_t nacks_sent = 0;
+    uint32_t nacks_suppressed = 0;
+    uint32_t fallbacks = 0;
+    uint32_t window_or_rate = 0;    // Largest congestion window, or final multicast rate in kbps
+};
+
+static RunResult run_once(SharedChannel& channel, Node& sender, std::vector<std::unique_ptr<Node>>& receivers,
+                          const std::shared_ptr<const std::vector<uint8_t>>& payload, double loss, bool multicast,
+                          const Options& options, uint32_t transferId) {
+    RunResult result;
+    result.loss = loss;
+    result.multicast = multicast;
+
+    SimLinkProfile profile = {(float)loss, options.delayMs, 0, 0, -70};
+    sender.radio->setDefaultLinkProfile(profile);
+    for (auto& node : receivers) {
+        node->radio->setDefaultLinkProfile(profile);
+        node->takeInbox();
+    }
+    sender.takeInbox();
+    channel.resetStats();
+
+    bulk_config_t config = bulk_default_config();
+    Clock::time_point start = Clock::now();
+    auto now_ms = [start]() {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    };
+
+    // Receivers
+    std::vector<std::unique_ptr<BulkReceiver>> bulkReceivers;
+    uint32_t intact = 0;
+    for (size_t i = 0; i < receivers.size(); i++) {
+        Node* node = receivers[i].get();
+        std::string senderId = sender.id;
+        std::unique_ptr<BulkReceiver> receiver(new BulkReceiver(
+            [&channel, node, senderId](const std::vector<uint8_t>& frame) {
+                return channel.send(node->radio.get(), senderId, frame);
+            },
+            config, options.seed * 7919 + (uint32_t)i + 1));
+        receiver->setMulticastSend([&channel, node](const std::vector<uint8_t>& frame) {
+            return channel.send(node->radio.get(), std::string(), frame);
+        });
+        receiver->setCompleteCallback([&intact, &payload](const BulkOffer&, std::vector<uint8_t>& data) {
+            intact += data == *payload;
+        });
+        bulkReceivers.push_back(std::move(receiver));
+    }
+
+    // Sender: unicast senders per receiver, plus the multicast sender in multicast runs
+    std::map<std::string, std::unique_ptr<BulkSender>> unicast;
+    auto startUnicast = [&](const std::string& peer, uint32_t nowMs) {
+        std::unique_ptr<BulkSender> bulk(new BulkSender(
+            [&channel, &sender, peer](const std::vector<uint8_t>& frame) {
+                return channel.send(sender.radio.get(), peer, frame);
+            },
+            config));
+        bulk->start(transferId, payload, BULK_CONTENT_BINARY, 0, nowMs);
+        unicast[peer] = std::move(bulk);
+    };
+    std::unique_ptr<BulkMulticastSender> group;
+    std::vector<std::string> peers;
+    for (auto& node : receivers) {
+        peers.push_back(node->id);
+    }
+    if (multicast) {
+        group.reset(new BulkMulticastSender(
+            [&channel, &sender](const std::vector<uint8_t>& frame) {
+                return channel.send(sender.radio.get(), std::string(), frame);
+            },
+            config));
+        group->start(transferId, payload, BULK_CONTENT_BINARY, 0, peers, 0);
+    } else {
+        for (const std::string& peer : peers) {
+            startUnicast(peer, 0);
+        }
+    }
+
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(TICK_MS));
+        uint32_t nowMs = now_ms();
+
+        for (auto& frame : sender.takeInbox()) {
+            if (group) {
+                group->handleFrame(frame.first, frame.second.data(), frame.second.size(), nowMs);
+            }
+            auto it = unicast.find(frame.first);
+            if (it != unicast.end()) {
+                it->second->handleFrame(frame.second.data(), frame.second.size(), nowMs);
+            }
+        }
+        for (size_t i = 0; i < receivers.size(); i++) {
+            for (auto& frame : receivers[i]->takeInbox()) {
+                // From other receivers only NACKs matter
+                if (frame.first == sender.id || bulk_frame_is_nack(frame.second.data(), frame.second.size())) {
+                    bulkReceivers[i]->handleFrame(frame.second.data(), frame.second.size(), nowMs);
+                }
+            }
+        }
+
+        if (group) {
+            group->tick(nowMs);
+            bulk_send_state_t state = group->state();
+            if (state == BULK_SEND_COMPLETE || state == BULK_SEND_FAILED) {
+                result.chunks_sent += group->stats().chunks_sent;
+                result.retransmits += group->stats().retransmits;
+                result.window_or_rate = group->rateKbps();
+                for (const std::string& peer : group->incompleteReceivers()) {
+                    startUnicast(peer, nowMs);
+                    result.fallbacks++;
+                }
+                group.reset();
+            }
+        }
+        bool sendersDone = !group;
+        for (auto& entry : unicast) {
+            entry.second->tick(nowMs);
+            bulk_send_state_t state = entry.second->state();
+            sendersDone = sendersDone && (state == BULK_SEND_COMPLETE || state == BULK_SEND_FAILED);
+            if (!multicast) {
+                result.window_or_rate = std::max(result.window_or_rate, entry.second->congestionWindow());
+            }
+        }
+        for (auto& receiver : bulkReceivers) {
+            receiver->tick(nowMs);
+        }
+
+        if (sendersDone || nowMs > options.timeoutS * 1000) {
+            result.complete_ms = nowMs;
+            break;
+        }
+    }
+
+    bool allComplete = true;
+    for (auto& entry : unicast) {
+        result.chunks_sent += entry.second->stats().chunks_sent;
+        result.retransmits += entry.second->stats().retransmits;
+        allComplete = allComplete && entry.second->state() == BULK_SEND_COMPLETE;
+    }
+    for (auto& receiver : bulkReceivers) {
+        result.nacks_sent += receiver->stats().nacks_sent;
+        result.nacks_suppressed += receiver->stats().nacks_suppressed;
+    }
+    result.delivered = allComplete && intact == receivers.size();
+
+    // Let queued feedback drain before counting airtime
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    result.sender_airtime_ms = channel.airtimeMs(channel.bytesFrom(sender.radio.get()));
+    for (auto& node : receivers) {
+        result.feedback_airtime_ms += channel.airtimeMs(channel.bytesFrom(node->radio.get()));
+    }
+    return result;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+static void print_result(const RunResult& r) {
+    printf("%5.0f%%  %-9s %8.2f %9.0f %9.0f %7u %7u %6u %6u %5u %6u%s\n", r.loss * 100,
+           r.multicast ? "multicast" : "unicast", r.complete_ms / 1000.0, r.sender_airtime_ms, r.feedback_airtime_ms,
+           (unsigned)r.chunks_sent, (unsigned)r.retransmits, (unsigned)r.nacks_sent, (unsigned)r.nacks_suppressed,
+           (unsigned)r.fallbacks, (unsigned)r.window_or_rate, r.delivered ? "" : "  FAILED");
+}
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<RunResult>& results) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("receivers", options.receivers);
+    json.add("payload_bytes", options.size);
+    json.add("rate_kbps", options.rateKbps);
+    json.add("delay_ms", options.delayMs);
+    json.beginArray("runs");
+    for (const RunResult& r : results) {
+        json.beginObject();
+        json.add("loss", r.loss, 3);
+        json.add("mode", r.multicast ? "multicast" : "unicast");
+        json.add("delivered", r.delivered);
+        json.add("complete_ms", r.complete_ms);
+        json.add("sender_airtime_ms", r.sender_airtime_ms);
+        json.add("feedback_airtime_ms", r.feedback_airtime_ms);
+        json.add("chunks_sent", r.chunks_sent);
+        json.add("retransmits", r.retransmits);
+        json.add("nacks_sent", r.nacks_sent);
+        json.add("nacks_suppressed", r.nacks_suppressed);
+        json.add("unicast_fallbacks", r.fallbacks);
+        json.add(r.multicast ? "final_rate_kbps" : "max_window", r.window_or_rate);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--receivers", "N", &options.receivers);
+    args.add("--size", "BYTES", &options.size);
+    args.add("--loss", "L1,L2,...", [&options](const char* text) { return SimArgs::parseList(text, &options.losses); });
+    args.add("--rate-kbps", "R", &options.rateKbps);
+    args.add("--delay-ms", "D", &options.delayMs);
+    args.add("--timeout-s", "S", &options.timeoutS);
+    args.add("--seed", "S", &options.seed);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv)) {
+        return SIM_EXIT_USAGE;
+    }
+    bool lossesValid = !options.losses.empty();
+    for (double loss : options.losses) {
+        lossesValid = lossesValid && loss >= 0 && loss < 1;
+    }
+    if (!args.check(options.receivers > 0 && options.receivers <= 32 && options.size > 0 &&
+                    options.size <= BULK_MAX_TRANSFER_SIZE && options.rateKbps > 0 && lossesValid)) {
+        return SIM_EXIT_USAGE;
+    }
+    if (!getenv("AIRCOM_HOST_LOG_LEVEL")) {
+        esp_log_level_set("*", ESP_LOG_ERROR);
+    }
+
+    std::mt19937 random(options.seed);
+    std::shared_ptr<std::vector<uint8_t>> payload = std::make_shared<std::vector<uint8_t>>(options.size);
+    for (uint8_t& byte : *payload) {
+        byte = (uint8_t)random();
+    }
+
+    Node sender;
+    std::vector<std::unique_ptr<Node>> receivers;
+    SharedChannel channel(options.rateKbps);    // Stops before the radios it sends on
+    if (!start_node(&sender, "sender", options.seed)) {
+        fprintf(stderr, "Cannot start the simulated radio\n");
+        return SIM_EXIT_USAGE;
+    }
+    for (uint32_t i = 0; i < options.receivers; i++) {
+        receivers.emplace_back(new Node());
+        if (!start_node(receivers.back().get(), "rx" + std::to_string(i + 1), options.seed + i + 1)) {
+            fprintf(stderr, "Cannot start the simulated radio\n");
+            return SIM_EXIT_USAGE;
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    printf("%u bytes to %u receivers, %u kbps shared channel, %u ms one-way delay, %u byte chunks\n\n",
+           (unsigned)options.size, (unsigned)options.receivers, (unsigned)options.rateKbps,
+           (unsigned)options.delayMs, (unsigned)bulk_default_config().chunk_size);
+    printf(" loss  mode      time (s)  air: data  feedback  chunks resent  nacks  supp.  fbk  cwnd/\n");
+    printf("                            (ms)       (ms)                                         kbps\n");
+
+    std::vector<RunResult> results;
+    uint32_t transferId = options.seed * 1000;
+    bool allDelivered = true;
+    for (double loss : options.losses) {
+        for (bool multicast : {false, true}) {
+            RunResult result = run_once(channel, sender, receivers, payload, loss, multicast, options, ++transferId);
+            print_result(result);
+            allDelivered = allDelivered && result.delivered;
+            results.push_back(result);
+        }
+    }
+
+    printf("\n");
+    for (double loss : options.losses) {
+        const RunResult* uni = nullptr;
+        const RunResult* multi = nullptr;
+        for (const RunResult& r : results) {
+            if (r.loss == loss) {
+                (r.multicast ? multi : uni) = &r;
+            }
+        }
+        if (uni && multi && multi->sender_airtime_ms > 0 && multi->complete_ms > 0) {
+            printf("loss %.0f%%: multicast uses %.0f%% of the unicast airtime and %.0f%% of its time\n", loss * 100,
+                   100.0 * (multi->sender_airtime_ms + multi->feedback_airtime_ms) /
+                       (uni->sender_airtime_ms + uni->feedback_airtime_ms),
+                   100.0 * multi->complete_ms / uni->complete_ms);
+        }
+    }
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, results)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return allDelivered ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
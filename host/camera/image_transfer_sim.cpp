@@ -0,0 +1,296 @@
+/**
+ * @file image_transfer_sim.cpp
+ * @brief Sends one camera image over a simulated lossy link, preview first
+ *
+ * Runs the camera pipeline on a JPEG file: FileCameraSource captures it,
+ * camera_service_prepare_image() re-encodes it as progressive, and a
+ * BulkSender moves it to a BulkReceiver over a simulated link on simulated
+ * time. The link carries one frame at a time at --rate-kbps, delivers it
+ * after half of --rtt-ms and loses it with probability --loss. An outage
+ * (--outage) drops everything for a while; if the sender gives up during
+ * it, the transfer is offered again as the bulk service does and resumes
+ * from the chunks that arrived.
+ *
+ * The same file is then sent as the camera produced it (baseline, no
+ * preview) over an identical link for comparison. Reports when the
+ * receiver could first show a picture and when the transfer finished, and
+ * writes preview.jpg (the preview prefix, decodable on its own) and
+ * received.jpg to --out.
+ *
+ * Exit status: 0 if the received image matches what was sent, 1 if not,
+ * 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "bulk_service.h"
+#include "bulk_transfer.h"
+#include "camera_service.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static const uint32_t TICK_MS = 10;
+static const uint32_t FRAME_OVERHEAD_BYTES = 60;    // MAC, IP and UDP headers per frame
+static const uint32_t RETRY_DELAY_MS = BULK_SERVICE_RETRY_DELAY_MS;
+static const uint32_t SEND_ATTEMPTS = BULK_SERVICE_SEND_ATTEMPTS;
+static const uint32_t MAX_MS = 600000;
+
+struct LinkConfig {
+    double loss = 0.05;
+    double rate_kbps = 600;
+    uint32_t rtt_ms = 40;
+    uint32_t outage_at_ms = 0;
+    uint32_t outage_for_ms = 0;
+    uint32_t seed = 1;
+};
+
+struct TransferResult {
+    bool complete = false;
+    bool matches = false;
+    uint32_t preview_ms = 0;            ///< Receiver has the preview prefix; 0 if none
+    uint32_t complete_ms = 0;
+    uint32_t attempts = 0;
+    uint64_t bytes_on_air = 0;
+    uint32_t frames_lost = 0;
+    bulk_sender_stats_t sender = bulk_sender_stats_t();
+    bulk_receiver_stats_t receiver = bulk_receiver_stats_t();
+    std::vector<uint8_t> preview;
+    std::vector<uint8_t> received;
+};
+
+// One frame at a time in either direction, then the one-way delay
+class SimLink {
+public:
+    explicit SimLink(const LinkConfig& config) : m_config(config), m_rng(config.seed) {}
+
+    void send(int to, const std::vector<uint8_t>& frame) {
+        m_queue.push_back(Pending{to, frame});
+    }
+
+    // Put queued frames on the air and hand over the ones that have arrived
+    template <typename Deliver>
+    void run(uint32_t nowMs, Deliver deliver) {
+        while (!m_queue.empty() && m_channelFreeMs <= (double)nowMs + TICK_MS) {
+            Pending pending = m_queue.front();
+            m_queue.pop_front();
+            double start = std::max(m_channelFreeMs, (double)nowMs);
+            size_t bytes = pending.frame.size() + FRAME_OVERHEAD_BYTES;
+            m_channelFreeMs = start + bytes * 8.0 / m_config.rate_kbps;
+            m_bytesOnAir += bytes;
+            bool outage = m_config.outage_for_ms && start >= m_config.outage_at_ms &&
+                          start < (double)m_config.outage_at_ms + m_config.outage_for_ms;
+            if (outage || std::uniform_real_distribution<double>(0, 1)(m_rng) < m_config.loss) {
+                m_lost++;
+                continue;
+            }
+            uint32_t arrives = (uint32_t)(m_channelFreeMs + m_config.rtt_ms / 2.0);
+            m_inFlight.insert(std::make_pair(arrives, pending));
+        }
+        while (!m_inFlight.empty() && m_inFlight.begin()->first <= nowMs) {
+            Pending pending = m_inFlight.begin()->second;
+            m_inFlight.erase(m_inFlight.begin());
+            deliver(pending.to, pending.frame);
+        }
+    }
+
+    uint64_t bytesOnAir() const { return m_bytesOnAir; }
+    uint32_t lost() const { return m_lost; }
+
+private:
+    struct Pending {
+        int to;
+        std::vector<uint8_t> frame;
+    };
+
+    LinkConfig m_config;
+    std::mt19937 m_rng;
+    std::deque<Pending> m_queue;
+    std::multimap<uint32_t, Pending> m_inFlight;
+    double m_channelFreeMs = 0;
+    uint64_t m_bytesOnAir = 0;
+    uint32_t m_lost = 0;
+};
+
+enum { TO_SENDER = 0, TO_RECEIVER = 1 };
+
+static TransferResult run_transfer(std::shared_ptr<const std::vector<uint8_t>> image, uint32_t previewBytes,
+                                   const LinkConfig& linkConfig, const bulk_config_t& bulkConfig) {
+    TransferResult result;
+    SimLink link(linkConfig);
+    BulkSender sender([&link](const std::vector<uint8_t>& frame) {
+        link.send(TO_RECEIVER, frame);
+        return true;
+    }, bulkConfig);
+    BulkReceiver receiver([&link](const std::vector<uint8_t>& frame) {
+        link.send(TO_SENDER, frame);
+        return true;
+    }, bulkConfig);
+
+    uint32_t nowMs = 0;
+    receiver.setPreviewCallback([&](const BulkOffer& offer, const uint8_t* data, size_t length) {
+        result.preview_ms = nowMs;
+        result.preview.assign(data, data + length);
+    });
+    receiver.setCompleteCallback([&](const BulkOffer& offer, std::vector<uint8_t>& payload) {
+        result.complete_ms = nowMs;
+        result.received.swap(payload);
+    });
+
+    const uint32_t transferId = 0x1A6E0001;
+    sender.start(transferId, image, BULK_CONTENT_JPEG, previewBytes, 0);
+    result.attempts = 1;
+    uint32_t retryAtMs = 0;
+
+    for (nowMs = 0; nowMs < MAX_MS; nowMs += TICK_MS) {
+        link.run(nowMs, [&](int to, const std::vector<uint8_t>& frame) {
+            if (to == TO_RECEIVER) {
+                receiver.handleFrame(frame.data(), frame.size(), nowMs);
+            } else {
+                sender.handleFrame(frame.data(), frame.size(), nowMs);
+            }
+        });
+        if (sender.state() == BULK_SEND_FAILED) {
+            if (!retryAtMs) {
+                retryAtMs = nowMs + RETRY_DELAY_MS;
+                printf("%8.2f s  sender gave up at %u/%u bytes\n", nowMs / 1000.0,
+                       (unsigned)sender.ackedBytes(), (unsigned)image->size());
+            }
+            if (nowMs >= retryAtMs && result.attempts < SEND_ATTEMPTS) {
+                retryAtMs = 0;
+                result.attempts++;
+                printf("%8.2f s  offered again, receiver has %u bytes\n", nowMs / 1000.0,
+                       (unsigned)receiver.receivedBytes(transferId));
+                sender.start(transferId, image, BULK_CONTENT_JPEG, previewBytes, nowMs);
+            } else if (nowMs >= retryAtMs) {
+                break;
+            }
+        }
+        sender.tick(nowMs);
+        receiver.tick(nowMs);
+        if (sender.state() == BULK_SEND_COMPLETE && !result.received.empty()) {
+            break;
+        }
+    }
+
+    result.complete = !result.received.empty();
+    result.matches = result.received == *image;
+    result.bytes_on_air = link.bytesOnAir();
+    result.frames_lost = link.lost();
+    result.sender = sender.stats();
+    result.receiver = receiver.stats();
+    return result;
+}
+
+static bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+static void print_result(const char* label, const TransferResult& result) {
+    if (!result.complete) {
+        printf("%-12s not delivered after %u attempts\n", label, (unsigned)result.attempts);
+        return;
+    }
+    printf("%-12s first picture %7.2f s, complete %7.2f s, %u chunks sent (%u resent), "
+           "%u ACKs, %u frames lost, %llu bytes on air\n",
+           label, (result.preview_ms ? result.preview_ms : result.complete_ms) / 1000.0,
+           result.complete_ms / 1000.0, (unsigned)result.sender.chunks_sent,
+           (unsigned)result.sender.retransmits, (unsigned)result.receiver.acks_sent,
+           (unsigned)result.frames_lost, (unsigned long long)result.bytes_on_air);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    std::string path;
+    std::string out_dir = ".";
+    LinkConfig link;
+    bulk_config_t bulk = bulk_default_config();
+    uint32_t chunkSize = bulk.chunk_size;
+    uint32_t window = bulk.max_window;
+    double outageAtS = 0;
+    double outageForS = 0;
+
+    SimArgs args;
+    args.positional("IMAGE.jpg", &path);
+    args.add("--loss", "P", &link.loss);
+    args.add("--rate-kbps", "R", &link.rate_kbps);
+    args.add("--rtt-ms", "D", &link.rtt_ms);
+    args.add("--chunk-size", "N", &chunkSize);
+    args.add("--window", "W", &window);
+    args.add("--outage", "AT_S FOR_S", &outageAtS, &outageForS);
+    args.add("--seed", "N", &link.seed);
+    args.add("--out", "DIR", &out_dir);
+    if (!args.parse(argc, argv) ||
+        !args.check(link.rate_kbps > 0 && link.loss >= 0 && link.loss < 1 && chunkSize > 0 && chunkSize <= UINT16_MAX &&
+                    window > 0 && window <= UINT16_MAX && outageAtS >= 0 && outageForS >= 0)) {
+        return SIM_EXIT_USAGE;
+    }
+    link.outage_at_ms = (uint32_t)(outageAtS * 1000);
+    link.outage_for_ms = (uint32_t)(outageForS * 1000);
+    bulk.chunk_size = (uint16_t)chunkSize;
+    bulk.max_window = (uint16_t)window;
+
+    FileCameraSource source(path);
+    if (!source.begin()) {
+        fprintf(stderr, "%s is not a JPEG file\n", path.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    CameraImage image;
+    if (!camera_service_prepare_image(&source, &image)) {
+        fprintf(stderr, "Cannot capture from %s\n", path.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    std::shared_ptr<std::vector<uint8_t>> baseline = std::make_shared<std::vector<uint8_t>>();
+    source.capture([&](const uint8_t* data, size_t length) { baseline->assign(data, data + length); });
+
+    printf("%ux%u image: %u bytes baseline, %u progressive (re-encoded in %.1f ms), preview in the first %u bytes\n",
+           image.width, image.height, (unsigned)image.capture_bytes, (unsigned)image.jpeg->size(),
+           image.reencode_us / 1000.0, (unsigned)image.preview_bytes);
+    printf("link %.0f kbps, %u ms RTT, loss %.0f%%", link.rate_kbps, (unsigned)link.rtt_ms, link.loss * 100);
+    if (link.outage_for_ms) {
+        printf(", outage %.1f s at %.1f s", link.outage_for_ms / 1000.0, link.outage_at_ms / 1000.0);
+    }
+    printf("; %u byte chunks, window %u\n\n", (unsigned)bulk.chunk_size, (unsigned)bulk.max_window);
+
+    printf("progressive:\n");
+    TransferResult progressive = run_transfer(image.jpeg, image.preview_bytes, link, bulk);
+    printf("baseline:\n");
+    TransferResult plain = run_transfer(baseline, 0, link, bulk);
+    printf("\n");
+    print_result("progressive", progressive);
+    print_result("baseline", plain);
+    if (progressive.complete && plain.complete && progressive.preview_ms) {
+        printf("preview after %.1f%% of the baseline's time to first picture\n",
+               100.0 * progressive.preview_ms / plain.complete_ms);
+    }
+
+    if (!progressive.preview.empty()) {
+        // A progressive decoder shows the scans it has once it sees EOI
+        std::vector<uint8_t> preview = progressive.preview;
+        preview.push_back(0xFF);
+        preview.push_back(0xD9);
+        write_file(out_dir + "/preview.jpg", preview);
+    }
+    if (progressive.complete) {
+        write_file(out_dir + "/received.jpg", progressive.received);
+    }
+    return progressive.matches && plain.matches ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
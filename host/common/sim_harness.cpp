@@ -0,0 +1,347 @@
+/**
+ * @file sim_harness.cpp
+ * @brief Option parsing, sample statistics and JSON output for host tools
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "sim_harness.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+double SimStat::mean() const {
+    double sum = 0;
+    for (double v : values) {
+        sum += v;
+    }
+    return values.empty() ? 0 : sum / values.size();
+}
+
+// ============================================================================
+// OPTIONS
+// ============================================================================
+
+static bool parse_double(const char* text, double* value) {
+    char* end = nullptr;
+    errno = 0;
+    double parsed = strtod(text, &end);
+    if (end == text || *end != '\0' || errno != 0 || !std::isfinite(parsed)) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+static bool parse_long(const char* text, long long* value) {
+    char* end = nullptr;
+    errno = 0;
+    long long parsed = strtoll(text, &end, 0);
+    if (end == text || *end != '\0' || errno != 0) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+void SimArgs::add(const char* flag, const char* metavar, uint32_t* value) {
+    add(flag, metavar, [value](const char* text) {
+        long long parsed;
+        if (!parse_long(text, &parsed) || parsed < 0 || parsed > UINT32_MAX) {
+            return false;
+        }
+        *value = (uint32_t)parsed;
+        return true;
+    });
+}
+
+void SimArgs::add(const char* flag, const char* metavar, int* value) {
+    add(flag, metavar, [value](const char* text) {
+        long long parsed;
+        if (!parse_long(text, &parsed) || parsed < INT32_MIN || parsed > INT32_MAX) {
+            return false;
+        }
+        *value = (int)parsed;
+        return true;
+    });
+}
+
+void SimArgs::add(const char* flag, const char* metavar, double* value) {
+    add(flag, metavar, [value](const char* text) { return parse_double(text, value); });
+}
+
+void SimArgs::add(const char* flag, const char* metavar, std::string* value) {
+    add(flag, metavar, [value](const char* text) {
+        *value = text;
+        return true;
+    });
+}
+
+void SimArgs::add(const char* flag, const char* metavar, Parser parser) {
+    m_options.push_back({flag, metavar, 1, [parser](char** texts) { return parser(texts[0]); }, nullptr});
+}
+
+void SimArgs::add(const char* flag, const char* metavar, double* first, double* second) {
+    add(flag, metavar, 2, [first, second](char** texts) {
+        return parse_double(texts[0], first) && parse_double(texts[1], second);
+    });
+}
+
+void SimArgs::add(const char* flag, const char* metavar, int values, MultiParser parser) {
+    m_options.push_back({flag, metavar, values, std::move(parser), nullptr});
+}
+
+void SimArgs::add(const char* flag, bool* value) {
+    m_options.push_back({flag, "", 0, nullptr, value});
+}
+
+void SimArgs::positional(const char* metavar, std::string* value, bool required) {
+    m_positionals.push_back({metavar, value, required});
+}
+
+bool SimArgs::parse(int argc, char** argv) {
+    m_program = argc > 0 ? argv[0] : "";
+    size_t positional = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const Option* option = nullptr;
+        for (const Option& candidate : m_options) {
+            if (candidate.flag == arg) {
+                option = &candidate;
+                break;
+            }
+        }
+
+        if (option == nullptr) {
+            if ((arg[0] == '-' && arg[1] != '\0') || positional >= m_positionals.size()) {
+                usage();
+                return false;
+            }
+            *m_positionals[positional++].value = arg;
+        } else if (option->set) {
+            *option->set = true;
+        } else if (i + option->values >= argc || !option->parser(argv + i + 1)) {
+            usage();
+            return false;
+        } else {
+            i += option->values;
+        }
+    }
+    for (; positional < m_positionals.size(); positional++) {
+        if (m_positionals[positional].required) {
+            usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SimArgs::check(bool valid) {
+    if (!valid) {
+        usage();
+    }
+    return valid;
+}
+
+void SimArgs::usage() const {
+    static const size_t LINE_WIDTH = 100;
+    std::string prefix = "usage: " + m_program;
+    std::string line = prefix;
+    std::string text;
+
+    std::vector<std::string> words;
+    for (const Positional& positional : m_positionals) {
+        words.push_back(positional.required ? positional.metavar : "[" + positional.metavar + "]");
+    }
+    for (const Option& option : m_options) {
+        words.push_back("[" + option.flag + (option.metavar.empty() ? "" : " " + option.metavar) + "]");
+    }
+    for (const std::string& word : words) {
+        if (line.size() + 1 + word.size() > LINE_WIDTH && line.size() > prefix.size()) {
+            text += line + "\n";
+            line = std::string(prefix.size(), ' ');
+        }
+        line += " " + word;
+    }
+    text += line + "\n";
+    fputs(text.c_str(), stderr);
+}
+
+bool SimArgs::parseNumber(const char* text, double* value) {
+    return parse_double(text, value);
+}
+
+bool SimArgs::parseList(const char* text, std::vector<double>* values) {
+    values->clear();
+    std::string list = text;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        double value;
+        if (!parse_double(list.substr(start, comma - start).c_str(), &value)) {
+            return false;
+        }
+        values->push_back(value);
+        start = comma + 1;
+    }
+    return !values->empty();
+}
+
+bool SimArgs::parseList(const char* text, std::vector<uint32_t>* values) {
+    std::vector<double> parsed;
+    if (!parseList(text, &parsed)) {
+        return false;
+    }
+    values->clear();
+    for (double value : parsed) {
+        if (value < 0 || value > UINT32_MAX || value != std::floor(value)) {
+            return false;
+        }
+        values->push_back((uint32_t)value);
+    }
+    return true;
+}
+
+// ============================================================================
+// JSON
+// ============================================================================
+
+SimJson::SimJson() : m_file(nullptr) {
+}
+
+SimJson::~SimJson() {
+    if (m_file) {
+        fclose(m_file);
+    }
+}
+
+bool SimJson::open(const std::string& path) {
+    m_file = fopen(path.c_str(), "w");
+    if (!m_file) {
+        return false;
+    }
+    m_levels.clear();
+    fputc('{', m_file);
+    m_levels.push_back({false, true, 0});
+    return true;
+}
+
+bool SimJson::close() {
+    if (!m_file) {
+        return false;
+    }
+    while (!m_levels.empty()) {
+        end();
+    }
+    fputc('\n', m_file);
+    bool ok = !ferror(m_file);
+    ok = fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+    return ok;
+}
+
+void SimJson::beginMember(const char* key, bool container) {
+    Level& level = m_levels.back();
+    if (level.members++) {
+        fputc(',', m_file);
+    }
+    if (level.multiline || (level.array && container)) {
+        level.multiline = true;
+        fprintf(m_file, "\n%*s", (int)(2 * m_levels.size()), "");
+    } else if (level.members > 1) {
+        fputc(' ', m_file);
+    }
+    if (key && !level.array) {
+        writeString(key);
+        fputs(": ", m_file);
+    }
+}
+
+void SimJson::begin(const char* key, bool array) {
+    beginMember(key, true);
+    fputc(array ? '[' : '{', m_file);
+    m_levels.push_back({array, false, 0});
+}
+
+void SimJson::end() {
+    Level level = m_levels.back();
+    m_levels.pop_back();
+    if (level.multiline) {
+        fprintf(m_file, "\n%*s", (int)(2 * m_levels.size()), "");
+    }
+    fputc(level.array ? ']' : '}', m_file);
+}
+
+void SimJson::beginObject(const char* key) {
+    begin(key, false);
+}
+
+void SimJson::endObject() {
+    end();
+}
+
+void SimJson::beginArray(const char* key) {
+    begin(key, true);
+}
+
+void SimJson::endArray() {
+    end();
+}
+
+void SimJson::add(const char* key, const std::string& value) {
+    beginMember(key, false);
+    writeString(value);
+}
+
+void SimJson::add(const char* key, const char* value) {
+    add(key, std::string(value ? value : ""));
+}
+
+void SimJson::add(const char* key, bool value) {
+    beginMember(key, false);
+    fputs(value ? "true" : "false", m_file);
+}
+
+void SimJson::add(const char* key, double value, int decimals) {
+    beginMember(key, false);
+    if (std::isfinite(value)) {
+        fprintf(m_file, "%.*f", decimals, value);
+    } else {
+        fputs("null", m_file);
+    }
+}
+
+void SimJson::addSigned(const char* key, long long value) {
+    beginMember(key, false);
+    fprintf(m_file, "%lld", value);
+}
+
+void SimJson::addUnsigned(const char* key, unsigned long long value) {
+    beginMember(key, false);
+    fprintf(m_file, "%llu", value);
+}
+
+void SimJson::writeString(const std::string& text) {
+    fputc('"', m_file);
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            fputc('\\', m_file);
+            fputc(c, m_file);
+        } else if (c < 0x20) {
+            fprintf(m_file, "\\u%04x", c);
+        } else {
+            fputc(c, m_file);
+        }
+    }
+    fputc('"', m_file);
+}
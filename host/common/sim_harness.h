@@ -0,0 +1,179 @@
+/**
+ * @file sim_harness.h
+ * @brief Shared pieces of the host simulators and benchmarks
+ *
+ * Every tool under host/ parses the same style of command line, collects
+ * latency samples, prints percentiles, writes its results as JSON and
+ * exits 0 when its checks passed, 1 when one failed and 2 on bad
+ * arguments or I/O errors. Those parts live here so each tool only holds
+ * its model and its report.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef SIM_HARNESS_H
+#define SIM_HARNESS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Exit status shared by every host tool
+enum {
+    SIM_EXIT_OK = 0,            // All checks passed
+    SIM_EXIT_FAILED = 1,        // A check failed
+    SIM_EXIT_USAGE = 2          // Bad arguments or an I/O error
+};
+
+// Value at fraction p (0.5 median, 0.99 p99, 1.0 max) of a sample set;
+// 0 for an empty set
+template <typename T>
+T sim_percentile(std::vector<T> values, double p) {
+    if (values.empty()) {
+        return T();
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+// done as a percentage of total; 100% of nothing is 100%
+inline double sim_share(double done, double total) {
+    return total > 0 ? 100.0 * done / total : 100.0;
+}
+
+// A set of samples with the summaries the reports print
+struct SimStat {
+    std::vector<double> values;
+
+    void add(double value) { values.push_back(value); }
+    size_t count() const { return values.size(); }
+    double mean() const;
+    double pct(double p) const { return sim_percentile(values, p); }
+    double min() const { return values.empty() ? 0 : *std::min_element(values.begin(), values.end()); }
+    double max() const { return values.empty() ? 0 : *std::max_element(values.begin(), values.end()); }
+};
+
+// Command-line options. Each tool registers its flags with a pointer to
+// the field they set; parse() fills them in and prints the usage line,
+// built from the registrations, on an unknown flag, a missing value, a
+// value that is not a number or a failed range check.
+class SimArgs {
+public:
+    // Parse the text of one value, or of several; false rejects them
+    typedef std::function<bool(const char* text)> Parser;
+    typedef std::function<bool(char** texts)> MultiParser;
+
+    SimArgs() = default;
+
+    void add(const char* flag, const char* metavar, uint32_t* value);
+    void add(const char* flag, const char* metavar, int* value);
+    void add(const char* flag, const char* metavar, double* value);
+    void add(const char* flag, const char* metavar, std::string* value);
+    void add(const char* flag, const char* metavar, Parser parser);
+
+    // A flag followed by several values, e.g. "--outage AT_S FOR_S"
+    void add(const char* flag, const char* metavar, double* first, double* second);
+    void add(const char* flag, const char* metavar, int values, MultiParser parser);
+
+    // A flag without a value that sets *value to true
+    void add(const char* flag, bool* value);
+
+    // Arguments without a flag, in order; optional ones may be left out
+    void positional(const char* metavar, std::string* value, bool required = true);
+
+    // Parse argv. Returns false, after printing the usage, if the command
+    // line is bad or valid is false once every option was applied.
+    bool parse(int argc, char** argv);
+    bool check(bool valid);
+
+    void usage() const;
+
+    // One number, rejecting trailing text
+    static bool parseNumber(const char* text, double* value);
+
+    // Comma-separated numbers, e.g. "0,0.1,0.2"
+    static bool parseList(const char* text, std::vector<double>* values);
+    static bool parseList(const char* text, std::vector<uint32_t>* values);
+
+private:
+    struct Option {
+        std::string flag;
+        std::string metavar;        // Empty for a flag without a value
+        int values;                 // Arguments after the flag
+        MultiParser parser;
+        bool* set;
+    };
+    struct Positional {
+        std::string metavar;
+        std::string* value;
+        bool required;
+    };
+
+    std::string m_program;
+    std::vector<Option> m_options;
+    std::vector<Positional> m_positionals;
+};
+
+// Writes one JSON document: members of the top-level object one per line,
+// every object or array inside an array on a line of its own, anything
+// deeper on that line. Numbers take the precision the caller gives;
+// strings are escaped.
+class SimJson {
+public:
+    SimJson();
+    ~SimJson();
+
+    SimJson(const SimJson&) = delete;
+    SimJson& operator=(const SimJson&) = delete;
+
+    // Opens the file and the top-level object; false if it cannot be written
+    bool open(const std::string& path);
+
+    // Closes the top-level object and the file; false on an I/O error
+    bool close();
+
+    // Containers. key is nullptr inside an array.
+    void beginObject(const char* key = nullptr);
+    void endObject();
+    void beginArray(const char* key = nullptr);
+    void endArray();
+
+    // Members; key is nullptr inside an array
+    void add(const char* key, const std::string& value);
+    void add(const char* key, const char* value);
+    void add(const char* key, bool value);
+    void add(const char* key, double value, int decimals = 1);
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type add(const char* key, T value) {
+        if (std::is_signed<T>::value) {
+            addSigned(key, (long long)value);
+        } else {
+            addUnsigned(key, (unsigned long long)value);
+        }
+    }
+
+private:
+    struct Level {
+        bool array;
+        bool multiline;         // Members start on their own lines
+        size_t members;
+    };
+
+    void addSigned(const char* key, long long value);
+    void addUnsigned(const char* key, unsigned long long value);
+    void beginMember(const char* key, bool container);
+    void begin(const char* key, bool array);
+    void end();
+    void writeString(const std::string& text);
+
+    FILE* m_file;
+    std::vector<Level> m_levels;
+};
+
+#endif // SIM_HARNESS_H
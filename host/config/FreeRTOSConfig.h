@@ -0,0 +1,80 @@
+/**
+ * @file FreeRTOSConfig.h
+ * @brief FreeRTOS configuration for the host build (POSIX port)
+ *
+ * Mirrors the ESP-IDF settings the firmware relies on (25 priorities,
+ * 1 kHz tick, recursive mutexes, trace facility) on top of the GCC_POSIX
+ * port. Tasks run as pthreads; the scheduler only lets one run at a time.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <assert.h>
+
+// Scheduler
+#define configUSE_PREEMPTION                    1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configUSE_TIME_SLICING                  1
+#define configIDLE_SHOULD_YIELD                 1
+#define configTICK_RATE_HZ                      1000
+#define configMAX_PRIORITIES                    25
+#define configTICK_TYPE_WIDTH_IN_BITS           TICK_TYPE_WIDTH_32_BITS
+
+// Stack depth is in words. Firmware code passes ESP-IDF byte counts, which
+// here become 8x larger stacks; pthreads need at least PTHREAD_STACK_MIN.
+#define configMINIMAL_STACK_SIZE                4096
+#define configMAX_TASK_NAME_LEN                 16
+
+// Memory: heap_3 wraps malloc, so configTOTAL_HEAP_SIZE is unused
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
+#define configSUPPORT_STATIC_ALLOCATION         0
+#define configTOTAL_HEAP_SIZE                   (64 * 1024 * 1024)
+
+// Synchronization
+#define configUSE_MUTEXES                       1
+#define configUSE_RECURSIVE_MUTEXES             1
+#define configUSE_COUNTING_SEMAPHORES           1
+#define configUSE_TASK_NOTIFICATIONS            1
+#define configUSE_QUEUE_SETS                    0
+#define configQUEUE_REGISTRY_SIZE               20
+
+// Software timers
+#define configUSE_TIMERS                        1
+#define configTIMER_TASK_PRIORITY               (configMAX_PRIORITIES - 1)
+#define configTIMER_QUEUE_LENGTH                20
+#define configTIMER_TASK_STACK_DEPTH            (configMINIMAL_STACK_SIZE * 2)
+
+// Hooks and diagnostics
+#define configUSE_IDLE_HOOK                     0
+#define configUSE_TICK_HOOK                     0
+#define configUSE_MALLOC_FAILED_HOOK            0
+#define configUSE_DAEMON_TASK_STARTUP_HOOK      0
+#define configCHECK_FOR_STACK_OVERFLOW          0
+#define configUSE_TRACE_FACILITY                1
+#define configGENERATE_RUN_TIME_STATS           0
+#define configTASKLIST_INCLUDE_COREID           0
+#define configASSERT(x)                         assert(x)
+
+// Optional API
+#define INCLUDE_vTaskPrioritySet                1
+#define INCLUDE_uxTaskPriorityGet               1
+#define INCLUDE_vTaskDelete                     1
+#define INCLUDE_vTaskSuspend                    1
+#define INCLUDE_vTaskDelayUntil                 1
+#define INCLUDE_xTaskDelayUntil                 1
+#define INCLUDE_vTaskDelay                      1
+#define INCLUDE_xTaskGetCurrentTaskHandle       1
+#define INCLUDE_xTaskGetSchedulerState          1
+#define INCLUDE_xTaskGetIdleTaskHandle          1
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_eTaskGetState                   1
+#define INCLUDE_xTaskGetHandle                  1
+#define INCLUDE_xTimerPendFunctionCall          1
+#define INCLUDE_xSemaphoreGetMutexHolder        1
+
+#endif // FREERTOS_CONFIG_H
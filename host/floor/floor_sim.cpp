@@ -0,0 +1,425 @@
+/**
+ * @file floor_sim.cpp
+ * @brief Push-to-talk collisions and latency in one talkgroup on simulated time
+ *
+ * --nodes nodes share one talkgroup. Each user presses PTT after an idle
+ * time drawn from an exponential distribution and talks for 2 - 8 s. The
+ * mean idle time is set so that the group offers --load talkers on
+ * average (0.4: one voice on the channel 40% of the time). Floor frames
+ * reach every other node after 5 - --delay-ms milliseconds (several mesh
+ * hops), each lost with probability --loss. The first --leaders nodes
+ * talk with leader priority.
+ *
+ * The same presses are replayed in two modes:
+ *
+ *   none    what audioTask did before: PTT starts the transmitter at once
+ *   floor   FloorControl; a user whose press is not granted within
+ *           --patience-ms lets go, the request stays queued, and the user
+ *           presses again --reaction-ms after the node shows "talk now".
+ *           A user cut off by a leader waits the same way for the rest of
+ *           the turn.
+ *
+ * Reported per mode: turns, the share of turns that overlapped another
+ * turn, the share of voice airtime with two or more talkers, PTT-to-audio
+ * latency (first press to transmitter on) for presses on a free floor and
+ * for presses that had to wait, and floor frames per turn.
+ *
+ * Exit status: 0 if floor control kept overlapping airtime under 1%, 1 if
+ * not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "floor_control.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static const uint32_t TICK_MS = 10;                 // floor_service tick
+static const uint32_t MIN_DELAY_MS = 5;
+static const uint32_t MIN_TALK_MS = 2000;
+static const uint32_t MAX_TALK_MS = 8000;
+static const uint32_t GIVE_UP_MS = 20000;           // User presses again if nothing happens for this long
+
+struct Options {
+    uint32_t nodes = 24;
+    uint32_t leaders = 2;
+    uint32_t durationS = 1800;
+    double load = 0.4;
+    uint32_t delayMs = 40;
+    double loss = 0.05;
+    uint32_t patienceMs = 1000;
+    uint32_t reactionMs = 300;
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+// One user's wish to talk, replayed in both modes
+struct Press {
+    uint32_t node;
+    uint32_t atMs;
+    uint32_t talkMs;
+};
+
+struct Turn {
+    uint32_t node;
+    uint32_t startMs;
+    uint32_t endMs;
+};
+
+struct Result {
+    std::string mode;
+    uint32_t presses = 0;
+    uint32_t turns = 0;
+    uint32_t collidedTurns = 0;
+    double voiceS = 0;
+    double overlapS = 0;
+    std::vector<uint32_t> freeLatencyMs;    // Press on a free floor to transmitter on
+    std::vector<uint32_t> queuedLatencyMs;  // Press on a busy floor to transmitter on
+    uint32_t preempted = 0;
+    uint32_t doubleHolds = 0;
+    uint32_t unserved = 0;                  // Presses that never got a turn
+    uint32_t frames = 0;
+};
+
+static std::vector<Press> make_presses(const Options& options) {
+    std::mt19937 rng(options.seed);
+    double talkMeanMs = (MIN_TALK_MS + MAX_TALK_MS) / 2.0;
+    double idleMeanMs = options.nodes * talkMeanMs / options.load - talkMeanMs;
+    std::exponential_distribution<double> idle(1.0 / idleMeanMs);
+    std::uniform_int_distribution<uint32_t> talk(MIN_TALK_MS, MAX_TALK_MS);
+    std::vector<Press> presses;
+    uint32_t endMs = options.durationS * 1000;
+    for (uint32_t node = 0; node < options.nodes; node++) {
+        double t = idle(rng);
+        while (t < endMs) {
+            Press press;
+            press.node = node;
+            press.atMs = (uint32_t)t;
+            press.talkMs = talk(rng);
+            presses.push_back(press);
+            t += press.talkMs + idle(rng);
+        }
+    }
+    std::sort(presses.begin(), presses.end(), [](const Press& a, const Press& b) { return a.atMs < b.atMs; });
+    return presses;
+}
+
+static void score_turns(std::vector<Turn> turns, Result* result) {
+    result->turns = (uint32_t)turns.size();
+    std::vector<std::pair<uint32_t, int>> edges;
+    for (size_t i = 0; i < turns.size(); i++) {
+        edges.push_back({turns[i].startMs, 1});
+        edges.push_back({turns[i].endMs, -1});
+        for (size_t j = 0; j < turns.size(); j++) {
+            if (i != j && turns[j].node != turns[i].node && turns[j].startMs < turns[i].endMs &&
+                turns[i].startMs < turns[j].endMs) {
+                result->collidedTurns++;
+                break;
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    int talkers = 0;
+    uint32_t lastMs = 0;
+    for (const auto& edge : edges) {
+        uint32_t span = edge.first - lastMs;
+        if (talkers >= 1) result->voiceS += span / 1000.0;
+        if (talkers >= 2) result->overlapS += span / 1000.0;
+        talkers += edge.second;
+        lastMs = edge.first;
+    }
+}
+
+static Result run_none(const Options& options, const std::vector<Press>& presses) {
+    Result result;
+    result.mode = "none";
+    std::vector<Turn> turns;
+    for (const Press& press : presses) {
+        turns.push_back({press.node, press.atMs, press.atMs + press.talkMs});
+        result.freeLatencyMs.push_back(0);
+    }
+    result.presses = (uint32_t)presses.size();
+    score_turns(turns, &result);
+    (void)options;
+    return result;
+}
+
+// ============================================================================
+// FLOOR CONTROL
+// ============================================================================
+
+enum UserState {
+    USER_IDLE,
+    USER_HOLDING,                           // PTT pressed, waiting for the transmitter
+    USER_WAITING,                           // Let go; request queued
+    USER_TALKING
+};
+
+struct SimNode {
+    std::unique_ptr<FloorControl> floor;
+    UserState user = USER_IDLE;
+    bool pressed = false;
+    std::vector<uint32_t> pending;          // Press indices not yet served
+    uint32_t firstPressMs = 0;
+    bool floorWasBusy = false;
+    uint32_t remainingMs = 0;               // Talk left in the current wish
+    uint32_t talkStartMs = 0;
+    uint32_t releaseAtMs = 0;
+    uint32_t patienceAtMs = 0;
+    uint32_t pressAgainAtMs = 0;
+    uint32_t waitingSinceMs = 0;
+    bool talking = false;
+};
+
+struct Delivery {
+    uint32_t to;
+    std::vector<uint8_t> frame;
+};
+
+static Result run_floor(const Options& options, const std::vector<Press>& presses) {
+    Result result;
+    result.mode = "floor";
+    result.presses = (uint32_t)presses.size();
+
+    std::mt19937 rng(options.seed * 7919 + 1);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<uint32_t> delay(MIN_DELAY_MS, std::max(MIN_DELAY_MS, options.delayMs));
+    std::multimap<uint32_t, Delivery> air;
+    std::vector<SimNode> nodes(options.nodes);
+    std::vector<Turn> turns;
+    uint32_t nowMs = 0;
+
+    for (uint32_t i = 0; i < options.nodes; i++) {
+        uint8_t priority = i < options.leaders ? FLOOR_PRIORITY_LEADER : FLOOR_PRIORITY_NORMAL;
+        SimNode* node = &nodes[i];
+        auto send = [&, i](const std::vector<uint8_t>& frame) {
+            result.frames++;
+            for (uint32_t to = 0; to < options.nodes; to++) {
+                if (to != i && chance(rng) >= options.loss) {
+                    air.insert({nowMs + delay(rng), Delivery{to, frame}});
+                }
+            }
+            return true;
+        };
+        auto talk = [&, node, i](bool on) {
+            if (on && !node->talking) {
+                node->talking = true;
+                node->talkStartMs = nowMs;
+                if (node->remainingMs == 0 && !node->pending.empty()) {
+                    // First turn of this wish
+                    const Press& press = presses[node->pending.front()];
+                    node->remainingMs = press.talkMs;
+                    uint32_t latency = nowMs - node->firstPressMs;
+                    (node->floorWasBusy ? result.queuedLatencyMs : result.freeLatencyMs).push_back(latency);
+                }
+                node->user = USER_TALKING;
+                node->releaseAtMs = nowMs + node->remainingMs;
+            } else if (!on && node->talking) {
+                node->talking = false;
+                turns.push_back({i, node->talkStartMs, nowMs});
+                uint32_t spoken = nowMs - node->talkStartMs;
+                node->remainingMs = spoken >= node->remainingMs ? 0 : node->remainingMs - spoken;
+            }
+        };
+        node->floor.reset(new FloorControl("node-" + std::to_string(i), priority, send, talk,
+                                           floor_default_config(), options.seed * 1000 + i + 1));
+    }
+
+    auto press = [&](SimNode& node) {
+        node.pressed = true;
+        node.floor->pttDown(nowMs);
+        if (!node.talking) {
+            node.user = USER_HOLDING;
+            node.patienceAtMs = nowMs + options.patienceMs;
+        }
+    };
+    auto release = [&](SimNode& node) {
+        node.pressed = false;
+        node.floor->pttUp(nowMs);
+    };
+
+    size_t nextPress = 0;
+    uint32_t endMs = options.durationS * 1000 + 60000;     // Time to drain the queues
+    for (nowMs = 0; nowMs < endMs; nowMs++) {
+        while (nextPress < presses.size() && presses[nextPress].atMs == nowMs) {
+            SimNode& node = nodes[presses[nextPress].node];
+            node.pending.push_back((uint32_t)nextPress);
+            if (node.user == USER_IDLE) {
+                node.firstPressMs = nowMs;
+                floor_state_t state = node.floor->state();
+                node.floorWasBusy = state == FLOOR_STATE_BUSY || state == FLOOR_STATE_QUEUED;
+                press(node);
+            }
+            nextPress++;
+        }
+
+        for (auto it = air.begin(); it != air.end() && it->first <= nowMs; it = air.erase(it)) {
+            nodes[it->second.to].floor->handleFrame(it->second.frame.data(), it->second.frame.size(), nowMs);
+        }
+
+        for (uint32_t i = 0; i < options.nodes; i++) {
+            SimNode& node = nodes[i];
+            if ((nowMs + i) % TICK_MS == 0) {
+                node.floor->tick(nowMs);
+            }
+            floor_state_t state = node.floor->state();
+            switch (node.user) {
+                case USER_TALKING:
+                    if (!node.talking) {
+                        // Cut off: wait for the floor to come back
+                        if (node.pressed) release(node);
+                        node.user = node.remainingMs ? USER_WAITING : USER_IDLE;
+                        node.waitingSinceMs = nowMs;
+                        node.pressAgainAtMs = 0;
+                    } else if (nowMs >= node.releaseAtMs) {
+                        release(node);
+                    }
+                    if (!node.talking && node.remainingMs == 0) {
+                        node.pending.erase(node.pending.begin());
+                        node.user = USER_IDLE;
+                        if (!node.pending.empty()) {
+                            node.firstPressMs = nowMs;
+                            node.floorWasBusy = node.floor->state() != FLOOR_STATE_IDLE;
+                            press(node);
+                        }
+                    }
+                    break;
+                case USER_HOLDING:
+                    if (nowMs >= node.patienceAtMs) {
+                        release(node);
+                        node.user = USER_WAITING;
+                        node.waitingSinceMs = nowMs;
+                        node.pressAgainAtMs = 0;
+                    }
+                    break;
+                case USER_WAITING:
+                    if (state == FLOOR_STATE_GRANTED) {
+                        if (!node.pressAgainAtMs) node.pressAgainAtMs = nowMs + options.reactionMs;
+                        if (nowMs >= node.pressAgainAtMs) press(node);
+                    } else if (state == FLOOR_STATE_QUEUED || state == FLOOR_STATE_REQUESTING) {
+                        node.waitingSinceMs = nowMs;
+                        node.pressAgainAtMs = 0;
+                    } else if (nowMs - node.waitingSinceMs > GIVE_UP_MS ||
+                               (state == FLOOR_STATE_IDLE && nowMs - node.waitingSinceMs > options.reactionMs)) {
+                        // The request is gone: press again
+                        press(node);
+                    }
+                    break;
+                case USER_IDLE:
+                    break;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < options.nodes; i++) {
+        const floor_stats_t& stats = nodes[i].floor->stats();
+        result.preempted += stats.preempted;
+        result.doubleHolds += stats.double_holds;
+        if (nodes[i].talking) {
+            turns.push_back({i, nodes[i].talkStartMs, nowMs});
+        }
+        result.unserved += (uint32_t)nodes[i].pending.size();
+    }
+    score_turns(turns, &result);
+    return result;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static void print_result(const Result& r) {
+    printf("%-6s %7u %6u %9.1f%% %9.2f%% %6u %6u %7u %7u %6u %6u %8.1f\n", r.mode.c_str(), r.presses, r.turns,
+           r.turns ? 100.0 * r.collidedTurns / r.turns : 0.0, r.voiceS > 0 ? 100.0 * r.overlapS / r.voiceS : 0.0,
+           sim_percentile(r.freeLatencyMs, 0.5), sim_percentile(r.freeLatencyMs, 0.95), sim_percentile(r.queuedLatencyMs, 0.5),
+           sim_percentile(r.queuedLatencyMs, 0.95), r.preempted, r.unserved,
+           r.turns ? (double)r.frames / r.turns : 0.0);
+}
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<Result>& results) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("nodes", options.nodes);
+    json.add("leaders", options.leaders);
+    json.add("duration_s", options.durationS);
+    json.add("load", options.load, 2);
+    json.add("delay_ms", options.delayMs);
+    json.add("loss", options.loss, 3);
+    json.beginArray("results");
+    for (const Result& r : results) {
+        json.beginObject();
+        json.add("mode", r.mode);
+        json.add("presses", r.presses);
+        json.add("turns", r.turns);
+        json.add("collided_turns", r.collidedTurns);
+        json.add("voice_s", r.voiceS);
+        json.add("overlap_s", r.overlapS);
+        json.add("free_latency_p50_ms", sim_percentile(r.freeLatencyMs, 0.5));
+        json.add("free_latency_p95_ms", sim_percentile(r.freeLatencyMs, 0.95));
+        json.add("queued_latency_p50_ms", sim_percentile(r.queuedLatencyMs, 0.5));
+        json.add("queued_latency_p95_ms", sim_percentile(r.queuedLatencyMs, 0.95));
+        json.add("preempted", r.preempted);
+        json.add("double_holds", r.doubleHolds);
+        json.add("unserved", r.unserved);
+        json.add("frames", r.frames);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--nodes", "N", &options.nodes);
+    args.add("--leaders", "N", &options.leaders);
+    args.add("--duration-s", "S", &options.durationS);
+    args.add("--load", "TALKERS", &options.load);
+    args.add("--delay-ms", "MS", &options.delayMs);
+    args.add("--loss", "P", &options.loss);
+    args.add("--patience-ms", "MS", &options.patienceMs);
+    args.add("--reaction-ms", "MS", &options.reactionMs);
+    args.add("--seed", "N", &options.seed);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv) ||
+        !args.check(options.nodes >= 2 && options.nodes <= 256 && options.load > 0 && options.load < options.nodes &&
+                    options.loss >= 0 && options.loss < 1)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    std::vector<Press> presses = make_presses(options);
+    std::vector<Result> results;
+    results.push_back(run_none(options, presses));
+    results.push_back(run_floor(options, presses));
+
+    printf("%u nodes (%u leaders), %u s, offered load %.2f talkers, %u ms max delay, %.0f%% loss\n\n",
+           options.nodes, options.leaders, options.durationS, options.load, options.delayMs, options.loss * 100);
+    printf("%-6s %7s %6s %10s %10s %6s %6s %7s %7s %6s %6s %8s\n", "mode", "presses", "turns", "collided",
+           "overlap", "free50", "free95", "queue50", "queue95", "preempt", "unsrvd", "frm/turn");
+    for (const Result& r : results) {
+        print_result(r);
+    }
+    printf("\nlatencies in ms from first press to transmitter on\n");
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, results)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    const Result& floor = results.back();
+    return floor.voiceS > 0 && floor.overlapS / floor.voiceS >= 0.01 ? SIM_EXIT_FAILED : SIM_EXIT_OK;
+}
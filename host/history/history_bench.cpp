@@ -0,0 +1,493 @@
+/**
+ * @file history_bench.cpp
+ * @brief Message history append and lookup throughput and boot time on a flash emulator
+ *
+ * Drives MessageHistory over a storage in RAM that behaves like segment
+ * files on SPIFFS and charges every call a modelled flash time: an
+ * operation costs FLASH_OP_US (file lookup), reading FLASH_READ_US_PER_KB,
+ * writing FLASH_PROGRAM_US_PER_KB plus the 4 KB erases the written bytes
+ * use up. Host CPU time and modelled flash time are reported separately;
+ * on the device the first is roughly ten times longer.
+ *
+ * --messages text messages (8 - 160 characters) go to --conversations
+ * peers, one every 10 s of simulated time with the background tick in
+ * between, so old segments age out once the log passes its size. Then
+ * --lookups random pages of three messages, as the chat screen reads them,
+ * each checked against what was sent. Then start-up, four ways: from a
+ * fresh checkpoint, from a checkpoint with --tail messages appended after
+ * it, without an index (rebuilt from every segment, which is also what
+ * loading every message would cost), and --restarts times after a power
+ * loss that tore an append, each checked for lost or damaged messages.
+ *
+ * Exit status: 0 if every check passed, 1 if not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "message_history.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Flash cost model: SPIFFS on QSPI NOR flash
+static const double FLASH_OP_US = 300;              // Open and seek through the page lookups
+static const double FLASH_READ_US_PER_KB = 25;      // 80 MHz quad read
+static const double FLASH_PROGRAM_US_PER_KB = 1600; // 256-byte page program, 0.4 ms typical
+static const double FLASH_ERASE_US = 45000;         // 4 KB sector erase, typical
+static const uint32_t MESSAGE_INTERVAL_MS = 10000;
+static const uint32_t TICK_MS = 1000;               // history_service tick
+static const size_t PAGE_ROWS = 3;                  // Chat screen rows
+
+struct Options {
+    uint32_t messages = 5000;
+    uint32_t conversations = 20;
+    uint32_t lookups = 2000;
+    uint32_t tail = 30;
+    uint32_t restarts = 20;
+    uint32_t maxKb = 64;
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+// ============================================================================
+// FLASH EMULATOR
+// ============================================================================
+
+class FlashEmulator : public IHistoryStorage {
+public:
+    struct Counters {
+        uint64_t ops = 0;
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
+        double us = 0;                      // Modelled flash time
+    };
+
+    bool list(std::vector<uint16_t>* segments) override {
+        charge(0, 0);
+        segments->clear();
+        for (const auto& entry : m_segments) {
+            segments->push_back(entry.first);
+        }
+        return true;
+    }
+
+    bool size(uint16_t segment, uint32_t* bytes) override {
+        charge(0, 0);
+        auto it = m_segments.find(segment);
+        if (it == m_segments.end()) {
+            return false;
+        }
+        *bytes = (uint32_t)it->second.size();
+        return true;
+    }
+
+    size_t read(uint16_t segment, uint32_t offset, uint8_t* out, size_t length) override {
+        auto it = m_segments.find(segment);
+        if (it == m_segments.end() || offset >= it->second.size()) {
+            charge(0, 0);
+            return 0;
+        }
+        size_t got = std::min(length, it->second.size() - offset);
+        memcpy(out, it->second.data() + offset, got);
+        charge(got, 0);
+        return got;
+    }
+
+    bool append(uint16_t segment, const uint8_t* data, size_t length) override {
+        std::vector<uint8_t>& file = m_segments[segment];
+        file.insert(file.end(), data, data + length);
+        charge(0, length);
+        return true;
+    }
+
+    bool remove(uint16_t segment) override {
+        charge(0, 0);
+        return m_segments.erase(segment) == 1;
+    }
+
+    bool loadIndex(std::vector<uint8_t>* index) override {
+        *index = m_index;
+        charge(m_index.size(), 0);
+        return true;
+    }
+
+    bool saveIndex(const std::vector<uint8_t>& index) override {
+        m_index = index;
+        charge(0, index.size());
+        return true;
+    }
+
+    // What a power loss in the middle of an append leaves behind
+    void tearAppend(uint16_t segment, size_t length, std::mt19937& rng) {
+        std::vector<uint8_t>& file = m_segments[segment];
+        file.push_back((uint8_t)length);
+        file.push_back(0);
+        for (size_t i = 2; i < length; i++) {
+            file.push_back((uint8_t)rng());
+        }
+    }
+
+    void dropIndex() { m_index.clear(); }
+    uint16_t lastSegment() const { return m_segments.empty() ? 0 : m_segments.rbegin()->first; }
+    size_t segmentCount() const { return m_segments.size(); }
+
+    uint64_t storedBytes() const {
+        uint64_t bytes = m_index.size();
+        for (const auto& entry : m_segments) {
+            bytes += entry.second.size();
+        }
+        return bytes;
+    }
+
+    Counters counters;
+
+private:
+    void charge(size_t readBytes, size_t writtenBytes) {
+        counters.ops++;
+        counters.bytesRead += readBytes;
+        counters.bytesWritten += writtenBytes;
+        counters.us += FLASH_OP_US + readBytes * FLASH_READ_US_PER_KB / 1024 +
+                       writtenBytes * (FLASH_PROGRAM_US_PER_KB + FLASH_ERASE_US / 4) / 1024;
+    }
+
+    std::map<uint16_t, std::vector<uint8_t>> m_segments;
+    std::vector<uint8_t> m_index;
+};
+
+// ============================================================================
+// WORKLOAD
+// ============================================================================
+
+struct Sent {
+    uint8_t direction;
+    std::string text;
+};
+
+// Everything sent, per conversation, to check pages against
+typedef std::map<std::string, std::vector<Sent>> Model;
+
+struct Measure {
+    std::string name;
+    uint64_t calls = 0;
+    double cpuUs = 0;
+    double flashUs = 0;
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    uint32_t records = 0;                   // Decrypted by load()
+    bool ok = true;
+};
+
+class Stopwatch {
+public:
+    Stopwatch(FlashEmulator& flash) : m_flash(flash), m_before(flash.counters),
+                                      m_start(std::chrono::steady_clock::now()) {}
+
+    void stop(Measure* measure) {
+        auto end = std::chrono::steady_clock::now();
+        measure->cpuUs += std::chrono::duration<double, std::micro>(end - m_start).count();
+        measure->flashUs += m_flash.counters.us - m_before.us;
+        measure->bytesRead += m_flash.counters.bytesRead - m_before.bytesRead;
+        measure->bytesWritten += m_flash.counters.bytesWritten - m_before.bytesWritten;
+    }
+
+private:
+    FlashEmulator& m_flash;
+    FlashEmulator::Counters m_before;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+static std::string random_text(std::mt19937& rng) {
+    static const char charset[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?";
+    size_t length = 8 + rng() % 153;
+    std::string text;
+    for (size_t i = 0; i < length; i++) {
+        text += charset[rng() % (sizeof(charset) - 1)];
+    }
+    return text;
+}
+
+static std::string peer_name(uint32_t index) {
+    char name[16];
+    snprintf(name, sizeof(name), "TEAM-%02u", index);
+    return name;
+}
+
+// The history holds the newest messages of each conversation; compare them
+// all with what was sent
+static bool check_all(MessageHistory& history, const Model& model) {
+    std::vector<history_message_t> page(64);
+    for (const auto& entry : model) {
+        size_t held = history.count(entry.first);
+        if (held > entry.second.size()) {
+            return false;
+        }
+        for (size_t skip = 0; skip < held; skip += page.size()) {
+            size_t got = history.page(entry.first, skip, page.data(), page.size());
+            if (got != std::min(page.size(), held - skip)) {
+                return false;
+            }
+            for (size_t i = 0; i < got; i++) {
+                const Sent& sent = entry.second[entry.second.size() - 1 - skip - i];
+                if (page[i].direction != sent.direction || sent.text != page[i].text) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static size_t held_total(MessageHistory& history, const Model& model) {
+    size_t held = 0;
+    for (const auto& entry : model) {
+        held += history.count(entry.first);
+    }
+    return held;
+}
+
+static const uint8_t* bench_key() {
+    static uint8_t key[HISTORY_KEY_SIZE];
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key[i] = (uint8_t)(i * 7 + 1);
+    }
+    return key;
+}
+
+static history_config_t bench_config(const Options& options) {
+    history_config_t config = history_default_config();
+    config.max_bytes = options.maxKb * 1024;
+    return config;
+}
+
+// A start-up: a new instance over the same flash, as after a reset
+static Measure measure_load(const char* name, FlashEmulator& flash, const Options& options, uint64_t seed,
+                            const Model& model, size_t expectHeld, MessageHistory** out) {
+    Measure measure;
+    measure.name = name;
+    MessageHistory* history = new MessageHistory(&flash, bench_key(), seed, bench_config(options));
+    Stopwatch watch(flash);
+    measure.ok = history->load(0);
+    watch.stop(&measure);
+    measure.calls = 1;
+    measure.records = history->stats().load_records;
+    measure.ok = measure.ok && held_total(*history, model) == expectHeld && check_all(*history, model);
+    *out = history;
+    return measure;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static void print_measure(const Measure& m) {
+    double calls = m.calls ? (double)m.calls : 1.0;
+    printf("%-26s %8llu %10.1f %12.1f %10.0f %10.0f %8u %5s\n", m.name.c_str(), (unsigned long long)m.calls,
+           m.cpuUs / calls, m.flashUs / calls, m.bytesRead / calls, m.bytesWritten / calls, m.records,
+           m.ok ? "ok" : "FAIL");
+}
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<Measure>& measures,
+                       uint64_t textBytes, uint64_t logBytes, uint32_t held) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("messages", options.messages);
+    json.add("conversations", options.conversations);
+    json.add("max_kb", options.maxKb);
+    json.add("held", held);
+    json.add("text_bytes", textBytes);
+    json.add("flash_bytes", logBytes);
+    json.beginArray("results");
+    for (const Measure& m : measures) {
+        double calls = m.calls ? (double)m.calls : 1.0;
+        json.beginObject();
+        json.add("name", m.name);
+        json.add("calls", m.calls);
+        json.add("cpu_us", m.cpuUs / calls, 2);
+        json.add("flash_us", m.flashUs / calls);
+        json.add("bytes_read", m.bytesRead / calls, 0);
+        json.add("bytes_written", m.bytesWritten / calls, 0);
+        json.add("records", m.records);
+        json.add("ok", m.ok);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--messages", "N", &options.messages);
+    args.add("--conversations", "N", &options.conversations);
+    args.add("--lookups", "N", &options.lookups);
+    args.add("--tail", "N", &options.tail);
+    args.add("--restarts", "N", &options.restarts);
+    args.add("--max-kb", "N", &options.maxKb);
+    args.add("--seed", "N", &options.seed);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv) ||
+        !args.check(options.messages > 0 && options.conversations > 0 && options.conversations <= 99 &&
+                    options.maxKb >= 16)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    std::mt19937 rng(options.seed);
+    FlashEmulator flash;
+    Model model;
+    std::vector<Measure> measures;
+    uint64_t textBytes = 0;
+    uint64_t seed = options.seed;
+
+    // Traffic, with the background tick between messages
+    MessageHistory* history = new MessageHistory(&flash, bench_key(), ++seed, bench_config(options));
+    history->load(0);
+    Measure append, tick;
+    append.name = "append";
+    tick.name = "tick (drop, checkpoint)";
+    uint32_t nowMs = 0;
+    for (uint32_t i = 0; i < options.messages; i++) {
+        std::string peer = peer_name(rng() % options.conversations);
+        Sent sent = {(uint8_t)(rng() % 3 == 0 ? HISTORY_DIRECTION_TX : HISTORY_DIRECTION_RX), random_text(rng)};
+        Stopwatch watch(flash);
+        append.ok = history->append(peer, sent.direction, 1700000000 + nowMs / 1000, sent.text, nowMs) && append.ok;
+        watch.stop(&append);
+        append.calls++;
+        model[peer].push_back(sent);
+        textBytes += sent.text.size();
+        for (uint32_t t = 0; t < MESSAGE_INTERVAL_MS; t += TICK_MS) {
+            nowMs += TICK_MS;
+            Stopwatch tickWatch(flash);
+            history->tick(nowMs);
+            tickWatch.stop(&tick);
+            tick.calls++;
+        }
+    }
+    measures.push_back(append);
+    measures.push_back(tick);
+
+    // Chat screen pages
+    Measure lookup;
+    lookup.name = "page of 3";
+    std::vector<std::string> peers;
+    for (const auto& entry : model) {
+        peers.push_back(entry.first);
+    }
+    for (uint32_t i = 0; i < options.lookups; i++) {
+        const std::string& peer = peers[rng() % peers.size()];
+        size_t held = history->count(peer);
+        size_t skip = held ? rng() % held : 0;
+        history_message_t page[PAGE_ROWS];
+        Stopwatch watch(flash);
+        size_t got = history->page(peer, skip, page, PAGE_ROWS);
+        watch.stop(&lookup);
+        lookup.calls++;
+        const std::vector<Sent>& sent = model[peer];
+        bool ok = got == std::min(PAGE_ROWS, held - skip);
+        for (size_t j = 0; ok && j < got; j++) {
+            ok = sent[sent.size() - 1 - skip - j].text == page[j].text;
+        }
+        lookup.ok = lookup.ok && ok;
+    }
+    measures.push_back(lookup);
+    Measure conversations;
+    conversations.name = "conversation list";
+    for (uint32_t i = 0; i < options.lookups; i++) {
+        history_conversation_t list[16];
+        Stopwatch watch(flash);
+        history->conversations(list, 16);
+        watch.stop(&conversations);
+        conversations.calls++;
+    }
+    measures.push_back(conversations);
+
+    size_t held = held_total(*history, model);
+    uint32_t heldKb = history->logBytes() / 1024;
+    history_stats_t finalStats = history->stats();
+
+    // Start-up from a fresh checkpoint
+    history->checkpoint();
+    delete history;
+    measures.push_back(measure_load("load: checkpoint", flash, options, ++seed, model, held, &history));
+
+    // ... with messages appended after it
+    for (uint32_t i = 0; i < options.tail; i++) {
+        std::string peer = peer_name(rng() % options.conversations);
+        Sent sent = {HISTORY_DIRECTION_RX, random_text(rng)};
+        history->append(peer, sent.direction, 0, sent.text, 0);
+        model[peer].push_back(sent);
+        held++;
+    }
+    delete history;
+    measures.push_back(measure_load("load: checkpoint + tail", flash, options, ++seed, model, held, &history));
+    delete history;
+
+    // ... and without an index
+    flash.dropIndex();
+    measures.push_back(measure_load("load: rebuild (no index)", flash, options, ++seed, model, held, &history));
+
+    // Power lost in the middle of appends
+    Measure restarts;
+    restarts.name = "load: after torn append";
+    for (uint32_t r = 0; r < options.restarts; r++) {
+        for (uint32_t i = 0; i < 1 + rng() % 8; i++) {
+            std::string peer = peer_name(rng() % options.conversations);
+            Sent sent = {HISTORY_DIRECTION_TX, random_text(rng)};
+            history->append(peer, sent.direction, 0, sent.text, 0);
+            model[peer].push_back(sent);
+        }
+        history->tick(0);
+        flash.tearAppend(flash.lastSegment(), 20 + rng() % 100, rng);
+        size_t before = held_total(*history, model);
+        delete history;
+        Measure one = measure_load("", flash, options, ++seed, model, before, &history);
+        restarts.calls++;
+        restarts.cpuUs += one.cpuUs;
+        restarts.flashUs += one.flashUs;
+        restarts.bytesRead += one.bytesRead;
+        restarts.records += one.records;
+        restarts.ok = restarts.ok && one.ok;
+    }
+    if (options.restarts) {
+        restarts.records /= options.restarts;
+        measures.push_back(restarts);
+    }
+    delete history;
+
+    printf("%u messages to %u peers, %u KB log kept: %u messages in %u KB, %u segments dropped\n",
+           options.messages, options.conversations, options.maxKb, (unsigned)held, heldKb,
+           finalStats.segments_dropped);
+    printf("flash written: %.1f KB log + %.1f KB index checkpoints for %.1f KB of text (%.2f per text byte)\n\n",
+           finalStats.log_bytes_written / 1024.0, finalStats.checkpoint_bytes_written / 1024.0, textBytes / 1024.0,
+           (double)(finalStats.log_bytes_written + finalStats.checkpoint_bytes_written) / textBytes);
+    printf("%-26s %8s %10s %12s %10s %10s %8s %5s\n", "operation", "calls", "cpu us", "flash us*", "read B",
+           "written B", "records", "check");
+    bool passed = true;
+    for (const Measure& m : measures) {
+        print_measure(m);
+        passed = passed && m.ok;
+    }
+    printf("\nPer call. *modelled SPIFFS time: %.0f us per operation, %.0f us/KB read, %.0f us/KB written\n"
+           "plus erases. records: decrypted at start-up.\n",
+           FLASH_OP_US, FLASH_READ_US_PER_KB, FLASH_PROGRAM_US_PER_KB + FLASH_ERASE_US / 4);
+
+    if (!options.jsonPath.empty() &&
+        !write_json(options.jsonPath, options, measures, textBytes,
+                    finalStats.log_bytes_written + finalStats.checkpoint_bytes_written, (uint32_t)held)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return passed ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
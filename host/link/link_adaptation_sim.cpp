@@ -0,0 +1,423 @@
+/**
+ * @file link_adaptation_sim.cpp
+ * @brief Goodput of closed-loop link adaptation while the SNR sweeps down and back up
+ *
+ * Three talkers and one receiver run as Sim-HaLow nodes in this process,
+ * in real time. All links share one SNR, which steps from --snr-high down
+ * to --snr-low and back up again, --rounds rounds per step, and finally
+ * holds at --snr-high for --settle-rounds. Sim-HaLow turns the SNR and the
+ * rate of each frame into a packet error rate (halow_phy.h), so frames
+ * sent faster than the link allows are lost.
+ *
+ * Every round each talker sends --frames frames to the receiver:
+ *
+ * - adaptive: its rate comes from LinkAdaptation, which polls the talker's
+ *   radio for RSSI and is told how many frames arrived after every round
+ * - fastest: fixed at the top of the controller's rate ladder
+ * - robust: fixed at MCS 10 on 1 MHz
+ *
+ * SNR is given against the noise floor of the widest channel the
+ * controller may use (2 MHz by default). Reported per step: the rate the
+ * adaptive talker ended on, and for each talker its goodput (PHY rate
+ * times the fraction of frames delivered) and loss; then the voice tier
+ * the controller chose, and whether a voice codec is running to apply it.
+ *
+ * Exit status: 0 if the adaptive talker reached the most robust rate at
+ * the bottom of the sweep and the fastest again after settling, its voice
+ * tier went up and came back to the best tier, its loss stayed within
+ * --max-loss and its mean goodput beat both fixed rates; 1 if not, 2 on
+ * bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "link_adaptation.h"
+#include "halow_phy.h"
+#include "sim_halow.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t SIM_CHANNEL = 737;            // Away from the channels other tools use
+static const uint32_t BEACON_MS = 100;
+static const char* RECEIVER_ID = "la-receiver";
+
+enum Talker { TALKER_ADAPTIVE, TALKER_FASTEST, TALKER_ROBUST, TALKER_COUNT };
+static const char* TALKER_IDS[TALKER_COUNT] = {"la-adaptive", "la-fastest", "la-robust"};
+static const char* TALKER_NAMES[TALKER_COUNT] = {"adaptive", "fastest", "robust"};
+
+// ============================================================================
+// NODES
+// ============================================================================
+
+/**
+ * @brief Counts the frames that reached the receiver, per talker
+ */
+struct Receiver {
+    std::mutex mutex;
+    std::map<std::string, uint32_t> frames;
+
+    void onData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+        (void)data;
+        std::lock_guard<std::mutex> lock(mutex);
+        frames[peer_id]++;
+    }
+
+    uint32_t take(const std::string& peer_id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t count = frames[peer_id];
+        frames[peer_id] = 0;
+        return count;
+    }
+};
+
+static bool start_node(SimHaLow& radio) {
+    HaLowConfig config = HaLowConfig();
+    config.ssid = "link-adaptation-sim";
+    config.channel = SIM_CHANNEL;
+    config.enable_mesh = true;
+    config.heartbeat_interval = BEACON_MS;
+    return radio.initialize(config) && radio.startDiscovery();
+}
+
+static bool has_peer(SimHaLow& radio, const std::string& peer_id) {
+    for (const HaLowPeerInfo& peer : radio.getConnectedPeers()) {
+        if (peer.peer_id == peer_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool set_rate(SimHaLow& radio, link_rate_t rate) {
+    std::string result = radio.sendRawCommand(
+        "set_link_rate", {RECEIVER_ID, std::to_string(rate.mcs), std::to_string(rate.bandwidth_mhz)});
+    return result.compare(0, 5, "ERROR") != 0;
+}
+
+// ============================================================================
+// SWEEP
+// ============================================================================
+
+struct Options {
+    double snrHigh = 30;
+    double snrLow = -2;
+    double stepDb = 2;
+    uint32_t rounds = 4;
+    uint32_t settleRounds = 20;
+    uint32_t roundMs = 60;
+    uint32_t frames = 20;
+    uint32_t size = 32;
+    uint32_t maxBandwidthMhz = 2;
+    double maxLoss = 0.1;
+    uint32_t timeoutS = 10;
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+struct TalkerTotals {
+    SimStat goodputKbps;            // One sample per round
+    uint32_t sent = 0;
+    uint32_t delivered = 0;
+
+    double loss() const { return sent > 0 ? 1.0 - (double)delivered / sent : 0; }
+};
+
+struct StepResult {
+    double snr = 0;
+    int32_t rssi = 0;
+    link_rate_t rate = {};          // Adaptive talker, at the end of the step
+    uint8_t voiceTier = 0;
+    double goodputKbps[TALKER_COUNT] = {};
+    double loss[TALKER_COUNT] = {};
+};
+
+static uint32_t rate_kbps(link_rate_t rate) {
+    return halow_phy_rate_kbps(rate.mcs, rate.bandwidth_mhz);
+}
+
+static std::string rate_name(link_rate_t rate) {
+    return "MCS" + std::to_string(rate.mcs) + "/" + std::to_string(rate.bandwidth_mhz) + "MHz";
+}
+
+static bool find_receiver_link(link_adaptation_link_t* link) {
+    for (const link_adaptation_link_t& entry : LinkAdaptation::getInstance().getLinks()) {
+        if (entry.peer_id == RECEIVER_ID) {
+            *link = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<StepResult>& steps,
+                       const TalkerTotals* totals, bool codecRunning) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("snr_high_db", options.snrHigh);
+    json.add("snr_low_db", options.snrLow);
+    json.add("rounds_per_step", options.rounds);
+    json.add("frames_per_round", options.frames);
+    json.add("frame_bytes", options.size);
+    json.add("codec_running", codecRunning);
+    json.beginObject("talkers");
+    for (int t = 0; t < TALKER_COUNT; t++) {
+        json.beginObject(TALKER_NAMES[t]);
+        json.add("goodput_kbps", totals[t].goodputKbps.mean());
+        json.add("loss", totals[t].loss(), 4);
+        json.endObject();
+    }
+    json.endObject();
+    json.beginArray("steps");
+    for (const StepResult& step : steps) {
+        json.beginObject();
+        json.add("snr_db", step.snr);
+        json.add("rssi_dbm", step.rssi);
+        json.add("mcs", step.rate.mcs);
+        json.add("bandwidth_mhz", step.rate.bandwidth_mhz);
+        json.add("voice_tier", step.voiceTier);
+        json.add("adaptive_kbps", step.goodputKbps[TALKER_ADAPTIVE]);
+        json.add("fastest_kbps", step.goodputKbps[TALKER_FASTEST]);
+        json.add("robust_kbps", step.goodputKbps[TALKER_ROBUST]);
+        json.add("adaptive_loss", step.loss[TALKER_ADAPTIVE], 4);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--snr-high", "DB", &options.snrHigh);
+    args.add("--snr-low", "DB", &options.snrLow);
+    args.add("--step-db", "DB", &options.stepDb);
+    args.add("--rounds", "N", &options.rounds);
+    args.add("--settle-rounds", "N", &options.settleRounds);
+    args.add("--round-ms", "MS", &options.roundMs);
+    args.add("--frames", "N", &options.frames);
+    args.add("--size", "BYTES", &options.size);
+    args.add("--max-bandwidth", "MHZ", &options.maxBandwidthMhz);
+    args.add("--max-loss", "FRACTION", &options.maxLoss);
+    args.add("--timeout-s", "S", &options.timeoutS);
+    args.add("--seed", "N", &options.seed);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv)) {
+        return SIM_EXIT_USAGE;
+    }
+    if (!args.check(options.snrHigh > options.snrLow && options.stepDb > 0 && options.rounds > 0 &&
+                    options.roundMs > 0 && options.frames > 0 && options.size > 0 && options.size <= 1400 &&
+                    halow_bandwidth_index((uint8_t)options.maxBandwidthMhz) >= 0)) {
+        return SIM_EXIT_USAGE;
+    }
+    if (!getenv("AIRCOM_HOST_LOG_LEVEL")) {
+        esp_log_level_set("*", ESP_LOG_ERROR);
+    }
+
+    // Short holds so the controller can follow a sweep that takes seconds
+    LinkAdaptation& adaptation = LinkAdaptation::getInstance();
+    link_adaptation_config_t config = LinkAdaptation::defaultConfig();
+    config.ewma_alpha = 0.5f;
+    config.up_hold_ms = options.roundMs * 2;
+    config.min_dwell_ms = options.roundMs * 2;
+    config.max_bandwidth_mhz = (uint8_t)options.maxBandwidthMhz;
+    if (!adaptation.configure(config)) {
+        return SIM_EXIT_USAGE;
+    }
+
+    Receiver counter;
+    SimHaLow receiver(RECEIVER_ID, options.seed);
+    receiver.setDataCallback(DataCallback::fromMethod<Receiver, &Receiver::onData>(&counter));
+    std::vector<std::unique_ptr<SimHaLow>> talkers;
+    bool started = start_node(receiver);
+    for (int t = 0; t < TALKER_COUNT; t++) {
+        talkers.emplace_back(new SimHaLow(TALKER_IDS[t], options.seed + t + 1));
+        started = started && start_node(*talkers.back());
+    }
+    if (!started) {
+        fprintf(stderr, "Cannot start the simulated radios\n");
+        return SIM_EXIT_USAGE;
+    }
+    SimHaLow& adaptive = *talkers[TALKER_ADAPTIVE];
+    adaptation.setRadio(&adaptive);
+
+    float noiseFloor = halow_noise_floor_dbm((uint8_t)options.maxBandwidthMhz);
+    auto setSnr = [&](double snr) {
+        int32_t rssi = (int32_t)lround(noiseFloor + snr);
+        SimLinkProfile profile = {0.0f, 0, 0, 0, rssi};
+        receiver.setDefaultLinkProfile(profile);
+        for (auto& talker : talkers) {
+            talker->setDefaultLinkProfile(profile);
+        }
+        return rssi;
+    };
+    setSnr(options.snrHigh);
+
+    // Every talker has to have heard the receiver before the controller can place its link
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(options.timeoutS);
+    bool discovered = false;
+    while (!discovered && Clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(BEACON_MS));
+        discovered = true;
+        for (auto& talker : talkers) {
+            discovered = discovered && has_peer(*talker, RECEIVER_ID);
+        }
+    }
+    if (!discovered) {
+        fprintf(stderr, "The talkers never heard the receiver\n");
+        adaptation.setRadio(NULL);
+        return SIM_EXIT_FAILED;
+    }
+
+    // The fixed talkers sit at the ends of the ladder
+    link_rate_t fixedRates[TALKER_COUNT] = {};
+    fixedRates[TALKER_FASTEST] = {HALOW_MCS_MAX, (uint8_t)options.maxBandwidthMhz};
+    fixedRates[TALKER_ROBUST] = {HALOW_MCS_RANGE_EXT, 1};
+    if (!set_rate(*talkers[TALKER_FASTEST], fixedRates[TALKER_FASTEST]) ||
+        !set_rate(*talkers[TALKER_ROBUST], fixedRates[TALKER_ROBUST])) {
+        fprintf(stderr, "Sim-HaLow rejected a fixed rate\n");
+        adaptation.setRadio(NULL);
+        return SIM_EXIT_FAILED;
+    }
+    adaptation.tick();
+
+    // Down, back up, then hold at the top
+    std::vector<double> sweep;
+    uint32_t levels = (uint32_t)floor((options.snrHigh - options.snrLow) / options.stepDb);
+    for (uint32_t i = 0; i <= levels; i++) {
+        sweep.push_back(options.snrHigh - i * options.stepDb);
+    }
+    size_t bottom = sweep.size() - 1;
+    for (uint32_t i = levels; i-- > 0;) {
+        sweep.push_back(options.snrHigh - i * options.stepDb);
+    }
+
+    printf("SNR %.0f -> %.0f -> %.0f dB in %.0f dB steps, %u rounds of %u x %u bytes per step\n",
+           options.snrHigh, sweep[bottom], options.snrHigh, options.stepDb, (unsigned)options.rounds,
+           (unsigned)options.frames, (unsigned)options.size);
+    printf("goodput = PHY rate x frames delivered; fixed talkers at %s and %s\n\n",
+           rate_name(fixedRates[TALKER_FASTEST]).c_str(), rate_name(fixedRates[TALKER_ROBUST]).c_str());
+    printf("   SNR   RSSI  adaptive rate  voice  adaptive kbps  loss  fastest kbps  robust kbps\n");
+
+    std::vector<uint8_t> payload(options.size, 0xA5);
+    TalkerTotals totals[TALKER_COUNT];
+    std::vector<StepResult> steps;
+    bool reachedRobust = false;
+    uint8_t worstVoiceTier = 0;
+    auto runRound = [&](StepResult* step) {
+        link_rate_t rates[TALKER_COUNT] = {adaptation.getLinkRate(RECEIVER_ID), fixedRates[TALKER_FASTEST],
+                                           fixedRates[TALKER_ROBUST]};
+        for (int t = 0; t < TALKER_COUNT; t++) {
+            for (uint32_t f = 0; f < options.frames; f++) {
+                talkers[t]->sendData(RECEIVER_ID, payload);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.roundMs));
+
+        for (int t = 0; t < TALKER_COUNT; t++) {
+            uint32_t delivered = std::min(counter.take(TALKER_IDS[t]), options.frames);
+            double goodput = (double)rate_kbps(rates[t]) * delivered / options.frames;
+            totals[t].goodputKbps.add(goodput);
+            totals[t].sent += options.frames;
+            totals[t].delivered += delivered;
+            if (step) {
+                step->goodputKbps[t] += goodput / options.rounds;
+                step->loss[t] += (1.0 - (double)delivered / options.frames) / options.rounds;
+            }
+            if (t == TALKER_ADAPTIVE) {
+                // RSSI comes from the talker's own peer list on tick()
+                adaptation.reportLinkSample(RECEIVER_ID, 0, options.frames, delivered);
+            }
+        }
+        adaptation.tick();
+    };
+
+    for (size_t i = 0; i < sweep.size(); i++) {
+        StepResult step;
+        step.snr = sweep[i];
+        step.rssi = setSnr(sweep[i]);
+        for (uint32_t round = 0; round < options.rounds; round++) {
+            runRound(&step);
+        }
+        link_adaptation_link_t link = {};
+        if (find_receiver_link(&link)) {
+            step.rate = link.rate;
+            step.voiceTier = link.audio_tier;
+        }
+        if (i == bottom) {
+            reachedRobust = step.rate.mcs == HALOW_MCS_RANGE_EXT;
+        }
+        worstVoiceTier = std::max(worstVoiceTier, step.voiceTier);
+
+        printf("%6.0f %6d  %13s  %5u  %13.0f %4.0f%%  %12.0f  %11.0f\n", step.snr, (int)step.rssi,
+               rate_name(step.rate).c_str(), (unsigned)step.voiceTier, step.goodputKbps[TALKER_ADAPTIVE],
+               step.loss[TALKER_ADAPTIVE] * 100.0, step.goodputKbps[TALKER_FASTEST],
+               step.goodputKbps[TALKER_ROBUST]);
+        steps.push_back(step);
+    }
+
+    // Settling is not part of the sweep's goodput
+    TalkerTotals sweepTotals[TALKER_COUNT];
+    for (int t = 0; t < TALKER_COUNT; t++) {
+        sweepTotals[t] = totals[t];
+    }
+    for (uint32_t round = 0; round < options.settleRounds; round++) {
+        runRound(nullptr);
+    }
+    link_adaptation_link_t settled = {};
+    find_receiver_link(&settled);
+    bool backToFastest = settled.rate.mcs == fixedRates[TALKER_FASTEST].mcs &&
+                         settled.rate.bandwidth_mhz == fixedRates[TALKER_FASTEST].bandwidth_mhz;
+    bool codecRunning = adaptation.codecAdaptationSupported();
+
+    printf("\nafter %u settling rounds: %s, voice tier %u, %u rate changes in all\n",
+           (unsigned)options.settleRounds, rate_name(settled.rate).c_str(), (unsigned)settled.audio_tier,
+           (unsigned)settled.rate_changes);
+    for (int t = 0; t < TALKER_COUNT; t++) {
+        printf("%-12s mean goodput %6.0f kbps, loss %5.2f%%\n", TALKER_NAMES[t],
+               sweepTotals[t].goodputKbps.mean(), sweepTotals[t].loss() * 100.0);
+    }
+    printf("voice codec: %s\n", codecRunning ? "running, voice tiers applied to the encoder"
+                                             : "not running, voice tiers tracked but not applied");
+
+    adaptation.setRadio(NULL);
+    receiver.deinitialize();
+    for (auto& talker : talkers) {
+        talker->deinitialize();
+    }
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, steps, sweepTotals, codecRunning)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+
+    double adaptiveGoodput = sweepTotals[TALKER_ADAPTIVE].goodputKbps.mean();
+    bool passed = reachedRobust && backToFastest && worstVoiceTier > 0 && settled.audio_tier == 0 &&
+                  sweepTotals[TALKER_ADAPTIVE].loss() <= options.maxLoss &&
+                  adaptiveGoodput > sweepTotals[TALKER_FASTEST].goodputKbps.mean() &&
+                  adaptiveGoodput > sweepTotals[TALKER_ROBUST].goodputKbps.mean();
+    if (!passed) {
+        printf("FAILED\n");
+    }
+    return passed ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
@@ -0,0 +1,344 @@
+/**
+ * @file failover_sim.cpp
+ * @brief Radio failover in HaLowMeshManager on simulated radios, in real time
+ *
+ * The mesh manager runs on a Sim-HaLow radio next to one peer node. It
+ * sends a numbered message every 1 / --rate-hz seconds, alternating
+ * multicast and unicast to the peer, and calls checkRadioHealth() every
+ * --health-ms as the firmware's health check does. --cycles times, after
+ * --settle-ms of traffic, the radio is made to hang ("fail"): sends fail
+ * and it raises an "error" event. The manager caches what it cannot send,
+ * replaces the radio with a new Sim-HaLow from HaLowFactory and replays
+ * the cache once the new radio has a link, while traffic keeps coming.
+ *
+ * Reported per outage: reconnect time as the manager measures it (error
+ * event to first connected event), messages sent during the outage and
+ * the most the cache held. At the end: messages lost, duplicated or
+ * dropped by the cache.
+ *
+ * Exit status: 0 if every outage ended with a reconnect within
+ * --max-reconnect-ms and every message arrived intact, 1 if not, 2 on bad
+ * arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "HaLowMeshManager.h"
+#include "config_manager.h"
+#include "sim_halow.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const char* const PEER_ID = "failover-peer";
+static const uint32_t PEER_BEACON_MS = 100;
+static const uint32_t MESSAGE_MAGIC = 0x464F534D;    // "FOSM"
+static const size_t MESSAGE_HEADER = 8;             // [magic 4][sequence 4]
+
+struct Options {
+    uint32_t cycles = 3;
+    uint32_t rateHz = 50;
+    uint32_t size = 200;
+    uint32_t settleMs = 500;
+    uint32_t healthMs = 50;
+    uint32_t maxReconnectMs = 2000;
+    uint32_t timeoutS = 30;
+    std::string jsonPath;
+};
+
+struct CycleResult {
+    bool reconnected = false;
+    uint32_t reconnectMs = 0;
+    uint32_t sentDuringOutage = 0;
+    uint32_t peakCached = 0;
+    uint32_t peakCachedBytes = 0;
+};
+
+// ============================================================================
+// PEER
+// ============================================================================
+
+static std::vector<uint8_t> make_message(uint32_t sequence, size_t size) {
+    std::vector<uint8_t> data(std::max(size, MESSAGE_HEADER));
+    for (int i = 0; i < 4; i++) {
+        data[i] = (uint8_t)(MESSAGE_MAGIC >> (24 - 8 * i));
+        data[4 + i] = (uint8_t)(sequence >> (24 - 8 * i));
+    }
+    for (size_t i = MESSAGE_HEADER; i < data.size(); i++) {
+        data[i] = (uint8_t)(sequence + i);
+    }
+    return data;
+}
+
+// Counts each numbered message the peer receives
+class Receiver {
+public:
+    void onData(const std::string& peer_id, const std::vector<uint8_t>& data) {
+        if (data.size() < MESSAGE_HEADER) {
+            return;
+        }
+        uint32_t magic = 0;
+        uint32_t sequence = 0;
+        for (int i = 0; i < 4; i++) {
+            magic = (magic << 8) | data[i];
+            sequence = (sequence << 8) | data[4 + i];
+        }
+        if (magic != MESSAGE_MAGIC) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (data != make_message(sequence, data.size())) {
+            m_corrupt++;
+            return;
+        }
+        if (sequence >= m_copies.size()) {
+            m_copies.resize(sequence + 1, 0);
+        }
+        m_copies[sequence]++;
+    }
+
+    // Messages [0, sent) that have not arrived, and extra copies
+    void count(uint32_t sent, uint32_t* missing, uint32_t* duplicates, uint32_t* corrupt) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *missing = 0;
+        *duplicates = 0;
+        for (uint32_t i = 0; i < sent; i++) {
+            uint32_t copies = i < m_copies.size() ? m_copies[i] : 0;
+            *missing += copies == 0;
+            *duplicates += copies > 1 ? copies - 1 : 0;
+        }
+        *corrupt = m_corrupt;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<uint32_t> m_copies;
+    uint32_t m_corrupt = 0;
+};
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+// Sends numbered messages at a fixed rate and runs the health check, as the
+// firmware's tasks would, until done() or the deadline
+class Driver {
+public:
+    Driver(const Options& options, HaLowMeshManager& mesh)
+        : m_options(options), m_mesh(mesh), m_start(Clock::now()) {}
+
+    uint32_t sent() const { return m_sent; }
+
+    template <typename Done>
+    bool runUntil(uint32_t deadlineMs, Done done) {
+        const uint32_t periodMs = std::max<uint32_t>(1, 1000 / m_options.rateHz);
+        while (!done()) {
+            uint32_t now = nowMs();
+            if (now >= deadlineMs) {
+                return false;
+            }
+            if (now >= m_nextSendMs) {
+                send();
+                m_nextSendMs += periodMs;
+            }
+            if (now >= m_nextHealthMs) {
+                m_mesh.checkRadioHealth();
+                m_nextHealthMs = now + m_options.healthMs;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    uint32_t nowMs() const {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_start).count();
+    }
+
+private:
+    void send() {
+        std::vector<uint8_t> data = make_message(m_sent, m_options.size);
+        if (m_sent % 2 == 0) {
+            m_mesh.sendUdpMulticast(data.data(), data.size(), 0);
+        } else {
+            m_mesh.sendUdpUnicast(PEER_ID, data.data(), data.size(), 0);
+        }
+        m_sent++;
+    }
+
+    const Options& m_options;
+    HaLowMeshManager& m_mesh;
+    Clock::time_point m_start;
+    uint32_t m_sent = 0;
+    uint32_t m_nextSendMs = 0;
+    uint32_t m_nextHealthMs = 0;
+};
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<CycleResult>& cycles,
+                       uint32_t sent, uint32_t missing, uint32_t duplicates, uint32_t dropped) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("rate_hz", options.rateHz);
+    json.add("message_bytes", options.size);
+    json.add("health_ms", options.healthMs);
+    json.add("sent", sent);
+    json.add("missing", missing);
+    json.add("duplicates", duplicates);
+    json.add("cache_dropped", dropped);
+    json.beginArray("outages");
+    for (const CycleResult& c : cycles) {
+        json.beginObject();
+        json.add("reconnected", c.reconnected);
+        json.add("reconnect_ms", c.reconnectMs);
+        json.add("sent_during_outage", c.sentDuringOutage);
+        json.add("peak_cached", c.peakCached);
+        json.add("peak_cached_bytes", c.peakCachedBytes);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--cycles", "N", &options.cycles);
+    args.add("--rate-hz", "R", &options.rateHz);
+    args.add("--size", "BYTES", &options.size);
+    args.add("--settle-ms", "MS", &options.settleMs);
+    args.add("--health-ms", "MS", &options.healthMs);
+    args.add("--max-reconnect-ms", "MS", &options.maxReconnectMs);
+    args.add("--timeout-s", "S", &options.timeoutS);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv)) {
+        return SIM_EXIT_USAGE;
+    }
+    if (!args.check(options.cycles > 0 && options.rateHz > 0 && options.rateHz <= 1000 &&
+                    options.size >= MESSAGE_HEADER && options.size <= 1400 && options.healthMs > 0)) {
+        return SIM_EXIT_USAGE;
+    }
+    if (!getenv("AIRCOM_HOST_LOG_LEVEL")) {
+        esp_log_level_set("*", ESP_LOG_ERROR);
+    }
+
+    // The peer joins the network the manager takes from the platform defaults
+    aircom_config_t defaults;
+    config_manager_get_defaults(config_manager_detect_hardware(), &defaults);
+    HaLowConfig peerConfig = HaLowConfig();
+    peerConfig.ssid = defaults.network.ssid;
+    peerConfig.channel = defaults.network.channel;
+    peerConfig.enable_mesh = true;
+    peerConfig.heartbeat_interval = PEER_BEACON_MS;
+
+    Receiver receiver;
+    SimHaLow peer(PEER_ID, 1);
+    peer.setDataCallback(DataCallback::fromMethod<Receiver, &Receiver::onData>(&receiver));
+    if (!peer.initialize(peerConfig) || !peer.startDiscovery()) {
+        fprintf(stderr, "Cannot start the simulated peer\n");
+        return SIM_EXIT_USAGE;
+    }
+
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    if (!mesh.begin(std::unique_ptr<IHaLow>(new SimHaLow("failover-node", 2)))) {
+        fprintf(stderr, "Cannot start the mesh manager\n");
+        return SIM_EXIT_USAGE;
+    }
+
+    Driver driver(options, mesh);
+    const uint32_t deadlineMs = options.timeoutS * 1000;
+    auto connected = [&mesh]() { return mesh.get_connection_status(); };
+    if (!driver.runUntil(deadlineMs, connected)) {
+        fprintf(stderr, "The mesh manager never connected to the peer\n");
+        peer.deinitialize();
+        return SIM_EXIT_FAILED;
+    }
+
+    printf("%u outages, %u messages/s of %u bytes, health check every %u ms\n\n",
+           (unsigned)options.cycles, (unsigned)options.rateHz, (unsigned)options.size, (unsigned)options.healthMs);
+    printf("outage  reconnect (ms)  sent meanwhile  peak cache (msgs / bytes)\n");
+
+    std::vector<CycleResult> cycles;
+    SimStat reconnectMs;
+    bool allReconnected = true;
+    for (uint32_t cycle = 0; cycle < options.cycles; cycle++) {
+        uint32_t settleUntil = driver.nowMs() + options.settleMs;
+        driver.runUntil(settleUntil, []() { return false; });
+
+        CycleResult result;
+        uint32_t reconnectsBefore = mesh.getFailoverStats().reconnects;
+        uint32_t sentBefore = driver.sent();
+        mesh.sendRadioCommand("fail", {});
+
+        // Until the new radio has a link and the cache has been replayed
+        result.reconnected = driver.runUntil(deadlineMs, [&mesh, &result, reconnectsBefore]() {
+            HaLowFailoverStats stats = mesh.getFailoverStats();
+            result.peakCached = std::max(result.peakCached, stats.cachedMessages);
+            result.peakCachedBytes = std::max(result.peakCachedBytes, stats.cachedBytes);
+            return stats.reconnects > reconnectsBefore && stats.cachedMessages == 0 &&
+                   mesh.get_connection_status();
+        });
+        result.sentDuringOutage = driver.sent() - sentBefore;
+        result.reconnectMs = mesh.getFailoverStats().lastReconnectMs;
+        if (result.reconnected) {
+            reconnectMs.add(result.reconnectMs);
+        }
+        allReconnected = allReconnected && result.reconnected && result.reconnectMs <= options.maxReconnectMs;
+
+        printf("%6u  %14s  %14u  %10u / %u\n", (unsigned)(cycle + 1),
+               result.reconnected ? std::to_string(result.reconnectMs).c_str() : "never",
+               (unsigned)result.sentDuringOutage, (unsigned)result.peakCached, (unsigned)result.peakCachedBytes);
+        cycles.push_back(result);
+        if (!result.reconnected) {
+            break;
+        }
+    }
+
+    // Let the last messages arrive
+    uint32_t sent = driver.sent();
+    uint32_t missing = 0;
+    uint32_t duplicates = 0;
+    uint32_t corrupt = 0;
+    Clock::time_point drainUntil = Clock::now() + std::chrono::seconds(2);
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        receiver.count(sent, &missing, &duplicates, &corrupt);
+    } while (missing > 0 && Clock::now() < drainUntil);
+
+    HaLowFailoverStats stats = mesh.getFailoverStats();
+    printf("\nreconnect: mean %.0f ms, max %.0f ms over %u outages (limit %u ms)\n", reconnectMs.mean(),
+           reconnectMs.max(), (unsigned)reconnectMs.count(), (unsigned)options.maxReconnectMs);
+    printf("messages: %u sent, %u missing, %u duplicated, %u corrupt, %u dropped by the cache\n", (unsigned)sent,
+           (unsigned)missing, (unsigned)duplicates, (unsigned)corrupt, (unsigned)stats.droppedMessages);
+
+    peer.deinitialize();
+
+    if (!options.jsonPath.empty() &&
+        !write_json(options.jsonPath, options, cycles, sent, missing, duplicates, stats.droppedMessages)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+
+    bool passed = allReconnected && missing == 0 && corrupt == 0 && stats.droppedMessages == 0;
+    if (!passed) {
+        printf("FAILED\n");
+    }
+    return passed ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
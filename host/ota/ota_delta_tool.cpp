@@ -0,0 +1,217 @@
+/**
+ * @file ota_delta_tool.cpp
+ * @brief Build a mesh OTA delta and manifest from two firmware images
+ *
+ *   ota_delta_tool <old.bin> <new.bin> <out-dir> --key KEYFILE [--version V] [--chunk-size N]
+ *   ota_delta_tool --keygen KEYFILE
+ *
+ * old.bin is the firmware the squad runs, new.bin the update, both as the
+ * build writes them (build/<project>.bin). Writes <out-dir>/ota.delta and
+ * <out-dir>/ota.manifest; upload both to the seed node's storage
+ * partition. The delta is patched back in memory and checked against
+ * new.bin before anything is written.
+ *
+ * The manifest is signed with the Ed25519 key in KEYFILE (a 64-character
+ * hex seed). --keygen makes a new KEYFILE and prints its public key for
+ * CONFIG_AIRCOM_OTA_PUBLIC_KEY; nodes ignore manifests signed by any other
+ * key. Keep KEYFILE off the devices and out of the repository.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "ota_delta.h"
+#include "ota_mesh.h"
+#include "sim_harness.h"
+#include "sodium.h"
+#include <chrono>
+#include <cstdio>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+static bool read_file(const std::string& path, std::vector<uint8_t>* data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    return (bool)file;
+}
+
+static std::string to_hex(const uint8_t* data, size_t length) {
+    std::string hex;
+    char byte[3];
+    for (size_t i = 0; i < length; i++) {
+        snprintf(byte, sizeof(byte), "%02x", data[i]);
+        hex += byte;
+    }
+    return hex;
+}
+
+// Key file: the 32-byte seed as 64 hex characters, optionally newline-terminated
+static bool read_seed(const std::string& path, uint8_t seed[crypto_sign_SEEDBYTES]) {
+    std::vector<uint8_t> text;
+    if (!read_file(path, &text)) {
+        return false;
+    }
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+        text.pop_back();
+    }
+    if (text.size() != 2 * crypto_sign_SEEDBYTES) {
+        return false;
+    }
+    for (size_t i = 0; i < crypto_sign_SEEDBYTES; i++) {
+        char byte[3] = { (char)text[2 * i], (char)text[2 * i + 1], 0 };
+        char* end;
+        unsigned long value = strtoul(byte, &end, 16);
+        if (*end != 0 || !isxdigit((unsigned char)byte[0])) {
+            return false;
+        }
+        seed[i] = (uint8_t)value;
+    }
+    return true;
+}
+
+static int keygen(const std::string& path) {
+    if (std::ifstream(path)) {
+        fprintf(stderr, "%s already exists, not overwriting a signing key\n", path.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    std::random_device entropy;
+    uint8_t seed[crypto_sign_SEEDBYTES];
+    for (size_t i = 0; i < sizeof(seed); i++) {
+        seed[i] = (uint8_t)entropy();
+    }
+    std::string hex = to_hex(seed, sizeof(seed)) + "\n";
+    if (!write_file(path, std::vector<uint8_t>(hex.begin(), hex.end()))) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    uint8_t pk[crypto_sign_PUBLICKEYBYTES];
+    uint8_t sk[crypto_sign_SECRETKEYBYTES];
+    crypto_sign_seed_keypair(pk, sk, seed);
+    printf("CONFIG_AIRCOM_OTA_PUBLIC_KEY=\"%s\"\n", to_hex(pk, sizeof(pk)).c_str());
+    return SIM_EXIT_OK;
+}
+
+struct PatchBuffers {
+    const std::vector<uint8_t>* old_image;
+    std::vector<uint8_t> output;
+};
+
+static bool read_old(void* ctx, uint32_t offset, uint8_t* data, size_t length) {
+    const std::vector<uint8_t>& old_image = *((PatchBuffers*)ctx)->old_image;
+    if ((size_t)offset + length > old_image.size()) {
+        return false;
+    }
+    memcpy(data, old_image.data() + offset, length);
+    return true;
+}
+
+static bool write_new(void* ctx, const uint8_t* data, size_t length) {
+    std::vector<uint8_t>& output = ((PatchBuffers*)ctx)->output;
+    output.insert(output.end(), data, data + length);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string old_path;
+    std::string new_path;
+    std::string out_dir;
+    std::string key_path;
+    std::string keygen_path;
+    std::string version = "unversioned";
+    uint32_t chunk_size = OTA_MESH_DEFAULT_CHUNK_SIZE;
+    SimArgs args;
+    args.positional("<old.bin>", &old_path, false);
+    args.positional("<new.bin>", &new_path, false);
+    args.positional("<out-dir>", &out_dir, false);
+    args.add("--key", "KEYFILE", &key_path);
+    args.add("--keygen", "KEYFILE", &keygen_path);
+    args.add("--version", "V", &version);
+    args.add("--chunk-size", "N", &chunk_size);
+    if (!args.parse(argc, argv)) {
+        return SIM_EXIT_USAGE;
+    }
+    if (!keygen_path.empty()) {
+        return keygen(keygen_path);
+    }
+    if (out_dir.empty() || key_path.empty()) {
+        fprintf(stderr, "Usage: ota_delta_tool <old.bin> <new.bin> <out-dir> --key KEYFILE\n"
+                        "       ota_delta_tool --keygen KEYFILE\n");
+        return SIM_EXIT_USAGE;
+    }
+    uint8_t seed[crypto_sign_SEEDBYTES];
+    uint8_t pk[crypto_sign_PUBLICKEYBYTES];
+    uint8_t sk[crypto_sign_SECRETKEYBYTES];
+    if (!read_seed(key_path, seed)) {
+        fprintf(stderr, "%s is not a key file from --keygen\n", key_path.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    crypto_sign_seed_keypair(pk, sk, seed);
+    if (chunk_size < 64 || chunk_size > 1400) {
+        fprintf(stderr, "Chunk size must be 64 - 1400 bytes to fit a mesh frame\n");
+        return SIM_EXIT_USAGE;
+    }
+
+    std::vector<uint8_t> old_image;
+    std::vector<uint8_t> new_image;
+    if (!read_file(old_path, &old_image) || !read_file(new_path, &new_image)) {
+        fprintf(stderr, "Cannot read %s or %s\n", old_path.c_str(), new_path.c_str());
+        return SIM_EXIT_USAGE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> delta;
+    if (!ota_delta_encode(old_image.data(), old_image.size(), new_image.data(), new_image.size(), &delta)) {
+        fprintf(stderr, "Images too large for the delta format\n");
+        return SIM_EXIT_FAILED;
+    }
+    double encode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Round trip before publishing
+    PatchBuffers buffers;
+    buffers.old_image = &old_image;
+    OtaDeltaPatcher patcher(read_old, write_new, &buffers);
+    if (patcher.feed(delta.data(), delta.size()) != OTA_DELTA_DONE || buffers.output != new_image) {
+        fprintf(stderr, "Delta does not reproduce %s\n", new_path.c_str());
+        return SIM_EXIT_FAILED;
+    }
+
+    OtaManifest manifest;
+    ota_manifest_create(old_image.data(), old_image.size(), new_image.data(), new_image.size(),
+                        delta, version.c_str(), (uint16_t)chunk_size, &manifest);
+    if (!ota_manifest_sign(&manifest, sk) || !ota_manifest_verify(manifest, pk)) {
+        fprintf(stderr, "Cannot sign the manifest\n");
+        return SIM_EXIT_FAILED;
+    }
+    std::vector<uint8_t> encoded;
+    ota_manifest_encode(manifest, &encoded);
+
+    if (!write_file(out_dir + "/ota.delta", delta) || !write_file(out_dir + "/ota.manifest", encoded)) {
+        fprintf(stderr, "Cannot write to %s\n", out_dir.c_str());
+        return SIM_EXIT_USAGE;
+    }
+
+    printf("update %08x  version %s\n", (unsigned)manifest.update_id, manifest.version);
+    printf("signed by   %s\n", to_hex(pk, sizeof(pk)).c_str());
+    printf("old image   %10zu bytes\n", old_image.size());
+    printf("new image   %10zu bytes\n", new_image.size());
+    printf("delta       %10zu bytes (%.2f%% of the new image), %u chunks of %u bytes\n",
+           delta.size(), 100.0 * delta.size() / new_image.size(), (unsigned)manifest.chunkCount(), chunk_size);
+    printf("encoded in %.0f ms\n", encode_ms);
+    return SIM_EXIT_OK;
+}
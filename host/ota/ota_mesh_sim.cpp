@@ -0,0 +1,466 @@
+/**
+ * @file ota_mesh_sim.cpp
+ * @brief Simulates a mesh OTA rollout across N nodes
+ *
+ * Runs N OtaMeshNode instances in one process on simulated time. Node 0
+ * seeds the update; the others run the old image and fetch the delta.
+ * Frames share one broadcast channel: each occupies it for its airtime at
+ * --rate-kbps and reaches the sender's neighbours, each of which loses it
+ * with probability --loss. Neighbours are everyone (--topology full) or
+ * the nodes next to the sender in a chain (--topology line), so updates
+ * in a line have to travel hop by hop.
+ *
+ * Optional voice bursts (--voice-every/--voice-for) occupy the channel
+ * and make every node hold back as foreground traffic would. A node can
+ * be power-cycled mid-transfer (--reboot) to show that it resumes from its
+ * saved bitmap. Each node applies the finished delta to its old image and
+ * the result is checked against the manifest's target hash.
+ *
+ * The manifest is signed with a fixed sim key that every node trusts.
+ * --forger adds a node that announces its own update for the same old
+ * image, signed with a different key; no node may take it.
+ *
+ * Without --old/--new a synthetic pair of images is generated: a new build
+ * with a function inserted, pointers past it relocated and a few constants
+ * changed, which is what a typical firmware change looks like to a delta.
+ *
+ * Exit status: 0 if every node rebuilt the new image (and none took the
+ * forged one), 1 if not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "ota_delta.h"
+#include "ota_mesh.h"
+#include "sim_harness.h"
+#include "sodium.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static const uint32_t TICK_MS = 10;
+static const uint32_t FRAME_OVERHEAD_BYTES = 60;    // MAC, IP and UDP headers per frame
+
+// ============================================================================
+// IMAGES
+// ============================================================================
+
+static bool read_file(const std::string& path, std::vector<uint8_t>* data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Code-like bytes: a few hundred "instruction" patterns repeated with
+// varying operands, plus a table of pointers into the image
+static void make_images(size_t size, uint32_t seed, std::vector<uint8_t>* old_image,
+                        std::vector<uint8_t>* new_image) {
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> patterns(300);
+    for (uint32_t& pattern : patterns) {
+        pattern = rng();
+    }
+
+    const size_t table_start = size * 3 / 4;
+    old_image->resize(size);
+    for (size_t pos = 0; pos + 4 <= table_start; pos += 4) {
+        uint32_t word = patterns[rng() % patterns.size()] ^ (rng() % 16 == 0 ? rng() & 0xFFF : 0);
+        memcpy(&(*old_image)[pos], &word, 4);
+    }
+    for (size_t pos = table_start; pos + 4 <= size; pos += 4) {
+        uint32_t pointer = 0x42000000 + (uint32_t)(rng() % table_start);
+        memcpy(&(*old_image)[pos], &pointer, 4);
+    }
+
+    // New build: 3 KB function inserted at 40%, pointers behind it moved,
+    // a handful of constants edited
+    const size_t insert_at = (size * 2 / 5) & ~(size_t)3;
+    const size_t inserted = 3072;
+    *new_image = *old_image;
+    std::vector<uint8_t> function(inserted);
+    for (size_t i = 0; i < inserted; i += 4) {
+        uint32_t word = patterns[rng() % patterns.size()];
+        memcpy(&function[i], &word, 4);
+    }
+    new_image->insert(new_image->begin() + insert_at, function.begin(), function.end());
+    for (size_t pos = table_start + inserted; pos + 4 <= new_image->size(); pos += 4) {
+        uint32_t pointer;
+        memcpy(&pointer, &(*new_image)[pos], 4);
+        if (pointer - 0x42000000 >= insert_at) {
+            pointer += inserted;
+            memcpy(&(*new_image)[pos], &pointer, 4);
+        }
+    }
+    for (int edit = 0; edit < 40; edit++) {
+        (*new_image)[rng() % table_start] ^= (uint8_t)(1 + rng() % 255);
+    }
+}
+
+// ============================================================================
+// NODES
+// ============================================================================
+
+// Flash as seen by one node: the delta file plus progress saved in NVS.
+// Both survive a reboot; chunks received after the last save are lost
+// from the bitmap, as on the device.
+class MemoryOtaStore : public IOtaChunkStore {
+public:
+    bool begin(const OtaManifest& manifest) override {
+        m_data.assign(manifest.delta_size, 0xFF);
+        m_chunkSize = manifest.chunk_size;
+        return true;
+    }
+    bool writeChunk(uint32_t index, const uint8_t* data, size_t length) override {
+        size_t offset = (size_t)index * m_chunkSize;
+        if (offset + length > m_data.size()) {
+            return false;
+        }
+        memcpy(&m_data[offset], data, length);
+        return true;
+    }
+    bool read(uint32_t offset, uint8_t* data, size_t length) override {
+        if ((size_t)offset + length > m_data.size()) {
+            return false;
+        }
+        memcpy(data, &m_data[offset], length);
+        return true;
+    }
+    bool saveProgress(const OtaManifest& manifest, const std::vector<uint8_t>& bitmap) override {
+        m_manifest = manifest;
+        m_bitmap = bitmap;
+        m_saved = true;
+        m_chunkSize = manifest.chunk_size;
+        return true;
+    }
+    bool loadProgress(OtaManifest* manifest, std::vector<uint8_t>* bitmap) override {
+        *manifest = m_manifest;
+        *bitmap = m_bitmap;
+        return m_saved;
+    }
+
+    std::vector<uint8_t> m_data;
+
+private:
+    OtaManifest m_manifest = OtaManifest();
+    std::vector<uint8_t> m_bitmap;
+    uint32_t m_chunkSize = 0;
+    bool m_saved = false;
+};
+
+struct SimNode {
+    std::string id;
+    MemoryOtaStore store;
+    std::unique_ptr<OtaMeshNode> ota;
+    ota_mesh_stats_t previousStats = ota_mesh_stats_t();   // Counters from before a reboot
+    bool online = true;
+    bool done = false;
+    bool imageOk = false;
+    uint32_t doneMs = 0;
+};
+
+struct Frame {
+    size_t sender;
+    std::vector<uint8_t> data;
+};
+
+struct PatchBuffers {
+    const std::vector<uint8_t>* old_image;
+    std::vector<uint8_t> output;
+};
+
+static bool read_old(void* ctx, uint32_t offset, uint8_t* data, size_t length) {
+    const std::vector<uint8_t>& old_image = *((PatchBuffers*)ctx)->old_image;
+    if ((size_t)offset + length > old_image.size()) {
+        return false;
+    }
+    memcpy(data, old_image.data() + offset, length);
+    return true;
+}
+
+static bool write_new(void* ctx, const uint8_t* data, size_t length) {
+    std::vector<uint8_t>& output = ((PatchBuffers*)ctx)->output;
+    output.insert(output.end(), data, data + length);
+    return true;
+}
+
+static void add_stats(ota_mesh_stats_t* total, const ota_mesh_stats_t& stats) {
+    total->frames_sent += stats.frames_sent;
+    total->bytes_sent += stats.bytes_sent;
+    total->announces_sent += stats.announces_sent;
+    total->requests_sent += stats.requests_sent;
+    total->requests_suppressed += stats.requests_suppressed;
+    total->chunks_sent += stats.chunks_sent;
+    total->chunks_received += stats.chunks_received;
+    total->chunks_duplicate += stats.chunks_duplicate;
+    total->chunks_bad += stats.chunks_bad;
+    total->verify_failures += stats.verify_failures;
+    total->signature_failures += stats.signature_failures;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    uint32_t node_count = 8;
+    std::string topology = "full";
+    double loss = 0.05;
+    double rate_kbps = 600;
+    uint32_t serve_bps = 16000;
+    uint32_t chunk_size = OTA_MESH_DEFAULT_CHUNK_SIZE;
+    uint32_t image_kb = 1024;
+    std::string old_path;
+    std::string new_path;
+    double voice_every_s = 0;
+    double voice_for_s = 0;
+    long reboot_node = -1;
+    double reboot_at_s = 0;
+    double reboot_down_s = 0;
+    uint32_t seed = 1;
+    double max_s = 3600;
+    bool forger = false;
+
+    SimArgs args;
+    args.add("--nodes", "N", &node_count);
+    args.add("--topology", "full|line", &topology);
+    args.add("--loss", "P", &loss);
+    args.add("--rate-kbps", "R", &rate_kbps);
+    args.add("--serve-bps", "B", &serve_bps);
+    args.add("--chunk-size", "N", &chunk_size);
+    args.add("--image-kb", "K", &image_kb);
+    args.add("--old", "F", &old_path);
+    args.add("--new", "F", &new_path);
+    args.add("--voice-every", "S", &voice_every_s);
+    args.add("--voice-for", "S", &voice_for_s);
+    args.add("--reboot", "NODE AT_S DOWN_S", 3, [&](char** texts) {
+        double node;
+        if (!SimArgs::parseNumber(texts[0], &node) || node != (long)node) {
+            return false;
+        }
+        reboot_node = (long)node;
+        return SimArgs::parseNumber(texts[1], &reboot_at_s) && SimArgs::parseNumber(texts[2], &reboot_down_s);
+    });
+    args.add("--seed", "N", &seed);
+    args.add("--max-s", "S", &max_s);
+    args.add("--forger", &forger);
+    if (!args.parse(argc, argv) ||
+        !args.check(node_count >= 2 && rate_kbps > 0 && chunk_size >= 64 && chunk_size <= 1400 && loss >= 0 &&
+                    loss < 1 && (topology == "full" || topology == "line") && reboot_node != 0 &&
+                    reboot_node < (long)node_count)) {
+        return SIM_EXIT_USAGE;
+    }
+    const bool line = topology == "line";
+
+    // Images, delta and manifest, as ota_delta_tool would make them
+    std::vector<uint8_t> old_image;
+    std::vector<uint8_t> new_image;
+    if (!old_path.empty() || !new_path.empty()) {
+        if (!read_file(old_path, &old_image) || !read_file(new_path, &new_image)) {
+            fprintf(stderr, "Cannot read --old/--new images\n");
+            return SIM_EXIT_USAGE;
+        }
+    } else {
+        make_images(image_kb * 1024, seed, &old_image, &new_image);
+    }
+    std::vector<uint8_t> delta;
+    ota_delta_encode(old_image.data(), old_image.size(), new_image.data(), new_image.size(), &delta);
+    OtaManifest manifest;
+    ota_manifest_create(old_image.data(), old_image.size(), new_image.data(), new_image.size(),
+                        delta, "sim", (uint16_t)chunk_size, &manifest);
+    uint8_t old_sha[OTA_SHA256_SIZE];
+    ota_sha256(old_image.data(), old_image.size(), old_sha);
+
+    // Release key, and for --forger an untrusted key signing a tampered
+    // update for the same old image
+    uint8_t key_seed[crypto_sign_SEEDBYTES];
+    uint8_t pk[crypto_sign_PUBLICKEYBYTES];
+    uint8_t sk[crypto_sign_SECRETKEYBYTES];
+    memset(key_seed, 0x5A, sizeof(key_seed));
+    crypto_sign_seed_keypair(pk, sk, key_seed);
+    ota_manifest_sign(&manifest, sk);
+    OtaManifest forged;
+    std::vector<uint8_t> forged_delta;
+    uint8_t forger_pk[crypto_sign_PUBLICKEYBYTES];
+    if (forger) {
+        std::vector<uint8_t> forged_image = old_image;
+        forged_image[0] ^= 0xFF;
+        ota_delta_encode(old_image.data(), old_image.size(), forged_image.data(), forged_image.size(),
+                         &forged_delta);
+        ota_manifest_create(old_image.data(), old_image.size(), forged_image.data(), forged_image.size(),
+                            forged_delta, "forged", (uint16_t)chunk_size, &forged);
+        uint8_t forger_sk[crypto_sign_SECRETKEYBYTES];
+        memset(key_seed, 0xA5, sizeof(key_seed));
+        crypto_sign_seed_keypair(forger_pk, forger_sk, key_seed);
+        ota_manifest_sign(&forged, forger_sk);
+    }
+
+    printf("image %zu -> %zu bytes, delta %zu bytes (%.1f%%), %u chunks; %u nodes, %s, loss %.0f%%, %.0f kbps\n",
+           old_image.size(), new_image.size(), delta.size(), 100.0 * delta.size() / new_image.size(),
+           (unsigned)manifest.chunkCount(), node_count, line ? "line" : "full", loss * 100, rate_kbps);
+
+    // Nodes and the shared channel
+    ota_mesh_config_t config = ota_mesh_default_config();
+    config.serve_rate_bps = serve_bps;
+    // The forger, if any, is the last node; in a line it sits past the end
+    const size_t total_nodes = node_count + (forger ? 1 : 0);
+    std::vector<SimNode> nodes(total_nodes);
+    std::deque<Frame> channel;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    uint64_t air_bytes = 0;
+    double air_busy_ms = 0;
+
+    auto make_node = [&](size_t index) {
+        SimNode& node = nodes[index];
+        node.ota.reset(new OtaMeshNode(node.id, old_sha, index < node_count ? pk : forger_pk, &node.store,
+            [&channel, index](const std::vector<uint8_t>& frame) {
+                channel.push_back({index, frame});
+                return true;
+            }, config, seed * 1000 + (uint32_t)index));
+    };
+    for (size_t i = 0; i < total_nodes; i++) {
+        char id[16];
+        snprintf(id, sizeof(id), "node%02zu", i);
+        nodes[i].id = i < node_count ? id : "forger";
+        make_node(i);
+    }
+    nodes[0].store.begin(manifest);
+    nodes[0].store.m_data = delta;
+    nodes[0].ota->seed(manifest, 0);
+    nodes[0].done = true;
+    nodes[0].imageOk = true;
+    if (forger) {
+        // Trusts its own key, so it seeds and serves the forged update
+        SimNode& node = nodes[node_count];
+        node.store.begin(forged);
+        node.store.m_data = forged_delta;
+        node.ota->seed(forged, 0);
+        node.done = true;
+        node.imageOk = true;
+    }
+
+    const uint32_t max_ms = (uint32_t)(max_s * 1000);
+    size_t done_count = 1;
+    double channel_free_ms = 0;
+    for (uint32_t now = 0; now < max_ms && done_count < node_count; now += TICK_MS) {
+        // Voice bursts hold the channel and quiet every node
+        bool voice = voice_every_s > 0 && fmod(now / 1000.0, voice_every_s) < voice_for_s;
+        if (voice) {
+            channel_free_ms = std::max(channel_free_ms, (double)now + TICK_MS);
+            for (SimNode& node : nodes) {
+                if (node.online) {
+                    node.ota->noteForegroundTraffic(now);
+                }
+            }
+        }
+
+        // Power cycle: down for a while, then a fresh node on the same flash
+        if (reboot_node > 0) {
+            SimNode& node = nodes[reboot_node];
+            if (node.online && !node.done && now == (uint32_t)(reboot_at_s * 1000) / TICK_MS * TICK_MS) {
+                printf("%8.2f s  %s powered off at %u/%u chunks\n", now / 1000.0, node.id.c_str(),
+                       (unsigned)node.ota->chunksHave(), (unsigned)manifest.chunkCount());
+                add_stats(&node.previousStats, node.ota->stats());
+                node.online = false;
+            } else if (!node.online && now == (uint32_t)((reboot_at_s + reboot_down_s) * 1000) / TICK_MS * TICK_MS) {
+                make_node(reboot_node);
+                node.online = true;
+                node.ota->resume(now);
+                printf("%8.2f s  %s back, resumed at %u/%u chunks\n", now / 1000.0, node.id.c_str(),
+                       (unsigned)node.ota->chunksHave(), (unsigned)manifest.chunkCount());
+            }
+        }
+
+        for (size_t i = 0; i < total_nodes; i++) {
+            if (nodes[i].online) {
+                nodes[i].ota->tick(now);
+            }
+        }
+
+        // Put queued frames on the air, one at a time
+        while (!channel.empty() && channel_free_ms < now + TICK_MS) {
+            Frame frame = std::move(channel.front());
+            channel.pop_front();
+            double airtime = (frame.data.size() + FRAME_OVERHEAD_BYTES) * 8.0 / rate_kbps;
+            channel_free_ms = std::max(channel_free_ms, (double)now) + airtime;
+            air_bytes += frame.data.size() + FRAME_OVERHEAD_BYTES;
+            air_busy_ms += airtime;
+
+            for (size_t i = 0; i < total_nodes; i++) {
+                bool neighbour = line ? (i + 1 == frame.sender || frame.sender + 1 == i) : i != frame.sender;
+                if (!neighbour || !nodes[i].online || unit(rng) < loss) {
+                    continue;
+                }
+                SimNode& node = nodes[i];
+                node.ota->handleFrame(frame.data.data(), frame.data.size(), (uint32_t)channel_free_ms);
+                if (!node.done && node.ota->state() == OTA_MESH_COMPLETE) {
+                    PatchBuffers buffers;
+                    buffers.old_image = &old_image;
+                    OtaDeltaPatcher patcher(read_old, write_new, &buffers);
+                    std::vector<uint8_t> stored(manifest.delta_size);
+                    node.store.read(0, stored.data(), stored.size());
+                    uint8_t sha[OTA_SHA256_SIZE];
+                    if (patcher.feed(stored.data(), stored.size()) == OTA_DELTA_DONE) {
+                        ota_sha256(buffers.output.data(), buffers.output.size(), sha);
+                        node.imageOk = memcmp(sha, manifest.target_sha256, OTA_SHA256_SIZE) == 0;
+                    }
+                    node.done = true;
+                    node.doneMs = (uint32_t)channel_free_ms;
+                    done_count++;
+                    printf("%8.2f s  %s complete, image %s\n", channel_free_ms / 1000.0, node.id.c_str(),
+                           node.imageOk ? "verified" : "WRONG");
+                }
+            }
+        }
+    }
+
+    // Summary
+    ota_mesh_stats_t total = ota_mesh_stats_t();
+    uint32_t last_ms = 0;
+    bool all_ok = true;
+    size_t forged_count = 0;
+    for (size_t i = 0; i < node_count; i++) {
+        SimNode& node = nodes[i];
+        add_stats(&total, node.previousStats);
+        add_stats(&total, node.ota->stats());
+        last_ms = std::max(last_ms, node.doneMs);
+        all_ok = all_ok && node.done && node.imageOk;
+        if (forger && node.ota->state() != OTA_MESH_IDLE && node.ota->manifest().update_id == forged.update_id) {
+            forged_count++;
+        }
+    }
+    all_ok = all_ok && forged_count == 0;
+    double full_image_air = (double)new_image.size() * (1.0 + (double)FRAME_OVERHEAD_BYTES / chunk_size);
+    printf("\n%zu/%u nodes updated%s, last after %.1f s\n", done_count, node_count,
+           all_ok ? "" : " (FAILED)", last_ms / 1000.0);
+    printf("on air       %10llu bytes, %.1f s of channel time (%.1f%% utilisation)\n",
+           (unsigned long long)air_bytes, air_busy_ms / 1000.0,
+           last_ms ? 100.0 * air_busy_ms / last_ms : 0.0);
+    printf("full image   %10.0f bytes broadcast once, %.0f bytes unicast to each node\n",
+           full_image_air, full_image_air * (node_count - 1));
+    printf("airtime      %.1f%% of one full-image broadcast, %.1f%% of full-image unicast\n",
+           100.0 * air_bytes / full_image_air, 100.0 * air_bytes / (full_image_air * (node_count - 1)));
+    printf("frames       %u announces, %u requests (%u suppressed), %u chunks sent, %u duplicates heard, %u bad\n",
+           (unsigned)total.announces_sent, (unsigned)total.requests_sent, (unsigned)total.requests_suppressed,
+           (unsigned)total.chunks_sent, (unsigned)total.chunks_duplicate, (unsigned)total.chunks_bad);
+    printf("signatures   %u manifests rejected", (unsigned)total.signature_failures);
+    if (forger) {
+        printf(", %zu nodes took the forged update", forged_count);
+    }
+    printf("\n");
+    return all_ok ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
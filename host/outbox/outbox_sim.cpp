@@ -0,0 +1,548 @@
+/**
+ * @file outbox_sim.cpp
+ * @brief Store-and-forward delivery among mobile nodes on simulated time
+ *
+ * --nodes nodes walk around a square field (random waypoint: walk to a
+ * random point at 0.5 - 2 m/s, pause, repeat). Two nodes are neighbours
+ * while they are within --range metres; the moment they meet or part,
+ * both get the neighbour table event the mesh manager would raise. Frames
+ * between neighbours arrive one tick later, each lost with probability
+ * --loss, and not at all if the nodes parted in between.
+ *
+ * Every --interval-s seconds of the first --traffic-s a random node sends
+ * a short text message to another random node; the run then continues
+ * for --drain-s seconds so messages in the outbox can still get through.
+ * The same traffic and movement are replayed in each mode:
+ *
+ *   direct   what network_task did before: three attempts when the
+ *            message is sent, and the message is dropped if the
+ *            destination is not in range then
+ *   outbox   MessageOutbox without custody: kept until the sender meets
+ *            the destination
+ *   custody  MessageOutbox with custody transfer: carried by nodes that
+ *            met the destination more recently
+ *
+ * Every outbox keeps its log in memory exactly as it would be written to
+ * flash. --reboots power-cycles random nodes for 20 s each; they come back
+ * from their logs alone.
+ *
+ * Reported per mode: delivery ratio, latency, frames and bytes on air,
+ * and flash writes and bytes per message sent, with the number of 256
+ * byte SPIFFS pages those writes touch.
+ *
+ * Exit status: 0 if every message the application saw was intact and
+ * every delivery receipt was for a message that really arrived, 1 if not,
+ * 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "message_outbox.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static const uint32_t TICK_MS = 100;
+static const uint32_t FRAME_OVERHEAD_BYTES = 60;    // MAC, IP and UDP headers per frame
+static const uint32_t SPIFFS_PAGE_BYTES = 256;
+static const uint32_t REBOOT_DOWN_MS = 20000;
+static const uint32_t LEGACY_ATTEMPTS = 3;          // send_tcp_message retries
+
+// ============================================================================
+// STORAGE
+// ============================================================================
+
+// The log as it would be on flash, with the write traffic counted
+class MemoryOutboxStorage : public IOutboxStorage {
+public:
+    bool load(std::vector<uint8_t>* log) override {
+        *log = m_log;
+        return true;
+    }
+    bool append(const uint8_t* data, size_t length) override {
+        m_pages += pagesTouched(m_log.size(), length);
+        m_log.insert(m_log.end(), data, data + length);
+        m_writes++;
+        m_bytes += length;
+        return true;
+    }
+    bool rewrite(const std::vector<uint8_t>& log) override {
+        m_pages += pagesTouched(0, log.size());
+        m_log = log;
+        m_writes++;
+        m_bytes += log.size();
+        return true;
+    }
+
+    uint64_t m_writes = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_pages = 0;
+
+private:
+    static uint64_t pagesTouched(size_t offset, size_t length) {
+        return length ? (offset + length - 1) / SPIFFS_PAGE_BYTES - offset / SPIFFS_PAGE_BYTES + 1 : 0;
+    }
+
+    std::vector<uint8_t> m_log;
+};
+
+// ============================================================================
+// SCENARIO
+// ============================================================================
+
+struct Options {
+    uint32_t nodes = 12;
+    double fieldM = 2000;
+    double rangeM = 300;
+    double loss = 0.1;
+    uint32_t intervalS = 20;
+    uint32_t trafficS = 3600;
+    uint32_t drainS = 3600;
+    uint32_t reboots = 4;
+    uint32_t seed = 1;
+    std::string mode = "all";
+};
+
+struct Walker {
+    double x, y;
+    double targetX, targetY;
+    double speed;                           // Metres per second
+    uint32_t pauseUntilMs;
+};
+
+struct Traffic {
+    uint32_t atMs;
+    size_t from;
+    size_t to;
+    std::vector<uint8_t> payload;           // Starts with the message number
+};
+
+struct Reboot {
+    uint32_t atMs;
+    size_t node;
+};
+
+// Positions every tick, computed once and shared by all modes
+static std::vector<std::vector<bool>> s_links;   // Per tick, upper triangle of the adjacency matrix
+
+static size_t link_index(size_t a, size_t b, size_t count) {
+    if (a > b) {
+        std::swap(a, b);
+    }
+    return a * count - a * (a + 1) / 2 + (b - a - 1);
+}
+
+static void make_movement(const Options& options, uint32_t endMs, std::mt19937& rng) {
+    std::uniform_real_distribution<double> field(0.0, options.fieldM);
+    std::uniform_real_distribution<double> speed(0.5, 2.0);
+    std::uniform_int_distribution<uint32_t> pause(0, 120000);
+    std::vector<Walker> walkers(options.nodes);
+    for (Walker& walker : walkers) {
+        walker = {field(rng), field(rng), field(rng), field(rng), speed(rng), pause(rng)};
+    }
+    size_t pairs = options.nodes * (options.nodes - 1) / 2;
+    for (uint32_t now = 0; now < endMs; now += TICK_MS) {
+        for (Walker& walker : walkers) {
+            if (now < walker.pauseUntilMs) {
+                continue;
+            }
+            double dx = walker.targetX - walker.x;
+            double dy = walker.targetY - walker.y;
+            double distance = std::sqrt(dx * dx + dy * dy);
+            double step = walker.speed * TICK_MS / 1000.0;
+            if (distance <= step) {
+                walker.x = walker.targetX;
+                walker.y = walker.targetY;
+                walker.targetX = field(rng);
+                walker.targetY = field(rng);
+                walker.speed = speed(rng);
+                walker.pauseUntilMs = now + pause(rng);
+            } else {
+                walker.x += dx / distance * step;
+                walker.y += dy / distance * step;
+            }
+        }
+        std::vector<bool> links(pairs);
+        for (size_t a = 0; a < options.nodes; a++) {
+            for (size_t b = a + 1; b < options.nodes; b++) {
+                double dx = walkers[a].x - walkers[b].x;
+                double dy = walkers[a].y - walkers[b].y;
+                links[link_index(a, b, options.nodes)] = dx * dx + dy * dy <= options.rangeM * options.rangeM;
+            }
+        }
+        s_links.push_back(std::move(links));
+    }
+}
+
+// ============================================================================
+// RUNS
+// ============================================================================
+
+struct Result {
+    std::string mode;
+    size_t sent = 0;
+    size_t delivered = 0;
+    size_t duplicates = 0;
+    size_t corrupted = 0;
+    size_t receipts = 0;
+    size_t falseReceipts = 0;
+    size_t pending = 0;
+    size_t refused = 0;                     // Outbox full when sent
+    std::vector<uint32_t> latenciesMs;
+    uint64_t frames = 0;
+    uint64_t airBytes = 0;
+    uint64_t flashWrites = 0;
+    uint64_t flashBytes = 0;
+    uint64_t flashPages = 0;
+    uint32_t compactions = 0;
+    uint32_t custodyHandovers = 0;
+    uint32_t expired = 0;
+};
+
+struct SimNode {
+    std::string id;
+    MemoryOutboxStorage storage;
+    std::unique_ptr<MessageOutbox> outbox;
+    outbox_stats_t previousStats = outbox_stats_t();    // Counters from before a reboot
+    bool online = true;
+    uint32_t backAtMs = 0;
+};
+
+struct Frame {
+    size_t from;
+    size_t to;
+    std::vector<uint8_t> data;
+};
+
+static Result run_legacy(const Options& options, const std::vector<Traffic>& traffic) {
+    Result result;
+    result.mode = "direct";
+    std::mt19937 rng(options.seed + 1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (const Traffic& message : traffic) {
+        result.sent++;
+        const std::vector<bool>& links = s_links[message.atMs / TICK_MS];
+        if (!links[link_index(message.from, message.to, options.nodes)]) {
+            continue;                       // No route: every attempt fails
+        }
+        for (uint32_t attempt = 0; attempt < LEGACY_ATTEMPTS; attempt++) {
+            result.frames++;
+            result.airBytes += message.payload.size() + FRAME_OVERHEAD_BYTES;
+            if (unit(rng) >= options.loss) {
+                result.delivered++;
+                result.latenciesMs.push_back(attempt * 1000);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static void add_stats(outbox_stats_t* total, const outbox_stats_t& stats) {
+    total->frames_sent += stats.frames_sent;
+    total->bytes_sent += stats.bytes_sent;
+    total->custody_handed += stats.custody_handed;
+    total->expired += stats.expired;
+    total->log_compactions += stats.log_compactions;
+}
+
+static Result run_outbox(const Options& options, const std::vector<Traffic>& traffic,
+                         const std::vector<Reboot>& reboots, bool custody, uint32_t endMs) {
+    Result result;
+    result.mode = custody ? "custody" : "outbox";
+    std::mt19937 rng(options.seed + 2);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    outbox_config_t config = outbox_default_config();
+    std::vector<SimNode> nodes(options.nodes);
+    std::vector<Frame> inFlight;
+    std::vector<Frame> arriving;
+    std::map<uint32_t, uint32_t> deliveredAtMs;     // Message number, delivery time
+    std::map<std::pair<size_t, uint32_t>, uint32_t> messageIds;  // (origin, outbox ID) -> message number
+    uint32_t now = 0;
+
+    auto make_node = [&](size_t index) {
+        SimNode& node = nodes[index];
+        node.outbox.reset(new MessageOutbox(node.id, &node.storage,
+            [&inFlight, index](const std::string& peerId, const std::vector<uint8_t>& frame) {
+                size_t to = strtoul(peerId.c_str() + 4, nullptr, 10);
+                inFlight.push_back({index, to, frame});
+                return true;
+            }, config, options.seed * 1000 + (uint32_t)index + now));
+        node.outbox->setReceiveCallback([&, index](const std::string& origin, const std::vector<uint8_t>& payload) {
+            uint32_t number = 0;
+            memcpy(&number, payload.data(), std::min(payload.size(), sizeof(number)));
+            if (number >= traffic.size() || traffic[number].payload != payload || traffic[number].to != index) {
+                result.corrupted++;
+                return;
+            }
+            if (!deliveredAtMs.emplace(number, now).second) {
+                result.duplicates++;
+                return;
+            }
+            result.delivered++;
+            result.latenciesMs.push_back(now - traffic[number].atMs);
+        });
+        node.outbox->setReceiptCallback([&, index](const std::string& destination, uint32_t messageId) {
+            auto it = messageIds.find(std::make_pair(index, messageId));
+            result.receipts++;
+            if (it == messageIds.end() || !deliveredAtMs.count(it->second)) {
+                result.falseReceipts++;
+            }
+        });
+        node.outbox->begin(now);
+    };
+    for (size_t i = 0; i < options.nodes; i++) {
+        char id[16];
+        snprintf(id, sizeof(id), "node%02zu", i);
+        nodes[i].id = id;
+        make_node(i);
+    }
+
+    size_t nextMessage = 0;
+    size_t nextReboot = 0;
+    for (now = 0; now < endMs; now += TICK_MS) {
+        const std::vector<bool>& links = s_links[now / TICK_MS];
+
+        // Power cycles: the node is gone for a while, then rebuilt from its log
+        while (nextReboot < reboots.size() && reboots[nextReboot].atMs <= now) {
+            SimNode& node = nodes[reboots[nextReboot++].node];
+            if (node.online) {
+                add_stats(&node.previousStats, node.outbox->stats());
+                node.online = false;
+                node.backAtMs = now + REBOOT_DOWN_MS;
+            }
+        }
+        for (size_t i = 0; i < options.nodes; i++) {
+            if (!nodes[i].online && now >= nodes[i].backAtMs) {
+                make_node(i);
+                nodes[i].online = true;
+            }
+        }
+
+        // Neighbour table events on meeting and parting
+        for (size_t a = 0; a < options.nodes; a++) {
+            for (size_t b = 0; b < options.nodes; b++) {
+                if (a == b || !nodes[a].online) {
+                    continue;
+                }
+                bool up = links[link_index(a, b, options.nodes)] && nodes[b].online;
+                if (up != nodes[a].outbox->isNeighbour(nodes[b].id)) {
+                    if (up) {
+                        nodes[a].outbox->peerUp(nodes[b].id, now);
+                    } else {
+                        nodes[a].outbox->peerDown(nodes[b].id, now);
+                    }
+                }
+            }
+        }
+
+        // Frames sent during the last tick arrive now, if the nodes are still together
+        arriving.swap(inFlight);
+        inFlight.clear();
+        for (Frame& frame : arriving) {
+            result.frames++;
+            result.airBytes += frame.data.size() + FRAME_OVERHEAD_BYTES;
+            if (!links[link_index(frame.from, frame.to, options.nodes)] || !nodes[frame.to].online ||
+                !nodes[frame.from].online || unit(rng) < options.loss) {
+                continue;
+            }
+            nodes[frame.to].outbox->handleFrame(nodes[frame.from].id, frame.data.data(), frame.data.size(), now);
+        }
+        arriving.clear();
+
+        while (nextMessage < traffic.size() && traffic[nextMessage].atMs <= now) {
+            const Traffic& message = traffic[nextMessage];
+            result.sent++;
+            SimNode& node = nodes[message.from];
+            if (node.online) {
+                uint32_t id = node.outbox->send(nodes[message.to].id, message.payload.data(), message.payload.size(),
+                                                OUTBOX_PRIORITY_NORMAL,
+                                                OUTBOX_FLAG_RECEIPT | (custody ? OUTBOX_FLAG_CUSTODY : 0), 0, now);
+                if (id) {
+                    messageIds[std::make_pair(message.from, id)] = (uint32_t)nextMessage;
+                } else {
+                    result.refused++;
+                }
+            }
+            nextMessage++;
+        }
+
+        for (SimNode& node : nodes) {
+            if (node.online) {
+                node.outbox->tick(now);
+            }
+        }
+    }
+
+    outbox_stats_t total = outbox_stats_t();
+    for (SimNode& node : nodes) {
+        add_stats(&total, node.previousStats);
+        add_stats(&total, node.outbox->stats());
+        result.flashWrites += node.storage.m_writes;
+        result.flashBytes += node.storage.m_bytes;
+        result.flashPages += node.storage.m_pages;
+        result.pending += node.outbox->pending();
+    }
+    result.compactions = total.log_compactions;
+    result.custodyHandovers = total.custody_handed;
+    result.expired = total.expired;
+    return result;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+static void print_result(const Result& r) {
+    double perMessage = r.sent ? 1.0 / r.sent : 0;
+    printf("%-8s %5zu/%-5zu %5.1f%% %8.0f %8.0f %7.1f %8.0f %6.1f %7.0f %6.1f %6u\n", r.mode.c_str(), r.delivered,
+           r.sent, r.sent ? 100.0 * r.delivered / r.sent : 0.0, sim_percentile(r.latenciesMs, 0.5) / 1000.0,
+           sim_percentile(r.latenciesMs, 0.9) / 1000.0, r.frames * perMessage, r.airBytes * perMessage,
+           r.flashWrites * perMessage, r.flashBytes * perMessage, r.flashPages * perMessage,
+           (unsigned)r.custodyHandovers);
+}
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<Result>& results) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("nodes", options.nodes);
+    json.add("field_m", options.fieldM, 0);
+    json.add("range_m", options.rangeM, 0);
+    json.add("loss", options.loss, 3);
+    json.beginArray("runs");
+    for (const Result& r : results) {
+        json.beginObject();
+        json.add("mode", r.mode);
+        json.add("sent", r.sent);
+        json.add("delivered", r.delivered);
+        json.add("refused", r.refused);
+        json.add("pending", r.pending);
+        json.add("duplicates", r.duplicates);
+        json.add("latency_p50_ms", sim_percentile(r.latenciesMs, 0.5));
+        json.add("latency_p90_ms", sim_percentile(r.latenciesMs, 0.9));
+        json.add("frames", r.frames);
+        json.add("air_bytes", r.airBytes);
+        json.add("flash_writes", r.flashWrites);
+        json.add("flash_bytes", r.flashBytes);
+        json.add("flash_pages", r.flashPages);
+        json.add("compactions", r.compactions);
+        json.add("custody_handovers", r.custodyHandovers);
+        json.add("expired", r.expired);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    std::string jsonPath;
+    SimArgs args;
+    args.add("--nodes", "N", &options.nodes);
+    args.add("--field", "M", &options.fieldM);
+    args.add("--range", "M", &options.rangeM);
+    args.add("--loss", "P", &options.loss);
+    args.add("--interval-s", "S", &options.intervalS);
+    args.add("--traffic-s", "S", &options.trafficS);
+    args.add("--drain-s", "S", &options.drainS);
+    args.add("--reboots", "N", &options.reboots);
+    args.add("--mode", "direct|outbox|custody|all", &options.mode);
+    args.add("--seed", "N", &options.seed);
+    args.add("--json", "FILE", &jsonPath);
+    if (!args.parse(argc, argv) ||
+        !args.check(options.nodes >= 2 && options.nodes <= 100 && options.fieldM > 0 && options.rangeM > 0 &&
+                    options.loss >= 0 && options.loss < 1 && options.intervalS > 0 && options.trafficS > 0 &&
+                    (options.mode == "all" || options.mode == "direct" || options.mode == "outbox" ||
+                     options.mode == "custody"))) {
+        return SIM_EXIT_USAGE;
+    }
+
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    // Movement, traffic and power cycles, the same for every mode
+    const uint32_t endMs = (options.trafficS + options.drainS) * 1000;
+    std::mt19937 rng(options.seed);
+    make_movement(options, endMs, rng);
+    std::vector<Traffic> traffic;
+    std::uniform_int_distribution<size_t> pick(0, options.nodes - 1);
+    std::uniform_int_distribution<size_t> length(16, 200);
+    for (uint32_t at = 1000; at < options.trafficS * 1000; at += options.intervalS * 1000) {
+        Traffic message;
+        message.atMs = at;
+        message.from = pick(rng);
+        do {
+            message.to = pick(rng);
+        } while (message.to == message.from);
+        uint32_t number = (uint32_t)traffic.size();
+        message.payload.resize(length(rng));
+        for (uint8_t& byte : message.payload) {
+            byte = (uint8_t)rng();
+        }
+        memcpy(message.payload.data(), &number, sizeof(number));
+        traffic.push_back(message);
+    }
+    std::vector<Reboot> reboots;
+    std::uniform_int_distribution<uint32_t> when(0, endMs - REBOOT_DOWN_MS);
+    for (uint32_t i = 0; i < options.reboots; i++) {
+        reboots.push_back({when(rng) / TICK_MS * TICK_MS, pick(rng)});
+    }
+    std::sort(reboots.begin(), reboots.end(), [](const Reboot& a, const Reboot& b) { return a.atMs < b.atMs; });
+
+    // How often do two given nodes meet?
+    size_t pairs = options.nodes * (options.nodes - 1) / 2;
+    uint64_t linkTicks = 0;
+    for (const std::vector<bool>& links : s_links) {
+        linkTicks += std::count(links.begin(), links.end(), true);
+    }
+    printf("%u nodes, %.0f m field, %.0f m range, loss %.0f%%, %zu messages, %u reboots; "
+           "a given pair is in range %.1f%% of the time\n\n",
+           options.nodes, options.fieldM, options.rangeM, options.loss * 100, traffic.size(),
+           (unsigned)options.reboots, 100.0 * linkTicks / ((double)pairs * s_links.size()));
+
+    std::vector<Result> results;
+    if (options.mode == "all" || options.mode == "direct") {
+        results.push_back(run_legacy(options, traffic));
+    }
+    if (options.mode == "all" || options.mode == "outbox") {
+        results.push_back(run_outbox(options, traffic, reboots, false, endMs));
+    }
+    if (options.mode == "all" || options.mode == "custody") {
+        results.push_back(run_outbox(options, traffic, reboots, true, endMs));
+    }
+
+    printf("mode     delivered        %%  p50 (s)  p90 (s)  frames  air (B)  flash writes/bytes/pages  handovers\n");
+    printf("                                         per message sent\n");
+    bool ok = true;
+    for (const Result& r : results) {
+        print_result(r);
+        ok = ok && r.corrupted == 0 && r.falseReceipts == 0;
+    }
+    printf("\n");
+    for (const Result& r : results) {
+        if (r.mode != "direct") {
+            printf("%-8s %zu refused, %zu messages and receipts still queued, %u expired, %zu duplicates, %zu receipts, "
+                   "%u log compactions%s\n",
+                   r.mode.c_str(), r.refused, r.pending, (unsigned)r.expired, r.duplicates, r.receipts,
+                   (unsigned)r.compactions,
+                   r.corrupted || r.falseReceipts ? "  FAILED: corrupt payload or false receipt" : "");
+        }
+    }
+    if (!jsonPath.empty() && !write_json(jsonPath, options, results)) {
+        fprintf(stderr, "Cannot write %s\n", jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return ok ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
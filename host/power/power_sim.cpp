@@ -0,0 +1,554 @@
+/**
+ * @file power_sim.cpp
+ * @brief Power state machine, task wakes and estimated battery life over a day of use
+ *
+ * Generates --hours of activity for one node: transmissions heard
+ * (--rx-per-hour, lasting around --talk-s), own PTT turns
+ * (--tx-per-hour), button presses (--user-per-hour, in bursts of three),
+ * map sessions (--nav-per-hour of --nav-min minutes) and text messages
+ * (--data-per-hour). The same trace is played twice through
+ * PowerManager and a model of the firmware's polling tasks:
+ *
+ * - "always-on": every state runs as the firmware did before the power
+ *   manager: 240 MHz, no light sleep, radio awake, UI at 30 fps, audio
+ *   every 20 ms, network every 100 ms, GPS every 100 ms.
+ * - "managed": power_default_config(). The HaLow backend (MM-IoT-SDK)
+ *   has no power save, so its radio stays awake in every state as on the
+ *   device; --radio-power-save lets it doze at the policy's radio_wake_ms,
+ *   as the ESP-IDF Wi-Fi fallback does.
+ *
+ * Tasks wake at the poll interval of the state they were in when they
+ * went to sleep; buttons go through the 50 ms debounce of
+ * button_handler.cpp; a dozing radio holds traffic until its next
+ * service period. Each wake costs CPU time (WAKE_COST_US), which gives
+ * the CPU load per state.
+ *
+ * Reported per run and state: share of time, wakes per second (as the
+ * policy predicts and as counted), CPU load, estimated current from
+ * power_estimate_current_ma() with power_default_current_model(), and the
+ * battery life if the node stayed in that state; then the average over
+ * the trace. Also the cost of sleeping: PTT press to transmitter keyed,
+ * first voice frame heard after the talker keyed up, and text message
+ * delay.
+ *
+ * Exit status: 0 if the managed run draws less on average than
+ * always-on and its latencies stay within what the policy allows, 1 if
+ * not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "power_manager.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static const uint32_t FRAME_MS = 20;
+static const uint32_t DEBOUNCE_MS = 50;             // button_handler.cpp
+static const uint32_t PRESS_MS = 200;               // How long a non-PTT button is held
+static const uint32_t NEVER = UINT32_MAX;
+
+// CPU time per task wake: a poll that finds nothing, and a voice frame
+// encoded or decoded. The network loop builds and broadcasts a discovery
+// packet on every pass.
+static const uint32_t WAKE_COST_US[POWER_WAKE_COUNT] = {
+    300,    // UI: button poll, redraw amortised
+    150,    // Audio poll without voice
+    1500,   // Network
+    300,    // GPS sentence parsing
+    400,    // Radio: SPI transfer of received frames
+    50      // Power task
+};
+static const uint32_t AUDIO_FRAME_COST_US = 2500;
+
+struct Options {
+    double hours = 12;
+    double rxPerHour = 30;
+    double txPerHour = 6;
+    double talkS = 5;
+    double userPerHour = 10;
+    double navPerHour = 1;
+    double navMin = 5;
+    double dataPerHour = 12;
+    double batteryMah = 0;                          // 0: the current model's
+    uint32_t seed = 1;
+    bool radioPowerSave = false;                    // The backend honours set_power_save
+    std::string jsonPath;
+};
+
+struct Span {
+    uint32_t startMs;
+    uint32_t endMs;
+};
+
+struct Trace {
+    uint32_t durationMs = 0;
+    std::vector<Span> rx;                           // Transmissions heard
+    std::vector<Span> ptt;                          // Own PTT held
+    std::vector<Span> buttons;                      // Other buttons held
+    std::vector<Span> nav;                          // Map shown
+    std::vector<uint32_t> data;                     // Text messages arriving
+};
+
+struct StateResult {
+    double share = 0;
+    double policyWakesPerS = 0;
+    double wakesPerS = 0;
+    double cpuLoad = 0;
+    double currentMa = 0;
+    double lifeH = 0;
+};
+
+struct Result {
+    std::string name;
+    power_stats_t stats = {};
+    StateResult states[POWER_STATE_COUNT];
+    double averageMa = 0;
+    double lifeH = 0;
+    SimStat ptt;
+    SimStat voice;
+    SimStat data;
+    uint32_t maxPttMs = 0;                          // Bound the policy allows
+    uint32_t maxVoiceMs = 0;
+};
+
+// ============================================================================
+// TRACE
+// ============================================================================
+
+static std::vector<Span> make_spans(std::mt19937& rng, double perHour, double meanS, double minS, double maxS,
+                                    uint32_t durationMs) {
+    std::vector<Span> spans;
+    if (perHour <= 0) {
+        return spans;
+    }
+    std::exponential_distribution<double> gap(perHour / 3600.0);
+    std::exponential_distribution<double> length(1.0 / meanS);
+    double t = gap(rng);
+    while (t * 1000 < durationMs) {
+        double s = std::min(maxS, std::max(minS, length(rng)));
+        Span span = { (uint32_t)(t * 1000), (uint32_t)std::min<double>(durationMs, (t + s) * 1000) };
+        spans.push_back(span);
+        t += s + gap(rng);
+    }
+    return spans;
+}
+
+static Trace make_trace(const Options& options) {
+    std::mt19937 rng(options.seed);
+    Trace trace;
+    trace.durationMs = (uint32_t)(options.hours * 3600 * 1000);
+    trace.rx = make_spans(rng, options.rxPerHour, options.talkS, 1, 30, trace.durationMs);
+    trace.ptt = make_spans(rng, options.txPerHour, options.talkS, 1, 30, trace.durationMs);
+    trace.nav = make_spans(rng, options.navPerHour, options.navMin * 60, 30, 3600, trace.durationMs);
+    // Button bursts: three presses a second apart (scrolling a menu)
+    for (const Span& burst : make_spans(rng, options.userPerHour, 3, 3, 3, trace.durationMs)) {
+        for (uint32_t i = 0; i < 3; i++) {
+            uint32_t start = burst.startMs + i * 1000;
+            if (start + PRESS_MS < trace.durationMs) {
+                trace.buttons.push_back({ start, start + PRESS_MS });
+            }
+        }
+    }
+    for (const Span& message : make_spans(rng, options.dataPerHour, 0.001, 0.001, 0.001, trace.durationMs)) {
+        trace.data.push_back(message.startMs);
+    }
+    return trace;
+}
+
+static bool inside(const std::vector<Span>& spans, size_t* cursor, uint32_t t) {
+    while (*cursor < spans.size() && spans[*cursor].endMs <= t) {
+        (*cursor)++;
+    }
+    return *cursor < spans.size() && spans[*cursor].startMs <= t;
+}
+
+// ============================================================================
+// NODE MODEL
+// ============================================================================
+
+// The debounce of button_handler.cpp, run at each UI wake
+struct Button {
+    bool state = false;                             // Debounced, true = pressed
+    bool lastReading = false;
+    uint32_t lastChangeMs = 0;
+
+    // Returns +1 on a debounced press, -1 on a release
+    int read(bool reading, uint32_t t) {
+        if (reading != lastReading) {
+            lastChangeMs = t;
+        }
+        lastReading = reading;
+        if (t - lastChangeMs > DEBOUNCE_MS && reading != state) {
+            state = reading;
+            return state ? 1 : -1;
+        }
+        return 0;
+    }
+};
+
+class Node {
+public:
+    Node(const power_config_t& config, const Trace& trace, Result* result)
+        : m_manager(config), m_trace(trace), m_result(result) {}
+
+    void run() {
+        m_manager.update(0);
+        for (int source = 0; source < POWER_WAKE_COUNT; source++) {
+            m_next[source] = source == POWER_WAKE_RADIO ? radioNext(0) : 0;
+        }
+        size_t dataCursor = 0;
+        for (;;) {
+            int source = 0;
+            for (int s = 1; s < POWER_WAKE_COUNT; s++) {
+                if (m_next[s] < m_next[source]) {
+                    source = s;
+                }
+            }
+            uint32_t t = std::min(m_next[source], m_trace.durationMs);
+            // Messages reach an awake radio as they arrive; a dozing one
+            // holds them for its next service period
+            while (dataCursor < m_trace.data.size() && m_trace.data[dataCursor] <= t) {
+                uint32_t arrival = m_trace.data[dataCursor++];
+                m_pendingData.push_back(arrival);
+                if (radioAwake()) {
+                    deliverData(arrival);
+                }
+            }
+            if (t >= m_trace.durationMs) {
+                m_manager.update(m_trace.durationMs);
+                return;
+            }
+            wake((power_wake_source_t)source, t);
+        }
+    }
+
+    const power_stats_t& stats() const { return m_manager.stats(); }
+    uint64_t busyUs(int state) const { return m_busyUs[state]; }
+
+private:
+    bool radioAwake() const { return m_manager.policy().radio_wake_ms == 0; }
+
+    uint32_t radioNext(uint32_t t) const {
+        uint32_t interval = m_manager.policy().radio_wake_ms;
+        return interval ? t + interval : NEVER;
+    }
+
+    void count(power_wake_source_t source, uint32_t costUs) {
+        m_manager.noteWake(source);
+        m_busyUs[m_manager.state()] += costUs;
+    }
+
+    // Reports wake the power task, so state changes apply at once
+    void changed(uint32_t t) {
+        if (!m_manager.update(t)) {
+            return;
+        }
+        if (radioAwake()) {
+            m_next[POWER_WAKE_RADIO] = NEVER;
+            receive(t);
+        } else if (m_next[POWER_WAKE_RADIO] == NEVER) {
+            m_next[POWER_WAKE_RADIO] = radioNext(t);
+        }
+    }
+
+    // The radio is receiving: whatever is on air or held for it comes in
+    void receive(uint32_t t) {
+        if (inside(m_trace.rx, &m_rxCursor, t)) {
+            m_rxDelivered = m_rxCursor;
+        }
+        deliverData(t);
+    }
+
+    void deliverData(uint32_t t) {
+        if (m_pendingData.empty()) {
+            return;
+        }
+        for (uint32_t arrival : m_pendingData) {
+            m_result->data.add(t - arrival);
+            count(POWER_WAKE_RADIO, WAKE_COST_US[POWER_WAKE_RADIO]);
+        }
+        m_pendingData.clear();
+        m_manager.pulse(POWER_ACTIVITY_DATA, t);
+        changed(t);
+    }
+
+    void wake(power_wake_source_t source, uint32_t t) {
+        if (source == POWER_WAKE_RADIO) {
+            // Service period of a dozing radio
+            count(source, WAKE_COST_US[source]);
+            m_next[source] = radioNext(t);
+            receive(t);
+            return;
+        }
+        if (source == POWER_WAKE_UI) {
+            wakeUi(t);
+        } else if (source == POWER_WAKE_AUDIO) {
+            wakeAudio(t);
+        } else {
+            count(source, WAKE_COST_US[source]);
+            if (source == POWER_WAKE_MANAGER) {
+                changed(t);
+            }
+        }
+        // The task sleeps for the interval of the state it is in now
+        m_next[source] = t + m_manager.pollMs(source);
+    }
+
+    void wakeUi(uint32_t t) {
+        count(POWER_WAKE_UI, WAKE_COST_US[POWER_WAKE_UI]);
+        bool pttDown = inside(m_trace.ptt, &m_pttCursor, t);
+        int ptt = m_ptt.read(pttDown, t);
+        int other = m_other.read(inside(m_trace.buttons, &m_buttonCursor, t), t);
+        if (ptt > 0 || other > 0) {
+            m_manager.pulse(POWER_ACTIVITY_USER, t);
+        }
+        if (ptt > 0 && pttDown) {
+            m_result->ptt.add(t - m_trace.ptt[m_pttCursor].startMs);
+        }
+        if (ptt != 0) {
+            m_manager.setActive(POWER_ACTIVITY_TRANSMIT, ptt > 0, t);
+        }
+        m_manager.setActive(POWER_ACTIVITY_NAVIGATE, inside(m_trace.nav, &m_navCursor, t), t);
+        changed(t);
+    }
+
+    void wakeAudio(uint32_t t) {
+        bool transmitting = m_manager.state() == POWER_STATE_TRANSMITTING;
+        bool onAir = inside(m_trace.rx, &m_rxCursor, t);
+        if (onAir && radioAwake()) {
+            m_rxDelivered = m_rxCursor;
+        }
+        if (transmitting && onAir) {
+            // Half duplex: a talker who keyed up over us is not timed
+            m_rxHeard = m_rxCursor;
+        }
+        bool voice = !transmitting && onAir && m_rxDelivered == m_rxCursor;
+        count(POWER_WAKE_AUDIO, voice || transmitting ? AUDIO_FRAME_COST_US : WAKE_COST_US[POWER_WAKE_AUDIO]);
+        if (!voice) {
+            return;
+        }
+        count(POWER_WAKE_RADIO, WAKE_COST_US[POWER_WAKE_RADIO]);
+        if (m_rxHeard != m_rxCursor) {
+            m_rxHeard = m_rxCursor;
+            m_result->voice.add(t - m_trace.rx[m_rxCursor].startMs);
+        }
+        m_manager.pulse(POWER_ACTIVITY_VOICE, t);
+        changed(t);
+    }
+
+    PowerManager m_manager;
+    const Trace& m_trace;
+    Result* m_result;
+    uint32_t m_next[POWER_WAKE_COUNT] = {};
+    uint64_t m_busyUs[POWER_STATE_COUNT] = {};
+    std::vector<uint32_t> m_pendingData;
+    Button m_ptt;
+    Button m_other;
+    size_t m_pttCursor = 0;
+    size_t m_buttonCursor = 0;
+    size_t m_navCursor = 0;
+    size_t m_rxCursor = 0;
+    size_t m_rxDelivered = SIZE_MAX;
+    size_t m_rxHeard = SIZE_MAX;
+};
+
+// ============================================================================
+// RUNS
+// ============================================================================
+
+// The firmware before the power manager, in every state
+static power_config_t always_on_config(void) {
+    power_config_t config = power_default_config();
+    for (int state = 0; state < POWER_STATE_COUNT; state++) {
+        power_policy_t& policy = config.policy[state];
+        policy.cpu_max_mhz = 240;
+        policy.cpu_min_mhz = 240;
+        policy.light_sleep = false;
+        policy.radio_wake_ms = 0;
+        policy.poll_ms[POWER_WAKE_UI] = 33;
+        policy.poll_ms[POWER_WAKE_AUDIO] = FRAME_MS;
+        policy.poll_ms[POWER_WAKE_NETWORK] = 100;
+        policy.poll_ms[POWER_WAKE_GPS] = 100;
+        policy.poll_ms[POWER_WAKE_MANAGER] = 250;
+    }
+    return config;
+}
+
+// Longest a debounced press can take to be seen when polling every poll_ms
+static uint32_t press_bound_ms(uint32_t pollMs) {
+    return pollMs + (DEBOUNCE_MS / pollMs + 1) * pollMs;
+}
+
+static Result run(const std::string& name, const power_config_t& config, const power_current_model_t& model,
+                  const Trace& trace) {
+    Result result;
+    result.name = name;
+    Node node(config, trace, &result);
+    node.run();
+    result.stats = node.stats();
+
+    double totalMs = trace.durationMs;
+    for (int state = 0; state < POWER_STATE_COUNT; state++) {
+        const power_policy_t& policy = config.policy[state];
+        StateResult& r = result.states[state];
+        double ms = result.stats.time_ms[state];
+        r.share = ms / totalMs;
+        r.policyWakesPerS = power_policy_wakes_per_second(policy);
+        r.wakesPerS = ms > 0 ? result.stats.wakes[state] * 1000.0 / ms : 0;
+        r.cpuLoad = ms > 0 ? node.busyUs(state) / (ms * 1000.0) : 0;
+        // A state never entered is estimated from its policy alone
+        double wakes = ms > 0 ? r.wakesPerS : r.policyWakesPerS;
+        r.currentMa = power_estimate_current_ma(model, policy, (float)r.cpuLoad, (float)wakes,
+                                                state == POWER_STATE_TRANSMITTING, state >= POWER_STATE_LISTENING);
+        r.lifeH = model.battery_mah / r.currentMa;
+        result.averageMa += r.share * r.currentMa;
+
+        // Sleeping states decide how late PTT and voice are noticed
+        if (state < POWER_STATE_TRANSMITTING) {
+            result.maxPttMs = std::max(result.maxPttMs, press_bound_ms(policy.poll_ms[POWER_WAKE_UI]));
+            result.maxVoiceMs = std::max(result.maxVoiceMs,
+                                         policy.radio_wake_ms + policy.poll_ms[POWER_WAKE_AUDIO]);
+        }
+    }
+    result.lifeH = model.battery_mah / result.averageMa;
+    return result;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static void print_result(const Result& r) {
+    printf("%s: %.1f mA average, %.1f h on battery\n", r.name.c_str(), r.averageMa, r.lifeH);
+    printf("  %-13s %6s %9s %9s %6s %7s %7s\n", "state", "time", "wakes/s", "(policy)", "cpu", "mA", "life-h");
+    for (int state = 0; state < POWER_STATE_COUNT; state++) {
+        const StateResult& s = r.states[state];
+        printf("  %-13s %5.1f%% %9.1f %9.1f %5.1f%% %7.1f %7.1f\n", power_state_name((power_state_t)state),
+               100.0 * s.share, s.wakesPerS, s.policyWakesPerS, 100.0 * s.cpuLoad, s.currentMa, s.lifeH);
+    }
+    printf("  %-22s %8s %8s %8s\n", "latency", "mean ms", "max ms", "bound");
+    printf("  %-22s %8.0f %8.0f %8u\n", "PTT to keyed", r.ptt.mean(), r.ptt.max(), r.maxPttMs);
+    printf("  %-22s %8.0f %8.0f %8u\n", "first voice frame", r.voice.mean(), r.voice.max(), r.maxVoiceMs);
+    printf("  %-22s %8.0f %8.0f %8s\n", "text message", r.data.mean(), r.data.max(), "-");
+    printf("  transitions %u\n\n", r.stats.transitions);
+}
+
+static bool write_json(const std::string& path, const Options& options, const power_current_model_t& model,
+                       const std::vector<Result>& results) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("hours", options.hours, 2);
+    json.add("rx_per_hour", options.rxPerHour);
+    json.add("tx_per_hour", options.txPerHour);
+    json.add("talk_s", options.talkS);
+    json.add("user_per_hour", options.userPerHour);
+    json.add("nav_per_hour", options.navPerHour);
+    json.add("nav_min", options.navMin);
+    json.add("data_per_hour", options.dataPerHour);
+    json.add("battery_mah", model.battery_mah, 0);
+    json.add("radio_power_save", options.radioPowerSave);
+    json.beginArray("runs");
+    for (const Result& r : results) {
+        json.beginObject();
+        json.add("name", r.name);
+        json.add("average_ma", r.averageMa, 2);
+        json.add("life_h", r.lifeH, 2);
+        json.add("transitions", r.stats.transitions);
+        json.add("ptt_mean_ms", r.ptt.mean());
+        json.add("ptt_max_ms", r.ptt.max(), 0);
+        json.add("voice_mean_ms", r.voice.mean());
+        json.add("voice_max_ms", r.voice.max(), 0);
+        json.add("data_mean_ms", r.data.mean());
+        json.add("data_max_ms", r.data.max(), 0);
+        json.beginArray("states");
+        for (int state = 0; state < POWER_STATE_COUNT; state++) {
+            const StateResult& s = r.states[state];
+            json.beginObject();
+            json.add("state", power_state_name((power_state_t)state));
+            json.add("share", s.share, 4);
+            json.add("wakes_per_s", s.wakesPerS, 2);
+            json.add("policy_wakes_per_s", s.policyWakesPerS, 2);
+            json.add("cpu_load", s.cpuLoad, 4);
+            json.add("current_ma", s.currentMa, 2);
+            json.add("life_h", s.lifeH, 2);
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--hours", "H", &options.hours);
+    args.add("--rx-per-hour", "N", &options.rxPerHour);
+    args.add("--tx-per-hour", "N", &options.txPerHour);
+    args.add("--talk-s", "S", &options.talkS);
+    args.add("--user-per-hour", "N", &options.userPerHour);
+    args.add("--nav-per-hour", "N", &options.navPerHour);
+    args.add("--nav-min", "M", &options.navMin);
+    args.add("--data-per-hour", "N", &options.dataPerHour);
+    args.add("--battery-mah", "N", &options.batteryMah);
+    args.add("--seed", "N", &options.seed);
+    args.add("--radio-power-save", &options.radioPowerSave);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv) ||
+        !args.check(options.hours > 0 && options.hours <= 1000 && options.talkS > 0 && options.navMin > 0 &&
+                    options.rxPerHour >= 0 && options.txPerHour >= 0 && options.userPerHour >= 0 &&
+                    options.navPerHour >= 0 && options.dataPerHour >= 0 && options.batteryMah >= 0)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    power_current_model_t model = power_default_current_model();
+    if (options.batteryMah > 0) {
+        model.battery_mah = (float)options.batteryMah;
+    }
+    Trace trace = make_trace(options);
+    printf("%.1f h: %zu transmissions heard, %zu sent, %zu button presses, %zu map sessions, %zu messages; "
+           "%.0f mAh\n", options.hours, trace.rx.size(), trace.ptt.size(), trace.buttons.size(),
+           trace.nav.size(), trace.data.size(), model.battery_mah);
+    printf("radio power save: %s\n\n", options.radioPowerSave ? "dozes at radio_wake_ms" :
+           "unsupported by MM-IoT-SDK, radio always awake (--radio-power-save to model it)");
+
+    power_config_t managed_config = power_default_config();
+    if (!options.radioPowerSave) {
+        for (int state = 0; state < POWER_STATE_COUNT; state++) {
+            managed_config.policy[state].radio_wake_ms = 0;
+        }
+    }
+    std::vector<Result> results;
+    results.push_back(run("always-on", always_on_config(), model, trace));
+    results.push_back(run("managed", managed_config, model, trace));
+    for (const Result& r : results) {
+        print_result(r);
+    }
+    printf("mA and life-h: estimates from the current model, per state as if the node stayed in it\n");
+
+    const Result& always = results[0];
+    const Result& managed = results[1];
+    bool ok = managed.averageMa < always.averageMa &&
+              managed.ptt.max() <= managed.maxPttMs && managed.voice.max() <= managed.maxVoiceMs;
+    printf("managed: %.1fx battery life of always-on%s\n", always.averageMa / managed.averageMa,
+           ok ? "" : " -- CHECK FAILED");
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, model, results)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return ok ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
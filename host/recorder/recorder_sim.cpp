@@ -0,0 +1,420 @@
+/**
+ * @file recorder_sim.cpp
+ * @brief Voice recorder write amplification, retention, replay and capture cost
+ *
+ * Drives VoiceRecorder over --hours of simulated radio traffic into a
+ * storage in RAM that counts block writes. Transmissions last an
+ * exponentially distributed time around --talk-s (1 - 30 s) with a pause
+ * around --idle-s between them; one in nine is this node's own, the rest
+ * come from 8 talkers. Frames come every 20 ms; each --frame-bytes value
+ * is a run (640: the 16 kHz PCM frames audioTask sends today; 60: a
+ * 24 kbps codec). --restarts times the node loses power and the recorder
+ * is reloaded from storage, losing the block that was being filled.
+ *
+ * Reported per run: voice and flash bytes, write amplification (flash
+ * bytes per voice byte), the share of blocks written before they were
+ * full, blocks written per hour and how often a block of the ring is
+ * rewritten per day, the transmissions and seconds of voice the ring
+ * holds at the end, frames lost to restarts, and whether every
+ * transmission in the index replays byte for byte.
+ *
+ * Then the cost on the audio path: a capture (FrameRing push, with
+ * another thread draining the ring as the recorder task does) against
+ * writing the frame to a file directly from the audio task.
+ *
+ * Exit status: 0 if every replay matched, 1 if not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "voice_recorder.h"
+#include "frame_ring.h"
+#include "esp_log.h"
+#include "sim_harness.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t FRAME_MS = 20;
+static const uint32_t TICK_MS = 50;                 // recorder_service tick
+static const uint32_t MIN_TALK_MS = 1000;
+static const uint32_t MAX_TALK_MS = 30000;
+static const uint32_t TALKERS = 8;
+static const size_t CAPTURE_FRAMES = 200000;
+
+struct Options {
+    double hours = 8;
+    std::vector<uint32_t> frameBytes = {640, 60};
+    double talkS = 5;
+    double idleS = 30;
+    uint32_t blocks = 64;
+    uint32_t restarts = 4;
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+struct Result {
+    uint32_t frameBytes = 0;
+    voice_recorder_stats_t stats = {};
+    uint32_t heldTransmissions = 0;
+    double heldS = 0;
+    uint32_t lostFrames = 0;
+    uint32_t checked = 0;
+    uint32_t mismatched = 0;
+};
+
+struct Latency {
+    std::string name;
+    SimStat ns;
+};
+
+// ============================================================================
+// STORAGE
+// ============================================================================
+
+class RamVoiceStorage : public IVoiceStorage {
+public:
+    explicit RamVoiceStorage(size_t blocks) : m_data(blocks * VOICE_RECORDER_BLOCK_SIZE, 0xFF), m_blocks(blocks) {}
+
+    size_t blockCount() const override { return m_blocks; }
+
+    bool readBlock(size_t index, uint8_t* block) override {
+        memcpy(block, m_data.data() + index * VOICE_RECORDER_BLOCK_SIZE, VOICE_RECORDER_BLOCK_SIZE);
+        return true;
+    }
+
+    bool writeBlock(size_t index, const uint8_t* block) override {
+        memcpy(m_data.data() + index * VOICE_RECORDER_BLOCK_SIZE, block, VOICE_RECORDER_BLOCK_SIZE);
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    size_t m_blocks;
+};
+
+// ============================================================================
+// TRAFFIC
+// ============================================================================
+
+// Frame contents follow from the transmission and frame number, so replays
+// can be checked without keeping what was recorded
+static void make_frame(uint32_t transmission, uint32_t frame, uint8_t* out, size_t length) {
+    uint32_t x = transmission * 2654435761u ^ (frame + 1) * 40503u;
+    for (size_t i = 0; i < length; i++) {
+        x = x * 1103515245u + 12345u;
+        out[i] = (uint8_t)(x >> 16);
+    }
+}
+
+// Where a recorder entry's frames come from: the traffic's transmission
+// and its first frame (later than 0 if the start was overwritten)
+struct Source {
+    uint32_t transmission;
+    uint32_t firstFrame;
+};
+
+static void check_replays(VoiceRecorder* recorder, const std::map<uint32_t, Source>& sources, uint32_t frameBytes,
+                          Result* result) {
+    std::vector<voice_transmission_t> entries(VOICE_RECORDER_MAX_INDEX);
+    size_t count = recorder->recent(entries.data(), entries.size());
+    std::vector<uint8_t> frame(VOICE_RECORDER_MAX_FRAME), expected(frameBytes);
+    for (size_t i = 0; i < count; i++) {
+        result->checked++;
+        auto source = sources.find(entries[i].id);
+        if (source == sources.end() || !recorder->startReplay(entries[i].id)) {
+            result->mismatched++;
+            continue;
+        }
+        uint32_t frames = 0;
+        bool match = true;
+        size_t length;
+        while ((length = recorder->nextReplayFrame(frame.data(), frame.size(), NULL)) > 0) {
+            make_frame(source->second.transmission, source->second.firstFrame + frames, expected.data(), frameBytes);
+            match = match && length == frameBytes && memcmp(frame.data(), expected.data(), frameBytes) == 0;
+            frames++;
+        }
+        if (!match || frames != entries[i].frames) {
+            result->mismatched++;
+        }
+    }
+}
+
+static Result run(const Options& options, uint32_t frameBytes) {
+    Result result;
+    result.frameBytes = frameBytes;
+    std::mt19937 random(options.seed);
+    std::exponential_distribution<double> talk(1.0 / (options.talkS * 1000));
+    std::exponential_distribution<double> idle(1.0 / (options.idleS * 1000));
+    std::uniform_int_distribution<uint32_t> talker(0, TALKERS);
+
+    uint64_t endMs = (uint64_t)(options.hours * 3600 * 1000);
+    std::vector<uint64_t> restarts;
+    std::uniform_real_distribution<double> when(0, (double)endMs);
+    for (uint32_t i = 0; i < options.restarts; i++) {
+        restarts.push_back((uint64_t)when(random));
+    }
+    std::sort(restarts.begin(), restarts.end());
+
+    RamVoiceStorage storage(options.blocks);
+    voice_recorder_config_t config = voice_recorder_default_config();
+    std::unique_ptr<VoiceRecorder> recorder(new VoiceRecorder(&storage, config));
+    recorder->load();
+    voice_recorder_stats_t before = {};     // Counters of recorders lost to restarts
+
+    std::map<uint32_t, Source> sources;
+    std::vector<uint8_t> frame(frameBytes);
+    uint64_t nowMs = 1000;
+    uint64_t nextTickMs = nowMs;
+    uint32_t transmission = 0;
+    size_t nextRestart = 0;
+    while (nowMs < endMs) {
+        uint32_t talkMs = std::max(MIN_TALK_MS, std::min(MAX_TALK_MS, (uint32_t)talk(random)));
+        uint32_t who = talker(random);
+        bool own = who >= TALKERS;
+        std::string name = own ? "" : "10.0.0." + std::to_string(10 + who);
+        transmission++;
+        uint32_t lastId = 0;
+        for (uint32_t i = 0; i * FRAME_MS < talkMs; i++, nowMs += FRAME_MS) {
+            while (nextTickMs <= nowMs) {
+                recorder->tick((uint32_t)nextTickMs);
+                nextTickMs += TICK_MS;
+            }
+            if (nextRestart < restarts.size() && nowMs >= restarts[nextRestart]) {
+                // Power loss: the block being filled is gone
+                nextRestart++;
+                std::vector<voice_transmission_t> entries(VOICE_RECORDER_MAX_INDEX);
+                size_t held = recorder->recent(entries.data(), entries.size());
+                uint32_t framesBefore = 0;
+                for (size_t e = 0; e < held; e++) framesBefore += entries[e].frames;
+                const voice_recorder_stats_t& stats = recorder->stats();
+                before.voice_bytes += stats.voice_bytes;
+                before.flash_bytes += stats.flash_bytes;
+                before.blocks_written += stats.blocks_written;
+                before.padded_flushes += stats.padded_flushes;
+                before.frames += stats.frames;
+                before.transmissions += stats.transmissions;
+                recorder.reset(new VoiceRecorder(&storage, config));
+                held = recorder->load();
+                uint32_t framesAfter = 0;
+                recorder->recent(entries.data(), held);
+                for (size_t e = 0; e < held; e++) framesAfter += entries[e].frames;
+                result.lostFrames += framesBefore > framesAfter ? framesBefore - framesAfter : 0;
+                check_replays(recorder.get(), sources, frameBytes, &result);
+                lastId = 0;
+            }
+            make_frame(transmission, i, frame.data(), frameBytes);
+            recorder->addFrame(own ? VOICE_DIRECTION_TX : VOICE_DIRECTION_RX, 0, name, (uint32_t)nowMs,
+                               1700000000u + (uint32_t)(nowMs / 1000), frame.data(), frameBytes);
+            voice_transmission_t newest;
+            if (recorder->recent(&newest, 1) && newest.id != lastId) {
+                lastId = newest.id;
+                sources[lastId] = {transmission, i};
+            }
+        }
+        nowMs += std::max<uint64_t>(config.gap_ms + FRAME_MS, (uint64_t)idle(random));
+    }
+    while (nextTickMs <= nowMs) {
+        recorder->tick((uint32_t)nextTickMs);
+        nextTickMs += TICK_MS;
+    }
+    check_replays(recorder.get(), sources, frameBytes, &result);
+
+    result.stats = recorder->stats();
+    result.stats.voice_bytes += before.voice_bytes;
+    result.stats.flash_bytes += before.flash_bytes;
+    result.stats.blocks_written += before.blocks_written;
+    result.stats.padded_flushes += before.padded_flushes;
+    result.stats.frames += before.frames;
+    result.stats.transmissions += before.transmissions;
+    std::vector<voice_transmission_t> entries(VOICE_RECORDER_MAX_INDEX);
+    size_t held = recorder->recent(entries.data(), entries.size());
+    result.heldTransmissions = (uint32_t)held;
+    for (size_t i = 0; i < held; i++) {
+        result.heldS += (entries[i].duration_ms + FRAME_MS) / 1000.0;
+    }
+    return result;
+}
+
+// ============================================================================
+// CAPTURE COST
+// ============================================================================
+
+static Latency measure_ring(uint32_t frameBytes, uint32_t* dropped) {
+    Latency latency;
+    latency.name = "ring push " + std::to_string(frameBytes) + " B";
+    FrameRing ring(16 * 1024);
+    std::atomic<bool> done(false);
+    std::thread consumer([&]() {
+        std::vector<uint8_t> out(VOICE_RECORDER_MAX_FRAME + 64);
+        while (!done.load()) {
+            while (ring.pop(out.data(), out.size())) {
+            }
+            std::this_thread::yield();
+        }
+    });
+    std::vector<uint8_t> head(11 + 9, 1), frame(frameBytes, 2);
+    *dropped = 0;
+    for (size_t i = 0; i < CAPTURE_FRAMES; i++) {
+        auto start = std::chrono::steady_clock::now();
+        bool pushed = ring.push(head.data(), head.size(), frame.data(), frame.size());
+        auto end = std::chrono::steady_clock::now();
+        latency.ns.add((double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        *dropped += !pushed;
+    }
+    done.store(true);
+    consumer.join();
+    return latency;
+}
+
+// What the audio task would spend writing to flash itself
+static Latency measure_file(uint32_t frameBytes) {
+    Latency latency;
+    latency.name = "fwrite+fflush " + std::to_string(frameBytes) + " B";
+    char path[] = "/tmp/recorder_sim_XXXXXX";
+    int fd = mkstemp(path);
+    FILE* file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!file) {
+        return latency;
+    }
+    std::vector<uint8_t> frame(frameBytes, 2);
+    for (size_t i = 0; i < CAPTURE_FRAMES / 10; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fwrite(frame.data(), 1, frame.size(), file);
+        fflush(file);
+        auto end = std::chrono::steady_clock::now();
+        latency.ns.add((double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        if ((i + 1) % 4096 == 0) {
+            rewind(file);                   // Stay a ring, like the recorder file
+        }
+    }
+    fclose(file);
+    remove(path);
+    return latency;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static void print_result(const Options& options, const Result& r) {
+    const voice_recorder_stats_t& s = r.stats;
+    double hours = options.hours;
+    printf("%6u %8.1f %8.1f %6.3f %7.1f%% %7.0f %9.1f %5u %7.0f %6u %5u/%-5u\n", r.frameBytes,
+           s.voice_bytes / 1e6, s.flash_bytes / 1e6, s.voice_bytes ? (double)s.flash_bytes / s.voice_bytes : 0.0,
+           s.blocks_written ? 100.0 * s.padded_flushes / s.blocks_written : 0.0, s.blocks_written / hours,
+           s.blocks_written * 24.0 / hours / options.blocks, r.heldTransmissions, r.heldS, r.lostFrames,
+           r.checked - r.mismatched, r.checked);
+}
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<Result>& results,
+                       const std::vector<Latency>& latencies) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("hours", options.hours, 2);
+    json.add("talk_s", options.talkS);
+    json.add("idle_s", options.idleS);
+    json.add("blocks", options.blocks);
+    json.add("restarts", options.restarts);
+    json.beginArray("results");
+    for (const Result& r : results) {
+        const voice_recorder_stats_t& s = r.stats;
+        json.beginObject();
+        json.add("frame_bytes", r.frameBytes);
+        json.add("voice_bytes", s.voice_bytes);
+        json.add("flash_bytes", s.flash_bytes);
+        json.add("write_amplification", s.voice_bytes ? (double)s.flash_bytes / s.voice_bytes : 0.0, 4);
+        json.add("blocks_written", s.blocks_written);
+        json.add("padded_flushes", s.padded_flushes);
+        json.add("held_transmissions", r.heldTransmissions);
+        json.add("held_s", r.heldS);
+        json.add("lost_frames", r.lostFrames);
+        json.add("replays_checked", r.checked);
+        json.add("replays_mismatched", r.mismatched);
+        json.endObject();
+    }
+    json.endArray();
+    json.beginArray("capture");
+    for (const Latency& l : latencies) {
+        json.beginObject();
+        json.add("name", l.name);
+        json.add("p50_ns", l.ns.pct(0.5), 0);
+        json.add("p99_ns", l.ns.pct(0.99), 0);
+        json.add("max_ns", l.ns.max(), 0);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    SimArgs args;
+    args.add("--hours", "H", &options.hours);
+    args.add("--frame-bytes", "N[,N...]",
+             [&options](const char* text) { return SimArgs::parseList(text, &options.frameBytes); });
+    args.add("--talk-s", "S", &options.talkS);
+    args.add("--idle-s", "S", &options.idleS);
+    args.add("--blocks", "N", &options.blocks);
+    args.add("--restarts", "N", &options.restarts);
+    args.add("--seed", "N", &options.seed);
+    args.add("--json", "FILE", &options.jsonPath);
+    if (!args.parse(argc, argv)) {
+        return SIM_EXIT_USAGE;
+    }
+    bool framesValid = !options.frameBytes.empty();
+    for (uint32_t bytes : options.frameBytes) {
+        framesValid = framesValid && bytes > 0 && bytes <= VOICE_RECORDER_MAX_FRAME;
+    }
+    if (!args.check(options.hours > 0 && framesValid && options.talkS > 0 && options.idleS >= 0 &&
+                    options.blocks >= 2)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    std::vector<Result> results;
+    for (uint32_t bytes : options.frameBytes) {
+        results.push_back(run(options, bytes));
+    }
+    printf("%.1f h, talk %.0f s / idle %.0f s, %u KB ring, %u restarts\n\n", options.hours, options.talkS,
+           options.idleS, options.blocks * VOICE_RECORDER_BLOCK_SIZE / 1024, options.restarts);
+    printf("%6s %8s %8s %6s %8s %7s %9s %5s %7s %6s %11s\n", "frame", "voiceMB", "flashMB", "WA", "padded",
+           "blk/h", "cycles/d", "held", "held-s", "lost", "replay-ok");
+    bool replaysOk = true;
+    for (const Result& r : results) {
+        print_result(options, r);
+        replaysOk = replaysOk && r.mismatched == 0;
+    }
+    printf("\nWA: flash bytes per voice byte; cycles/d: rewrites of each ring block per day\n\n");
+
+    std::vector<Latency> latencies;
+    for (uint32_t bytes : options.frameBytes) {
+        uint32_t dropped = 0;
+        latencies.push_back(measure_ring(bytes, &dropped));
+        latencies.push_back(measure_file(bytes));
+    }
+    printf("%-24s %8s %8s %10s\n", "audio task cost", "p50 ns", "p99 ns", "max ns");
+    for (const Latency& l : latencies) {
+        printf("%-24s %8.0f %8.0f %10.0f\n", l.name.c_str(), l.ns.pct(0.5), l.ns.pct(0.99),
+               l.ns.max());
+    }
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, results, latencies)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return replaysOk ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file spi_master.h
+ * @brief ESP-IDF SPI master driver for the host build
+ *
+ * Queued transactions wait on the bus until the host completes them with
+ * host_spi_complete_next(), so a simulator decides how long each one takes.
+ * Completing a transaction clocks it through the device model attached
+ * with host_spi_attach() (without one, MOSI is looped back to MISO), then
+ * runs the device's post-transaction callback in the caller's context, as
+ * the SPI interrupt would. spi_device_get_trans_result() with a timeout
+ * completes the head transaction itself rather than wait.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_DRIVER_SPI_MASTER_H
+#define AIRCOM_HOST_DRIVER_SPI_MASTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SPI1_HOST = 0,
+    SPI2_HOST = 1,
+    SPI3_HOST = 2,
+    SPI_HOST_MAX,
+} spi_host_device_t;
+
+typedef enum {
+    SPI_DMA_DISABLED = 0,
+    SPI_DMA_CH1 = 1,
+    SPI_DMA_CH2 = 2,
+    SPI_DMA_CH_AUTO = 3,
+} spi_dma_chan_t;
+
+typedef struct spi_transaction_t spi_transaction_t;
+typedef void (*transaction_cb_t)(spi_transaction_t* trans);
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+    uint32_t flags;
+    int intr_flags;
+} spi_bus_config_t;
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    int clock_speed_hz;
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+    transaction_cb_t pre_cb;
+    transaction_cb_t post_cb;
+} spi_device_interface_config_t;
+
+struct spi_transaction_t {
+    uint32_t flags;
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length;                  ///< Total length in bits
+    size_t rxlength;                ///< Bits to receive; 0 means length
+    void* user;
+    const void* tx_buffer;
+    void* rx_buffer;
+};
+
+typedef struct spi_device_t* spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t* bus_config,
+                             spi_dma_chan_t dma_chan);
+esp_err_t spi_bus_free(spi_host_device_t host_id);
+esp_err_t spi_bus_add_device(spi_host_device_t host_id, const spi_device_interface_config_t* dev_config,
+                             spi_device_handle_t* handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* trans_desc,
+                                 TickType_t ticks_to_wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** trans_desc,
+                                      TickType_t ticks_to_wait);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc);
+
+/**
+ * @brief Host only: model of the device on a bus. Called once per completed
+ *        transaction to shift its bytes: read trans->tx_buffer, fill
+ *        trans->rx_buffer.
+ */
+typedef void (*host_spi_device_model_t)(void* context, spi_transaction_t* trans);
+
+/**
+ * @brief Host only: attach a device model to a bus; nullptr restores the loopback
+ */
+void host_spi_attach(spi_host_device_t host_id, host_spi_device_model_t model, void* context);
+
+/**
+ * @brief Host only: the transaction at the head of a bus queue
+ * @param bits          Set to its length in bits
+ * @param clock_speed_hz Set to its device's clock
+ * @return false if nothing is queued
+ */
+bool host_spi_peek(spi_host_device_t host_id, size_t* bits, int* clock_speed_hz);
+
+/**
+ * @brief Host only: finish the transaction at the head of a bus queue
+ * @return false if nothing is queued
+ */
+bool host_spi_complete_next(spi_host_device_t host_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_DRIVER_SPI_MASTER_H
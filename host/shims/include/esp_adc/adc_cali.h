@@ -0,0 +1,29 @@
+/**
+ * @file adc_cali.h
+ * @brief ESP-IDF ADC calibration for the host build
+ *
+ * No calibration scheme is available (adc_cali_scheme.h defines none).
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ADC_CALI_H
+#define AIRCOM_HOST_ADC_CALI_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct adc_cali_scheme_t* adc_cali_handle_t;
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int* voltage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_ADC_CALI_H
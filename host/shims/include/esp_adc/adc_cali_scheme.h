@@ -0,0 +1,19 @@
+/**
+ * @file adc_cali_scheme.h
+ * @brief ESP-IDF ADC calibration schemes for the host build: none
+ *
+ * Neither ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED nor
+ * ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED is defined.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ADC_CALI_SCHEME_H
+#define AIRCOM_HOST_ADC_CALI_SCHEME_H
+
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_oneshot.h"
+
+#endif // AIRCOM_HOST_ADC_CALI_SCHEME_H
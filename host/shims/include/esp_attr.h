@@ -0,0 +1,22 @@
+/**
+ * @file esp_attr.h
+ * @brief ESP-IDF placement attributes for the host build
+ *
+ * Code and data placement means nothing on a workstation; the attributes
+ * expand to nothing.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ESP_ATTR_H
+#define AIRCOM_HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_BSS_ATTR
+
+#endif // AIRCOM_HOST_ESP_ATTR_H
@@ -0,0 +1,46 @@
+/**
+ * @file esp_chip_info.h
+ * @brief ESP-IDF chip information for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ESP_CHIP_INFO_H
+#define AIRCOM_HOST_ESP_CHIP_INFO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CHIP_ESP32 = 1,
+    CHIP_ESP32S2 = 2,
+    CHIP_ESP32S3 = 9,
+    CHIP_ESP32C3 = 5,
+    CHIP_ESP32C2 = 12,
+    CHIP_ESP32C6 = 13,
+    CHIP_ESP32H2 = 16,
+    CHIP_POSIX_LINUX = 999
+} esp_chip_model_t;
+
+typedef struct {
+    esp_chip_model_t model;
+    uint32_t features;
+    uint16_t revision;
+    uint8_t cores;
+} esp_chip_info_t;
+
+/**
+ * @brief Reports CHIP_POSIX_LINUX with one core
+ */
+void esp_chip_info(esp_chip_info_t* out_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_ESP_CHIP_INFO_H
@@ -0,0 +1,78 @@
+/**
+ * @file esp_log.h
+ * @brief ESP-IDF logging macros for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ESP_LOG_H
+#define AIRCOM_HOST_ESP_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+/**
+ * @brief Milliseconds since start, as printed in every log line
+ */
+uint32_t esp_log_timestamp(void);
+
+/**
+ * @brief Set the log level for a tag ("*" for all); default ESP_LOG_INFO,
+ *        or the AIRCOM_HOST_LOG_LEVEL environment variable (0-5)
+ */
+void esp_log_level_set(const char* tag, esp_log_level_t level);
+
+/**
+ * @brief Whether a message at this level is printed
+ */
+int esp_log_enabled(esp_log_level_t level);
+
+void esp_log_buffer_hexdump(const char* tag, const void* buffer, uint16_t length, esp_log_level_t level);
+
+#define AIRCOM_HOST_LOG(level, letter, tag, format, ...) do {                           \
+        if (esp_log_enabled(level)) {                                                   \
+            printf(letter " (%u) %s: " format "\n", (unsigned)esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        }                                                                               \
+    } while (0)
+
+// logging_system.h routes these through LOG_ERROR etc.; keep its
+// definitions when it was included first
+#ifndef ESP_LOGE
+#define ESP_LOGE(tag, format, ...) AIRCOM_HOST_LOG(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#endif
+#ifndef ESP_LOGW
+#define ESP_LOGW(tag, format, ...) AIRCOM_HOST_LOG(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#endif
+#ifndef ESP_LOGI
+#define ESP_LOGI(tag, format, ...) AIRCOM_HOST_LOG(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#endif
+#ifndef ESP_LOGD
+#define ESP_LOGD(tag, format, ...) AIRCOM_HOST_LOG(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#endif
+#ifndef ESP_LOGV
+#define ESP_LOGV(tag, format, ...) AIRCOM_HOST_LOG(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+#endif
+
+#define ESP_LOG_BUFFER_HEXDUMP(tag, buffer, length, level) \
+    esp_log_buffer_hexdump(tag, buffer, length, level)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_ESP_LOG_H
@@ -0,0 +1,29 @@
+/**
+ * @file esp_mac.h
+ * @brief ESP-IDF MAC address API for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ESP_MAC_H
+#define AIRCOM_HOST_ESP_MAC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fixed locally administered MAC, or AIRCOM_HOST_MAC (aa:bb:cc:dd:ee:ff)
+ */
+esp_err_t esp_efuse_mac_get_default(uint8_t* mac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_ESP_MAC_H
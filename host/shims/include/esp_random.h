@@ -0,0 +1,27 @@
+/**
+ * @file esp_random.h
+ * @brief ESP-IDF random number API for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ESP_RANDOM_H
+#define AIRCOM_HOST_ESP_RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_random(void);
+void esp_fill_random(void* buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_ESP_RANDOM_H
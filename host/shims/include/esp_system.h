@@ -0,0 +1,38 @@
+/**
+ * @file esp_system.h
+ * @brief ESP-IDF system API for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ESP_SYSTEM_H
+#define AIRCOM_HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Heap figures are those of a 320 KB ESP32-S3 internal heap, minus
+ *        what the host process has allocated through malloc
+ */
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+/**
+ * @brief Exits the host process
+ */
+void esp_restart(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_ESP_SYSTEM_H
@@ -0,0 +1,39 @@
+/**
+ * @file esp_timer.h
+ * @brief ESP-IDF high resolution timer for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_ESP_TIMER_H
+#define AIRCOM_HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds since start (monotonic clock)
+ */
+int64_t esp_timer_get_time(void);
+
+/**
+ * @brief Host only: run esp_timer_get_time() on a virtual clock, set to
+ *        now_us, that stands still until host_timer_advance() moves it
+ */
+void host_timer_set_virtual(int64_t now_us);
+
+/**
+ * @brief Host only: move the virtual clock forward
+ */
+void host_timer_advance(int64_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_ESP_TIMER_H
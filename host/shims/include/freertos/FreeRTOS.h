@@ -0,0 +1,69 @@
+/**
+ * @file FreeRTOS.h
+ * @brief ESP-IDF style <freertos/FreeRTOS.h> for the host build
+ *
+ * Includes the upstream kernel header and adds the ESP-IDF extensions the
+ * firmware uses: portMUX spinlocks (critical sections take a mux argument),
+ * core IDs, portNUM_PROCESSORS, portYIELD_FROM_ISR() without an argument
+ * and the placement attributes of esp_attr.h. The host runs a single core.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_FREERTOS_H
+#define AIRCOM_HOST_FREERTOS_H
+
+#include <FreeRTOS.h>
+#include "esp_attr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef portNUM_PROCESSORS
+#define portNUM_PROCESSORS 1
+#endif
+
+#ifndef tskNO_AFFINITY
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+#endif
+
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+// ESP-IDF critical sections name a spinlock; the POSIX port has one global
+// critical section, which is all a single core needs
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+
+#undef portENTER_CRITICAL
+#undef portEXIT_CRITICAL
+#define portENTER_CRITICAL(mux) vPortEnterCritical()
+#define portEXIT_CRITICAL(mux) vPortExitCritical()
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical()
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical()
+
+// ESP-IDF ISRs yield after deciding a switch is needed; "ISRs" on the host
+// are callbacks run from a task, which can simply yield
+#undef portYIELD_FROM_ISR
+#define portYIELD_FROM_ISR(...) portYIELD()
+
+static inline BaseType_t xPortGetCoreID(void) {
+    return 0;
+}
+
+#ifndef pdTICKS_TO_MS
+#define pdTICKS_TO_MS(xTicks) ((TickType_t)(((uint64_t)(xTicks) * 1000U) / configTICK_RATE_HZ))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_FREERTOS_H
@@ -0,0 +1,16 @@
+/**
+ * @file event_groups.h
+ * @brief ESP-IDF style <freertos/event_groups.h> for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_FREERTOS_EVENT_GROUPS_H
+#define AIRCOM_HOST_FREERTOS_EVENT_GROUPS_H
+
+#include "freertos/task.h"
+#include <event_groups.h>
+
+#endif // AIRCOM_HOST_FREERTOS_EVENT_GROUPS_H
@@ -0,0 +1,16 @@
+/**
+ * @file queue.h
+ * @brief ESP-IDF style <freertos/queue.h> for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_FREERTOS_QUEUE_H
+#define AIRCOM_HOST_FREERTOS_QUEUE_H
+
+#include "freertos/task.h"
+#include <queue.h>
+
+#endif // AIRCOM_HOST_FREERTOS_QUEUE_H
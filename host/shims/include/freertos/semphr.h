@@ -0,0 +1,16 @@
+/**
+ * @file semphr.h
+ * @brief ESP-IDF style <freertos/semphr.h> for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_FREERTOS_SEMPHR_H
+#define AIRCOM_HOST_FREERTOS_SEMPHR_H
+
+#include "freertos/task.h"
+#include <semphr.h>
+
+#endif // AIRCOM_HOST_FREERTOS_SEMPHR_H
@@ -0,0 +1,41 @@
+/**
+ * @file task.h
+ * @brief ESP-IDF style <freertos/task.h> for the host build
+ *
+ * Adds xTaskCreatePinnedToCore() and the mux-taking task critical section
+ * macros. Stack sizes are passed through unchanged: ESP-IDF counts bytes,
+ * the POSIX port counts words, so host tasks get larger stacks.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_FREERTOS_TASK_H
+#define AIRCOM_HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+#include <task.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#undef taskENTER_CRITICAL
+#undef taskEXIT_CRITICAL
+#define taskENTER_CRITICAL(mux) vPortEnterCritical()
+#define taskEXIT_CRITICAL(mux) vPortExitCritical()
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode, const char* pcName,
+                                                 uint32_t usStackDepth, void* pvParameters,
+                                                 UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask,
+                                                 BaseType_t xCoreID) {
+    (void)xCoreID;
+    return xTaskCreate(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_FREERTOS_TASK_H
@@ -0,0 +1,16 @@
+/**
+ * @file timers.h
+ * @brief ESP-IDF style <freertos/timers.h> for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_FREERTOS_TIMERS_H
+#define AIRCOM_HOST_FREERTOS_TIMERS_H
+
+#include "freertos/task.h"
+#include <timers.h>
+
+#endif // AIRCOM_HOST_FREERTOS_TIMERS_H
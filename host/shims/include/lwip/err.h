@@ -0,0 +1,19 @@
+/**
+ * @file err.h
+ * @brief lwIP error type for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_LWIP_ERR_H
+#define AIRCOM_HOST_LWIP_ERR_H
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+
+#endif // AIRCOM_HOST_LWIP_ERR_H
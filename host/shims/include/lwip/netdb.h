@@ -0,0 +1,15 @@
+/**
+ * @file netdb.h
+ * @brief lwIP name resolution for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_LWIP_NETDB_H
+#define AIRCOM_HOST_LWIP_NETDB_H
+
+#include <netdb.h>
+
+#endif // AIRCOM_HOST_LWIP_NETDB_H
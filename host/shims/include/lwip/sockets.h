@@ -0,0 +1,22 @@
+/**
+ * @file sockets.h
+ * @brief lwIP sockets for the host build: the BSD socket API of the host
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_LWIP_SOCKETS_H
+#define AIRCOM_HOST_LWIP_SOCKETS_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#endif // AIRCOM_HOST_LWIP_SOCKETS_H
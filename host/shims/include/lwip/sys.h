@@ -0,0 +1,13 @@
+/**
+ * @file sys.h
+ * @brief lwIP system layer for the host build (nothing needed)
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_LWIP_SYS_H
+#define AIRCOM_HOST_LWIP_SYS_H
+
+#endif // AIRCOM_HOST_LWIP_SYS_H
@@ -0,0 +1,41 @@
+/**
+ * @file sha256.h
+ * @brief Mbed TLS SHA-256 API for the host build
+ *
+ * Covers the streaming calls the firmware uses (Mbed TLS 3 signatures, as
+ * in ESP-IDF 5).
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_MBEDTLS_SHA256_H
+#define AIRCOM_HOST_MBEDTLS_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t total;                 // Bytes hashed so far
+    unsigned char buffer[64];
+    int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char* output);
+int mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char* output, int is224);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_MBEDTLS_SHA256_H
@@ -0,0 +1,30 @@
+/**
+ * @file nvs_flash.h
+ * @brief ESP-IDF NVS flash initialization for the host build
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AIRCOM_HOST_NVS_FLASH_H
+#define AIRCOM_HOST_NVS_FLASH_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+
+/**
+ * @brief Clears the in-memory store
+ */
+esp_err_t nvs_flash_erase(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRCOM_HOST_NVS_FLASH_H
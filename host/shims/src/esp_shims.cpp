@@ -0,0 +1,1031 @@
+/**
+ * @file esp_shims.cpp
+ * @brief ESP-IDF API implementations for the host build
+ *
+ * Just enough of ESP-IDF for the firmware modules to run on a workstation:
+ * logging to stdout, a monotonic esp_timer (or a virtual one the host
+ * advances), a simulated 320 KB heap budget, an in-memory NVS, a UART that
+ * replays bytes fed by the host, an SPI master whose transactions the host
+ * completes, GPIO inputs the host drives, power management calls that are
+ * recorded but change nothing and an ADC with no channels.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_chip_info.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "driver/uart.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_pm.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "freertos/task.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// ERRORS AND LOGGING
+// ============================================================================
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_NO_FREE_PAGES: return "ESP_ERR_NVS_NO_FREE_PAGES";
+        case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+        default: return "UNKNOWN_ERROR";
+    }
+}
+
+static const std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+
+static int initial_log_level() {
+    const char* env = getenv("AIRCOM_HOST_LOG_LEVEL");
+    if (env && env[0] >= '0' && env[0] <= '5') {
+        return env[0] - '0';
+    }
+    return ESP_LOG_INFO;
+}
+
+static std::atomic<int> s_log_level(initial_log_level());
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    // Per-tag levels are not kept; any tag sets the global level
+    (void)tag;
+    s_log_level.store(level, std::memory_order_relaxed);
+}
+
+int esp_log_enabled(esp_log_level_t level) {
+    return level <= s_log_level.load(std::memory_order_relaxed);
+}
+
+void esp_log_buffer_hexdump(const char* tag, const void* buffer, uint16_t length, esp_log_level_t level) {
+    if (!esp_log_enabled(level) || !buffer) {
+        return;
+    }
+    const uint8_t* bytes = (const uint8_t*)buffer;
+    for (uint16_t offset = 0; offset < length; offset += 16) {
+        char line[16 * 3 + 1] = {0};
+        for (uint16_t i = 0; i < 16 && offset + i < length; i++) {
+            snprintf(line + i * 3, 4, "%02x ", bytes[offset + i]);
+        }
+        printf("%s: 0x%04x   %s\n", tag, offset, line);
+    }
+}
+
+// ============================================================================
+// TIMER, SYSTEM AND HEAP
+// ============================================================================
+
+// Negative while esp_timer follows the monotonic clock
+static std::atomic<int64_t> s_virtualUs(-1);
+
+int64_t esp_timer_get_time(void) {
+    int64_t virtual_us = s_virtualUs.load(std::memory_order_acquire);
+    if (virtual_us >= 0) {
+        return virtual_us;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - s_start).count();
+}
+
+void host_timer_set_virtual(int64_t now_us) {
+    s_virtualUs.store(now_us < 0 ? 0 : now_us, std::memory_order_release);
+}
+
+void host_timer_advance(int64_t us) {
+    if (us > 0) {
+        s_virtualUs.fetch_add(us, std::memory_order_acq_rel);
+    }
+}
+
+// Simulated internal heap of an ESP32-S3; heap_caps_* allocations count against it
+static const size_t HOST_HEAP_SIZE = 320 * 1024;
+static std::atomic<size_t> s_heap_used(0);
+static std::atomic<size_t> s_heap_peak(0);
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    (void)caps;
+    // The size is stored in front of the block so heap_caps_free() can account for it
+    size_t* block = (size_t*)malloc(sizeof(size_t) * 2 + size);
+    if (!block) {
+        return NULL;
+    }
+    block[0] = size;
+    size_t used = s_heap_used.fetch_add(size) + size;
+    size_t peak = s_heap_peak.load();
+    while (used > peak && !s_heap_peak.compare_exchange_weak(peak, used)) {
+    }
+    return block + 2;
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_malloc(n * size, caps);
+    if (ptr) {
+        memset(ptr, 0, n * size);
+    }
+    return ptr;
+}
+
+void heap_caps_free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    size_t* block = (size_t*)ptr - 2;
+    s_heap_used.fetch_sub(block[0]);
+    free(block);
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+    (void)caps;
+    return HOST_HEAP_SIZE;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    (void)caps;
+    size_t used = s_heap_used.load();
+    return used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    (void)caps;
+    size_t peak = s_heap_peak.load();
+    return peak < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - peak : 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return (uint32_t)heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+}
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart() called, exiting\n");
+    exit(0);
+}
+
+static std::mutex s_random_mutex;
+static std::mt19937 s_random(std::random_device{}());
+
+uint32_t esp_random(void) {
+    std::lock_guard<std::mutex> lock(s_random_mutex);
+    return (uint32_t)s_random();
+}
+
+void esp_fill_random(void* buf, size_t len) {
+    uint8_t* bytes = (uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) {
+        bytes[i] = (uint8_t)esp_random();
+    }
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t* mac) {
+    if (!mac) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    static const uint8_t default_mac[6] = {0x02, 0x00, 0x00, 0xA1, 0xC0, 0x01};
+    memcpy(mac, default_mac, sizeof(default_mac));
+
+    unsigned values[6];
+    const char* env = getenv("AIRCOM_HOST_MAC");
+    if (env && sscanf(env, "%x:%x:%x:%x:%x:%x", &values[0], &values[1], &values[2],
+                      &values[3], &values[4], &values[5]) == 6) {
+        for (int i = 0; i < 6; i++) {
+            mac[i] = (uint8_t)values[i];
+        }
+    }
+    return ESP_OK;
+}
+
+void esp_chip_info(esp_chip_info_t* out_info) {
+    if (!out_info) {
+        return;
+    }
+    memset(out_info, 0, sizeof(*out_info));
+    out_info->model = CHIP_POSIX_LINUX;
+    out_info->cores = 1;
+}
+
+// ============================================================================
+// NVS (in memory)
+// ============================================================================
+
+namespace {
+
+struct NvsStore {
+    std::mutex mutex;
+    bool initialized = false;
+    // namespace -> key -> raw value
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> data;
+    std::map<nvs_handle_t, std::pair<std::string, nvs_open_mode_t>> handles;
+    nvs_handle_t next_handle = 1;
+};
+
+NvsStore& nvs_store() {
+    static NvsStore store;
+    return store;
+}
+
+// Looks up the namespace of an open handle; store mutex must be held
+std::map<std::string, std::vector<uint8_t>>* nvs_namespace(NvsStore& store, nvs_handle_t handle,
+                                                            bool write, esp_err_t* error) {
+    auto it = store.handles.find(handle);
+    if (it == store.handles.end()) {
+        *error = ESP_ERR_NVS_INVALID_HANDLE;
+        return NULL;
+    }
+    if (write && it->second.second == NVS_READONLY) {
+        *error = ESP_ERR_INVALID_STATE;
+        return NULL;
+    }
+    *error = ESP_OK;
+    return &store.data[it->second.first];
+}
+
+esp_err_t nvs_set_raw(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    if (!key || (!value && length)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    esp_err_t error;
+    auto* entries = nvs_namespace(store, handle, true, &error);
+    if (!entries) {
+        return error;
+    }
+    const uint8_t* bytes = (const uint8_t*)value;
+    (*entries)[key] = std::vector<uint8_t>(bytes, bytes + length);
+    return ESP_OK;
+}
+
+// Copies a fixed-size value, or a variable one when exact_length is false
+esp_err_t nvs_get_raw(nvs_handle_t handle, const char* key, void* out_value, size_t* length, bool exact_length) {
+    if (!key || !length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    esp_err_t error;
+    auto* entries = nvs_namespace(store, handle, false, &error);
+    if (!entries) {
+        return error;
+    }
+    auto it = entries->find(key);
+    if (it == entries->end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    const std::vector<uint8_t>& stored = it->second;
+    if (exact_length && stored.size() != *length) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    if (!out_value) {
+        *length = stored.size();
+        return ESP_OK;
+    }
+    if (*length < stored.size()) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, stored.data(), stored.size());
+    *length = stored.size();
+    return ESP_OK;
+}
+
+template <typename T>
+esp_err_t nvs_get_value(nvs_handle_t handle, const char* key, T* out_value) {
+    if (!out_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t length = sizeof(T);
+    return nvs_get_raw(handle, key, out_value, &length, true);
+}
+
+} // namespace
+
+esp_err_t nvs_flash_init(void) {
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    store.initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    store.data.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if (!name || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    if (!store.initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (open_mode == NVS_READONLY && store.data.find(name) == store.data.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    nvs_handle_t handle = store.next_handle++;
+    store.handles[handle] = std::make_pair(std::string(name), open_mode);
+    *out_handle = handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    store.handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    return store.handles.count(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    esp_err_t error;
+    auto* entries = nvs_namespace(store, handle, true, &error);
+    if (!entries) {
+        return error;
+    }
+    return entries->erase(key ? key : "") ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    NvsStore& store = nvs_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    esp_err_t error;
+    auto* entries = nvs_namespace(store, handle, true, &error);
+    if (!entries) {
+        return error;
+    }
+    entries->clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return nvs_set_raw(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    return nvs_get_value(handle, key, out_value);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    return nvs_set_raw(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    return nvs_get_value(handle, key, out_value);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return nvs_set_raw(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value) {
+    return nvs_get_value(handle, key, out_value);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    if (!value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return nvs_set_raw(handle, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    return nvs_get_raw(handle, key, out_value, length, false);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    return nvs_set_raw(handle, key, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    return nvs_get_raw(handle, key, out_value, length, false);
+}
+
+// ============================================================================
+// UART
+// ============================================================================
+
+namespace {
+
+struct HostUart {
+    std::mutex mutex;
+    std::deque<uint8_t> rx[UART_NUM_MAX];
+};
+
+HostUart& host_uart() {
+    static HostUart uart;
+    return uart;
+}
+
+} // namespace
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, QueueHandle_t* uart_queue, int intr_alloc_flags) {
+    (void)rx_buffer_size;
+    (void)tx_buffer_size;
+    (void)queue_size;
+    (void)uart_queue;
+    (void)intr_alloc_flags;
+    return uart_num >= 0 && uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t* uart_config) {
+    return uart_num >= 0 && uart_num < UART_NUM_MAX && uart_config ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num) {
+    (void)tx_io_num;
+    (void)rx_io_num;
+    (void)rts_io_num;
+    (void)cts_io_num;
+    return uart_num >= 0 && uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void host_uart_feed(uart_port_t uart_num, const void* data, size_t size) {
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX || !data) {
+        return;
+    }
+    HostUart& uart = host_uart();
+    std::lock_guard<std::mutex> lock(uart.mutex);
+    const uint8_t* bytes = (const uint8_t*)data;
+    uart.rx[uart_num].insert(uart.rx[uart_num].end(), bytes, bytes + size);
+}
+
+static int uart_take(uart_port_t uart_num, uint8_t* buf, uint32_t length) {
+    HostUart& uart = host_uart();
+    std::lock_guard<std::mutex> lock(uart.mutex);
+    std::deque<uint8_t>& rx = uart.rx[uart_num];
+    uint32_t count = 0;
+    while (count < length && !rx.empty()) {
+        buf[count++] = rx.front();
+        rx.pop_front();
+    }
+    return (int)count;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void* buf, uint32_t length, TickType_t ticks_to_wait) {
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX || !buf) {
+        return -1;
+    }
+    int count = uart_take(uart_num, (uint8_t*)buf, length);
+    if (count == 0 && ticks_to_wait > 0) {
+        // Nothing queued: block like the driver would, then try once more
+        vTaskDelay(ticks_to_wait);
+        count = uart_take(uart_num, (uint8_t*)buf, length);
+    }
+    return count;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void* src, size_t size) {
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX || !src) {
+        return -1;
+    }
+    return (int)size;
+}
+
+// ============================================================================
+// SPI MASTER AND GPIO
+// ============================================================================
+
+struct spi_device_t {
+    spi_host_device_t host;
+    spi_device_interface_config_t config;
+    std::deque<spi_transaction_t*> done;
+};
+
+namespace {
+
+struct HostSpiBus {
+    bool initialized = false;
+    host_spi_device_model_t model = nullptr;
+    void* context = nullptr;
+    std::vector<spi_device_t*> devices;
+    std::deque<std::pair<spi_device_t*, spi_transaction_t*>> queued;
+};
+
+struct HostSpi {
+    std::mutex mutex;
+    HostSpiBus bus[SPI_HOST_MAX];
+};
+
+HostSpi& host_spi() {
+    static HostSpi spi;
+    return spi;
+}
+
+// Without a device model the bus is wired MOSI to MISO
+void spi_loopback(spi_transaction_t* trans) {
+    if (!trans->rx_buffer) {
+        return;
+    }
+    size_t rx_bits = trans->rxlength > 0 ? trans->rxlength : trans->length;
+    size_t bytes = (std::min(rx_bits, trans->length) + 7) / 8;
+    if (trans->tx_buffer) {
+        memcpy(trans->rx_buffer, trans->tx_buffer, bytes);
+    } else {
+        memset(trans->rx_buffer, 0xFF, bytes);
+    }
+}
+
+bool spi_host_valid(spi_host_device_t host_id) {
+    return host_id >= SPI1_HOST && host_id < SPI_HOST_MAX;
+}
+
+} // namespace
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t* bus_config,
+                             spi_dma_chan_t dma_chan) {
+    (void)dma_chan;
+    if (!spi_host_valid(host_id) || !bus_config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostSpi& spi = host_spi();
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    if (spi.bus[host_id].initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    spi.bus[host_id].initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host_id) {
+    if (!spi_host_valid(host_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostSpi& spi = host_spi();
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    HostSpiBus& bus = spi.bus[host_id];
+    if (!bus.initialized || !bus.devices.empty()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    bus.initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host_id, const spi_device_interface_config_t* dev_config,
+                             spi_device_handle_t* handle) {
+    if (!spi_host_valid(host_id) || !dev_config || !handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostSpi& spi = host_spi();
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    HostSpiBus& bus = spi.bus[host_id];
+    if (!bus.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    spi_device_t* device = new spi_device_t();
+    device->host = host_id;
+    device->config = *dev_config;
+    bus.devices.push_back(device);
+    *handle = device;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostSpi& spi = host_spi();
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    HostSpiBus& bus = spi.bus[handle->host];
+    for (const auto& entry : bus.queued) {
+        if (entry.first == handle) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    bus.devices.erase(std::remove(bus.devices.begin(), bus.devices.end(), handle), bus.devices.end());
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* trans_desc,
+                                 TickType_t ticks_to_wait) {
+    (void)ticks_to_wait;
+    if (!handle || !trans_desc || trans_desc->length == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostSpi& spi = host_spi();
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    HostSpiBus& bus = spi.bus[handle->host];
+    size_t in_flight = handle->done.size();
+    for (const auto& entry : bus.queued) {
+        in_flight += entry.first == handle ? 1 : 0;
+    }
+    if ((int)in_flight >= handle->config.queue_size) {
+        return ESP_ERR_TIMEOUT;
+    }
+    bus.queued.push_back(std::make_pair(handle, trans_desc));
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** trans_desc,
+                                      TickType_t ticks_to_wait) {
+    if (!handle || !trans_desc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostSpi& spi = host_spi();
+    bool complete = false;
+    {
+        std::lock_guard<std::mutex> lock(spi.mutex);
+        if (handle->done.empty()) {
+            const auto& queued = spi.bus[handle->host].queued;
+            complete = ticks_to_wait > 0 && !queued.empty() && queued.front().first == handle;
+            if (!complete) {
+                return ESP_ERR_TIMEOUT;
+            }
+        }
+    }
+    // Waiting for a result finishes the transfer on the bus
+    if (complete) {
+        host_spi_complete_next(handle->host);
+    }
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    if (handle->done.empty()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *trans_desc = handle->done.front();
+    handle->done.pop_front();
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc) {
+    esp_err_t ret = spi_device_queue_trans(handle, trans_desc, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    spi_transaction_t* done = nullptr;
+    do {
+        ret = spi_device_get_trans_result(handle, &done, portMAX_DELAY);
+    } while (ret == ESP_OK && done != trans_desc);
+    return ret;
+}
+
+void host_spi_attach(spi_host_device_t host_id, host_spi_device_model_t model, void* context) {
+    if (!spi_host_valid(host_id)) {
+        return;
+    }
+    HostSpi& spi = host_spi();
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    spi.bus[host_id].model = model;
+    spi.bus[host_id].context = model ? context : nullptr;
+}
+
+bool host_spi_peek(spi_host_device_t host_id, size_t* bits, int* clock_speed_hz) {
+    if (!spi_host_valid(host_id)) {
+        return false;
+    }
+    HostSpi& spi = host_spi();
+    std::lock_guard<std::mutex> lock(spi.mutex);
+    const HostSpiBus& bus = spi.bus[host_id];
+    if (bus.queued.empty()) {
+        return false;
+    }
+    if (bits) {
+        *bits = bus.queued.front().second->length;
+    }
+    if (clock_speed_hz) {
+        *clock_speed_hz = bus.queued.front().first->config.clock_speed_hz;
+    }
+    return true;
+}
+
+bool host_spi_complete_next(spi_host_device_t host_id) {
+    if (!spi_host_valid(host_id)) {
+        return false;
+    }
+    HostSpi& spi = host_spi();
+    spi_device_t* device;
+    spi_transaction_t* trans;
+    host_spi_device_model_t model;
+    void* context;
+    {
+        std::lock_guard<std::mutex> lock(spi.mutex);
+        HostSpiBus& bus = spi.bus[host_id];
+        if (bus.queued.empty()) {
+            return false;
+        }
+        device = bus.queued.front().first;
+        trans = bus.queued.front().second;
+        bus.queued.pop_front();
+        model = bus.model;
+        context = bus.context;
+    }
+
+    // The device model and the callback may queue more transactions
+    if (model) {
+        model(context, trans);
+    } else {
+        spi_loopback(trans);
+    }
+    {
+        std::lock_guard<std::mutex> lock(spi.mutex);
+        device->done.push_back(trans);
+    }
+    if (device->config.post_cb) {
+        device->config.post_cb(trans);
+    }
+    return true;
+}
+
+namespace {
+
+struct HostGpioPin {
+    int level = 1;
+    gpio_int_type_t intr = GPIO_INTR_DISABLE;
+    gpio_isr_t handler = nullptr;
+    void* arg = nullptr;
+};
+
+struct HostGpio {
+    std::mutex mutex;
+    bool isrService = false;
+    HostGpioPin pins[GPIO_NUM_MAX];
+};
+
+HostGpio& host_gpio() {
+    static HostGpio gpio;
+    return gpio;
+}
+
+bool gpio_valid(gpio_num_t gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+} // namespace
+
+esp_err_t gpio_config(const gpio_config_t* config) {
+    if (!config || config->pin_bit_mask == 0 || (config->pin_bit_mask >> GPIO_NUM_MAX) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if (config->pin_bit_mask & (1ULL << pin)) {
+            gpio.pins[pin].intr = config->intr_type;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+    if (!gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    gpio.pins[gpio_num].intr = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    (void)intr_alloc_flags;
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    if (gpio.isrService) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    gpio.isrService = true;
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void) {
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    gpio.isrService = false;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void* args) {
+    if (!gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    if (!gpio.isrService) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    gpio.pins[gpio_num].handler = isr_handler;
+    gpio.pins[gpio_num].arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    if (!gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    gpio.pins[gpio_num].handler = nullptr;
+    gpio.pins[gpio_num].arg = nullptr;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (!gpio_valid(gpio_num)) {
+        return 0;
+    }
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    return gpio.pins[gpio_num].level;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (!gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostGpio& gpio = host_gpio();
+    std::lock_guard<std::mutex> lock(gpio.mutex);
+    gpio.pins[gpio_num].level = level ? 1 : 0;
+    return ESP_OK;
+}
+
+void host_gpio_set_level(gpio_num_t gpio_num, int level) {
+    if (!gpio_valid(gpio_num)) {
+        return;
+    }
+    HostGpio& gpio = host_gpio();
+    gpio_isr_t handler = nullptr;
+    void* arg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(gpio.mutex);
+        HostGpioPin& pin = gpio.pins[gpio_num];
+        int previous = pin.level;
+        pin.level = level ? 1 : 0;
+        bool fire = false;
+        switch (pin.intr) {
+            case GPIO_INTR_POSEDGE:    fire = previous == 0 && pin.level == 1; break;
+            case GPIO_INTR_NEGEDGE:    fire = previous == 1 && pin.level == 0; break;
+            case GPIO_INTR_ANYEDGE:    fire = previous != pin.level; break;
+            case GPIO_INTR_LOW_LEVEL:  fire = pin.level == 0; break;
+            case GPIO_INTR_HIGH_LEVEL: fire = pin.level == 1; break;
+            default:                   break;
+        }
+        if (fire && gpio.isrService) {
+            handler = pin.handler;
+            arg = pin.arg;
+        }
+    }
+    if (handler) {
+        handler(arg);
+    }
+}
+
+// ============================================================================
+// POWER MANAGEMENT
+// ============================================================================
+
+struct esp_pm_lock {
+    esp_pm_lock_type_t type;
+    std::atomic<int> holders;
+};
+
+static std::mutex s_pmMutex;
+static esp_pm_config_t s_pmConfig = { 160, 160, false };
+
+esp_err_t esp_pm_configure(const void* config) {
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(s_pmMutex);
+    s_pmConfig = *static_cast<const esp_pm_config_t*>(config);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_get_configuration(void* config) {
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(s_pmMutex);
+    *static_cast<esp_pm_config_t*>(config) = s_pmConfig;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char* name, esp_pm_lock_handle_t* out_handle) {
+    (void)arg;
+    (void)name;
+    if (!out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_pm_lock* handle = new esp_pm_lock;
+    handle->type = lock_type;
+    handle->holders = 0;
+    *out_handle = handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->holders++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    if (!handle || handle->holders.load() == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->holders--;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle) {
+    if (!handle || handle->holders.load() != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    delete handle;
+    return ESP_OK;
+}
+
+// ============================================================================
+// ADC
+// ============================================================================
+
+esp_err_t adc_oneshot_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel) {
+    (void)io_num;
+    (void)unit_id;
+    (void)channel;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t* init_config, adc_oneshot_unit_handle_t* ret_unit) {
+    (void)init_config;
+    (void)ret_unit;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel,
+                                     const adc_oneshot_chan_cfg_t* config) {
+    (void)handle;
+    (void)channel;
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int* out_raw) {
+    (void)handle;
+    (void)chan;
+    (void)out_raw;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle) {
+    (void)handle;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int* voltage) {
+    (void)handle;
+    (void)raw;
+    (void)voltage;
+    return ESP_ERR_NOT_SUPPORTED;
+}
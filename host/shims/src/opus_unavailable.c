@@ -0,0 +1,91 @@
+/**
+ * @file opus_unavailable.c
+ * @brief Opus entry points for host builds without libopus
+ *
+ * The firmware links a pre-compiled Opus for the ESP32 only. On the host
+ * every constructor fails with OPUS_UNIMPLEMENTED, so audio_codec reports
+ * itself not ready, as on a board without the library. Set OPUS_LIBRARY
+ * when configuring the host build to link a real libopus instead.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "opus.h"
+#include <stddef.h>
+
+OpusEncoder* opus_encoder_create(int32_t Fs, int channels, int application, int *error) {
+    (void)Fs; (void)channels; (void)application;
+    if (error) {
+        *error = OPUS_UNIMPLEMENTED;
+    }
+    return NULL;
+}
+
+void opus_encoder_destroy(OpusEncoder *st) {
+    (void)st;
+}
+
+int32_t opus_encode(OpusEncoder *st, const int16_t *pcm, int frame_size,
+                    unsigned char *data, int32_t max_data_bytes) {
+    (void)st; (void)pcm; (void)frame_size; (void)data; (void)max_data_bytes;
+    return OPUS_UNIMPLEMENTED;
+}
+
+int opus_encoder_ctl(OpusEncoder *st, int request, ...) {
+    (void)st; (void)request;
+    return OPUS_UNIMPLEMENTED;
+}
+
+int opus_encoder_get_ctl(OpusEncoder *st, int request, ...) {
+    (void)st; (void)request;
+    return OPUS_UNIMPLEMENTED;
+}
+
+OpusDecoder* opus_decoder_create(int32_t Fs, int channels, int *error) {
+    (void)Fs; (void)channels;
+    if (error) {
+        *error = OPUS_UNIMPLEMENTED;
+    }
+    return NULL;
+}
+
+void opus_decoder_destroy(OpusDecoder *st) {
+    (void)st;
+}
+
+int opus_decode(OpusDecoder *st, const unsigned char *data, int32_t len,
+                int16_t *pcm, int frame_size, int decode_fec) {
+    (void)st; (void)data; (void)len; (void)pcm; (void)frame_size; (void)decode_fec;
+    return OPUS_UNIMPLEMENTED;
+}
+
+int opus_decoder_ctl(OpusDecoder *st, int request, ...) {
+    (void)st; (void)request;
+    return OPUS_UNIMPLEMENTED;
+}
+
+int opus_decoder_get_ctl(OpusDecoder *st, int request, ...) {
+    (void)st; (void)request;
+    return OPUS_UNIMPLEMENTED;
+}
+
+const char* opus_get_version_string(void) {
+    return "unavailable (host build)";
+}
+
+int opus_packet_get_bandwidth(const unsigned char *packet) {
+    (void)packet;
+    return OPUS_UNIMPLEMENTED;
+}
+
+int opus_packet_get_samples_per_frame(const unsigned char *packet, int Fs) {
+    (void)packet; (void)Fs;
+    return OPUS_UNIMPLEMENTED;
+}
+
+int opus_packet_get_nb_frames(const unsigned char *packet, int len) {
+    (void)packet; (void)len;
+    return OPUS_UNIMPLEMENTED;
+}
@@ -0,0 +1,381 @@
+/**
+ * @file spi_loopback_bench.cpp
+ * @brief FGH100M SPI transport throughput and per-frame latency over a loopback module
+ *
+ * Runs the firmware's Fgh100mSpiTransport, its task included, under the
+ * FreeRTOS scheduler against the SPI master and GPIO shims. The module at
+ * the far end of the bus is a loopback: every WRITE batch it takes is
+ * kept as one RX batch, INT is low while one is kept, and STATUS and READ
+ * hand it back, so each frame crosses the bus twice.
+ *
+ * Time is virtual. A transaction takes its bits at the device clock plus
+ * --overhead-us for the driver and its interrupt (modelled, not measured
+ * on a board), and the bus runs one transaction at a time in queue order.
+ * The clock only moves while the transport task is blocked, so the
+ * host's own speed does not show in the results.
+ *
+ * Each clock in --clock-hz and frame size in --frame-bytes is run twice:
+ *
+ * - "burst": --frames frames offered as fast as the transport takes them,
+ *   for throughput
+ * - "paced": one frame every --interval-us, for the latency of a frame
+ *   that finds the bus idle
+ *
+ * Reported per run: payload throughput and the share of the bus clock it
+ * uses both ways, write batches and frames per batch, latency from
+ * sendFrame() to the end of its write (the transport's own statistic,
+ * mean and max) and to its delivery back to the RX handler (mean, p99,
+ * max).
+ *
+ * Exit status: 0 if every frame came back once, intact and in order,
+ * with no RX errors, 1 if not, 2 on bad arguments.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "fgh100m_spi_transport.h"
+#include "xiao_esp32_config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim_harness.h"
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <string>
+#include <vector>
+
+static const uint32_t SEQ_BYTES = 4;        // Each frame starts with its sequence number
+
+struct Options {
+    std::vector<uint32_t> clocks = {FGH100M_SPI_CLOCK_SPEED, 10000000, 40000000};
+    std::vector<uint32_t> frameBytes = {64, 512, 1500};
+    uint32_t frames = 1000;
+    uint32_t intervalUs = 20000;            // A voice frame every 20 ms
+    uint32_t overheadUs = 15;               // Queueing, chip select and the completion interrupt
+    std::string jsonPath;
+};
+
+struct Result {
+    std::string mode;
+    uint32_t clockHz;
+    uint32_t frameBytes;
+    uint32_t frames;
+    double seconds;
+    double mbps;
+    double busShare;
+    Fgh100mTransportStats stats;
+    SimStat rxLatencyUs;
+    bool ok;
+};
+
+// ============================================================================
+// LOOPBACK MODULE
+// ============================================================================
+
+// The far end of the bus: keeps each WRITE batch and hands it back as an RX batch
+struct LoopbackModule {
+    std::deque<std::vector<uint8_t>> batches;   // Header included
+    uint32_t protocolErrors = 0;
+
+    void transfer(spi_transaction_t* trans) {
+        const uint8_t* tx = static_cast<const uint8_t*>(trans->tx_buffer);
+        uint8_t* rx = static_cast<uint8_t*>(trans->rx_buffer);
+        size_t bytes = trans->length / 8;
+        if (!tx || bytes < FGH100M_HEADER_SIZE) {
+            protocolErrors++;
+            return;
+        }
+
+        switch (tx[0]) {
+            case FGH100M_CMD_WRITE:
+                batches.emplace_back(tx, tx + bytes);
+                break;
+            case FGH100M_CMD_STATUS:
+                // [status][frame_count][len_lo][len_hi] of the next batch
+                memset(rx, 0, FGH100M_HEADER_SIZE);
+                if (!batches.empty()) {
+                    memcpy(rx + 1, batches.front().data() + 1, FGH100M_HEADER_SIZE - 1);
+                }
+                break;
+            case FGH100M_CMD_READ:
+                if (batches.empty() || batches.front().size() != bytes) {
+                    protocolErrors++;
+                    memset(rx, 0, bytes);
+                    break;
+                }
+                memcpy(rx, batches.front().data(), bytes);
+                rx[0] = 0;
+                batches.pop_front();
+                break;
+            default:
+                protocolErrors++;
+                break;
+        }
+    }
+
+    static void model(void* context, spi_transaction_t* trans) {
+        static_cast<LoopbackModule*>(context)->transfer(trans);
+    }
+};
+
+// ============================================================================
+// RECEIVER
+// ============================================================================
+
+static void fill_frame(uint8_t* frame, uint32_t length, uint32_t seq) {
+    memcpy(frame, &seq, SEQ_BYTES);
+    for (uint32_t i = SEQ_BYTES; i < length; i++) {
+        frame[i] = (uint8_t)(seq * 31 + i);
+    }
+}
+
+// Checks frames come back once, intact and in order; runs on the transport task
+struct Receiver {
+    const std::vector<int64_t>* sentAt = nullptr;
+    uint32_t frameBytes = 0;
+    uint32_t received = 0;
+    bool ok = true;
+    SimStat latencyUs;
+    std::vector<uint8_t> expected;
+
+    void onFrame(const uint8_t* data, size_t length) {
+        uint32_t seq = 0;
+        if (length >= SEQ_BYTES) {
+            memcpy(&seq, data, SEQ_BYTES);
+        }
+        expected.resize(frameBytes);
+        fill_frame(expected.data(), frameBytes, received);
+        if (length != frameBytes || seq != received || memcmp(data, expected.data(), length) != 0) {
+            ok = false;
+        } else {
+            latencyUs.add((double)(esp_timer_get_time() - (*sentAt)[seq]));
+        }
+        received++;
+    }
+};
+
+// ============================================================================
+// RUN
+// ============================================================================
+
+// The clock only moves once the transport task has gone as far as it can.
+// It runs above the bench task, so on the POSIX port this returns at once.
+static void wait_idle(TaskHandle_t task) {
+    for (;;) {
+        eTaskState state = eTaskGetState(task);
+        if (state == eBlocked || state == eSuspended || state == eDeleted) {
+            return;
+        }
+        taskYIELD();
+    }
+}
+
+static Result run_case(const Options& options, uint32_t clockHz, uint32_t frameBytes, bool paced) {
+    Result result = {};
+    result.mode = paced ? "paced" : "burst";
+    result.clockHz = clockHz;
+    result.frameBytes = frameBytes;
+    result.frames = options.frames;
+
+    Fgh100mTransportConfig config = Fgh100mSpiTransport::defaultConfig();
+    config.clock_speed_hz = (int)clockHz;
+    gpio_num_t intPin = static_cast<gpio_num_t>(config.pin_int);
+
+    LoopbackModule module;
+    host_spi_attach(config.host, LoopbackModule::model, &module);
+    host_gpio_set_level(intPin, 1);
+    host_timer_set_virtual(0);
+
+    std::vector<int64_t> sentAt(options.frames, 0);
+    Receiver receiver;
+    receiver.sentAt = &sentAt;
+    receiver.frameBytes = frameBytes;
+
+    Fgh100mSpiTransport transport;
+    transport.setRxHandler(Fgh100mRxHandler::fromMethod<Receiver, &Receiver::onFrame>(&receiver));
+    if (transport.begin(config) != ESP_OK) {
+        host_spi_attach(config.host, nullptr, nullptr);
+        return result;
+    }
+    TaskHandle_t task = xTaskGetHandle("FGH100M");
+    wait_idle(task);
+
+    std::vector<uint8_t> frame(frameBytes);
+    int64_t now = 0;
+    int64_t nextSendUs = 0;
+    uint32_t sent = 0;
+    bool onBus = false;
+    int64_t busDoneUs = 0;
+    while (receiver.received < options.frames) {
+        // Offer the frames that are due; a refused one waits for the bus to move
+        bool refused = false;
+        while (sent < options.frames && nextSendUs <= now) {
+            fill_frame(frame.data(), frameBytes, sent);
+            if (!transport.sendFrame(frame.data(), frameBytes)) {
+                refused = true;
+                break;
+            }
+            sentAt[sent++] = now;
+            nextSendUs = paced ? (int64_t)sent * options.intervalUs : now;
+            wait_idle(task);
+        }
+
+        // The transaction at the head of the queue starts when the one before ends
+        size_t bits = 0;
+        int hz = 0;
+        if (!onBus && host_spi_peek(config.host, &bits, &hz)) {
+            onBus = true;
+            busDoneUs = now + options.overheadUs + (int64_t)((bits * 1000000ull + hz - 1) / hz);
+        }
+
+        int64_t next = std::numeric_limits<int64_t>::max();
+        if (onBus) {
+            next = busDoneUs;
+        }
+        if (sent < options.frames && !refused) {
+            next = std::min(next, nextSendUs);
+        }
+        if (next == std::numeric_limits<int64_t>::max()) {
+            break;      // Nothing on the bus and nothing to send: frames were lost
+        }
+        host_timer_advance(next - now);
+        now = next;
+
+        if (onBus && busDoneUs == now) {
+            onBus = false;
+            host_spi_complete_next(config.host);
+            // INT is low while the module holds a batch
+            host_gpio_set_level(intPin, module.batches.empty() ? 1 : 0);
+            wait_idle(task);
+        }
+    }
+
+    result.stats = transport.getStats();
+    transport.end();
+    host_spi_attach(config.host, nullptr, nullptr);
+
+    result.seconds = now / 1e6;
+    double payloadBits = 8.0 * frameBytes * receiver.received;
+    result.mbps = result.seconds > 0 ? payloadBits / result.seconds / 1e6 : 0;
+    result.busShare = result.seconds > 0 ? 100.0 * 2 * payloadBits / (clockHz * result.seconds) : 0;
+    result.rxLatencyUs = receiver.latencyUs;
+    result.ok = receiver.ok && receiver.received == options.frames && result.stats.rx_errors == 0 &&
+                module.protocolErrors == 0 && module.batches.empty();
+    return result;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static bool write_json(const std::string& path, const Options& options, const std::vector<Result>& results) {
+    SimJson json;
+    if (!json.open(path)) {
+        return false;
+    }
+    json.add("frames", options.frames);
+    json.add("interval_us", options.intervalUs);
+    json.add("overhead_us", options.overheadUs);
+    json.add("buffer_bytes", (uint32_t)Board::halow_spi_buffer);
+    json.beginArray("runs");
+    for (const Result& r : results) {
+        json.beginObject();
+        json.add("mode", r.mode);
+        json.add("clock_hz", r.clockHz);
+        json.add("frame_bytes", r.frameBytes);
+        json.add("ok", r.ok);
+        json.add("mbps", r.mbps, 3);
+        json.add("bus_share", r.busShare, 1);
+        json.add("tx_batches", r.stats.tx_batches);
+        json.add("tx_refused", r.stats.tx_dropped);
+        json.add("tx_latency_mean_us", r.stats.avg_frame_latency_us);
+        json.add("tx_latency_max_us", r.stats.max_frame_latency_us);
+        json.add("rx_latency_mean_us", r.rxLatencyUs.mean(), 0);
+        json.add("rx_latency_p99_us", r.rxLatencyUs.pct(0.99), 0);
+        json.add("rx_latency_max_us", r.rxLatencyUs.max(), 0);
+        json.endObject();
+    }
+    json.endArray();
+    return json.close();
+}
+
+static Options s_options;
+static int s_exitStatus = SIM_EXIT_FAILED;
+
+static int run_all(const Options& options) {
+    std::vector<Result> results;
+    for (uint32_t clockHz : options.clocks) {
+        for (uint32_t frameBytes : options.frameBytes) {
+            results.push_back(run_case(options, clockHz, frameBytes, false));
+            results.push_back(run_case(options, clockHz, frameBytes, true));
+        }
+    }
+
+    printf("FGH100M transport over a loopback module: %u frames a run, %u byte DMA buffers, %u us a transaction\n\n",
+           (unsigned)options.frames, (unsigned)Board::halow_spi_buffer, (unsigned)options.overheadUs);
+    printf("  %-6s %6s %6s %8s %6s %8s %6s %16s %22s\n", "mode", "MHz", "bytes", "Mbit/s", "bus %",
+           "batches", "f/b", "tx us mean/max", "rx us mean/p99/max");
+    bool ok = true;
+    for (const Result& r : results) {
+        double perBatch = r.stats.tx_batches > 0 ? (double)r.stats.tx_frames / r.stats.tx_batches : 0;
+        printf("  %-6s %6.1f %6u %8.3f %6.1f %8u %6.1f %7u / %6u %6.0f / %6.0f / %6.0f%s\n", r.mode.c_str(),
+               r.clockHz / 1e6, (unsigned)r.frameBytes, r.mbps, r.busShare, (unsigned)r.stats.tx_batches,
+               perBatch, (unsigned)r.stats.avg_frame_latency_us, (unsigned)r.stats.max_frame_latency_us,
+               r.rxLatencyUs.mean(), r.rxLatencyUs.pct(0.99), r.rxLatencyUs.max(),
+               r.ok ? "" : " -- CHECK FAILED");
+        ok = ok && r.ok;
+    }
+    printf("  payload throughput; bus %% counts both crossings; tx is sendFrame() to the end of its write,\n"
+           "  rx to its delivery back; modelled bus timing, virtual time\n");
+
+    if (!options.jsonPath.empty() && !write_json(options.jsonPath, options, results)) {
+        fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+        return SIM_EXIT_USAGE;
+    }
+    return ok ? SIM_EXIT_OK : SIM_EXIT_FAILED;
+}
+
+static void bench_task(void* arg) {
+    (void)arg;
+    s_exitStatus = run_all(s_options);
+    vTaskEndScheduler();
+}
+
+int main(int argc, char** argv) {
+    Options& options = s_options;
+    SimArgs args;
+    args.add("--clock-hz", "HZ,...", [&](const char* text) {
+        return SimArgs::parseList(text, &options.clocks);
+    });
+    args.add("--frame-bytes", "N,...", [&](const char* text) {
+        return SimArgs::parseList(text, &options.frameBytes);
+    });
+    args.add("--frames", "N", &options.frames);
+    args.add("--interval-us", "US", &options.intervalUs);
+    args.add("--overhead-us", "US", &options.overheadUs);
+    args.add("--json", "FILE", &options.jsonPath);
+    const uint32_t maxFrame = Board::halow_spi_buffer - FGH100M_HEADER_SIZE - FGH100M_FRAME_PREFIX_SIZE;
+    if (!args.parse(argc, argv)) {
+        return SIM_EXIT_USAGE;
+    }
+    bool valid = options.frames >= 1 && options.frames <= 1000000 && options.intervalUs >= 1 &&
+            !options.clocks.empty() && !options.frameBytes.empty();
+    for (uint32_t clockHz : options.clocks) {
+        valid = valid && clockHz >= 100000 && clockHz <= 80000000;
+    }
+    for (uint32_t frameBytes : options.frameBytes) {
+        valid = valid && frameBytes >= SEQ_BYTES && frameBytes <= maxFrame;
+    }
+    if (!args.check(valid)) {
+        return SIM_EXIT_USAGE;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    // The transport needs its task running: the bench runs as a task too
+    xTaskCreate(bench_task, "bench", 16384, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+    vTaskStartScheduler();
+    return s_exitStatus;
+}
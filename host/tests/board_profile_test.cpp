@@ -0,0 +1,107 @@
+/**
+ * @file board_profile_test.cpp
+ * @brief Board profile traits: distinct pins, GPIO ranges, SPI host and DMA
+ *
+ * The static_asserts in board_profile.h only cover the selected board's
+ * ranges; these run the same checks over every profile, and show that the
+ * shared-pin check catches a clash.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include <gtest/gtest.h>
+
+#include "board_profile.h"
+
+namespace {
+
+// A pin the camera connector already uses
+struct BoardLedOnCameraClock : BoardXiaoEsp32S3 {
+    static constexpr int pin_led = 10;
+};
+
+// Two pins left unfitted are not a clash
+struct BoardTwoUnfitted : BoardXiaoEsp32C3 {
+    static constexpr int pin_gps_rx = -1;
+    static constexpr int pin_gps_tx = -1;
+};
+
+template <typename B> bool pins_in_range() {
+    const int pins[] = {
+        B::pin_oled_sda, B::pin_oled_scl, B::pin_i2s_bclk, B::pin_i2s_lrc, B::pin_i2s_din,
+        B::pin_i2s_dout, B::pin_button_ptt, B::pin_button_up, B::pin_button_down,
+        B::pin_button_select, B::pin_button_back, B::pin_gps_rx, B::pin_gps_tx, B::pin_led,
+        B::pin_battery_adc, B::cam_pin_xclk, B::cam_pin_vsync, B::cam_pin_pclk,
+    };
+    for (int pin : pins) {
+        if (pin < -1 || pin >= B::gpio_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The radio, audio and display have no fallback, so they are always fitted
+template <typename B> bool core_pins_fitted() {
+    return B::pin_halow_mosi >= 0 && B::pin_halow_miso >= 0 && B::pin_halow_sclk >= 0 &&
+           B::pin_halow_cs >= 0 && B::pin_halow_reset >= 0 && B::pin_halow_int >= 0 &&
+           B::pin_halow_int < B::gpio_count && B::pin_i2s_bclk >= 0 && B::pin_i2s_lrc >= 0 &&
+           B::pin_i2s_din >= 0 && B::pin_i2s_dout >= 0 && B::pin_oled_sda >= 0 && B::pin_oled_scl >= 0;
+}
+
+template <typename B> bool spi_fits_soc() {
+    return B::halow_spi_host >= BOARD_SPI2_HOST && B::halow_spi_host < BOARD_SPI2_HOST + B::spi_hosts &&
+           (!B::has_gdma || B::halow_spi_dma == BOARD_SPI_DMA_AUTO);
+}
+
+} // namespace
+
+TEST(BoardProfile, EveryProfileGivesEachPinOneFunction) {
+    EXPECT_EQ(board_shared_pin<BoardXiaoEsp32S3>(), -1);
+    EXPECT_EQ(board_shared_pin<BoardXiaoEsp32C3>(), -1);
+    EXPECT_EQ(board_shared_pin<BoardXiaoEsp32C6>(), -1);
+    EXPECT_EQ(board_shared_pin<BoardHeltecGeneric>(), -1);
+    EXPECT_EQ(board_shared_pin<BoardHeltecHtHc32>(), -1);
+    EXPECT_EQ(board_shared_pin<BoardHeltecHtIt01>(), -1);
+}
+
+TEST(BoardProfile, SharedPinCheckFindsAClash) {
+    EXPECT_EQ(board_shared_pin<BoardLedOnCameraClock>(), 10);
+    EXPECT_EQ(board_shared_pin<BoardTwoUnfitted>(), -1);
+}
+
+TEST(BoardProfile, PinsFitTheSoc) {
+    EXPECT_TRUE(pins_in_range<BoardXiaoEsp32S3>());
+    EXPECT_TRUE(pins_in_range<BoardXiaoEsp32C3>());
+    EXPECT_TRUE(pins_in_range<BoardXiaoEsp32C6>());
+    EXPECT_TRUE(pins_in_range<BoardHeltecGeneric>());
+
+    EXPECT_TRUE(core_pins_fitted<BoardXiaoEsp32S3>());
+    EXPECT_TRUE(core_pins_fitted<BoardXiaoEsp32C3>());
+    EXPECT_TRUE(core_pins_fitted<BoardXiaoEsp32C6>());
+    EXPECT_TRUE(core_pins_fitted<BoardHeltecGeneric>());
+}
+
+TEST(BoardProfile, SpiHostAndDmaFitTheSoc) {
+    EXPECT_TRUE(spi_fits_soc<BoardXiaoEsp32S3>());
+    EXPECT_TRUE(spi_fits_soc<BoardXiaoEsp32C3>());
+    EXPECT_TRUE(spi_fits_soc<BoardXiaoEsp32C6>());
+    EXPECT_TRUE(spi_fits_soc<BoardHeltecGeneric>());
+    EXPECT_EQ(BoardHeltecGeneric::halow_spi_dma, BOARD_SPI_DMA_CH2);
+}
+
+TEST(BoardProfile, OnlyTheS3CarriesACameraAndVectorUnit) {
+    EXPECT_TRUE(BoardXiaoEsp32S3::has_camera);
+    EXPECT_TRUE(BoardXiaoEsp32S3::has_simd);
+    EXPECT_FALSE(BoardXiaoEsp32C3::has_camera);
+    EXPECT_FALSE(BoardXiaoEsp32C6::has_camera);
+    EXPECT_FALSE(BoardHeltecGeneric::has_camera);
+    EXPECT_FALSE(BoardXiaoEsp32C3::has_simd);
+}
+
+TEST(BoardProfile, HostBuildSelectsTheXiaoS3) {
+    EXPECT_EQ(Board::platform, HW_PLATFORM_XIAO_ESP32S3);
+    EXPECT_EQ(Board::soc, BOARD_SOC_ESP32S3);
+}
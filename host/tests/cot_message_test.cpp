@@ -0,0 +1,42 @@
+/**
+ * @file cot_message_test.cpp
+ * @brief CoT position report generation and attribute parsing
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "cot_message.h"
+
+static GPSData sample_fix() {
+    GPSData fix;
+    fix.latitude = 48.117300;
+    fix.longitude = 11.516667;
+    fix.altitude = 545.4;
+    fix.satellites = 8;
+    fix.isValid = true;
+    return fix;
+}
+
+TEST(CotMessage, PositionSurvivesRoundTrip) {
+    const std::string cot = generateCoT(sample_fix());
+    ASSERT_FALSE(cot.empty());
+    EXPECT_NEAR(atof(parse_cot_value(cot, "lat=\"").c_str()), 48.117300, 1e-5);
+    EXPECT_NEAR(atof(parse_cot_value(cot, "lon=\"").c_str()), 11.516667, 1e-5);
+}
+
+TEST(CotMessage, MissingKeyIsEmpty) {
+    const std::string cot = generateCoT(sample_fix());
+    EXPECT_EQ(parse_cot_value(cot, "nosuchkey=\""), "");
+    EXPECT_EQ(parse_cot_value("", "lat=\""), "");
+}
+
+TEST(CotMessage, UnterminatedValueIsEmpty) {
+    EXPECT_EQ(parse_cot_value("<point lat=\"48.1", "lat=\""), "");
+}
@@ -0,0 +1,124 @@
+/**
+ * @file crypto_test.cpp
+ * @brief Session encryption, Ed25519 and OTA manifest signatures
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "crypto.h"
+#include "ota_mesh.h"
+#include "sodium.h"
+
+static std::vector<uint8_t> from_hex(const char* hex) {
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+        char byte[3] = { hex[i], hex[i + 1], 0 };
+        bytes.push_back((uint8_t)strtoul(byte, nullptr, 16));
+    }
+    return bytes;
+}
+
+TEST(Crypto, RoundTrip) {
+    const std::string plaintext = "Contact at grid 32U 691234 5334567";
+    std::vector<uint8_t> ciphertext = encrypt_message(plaintext);
+    ASSERT_FALSE(ciphertext.empty());
+    EXPECT_GT(ciphertext.size(), plaintext.size());
+    EXPECT_EQ(decrypt_message(ciphertext), plaintext);
+}
+
+TEST(Crypto, FreshNoncePerMessage) {
+    const std::string plaintext = "same text";
+    EXPECT_NE(encrypt_message(plaintext), encrypt_message(plaintext));
+}
+
+TEST(Crypto, RejectsTamperedCiphertext) {
+    std::vector<uint8_t> ciphertext = encrypt_message("do not modify");
+    ASSERT_FALSE(ciphertext.empty());
+    ciphertext.back() ^= 0x01;
+    EXPECT_EQ(decrypt_message(ciphertext), "");
+}
+
+TEST(Crypto, RejectsTruncatedCiphertext) {
+    std::vector<uint8_t> ciphertext = encrypt_message("short");
+    ciphertext.resize(4);
+    EXPECT_EQ(decrypt_message(ciphertext), "");
+}
+
+TEST(Crypto, RoundTripAfterKeyRegeneration) {
+    regenerate_session_key();
+    EXPECT_EQ(decrypt_message(encrypt_message("new session")), "new session");
+}
+
+// RFC 8032 section 7.1, TEST 2
+static const char* RFC8032_SEED = "4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb";
+static const char* RFC8032_PUBLIC_KEY = "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c";
+static const char* RFC8032_SIGNATURE =
+    "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da"
+    "085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00";
+
+TEST(Ed25519, MatchesRfc8032Vector) {
+    std::vector<uint8_t> seed = from_hex(RFC8032_SEED);
+    uint8_t pk[crypto_sign_PUBLICKEYBYTES];
+    uint8_t sk[crypto_sign_SECRETKEYBYTES];
+    crypto_sign_seed_keypair(pk, sk, seed.data());
+    EXPECT_EQ(std::vector<uint8_t>(pk, pk + sizeof(pk)), from_hex(RFC8032_PUBLIC_KEY));
+
+    const uint8_t message[] = { 0x72 };
+    uint8_t sig[crypto_sign_BYTES];
+    ASSERT_EQ(crypto_sign_detached(sig, nullptr, message, sizeof(message), sk), 0);
+    EXPECT_EQ(std::vector<uint8_t>(sig, sig + sizeof(sig)), from_hex(RFC8032_SIGNATURE));
+    EXPECT_EQ(crypto_sign_verify_detached(sig, message, sizeof(message), pk), 0);
+}
+
+TEST(Ed25519, RejectsTamperedMessageOrSignature) {
+    std::vector<uint8_t> pk = from_hex(RFC8032_PUBLIC_KEY);
+    std::vector<uint8_t> sig = from_hex(RFC8032_SIGNATURE);
+    const uint8_t other[] = { 0x73 };
+    EXPECT_NE(crypto_sign_verify_detached(sig.data(), other, sizeof(other), pk.data()), 0);
+
+    const uint8_t message[] = { 0x72 };
+    sig[10] ^= 0x01;
+    EXPECT_NE(crypto_sign_verify_detached(sig.data(), message, sizeof(message), pk.data()), 0);
+}
+
+TEST(OtaManifest, SignatureSurvivesEncodingAndCoversEveryField) {
+    std::vector<uint8_t> seed = from_hex(RFC8032_SEED);
+    uint8_t pk[crypto_sign_PUBLICKEYBYTES];
+    uint8_t sk[crypto_sign_SECRETKEYBYTES];
+    crypto_sign_seed_keypair(pk, sk, seed.data());
+
+    std::vector<uint8_t> base(4096, 0x11);
+    std::vector<uint8_t> target(4096, 0x22);
+    std::vector<uint8_t> delta(512, 0x33);
+    OtaManifest manifest;
+    ASSERT_TRUE(ota_manifest_create(base.data(), base.size(), target.data(), target.size(), delta, "1.2.3",
+                                    256, &manifest));
+    EXPECT_FALSE(ota_manifest_verify(manifest, pk));
+    ASSERT_TRUE(ota_manifest_sign(&manifest, sk));
+
+    std::vector<uint8_t> encoded;
+    ota_manifest_encode(manifest, &encoded);
+    ASSERT_EQ(encoded.size(), (size_t)OTA_MANIFEST_ENCODED_SIZE);
+    OtaManifest decoded;
+    ASSERT_TRUE(ota_manifest_decode(encoded.data(), encoded.size(), &decoded));
+    EXPECT_TRUE(ota_manifest_verify(decoded, pk));
+
+    // Any byte of the signed part changed, such as the target hash
+    encoded[OTA_MANIFEST_SIGNED_SIZE - OTA_SHA256_SIZE - 1] ^= 0x01;
+    ASSERT_TRUE(ota_manifest_decode(encoded.data(), encoded.size(), &decoded));
+    EXPECT_FALSE(ota_manifest_verify(decoded, pk));
+
+    uint8_t other_pk[crypto_sign_PUBLICKEYBYTES];
+    seed[0] ^= 0x01;
+    crypto_sign_seed_keypair(other_pk, sk, seed.data());
+    EXPECT_FALSE(ota_manifest_verify(manifest, other_pk));
+}
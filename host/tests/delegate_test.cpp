@@ -0,0 +1,139 @@
+/**
+ * @file delegate_test.cpp
+ * @brief DelegateTable: stale handles, generation wrap, removal during dispatch, full table
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include <gtest/gtest.h>
+
+#include "delegate.h"
+
+#include <vector>
+
+namespace {
+
+typedef DelegateTable<void(int), 4> Table;
+typedef Table::DelegateType Listener;
+
+// Records the values it was called with; may remove a handle when called
+struct Probe {
+    std::vector<int> seen;
+    Table* table = nullptr;
+    DelegateHandle removeOnCall;
+
+    void onEvent(int value) {
+        seen.push_back(value);
+        if (table && removeOnCall.isValid()) {
+            table->remove(removeOnCall);
+        }
+    }
+
+    Listener listener() { return Listener::fromMethod<Probe, &Probe::onEvent>(this); }
+};
+
+} // namespace
+
+TEST(DelegateTable, RejectsStaleAndForeignHandles) {
+    Table table;
+    Probe probe;
+    DelegateHandle handle = table.add(probe.listener());
+    ASSERT_TRUE(handle.isValid());
+    EXPECT_TRUE(table.contains(handle));
+
+    EXPECT_TRUE(table.remove(handle));
+    EXPECT_FALSE(table.contains(handle));
+    EXPECT_FALSE(table.remove(handle));
+    EXPECT_FALSE(table.invoke(handle, 1));
+
+    // The slot is reused under a new generation; the old handle stays dead
+    DelegateHandle reused = table.add(probe.listener());
+    ASSERT_EQ(reused.index(), handle.index());
+    EXPECT_NE(reused.generation(), handle.generation());
+    EXPECT_FALSE(table.remove(handle));
+    EXPECT_FALSE(table.invoke(handle, 2));
+    EXPECT_TRUE(table.invoke(reused, 3));
+    EXPECT_EQ(probe.seen, (std::vector<int>{3}));
+
+    EXPECT_FALSE(table.remove(DelegateHandle()));
+    EXPECT_FALSE(table.remove(DelegateHandle::make(7, 1)));
+    EXPECT_FALSE(table.add(Listener()).isValid());
+}
+
+TEST(DelegateTable, GenerationWrapsPastZero) {
+    Table table;
+    Probe probe;
+    DelegateHandle first = table.add(probe.listener());
+    ASSERT_EQ(first.generation(), 1u);
+
+    // 0xFFFF registrations of one slot run through every non-zero generation
+    DelegateHandle last = first;
+    for (uint32_t i = 0; i < 0xFFFEu; i++) {
+        ASSERT_TRUE(table.remove(last));
+        last = table.add(probe.listener());
+        ASSERT_TRUE(last.isValid());
+        ASSERT_EQ(last.index(), first.index());
+    }
+    EXPECT_EQ(last.generation(), 0xFFFFu);
+
+    ASSERT_TRUE(table.remove(last));
+    DelegateHandle wrapped = table.add(probe.listener());
+    EXPECT_TRUE(wrapped.isValid());
+    EXPECT_EQ(wrapped.generation(), 1u);
+    EXPECT_FALSE(table.contains(last));
+    EXPECT_TRUE(table.invoke(wrapped, 5));
+}
+
+TEST(DelegateTable, RemovalDuringInvokeAllSkipsTheRemovedListener) {
+    Table table;
+    Probe first;
+    Probe second;
+    Probe third;
+    table.add(first.listener());
+    DelegateHandle secondHandle = table.add(second.listener());
+    table.add(third.listener());
+
+    first.table = &table;
+    first.removeOnCall = secondHandle;
+    EXPECT_EQ(table.invokeAll(1), 2u);
+    EXPECT_EQ(first.seen, (std::vector<int>{1}));
+    EXPECT_TRUE(second.seen.empty());
+    EXPECT_EQ(third.seen, (std::vector<int>{1}));
+    EXPECT_EQ(table.size(), 2u);
+}
+
+TEST(DelegateTable, ListenerCanRemoveItselfWhileCalled) {
+    Table table;
+    Probe once;
+    DelegateHandle handle = table.add(once.listener());
+    once.table = &table;
+    once.removeOnCall = handle;
+
+    EXPECT_EQ(table.invokeAll(1), 1u);
+    EXPECT_EQ(table.invokeAll(2), 0u);
+    EXPECT_EQ(once.seen, (std::vector<int>{1}));
+    EXPECT_EQ(table.size(), 0u);
+}
+
+TEST(DelegateTable, FullTableRejectsUntilASlotFrees) {
+    Table table;
+    Probe probes[5];
+    DelegateHandle handles[4];
+    for (int i = 0; i < 4; i++) {
+        handles[i] = table.add(probes[i].listener());
+        ASSERT_TRUE(handles[i].isValid());
+    }
+    EXPECT_EQ(table.size(), 4u);
+    EXPECT_FALSE(table.add(probes[4].listener()).isValid());
+
+    ASSERT_TRUE(table.remove(handles[2]));
+    DelegateHandle late = table.add(probes[4].listener());
+    ASSERT_TRUE(late.isValid());
+    EXPECT_EQ(late.index(), handles[2].index());
+
+    EXPECT_EQ(table.invokeAll(9), 4u);
+    EXPECT_TRUE(probes[2].seen.empty());
+    EXPECT_EQ(probes[4].seen, (std::vector<int>{9}));
+}
@@ -0,0 +1,122 @@
+/**
+ * @file event_executor_test.cpp
+ * @brief Deferred event executor: priority order, FIFO order and overload shedding
+ *
+ * The executor runs without workers (the host never starts the scheduler)
+ * and the test drains it with runPending().
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include <gtest/gtest.h>
+
+#include "event_executor.h"
+
+#include <vector>
+
+namespace {
+
+// Records the order in which handlers ran and which arguments were released
+struct Recorder {
+    std::vector<int> ran;
+
+    void onEvent(void* arg) { ran.push_back(*static_cast<int*>(arg)); }
+};
+
+std::vector<int> g_released;
+
+void releaseTag(void* arg) {
+    g_released.push_back(*static_cast<int*>(arg));
+}
+
+class EventExecutorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        g_released.clear();
+        event_executor_config_t config = EventExecutor::defaultConfig();
+        config.worker_count = 0;
+        config.queue_depth[EVENT_PRIORITY_HIGH] = 2;
+        config.queue_depth[EVENT_PRIORITY_NORMAL] = 4;
+        config.queue_depth[EVENT_PRIORITY_LOW] = 2;
+        executor().resetStats();
+        ASSERT_TRUE(executor().start(config));
+    }
+
+    void TearDown() override { executor().stop(); }
+
+    static EventExecutor& executor() { return EventExecutor::getInstance(); }
+
+    bool post(event_priority_t priority, int* tag) {
+        return executor().post(priority, EventHandler::fromMethod<Recorder, &Recorder::onEvent>(&recorder),
+                               tag, releaseTag);
+    }
+
+    Recorder recorder;
+};
+
+} // namespace
+
+TEST_F(EventExecutorTest, RunsHighestPriorityFirst) {
+    int tags[] = {1, 2, 3, 4, 5};
+    ASSERT_TRUE(post(EVENT_PRIORITY_LOW, &tags[0]));
+    ASSERT_TRUE(post(EVENT_PRIORITY_NORMAL, &tags[1]));
+    ASSERT_TRUE(post(EVENT_PRIORITY_LOW, &tags[2]));
+    ASSERT_TRUE(post(EVENT_PRIORITY_HIGH, &tags[3]));
+    ASSERT_TRUE(post(EVENT_PRIORITY_NORMAL, &tags[4]));
+
+    EXPECT_EQ(executor().runPending(), 5u);
+    EXPECT_EQ(recorder.ran, (std::vector<int>{4, 2, 5, 1, 3}));
+    EXPECT_EQ(g_released, recorder.ran);
+    EXPECT_EQ(executor().getStats(EVENT_PRIORITY_HIGH).executed, 1u);
+    EXPECT_EQ(executor().getStats(EVENT_PRIORITY_NORMAL).executed, 2u);
+    EXPECT_EQ(executor().getStats(EVENT_PRIORITY_LOW).executed, 2u);
+}
+
+TEST_F(EventExecutorTest, KeepsFifoOrderWithinAPriority) {
+    int tags[] = {1, 2, 3, 4};
+    for (int& tag : tags) {
+        ASSERT_TRUE(post(EVENT_PRIORITY_NORMAL, &tag));
+    }
+    executor().runPending();
+    EXPECT_EQ(recorder.ran, (std::vector<int>{1, 2, 3, 4}));
+}
+
+TEST_F(EventExecutorTest, ShedsOverloadWithoutBlocking) {
+    int tags[] = {1, 2, 3, 4, 5};
+    EXPECT_TRUE(post(EVENT_PRIORITY_HIGH, &tags[0]));
+    EXPECT_TRUE(post(EVENT_PRIORITY_HIGH, &tags[1]));
+    EXPECT_FALSE(post(EVENT_PRIORITY_HIGH, &tags[2]));
+    EXPECT_FALSE(post(EVENT_PRIORITY_HIGH, &tags[3]));
+
+    // A full queue releases the rejected argument at once and leaves the
+    // other priorities alone
+    EXPECT_EQ(g_released, (std::vector<int>{3, 4}));
+    EXPECT_TRUE(post(EVENT_PRIORITY_LOW, &tags[4]));
+
+    event_executor_stats_t high = executor().getStats(EVENT_PRIORITY_HIGH);
+    EXPECT_EQ(high.posted, 2u);
+    EXPECT_EQ(high.dropped, 2u);
+    EXPECT_EQ(high.queue_high_water, 2u);
+
+    EXPECT_EQ(executor().runPending(), 3u);
+    EXPECT_EQ(recorder.ran, (std::vector<int>{1, 2, 5}));
+    EXPECT_EQ(executor().getStats(EVENT_PRIORITY_HIGH).executed, 2u);
+}
+
+TEST_F(EventExecutorTest, StopReleasesQueuedEvents) {
+    int tags[] = {1, 2};
+    ASSERT_TRUE(post(EVENT_PRIORITY_NORMAL, &tags[0]));
+    ASSERT_TRUE(post(EVENT_PRIORITY_LOW, &tags[1]));
+
+    executor().stop();
+    EXPECT_TRUE(recorder.ran.empty());
+    EXPECT_EQ(g_released, (std::vector<int>{1, 2}));
+
+    // A stopped executor rejects and releases
+    int late = 3;
+    EXPECT_FALSE(post(EVENT_PRIORITY_HIGH, &late));
+    EXPECT_EQ(g_released.back(), 3);
+    EXPECT_EQ(executor().runPending(), 0u);
+}
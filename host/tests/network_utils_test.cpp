@@ -0,0 +1,28 @@
+/**
+ * @file network_utils_test.cpp
+ * @brief IPv4 address validation
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include <gtest/gtest.h>
+
+#include "network_utils.h"
+
+TEST(NetworkUtils, AcceptsDottedQuads) {
+    EXPECT_TRUE(validate_ip_address("192.168.1.10"));
+    EXPECT_TRUE(validate_ip_address("0.0.0.0"));
+    EXPECT_TRUE(validate_ip_address("255.255.255.255"));
+    EXPECT_TRUE(validate_ip_address("239.255.0.1"));
+}
+
+TEST(NetworkUtils, RejectsMalformedAddresses) {
+    EXPECT_FALSE(validate_ip_address(nullptr));
+    EXPECT_FALSE(validate_ip_address(""));
+    EXPECT_FALSE(validate_ip_address("256.1.1.1"));
+    EXPECT_FALSE(validate_ip_address("1.2.3"));
+    EXPECT_FALSE(validate_ip_address("1.2.3.4.5"));
+    EXPECT_FALSE(validate_ip_address("a.b.c.d"));
+}
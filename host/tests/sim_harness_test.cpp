@@ -0,0 +1,123 @@
+/**
+ * @file sim_harness_test.cpp
+ * @brief Option parsing, percentiles and JSON output of the host tools
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include <gtest/gtest.h>
+
+#include "sim_harness.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static bool parse(SimArgs& args, std::vector<const char*> argv) {
+    argv.insert(argv.begin(), "tool");
+    return args.parse((int)argv.size(), (char**)argv.data());
+}
+
+TEST(SimHarness, PercentileOfSamples) {
+    std::vector<double> values = {5, 1, 4, 2, 3};
+    EXPECT_EQ(sim_percentile(values, 0.0), 1);
+    EXPECT_EQ(sim_percentile(values, 0.5), 3);
+    EXPECT_EQ(sim_percentile(values, 1.0), 5);
+    EXPECT_EQ(sim_percentile(std::vector<double>(), 0.5), 0);
+
+    SimStat stat;
+    for (double v : values) {
+        stat.add(v);
+    }
+    EXPECT_EQ(stat.count(), 5u);
+    EXPECT_DOUBLE_EQ(stat.mean(), 3.0);
+    EXPECT_EQ(stat.min(), 1);
+    EXPECT_EQ(stat.max(), 5);
+    EXPECT_EQ(sim_share(0, 0), 100.0);
+    EXPECT_EQ(sim_share(1, 4), 25.0);
+}
+
+TEST(SimHarness, ParsesOptionsAndPositionals) {
+    uint32_t nodes = 4;
+    double loss = 0;
+    std::string path;
+    bool quiet = false;
+    double at = 0, length = 0;
+    SimArgs args;
+    args.positional("FILE", &path);
+    args.add("--nodes", "N", &nodes);
+    args.add("--loss", "P", &loss);
+    args.add("--quiet", &quiet);
+    args.add("--outage", "AT FOR", &at, &length);
+
+    ASSERT_TRUE(parse(args, {"in.jpg", "--nodes", "12", "--loss", "0.25", "--quiet", "--outage", "3", "1.5"}));
+    EXPECT_EQ(path, "in.jpg");
+    EXPECT_EQ(nodes, 12u);
+    EXPECT_DOUBLE_EQ(loss, 0.25);
+    EXPECT_TRUE(quiet);
+    EXPECT_DOUBLE_EQ(at, 3);
+    EXPECT_DOUBLE_EQ(length, 1.5);
+}
+
+TEST(SimHarness, RejectsBadCommandLines) {
+    uint32_t nodes = 4;
+    std::string path;
+    SimArgs args;
+    args.positional("FILE", &path);
+    args.add("--nodes", "N", &nodes);
+
+    EXPECT_FALSE(parse(args, {}));                              // Missing positional
+    EXPECT_FALSE(parse(args, {"a", "--nodes"}));                // Missing value
+    EXPECT_FALSE(parse(args, {"a", "--nodes", "12x"}));         // Trailing text
+    EXPECT_FALSE(parse(args, {"a", "--nodes", "-1"}));          // Out of range
+    EXPECT_FALSE(parse(args, {"a", "--other", "1"}));           // Unknown flag
+    EXPECT_FALSE(parse(args, {"a", "b"}));                      // Extra positional
+    EXPECT_FALSE(args.check(false));
+}
+
+TEST(SimHarness, ParsesLists) {
+    std::vector<double> losses;
+    ASSERT_TRUE(SimArgs::parseList("0,0.1,0.2", &losses));
+    EXPECT_EQ(losses, (std::vector<double>{0, 0.1, 0.2}));
+    EXPECT_FALSE(SimArgs::parseList("0,,0.2", &losses));
+    EXPECT_FALSE(SimArgs::parseList("", &losses));
+
+    std::vector<uint32_t> sizes;
+    ASSERT_TRUE(SimArgs::parseList("640,60", &sizes));
+    EXPECT_EQ(sizes, (std::vector<uint32_t>{640, 60}));
+    EXPECT_FALSE(SimArgs::parseList("1.5", &sizes));
+    EXPECT_FALSE(SimArgs::parseList("-1", &sizes));
+}
+
+TEST(SimHarness, WritesJson) {
+    std::string path = ::testing::TempDir() + "sim_harness_test.json";
+    SimJson json;
+    ASSERT_TRUE(json.open(path));
+    json.add("name", "a \"quoted\" name");
+    json.add("count", 3u);
+    json.add("ok", true);
+    json.beginArray("results");
+    json.beginObject();
+    json.add("ms", 1.25, 2);
+    json.add("delta", -2);
+    json.endObject();
+    json.endArray();
+    ASSERT_TRUE(json.close());
+
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    EXPECT_EQ(text.str(),
+              "{\n"
+              "  \"name\": \"a \\\"quoted\\\" name\",\n"
+              "  \"count\": 3,\n"
+              "  \"ok\": true,\n"
+              "  \"results\": [\n"
+              "    {\"ms\": 1.25, \"delta\": -2}\n"
+              "  ]\n"
+              "}\n");
+    remove(path.c_str());
+}
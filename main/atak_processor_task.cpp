@@ -18,6 +18,9 @@
 #include "include/config.h"
 #include "include/shared_data.h"
 #include "include/error_handling.h"
+#include "include/logging_system.h"
+#include "include/cot_message.h"
+#include "include/talkgroup.h"
 #include "AirCom.pb-c.h"
 
 #include <lwip/err.h>
@@ -31,22 +34,6 @@ static const char* ATAK_PROC_TAG = "ATAK_PROC";
 // ATAK PROCESSOR TASK IMPLEMENTATION
 // ============================================================================
 
-/**
- * @brief Parse a value from a CoT XML string
- *
- * @param cot CoT XML string to parse
- * @param key XML attribute key to find
- * @return Extracted value string, empty string if not found
- */
-static std::string parse_cot_value(const std::string& cot, const char* key) {
-    size_t key_pos = cot.find(key);
-    if (key_pos == std::string::npos) return "";
-    key_pos += strlen(key); // Move to the start of the value
-    size_t end_quote_pos = cot.find('"', key_pos);
-    if (end_quote_pos == std::string::npos) return "";
-    return cot.substr(key_pos, end_quote_pos - key_pos);
-}
-
 /**
  * @brief ATAK processor task
  *
@@ -83,8 +70,11 @@ void atak_processor_task(void *pvParameters) {
         uint8_t rx_buffer[1500];
         int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0, (struct sockaddr *)&source_addr, &socklen);
 
-        if (len > 0) {
-            AirComPacket *packet = air_com_packet__unpack(NULL, len, rx_buffer);
+        size_t cot_len = 0;
+        // Other talkgroups' positions are dropped before they are unpacked
+        const uint8_t* cot = len > 0 ? talkgroup_accept(rx_buffer, len, &cot_len) : NULL;
+        if (cot) {
+            AirComPacket *packet = air_com_packet__unpack(NULL, cot_len, cot);
             if (packet != NULL) {
                 if (packet->payload_variant_case == AIR_COM_PACKET__PAYLOAD_VARIANT_COT_MESSAGE) {
                     LOG_INFO(ATAK_PROC_TAG, "Received CoT message");
@@ -0,0 +1,247 @@
+/**
+ * @file audio_pipeline.cpp
+ * @brief Audio stages joined by lock-free rings, run by lanes placed on cores
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/audio_pipeline.h"
+#include <string.h>
+#include <new>
+
+AudioPipeline::AudioPipeline(clock_fn_t clock)
+    : m_clock(clock), m_stages(), m_profile(), m_lanes() {
+    for (audio_stage_t& stage : m_stages) {
+        stage.input = -1;
+        stage.lane = -1;
+    }
+}
+
+AudioPipeline::~AudioPipeline() {
+    for (audio_stage_t& stage : m_stages) {
+        delete stage.ring;
+    }
+}
+
+bool AudioPipeline::add(int id, const char* name, audio_stage_fn_t fn, void* ctx, int input, size_t ringBytes) {
+    if (id < 0 || id >= AUDIO_PIPELINE_MAX_STAGES || m_stages[id].name || !name || !fn) {
+        return false;
+    }
+    if (input >= 0 && (input >= AUDIO_PIPELINE_MAX_STAGES || !m_stages[input].name ||
+                       m_stages[input].outputCount == AUDIO_PIPELINE_MAX_OUTPUTS)) {
+        return false;
+    }
+    audio_stage_t& stage = m_stages[id];
+    if (input >= 0) {
+        stage.ring = new (std::nothrow) FrameRing(ringBytes);
+        if (!stage.ring || !stage.ring->valid()) {
+            delete stage.ring;
+            stage.ring = nullptr;
+            return false;
+        }
+        m_stages[input].outputs[m_stages[input].outputCount++] = id;
+    }
+    stage.name = name;
+    stage.fn = fn;
+    stage.ctx = ctx;
+    stage.input = input;
+    return true;
+}
+
+bool AudioPipeline::configure(const audio_profile_t& profile) {
+    if (profile.lanes < 1 || profile.lanes > AUDIO_PIPELINE_MAX_LANES) {
+        return false;
+    }
+    uint32_t placed = 0;
+    for (int lane = 0; lane < profile.lanes; lane++) {
+        const audio_lane_config_t& config = profile.lane[lane];
+        if (config.stages == 0 || (config.stages & placed)) {
+            return false;
+        }
+        for (int other = 0; other < lane; other++) {
+            if (profile.lane[other].core == config.core) {
+                return false;
+            }
+        }
+        placed |= config.stages;
+    }
+    for (int id = 0; id < AUDIO_PIPELINE_MAX_STAGES; id++) {
+        bool present = m_stages[id].name != nullptr;
+        if (present != ((placed & AUDIO_STAGE_BIT(id)) != 0)) {
+            return false;
+        }
+    }
+
+    m_profile = profile;
+    int64_t now = m_clock();
+    for (int lane = 0; lane < profile.lanes; lane++) {
+        for (int id = 0; id < AUDIO_PIPELINE_MAX_STAGES; id++) {
+            if (profile.lane[lane].stages & AUDIO_STAGE_BIT(id)) {
+                m_stages[id].lane = lane;
+            }
+        }
+        m_lanes[lane] = audio_lane_stats_t();
+        m_lanes[lane].sinceUs = now;
+    }
+    return true;
+}
+
+int AudioPipeline::runLane(int lane) {
+    audio_lane_stats_t& stats = m_lanes[lane];
+    int64_t tickStart = m_clock();
+    int handled = 0;
+    for (int id = 0; id < AUDIO_PIPELINE_MAX_STAGES; id++) {
+        audio_stage_t& stage = m_stages[id];
+        if (stage.lane != lane) {
+            continue;
+        }
+        int64_t start = m_clock();
+        handled += stage.fn(*this, id, stage.ctx);
+        uint32_t us = (uint32_t)(m_clock() - start);
+        stage.runs++;
+        stage.busyUs += us;
+        if (us > stage.maxRunUs) {
+            stage.maxRunUs = us;
+        }
+    }
+    uint32_t us = (uint32_t)(m_clock() - tickStart);
+    stats.ticks++;
+    stats.busyUs += us;
+    if (us > stats.maxTickUs) {
+        stats.maxTickUs = us;
+    }
+    return handled;
+}
+
+size_t AudioPipeline::pop(int stage, audio_frame_t* frame, uint8_t* data, size_t capacity) {
+    audio_stage_t& s = m_stages[stage];
+    if (!s.ring) {
+        return 0;
+    }
+    uint8_t buffer[sizeof(audio_frame_t) + AUDIO_PIPELINE_MAX_FRAME];
+    size_t length = s.ring->pop(buffer, sizeof(buffer));
+    if (length < sizeof(audio_frame_t)) {
+        return 0;
+    }
+    s.taken.fetch_add(1, std::memory_order_relaxed);
+    memcpy(frame, buffer, sizeof(audio_frame_t));
+    size_t payload = length - sizeof(audio_frame_t);
+    if (payload > capacity) {
+        payload = capacity;
+    }
+    memcpy(data, buffer + sizeof(audio_frame_t), payload);
+    frame->length = (uint16_t)payload;
+    return payload;
+}
+
+uint32_t AudioPipeline::depth(int stage) const {
+    const audio_stage_t& s = m_stages[stage];
+    return s.queued.load(std::memory_order_relaxed) - s.taken.load(std::memory_order_relaxed);
+}
+
+bool AudioPipeline::push(int stage, const audio_frame_t& frame, const void* data) {
+    audio_stage_t& s = m_stages[stage];
+    size_t length = frame.length < AUDIO_PIPELINE_MAX_FRAME ? frame.length : AUDIO_PIPELINE_MAX_FRAME;
+    bool all = true;
+    for (int i = 0; i < s.outputCount; i++) {
+        audio_stage_t& consumer = m_stages[s.outputs[i]];
+        if (consumer.ring->push(&frame, sizeof(frame), data, length)) {
+            consumer.queued.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            s.dropped++;
+            all = false;
+        }
+    }
+    account(s, frame);
+    return all;
+}
+
+void AudioPipeline::done(int stage, const audio_frame_t& frame) {
+    account(m_stages[stage], frame);
+}
+
+void AudioPipeline::account(audio_stage_t& stage, const audio_frame_t& frame) {
+    int64_t latency = m_clock() - frame.origin_us;
+    uint32_t us = latency > 0 ? (uint32_t)latency : 0;
+    stage.frames++;
+    stage.latencyUs += us;
+    if (us > stage.maxLatencyUs) {
+        stage.maxLatencyUs = us;
+    }
+}
+
+uint32_t AudioPipeline::laneLoad(int lane) const {
+    const audio_lane_stats_t& stats = m_lanes[lane];
+    int64_t window = m_clock() - stats.sinceUs;
+    return window > 0 ? (uint32_t)((uint64_t)stats.busyUs * 100 / (uint64_t)window) : 0;
+}
+
+void AudioPipeline::resetStats(int lane) {
+    for (audio_stage_t& stage : m_stages) {
+        if (stage.lane == lane) {
+            stage.runs = 0;
+            stage.frames = 0;
+            stage.dropped = 0;
+            stage.busyUs = 0;
+            stage.maxRunUs = 0;
+            stage.latencyUs = 0;
+            stage.maxLatencyUs = 0;
+        }
+    }
+    m_lanes[lane] = audio_lane_stats_t();
+    m_lanes[lane].sinceUs = m_clock();
+}
+
+// ============================================================================
+// THE FIRMWARE'S VOICE PATH
+// ============================================================================
+
+#define AUDIO_RING_BYTES 2048               // A frame or two: producer and consumer share a lane
+#define AUDIO_RX_RING_BYTES 8192            // Received bursts wait here for the jitter buffer
+#define AUDIO_SIDETONE_RING_BYTES 2048      // Three mic frames; sidetone plays only the newest
+
+static const audio_profile_t AUDIO_PROFILE_SINGLE = {
+    "single", 1, {
+        {"Audio", 0, 10, AUDIO_TX_STAGES | AUDIO_RX_STAGES},
+    },
+};
+
+static const audio_profile_t AUDIO_PROFILE_DUAL = {
+    "dual", 2, {
+        {"AudioTx", 1, 10, AUDIO_TX_STAGES},
+        {"AudioRx", 0, 10, AUDIO_RX_STAGES},
+    },
+};
+
+bool audio_pipeline_build(AudioPipeline* pipeline, const audio_stage_fn_t fns[AUDIO_STAGE_COUNT],
+                          void* const ctx[AUDIO_STAGE_COUNT]) {
+    static const struct {
+        const char* name;
+        int input;
+        size_t ringBytes;
+    } STAGES[AUDIO_STAGE_COUNT] = {
+        {"capture", -1, 0},
+        {"dsp", AUDIO_STAGE_CAPTURE, AUDIO_RING_BYTES},
+        {"encode", AUDIO_STAGE_DSP, AUDIO_RING_BYTES},
+        {"send", AUDIO_STAGE_ENCODE, AUDIO_RING_BYTES},
+        {"receive", -1, 0},
+        {"jitter", AUDIO_STAGE_RECEIVE, AUDIO_RX_RING_BYTES},
+        {"decode", AUDIO_STAGE_JITTER, AUDIO_RING_BYTES},
+        {"sidetone", AUDIO_STAGE_CAPTURE, AUDIO_SIDETONE_RING_BYTES},
+        {"mix", AUDIO_STAGE_DECODE, AUDIO_RING_BYTES},
+        {"playout", AUDIO_STAGE_MIX, AUDIO_RING_BYTES},
+    };
+    for (int id = 0; id < AUDIO_STAGE_COUNT; id++) {
+        if (!pipeline->add(id, STAGES[id].name, fns[id], ctx ? ctx[id] : nullptr, STAGES[id].input,
+                           STAGES[id].ringBytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const audio_profile_t& audio_pipeline_profile(int cores) {
+    return cores > 1 ? AUDIO_PROFILE_DUAL : AUDIO_PROFILE_SINGLE;
+}
@@ -1,6 +1,15 @@
 #include "include/audio_task.h"
 #include "include/config.h"
+#include "include/board_profile.h"
 #include "include/shared_data.h"
+#include "include/talkgroup.h"
+#include "include/recorder_service.h"
+#include "include/power_service.h"
+#include "include/boot_sequence.h"
+#include "include/audio_pipeline.h"
+#include "include/dsp_kernels.h"
+#include "include/metrics_registry.h"
+#include "include/telemetry_service.h"
 #include "bt_audio.h"
 #include "esp_log.h"
 #include "driver/i2s.h"
@@ -10,16 +19,19 @@
 
 #include "lwip/sockets.h"
 #include <math.h>
+#include <string.h>
+#include <atomic>
+#include <new>
 #include "freertos/task.h"
 #include "esp_timer.h"
 
 // I2S Configuration
 #define I2S_SAMPLE_RATE     (16000)
 #define I2S_NUM             (I2S_NUM_0)
-#define I2S_BCK_PIN         (PIN_I2S_BCLK)
-#define I2S_LRC_PIN         (PIN_I2S_LRC)
-#define I2S_DO_PIN          (PIN_I2S_DOUT)
-#define I2S_DI_PIN          (PIN_I2S_DIN)
+#define I2S_BCK_PIN         (Board::pin_i2s_bclk)
+#define I2S_LRC_PIN         (Board::pin_i2s_lrc)
+#define I2S_DO_PIN          (Board::pin_i2s_dout)
+#define I2S_DI_PIN          (Board::pin_i2s_din)
 
 // Audio Codec Configuration
 #define AUDIO_FRAME_SIZE_MS (20) // 20ms frames for low latency
@@ -41,8 +53,8 @@ static void init_i2s() {
         .channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT, // For MEMS mic
         .communication_format = I2S_COMM_FORMAT_STAND_I2S,
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 8,
-        .dma_buf_len = 256,
+        .dma_buf_count = Board::i2s_dma_buf_count,
+        .dma_buf_len = Board::i2s_dma_buf_len,
         .use_apll = false,
         .tx_desc_auto_clear = true
     };
@@ -64,151 +76,418 @@ static void init_i2s() {
 #define AUDIO_OVER_TONE_DURATION_MS 100 // Duration of over signal
 #define AUDIO_OVER_TONE_AMPLITUDE 5000 // Amplitude (out of 32767 for int16_t)
 
+// Pipeline
+#define AUDIO_LANE_STACK_SIZE (6 * 1024)
+#define AUDIO_RX_MAX_PER_TICK 4 // Voice frames taken from the socket per tick
+#define AUDIO_MIC_HIGHPASS_HZ 80.0f // Mic DC offset and handling rumble
+#define AUDIO_SIDETONE_GAIN (DSP_GAIN_UNITY / 4) // -12 dB: heard, but under received voice
+#define AUDIO_RX_DUCK_GAIN (DSP_GAIN_UNITY / 2) // -6 dB on received voice while the PTT is held
+#define AUDIO_RELEASE_WINDOW_US 1000000 // Received voice this soon after PTT release counts as release latency
+
 // Performance monitoring constants
 #define AUDIO_YIELD_INTERVAL 10 // Yield every 10 frames
 #define AUDIO_LOG_INTERVAL_MS 1000 // Log statistics every second
 
-static void play_over_sound() {
-    ESP_LOGI(TAG, "Playing 'over' sound...");
+static AudioPipeline* s_pipeline = nullptr;
+static int s_rxSock = -1;
+static std::atomic<bool> s_transmitting(false); // Written by the capture stage
+static std::atomic<bool> s_overTone(false);     // Capture stage -> mix stage
+static std::atomic<int64_t> s_releasedUs(0);    // Last PTT release, for the playout stage; 0: none yet
+
+// Stage buffers; each stage runs in one lane only
+static uint8_t s_captureBuf[AUDIO_FRAME_SIZE_SAMPLES * sizeof(int16_t)];
+static int16_t s_dspBuf[AUDIO_FRAME_SIZE_SAMPLES];
+static uint8_t s_encodeIn[AUDIO_PIPELINE_MAX_FRAME];
+static uint8_t s_encodeOut[TALKGROUP_HEADER_SIZE + AUDIO_PIPELINE_MAX_FRAME];
+static uint8_t s_sendBuf[TALKGROUP_HEADER_SIZE + AUDIO_PIPELINE_MAX_FRAME];
+static uint8_t s_rxBuf[AUDIO_MAX_PACKET_SIZE];
+static uint8_t s_jitterBuf[AUDIO_PIPELINE_MAX_FRAME];
+static uint8_t s_decodeBuf[AUDIO_PIPELINE_MAX_FRAME];
+static int16_t s_sidetoneIn[AUDIO_FRAME_SIZE_SAMPLES];
+static int16_t s_sidetone[AUDIO_FRAME_SIZE_SAMPLES];    // Sidetone stage -> mix stage, same lane
+static size_t s_sidetoneLength = 0;                     // Bytes; 0 when no frame waits
+static int64_t s_sidetoneOriginUs = 0;
+static int16_t s_mixBuf[AUDIO_PIPELINE_MAX_FRAME / sizeof(int16_t)];
+static uint8_t s_playoutBuf[AUDIO_PIPELINE_MAX_FRAME];
+static dsp_biquad_s16_t s_micHighpass;
+static bool s_jitterPrimed = false;
+static int s_overToneSample = -1;               // Next tone sample; -1 when no tone plays
+
+// Hand a received voice frame to the recorder; it only copies into RAM
+static void record_rx(const struct sockaddr_in* source, const uint8_t* frame, const uint8_t* voice, size_t voice_len) {
+    char talker[INET_ADDRSTRLEN];
+    inet_ntoa_r(source->sin_addr, talker, sizeof(talker));
+    uint8_t group = voice != frame ? frame[3] : TALKGROUP_ALL;  // No header: all-call
+    recorder_service_capture(VOICE_DIRECTION_RX, group, talker, voice, voice_len);
+}
 
-    // Calculate number of samples
-    const int num_samples = (int)((float)I2S_SAMPLE_RATE * (float)AUDIO_OVER_TONE_DURATION_MS / 1000.0f);
-    int16_t* buffer = (int16_t*)malloc(num_samples * sizeof(int16_t));
-    if (!buffer) {
-        ESP_LOGE(TAG, "Failed to allocate buffer for over sound");
-        return;
+// ============================================================================
+// TX STAGES
+// ============================================================================
+
+// PTT commands from the UI and floor control, then one frame from the mic
+static int stage_capture(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_command_t cmd;
+    if (xQueueReceive(audio_command_queue, &cmd, (TickType_t)0) == pdPASS) {
+        if (cmd == AUDIO_CMD_START_TX) {
+            s_transmitting.store(true);
+            power_service_set_active(POWER_ACTIVITY_TRANSMIT, true);
+            LOG_AUDIO_INFO("Audio task started transmitting with timing guarantees");
+        } else if (cmd == AUDIO_CMD_STOP_TX) {
+            s_transmitting.store(false);
+            s_releasedUs.store(pipeline.now());
+            power_service_set_active(POWER_ACTIVITY_TRANSMIT, false);
+            LOG_AUDIO_INFO("Audio task stopped transmitting");
+            s_overTone.store(true);
+        }
+    }
+    if (!s_transmitting.load()) {
+        return 0;
     }
 
-    // Generate sine wave for "over" signal
-    for (int i = 0; i < num_samples; i++) {
-        float t = (float)i / (float)I2S_SAMPLE_RATE;
-        buffer[i] = (int16_t)(AUDIO_OVER_TONE_AMPLITUDE * sin(2.0f * M_PI * AUDIO_OVER_TONE_FREQ_HZ * t));
+    audio_frame_t frame = {};
+    frame.origin_us = pipeline.now();
+    frame.group = talkgroup_get_tx();
+    if (is_bt_audio_connected()) {
+        int bytes_read = bt_audio_read_mic_data(s_captureBuf, AUDIO_BT_MIC_BUFFER_SIZE);
+        if (bytes_read <= 0) {
+            return 0;
+        }
+        frame.length = (uint16_t)bytes_read;
+    } else {
+        size_t bytes_read = 0;
+        esp_err_t ret = i2s_read(I2S_NUM, s_captureBuf, sizeof(s_captureBuf), &bytes_read, 0); // Non-blocking
+        if (ret != ESP_OK || bytes_read == 0) {
+            return 0;
+        }
+        frame.length = (uint16_t)bytes_read;
+        frame.flags = AUDIO_FRAME_PCM;
     }
+    pipeline.push(stage, frame, s_captureBuf);
+    return 1;
+}
 
-    // Write to I2S
-    size_t bytes_written;
-    i2s_write(I2S_NUM, buffer, num_samples * sizeof(int16_t), &bytes_written, portMAX_DELAY);
+// High-pass the mic's PCM; headset audio passes as it is
+static int stage_dsp(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, (uint8_t*)s_dspBuf, sizeof(s_dspBuf)) > 0) {
+        if (frame.flags & AUDIO_FRAME_PCM) {
+            dsp_biquad_s16(&s_micHighpass, s_dspBuf, s_dspBuf, frame.length / sizeof(int16_t));
+        }
+        pipeline.push(stage, frame, s_dspBuf);
+        handled++;
+    }
+    return handled;
+}
 
-    // After playing the tone, it's good practice to write some silence
-    // to ensure the buffer clears and prevent any lingering noise.
-    i2s_zero_dma_buffer(I2S_NUM);
+// Voice goes out as PCM: leave room for the talkgroup header in front
+static int stage_encode(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_encodeIn, sizeof(s_encodeIn)) > 0) {
+        memset(s_encodeOut, 0, TALKGROUP_HEADER_SIZE);
+        memcpy(s_encodeOut + TALKGROUP_HEADER_SIZE, s_encodeIn, frame.length);
+        frame.length += TALKGROUP_HEADER_SIZE;
+        pipeline.push(stage, frame, s_encodeOut);
+        handled++;
+    }
+    return handled;
+}
 
-    free(buffer);
-    ESP_LOGI(TAG, "'Over' sound finished.");
+static int stage_send(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_sendBuf, sizeof(s_sendBuf)) > TALKGROUP_HEADER_SIZE) {
+        talkgroup_send(TALKGROUP_KIND_VOICE, s_sendBuf, frame.length, VOICE_PORT);
+        recorder_service_capture(VOICE_DIRECTION_TX, frame.group, NULL, s_sendBuf + TALKGROUP_HEADER_SIZE,
+                                 frame.length - TALKGROUP_HEADER_SIZE);
+        pipeline.done(stage, frame);
+        metrics_histogram_record(METRIC_AUDIO_TX_LATENCY_US, (uint32_t)(pipeline.now() - frame.origin_us));
+        LOG_AUDIO_DEBUG("Transmitted %u audio bytes", (unsigned)(frame.length - TALKGROUP_HEADER_SIZE));
+        handled++;
+    }
+    return handled;
 }
 
+// ============================================================================
+// RX STAGES
+// ============================================================================
+
+// Reads on while the PTT is held, so nothing piles up in lwIP for after release
+static int stage_receive(AudioPipeline& pipeline, int stage, void* ctx) {
+    struct sockaddr_in source;
+    int handled = 0;
+    while (handled < AUDIO_RX_MAX_PER_TICK) {
+        socklen_t source_len = sizeof(source);
+        int len = recvfrom(s_rxSock, s_rxBuf, sizeof(s_rxBuf), 0, (struct sockaddr *)&source, &source_len);
+        if (len <= 0) {
+            break;
+        }
+        handled++;
+        size_t voice_len = 0;
+        // Other groups' voice is dropped before it reaches the speaker
+        const uint8_t* voice = talkgroup_accept(s_rxBuf, len, &voice_len);
+        if (!voice || voice_len == 0) {
+            continue;
+        }
+        audio_frame_t frame = {};
+        frame.origin_us = pipeline.now();
+        frame.length = (uint16_t)voice_len;
+        frame.group = voice != s_rxBuf ? s_rxBuf[3] : TALKGROUP_ALL;
+        frame.flags = AUDIO_FRAME_LIVE;
+        pipeline.push(stage, frame, voice);
+        // The recorder keeps one transmission at a time: while the PTT is
+        // held it records ours, and received voice is only monitored
+        if (!s_transmitting.load()) {
+            record_rx(&source, s_rxBuf, voice, voice_len);
+        }
+        power_service_pulse(POWER_ACTIVITY_VOICE);
+    }
+    return handled;
+}
 
-void audioTask(void *pvParameters) {
-    LOG_AUDIO_INFO("audioTask started with real-time performance optimizations");
+// Hold back AUDIO_JITTER_PRIME_FRAMES at the start of a talk spurt, then one
+// frame per tick; a backlog older than AUDIO_RX_MAX_LATENCY_US is discarded
+static int stage_jitter(AudioPipeline& pipeline, int stage, void* ctx) {
+    uint32_t depth = pipeline.depth(stage);
+    if (depth == 0) {
+        s_jitterPrimed = false;
+        return 0;
+    }
+    if (!s_jitterPrimed && depth < AUDIO_JITTER_PRIME_FRAMES) {
+        return 0;
+    }
+    s_jitterPrimed = true;
+    audio_frame_t frame;
+    int64_t now = pipeline.now();
+    while (pipeline.pop(stage, &frame, s_jitterBuf, sizeof(s_jitterBuf)) > 0) {
+        if (now - frame.origin_us <= AUDIO_RX_MAX_LATENCY_US) {
+            pipeline.push(stage, frame, s_jitterBuf);
+            return 1;
+        }
+        metrics_counter_inc(METRIC_AUDIO_RX_DISCARDED);
+    }
+    return 0;
+}
 
-    // Initialize I2S
-    init_i2s();
+// Voice arrives as PCM: whole samples only
+static int stage_decode(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_decodeBuf, sizeof(s_decodeBuf)) > 0) {
+        frame.length &= ~1u;
+        if (frame.length > 0) {
+            pipeline.push(stage, frame, s_decodeBuf);
+        }
+        handled++;
+    }
+    return handled;
+}
 
-    // Create a non-blocking UDP socket for receiving audio
-    int rx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
-    if (rx_sock < 0) {
-        LOG_AUDIO_ERROR(ERROR_SOCKET_CREATE, "Unable to create RX socket: errno %d", errno);
-        vTaskDelete(NULL);
-        return;
+// Only the newest mic frame is kept for the mix: older ones would add delay.
+// Headsets play their own sidetone, so only I2S audio gets one
+static int stage_sidetone(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, (uint8_t*)s_sidetoneIn, sizeof(s_sidetoneIn)) > 0) {
+        handled++;
+        if (pipeline.depth(stage) > 0 || !(frame.flags & AUDIO_FRAME_PCM)) {
+            continue;
+        }
+        size_t samples = frame.length / sizeof(int16_t);
+        dsp_gain_s16(s_sidetoneIn, s_sidetone, samples, AUDIO_SIDETONE_GAIN);
+        s_sidetoneLength = samples * sizeof(int16_t);
+        s_sidetoneOriginUs = frame.origin_us;
+        pipeline.done(stage, frame);
+        metrics_histogram_record(METRIC_AUDIO_SIDETONE_LATENCY_US, (uint32_t)(pipeline.now() - frame.origin_us));
     }
+    return handled;
+}
 
-    struct sockaddr_in dest_addr;
-    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(VOICE_PORT);
-    int err = bind(rx_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-    if (err < 0) {
-        LOG_AUDIO_ERROR(ERROR_SOCKET_BIND, "Socket unable to bind: errno %d", errno);
-        close(rx_sock);
-        vTaskDelete(NULL);
-        return;
+// Add the waiting sidetone frame to the one in s_mixBuf
+static void mix_sidetone(audio_frame_t* frame) {
+    size_t samples = frame->length / sizeof(int16_t);
+    size_t sidetone = s_sidetoneLength / sizeof(int16_t);
+    size_t both = samples < sidetone ? samples : sidetone;
+    dsp_add_sat_s16(s_mixBuf, s_sidetone, s_mixBuf, both);
+    if (sidetone > samples) {
+        memcpy(s_mixBuf + samples, s_sidetone + samples, (sidetone - samples) * sizeof(int16_t));
+        frame->length = (uint16_t)(sidetone * sizeof(int16_t));
     }
-    fcntl(rx_sock, F_SETFL, O_NONBLOCK);
+}
+
+// One frame of the 'over' tone; false once it has all played
+static bool over_tone_frame(audio_frame_t* frame, int16_t* out) {
+    const int total = I2S_SAMPLE_RATE * AUDIO_OVER_TONE_DURATION_MS / 1000;
+    if (s_overToneSample >= total) {
+        s_overToneSample = -1;
+        return false;
+    }
+    int count = total - s_overToneSample < AUDIO_FRAME_SIZE_SAMPLES ? total - s_overToneSample
+                                                                     : AUDIO_FRAME_SIZE_SAMPLES;
+    for (int i = 0; i < count; i++) {
+        float t = (float)(s_overToneSample + i) / (float)I2S_SAMPLE_RATE;
+        out[i] = (int16_t)(AUDIO_OVER_TONE_AMPLITUDE * sin(2.0f * M_PI * AUDIO_OVER_TONE_FREQ_HZ * t));
+    }
+    s_overToneSample += count;
+    frame->length = (uint16_t)(count * sizeof(int16_t));
+    frame->flags = AUDIO_FRAME_PCM;
+    return true;
+}
 
-    bool is_transmitting = false;
+// The 'over' tone first, then live voice, ducked under the sidetone while
+// the PTT is held; a replay plays in the pauses
+static int stage_mix(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_frame_t frame = {};
+    bool transmitting = s_transmitting.load();
+    if (!transmitting) {
+        s_sidetoneLength = 0;               // The last frames of a transmission
+    }
+    if (s_overTone.exchange(false)) {
+        ESP_LOGI(TAG, "Playing 'over' sound...");
+        s_overToneSample = 0;
+    }
+    if (s_overToneSample >= 0) {
+        frame.origin_us = pipeline.now();
+        if (over_tone_frame(&frame, s_mixBuf)) {
+            pipeline.push(stage, frame, s_mixBuf);
+            return 1;
+        }
+    }
+    if (pipeline.pop(stage, &frame, (uint8_t*)s_mixBuf, sizeof(s_mixBuf)) > 0) {
+        frame.length &= ~1u;
+        if (transmitting) {
+            dsp_gain_s16(s_mixBuf, s_mixBuf, frame.length / sizeof(int16_t), AUDIO_RX_DUCK_GAIN);
+        }
+        if (s_sidetoneLength > 0) {
+            mix_sidetone(&frame);
+            s_sidetoneLength = 0;
+        }
+        pipeline.push(stage, frame, s_mixBuf);
+        return 1;
+    }
+    if (s_sidetoneLength > 0) {
+        frame.origin_us = s_sidetoneOriginUs;
+        frame.length = (uint16_t)s_sidetoneLength;
+        frame.flags = AUDIO_FRAME_PCM;
+        memcpy(s_mixBuf, s_sidetone, s_sidetoneLength);
+        s_sidetoneLength = 0;
+        pipeline.push(stage, frame, s_mixBuf);
+        return 1;
+    }
+    if (transmitting) {
+        return 0;
+    }
+    size_t length = recorder_service_replay_frame((uint8_t*)s_mixBuf, sizeof(s_mixBuf));
+    if (length > 0) {
+        frame.origin_us = pipeline.now();
+        frame.length = (uint16_t)length;
+        pipeline.push(stage, frame, s_mixBuf);
+        power_service_pulse(POWER_ACTIVITY_VOICE);
+        return 1;
+    }
+    return 0;
+}
+
+static int stage_playout(AudioPipeline& pipeline, int stage, void* ctx) {
+    audio_frame_t frame;
+    int handled = 0;
+    while (pipeline.pop(stage, &frame, s_playoutBuf, sizeof(s_playoutBuf)) > 0) {
+        if (is_bt_audio_connected()) {
+            bt_audio_send_data(s_playoutBuf, frame.length);
+        } else {
+            size_t bytes_written = 0;
+            i2s_write(I2S_NUM, s_playoutBuf, frame.length, &bytes_written, 0); // Non-blocking
+        }
+        pipeline.done(stage, frame);
+        if (frame.flags & AUDIO_FRAME_LIVE) {
+            int64_t now = pipeline.now();
+            uint32_t latency = (uint32_t)(now - frame.origin_us);
+            metrics_histogram_record(METRIC_AUDIO_RX_LATENCY_US, latency);
+            int64_t released = s_releasedUs.load();
+            if (released > 0 && now - released < AUDIO_RELEASE_WINDOW_US && !s_transmitting.load()) {
+                metrics_histogram_record(METRIC_AUDIO_RELEASE_LATENCY_US, latency);
+            }
+        }
+        handled++;
+    }
+    return handled;
+}
+
+// ============================================================================
+// LANES
+// ============================================================================
+
+static void log_lane_stats(int lane) {
+    const audio_lane_config_t& config = s_pipeline->profile().lane[lane];
+    uint32_t load = s_pipeline->laneLoad(lane);
+    metrics_gauge_set(config.core == 0 ? METRIC_AUDIO_CORE0_LOAD_PCT : METRIC_AUDIO_CORE1_LOAD_PCT, (int32_t)load);
+    for (int id = 0; id < AUDIO_STAGE_COUNT; id++) {
+        const audio_stage_t& stage = s_pipeline->stage(id);
+        if (stage.lane != lane) {
+            continue;
+        }
+        if (stage.dropped) {
+            metrics_counter_add(METRIC_AUDIO_RING_DROPS, stage.dropped);
+        }
+        if (stage.frames) {
+            LOG_AUDIO_DEBUG("%s: %lu frames, latency %lu us mean %lu max, run %lu us max, %lu dropped",
+                            stage.name, (unsigned long)stage.frames,
+                            (unsigned long)(stage.latencyUs / stage.frames), (unsigned long)stage.maxLatencyUs,
+                            (unsigned long)stage.maxRunUs, (unsigned long)stage.dropped);
+        }
+    }
+    LOG_AUDIO_DEBUG("Lane %s on core %d: %lu%% load, longest tick %lu us", config.name, config.core,
+                    (unsigned long)load, (unsigned long)s_pipeline->laneStats(lane).maxTickUs);
+    s_pipeline->resetStats(lane);
+}
+
+// Runs the lane's stages once per frame period
+static void lane_task(void* pvParameters) {
+    const int lane = (int)(intptr_t)pvParameters;
     uint64_t last_frame_time = esp_timer_get_time();
-    uint64_t frame_start_time = 0;
+    uint64_t frame_interval_us = AUDIO_FRAME_INTERVAL_US;   // Longer while the node is idle
+    uint64_t next_log = last_frame_time + AUDIO_LOG_INTERVAL_MS * 1000ULL;
     uint32_t timing_violations = 0;
-    uint8_t rx_buf[AUDIO_MAX_PACKET_SIZE];
+    uint32_t yield_counter = 0;
 
-    // Main audio loop with precise timing control
-    for(;;) {
-        frame_start_time = esp_timer_get_time();
+    for (;;) {
+        uint64_t frame_start_time = esp_timer_get_time();
 
         // Check for timing violations and log performance issues
         uint64_t frame_duration = frame_start_time - last_frame_time;
-        if (frame_duration > AUDIO_WATCHDOG_TIMEOUT_US) {
+        if (frame_duration > frame_interval_us * AUDIO_WATCHDOG_TIMEOUT_US / AUDIO_FRAME_INTERVAL_US) {
             timing_violations++;
             LOG_AUDIO_WARNING("Audio timing violation: %llu us (violation #%lu)",
                     frame_duration, timing_violations);
         }
 
-        // Check for commands from the UI task with higher priority processing
-        audio_command_t cmd;
-        if (xQueueReceive(audio_command_queue, &cmd, (TickType_t)0) == pdPASS) {
-            if (cmd == AUDIO_CMD_START_TX) {
-                is_transmitting = true;
-                LOG_AUDIO_INFO("Audio task started transmitting with timing guarantees");
-            } else if (cmd == AUDIO_CMD_STOP_TX) {
-                is_transmitting = false;
-                LOG_AUDIO_INFO("Audio task stopped transmitting");
-                // Yield to allow UI task to respond immediately
-                taskYIELD();
-                play_over_sound();
-            }
+        // Codec work at full clock, and no light sleep while I2S runs
+        bool realtime = power_service_state() >= POWER_STATE_LISTENING;
+        if (realtime) {
+            power_service_rt_begin();
         }
-
         uint64_t processing_start = esp_timer_get_time();
-
-        if (is_bt_audio_connected()) {
-            // Bluetooth headset processing with timing optimization
-            if (is_transmitting) {
-                uint8_t bt_mic_buf[AUDIO_BT_MIC_BUFFER_SIZE];
-                int bytes_read = bt_audio_read_mic_data(bt_mic_buf, sizeof(bt_mic_buf));
-                if (bytes_read > 0) {
-                    HaLowMeshManager::getInstance().sendUdpMulticast(bt_mic_buf, bytes_read, VOICE_PORT);
-                    LOG_AUDIO_DEBUG("Transmitted %d audio bytes from BT", bytes_read);
-                }
-            } else {
-                int len = recv(rx_sock, rx_buf, sizeof(rx_buf), 0);
-                if (len > 0) {
-                    bt_audio_send_data(rx_buf, len);
-                    LOG_AUDIO_DEBUG("Received and sent %d audio bytes to BT", len);
-                }
-            }
-        } else {
-            // I2S processing with optimized timing
-            if (is_transmitting) {
-                int16_t i2s_buffer[AUDIO_FRAME_SIZE_SAMPLES];
-                size_t bytes_read = 0;
-                esp_err_t ret = i2s_read(I2S_NUM, i2s_buffer, sizeof(i2s_buffer), &bytes_read, 0); // Non-blocking
-
-                if (ret == ESP_OK && bytes_read > 0) {
-                    HaLowMeshManager::getInstance().sendUdpMulticast((const uint8_t*)i2s_buffer, bytes_read, VOICE_PORT);
-                    LOG_AUDIO_DEBUG("Transmitted %d audio bytes from I2S", bytes_read);
-                }
-            } else {
-                int len = recv(rx_sock, rx_buf, sizeof(rx_buf), 0);
-                if (len > 0) {
-                    size_t bytes_written = 0;
-                    esp_err_t ret = i2s_write(I2S_NUM, rx_buf, len, &bytes_written, 0); // Non-blocking
-
-                    if (ret == ESP_OK) {
-                        LOG_AUDIO_DEBUG("Received and played %d audio bytes on I2S", bytes_written);
-                    }
-                }
-            }
-        }
+        s_pipeline->runLane(lane);
 
         // Monitor processing time to ensure we meet real-time constraints
         uint64_t processing_time = esp_timer_get_time() - processing_start;
         if (processing_time > AUDIO_MAX_PROCESSING_TIME_US) {
             LOG_AUDIO_WARNING("Audio processing exceeded limit: %llu us", processing_time);
         }
+        if (realtime) {
+            power_service_rt_end();
+        }
+        if (frame_start_time >= next_log) {
+            log_lane_stats(lane);
+            next_log = frame_start_time + AUDIO_LOG_INTERVAL_MS * 1000ULL;
+        }
 
         // Precise timing control for next frame
         last_frame_time = frame_start_time;
-        uint64_t target_next_frame = frame_start_time + AUDIO_FRAME_INTERVAL_US;
+        frame_interval_us = (uint64_t)power_service_poll_ms(POWER_WAKE_AUDIO, AUDIO_FRAME_SIZE_MS) * 1000;
+        uint64_t target_next_frame = frame_start_time + frame_interval_us;
         uint64_t current_time = esp_timer_get_time();
 
         if (current_time < target_next_frame) {
@@ -225,13 +504,86 @@ void audioTask(void *pvParameters) {
         }
 
         // Yield periodically to maintain system responsiveness
-        static uint32_t yield_counter = 0;
         if (++yield_counter % AUDIO_YIELD_INTERVAL == 0) {
             taskYIELD();
         }
     }
+}
+
+// Stages in the profile's lanes; a lane that cannot start leaves its stages idle
+static bool start_pipeline(void) {
+    static const audio_stage_fn_t fns[AUDIO_STAGE_COUNT] = {
+        stage_capture, stage_dsp, stage_encode, stage_send,
+        stage_receive, stage_jitter, stage_decode, stage_sidetone, stage_mix, stage_playout,
+    };
+    dsp_biquad_s16_highpass(&s_micHighpass, AUDIO_MIC_HIGHPASS_HZ, (float)I2S_SAMPLE_RATE, 0.707f);
+    s_pipeline = new (std::nothrow) AudioPipeline(esp_timer_get_time);
+    const audio_profile_t& profile = audio_pipeline_profile(Board::cores);
+    if (!s_pipeline || !audio_pipeline_build(s_pipeline, fns, NULL) || !s_pipeline->configure(profile)) {
+        return false;
+    }
+    bool started = true;
+    for (int lane = 0; lane < profile.lanes; lane++) {
+        const audio_lane_config_t& config = profile.lane[lane];
+        TaskHandle_t handle = NULL;
+        if (xTaskCreatePinnedToCore(lane_task, config.name, AUDIO_LANE_STACK_SIZE, (void*)(intptr_t)lane,
+                                    config.priority, &handle, config.core) != pdPASS) {
+            LOG_AUDIO_ERROR(ERROR_TASK_CREATION, "Failed to create audio lane %s", config.name);
+            started = false;
+            continue;
+        }
+        telemetry_register_task(handle, AUDIO_LANE_STACK_SIZE);
+    }
+    LOG_AUDIO_INFO("Audio pipeline: %s profile, %d lane%s", profile.name, profile.lanes,
+                   profile.lanes == 1 ? "" : "s");
+    return started;
+}
+
+// Sets up I2S and the voice socket, starts the lanes and ends
+void audioTask(void *pvParameters) {
+    LOG_AUDIO_INFO("audioTask started with real-time performance optimizations");
+
+    // Initialize I2S while the radio comes up, then wait for it: the
+    // socket needs the network interface
+    int64_t i2s_start_us = esp_timer_get_time();
+    init_i2s();
+    LOG_AUDIO_INFO("I2S up in %u ms", (unsigned)((esp_timer_get_time() - i2s_start_us) / 1000));
+    if (!boot_wait(BOOT_BIT(BOOT_STAGE_RADIO), BOOT_WAIT_FOREVER)) {
+        LOG_AUDIO_WARNING("Radio not up at boot, binding the voice socket anyway");
+    }
 
-    // Cleanup
-    close(rx_sock);
+    // Create a non-blocking UDP socket for receiving audio
+    int rx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (rx_sock < 0) {
+        LOG_AUDIO_ERROR(ERROR_SOCKET_CREATE, "Unable to create RX socket: errno %d", errno);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    struct sockaddr_in dest_addr;
+    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(VOICE_PORT);
+    int err = bind(rx_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    if (err < 0) {
+        LOG_AUDIO_ERROR(ERROR_SOCKET_BIND, "Socket unable to bind: errno %d", errno);
+        close(rx_sock);
+        vTaskDelete(NULL);
+        return;
+    }
+    fcntl(rx_sock, F_SETFL, O_NONBLOCK);
+    s_rxSock = rx_sock;
+
+    if (!start_pipeline()) {
+        LOG_AUDIO_ERROR(ERROR_TASK_CREATION, "Audio pipeline not started");
+        if (!s_pipeline || s_pipeline->profile().lanes == 0) {
+            delete s_pipeline;
+            s_pipeline = nullptr;
+            close(rx_sock);
+            vTaskDelete(NULL);
+            return;
+        }
+    }
+    boot_voice_ready();
     vTaskDelete(NULL);
 }
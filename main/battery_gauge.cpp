@@ -0,0 +1,135 @@
+/**
+ * @file battery_gauge.cpp
+ * @brief Battery charge and runtime estimate from voltage samples, and the charge levels
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/battery_gauge.h"
+#include <string.h>
+
+// Open-circuit voltage of a single LiPo cell at rest against charge,
+// highest first; typical of 1000 - 2000 mAh pouch cells at room temperature
+static const struct {
+    uint16_t mv;
+    uint8_t percent;
+} OCV_TABLE[] = {
+    { 4200, 100 }, { 4150, 95 }, { 4110, 90 }, { 4080, 85 }, { 4020, 80 },
+    { 3980, 75 }, { 3950, 70 }, { 3910, 65 }, { 3870, 60 }, { 3850, 55 },
+    { 3840, 50 }, { 3820, 45 }, { 3800, 40 }, { 3790, 35 }, { 3770, 30 },
+    { 3750, 25 }, { 3730, 20 }, { 3710, 15 }, { 3690, 10 }, { 3610, 5 },
+    { 3270, 0 },
+};
+static const size_t OCV_TABLE_SIZE = sizeof(OCV_TABLE) / sizeof(OCV_TABLE[0]);
+
+battery_gauge_config_t battery_gauge_default_config(void) {
+    battery_gauge_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.divider = 2.0f;
+    config.internal_mohm = 150.0f;
+    config.voltage_alpha = 0.05f;           // ~100 s at one sample per 5 s
+    config.current_alpha = 0.003f;          // ~30 min: runtime follows the duty, not each call
+    config.capacity_mah = 1500.0f;
+    config.low_percent = 30.0f;
+    config.critical_percent = 10.0f;
+    config.hysteresis_percent = 8.0f;       // The curve is flat near 30%: 10 mV is 5 points
+
+    // NORMAL keeps the firmware's rates
+    battery_policy_t& normal = config.policy[BATTERY_LEVEL_NORMAL];
+    normal.beacon_ms = 0;
+    normal.cot_ms = 10000;
+    normal.ui_frame_ms = 0;
+    normal.codec_complexity = 5;
+
+    battery_policy_t& low = config.policy[BATTERY_LEVEL_LOW];
+    low.beacon_ms = 5000;
+    low.cot_ms = 30000;
+    low.ui_frame_ms = 66;
+    low.codec_complexity = 3;
+
+    // Still reachable and still talking, at the least the team can work with
+    battery_policy_t& critical = config.policy[BATTERY_LEVEL_CRITICAL];
+    critical.beacon_ms = 15000;
+    critical.cot_ms = 60000;
+    critical.ui_frame_ms = 100;
+    critical.codec_complexity = 1;
+    return config;
+}
+
+float battery_percent_from_ocv(uint32_t ocv_mv) {
+    if (ocv_mv >= OCV_TABLE[0].mv) {
+        return 100.0f;
+    }
+    for (size_t i = 1; i < OCV_TABLE_SIZE; i++) {
+        if (ocv_mv >= OCV_TABLE[i].mv) {
+            float span = (float)(OCV_TABLE[i - 1].mv - OCV_TABLE[i].mv);
+            float above = (float)(ocv_mv - OCV_TABLE[i].mv);
+            return OCV_TABLE[i].percent + (OCV_TABLE[i - 1].percent - OCV_TABLE[i].percent) * above / span;
+        }
+    }
+    return 0.0f;
+}
+
+const char* battery_level_name(battery_level_t level) {
+    switch (level) {
+        case BATTERY_LEVEL_NORMAL: return "normal";
+        case BATTERY_LEVEL_LOW: return "low";
+        case BATTERY_LEVEL_CRITICAL: return "critical";
+        default: return "?";
+    }
+}
+
+BatteryGauge::BatteryGauge(const battery_gauge_config_t& config)
+    : m_config(config) {
+}
+
+battery_level_t BatteryGauge::levelFor(float percent) const {
+    battery_level_t target = percent < m_config.critical_percent ? BATTERY_LEVEL_CRITICAL :
+                             percent < m_config.low_percent ? BATTERY_LEVEL_LOW : BATTERY_LEVEL_NORMAL;
+    battery_level_t level = m_status.level;
+    if (target >= level) {
+        return target;
+    }
+
+    // Recover one threshold at a time, each only with the margin to spare
+    if (level == BATTERY_LEVEL_CRITICAL && percent >= m_config.critical_percent + m_config.hysteresis_percent) {
+        level = BATTERY_LEVEL_LOW;
+    }
+    if (level == BATTERY_LEVEL_LOW && percent >= m_config.low_percent + m_config.hysteresis_percent) {
+        level = BATTERY_LEVEL_NORMAL;
+    }
+    return level;
+}
+
+bool BatteryGauge::addSample(uint32_t pin_mv, float load_ma) {
+    if (load_ma < 0.0f) {
+        load_ma = 0.0f;
+    }
+    float battery_mv = pin_mv * m_config.divider;
+    float ocv = battery_mv + load_ma * m_config.internal_mohm / 1000.0f;
+
+    if (m_status.samples == 0) {
+        m_ocv = ocv;
+        m_status.load_ma = load_ma;
+    } else {
+        m_ocv += m_config.voltage_alpha * (ocv - m_ocv);
+        m_status.load_ma += m_config.current_alpha * (load_ma - m_status.load_ma);
+    }
+    m_status.samples++;
+    m_status.valid = true;
+    m_status.battery_mv = (uint32_t)(battery_mv + 0.5f);
+    m_status.ocv_mv = (uint32_t)(m_ocv + 0.5f);
+    m_status.percent = battery_percent_from_ocv(m_status.ocv_mv);
+    m_status.minutes = m_status.load_ma > 0.0f ?
+        (uint32_t)(m_status.percent / 100.0f * m_config.capacity_mah / m_status.load_ma * 60.0f) : 0;
+
+    battery_level_t level = levelFor(m_status.percent);
+    if (level == m_status.level) {
+        return false;
+    }
+    m_status.level = level;
+    m_status.level_changes++;
+    return true;
+}
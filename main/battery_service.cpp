@@ -0,0 +1,215 @@
+/**
+ * @file battery_service.cpp
+ * @brief Battery fuel gauge and battery-aware rates
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/battery_service.h"
+#include "include/power_service.h"
+#include "include/link_adaptation.h"
+#include "include/metrics_registry.h"
+#include "include/board_profile.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_log.h"
+#include <atomic>
+#include <new>
+
+static const char* BATTERY_TAG = "BATTERY_SERVICE";
+
+// Full scale of an uncalibrated 12-bit reading at 12 dB attenuation
+#define BATTERY_UNCALIBRATED_FULL_SCALE_MV 3100
+
+static BatteryGauge* s_gauge = nullptr;
+static battery_gauge_config_t s_config;     // Read without a lock; fixed once the task runs
+static TaskHandle_t s_task = NULL;
+static std::atomic<uint8_t> s_level(BATTERY_LEVEL_NORMAL);
+
+static portMUX_TYPE s_statusLock = portMUX_INITIALIZER_UNLOCKED;
+static battery_status_t s_status;
+
+static adc_oneshot_unit_handle_t s_adc = NULL;
+static adc_channel_t s_channel;
+static adc_cali_handle_t s_cali = NULL;
+static uint32_t s_publishedLevelChanges = 0;
+
+static bool create_calibration(adc_unit_t unit) {
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cali = {
+        .unit_id = unit,
+        .chan = s_channel,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT
+    };
+    return adc_cali_create_scheme_curve_fitting(&cali, &s_cali) == ESP_OK;
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cali = {
+        .unit_id = unit,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT
+    };
+    return adc_cali_create_scheme_line_fitting(&cali, &s_cali) == ESP_OK;
+#else
+    (void)unit;
+    return false;
+#endif
+}
+
+static bool setup_adc(int pin) {
+    adc_unit_t unit;
+    if (adc_oneshot_io_to_channel(pin, &unit, &s_channel) != ESP_OK) {
+        return false;
+    }
+    adc_oneshot_unit_init_cfg_t init = {};
+    init.unit_id = unit;
+    init.ulp_mode = ADC_ULP_MODE_DISABLE;
+    if (adc_oneshot_new_unit(&init, &s_adc) != ESP_OK) {
+        return false;
+    }
+    adc_oneshot_chan_cfg_t channel = {};
+    channel.atten = ADC_ATTEN_DB_12;
+    channel.bitwidth = ADC_BITWIDTH_DEFAULT;
+    if (adc_oneshot_config_channel(s_adc, s_channel, &channel) != ESP_OK) {
+        adc_oneshot_del_unit(s_adc);
+        s_adc = NULL;
+        return false;
+    }
+    if (!create_calibration(unit)) {
+        s_cali = NULL;
+        ESP_LOGW(BATTERY_TAG, "No ADC calibration; battery readings are approximate");
+    }
+    return true;
+}
+
+// Averaged pin voltage in mV
+static bool read_pin_mv(uint32_t* mv) {
+    int sum = 0;
+    for (int i = 0; i < BATTERY_SERVICE_OVERSAMPLE; i++) {
+        int raw;
+        if (adc_oneshot_read(s_adc, s_channel, &raw) != ESP_OK) {
+            return false;
+        }
+        sum += raw;
+    }
+    int raw = sum / BATTERY_SERVICE_OVERSAMPLE;
+    int voltage;
+    if (!s_cali || adc_cali_raw_to_voltage(s_cali, raw, &voltage) != ESP_OK) {
+        voltage = raw * BATTERY_UNCALIBRATED_FULL_SCALE_MV / 4095;
+    }
+    *mv = (uint32_t)voltage;
+    return true;
+}
+
+// What the board draws in the current power state, from the current model.
+// CPU load per state as host/power/power_sim measures it. A radio without
+// power save is counted as awake. A lower codec complexity is never counted:
+// the voice codec is not running yet (LinkAdaptation::codecAdaptationSupported()).
+static float load_ma(void) {
+    static const float CPU_LOAD[POWER_STATE_COUNT] = { 0.01f, 0.01f, 0.06f, 0.15f };
+    static const power_config_t power = power_default_config();
+    static const power_current_model_t model = power_default_current_model();
+    power_state_t state = power_service_state();
+    power_policy_t policy = power.policy[state];
+    if (!HaLowMeshManager::getInstance().radioPowerSaveSupported()) {
+        policy.radio_wake_ms = 0;
+    }
+    return power_estimate_current_ma(model, policy, CPU_LOAD[state], power_policy_wakes_per_second(policy),
+                                     state == POWER_STATE_TRANSMITTING, state >= POWER_STATE_LISTENING);
+}
+
+static void apply_level(battery_level_t level, const battery_status_t& status) {
+    const battery_policy_t& policy = s_config.policy[level];
+    LinkAdaptation& adaptation = LinkAdaptation::getInstance();
+    adaptation.setCodecComplexity(policy.codec_complexity);
+    ESP_LOGI(BATTERY_TAG, "Battery %s at %.0f%% (%u mV, ~%u min): beacon %u ms, CoT %u s, codec complexity %d%s",
+             battery_level_name(level), status.percent, (unsigned)status.ocv_mv, (unsigned)status.minutes,
+             (unsigned)policy.beacon_ms, (unsigned)(policy.cot_ms / 1000), policy.codec_complexity,
+             adaptation.codecAdaptationSupported() ? "" : " (not applied, codec not running)");
+}
+
+static void publish(const battery_status_t& status) {
+    metrics_gauge_set(METRIC_BATTERY_PERCENT, (int32_t)(status.percent + 0.5f));
+    metrics_gauge_set(METRIC_BATTERY_MV, (int32_t)status.battery_mv);
+    metrics_gauge_set(METRIC_BATTERY_MINUTES, (int32_t)status.minutes);
+    metrics_gauge_set(METRIC_BATTERY_LEVEL, (int32_t)status.level);
+    metrics_counter_add(METRIC_BATTERY_LEVEL_CHANGES, status.level_changes - s_publishedLevelChanges);
+    s_publishedLevelChanges = status.level_changes;
+}
+
+static void battery_task(void* pvParameters) {
+    for (;;) {
+        uint32_t mv;
+        if (read_pin_mv(&mv)) {
+            bool changed = s_gauge->addSample(mv, load_ma());
+            const battery_status_t& status = s_gauge->status();
+            portENTER_CRITICAL(&s_statusLock);
+            s_status = status;
+            portEXIT_CRITICAL(&s_statusLock);
+            s_level = (uint8_t)status.level;
+            if (changed) {
+                apply_level(status.level, status);
+            }
+            publish(status);
+        } else {
+            ESP_LOGW(BATTERY_TAG, "ADC read failed");
+        }
+        vTaskDelay(pdMS_TO_TICKS(BATTERY_SERVICE_SAMPLE_MS));
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int battery_service_init(void) {
+    if (s_gauge) {
+        return 0;
+    }
+    s_config = battery_gauge_default_config();
+
+    int pin = Board::pin_battery_adc;
+    if (pin < 0 || !setup_adc(pin)) {
+        ESP_LOGW(BATTERY_TAG, "No battery ADC on this board; running at full rates");
+        return 0;
+    }
+
+    s_gauge = new (std::nothrow) BatteryGauge(s_config);
+    if (!s_gauge) {
+        ESP_LOGE(BATTERY_TAG, "Out of memory");
+        return -1;
+    }
+    if (xTaskCreatePinnedToCore(battery_task, "Battery", BATTERY_SERVICE_TASK_STACK_SIZE, NULL,
+                                BATTERY_SERVICE_TASK_PRIORITY, &s_task, 0) != pdPASS) {
+        ESP_LOGE(BATTERY_TAG, "Failed to create battery task");
+        return -1;
+    }
+    return 0;
+}
+
+bool battery_service_get_status(battery_status_t* status) {
+    if (!s_task || !status) {
+        return false;
+    }
+    portENTER_CRITICAL(&s_statusLock);
+    *status = s_status;
+    portEXIT_CRITICAL(&s_statusLock);
+    return status->valid;
+}
+
+battery_level_t battery_service_level(void) {
+    return (battery_level_t)s_level.load();
+}
+
+battery_policy_t battery_service_policy(void) {
+    if (!s_task) {
+        return battery_gauge_default_config().policy[BATTERY_LEVEL_NORMAL];
+    }
+    return s_config.policy[s_level.load()];
+}
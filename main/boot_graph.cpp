@@ -0,0 +1,130 @@
+/**
+ * @file boot_graph.cpp
+ * @brief Boot stages, their dependencies and the boot timeline
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/boot_graph.h"
+
+const char* boot_stage_state_name(boot_stage_state_t state) {
+    switch (state) {
+        case BOOT_STAGE_PENDING: return "pending";
+        case BOOT_STAGE_RUNNING: return "running";
+        case BOOT_STAGE_DONE: return "done";
+        case BOOT_STAGE_FAILED: return "failed";
+        case BOOT_STAGE_SKIPPED: return "skipped";
+        default: return "?";
+    }
+}
+
+bool BootGraph::add(int id, const char* name, boot_stage_fn_t fn, uint32_t deps, bool lazy) {
+    if (id < 0 || id >= BOOT_MAX_STAGES || exists(id) || !name) {
+        return false;
+    }
+    // Only stages added earlier, which keeps the graph acyclic
+    if ((deps & ~m_present) != 0) {
+        return false;
+    }
+    if (!lazy) {
+        for (int dep = 0; dep < BOOT_MAX_STAGES; dep++) {
+            if ((deps & BOOT_BIT(dep)) && m_stages[dep].lazy) {
+                return false;
+            }
+        }
+    }
+
+    boot_stage_t& stage = m_stages[id];
+    stage.name = name;
+    stage.fn = fn;
+    stage.deps = deps;
+    stage.lazy = lazy;
+    stage.core = -1;
+    m_present |= BOOT_BIT(id);
+    return true;
+}
+
+int BootGraph::take(int64_t now_us, int core, uint32_t among) {
+    for (int id = 0; id < BOOT_MAX_STAGES; id++) {
+        boot_stage_t& stage = m_stages[id];
+        if (!exists(id) || !(among & BOOT_BIT(id)) || stage.state != BOOT_STAGE_PENDING || !wanted(stage)) {
+            continue;
+        }
+        if ((stage.deps & ~m_done) != 0) {
+            continue;
+        }
+        stage.state = BOOT_STAGE_RUNNING;
+        stage.start_us = now_us;
+        stage.core = core;
+        m_running |= BOOT_BIT(id);
+        return id;
+    }
+    return -1;
+}
+
+uint32_t BootGraph::finish(int id, int result, int64_t now_us) {
+    if (!exists(id) || m_stages[id].state != BOOT_STAGE_RUNNING) {
+        return 0;
+    }
+    boot_stage_t& stage = m_stages[id];
+    stage.result = result;
+    stage.end_us = now_us;
+    stage.state = result == 0 ? BOOT_STAGE_DONE : BOOT_STAGE_FAILED;
+    m_running &= ~BOOT_BIT(id);
+    m_ended |= BOOT_BIT(id);
+    if (result == 0) {
+        m_done |= BOOT_BIT(id);
+        return BOOT_BIT(id);
+    }
+
+    // Dependents have higher ids, so one pass reaches the indirect ones
+    uint32_t failed = BOOT_BIT(id);
+    for (int next = id + 1; next < BOOT_MAX_STAGES; next++) {
+        boot_stage_t& dependent = m_stages[next];
+        if (exists(next) && dependent.state == BOOT_STAGE_PENDING && (dependent.deps & failed)) {
+            dependent.state = BOOT_STAGE_SKIPPED;
+            dependent.start_us = now_us;
+            dependent.end_us = now_us;
+            failed |= BOOT_BIT(next);
+            m_ended |= BOOT_BIT(next);
+        }
+    }
+    return failed;
+}
+
+bool BootGraph::request(int id) {
+    if (!exists(id)) {
+        return false;
+    }
+    m_stages[id].requested = true;
+    for (int dep = id - 1; dep >= 0; dep--) {
+        if (m_stages[id].deps & BOOT_BIT(dep)) {
+            request(dep);
+        }
+    }
+    return true;
+}
+
+uint32_t BootGraph::closure(int id) const {
+    if (!exists(id)) {
+        return 0;
+    }
+    uint32_t mask = BOOT_BIT(id);
+    for (int dep = id - 1; dep >= 0; dep--) {
+        if (m_stages[id].deps & BOOT_BIT(dep)) {
+            mask |= closure(dep);
+        }
+    }
+    return mask;
+}
+
+bool BootGraph::settled() const {
+    for (int id = 0; id < BOOT_MAX_STAGES; id++) {
+        if (exists(id) && wanted(m_stages[id]) && !(m_ended & BOOT_BIT(id))) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file boot_sequence.cpp
+ * @brief Parallel start-up from a stage graph, readiness waits and the boot timeline
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/boot_sequence.h"
+#include "include/metrics_registry.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <atomic>
+#include <stdio.h>
+
+static const char* BOOT_TAG = "BOOT";
+
+static BootGraph* s_graph = nullptr;
+static SemaphoreHandle_t s_lock = NULL;         // Guards s_graph
+static EventGroupHandle_t s_ended = NULL;       // BOOT_BIT() of every stage that has ended
+static SemaphoreHandle_t s_workersDone = NULL;
+static std::atomic<uint32_t> s_voiceReadyMs(0);
+
+static TickType_t to_ticks(uint32_t timeout_ms) {
+    return timeout_ms == BOOT_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
+
+static uint32_t to_ms(int64_t us) {
+    return (uint32_t)(us / 1000);
+}
+
+static bool graph_ready(void) {
+    return s_graph && s_lock && s_ended;
+}
+
+/**
+ * @brief Run stages from `among` on this task until `until` have all ended;
+ *        until == 0 runs until the graph has settled
+ */
+static bool work(uint32_t among, uint32_t until, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        uint32_t ended = s_graph->endedMask();
+        bool finished = until ? (ended & until) == until : s_graph->settled();
+        int id = finished ? -1 : s_graph->take(esp_timer_get_time(), xPortGetCoreID(), among);
+        boot_stage_fn_t fn = id >= 0 ? s_graph->stage(id).fn : nullptr;
+        xSemaphoreGive(s_lock);
+        if (finished) {
+            return true;
+        }
+
+        if (id >= 0) {
+            int result = fn ? fn() : 0;
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            uint32_t bits = s_graph->finish(id, result, esp_timer_get_time());
+            xSemaphoreGive(s_lock);
+            if (result != 0) {
+                ESP_LOGE(BOOT_TAG, "Stage %s failed (%d), skipping what depends on it",
+                         s_graph->stage(id).name, result);
+            }
+            xEventGroupSetBits(s_ended, bits);
+            continue;
+        }
+
+        // Nothing ready here: wait for any stage still running to end
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && waited >= timeout) {
+            return false;
+        }
+        EventBits_t pending = (EventBits_t)(~ended & ((1u << BOOT_MAX_STAGES) - 1));
+        xEventGroupWaitBits(s_ended, pending, pdFALSE, pdFALSE,
+                            timeout == portMAX_DELAY ? portMAX_DELAY : timeout - waited);
+    }
+}
+
+static void worker_task(void* pvParameters) {
+    work(~0u, 0, portMAX_DELAY);
+    xSemaphoreGive(s_workersDone);
+    vTaskDelete(NULL);
+}
+
+static void log_timeline(void) {
+    ESP_LOGI(BOOT_TAG, "Boot timeline (ms since timer start):");
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int id = 0; id < BOOT_MAX_STAGES; id++) {
+        if (!s_graph->exists(id)) {
+            continue;
+        }
+        const boot_stage_t& stage = s_graph->stage(id);
+        if (stage.state == BOOT_STAGE_PENDING) {
+            ESP_LOGI(BOOT_TAG, "  %-12s %s", stage.name, stage.lazy ? "lazy, not started" : "pending");
+            continue;
+        }
+        ESP_LOGI(BOOT_TAG, "  %-12s core %d %6u - %6u  %5u ms  %s", stage.name, stage.core,
+                 (unsigned)to_ms(stage.start_us), (unsigned)to_ms(stage.end_us),
+                 (unsigned)to_ms(stage.end_us - stage.start_us), boot_stage_state_name(stage.state));
+    }
+    xSemaphoreGive(s_lock);
+    if (s_voiceReadyMs.load()) {
+        ESP_LOGI(BOOT_TAG, "  %-12s %6u", "voice ready", (unsigned)s_voiceReadyMs.load());
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool boot_sequence_build(BootGraph* graph, const boot_stage_fn_t fns[BOOT_STAGE_COUNT]) {
+    if (!graph || graph->exists(BOOT_STAGE_NVS)) {
+        return false;
+    }
+    // The radio waits only for its configuration; the services that listen
+    // to the mesh add their listeners while it comes up
+    graph->add(BOOT_STAGE_NVS, "nvs", fns[BOOT_STAGE_NVS], 0);
+    graph->add(BOOT_STAGE_CONFIG, "config", fns[BOOT_STAGE_CONFIG], BOOT_BIT(BOOT_STAGE_NVS));
+    graph->add(BOOT_STAGE_ERRORS, "errors", fns[BOOT_STAGE_ERRORS], 0);
+    graph->add(BOOT_STAGE_EXECUTOR, "executor", fns[BOOT_STAGE_EXECUTOR], BOOT_BIT(BOOT_STAGE_ERRORS));
+    graph->add(BOOT_STAGE_POWER, "power", fns[BOOT_STAGE_POWER], 0);
+    graph->add(BOOT_STAGE_RADIO, "radio", fns[BOOT_STAGE_RADIO],
+               BOOT_BIT(BOOT_STAGE_CONFIG) | BOOT_BIT(BOOT_STAGE_EXECUTOR) | BOOT_BIT(BOOT_STAGE_POWER));
+    graph->add(BOOT_STAGE_SHARED_DATA, "shared_data", fns[BOOT_STAGE_SHARED_DATA], 0);
+    graph->add(BOOT_STAGE_STORAGE, "storage", fns[BOOT_STAGE_STORAGE], 0);
+    graph->add(BOOT_STAGE_TALKGROUP, "talkgroup", fns[BOOT_STAGE_TALKGROUP], BOOT_BIT(BOOT_STAGE_NVS));
+    graph->add(BOOT_STAGE_FLOOR, "floor", fns[BOOT_STAGE_FLOOR], BOOT_BIT(BOOT_STAGE_TALKGROUP));
+    graph->add(BOOT_STAGE_OUTBOX, "outbox", fns[BOOT_STAGE_OUTBOX],
+               BOOT_BIT(BOOT_STAGE_STORAGE) | BOOT_BIT(BOOT_STAGE_EXECUTOR));
+    graph->add(BOOT_STAGE_TELEMETRY, "telemetry", fns[BOOT_STAGE_TELEMETRY], BOOT_BIT(BOOT_STAGE_SHARED_DATA));
+    graph->add(BOOT_STAGE_RECORDER, "recorder", fns[BOOT_STAGE_RECORDER], BOOT_BIT(BOOT_STAGE_STORAGE));
+    graph->add(BOOT_STAGE_HISTORY, "history", fns[BOOT_STAGE_HISTORY],
+               BOOT_BIT(BOOT_STAGE_NVS) | BOOT_BIT(BOOT_STAGE_STORAGE));
+    graph->add(BOOT_STAGE_BATTERY, "battery", fns[BOOT_STAGE_BATTERY], BOOT_BIT(BOOT_STAGE_POWER));
+
+    // Every service a task calls into, so none sees one half started
+    graph->add(BOOT_STAGE_TASKS, "tasks", fns[BOOT_STAGE_TASKS],
+               BOOT_BIT(BOOT_STAGE_CONFIG) | BOOT_BIT(BOOT_STAGE_EXECUTOR) | BOOT_BIT(BOOT_STAGE_SHARED_DATA) |
+               BOOT_BIT(BOOT_STAGE_TALKGROUP) | BOOT_BIT(BOOT_STAGE_FLOOR) | BOOT_BIT(BOOT_STAGE_OUTBOX) |
+               BOOT_BIT(BOOT_STAGE_TELEMETRY) | BOOT_BIT(BOOT_STAGE_RECORDER) | BOOT_BIT(BOOT_STAGE_HISTORY) |
+               BOOT_BIT(BOOT_STAGE_BATTERY));
+    graph->add(BOOT_STAGE_CAMERA, "camera", fns[BOOT_STAGE_CAMERA], BOOT_BIT(BOOT_STAGE_EXECUTOR));
+    graph->add(BOOT_STAGE_OTA, "ota", fns[BOOT_STAGE_OTA],
+               BOOT_BIT(BOOT_STAGE_STORAGE) | BOOT_BIT(BOOT_STAGE_EXECUTOR));
+    graph->add(BOOT_STAGE_BLUETOOTH, "bluetooth", fns[BOOT_STAGE_BLUETOOTH], 0, true);
+    return true;
+}
+
+int boot_sequence_run(BootGraph* graph) {
+    if (!graph || s_graph) {
+        return -1;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    s_ended = xEventGroupCreate();
+    s_workersDone = xSemaphoreCreateCounting(BOOT_SEQUENCE_WORKERS, 0);
+    if (!s_lock || !s_ended || !s_workersDone) {
+        ESP_LOGE(BOOT_TAG, "Out of memory");
+        return -1;
+    }
+    s_graph = graph;
+
+    int64_t start_us = esp_timer_get_time();
+    int workers = 0;
+    for (int i = 0; i < BOOT_SEQUENCE_WORKERS; i++) {
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "Boot%d", i);
+        if (xTaskCreatePinnedToCore(worker_task, name, BOOT_SEQUENCE_WORKER_STACK_SIZE, NULL,
+                                    BOOT_SEQUENCE_WORKER_PRIORITY, NULL, i % portNUM_PROCESSORS) == pdPASS) {
+            workers++;
+        }
+    }
+    if (workers == 0) {
+        // Still boot, one stage after another on this task
+        ESP_LOGW(BOOT_TAG, "No boot workers, starting sequentially");
+        work(~0u, 0, portMAX_DELAY);
+    }
+    for (int i = 0; i < workers; i++) {
+        xSemaphoreTake(s_workersDone, portMAX_DELAY);
+    }
+
+    int64_t end_us = esp_timer_get_time();
+    log_timeline();
+    uint32_t failed = 0;
+    for (int id = 0; id < BOOT_MAX_STAGES; id++) {
+        const boot_stage_t& stage = graph->stage(id);
+        if (graph->exists(id) && !stage.lazy && stage.state != BOOT_STAGE_DONE) {
+            failed++;
+        }
+    }
+    metrics_gauge_set(METRIC_BOOT_SETTLED_MS, (int32_t)to_ms(end_us));
+    ESP_LOGI(BOOT_TAG, "Boot stages ended at %u ms (%u ms on %d workers), %u failed or skipped",
+             (unsigned)to_ms(end_us), (unsigned)to_ms(end_us - start_us), workers, (unsigned)failed);
+    return failed ? -1 : 0;
+}
+
+bool boot_wait(uint32_t stages, uint32_t timeout_ms) {
+    if (!graph_ready()) {
+        return true;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_ended, (EventBits_t)stages, pdFALSE, pdTRUE, to_ticks(timeout_ms));
+    if ((bits & stages) != stages) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool done = (s_graph->doneMask() & stages) == stages;
+    xSemaphoreGive(s_lock);
+    return done;
+}
+
+int boot_ensure(int stage, uint32_t timeout_ms) {
+    if (!graph_ready()) {
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool known = s_graph->request(stage);
+    uint32_t among = s_graph->closure(stage);
+    bool ranBefore = (s_graph->endedMask() & BOOT_BIT(stage)) != 0;
+    xSemaphoreGive(s_lock);
+    if (!known) {
+        return -1;
+    }
+
+    if (!work(among, BOOT_BIT(stage), to_ticks(timeout_ms))) {
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const boot_stage_t& ended = s_graph->stage(stage);
+    int result = ended.state == BOOT_STAGE_SKIPPED ? -1 : ended.result;
+    uint32_t ms = to_ms(ended.end_us - ended.start_us);
+    xSemaphoreGive(s_lock);
+    if (!ranBefore) {
+        ESP_LOGI(BOOT_TAG, "Lazy stage %s: %d after %u ms", s_graph->stage(stage).name, result, (unsigned)ms);
+    }
+    return result;
+}
+
+void boot_voice_ready(void) {
+    uint32_t ms = to_ms(esp_timer_get_time());
+    uint32_t unset = 0;
+    if (!s_voiceReadyMs.compare_exchange_strong(unset, ms ? ms : 1)) {
+        return;
+    }
+    metrics_gauge_set(METRIC_BOOT_VOICE_READY_MS, (int32_t)ms);
+    ESP_LOGI(BOOT_TAG, "Voice ready %u ms after timer start", (unsigned)ms);
+}
+
+uint32_t boot_voice_ready_ms(void) {
+    return s_voiceReadyMs.load();
+}
@@ -0,0 +1,487 @@
+/**
+ * @file bulk_service.cpp
+ * @brief Large payload delivery over the mesh on BULK_PORT
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/bulk_service.h"
+#include "include/config.h"
+#include "include/metrics_registry.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+static const char* BULK_TAG = "BULK_SERVICE";
+
+#define BULK_STATS_MUTEX_TIMEOUT pdMS_TO_TICKS(100)
+#define BULK_SERVICE_CONTENT_TYPES 8
+
+// Work handed to the bulk task
+typedef enum {
+    BULK_EVENT_FRAME = 0,                   // Bulk frame from a peer
+    BULK_EVENT_SEND                         // New payload to send
+} bulk_event_type_t;
+
+// A payload and where it goes; shared by a multicast and its unicast follow-ups
+struct BulkJob {
+    uint32_t transferId;
+    std::vector<std::string> peers;
+    std::shared_ptr<const std::vector<uint8_t>> payload;
+    uint8_t contentType;
+    uint32_t previewSize;
+    BulkSendCallbacks callbacks;
+    uint32_t startMs;
+};
+
+typedef struct {
+    bulk_event_type_t type;
+    char peer_id[BULK_SERVICE_PEER_ID_LEN];
+    uint8_t* data;
+    uint16_t length;
+    BulkJob* job;
+} bulk_event_t;
+
+// One payload on its way to one peer
+struct UnicastSend {
+    std::shared_ptr<BulkJob> job;
+    uint8_t attempts = 0;
+    bool started = false;
+    bool previewReported = false;
+    uint32_t retryAtMs = 0;
+    uint32_t retransmitsAtStart = 0;
+};
+
+// Sender, receiver and waiting transfers per peer; owned by the bulk task
+struct BulkPeer {
+    std::unique_ptr<BulkSender> sender;
+    std::unique_ptr<BulkReceiver> receiver;
+    std::deque<UnicastSend> sends;          // The front one is in progress
+};
+
+// One payload on its way to a group
+struct MulticastSend {
+    std::shared_ptr<BulkJob> job;
+    bool started = false;
+    uint32_t retransmitsAtStart = 0;
+    std::set<std::string> previewReported;
+    std::set<std::string> doneReported;
+};
+
+static std::map<std::string, BulkPeer> s_peers;
+static std::unique_ptr<BulkMulticastSender> s_multicastSender;   // Keeps the group rate between transfers
+static std::deque<MulticastSend> s_multicasts;
+static QueueHandle_t s_eventQueue = nullptr;
+static SemaphoreHandle_t s_statsMutex = nullptr;
+static bulk_service_stats_t s_stats;
+static bulk_config_t s_bulkConfig;
+static std::atomic<bulk_receive_handler_t> s_handlers[BULK_SERVICE_CONTENT_TYPES];
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+template <typename F>
+static void update_stats(F update) {
+    if (xSemaphoreTake(s_statsMutex, BULK_STATS_MUTEX_TIMEOUT) == pdTRUE) {
+        update(s_stats);
+        xSemaphoreGive(s_statsMutex);
+    }
+}
+
+// ============================================================================
+// MESH HOOKS
+// ============================================================================
+
+static void on_mesh_data(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (!bulk_is_frame(data.data(), data.size()) || data.size() > UINT16_MAX ||
+        peer_id.size() >= BULK_SERVICE_PEER_ID_LEN) {
+        return;
+    }
+    bulk_event_t event = {};
+    event.type = BULK_EVENT_FRAME;
+    strncpy(event.peer_id, peer_id.c_str(), sizeof(event.peer_id) - 1);
+    event.data = (uint8_t*)malloc(data.size());
+    if (!event.data) {
+        return;
+    }
+    memcpy(event.data, data.data(), data.size());
+    event.length = (uint16_t)data.size();
+    if (xQueueSend(s_eventQueue, &event, 0) != pdTRUE) {
+        free(event.data);   // The sender repeats what was not acknowledged
+    }
+}
+
+// Frames are repeated anyway; keep them out of the offline cache
+static bool send_frame(const std::string* peer_id, const std::vector<uint8_t>& frame) {
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    if (!mesh.get_connection_status()) {
+        return false;
+    }
+    bool sent = peer_id ? mesh.sendUdpUnicast(*peer_id, frame.data(), frame.size(), BULK_PORT)
+                        : mesh.sendUdpMulticast(frame.data(), frame.size(), BULK_PORT);
+    if (sent) {
+        metrics_counter_add(METRIC_BULK_BYTES_SENT, frame.size());
+        update_stats([&frame](bulk_service_stats_t& stats) { stats.bytes_sent += frame.size(); });
+    }
+    return sent;
+}
+
+static void deliver(const std::string& peer_id, const BulkOffer& offer, const uint8_t* data, size_t length,
+                    bool complete) {
+    bulk_receive_handler_t handler =
+        offer.content_type < BULK_SERVICE_CONTENT_TYPES ? s_handlers[offer.content_type].load() : nullptr;
+    if (!handler) {
+        if (complete) {
+            ESP_LOGW(BULK_TAG, "No handler for content type %u from %s", offer.content_type, peer_id.c_str());
+        }
+        return;
+    }
+    handler(peer_id.c_str(), data, length, complete);
+}
+
+static BulkPeer* get_peer(const std::string& peer_id) {
+    auto it = s_peers.find(peer_id);
+    if (it != s_peers.end()) {
+        return &it->second;
+    }
+    BulkPeer peer;
+    BulkSendFunction unicast = [peer_id](const std::vector<uint8_t>& frame) { return send_frame(&peer_id, frame); };
+    peer.sender.reset(new (std::nothrow) BulkSender(unicast, s_bulkConfig));
+    peer.receiver.reset(new (std::nothrow) BulkReceiver(unicast, s_bulkConfig, esp_random()));
+    if (!peer.sender || !peer.receiver) {
+        ESP_LOGE(BULK_TAG, "Out of memory for peer %s", peer_id.c_str());
+        return nullptr;
+    }
+    peer.receiver->setMulticastSend([](const std::vector<uint8_t>& frame) { return send_frame(nullptr, frame); });
+    peer.receiver->setPreviewCallback([peer_id](const BulkOffer& offer, const uint8_t* data, size_t length) {
+        deliver(peer_id, offer, data, length, false);
+    });
+    peer.receiver->setCompleteCallback([peer_id](const BulkOffer& offer, std::vector<uint8_t>& payload) {
+        ESP_LOGI(BULK_TAG, "Received %u bytes from %s", (unsigned)payload.size(), peer_id.c_str());
+        metrics_counter_inc(METRIC_BULK_TRANSFERS_RECEIVED);
+        update_stats([](bulk_service_stats_t& stats) { stats.transfers_received++; });
+        deliver(peer_id, offer, payload.data(), payload.size(), true);
+    });
+    return &(s_peers[peer_id] = std::move(peer));
+}
+
+// ============================================================================
+// SENDING
+// ============================================================================
+
+static void report_done(const BulkJob& job, const std::string& peer_id, bool delivered, uint32_t retransmits,
+                        uint32_t nowMs) {
+    uint32_t elapsedMs = nowMs - job.startMs;
+    if (delivered) {
+        metrics_counter_inc(METRIC_BULK_TRANSFERS_SENT);
+        metrics_histogram_record(METRIC_BULK_TRANSFER_TIME_MS, elapsedMs);
+    } else {
+        ESP_LOGW(BULK_TAG, "Giving up sending transfer %08x to %s", (unsigned)job.transferId, peer_id.c_str());
+        metrics_counter_inc(METRIC_BULK_SEND_FAILURES);
+    }
+    metrics_counter_add(METRIC_BULK_RETRANSMITS, retransmits);
+    update_stats([delivered, retransmits, elapsedMs](bulk_service_stats_t& stats) {
+        if (delivered) {
+            stats.transfers_sent++;
+            stats.last_transfer_ms = elapsedMs;
+        } else {
+            stats.send_failures++;
+        }
+        stats.retransmits += retransmits;
+    });
+    if (job.callbacks.onDone) {
+        job.callbacks.onDone(peer_id, delivered, elapsedMs, retransmits);
+    }
+}
+
+static void report_preview(const BulkJob& job, const std::string& peer_id, uint32_t nowMs) {
+    if (job.callbacks.onPreview) {
+        job.callbacks.onPreview(peer_id, nowMs - job.startMs);
+    }
+}
+
+static void queue_unicast(const std::string& peer_id, const std::shared_ptr<BulkJob>& job, uint32_t nowMs) {
+    BulkPeer* peer = get_peer(peer_id);
+    if (!peer || peer->sends.size() >= BULK_SERVICE_MAX_QUEUED) {
+        ESP_LOGW(BULK_TAG, "Too many transfers queued for %s", peer_id.c_str());
+        report_done(*job, peer_id, false, 0, nowMs);
+        return;
+    }
+    UnicastSend send;
+    send.job = job;
+    peer->sends.push_back(send);
+}
+
+static void tick_unicast(const std::string& peer_id, BulkPeer& peer, uint32_t nowMs) {
+    if (peer.sends.empty()) {
+        return;
+    }
+    UnicastSend& send = peer.sends.front();
+    const BulkJob& job = *send.job;
+    BulkSender& sender = *peer.sender;
+
+    if (send.started && sender.state() == BULK_SEND_FAILED) {
+        if (!send.retryAtMs) {
+            send.retryAtMs = nowMs + BULK_SERVICE_RETRY_DELAY_MS;
+        }
+        if ((int32_t)(nowMs - send.retryAtMs) < 0) {
+            return;
+        }
+        send.retryAtMs = 0;
+        send.started = false;
+    }
+    if (!send.started) {
+        if (send.attempts == 0) {
+            send.retransmitsAtStart = sender.stats().retransmits;
+        }
+        // Same transfer ID on every attempt: the receiver keeps what arrived
+        if (send.attempts >= BULK_SERVICE_SEND_ATTEMPTS ||
+            !sender.start(job.transferId, job.payload, job.contentType, job.previewSize, nowMs)) {
+            report_done(job, peer_id, false, sender.stats().retransmits - send.retransmitsAtStart, nowMs);
+            peer.sends.pop_front();
+            return;
+        }
+        send.attempts++;
+        send.started = true;
+    }
+
+    sender.tick(nowMs);
+
+    if (!send.previewReported && job.previewSize && sender.ackedBytes() >= job.previewSize) {
+        send.previewReported = true;
+        report_preview(job, peer_id, nowMs);
+    }
+    if (sender.state() == BULK_SEND_COMPLETE) {
+        uint32_t retransmits = sender.stats().retransmits - send.retransmitsAtStart;
+        ESP_LOGI(BULK_TAG, "Transfer %08x to %s done in %u ms, %u chunks resent", (unsigned)job.transferId,
+                 peer_id.c_str(), (unsigned)(nowMs - job.startMs), (unsigned)retransmits);
+        report_done(job, peer_id, true, retransmits, nowMs);
+        peer.sends.pop_front();
+    }
+}
+
+static void tick_multicast(uint32_t nowMs) {
+    if (s_multicasts.empty()) {
+        return;
+    }
+    MulticastSend& send = s_multicasts.front();
+    const BulkJob& job = *send.job;
+    BulkMulticastSender& sender = *s_multicastSender;
+
+    if (!send.started) {
+        send.started = true;
+        send.retransmitsAtStart = sender.stats().retransmits;
+        if (!sender.start(job.transferId, job.payload, job.contentType, job.previewSize, job.peers, nowMs)) {
+            for (const std::string& peer_id : job.peers) {
+                report_done(job, peer_id, false, 0, nowMs);
+            }
+            s_multicasts.pop_front();
+            return;
+        }
+        metrics_counter_inc(METRIC_BULK_MULTICASTS);
+        update_stats([](bulk_service_stats_t& stats) { stats.multicasts++; });
+    }
+
+    sender.tick(nowMs);
+
+    uint32_t retransmits = sender.stats().retransmits - send.retransmitsAtStart;
+    for (const std::string& peer_id : job.peers) {
+        if (job.previewSize && sender.receivedBytes(peer_id) >= job.previewSize &&
+            send.previewReported.insert(peer_id).second) {
+            report_preview(job, peer_id, nowMs);
+        }
+        if (sender.receiverComplete(peer_id) && send.doneReported.insert(peer_id).second) {
+            report_done(job, peer_id, true, retransmits, nowMs);
+        }
+    }
+
+    bulk_send_state_t state = sender.state();
+    if (state != BULK_SEND_COMPLETE && state != BULK_SEND_FAILED) {
+        return;
+    }
+    ESP_LOGI(BULK_TAG, "Multicast %08x ended after %u ms at %u kbps, %u chunks resent", (unsigned)job.transferId,
+             (unsigned)(nowMs - job.startMs), (unsigned)sender.rateKbps(), (unsigned)retransmits);
+    // Whoever fell behind is finished by unicast from where they stopped
+    std::shared_ptr<BulkJob> shared = send.job;
+    for (const std::string& peer_id : sender.incompleteReceivers()) {
+        metrics_counter_inc(METRIC_BULK_UNICAST_FALLBACKS);
+        update_stats([](bulk_service_stats_t& stats) { stats.unicast_fallbacks++; });
+        queue_unicast(peer_id, shared, nowMs);
+    }
+    s_multicasts.pop_front();
+}
+
+static void start_job(BulkJob* raw, uint32_t nowMs) {
+    std::shared_ptr<BulkJob> job(raw);
+    if (job->peers.size() == 1) {
+        queue_unicast(job->peers[0], job, nowMs);
+        return;
+    }
+    MulticastSend send;
+    send.job = job;
+    s_multicasts.push_back(send);
+}
+
+// ============================================================================
+// TASK
+// ============================================================================
+
+static void handle_frame(const bulk_event_t& event, uint32_t nowMs) {
+    std::string peer_id(event.peer_id);
+    BulkPeer* peer = get_peer(peer_id);
+    if (!peer) {
+        return;
+    }
+    if (s_multicastSender) {
+        s_multicastSender->handleFrame(peer_id, event.data, event.length, nowMs);
+    }
+    if (bulk_frame_is_nack(event.data, event.length)) {
+        // About another sender's multicast: lets its other receivers stay quiet
+        uint32_t suppressed = 0;
+        for (auto& entry : s_peers) {
+            BulkReceiver& receiver = *entry.second.receiver;
+            uint32_t before = receiver.stats().nacks_suppressed;
+            receiver.handleFrame(event.data, event.length, nowMs);
+            suppressed += receiver.stats().nacks_suppressed - before;
+        }
+        if (suppressed) {
+            update_stats([suppressed](bulk_service_stats_t& stats) { stats.nacks_suppressed += suppressed; });
+        }
+        return;
+    }
+    peer->sender->handleFrame(event.data, event.length, nowMs);
+    peer->receiver->handleFrame(event.data, event.length, nowMs);
+}
+
+static void bulk_task(void* pvParameters) {
+    for (;;) {
+        bulk_event_t event;
+        if (xQueueReceive(s_eventQueue, &event, pdMS_TO_TICKS(BULK_SERVICE_TICK_MS)) == pdTRUE) {
+            uint32_t nowMs = now_ms();
+            if (event.type == BULK_EVENT_FRAME) {
+                handle_frame(event, nowMs);
+                free(event.data);
+            } else {
+                start_job(event.job, nowMs);
+            }
+        }
+
+        uint32_t nowMs = now_ms();
+        tick_multicast(nowMs);
+        for (auto& entry : s_peers) {
+            tick_unicast(entry.first, entry.second, nowMs);
+            entry.second.receiver->tick(nowMs);
+        }
+    }
+}
+
+static uint32_t queue_job(const std::vector<std::string>& peer_ids, std::shared_ptr<const std::vector<uint8_t>> payload,
+                          uint8_t content_type, uint32_t preview_size, const BulkSendCallbacks& callbacks) {
+    if (!s_eventQueue || !payload || payload->empty() || payload->size() > BULK_MAX_TRANSFER_SIZE ||
+        peer_ids.empty() || peer_ids.size() > BULK_SERVICE_MAX_PEERS) {
+        return 0;
+    }
+    for (const std::string& peer_id : peer_ids) {
+        if (peer_id.empty() || peer_id.size() >= BULK_SERVICE_PEER_ID_LEN) {
+            return 0;
+        }
+    }
+    BulkJob* job = new (std::nothrow) BulkJob();
+    if (!job) {
+        return 0;
+    }
+    job->transferId = esp_random() | 1;     // Never 0
+    job->peers = peer_ids;
+    job->payload = payload;
+    job->contentType = content_type;
+    job->previewSize = preview_size;
+    job->callbacks = callbacks;
+    job->startMs = now_ms();
+    uint32_t transferId = job->transferId;
+
+    bulk_event_t event = {};
+    event.type = BULK_EVENT_SEND;
+    event.job = job;
+    if (xQueueSend(s_eventQueue, &event, 0) != pdTRUE) {
+        delete job;
+        return 0;
+    }
+    return transferId;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void bulk_service_set_handler(uint8_t content_type, bulk_receive_handler_t handler) {
+    if (content_type < BULK_SERVICE_CONTENT_TYPES) {
+        s_handlers[content_type].store(handler);
+    }
+}
+
+int bulk_service_init(void) {
+    if (s_eventQueue) {
+        return 0;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_bulkConfig = bulk_default_config();
+
+    s_multicastSender.reset(new (std::nothrow) BulkMulticastSender(
+        [](const std::vector<uint8_t>& frame) { return send_frame(nullptr, frame); }, s_bulkConfig));
+    s_statsMutex = xSemaphoreCreateMutex();
+    s_eventQueue = xQueueCreate(BULK_SERVICE_EVENT_QUEUE_DEPTH, sizeof(bulk_event_t));
+    if (!s_multicastSender || !s_statsMutex || !s_eventQueue) {
+        ESP_LOGE(BULK_TAG, "Out of memory");
+        return -1;
+    }
+
+    HaLowMeshManager::getInstance().addDataListener(DataCallback::fromFunction<on_mesh_data>());
+
+    if (xTaskCreatePinnedToCore(bulk_task, "Bulk", BULK_SERVICE_TASK_STACK_SIZE, NULL, BULK_SERVICE_TASK_PRIORITY,
+                                NULL, 0) != pdPASS) {
+        ESP_LOGE(BULK_TAG, "Failed to create bulk task");
+        return -1;
+    }
+
+    ESP_LOGI(BULK_TAG, "Bulk service started on port %d, %u byte chunks", BULK_PORT,
+             (unsigned)s_bulkConfig.chunk_size);
+    return 0;
+}
+
+uint32_t bulk_service_send(const std::string& peer_id, std::shared_ptr<const std::vector<uint8_t>> payload,
+                           uint8_t content_type, uint32_t preview_size, const BulkSendCallbacks& callbacks) {
+    return queue_job(std::vector<std::string>(1, peer_id), payload, content_type, preview_size, callbacks);
+}
+
+uint32_t bulk_service_multicast(const std::vector<std::string>& peer_ids,
+                                std::shared_ptr<const std::vector<uint8_t>> payload, uint8_t content_type,
+                                uint32_t preview_size, const BulkSendCallbacks& callbacks) {
+    return queue_job(peer_ids, payload, content_type, preview_size, callbacks);
+}
+
+bool bulk_service_get_stats(bulk_service_stats_t* stats) {
+    if (!s_statsMutex || !stats) {
+        return false;
+    }
+    if (xSemaphoreTake(s_statsMutex, BULK_STATS_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    *stats = s_stats;
+    xSemaphoreGive(s_statsMutex);
+    return true;
+}
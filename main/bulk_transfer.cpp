@@ -0,0 +1,1059 @@
+/**
+ * @file bulk_transfer.cpp
+ * @brief Reliable transfer of large payloads over mesh datagrams
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/bulk_transfer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+#include <algorithm>
+
+static const char* TAG = "BULK_TRANSFER";
+
+// Frame header: magic, protocol version, frame type
+static const uint8_t FRAME_MAGIC[4] = {'A', 'B', 'L', 'K'};
+static const uint8_t PROTOCOL_VERSION = 2;
+static const size_t FRAME_HEADER_SIZE = 6;
+
+enum {
+    FRAME_OFFER = 1,
+    FRAME_CHUNK = 2,
+    FRAME_ACK = 3,
+    FRAME_NACK = 4
+};
+
+// OFFER flags
+static const uint8_t OFFER_MULTICAST = 0x01;
+
+// ACK flags
+static const uint8_t ACK_COMPLETE = 0x01;
+static const uint8_t ACK_REJECTED = 0x02;
+
+// NACK flags
+static const uint8_t NACK_PREVIEW = 0x01;           // Sent because the preview prefix arrived
+
+static const size_t OFFER_SIZE = 20;
+static const size_t CHUNK_HEADER_SIZE = 12;
+static const size_t ACK_MIN_SIZE = 10;              // Without the bitmap
+static const size_t NACK_MIN_SIZE = 12;             // Without the ranges
+static const size_t NACK_RANGE_SIZE = 6;
+static const size_t MAX_SESSIONS = 2;               // Partial transfers kept per sender
+static const size_t COMPLETED_HISTORY = 8;
+static const int32_t PACING_BURST_CHUNKS = 4;       // Multicast chunks that may go out at once
+
+static bool is_due(uint32_t nowMs, uint32_t deadlineMs) {
+    return (int32_t)(nowMs - deadlineMs) >= 0;
+}
+
+static void put_u16(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back((uint8_t)value);
+    out->push_back((uint8_t)(value >> 8));
+}
+
+static void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint16_t get_u16(const uint8_t* data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static std::vector<uint8_t> make_frame(uint8_t type, size_t bodyReserve) {
+    std::vector<uint8_t> frame;
+    frame.reserve(FRAME_HEADER_SIZE + bodyReserve);
+    for (uint8_t byte : FRAME_MAGIC) {
+        frame.push_back(byte);
+    }
+    frame.push_back(PROTOCOL_VERSION);
+    frame.push_back(type);
+    return frame;
+}
+
+static std::vector<uint8_t> make_offer(const BulkOffer& offer, uint8_t flags, uint32_t sentThrough) {
+    std::vector<uint8_t> frame = make_frame(FRAME_OFFER, OFFER_SIZE);
+    put_u32(&frame, offer.transfer_id);
+    put_u32(&frame, offer.size);
+    put_u16(&frame, offer.chunk_size);
+    frame.push_back(offer.content_type);
+    put_u32(&frame, offer.preview_size);
+    frame.push_back(flags);
+    put_u32(&frame, sentThrough);
+    return frame;
+}
+
+static std::vector<uint8_t> make_chunk(const BulkOffer& offer, const std::vector<uint8_t>& payload,
+                                       uint32_t index, uint32_t txSeq) {
+    uint32_t offset = index * offer.chunk_size;
+    size_t length = std::min((uint32_t)offer.chunk_size, offer.size - offset);
+    std::vector<uint8_t> frame = make_frame(FRAME_CHUNK, CHUNK_HEADER_SIZE + length);
+    put_u32(&frame, offer.transfer_id);
+    put_u32(&frame, index);
+    put_u32(&frame, txSeq);
+    frame.insert(frame.end(), payload.begin() + offset, payload.begin() + offset + length);
+    return frame;
+}
+
+static bool make_offer_for(BulkOffer* offer, const std::shared_ptr<const std::vector<uint8_t>>& payload,
+                           uint32_t transferId, uint16_t chunkSize, uint8_t contentType, uint32_t previewSize) {
+    if (!payload || payload->empty() || payload->size() > BULK_MAX_TRANSFER_SIZE || chunkSize == 0) {
+        return false;
+    }
+    offer->transfer_id = transferId;
+    offer->size = (uint32_t)payload->size();
+    offer->chunk_size = chunkSize;
+    offer->content_type = contentType;
+    offer->preview_size = std::min(previewSize, offer->size);
+    return true;
+}
+
+bulk_config_t bulk_default_config(void) {
+    bulk_config_t config;
+    config.chunk_size = BULK_DEFAULT_CHUNK_SIZE;
+    config.initial_window = 4;
+    config.max_window = 64;
+    config.ack_every = 4;
+    config.ack_delay_ms = 50;
+    config.retransmit_timeout_ms = 1000;
+    config.offer_interval_ms = 1000;
+    config.sender_give_up_ms = 15000;
+    config.receiver_keep_ms = 300000;
+    config.multicast_rate_kbps = 400;
+    config.multicast_min_rate_kbps = 50;
+    config.multicast_max_rate_kbps = 4000;
+    config.multicast_loss_threshold = 100;
+    config.poll_interval_ms = 250;
+    config.nack_backoff_ms = 50;
+    return config;
+}
+
+uint16_t bulk_chunk_size_for_mtu(size_t mtu) {
+    if (mtu <= BULK_CHUNK_OVERHEAD) {
+        return 0;
+    }
+    return (uint16_t)std::min(mtu - BULK_CHUNK_OVERHEAD, (size_t)UINT16_MAX);
+}
+
+bool bulk_is_frame(const uint8_t* data, size_t length) {
+    return length >= FRAME_HEADER_SIZE && memcmp(data, FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0 &&
+           data[4] == PROTOCOL_VERSION;
+}
+
+uint32_t bulk_frame_transfer_id(const uint8_t* data, size_t length) {
+    if (!bulk_is_frame(data, length) || length < FRAME_HEADER_SIZE + 4) {
+        return 0;
+    }
+    return get_u32(data + FRAME_HEADER_SIZE);
+}
+
+bool bulk_frame_is_nack(const uint8_t* data, size_t length) {
+    return bulk_is_frame(data, length) && data[5] == FRAME_NACK;
+}
+
+// ============================================================================
+// UNICAST SENDER
+// ============================================================================
+
+BulkSender::BulkSender(BulkSendFunction send, const bulk_config_t& config)
+    : m_send(send), m_config(config), m_state(BULK_SEND_IDLE), m_offer(), m_nextSeq(0),
+      m_highestAckedSeq(0), m_cumulative(0), m_nextNew(0), m_lastAckMs(0), m_nextOfferMs(0), m_cwnd(1),
+      m_ssthresh(0), m_cwndCredit(0), m_recoverySeq(0), m_queueing(false), m_srttMs(0), m_rttVarMs(0),
+      m_minRttMs(0), m_rtoMs(0), m_rtoDeadlineMs(0), m_heardSinceTimeout(false), m_stats() {
+    m_config.max_window = std::max(m_config.max_window, (uint16_t)1);
+    m_config.initial_window = std::min(std::max(m_config.initial_window, (uint16_t)1), m_config.max_window);
+    resetRetransmitTimeout();
+}
+
+bool BulkSender::start(uint32_t transferId, std::shared_ptr<const std::vector<uint8_t>> payload,
+                       uint8_t contentType, uint32_t previewSize, uint32_t nowMs) {
+    if (!make_offer_for(&m_offer, payload, transferId, m_config.chunk_size, contentType, previewSize)) {
+        return false;
+    }
+    m_payload = payload;
+
+    const uint32_t count = m_offer.chunkCount();
+    m_acked.assign((count + 7) / 8, 0);
+    m_resent.assign((count + 7) / 8, 0);
+    m_sentAtMs.assign(count, 0);
+    m_sendSeq.assign(count, 0);
+    m_nextSeq = 1;
+    m_highestAckedSeq = 0;
+    m_cumulative = 0;
+    m_nextNew = 0;
+    m_lastAckMs = nowMs;
+    m_nextOfferMs = nowMs;
+
+    // Every transfer starts cautiously; round trip estimates carry over
+    m_cwnd = m_config.initial_window;
+    m_ssthresh = m_config.max_window;
+    m_cwndCredit = 0;
+    m_recoverySeq = 0;
+    m_queueing = false;
+    m_rtoDeadlineMs = nowMs + m_rtoMs;
+    m_heardSinceTimeout = true;
+    m_state = BULK_SEND_OFFERING;
+    return true;
+}
+
+uint32_t BulkSender::ackedBytes() const {
+    return std::min(m_cumulative * (uint32_t)m_offer.chunk_size, m_offer.size);
+}
+
+void BulkSender::resetRetransmitTimeout() {
+    uint32_t rto = m_srttMs ? m_srttMs + 4 * m_rttVarMs : m_config.retransmit_timeout_ms;
+    m_rtoMs = std::min(std::max(rto, (uint32_t)BULK_MIN_RETRANSMIT_MS), (uint32_t)BULK_MAX_RETRANSMIT_MS);
+}
+
+// RFC 6298 smoothed round trip time and variance. A sample well above the
+// lowest one seen means our frames are waiting in a queue.
+void BulkSender::onRttSample(uint32_t rttMs) {
+    rttMs = std::max(rttMs, (uint32_t)1);
+    if (m_srttMs == 0) {
+        m_srttMs = rttMs;
+        m_rttVarMs = rttMs / 2;
+    } else {
+        uint32_t error = m_srttMs > rttMs ? m_srttMs - rttMs : rttMs - m_srttMs;
+        m_rttVarMs = (3 * m_rttVarMs + error) / 4;
+        m_srttMs = (7 * m_srttMs + rttMs) / 8;
+    }
+    m_minRttMs = m_minRttMs ? std::min(m_minRttMs, rttMs) : rttMs;
+    resetRetransmitTimeout();
+
+    // The receiver may hold an ACK for up to ack_delay_ms; that is no queue
+    uint32_t queueMarginMs = m_config.ack_delay_ms + std::max(m_minRttMs / 2, (uint32_t)BULK_MIN_QUEUE_DELAY_MS);
+    m_queueing = rttMs > m_minRttMs + queueMarginMs;
+    if (m_queueing && m_cwnd < m_ssthresh) {
+        m_ssthresh = std::max(m_cwnd, (uint32_t)2);
+    }
+}
+
+void BulkSender::onChunkAcked() {
+    if (m_recoverySeq) {
+        return;
+    }
+    if (m_cwnd < m_ssthresh) {
+        m_cwnd++;
+    } else if (!m_queueing && ++m_cwndCredit >= m_cwnd) {
+        m_cwndCredit = 0;
+        m_cwnd++;
+    }
+    m_cwnd = std::min(m_cwnd, (uint32_t)m_config.max_window);
+}
+
+void BulkSender::onLoss(bool timeout, uint32_t inFlight) {
+    if (timeout) {
+        if (m_queueing) {
+            m_ssthresh = std::max(inFlight / 2, (uint32_t)2);
+            m_cwnd = 1;
+        } else {
+            m_ssthresh = std::max(m_cwnd / 2, (uint32_t)m_config.initial_window);
+            m_cwnd = m_ssthresh;
+        }
+        // The first resend about to go out ends no recovery: the chunks sent before
+        // it will show up as lost once it is acknowledged
+        m_recoverySeq = m_nextSeq + 1;
+        m_stats.timeouts++;
+    } else {
+        if (m_queueing) {
+            m_ssthresh = std::max(m_cwnd / 2, (uint32_t)2);
+            m_cwnd = m_ssthresh;
+            m_stats.loss_events++;
+        }
+        m_recoverySeq = m_nextSeq;
+    }
+    m_cwndCredit = 0;
+}
+
+bool BulkSender::sendOffer() {
+    return m_send(make_offer(m_offer, 0, 0));
+}
+
+bool BulkSender::sendChunk(uint32_t index, uint32_t nowMs) {
+    std::vector<uint8_t> frame = make_chunk(m_offer, *m_payload, index, m_nextSeq);
+    if (!m_send(frame)) {
+        return false;
+    }
+    if (m_sendSeq[index]) {
+        m_resent[index / 8] |= (uint8_t)(1 << (index % 8));
+        m_stats.retransmits++;
+    }
+    m_sentAtMs[index] = nowMs;
+    m_sendSeq[index] = m_nextSeq++;
+    m_stats.chunks_sent++;
+    m_stats.bytes_sent += frame.size();
+    return true;
+}
+
+void BulkSender::handleFrame(const uint8_t* data, size_t length, uint32_t nowMs) {
+    if (!bulk_is_frame(data, length) || data[5] != FRAME_ACK || length < FRAME_HEADER_SIZE + ACK_MIN_SIZE) {
+        return;
+    }
+    const uint8_t* body = data + FRAME_HEADER_SIZE;
+    if ((m_state != BULK_SEND_OFFERING && m_state != BULK_SEND_SENDING) || get_u32(body) != m_offer.transfer_id) {
+        return;
+    }
+    uint8_t flags = body[4];
+    uint32_t cumulative = get_u32(body + 5);
+    size_t bitmapLength = std::min((size_t)body[9], length - FRAME_HEADER_SIZE - ACK_MIN_SIZE);
+    const uint8_t* bitmap = body + ACK_MIN_SIZE;
+    const uint32_t count = m_offer.chunkCount();
+    m_lastAckMs = nowMs;
+    m_heardSinceTimeout = true;
+    m_stats.acks_received++;
+
+    if (flags & ACK_REJECTED) {
+        ESP_LOGW(TAG, "Transfer %08x rejected by the receiver", (unsigned)m_offer.transfer_id);
+        m_state = BULK_SEND_FAILED;
+        return;
+    }
+    if (flags & ACK_COMPLETE) {
+        cumulative = count;
+    }
+    cumulative = std::min(cumulative, count);
+
+    // Time the most recent send this ACK covers, unless it was a resend
+    uint32_t newestIndex = 0;
+    uint32_t newestSeq = 0;
+    uint32_t newlyAcked = 0;
+    auto markAcked = [&](uint32_t index) {
+        if (acked(index)) {
+            return;
+        }
+        m_acked[index / 8] |= (uint8_t)(1 << (index % 8));
+        if (m_sendSeq[index] == 0) {
+            return;                         // Arrived in an earlier attempt
+        }
+        newlyAcked++;
+        m_highestAckedSeq = std::max(m_highestAckedSeq, m_sendSeq[index]);
+        if (m_sendSeq[index] > newestSeq) {
+            newestSeq = m_sendSeq[index];
+            newestIndex = index;
+        }
+    };
+    for (uint32_t index = m_cumulative; index < cumulative; index++) {
+        markAcked(index);
+    }
+    for (uint32_t bit = 0; bit < bitmapLength * 8; bit++) {
+        uint32_t index = cumulative + 1 + bit;
+        if (index < count && ((bitmap[bit / 8] >> (bit % 8)) & 1)) {
+            markAcked(index);
+        }
+    }
+    if (newestSeq) {
+        // The peer is back: undo any backoff, but take no sample from a resend
+        if (resent(newestIndex)) {
+            resetRetransmitTimeout();
+        } else {
+            onRttSample(nowMs - m_sentAtMs[newestIndex]);
+        }
+        m_rtoDeadlineMs = nowMs + m_rtoMs;
+    }
+    if (m_recoverySeq && m_highestAckedSeq >= m_recoverySeq) {
+        m_recoverySeq = 0;
+    }
+    while (newlyAcked--) {
+        onChunkAcked();
+    }
+    while (m_cumulative < count && acked(m_cumulative)) {
+        m_cumulative++;
+    }
+    // A resumed transfer skips what the receiver already has
+    m_nextNew = std::max(m_nextNew, m_cumulative);
+
+    if (m_cumulative >= count) {
+        m_state = BULK_SEND_COMPLETE;
+    } else if (m_state == BULK_SEND_OFFERING) {
+        ESP_LOGD(TAG, "Transfer %08x accepted at chunk %u/%u", (unsigned)m_offer.transfer_id,
+                 (unsigned)m_cumulative, (unsigned)count);
+        m_state = BULK_SEND_SENDING;
+        m_rtoDeadlineMs = nowMs + m_rtoMs;
+    }
+}
+
+void BulkSender::tick(uint32_t nowMs) {
+    if (m_state != BULK_SEND_OFFERING && m_state != BULK_SEND_SENDING) {
+        return;
+    }
+    if (is_due(nowMs, m_lastAckMs + m_config.sender_give_up_ms)) {
+        ESP_LOGW(TAG, "Transfer %08x: no answer for %u ms, giving up at %u/%u bytes",
+                 (unsigned)m_offer.transfer_id, (unsigned)m_config.sender_give_up_ms,
+                 (unsigned)ackedBytes(), (unsigned)m_offer.size);
+        m_state = BULK_SEND_FAILED;
+        return;
+    }
+    if (m_state == BULK_SEND_OFFERING) {
+        if (is_due(nowMs, m_nextOfferMs) && sendOffer()) {
+            m_nextOfferMs = nowMs + m_config.offer_interval_ms;
+        }
+        return;
+    }
+
+    // Lost chunks first: overtaken by an acknowledged later send
+    const uint32_t count = m_offer.chunkCount();
+    uint32_t inFlight = 0;
+    for (uint32_t index = m_cumulative; index < m_nextNew; index++) {
+        if (acked(index)) {
+            continue;
+        }
+        if (m_sendSeq[index] < m_highestAckedSeq) {
+            if (!m_recoverySeq) {
+                onLoss(false, 0);
+            }
+            if (!sendChunk(index, nowMs)) {
+                return;
+            }
+        }
+        inFlight++;
+    }
+
+    // No ACK progress for a whole timeout: resend the oldest chunk only if
+    // the link is queueing, otherwise the whole window, since one frame
+    // alone is easily lost again. Once a resend is acknowledged, whatever
+    // was sent before it counts as lost. The timeout doubles only while
+    // the peer says nothing at all.
+    if (inFlight == 0) {
+        m_rtoDeadlineMs = nowMs + m_rtoMs;
+    } else if (is_due(nowMs, m_rtoDeadlineMs)) {
+        onLoss(true, inFlight);
+        uint32_t resends = m_queueing ? 1 : m_cwnd;
+        for (uint32_t index = m_cumulative; index < m_nextNew && resends; index++) {
+            if (acked(index)) {
+                continue;
+            }
+            if (!sendChunk(index, nowMs)) {
+                return;
+            }
+            resends--;
+        }
+        m_queueing = false;                 // Whatever queue there was has drained by now
+        if (!m_heardSinceTimeout) {
+            m_rtoMs = std::min(m_rtoMs * 2, (uint32_t)BULK_MAX_RETRANSMIT_MS);
+        }
+        m_heardSinceTimeout = false;
+        m_rtoDeadlineMs = nowMs + m_rtoMs;
+    }
+
+    while (inFlight < m_cwnd && m_nextNew < count) {
+        if (!acked(m_nextNew)) {
+            if (!sendChunk(m_nextNew, nowMs)) {
+                return;
+            }
+            inFlight++;
+        }
+        m_nextNew++;
+    }
+}
+
+// ============================================================================
+// MULTICAST SENDER
+// ============================================================================
+
+BulkMulticastSender::BulkMulticastSender(BulkSendFunction send, const bulk_config_t& config)
+    : m_send(send), m_config(config), m_state(BULK_SEND_IDLE), m_offer(), m_repairCount(0), m_nextNew(0),
+      m_txSeq(0), m_rateKbps(0), m_budgetBytes(0), m_lastTickMs(0), m_lastPollMs(0), m_nextPollMs(0),
+      m_offerDeadlineMs(0), m_lastFeedbackMs(0), m_lossFloor(LOSS_FLOOR_UNKNOWN), m_stats() {
+    m_config.multicast_min_rate_kbps = std::max(m_config.multicast_min_rate_kbps, (uint32_t)1);
+    m_config.multicast_max_rate_kbps = std::max(m_config.multicast_max_rate_kbps, m_config.multicast_min_rate_kbps);
+    m_rateKbps = std::min(std::max(m_config.multicast_rate_kbps, m_config.multicast_min_rate_kbps),
+                          m_config.multicast_max_rate_kbps);
+}
+
+bool BulkMulticastSender::start(uint32_t transferId, std::shared_ptr<const std::vector<uint8_t>> payload,
+                                uint8_t contentType, uint32_t previewSize,
+                                const std::vector<std::string>& receivers, uint32_t nowMs) {
+    if (receivers.empty() ||
+        !make_offer_for(&m_offer, payload, transferId, m_config.chunk_size, contentType, previewSize)) {
+        return false;
+    }
+    m_payload = payload;
+
+    const uint32_t count = m_offer.chunkCount();
+    m_receivers.clear();
+    for (const std::string& receiver : receivers) {
+        m_receivers[receiver] = Receiver();
+    }
+    m_repair.assign((count + 7) / 8, 0);
+    m_sentAtMs.assign(count, 0);
+    m_repairCount = 0;
+    m_nextNew = 0;
+    m_txSeq = 0;
+    // The rate learnt on the previous transfer is kept
+    m_budgetBytes = 0;
+    m_lastTickMs = nowMs;
+    m_lastPollMs = nowMs;
+    m_nextPollMs = nowMs;
+    m_offerDeadlineMs = nowMs + m_config.offer_interval_ms;
+    m_lastFeedbackMs = nowMs;
+    m_state = BULK_SEND_OFFERING;
+    return true;
+}
+
+uint32_t BulkMulticastSender::receivedBytes(const std::string& peerId) const {
+    auto it = m_receivers.find(peerId);
+    if (it == m_receivers.end()) {
+        return 0;
+    }
+    return std::min(it->second.cumulative * (uint32_t)m_offer.chunk_size, m_offer.size);
+}
+
+bool BulkMulticastSender::receiverComplete(const std::string& peerId) const {
+    auto it = m_receivers.find(peerId);
+    return it != m_receivers.end() && it->second.complete;
+}
+
+std::vector<std::string> BulkMulticastSender::incompleteReceivers() const {
+    std::vector<std::string> peers;
+    for (const auto& entry : m_receivers) {
+        if (!entry.second.complete) {
+            peers.push_back(entry.first);
+        }
+    }
+    return peers;
+}
+
+bool BulkMulticastSender::allDone() const {
+    for (const auto& entry : m_receivers) {
+        if (!entry.second.complete && !entry.second.rejected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BulkMulticastSender::sendOffer() {
+    return m_send(make_offer(m_offer, OFFER_MULTICAST, m_nextNew));
+}
+
+bool BulkMulticastSender::sendChunk(uint32_t index, uint32_t nowMs) {
+    std::vector<uint8_t> frame = make_chunk(m_offer, *m_payload, index, ++m_txSeq);
+    if (!m_send(frame)) {
+        return false;
+    }
+    m_sentAtMs[index] = nowMs;
+    m_budgetBytes -= (int32_t)frame.size();
+    m_stats.chunks_sent++;
+    m_stats.bytes_sent += frame.size();
+    return true;
+}
+
+void BulkMulticastSender::handleFrame(const std::string& peerId, const uint8_t* data, size_t length, uint32_t nowMs) {
+    if (!bulk_is_frame(data, length) || (m_state != BULK_SEND_OFFERING && m_state != BULK_SEND_SENDING)) {
+        return;
+    }
+    const uint8_t* body = data + FRAME_HEADER_SIZE;
+    const size_t bodyLength = length - FRAME_HEADER_SIZE;
+    auto it = m_receivers.find(peerId);
+    if (it == m_receivers.end() || bodyLength < 4 || get_u32(body) != m_offer.transfer_id) {
+        return;
+    }
+    Receiver& receiver = it->second;
+    const uint32_t count = m_offer.chunkCount();
+
+    if (data[5] == FRAME_ACK && bodyLength >= ACK_MIN_SIZE) {
+        uint8_t flags = body[4];
+        m_stats.acks_received++;
+        m_lastFeedbackMs = nowMs;
+        receiver.answered = true;
+        if (flags & ACK_REJECTED) {
+            ESP_LOGW(TAG, "Transfer %08x rejected by %s", (unsigned)m_offer.transfer_id, peerId.c_str());
+            receiver.rejected = true;
+        } else if (flags & ACK_COMPLETE) {
+            receiver.cumulative = count;
+            receiver.complete = true;
+        } else {
+            receiver.cumulative = std::max(receiver.cumulative, std::min(get_u32(body + 5), count));
+        }
+        return;
+    }
+    if (data[5] != FRAME_NACK || bodyLength < NACK_MIN_SIZE) {
+        return;
+    }
+
+    m_stats.acks_received++;
+    m_lastFeedbackMs = nowMs;
+    receiver.answered = true;
+    receiver.cumulative = std::max(receiver.cumulative, std::min(get_u32(body + 5), count));
+    // A single report covers only a few frames; smooth it per receiver
+    uint16_t loss = std::min(get_u16(body + 9), (uint16_t)1000);
+    receiver.loss = receiver.lossReported ? (uint16_t)((3 * receiver.loss + loss) / 4) : loss;
+    receiver.lossReported = true;
+
+    // Merge the missing ranges into one repair set. A chunk sent since the
+    // last poll is left out: either the receiver could not know about it yet
+    // or it is the repair another receiver's NACK already triggered.
+    size_t ranges = std::min((size_t)body[11], (bodyLength - NACK_MIN_SIZE) / NACK_RANGE_SIZE);
+    const uint8_t* range = body + NACK_MIN_SIZE;
+    for (size_t r = 0; r < ranges; r++, range += NACK_RANGE_SIZE) {
+        uint32_t first = get_u32(range);
+        uint32_t end = std::min(first + get_u16(range + 4), m_nextNew);
+        for (uint32_t index = first; index < end; index++) {
+            bool queued = (m_repair[index / 8] >> (index % 8)) & 1;
+            if (!queued && !is_due(m_sentAtMs[index], m_lastPollMs)) {
+                m_repair[index / 8] |= (uint8_t)(1 << (index % 8));
+                m_repairCount++;
+            }
+        }
+    }
+}
+
+// Once per poll: slow down when the worst receiver loses clearly more than
+// the group does anyway. The floor starts at the first reports, drops at
+// once and rises slowly, so a radio that always loses some frames does not
+// hold the rate down.
+void BulkMulticastSender::endRound() {
+    bool reported = false;
+    uint16_t worst = 0;
+    for (const auto& entry : m_receivers) {
+        if (!entry.second.complete && entry.second.lossReported) {
+            reported = true;
+            worst = std::max(worst, entry.second.loss);
+        }
+    }
+    if (reported && m_lossFloor == LOSS_FLOOR_UNKNOWN) {
+        m_lossFloor = worst;
+    }
+    if (reported && worst > m_lossFloor + m_config.multicast_loss_threshold) {
+        m_rateKbps = std::max(m_rateKbps * 3 / 4, m_config.multicast_min_rate_kbps);
+        m_stats.loss_events++;
+    } else {
+        m_rateKbps = std::min(m_rateKbps + std::max(m_rateKbps / 8, (uint32_t)8), m_config.multicast_max_rate_kbps);
+    }
+    if (reported) {
+        m_lossFloor = worst < m_lossFloor ? worst : m_lossFloor + (worst - m_lossFloor) / 8;
+    }
+}
+
+void BulkMulticastSender::tick(uint32_t nowMs) {
+    if (m_state != BULK_SEND_OFFERING && m_state != BULK_SEND_SENDING) {
+        return;
+    }
+    uint32_t elapsedMs = nowMs - m_lastTickMs;
+    m_lastTickMs = nowMs;
+
+    if (allDone()) {
+        bool anyComplete = false;
+        for (const auto& entry : m_receivers) {
+            anyComplete = anyComplete || entry.second.complete;
+        }
+        m_state = anyComplete ? BULK_SEND_COMPLETE : BULK_SEND_FAILED;
+        return;
+    }
+    if (is_due(nowMs, m_lastFeedbackMs + m_config.sender_give_up_ms)) {
+        ESP_LOGW(TAG, "Multicast %08x: no answer for %u ms, %u receivers incomplete",
+                 (unsigned)m_offer.transfer_id, (unsigned)m_config.sender_give_up_ms,
+                 (unsigned)incompleteReceivers().size());
+        m_state = BULK_SEND_FAILED;
+        return;
+    }
+
+    if (m_state == BULK_SEND_OFFERING) {
+        bool allAnswered = true;
+        bool anyAnswered = false;
+        for (const auto& entry : m_receivers) {
+            allAnswered = allAnswered && entry.second.answered;
+            anyAnswered = anyAnswered || entry.second.answered;
+        }
+        // Start once everyone listens, or with whoever answered in time;
+        // latecomers join at a poll and ask for what they missed
+        if (!allAnswered && !(anyAnswered && is_due(nowMs, m_offerDeadlineMs))) {
+            if (is_due(nowMs, m_nextPollMs) && sendOffer()) {
+                m_nextPollMs = nowMs + m_config.offer_interval_ms / 4;
+            }
+            return;
+        }
+        m_state = BULK_SEND_SENDING;
+        m_nextPollMs = nowMs + m_config.poll_interval_ms;
+        elapsedMs = 0;
+    }
+
+    // Poll before sending, so the count in the poll excludes this tick's chunks
+    if (is_due(nowMs, m_nextPollMs) && sendOffer()) {
+        m_lastPollMs = nowMs;
+        m_nextPollMs = nowMs + m_config.poll_interval_ms;
+        endRound();
+    }
+
+    // Paced sending: repairs first, then new chunks
+    const uint32_t count = m_offer.chunkCount();
+    const int32_t burstBytes = (int32_t)(m_offer.chunk_size + BULK_CHUNK_OVERHEAD) * PACING_BURST_CHUNKS;
+    m_budgetBytes = std::min(m_budgetBytes + (int32_t)(m_rateKbps * elapsedMs / 8), burstBytes);
+    if (m_state == BULK_SEND_SENDING && m_budgetBytes <= 0 && elapsedMs == 0) {
+        m_budgetBytes = 1;                  // First chunk goes out right away
+    }
+    uint32_t repairCursor = 0;
+    while (m_budgetBytes > 0) {
+        if (m_repairCount) {
+            while (!((m_repair[repairCursor / 8] >> (repairCursor % 8)) & 1)) {
+                repairCursor++;
+            }
+            if (!sendChunk(repairCursor, nowMs)) {
+                break;
+            }
+            m_repair[repairCursor / 8] &= (uint8_t)~(1 << (repairCursor % 8));
+            m_repairCount--;
+            m_stats.retransmits++;
+        } else if (m_nextNew < count) {
+            if (!sendChunk(m_nextNew, nowMs)) {
+                break;
+            }
+            m_nextNew++;
+        } else {
+            m_budgetBytes = 0;              // Idle time earns no burst
+            break;
+        }
+    }
+}
+
+// ============================================================================
+// RECEIVER
+// ============================================================================
+
+BulkReceiver::BulkReceiver(BulkSendFunction send, const bulk_config_t& config, uint32_t seed)
+    : m_send(send), m_config(config), m_random(seed ? seed : 1), m_stats() {
+}
+
+uint32_t BulkReceiver::nextRandom() {
+    // xorshift32
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+}
+
+bool BulkReceiver::completed(uint32_t transferId) const {
+    return std::find(m_completed.begin(), m_completed.end(), transferId) != m_completed.end();
+}
+
+uint32_t BulkReceiver::receivedBytes(uint32_t transferId) const {
+    auto it = m_sessions.find(transferId);
+    if (it == m_sessions.end()) {
+        return 0;
+    }
+    return std::min(it->second.cumulative * (uint32_t)it->second.offer.chunk_size, it->second.offer.size);
+}
+
+void BulkReceiver::handleFrame(const uint8_t* data, size_t length, uint32_t nowMs) {
+    if (!bulk_is_frame(data, length)) {
+        return;
+    }
+    if (data[5] == FRAME_OFFER) {
+        handleOffer(data + FRAME_HEADER_SIZE, length - FRAME_HEADER_SIZE, nowMs);
+    } else if (data[5] == FRAME_CHUNK) {
+        handleChunk(data + FRAME_HEADER_SIZE, length - FRAME_HEADER_SIZE, nowMs);
+    } else if (data[5] == FRAME_NACK) {
+        handleNack(data + FRAME_HEADER_SIZE, length - FRAME_HEADER_SIZE);
+    }
+}
+
+void BulkReceiver::scheduleNack(Session* session, uint32_t nowMs) {
+    if (session->nackPending || session->cumulative >= std::min(session->sentThrough, session->count)) {
+        return;
+    }
+    // Spread the group's answers so that one NACK can silence the others
+    session->nackPending = true;
+    session->nackAtMs = nowMs + nextRandom() % (m_config.nack_backoff_ms + 1);
+}
+
+void BulkReceiver::handleOffer(const uint8_t* body, size_t length, uint32_t nowMs) {
+    if (length < OFFER_SIZE) {
+        return;
+    }
+    BulkOffer offer;
+    offer.transfer_id = get_u32(body);
+    offer.size = get_u32(body + 4);
+    offer.chunk_size = get_u16(body + 8);
+    offer.content_type = body[10];
+    offer.preview_size = get_u32(body + 11);
+    bool multicast = body[15] & OFFER_MULTICAST;
+    uint32_t sentThrough = get_u32(body + 16);
+
+    if (completed(offer.transfer_id)) {
+        m_completeAcks.push_back(offer.transfer_id);
+        return;
+    }
+    auto it = m_sessions.find(offer.transfer_id);
+    if (it != m_sessions.end()) {
+        Session& session = it->second;
+        session.lastHeardMs = nowMs;
+        if (!multicast) {
+            // Sender restarted, lost our answer, or finishes a multicast by unicast
+            session.multicast = false;
+            session.nackPending = false;
+            session.ackDue = true;
+        } else if (sentThrough == 0) {
+            session.ackDue = true;          // Still offering: our answer was lost
+        } else {
+            // A poll: ask for whatever has been sent and did not arrive
+            session.sentThrough = std::max(session.sentThrough, sentThrough);
+            scheduleNack(&session, nowMs);
+        }
+        return;
+    }
+
+    if (offer.size == 0 || offer.size > BULK_MAX_TRANSFER_SIZE || offer.chunk_size == 0 ||
+        heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) < offer.size + offer.size / 8) {
+        ESP_LOGW(TAG, "Rejecting transfer %08x of %u bytes", (unsigned)offer.transfer_id, (unsigned)offer.size);
+        m_stats.transfers_rejected++;
+        sendAck(offer.transfer_id, nullptr, ACK_REJECTED);
+        return;
+    }
+
+    // Make room: drop the session heard from least recently
+    if (m_sessions.size() >= MAX_SESSIONS) {
+        auto oldest = m_sessions.begin();
+        for (auto s = m_sessions.begin(); s != m_sessions.end(); ++s) {
+            if ((int32_t)(s->second.lastHeardMs - oldest->second.lastHeardMs) < 0) {
+                oldest = s;
+            }
+        }
+        m_sessions.erase(oldest);
+    }
+
+    Session& session = m_sessions[offer.transfer_id];
+    session.offer = offer;
+    session.count = offer.chunkCount();
+    session.payload.resize(offer.size);
+    session.have.assign((session.count + 7) / 8, 0);
+    session.cumulative = 0;
+    session.highest = 0;
+    session.unacked = 0;
+    session.ackDue = true;                  // Accept the offer
+    session.previewed = offer.preview_size == 0;
+    session.multicast = multicast;
+    session.previewReportDue = false;
+    session.sentThrough = sentThrough;
+    session.nackAtMs = 0;
+    session.nackPending = false;
+    session.firstUnackedMs = nowMs;
+    session.lastHeardMs = nowMs;
+    session.lossFirstSeq = 0;
+    session.lossLastSeq = 0;
+    session.lossReceived = 0;
+    ESP_LOGD(TAG, "Receiving %s transfer %08x: %u bytes in %u chunks", multicast ? "multicast" : "unicast",
+             (unsigned)offer.transfer_id, (unsigned)offer.size, (unsigned)session.count);
+    if (multicast) {
+        scheduleNack(&session, nowMs);      // Joined late
+    }
+}
+
+void BulkReceiver::handleChunk(const uint8_t* body, size_t length, uint32_t nowMs) {
+    if (length < CHUNK_HEADER_SIZE) {
+        return;
+    }
+    uint32_t transferId = get_u32(body);
+    uint32_t index = get_u32(body + 4);
+    uint32_t txSeq = get_u32(body + 8);
+    auto it = m_sessions.find(transferId);
+    if (it == m_sessions.end()) {
+        if (completed(transferId)) {
+            m_completeAcks.push_back(transferId);   // Our final ACK was lost
+            m_stats.duplicates++;
+        }
+        return;
+    }
+
+    Session& session = it->second;
+    session.lastHeardMs = nowMs;
+    size_t dataLength = length - CHUNK_HEADER_SIZE;
+    uint32_t offset = index * session.offer.chunk_size;
+    size_t expected = index + 1 < session.count ? session.offer.chunk_size : session.offer.size - offset;
+    if (index >= session.count || dataLength != expected) {
+        return;
+    }
+
+    if (session.multicast) {
+        if (session.lossReceived == 0) {
+            session.lossFirstSeq = txSeq;
+        }
+        session.lossFirstSeq = std::min(session.lossFirstSeq, txSeq);
+        session.lossLastSeq = std::max(session.lossLastSeq, txSeq);
+        session.lossReceived++;
+    }
+    if (has(session, index)) {
+        m_stats.duplicates++;
+        if (!session.multicast) {
+            session.ackDue = true;          // The sender did not hear our ACK
+        }
+        return;
+    }
+
+    memcpy(session.payload.data() + offset, body + CHUNK_HEADER_SIZE, dataLength);
+    session.have[index / 8] |= (uint8_t)(1 << (index % 8));
+    session.highest = std::max(session.highest, index + 1);
+    m_stats.chunks_received++;
+    while (session.cumulative < session.count && has(session, session.cumulative)) {
+        session.cumulative++;
+    }
+    if (!session.multicast) {
+        if (session.unacked++ == 0) {
+            session.firstUnackedMs = nowMs;
+        }
+        if (index + 1 != session.cumulative || session.unacked >= m_config.ack_every) {
+            session.ackDue = true;          // Gap: let the sender repair it now
+        }
+    }
+
+    if (!session.previewed && receivedBytes(transferId) >= session.offer.preview_size) {
+        session.previewed = true;
+        session.previewReportDue = session.multicast;
+        if (m_onPreview) {
+            m_onPreview(session.offer, session.payload.data(), session.offer.preview_size);
+        }
+    }
+
+    if (session.cumulative == session.count) {
+        BulkOffer offer = session.offer;
+        std::vector<uint8_t> payload;
+        payload.swap(session.payload);
+        m_sessions.erase(it);
+        m_completed.push_back(transferId);
+        if (m_completed.size() > COMPLETED_HISTORY) {
+            m_completed.erase(m_completed.begin());
+        }
+        m_completeAcks.push_back(transferId);
+        m_stats.transfers_completed++;
+        if (m_onComplete) {
+            m_onComplete(offer, payload);
+        }
+    }
+}
+
+// Another receiver's NACK: stay quiet if it asks for everything we miss
+void BulkReceiver::handleNack(const uint8_t* body, size_t length) {
+    if (length < NACK_MIN_SIZE) {
+        return;
+    }
+    auto it = m_sessions.find(get_u32(body));
+    if (it == m_sessions.end() || !it->second.multicast || !it->second.nackPending) {
+        return;
+    }
+    Session& session = it->second;
+    size_t ranges = std::min((size_t)body[11], (length - NACK_MIN_SIZE) / NACK_RANGE_SIZE);
+    const uint8_t* rangeData = body + NACK_MIN_SIZE;
+    uint32_t limit = std::min(session.sentThrough, session.count);
+    for (uint32_t index = session.cumulative; index < limit; index++) {
+        if (has(session, index)) {
+            continue;
+        }
+        bool covered = false;
+        for (size_t r = 0; r < ranges && !covered; r++) {
+            uint32_t first = get_u32(rangeData + r * NACK_RANGE_SIZE);
+            covered = index >= first && index - first < get_u16(rangeData + r * NACK_RANGE_SIZE + 4);
+        }
+        if (!covered) {
+            return;
+        }
+    }
+    session.nackPending = false;
+    m_stats.nacks_suppressed++;
+}
+
+void BulkReceiver::sendAck(uint32_t transferId, Session* session, uint8_t flags) {
+    uint32_t cumulative = session ? session->cumulative : 0;
+    uint32_t bitmapChunks = 0;
+    if (session && session->highest > cumulative + 1) {
+        bitmapChunks = std::min(session->highest - cumulative - 1, (uint32_t)BULK_ACK_BITMAP_CHUNKS);
+    }
+    uint8_t bitmap[BULK_ACK_BITMAP_CHUNKS / 8] = {0};
+    for (uint32_t bit = 0; bit < bitmapChunks; bit++) {
+        if (has(*session, cumulative + 1 + bit)) {
+            bitmap[bit / 8] |= (uint8_t)(1 << (bit % 8));
+        }
+    }
+    size_t bitmapLength = (bitmapChunks + 7) / 8;
+
+    std::vector<uint8_t> frame = make_frame(FRAME_ACK, ACK_MIN_SIZE + bitmapLength);
+    put_u32(&frame, transferId);
+    frame.push_back(flags);
+    put_u32(&frame, cumulative);
+    frame.push_back((uint8_t)bitmapLength);
+    frame.insert(frame.end(), bitmap, bitmap + bitmapLength);
+    if (m_send(frame)) {
+        m_stats.acks_sent++;
+    }
+}
+
+void BulkReceiver::sendNack(uint32_t transferId, Session* session, uint8_t flags) {
+    uint16_t lossPermille = 0;
+    if (session->lossReceived) {
+        uint32_t expected = session->lossLastSeq - session->lossFirstSeq + 1;
+        lossPermille = (uint16_t)(1000 - std::min(session->lossReceived, expected) * 1000 / expected);
+    }
+    session->lossReceived = 0;
+
+    std::vector<uint8_t> ranges;
+    uint8_t rangeCount = 0;
+    uint32_t limit = std::min(session->sentThrough, session->count);
+    for (uint32_t index = session->cumulative; index < limit && rangeCount < BULK_NACK_MAX_RANGES;) {
+        if (has(*session, index)) {
+            index++;
+            continue;
+        }
+        uint32_t first = index;
+        while (index < limit && !has(*session, index) && index - first < UINT16_MAX) {
+            index++;
+        }
+        put_u32(&ranges, first);
+        put_u16(&ranges, (uint16_t)(index - first));
+        rangeCount++;
+    }
+
+    std::vector<uint8_t> frame = make_frame(FRAME_NACK, NACK_MIN_SIZE + ranges.size());
+    put_u32(&frame, transferId);
+    frame.push_back(flags);
+    put_u32(&frame, session->cumulative);
+    put_u16(&frame, lossPermille);
+    frame.push_back(rangeCount);
+    frame.insert(frame.end(), ranges.begin(), ranges.end());
+    // To the whole group, so receivers missing the same chunks stay quiet
+    const BulkSendFunction& send = m_multicastSend ? m_multicastSend : m_send;
+    if (send(frame)) {
+        m_stats.nacks_sent++;
+    }
+}
+
+void BulkReceiver::tick(uint32_t nowMs) {
+    // One ACK per completed transfer per tick, however many duplicates came in
+    std::sort(m_completeAcks.begin(), m_completeAcks.end());
+    m_completeAcks.erase(std::unique(m_completeAcks.begin(), m_completeAcks.end()), m_completeAcks.end());
+    for (uint32_t transferId : m_completeAcks) {
+        sendAck(transferId, nullptr, ACK_COMPLETE);
+    }
+    m_completeAcks.clear();
+
+    for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+        Session& session = it->second;
+        if (is_due(nowMs, session.lastHeardMs + m_config.receiver_keep_ms)) {
+            ESP_LOGW(TAG, "Dropping stalled transfer %08x at %u/%u chunks", (unsigned)it->first,
+                     (unsigned)session.cumulative, (unsigned)session.count);
+            it = m_sessions.erase(it);
+            continue;
+        }
+        if (session.ackDue || (session.unacked && is_due(nowMs, session.firstUnackedMs + m_config.ack_delay_ms))) {
+            sendAck(it->first, &session, 0);
+            session.ackDue = false;
+            session.unacked = 0;
+        }
+        if (session.multicast) {
+            if (session.nackPending && is_due(nowMs, session.nackAtMs)) {
+                session.nackPending = false;
+                session.previewReportDue = false;
+                sendNack(it->first, &session, 0);
+            } else if (session.previewReportDue) {
+                session.previewReportDue = false;
+                sendNack(it->first, &session, NACK_PREVIEW);
+            }
+        }
+        ++it;
+    }
+}
@@ -1,5 +1,6 @@
 #include "include/button_handler.h"
 #include "include/config.h"
+#include "include/board_profile.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,11 +10,11 @@
 
 // Array to hold the pin number for each button
 static const gpio_num_t button_pins[NUM_BUTTONS] = {
-    (gpio_num_t)PIN_BUTTON_PTT,
-    (gpio_num_t)PIN_BUTTON_UP,
-    (gpio_num_t)PIN_BUTTON_DOWN,
-    (gpio_num_t)PIN_BUTTON_SELECT,
-    (gpio_num_t)PIN_BUTTON_BACK
+    (gpio_num_t)Board::pin_button_ptt,
+    (gpio_num_t)Board::pin_button_up,
+    (gpio_num_t)Board::pin_button_down,
+    (gpio_num_t)Board::pin_button_select,
+    (gpio_num_t)Board::pin_button_back
 };
 
 // Internal state for each button
@@ -28,14 +29,6 @@ static uint32_t press_start_time[NUM_BUTTONS];
 
 void buttons_init() {
     for (int i = 0; i < NUM_BUTTONS; i++) {
-        gpio_config_t io_conf;
-        io_conf.intr_type = GPIO_INTR_DISABLE;
-        io_conf.mode = GPIO_MODE_INPUT;
-        io_conf.pin_bit_mask = (1ULL << button_pins[i]);
-        io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-        io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
-        gpio_config(&io_conf);
-
         // Initialize states
         button_state[i] = true; // Assume released (high due to pull-up)
         last_button_state[i] = true;
@@ -44,6 +37,18 @@ void buttons_init() {
         long_press_flag[i] = false;
         last_debounce_time[i] = 0;
         press_start_time[i] = 0;
+
+        // Buttons the board does not fit stay released
+        if (button_pins[i] < 0) {
+            continue;
+        }
+        gpio_config_t io_conf;
+        io_conf.intr_type = GPIO_INTR_DISABLE;
+        io_conf.mode = GPIO_MODE_INPUT;
+        io_conf.pin_bit_mask = (1ULL << button_pins[i]);
+        io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+        io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
+        gpio_config(&io_conf);
     }
 }
 
@@ -56,6 +61,9 @@ void buttons_read() {
         just_released_flag[i] = false;
         long_press_flag[i] = false;
 
+        if (button_pins[i] < 0) {
+            continue;
+        }
         bool reading = gpio_get_level(button_pins[i]);
 
         // If the switch changed, due to noise or pressing:
@@ -1,31 +1,440 @@
+/**
+ * @file camera_service.cpp
+ * @brief Capture images and send them over the mesh, preview first
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
 #include "include/camera_service.h"
-#include <stdio.h>
+#include "include/bulk_service.h"
+#include "include/config.h"
+#include "include/board_profile.h"
+#include "include/jpeg_progressive.h"
+#include "include/metrics_registry.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#if defined(ESP_PLATFORM) && __has_include("esp_camera.h")
+#include "esp_camera.h"
+#define CAMERA_HAVE_DRIVER 1
+#endif
+
+static const char* CAMERA_TAG = "CAMERA_SERVICE";
+
+#define CAMERA_STATS_MUTEX_TIMEOUT pdMS_TO_TICKS(100)
+
+// Capture request handed to the camera task; empty peer means all
+typedef struct {
+    char peer_id[CAMERA_PEER_ID_LEN];
+} camera_event_t;
+
+// ============================================================================
+// IMAGE SOURCES
+// ============================================================================
+
+bool FileCameraSource::begin() {
+    std::ifstream file(m_path, std::ios::binary);
+    if (!file) {
+        ESP_LOGE(CAMERA_TAG, "Cannot open %s", m_path.c_str());
+        return false;
+    }
+    m_jpeg.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return m_jpeg.size() > 4 && m_jpeg[0] == 0xFF && m_jpeg[1] == 0xD8;
+}
+
+bool FileCameraSource::capture(const std::function<void(const uint8_t* jpeg, size_t length)>& consume) {
+    if (m_jpeg.empty()) {
+        return false;
+    }
+    consume(m_jpeg.data(), m_jpeg.size());
+    return true;
+}
+
+#ifdef CAMERA_HAVE_DRIVER
+/**
+ * @brief OV2640/OV3660 on the board's camera connector, frame buffers in PSRAM
+ */
+class EspCameraSource : public ICameraSource {
+public:
+    bool begin() override {
+        camera_config_t config = {};
+        config.pin_pwdn = Board::cam_pin_pwdn;
+        config.pin_reset = Board::cam_pin_reset;
+        config.pin_xclk = Board::cam_pin_xclk;
+        config.pin_sccb_sda = Board::cam_pin_siod;
+        config.pin_sccb_scl = Board::cam_pin_sioc;
+        config.pin_d7 = Board::cam_pin_d[7];
+        config.pin_d6 = Board::cam_pin_d[6];
+        config.pin_d5 = Board::cam_pin_d[5];
+        config.pin_d4 = Board::cam_pin_d[4];
+        config.pin_d3 = Board::cam_pin_d[3];
+        config.pin_d2 = Board::cam_pin_d[2];
+        config.pin_d1 = Board::cam_pin_d[1];
+        config.pin_d0 = Board::cam_pin_d[0];
+        config.pin_vsync = Board::cam_pin_vsync;
+        config.pin_href = Board::cam_pin_href;
+        config.pin_pclk = Board::cam_pin_pclk;
+        config.xclk_freq_hz = CAMERA_XCLK_FREQ_HZ;
+        config.ledc_timer = LEDC_TIMER_0;
+        config.ledc_channel = LEDC_CHANNEL_0;
+        config.pixel_format = PIXFORMAT_JPEG;
+        config.frame_size = FRAMESIZE_VGA;
+        config.jpeg_quality = CAMERA_JPEG_QUALITY;
+        config.fb_count = Board::cam_fb_count;
+        config.fb_location = CAMERA_FB_IN_PSRAM;
+        config.grab_mode = CAMERA_GRAB_LATEST;
+
+        esp_err_t err = esp_camera_init(&config);
+        if (err != ESP_OK) {
+            ESP_LOGW(CAMERA_TAG, "No camera: %s", esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    }
+
+    bool capture(const std::function<void(const uint8_t* jpeg, size_t length)>& consume) override {
+        camera_fb_t* fb = esp_camera_fb_get();
+        if (!fb) {
+            return false;
+        }
+        bool ok = fb->format == PIXFORMAT_JPEG;
+        if (ok) {
+            consume(fb->buf, fb->len);
+        }
+        esp_camera_fb_return(fb);
+        return ok;
+    }
+
+    const char* name() const override { return "esp32-camera"; }
+};
+#endif
+
+// ============================================================================
+// CAPTURE AND RE-ENCODE
+// ============================================================================
+
+bool camera_service_prepare_image(ICameraSource* source, CameraImage* image) {
+    if (!source || !image) {
+        return false;
+    }
+    *image = CameraImage();
+    std::shared_ptr<std::vector<uint8_t>> jpeg = std::make_shared<std::vector<uint8_t>>();
+
+    int64_t startUs = esp_timer_get_time();
+    int64_t capturedUs = startUs;
+    bool ok = source->capture([&](const uint8_t* data, size_t length) {
+        capturedUs = esp_timer_get_time();
+        image->capture_bytes = (uint32_t)length;
+
+        // Re-encode straight from the frame buffer, which is released after
+        jpeg_progressive_info_t info;
+        jpeg_progressive_status_t status = jpeg_progressive_encode(data, length, jpeg.get(), &info);
+        if (status == JPEG_PROGRESSIVE_OK) {
+            image->preview_bytes = info.preview_bytes;
+            image->width = info.width;
+            image->height = info.height;
+        } else {
+            // Still worth sending, just without an early preview
+            ESP_LOGW(CAMERA_TAG, "Sending baseline JPEG: %s", jpeg_progressive_status_name(status));
+            jpeg->assign(data, data + length);
+        }
+    });
+    if (!ok || jpeg->empty()) {
+        return false;
+    }
+
+    image->capture_us = (uint32_t)(capturedUs - startUs);
+    image->reencode_us = (uint32_t)(esp_timer_get_time() - capturedUs);
+    image->jpeg = jpeg;
+    metrics_counter_inc(METRIC_CAMERA_CAPTURES);
+    metrics_histogram_record(METRIC_CAMERA_REENCODE_TIME_US, image->reencode_us);
+    return true;
+}
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+// The sensor is started on the first capture, not at boot: it takes
+// hundreds of ms and most sessions never take a picture
+typedef enum {
+    SOURCE_UNTRIED = 0,
+    SOURCE_READY,
+    SOURCE_ABSENT
+} source_state_t;
+
+static std::unique_ptr<ICameraSource> s_source;
+static std::atomic<uint8_t> s_sourceState(SOURCE_UNTRIED);
+static QueueHandle_t s_eventQueue = nullptr;
+static SemaphoreHandle_t s_statsMutex = nullptr;
+static camera_service_stats_t s_stats;
+static std::atomic<bool> s_streaming(false);
+static std::atomic<camera_receive_callback_t> s_receiveCallback(nullptr);
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+template <typename F>
+static void update_stats(F update) {
+    if (xSemaphoreTake(s_statsMutex, CAMERA_STATS_MUTEX_TIMEOUT) == pdTRUE) {
+        update(s_stats);
+        xSemaphoreGive(s_statsMutex);
+    }
+}
+
+// ============================================================================
+// RECEIVING
+// ============================================================================
+
+static void on_image(const char* peer_id, const uint8_t* jpeg, size_t length, bool complete) {
+    if (complete) {
+        ESP_LOGI(CAMERA_TAG, "Image of %u bytes from %s", (unsigned)length, peer_id);
+        metrics_counter_inc(METRIC_CAMERA_IMAGES_RECEIVED);
+        update_stats([](camera_service_stats_t& stats) { stats.images_received++; });
+    }
+    camera_receive_callback_t callback = s_receiveCallback.load();
+    if (callback) {
+        callback(peer_id, jpeg, length, complete);
+    }
+}
+
+// ============================================================================
+// SENDING
+// ============================================================================
+
+// Latencies count from the start of the capture, not from the send call
+static BulkSendCallbacks make_callbacks(uint32_t captureMs) {
+    BulkSendCallbacks callbacks;
+    callbacks.onPreview = [captureMs](const std::string& peer_id, uint32_t elapsedMs) {
+        uint32_t latencyMs = elapsedMs + captureMs;
+        metrics_histogram_record(METRIC_CAMERA_PREVIEW_LATENCY_MS, latencyMs);
+        update_stats([latencyMs](camera_service_stats_t& stats) { stats.last_preview_latency_ms = latencyMs; });
+    };
+    callbacks.onDone = [captureMs](const std::string& peer_id, bool delivered, uint32_t elapsedMs,
+                                   uint32_t retransmits) {
+        metrics_counter_add(METRIC_CAMERA_RETRANSMITS, retransmits);
+        if (!delivered) {
+            ESP_LOGW(CAMERA_TAG, "Image not delivered to %s", peer_id.c_str());
+            metrics_counter_inc(METRIC_CAMERA_SEND_FAILURES);
+            update_stats([](camera_service_stats_t& stats) { stats.send_failures++; });
+            return;
+        }
+        uint32_t transferMs = elapsedMs + captureMs;
+        ESP_LOGI(CAMERA_TAG, "Image to %s in %u ms, %u chunks resent", peer_id.c_str(), (unsigned)transferMs,
+                 (unsigned)retransmits);
+        metrics_counter_inc(METRIC_CAMERA_IMAGES_SENT);
+        metrics_histogram_record(METRIC_CAMERA_TRANSFER_TIME_MS, transferMs);
+        update_stats([transferMs](camera_service_stats_t& stats) {
+            stats.images_sent++;
+            stats.last_transfer_ms = transferMs;
+        });
+    };
+    return callbacks;
+}
 
-static const char* TAG = "CAMERA_SERVICE";
+// Camera task only
+static bool start_source(void) {
+    if (s_sourceState.load() == SOURCE_UNTRIED) {
+        bool ready = s_source && s_source->begin();
+        s_sourceState.store(ready ? SOURCE_READY : SOURCE_ABSENT);
+        if (ready) {
+            ESP_LOGI(CAMERA_TAG, "Image source %s started", s_source->name());
+        } else {
+            ESP_LOGW(CAMERA_TAG, "No image source, receiving only");
+        }
+    }
+    return s_sourceState.load() == SOURCE_READY;
+}
+
+static void capture_and_send(const char* peer_id) {
+    if (!start_source()) {
+        ESP_LOGW(CAMERA_TAG, "No camera");
+        s_streaming.store(false);
+        update_stats([](camera_service_stats_t& stats) { stats.streaming = false; });
+        return;
+    }
+    uint32_t captureStartMs = now_ms();
+    CameraImage image;
+    if (!camera_service_prepare_image(s_source.get(), &image)) {
+        ESP_LOGE(CAMERA_TAG, "Capture failed");
+        update_stats([](camera_service_stats_t& stats) { stats.capture_failures++; });
+        return;
+    }
+    ESP_LOGI(CAMERA_TAG, "%ux%u image: %u bytes captured, %u progressive, preview in %u, re-encoded in %u ms",
+             image.width, image.height, (unsigned)image.capture_bytes, (unsigned)image.jpeg->size(),
+             (unsigned)image.preview_bytes, (unsigned)(image.reencode_us / 1000));
+    update_stats([&image](camera_service_stats_t& stats) {
+        stats.captures++;
+        stats.last_capture_bytes = image.capture_bytes;
+        stats.last_image_bytes = (uint32_t)image.jpeg->size();
+        stats.last_preview_bytes = image.preview_bytes;
+        stats.last_reencode_ms = image.reencode_us / 1000;
+    });
+
+    // One peer by unicast, the whole squad with a single multicast
+    std::vector<std::string> peers;
+    if (peer_id[0]) {
+        peers.push_back(peer_id);
+    } else {
+        for (const MeshNodeInfo& node : HaLowMeshManager::getInstance().getMeshNodes()) {
+            if (peers.size() < CAMERA_MAX_PEERS) {
+                peers.push_back(node.ipAddress);
+            }
+        }
+    }
+    if (peers.empty()) {
+        ESP_LOGW(CAMERA_TAG, "No peers to send the image to");
+        return;
+    }
+    BulkSendCallbacks callbacks = make_callbacks(now_ms() - captureStartMs);
+    if (!bulk_service_multicast(peers, image.jpeg, BULK_CONTENT_JPEG, image.preview_bytes, callbacks)) {
+        ESP_LOGW(CAMERA_TAG, "Bulk service busy, image dropped");
+        metrics_counter_add(METRIC_CAMERA_SEND_FAILURES, peers.size());
+        update_stats([&peers](camera_service_stats_t& stats) { stats.send_failures += peers.size(); });
+    }
+}
 
-// Camera Service - Stub Implementation
-// This is a placeholder for camera functionality
+// ============================================================================
+// TASK
+// ============================================================================
+
+static void camera_task(void* pvParameters) {
+    uint32_t nextStreamMs = now_ms();
+    for (;;) {
+        camera_event_t event;
+        if (xQueueReceive(s_eventQueue, &event, pdMS_TO_TICKS(CAMERA_TICK_MS)) == pdTRUE) {
+            capture_and_send(event.peer_id);
+        }
+
+        uint32_t nowMs = now_ms();
+        if (s_streaming.load() && (int32_t)(nowMs - nextStreamMs) >= 0) {
+            nextStreamMs = nowMs + CAMERA_STREAM_INTERVAL_MS;
+            capture_and_send("");
+        }
+    }
+}
+
+static int queue_capture(const char* peer_id) {
+    if (!s_eventQueue) {
+        return -1;
+    }
+    if (s_sourceState.load() == SOURCE_ABSENT) {
+        ESP_LOGW(CAMERA_TAG, "No camera");
+        return -1;
+    }
+    camera_event_t event = {};
+    if (peer_id) {
+        strncpy(event.peer_id, peer_id, sizeof(event.peer_id) - 1);
+    }
+    return xQueueSend(s_eventQueue, &event, 0) == pdTRUE ? 0 : -1;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void camera_service_set_source(std::unique_ptr<ICameraSource> source) {
+    if (s_eventQueue) {
+        ESP_LOGW(CAMERA_TAG, "Camera service already running, source not changed");
+        return;
+    }
+    s_source = std::move(source);
+}
+
+void camera_service_set_receive_callback(camera_receive_callback_t callback) {
+    s_receiveCallback.store(callback);
+}
 
 int camera_service_init(void) {
-    printf("[%s] Camera service initialized (stub implementation)\n", TAG);
-    // TODO: Implement actual camera initialization
+    if (s_eventQueue) {
+        return 0;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+
+#ifdef CAMERA_HAVE_DRIVER
+    // Boards without a camera connector keep only the receive path
+    if constexpr (Board::has_camera) {
+        if (!s_source) {
+            s_source.reset(new (std::nothrow) EspCameraSource());
+        }
+    }
+#endif
+    s_sourceState.store(SOURCE_UNTRIED);
+
+    s_statsMutex = xSemaphoreCreateMutex();
+    s_eventQueue = xQueueCreate(CAMERA_EVENT_QUEUE_DEPTH, sizeof(camera_event_t));
+    if (!s_statsMutex || !s_eventQueue) {
+        ESP_LOGE(CAMERA_TAG, "Out of memory");
+        return -1;
+    }
+
+    bulk_service_set_handler(BULK_CONTENT_JPEG, on_image);
+    if (bulk_service_init() != 0) {
+        return -1;
+    }
+
+    if (xTaskCreatePinnedToCore(camera_task, "Camera", CAMERA_TASK_STACK_SIZE, NULL, CAMERA_TASK_PRIORITY,
+                                NULL, 0) != pdPASS) {
+        ESP_LOGE(CAMERA_TAG, "Failed to create camera task");
+        return -1;
+    }
+
+    ESP_LOGI(CAMERA_TAG, "Camera service started, source %s (on first capture)", s_source ? s_source->name() : "none");
     return 0;
 }
 
 int camera_service_start_stream(void) {
-    printf("[%s] Starting camera stream (stub implementation)\n", TAG);
-    // TODO: Implement actual camera streaming
+    if (!s_eventQueue || s_sourceState.load() == SOURCE_ABSENT) {
+        return -1;
+    }
+    s_streaming.store(true);
+    update_stats([](camera_service_stats_t& stats) { stats.streaming = true; });
+    ESP_LOGI(CAMERA_TAG, "Streaming an image every %d s", CAMERA_STREAM_INTERVAL_MS / 1000);
     return 0;
 }
 
 int camera_service_stop_stream(void) {
-    printf("[%s] Stopping camera stream (stub implementation)\n", TAG);
-    // TODO: Implement actual camera stop
+    if (!s_eventQueue) {
+        return -1;
+    }
+    s_streaming.store(false);
+    update_stats([](camera_service_stats_t& stats) { stats.streaming = false; });
     return 0;
 }
 
 int camera_service_capture_image(void) {
-    printf("[%s] Capturing image (stub implementation)\n", TAG);
-    // TODO: Implement actual image capture
-    return 0;
-}
\ No newline at end of file
+    return queue_capture(nullptr);
+}
+
+int camera_service_send_image_to(const char* peer_id) {
+    if (!peer_id || !peer_id[0] || strlen(peer_id) >= CAMERA_PEER_ID_LEN) {
+        return -1;
+    }
+    return queue_capture(peer_id);
+}
+
+bool camera_service_get_stats(camera_service_stats_t* stats) {
+    if (!s_statsMutex || !stats) {
+        return false;
+    }
+    if (xSemaphoreTake(s_statsMutex, CAMERA_STATS_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    *stats = s_stats;
+    xSemaphoreGive(s_statsMutex);
+    return true;
+}
@@ -16,7 +16,6 @@
 #include "nvs.h"
 #include "nvs_flash.h"
 #include <cstring>
-#include "esp_chip_info.h"
 #include <string>
 
 static const char* TAG = "CONFIG_MGR";
@@ -45,41 +44,8 @@ extern "C" {
 // ============================================================================
 
 hardware_platform_t config_manager_detect_hardware(void) {
-    // This is a simplified implementation
-    // In a real system, you would detect based on:
-    // - GPIO strapping pins
-    // - EFUSE values
-    // - Device tree information
-    // - Build-time defines
-
-#ifdef CONFIG_XIAO_ESP32S3
-    return HW_PLATFORM_XIAO_ESP32S3;
-#elif CONFIG_XIAO_ESP32C3
-    return HW_PLATFORM_XIAO_ESP32C3;
-#elif CONFIG_XIAO_ESP32C6
-    return HW_PLATFORM_XIAO_ESP32C6;
-#elif CONFIG_HELTEC_HT_HC32
-    return HW_PLATFORM_HELTEC_HT_HC32;
-#elif CONFIG_HELTEC_HT_IT01
-    return HW_PLATFORM_HELTEC_HT_IT01;
-#elif CONFIG_HELTEC_GENERIC
-    return HW_PLATFORM_HELTEC_GENERIC;
-#else
-    // Default fallback - try to detect based on chip information
-    esp_chip_info_t chip_info;
-    esp_chip_info(&chip_info);
-
-    if (chip_info.model == CHIP_ESP32S3) {
-        return HW_PLATFORM_XIAO_ESP32S3;
-    } else if (chip_info.model == CHIP_ESP32C3) {
-        return HW_PLATFORM_XIAO_ESP32C3;
-    } else if (chip_info.model == CHIP_ESP32C6) {
-        return HW_PLATFORM_XIAO_ESP32C6;
-    } else {
-        return HW_PLATFORM_ESP32_GENERIC;
-    }
-#endif
-    return HW_PLATFORM_UNKNOWN;
+    // Chosen in menuconfig; the firmware only carries this board's profile
+    return Board::platform;
 }
 
 const char* config_manager_get_platform_name(hardware_platform_t platform) {
@@ -104,18 +70,7 @@ const char* config_manager_get_platform_name(hardware_platform_t platform) {
 }
 
 bool config_manager_is_platform_supported(hardware_platform_t platform) {
-    switch (platform) {
-        case HW_PLATFORM_XIAO_ESP32S3:
-        case HW_PLATFORM_XIAO_ESP32C3:
-        case HW_PLATFORM_XIAO_ESP32C6:
-        case HW_PLATFORM_HELTEC_HT_HC32:
-        case HW_PLATFORM_HELTEC_HT_IT01:
-        case HW_PLATFORM_HELTEC_GENERIC:
-        case HW_PLATFORM_ESP32_GENERIC:
-            return true;
-        default:
-            return false;
-    }
+    return platform == Board::platform;
 }
 
 // ============================================================================
@@ -126,9 +81,15 @@ bool config_manager_get_defaults(hardware_platform_t platform, aircom_config_t*
     if (!config) {
         return false;
     }
+    if (platform != Board::platform) {
+        ESP_LOGE(TAG, "No profile for %s in this build (built for %s)",
+                 config_manager_get_platform_name(platform), Board::name);
+        return false;
+    }
 
-    // Clear the configuration structure
-    memset(config, 0, sizeof(aircom_config_t));
+    // Clear the configuration structure. Value-initialize rather than memset:
+    // the structure holds std::string members.
+    *config = aircom_config_t();
 
     // Set platform
     config->platform = platform;
@@ -155,14 +116,15 @@ bool config_manager_get_defaults(hardware_platform_t platform, aircom_config_t*
     config->audio.enable_compression = true;
     config->audio.enable_noise_reduction = false;
     config->audio.ptt_debounce_ms = 50;
+    config->audio.ptt_priority = 1;
 
-    config->display.width = 128;
-    config->display.height = 64;
+    config->display.width = Board::display_width;
+    config->display.height = Board::display_height;
     config->display.rotation = 0;
     config->display.enable_backlight = true;
     config->display.backlight_timeout_ms = 30000;
     config->display.brightness = 128;
-    config->display.enable_touch = false;
+    config->display.enable_touch = Board::display_touch;
     config->display.font_name = "default";
 
     config->gps.baud_rate = 9600;
@@ -183,198 +145,28 @@ bool config_manager_get_defaults(hardware_platform_t platform, aircom_config_t*
     config->system.device_id = "AC-" + std::to_string(esp_random() % 1000000);
     config->system.firmware_version = 0x020000; // 2.0.0
 
-    // Platform-specific pin configurations
-    switch (platform) {
-        case HW_PLATFORM_XIAO_ESP32S3:
-            return config_get_xiao_esp32s3_defaults(config);
-        case HW_PLATFORM_XIAO_ESP32C3:
-            return config_get_xiao_esp32c3_defaults(config);
-        case HW_PLATFORM_XIAO_ESP32C6:
-            return config_get_xiao_esp32c6_defaults(config);
-        case HW_PLATFORM_HELTEC_HT_HC32:
-            return config_get_heltec_ht_hc32_defaults(config);
-        case HW_PLATFORM_HELTEC_HT_IT01:
-            return config_get_heltec_ht_it01_defaults(config);
-        case HW_PLATFORM_HELTEC_GENERIC:
-            return config_get_heltec_generic_defaults(config);
-        default:
-            return config_get_xiao_esp32s3_defaults(config); // Default fallback
-    }
-}
-
-// Platform-specific configuration implementations
-bool config_get_xiao_esp32s3_defaults(aircom_config_t* config) {
-    config->pin_oled_sda = 5;
-    config->pin_oled_scl = 6;
-    config->pin_i2s_bclk = 7;
-    config->pin_i2s_lrc = 8;
-    config->pin_i2s_din = 9;
-    config->pin_i2s_dout = 10;
-    config->pin_button_ptt = 3;
-    config->pin_button_up = 1;
-    config->pin_button_down = 2;
-    config->pin_button_select = 0;
-    config->pin_button_back = 4;
-    config->pin_gps_rx = 43;
-    config->pin_gps_tx = 44;
-    config->pin_led = 21;
-    config->pin_battery_adc = 4;
-
-    // Wi-Fi HaLow pins from xiao_esp32_config.h
-    config->pin_wifihalow_mosi = get_spi_mosi_pin();
-    config->pin_wifihalow_miso = get_spi_miso_pin();
-    config->pin_wifihalow_sclk = get_spi_sclk_pin();
-    config->pin_wifihalow_cs = get_spi_cs_pin();
-    config->pin_wifihalow_reset = get_spi_reset_pin();
-    config->pin_wifihalow_int = get_spi_int_pin();
-
-    return true;
-}
-
-bool config_get_xiao_esp32c3_defaults(aircom_config_t* config) {
-    config->pin_oled_sda = 4;
-    config->pin_oled_scl = 5;
-    config->pin_i2s_bclk = 6;
-    config->pin_i2s_lrc = 7;
-    config->pin_i2s_din = 8;
-    config->pin_i2s_dout = 9;
-    config->pin_button_ptt = 3;
-    config->pin_button_up = 1;
-    config->pin_button_down = 2;
-    config->pin_button_select = 0;
-    config->pin_button_back = 10;
-    config->pin_gps_rx = 20;
-    config->pin_gps_tx = 21;
-    config->pin_led = 12;
-    config->pin_battery_adc = 2;
-
-    // Wi-Fi HaLow pins from xiao_esp32_config.h
-    config->pin_wifihalow_mosi = get_spi_mosi_pin();
-    config->pin_wifihalow_miso = get_spi_miso_pin();
-    config->pin_wifihalow_sclk = get_spi_sclk_pin();
-    config->pin_wifihalow_cs = get_spi_cs_pin();
-    config->pin_wifihalow_reset = get_spi_reset_pin();
-    config->pin_wifihalow_int = get_spi_int_pin();
-
-    return true;
-}
-
-bool config_get_xiao_esp32c6_defaults(aircom_config_t* config) {
-    config->pin_oled_sda = 4;
-    config->pin_oled_scl = 5;
-    config->pin_i2s_bclk = 6;
-    config->pin_i2s_lrc = 7;
-    config->pin_i2s_din = 8;
-    config->pin_i2s_dout = 9;
-    config->pin_button_ptt = 3;
-    config->pin_button_up = 1;
-    config->pin_button_down = 2;
-    config->pin_button_select = 0;
-    config->pin_button_back = 10;
-    config->pin_gps_rx = 20;
-    config->pin_gps_tx = 21;
-    config->pin_led = 15;
-    config->pin_battery_adc = 10;
-
-    // Wi-Fi HaLow pins from xiao_esp32_config.h
-    config->pin_wifihalow_mosi = get_spi_mosi_pin();
-    config->pin_wifihalow_miso = get_spi_miso_pin();
-    config->pin_wifihalow_sclk = get_spi_sclk_pin();
-    config->pin_wifihalow_cs = get_spi_cs_pin();
-    config->pin_wifihalow_reset = get_spi_reset_pin();
-    config->pin_wifihalow_int = get_spi_int_pin();
-
-    return true;
-}
-
-bool config_get_heltec_ht_hc32_defaults(aircom_config_t* config) {
-    config->pin_oled_sda = 4;
-    config->pin_oled_scl = 15;
-    config->pin_i2s_bclk = 26;
-    config->pin_i2s_lrc = 25;
-    config->pin_i2s_din = 33;
-    config->pin_i2s_dout = 32;
-    config->pin_button_ptt = 12;
-    config->pin_button_up = 13;
-    config->pin_button_down = 14;
-    config->pin_button_select = 0;
-    config->pin_button_back = 2;
-    config->pin_gps_rx = 34;
-    config->pin_gps_tx = 12;
-    config->pin_led = 25;
-    config->pin_battery_adc = 35;
-
-    // Camera-specific pins (HT-HC32 has camera)
-    config->display.enable_touch = false; // No touch on HT-HC32
-
-    // Wi-Fi HaLow pins - using generic ESP32 pins
-    config->pin_wifihalow_mosi = 23;
-    config->pin_wifihalow_miso = 19;
-    config->pin_wifihalow_sclk = 18;
-    config->pin_wifihalow_cs = 5;
-    config->pin_wifihalow_reset = 17;
-    config->pin_wifihalow_int = 16;
-
-    return true;
-}
-
-bool config_get_heltec_ht_it01_defaults(aircom_config_t* config) {
-    config->pin_oled_sda = 4;
-    config->pin_oled_scl = 15;
-    config->pin_i2s_bclk = 26;
-    config->pin_i2s_lrc = 25;
-    config->pin_i2s_din = 33;
-    config->pin_i2s_dout = 32;
-    config->pin_button_ptt = 12;
-    config->pin_button_up = 13;
-    config->pin_button_down = 14;
-    config->pin_button_select = 0;
-    config->pin_button_back = 2;
-    config->pin_gps_rx = 34;
-    config->pin_gps_tx = 12;
-    config->pin_led = 25;
-    config->pin_battery_adc = 35;
-
-    // Display-specific configuration (HT-IT01 has display)
-    config->display.width = 240;
-    config->display.height = 320;
-    config->display.enable_touch = true;
-
-    // Wi-Fi HaLow pins - using generic ESP32 pins
-    config->pin_wifihalow_mosi = 23;
-    config->pin_wifihalow_miso = 19;
-    config->pin_wifihalow_sclk = 18;
-    config->pin_wifihalow_cs = 5;
-    config->pin_wifihalow_reset = 17;
-    config->pin_wifihalow_int = 16;
-
-    return true;
-}
-
-bool config_get_heltec_generic_defaults(aircom_config_t* config) {
-    config->pin_oled_sda = 4;
-    config->pin_oled_scl = 15;
-    config->pin_i2s_bclk = 26;
-    config->pin_i2s_lrc = 25;
-    config->pin_i2s_din = 33;
-    config->pin_i2s_dout = 32;
-    config->pin_button_ptt = 12;
-    config->pin_button_up = 13;
-    config->pin_button_down = 14;
-    config->pin_button_select = 0;
-    config->pin_button_back = 2;
-    config->pin_gps_rx = 34;
-    config->pin_gps_tx = 12;
-    config->pin_led = 25;
-    config->pin_battery_adc = 35;
-
-    // Wi-Fi HaLow pins - using generic ESP32 pins
-    config->pin_wifihalow_mosi = 23;
-    config->pin_wifihalow_miso = 19;
-    config->pin_wifihalow_sclk = 18;
-    config->pin_wifihalow_cs = 5;
-    config->pin_wifihalow_reset = 17;
-    config->pin_wifihalow_int = 16;
+    config->pin_oled_sda = Board::pin_oled_sda;
+    config->pin_oled_scl = Board::pin_oled_scl;
+    config->pin_i2s_bclk = Board::pin_i2s_bclk;
+    config->pin_i2s_lrc = Board::pin_i2s_lrc;
+    config->pin_i2s_din = Board::pin_i2s_din;
+    config->pin_i2s_dout = Board::pin_i2s_dout;
+    config->pin_button_ptt = Board::pin_button_ptt;
+    config->pin_button_up = Board::pin_button_up;
+    config->pin_button_down = Board::pin_button_down;
+    config->pin_button_select = Board::pin_button_select;
+    config->pin_button_back = Board::pin_button_back;
+    config->pin_gps_rx = Board::pin_gps_rx;
+    config->pin_gps_tx = Board::pin_gps_tx;
+    config->pin_led = Board::pin_led;
+    config->pin_battery_adc = Board::pin_battery_adc;
+
+    config->pin_wifihalow_mosi = Board::pin_halow_mosi;
+    config->pin_wifihalow_miso = Board::pin_halow_miso;
+    config->pin_wifihalow_sclk = Board::pin_halow_sclk;
+    config->pin_wifihalow_cs = Board::pin_halow_cs;
+    config->pin_wifihalow_reset = Board::pin_halow_reset;
+    config->pin_wifihalow_int = Board::pin_halow_int;
 
     return true;
 }
@@ -401,9 +193,9 @@ bool config_manager_init(void) {
         return false;
     }
 
-    // Auto-detect hardware and load defaults
+    // Load the defaults of the board the firmware was built for
     hardware_platform_t detected_hw = config_manager_detect_hardware();
-    ESP_LOGI(TAG, "Detected hardware platform: %s", config_manager_get_platform_name(detected_hw));
+    ESP_LOGI(TAG, "Board: %s (%s)", Board::name, Board::soc_name);
 
     if (!config_manager_get_defaults(detected_hw, &g_current_config)) {
         ESP_LOGE(TAG, "Failed to get default configuration for platform");
@@ -443,6 +235,16 @@ bool config_manager_load(aircom_config_t* config) {
         config->network.password = buffer;
     }
 
+    str_len = sizeof(buffer);
+    if (nvs_get_str(handle, "net.fb_ssid", buffer, &str_len) == ESP_OK) {
+        config->network.fallback_ssid = buffer;
+    }
+
+    str_len = sizeof(buffer);
+    if (nvs_get_str(handle, "net.fb_password", buffer, &str_len) == ESP_OK) {
+        config->network.fallback_password = buffer;
+    }
+
     int32_t int_val;
     if (nvs_get_i32(handle, "net.channel", &int_val) == ESP_OK) {
         config->network.channel = int_val;
@@ -452,6 +254,9 @@ bool config_manager_load(aircom_config_t* config) {
     if (nvs_get_u8(handle, "net.enable_mesh", &bool_val) == ESP_OK) {
         config->network.enable_mesh = bool_val;
     }
+    if (nvs_get_u8(handle, "audio.ptt_prio", &bool_val) == ESP_OK) {
+        config->audio.ptt_priority = bool_val;
+    }
 
     nvs_close(handle);
     ESP_LOGI(TAG, "Configuration loaded from NVS");
@@ -472,8 +277,11 @@ bool config_manager_save(const aircom_config_t* config) {
     // Save network configuration
     nvs_set_str(handle, "net.ssid", config->network.ssid.c_str());
     nvs_set_str(handle, "net.password", config->network.password.c_str());
+    nvs_set_str(handle, "net.fb_ssid", config->network.fallback_ssid.c_str());
+    nvs_set_str(handle, "net.fb_password", config->network.fallback_password.c_str());
     nvs_set_i32(handle, "net.channel", config->network.channel);
     nvs_set_u8(handle, "net.enable_mesh", config->network.enable_mesh);
+    nvs_set_u8(handle, "audio.ptt_prio", config->audio.ptt_priority);
 
     err = nvs_commit(handle);
     nvs_close(handle);
@@ -503,6 +311,7 @@ bool config_manager_validate(const aircom_config_t* config) {
     // Validate audio configuration
     if (config->audio.sample_rate < 8000 || config->audio.sample_rate > 48000) return false;
     if (config->audio.channels < 1 || config->audio.channels > 2) return false;
+    if (config->audio.ptt_priority < 1 || config->audio.ptt_priority > 3) return false;
 
     // Validate system configuration
     if (config->system.task_stack_size_default < 1024) return false;
@@ -524,6 +333,15 @@ bool config_manager_get_string(const char* key, std::string* value) {
     } else if (strcmp(key, "network.password") == 0) {
         *value = g_current_config.network.password;
         return true;
+    } else if (strcmp(key, "network.country_code") == 0) {
+        *value = g_current_config.network.country_code;
+        return true;
+    } else if (strcmp(key, "network.fallback_ssid") == 0) {
+        *value = g_current_config.network.fallback_ssid;
+        return true;
+    } else if (strcmp(key, "network.fallback_password") == 0) {
+        *value = g_current_config.network.fallback_password;
+        return true;
     } else if (strcmp(key, "system.device_name") == 0) {
         *value = g_current_config.system.device_name;
         return true;
@@ -532,6 +350,13 @@ bool config_manager_get_string(const char* key, std::string* value) {
     return false;
 }
 
+bool config_manager_get_network_config(network_config_t* network) {
+    if (!network || !g_config_initialized) return false;
+
+    *network = g_current_config.network;
+    return true;
+}
+
 bool config_manager_set_string(const char* key, const std::string& value) {
     if (!key) return false;
 
@@ -541,6 +366,15 @@ bool config_manager_set_string(const char* key, const std::string& value) {
     } else if (strcmp(key, "network.password") == 0) {
         g_current_config.network.password = value;
         return true;
+    } else if (strcmp(key, "network.country_code") == 0) {
+        g_current_config.network.country_code = value;
+        return true;
+    } else if (strcmp(key, "network.fallback_ssid") == 0) {
+        g_current_config.network.fallback_ssid = value;
+        return true;
+    } else if (strcmp(key, "network.fallback_password") == 0) {
+        g_current_config.network.fallback_password = value;
+        return true;
     } else if (strcmp(key, "system.device_name") == 0) {
         g_current_config.system.device_name = value;
         return true;
@@ -558,6 +392,9 @@ bool config_manager_get_int(const char* key, int* value) {
     } else if (strcmp(key, "audio.sample_rate") == 0) {
         *value = g_current_config.audio.sample_rate;
         return true;
+    } else if (strcmp(key, "audio.ptt_priority") == 0) {
+        *value = g_current_config.audio.ptt_priority;
+        return true;
     } else if (strcmp(key, "system.log_level") == 0) {
         *value = g_current_config.system.log_level;
         return true;
@@ -575,6 +412,9 @@ bool config_manager_set_int(const char* key, int value) {
     } else if (strcmp(key, "audio.sample_rate") == 0) {
         g_current_config.audio.sample_rate = value;
         return true;
+    } else if (strcmp(key, "audio.ptt_priority") == 0) {
+        g_current_config.audio.ptt_priority = value;
+        return true;
     } else if (strcmp(key, "system.log_level") == 0) {
         g_current_config.system.log_level = value;
         return true;
@@ -0,0 +1,66 @@
+/**
+ * @file cot_message.cpp
+ * @brief Cursor-on-Target XML helpers for the ATAK tasks
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/cot_message.h"
+#include "include/config.h"
+#include "esp_system.h" // For MAC address
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Helper function to get current time in ISO 8601 format
+// Note: This requires the system time to be set, ideally from GPS or NTP.
+static std::string getISO8601Time(time_t timestamp) {
+    char buf[sizeof "2011-10-08T07:07:09Z"];
+    strftime(buf, sizeof buf, "%Y-%m-%dT%H:%M:%SZ", gmtime(&timestamp));
+    return std::string(buf);
+}
+
+std::string generateCoT(const GPSData& gpsData) {
+    char uid[32];
+    uint8_t mac[6];
+    esp_efuse_mac_get_default(mac);
+    sprintf(uid, "ESP32-%02x%02x%02x", mac[3], mac[4], mac[5]);
+
+    time_t now;
+    time(&now); // Get current time
+    time_t stale = now + 60; // Stale time 60 seconds from now
+
+    // Using std::string for easier concatenation
+    std::string cot = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    cot += "<event version=\"2.0\" uid=\"";
+    cot += uid;
+    cot += "\" type=\"a-f-G-E-V-C\" time=\"";
+    cot += getISO8601Time(now);
+    cot += "\" start=\"";
+    cot += getISO8601Time(now);
+    cot += "\" stale=\"";
+    cot += getISO8601Time(stale);
+    cot += "\" how=\"h-e\">";
+    cot += "<point lat=\"" + std::to_string(gpsData.latitude) +
+           "\" lon=\"" + std::to_string(gpsData.longitude) +
+           "\" hae=\"9999999.0\" ce=\"5\" le=\"9999999.0\"/>";
+    cot += "<detail>";
+    cot += "<contact callsign=\"" CALLSIGN "\"/>";
+    cot += "<uid Droid=\"" CALLSIGN "\"/>";
+    cot += "<__group name=\"Cyan\" role=\"Team Member\"/>";
+    cot += "</detail>";
+    cot += "</event>";
+
+    return cot;
+}
+
+std::string parse_cot_value(const std::string& cot, const char* key) {
+    size_t key_pos = cot.find(key);
+    if (key_pos == std::string::npos) return "";
+    key_pos += strlen(key); // Move to the start of the value
+    size_t end_quote_pos = cot.find('"', key_pos);
+    if (end_quote_pos == std::string::npos) return "";
+    return cot.substr(key_pos, end_quote_pos - key_pos);
+}
@@ -0,0 +1,536 @@
+/**
+ * @file dsp_kernels.cpp
+ * @brief Audio DSP kernels: dot product, FIR, biquad, saturating add, gain, int16/float conversion
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/board_profile.h"
+#include "include/dsp_kernels.h"
+#include <math.h>
+#include <string.h>
+#include <new>
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define DSP_KERNELS_PIE 1
+#elif !defined(ESP_PLATFORM) && defined(__SSE2__)
+#define DSP_KERNELS_SSE2 1
+#include <emmintrin.h>
+#elif !defined(ESP_PLATFORM) && defined(__ARM_NEON) && defined(__aarch64__)
+#define DSP_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(ESP_PLATFORM) && defined(DSP_KERNELS_PIE)
+static_assert(Board::has_simd, "PIE kernels on a SoC without them");
+#elif defined(ESP_PLATFORM)
+static_assert(!Board::has_simd, "Board has PIE but the kernels were not built for it");
+#endif
+
+#define DSP_S16_SCALE 32768.0f
+#define DSP_PIE_GROUPS 32       // 256 products per ACCX read: |sum| < 2^38 fits its 40 bits
+
+static inline int16_t sat_s16(int64_t value) {
+    return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+}
+
+static inline int64_t round_shift(int64_t value, int shift) {
+    return (value + ((int64_t)1 << (shift - 1))) >> shift;
+}
+
+// ----------------------------------------------------------------------------
+// Reference: the definition of every kernel
+// ----------------------------------------------------------------------------
+
+static int64_t ref_dot_s16(const int16_t* a, const int16_t* b, size_t n) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (int32_t)a[i] * b[i];
+    }
+    return sum;
+}
+
+// Shift the last taps - 1 samples to the front for the next block
+static void fir_keep_history(dsp_fir_s16_t* fir, size_t n) {
+    memmove(fir->history, fir->history + n, (fir->taps - 1) * sizeof(int16_t));
+}
+
+static void ref_fir_s16(dsp_fir_s16_t* fir, const int16_t* in, int16_t* out, size_t n) {
+    while (n > 0) {
+        size_t block = n < fir->maxBlock ? n : fir->maxBlock;
+        memcpy(fir->history + fir->taps - 1, in, block * sizeof(int16_t));
+        for (size_t k = 0; k < block; k++) {
+            int64_t sum = 0;
+            for (size_t t = 0; t < fir->taps; t++) {
+                sum += (int32_t)fir->coeffs[t] * fir->history[k + t];    // Copy 0 is the taps, reversed
+            }
+            out[k] = sat_s16(round_shift(sum, DSP_FIR_SHIFT));
+        }
+        fir_keep_history(fir, block);
+        in += block;
+        out += block;
+        n -= block;
+    }
+}
+
+static void ref_add_sat_s16(const int16_t* a, const int16_t* b, int16_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = sat_s16((int32_t)a[i] + b[i]);
+    }
+}
+
+static void ref_gain_s16(const int16_t* in, int16_t* out, size_t n, int16_t gain) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = sat_s16(round_shift((int32_t)in[i] * gain, DSP_GAIN_SHIFT));
+    }
+}
+
+static void ref_s16_to_f32(const int16_t* in, float* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (float)in[i] * (1.0f / DSP_S16_SCALE);
+    }
+}
+
+static void ref_f32_to_s16(const float* in, int16_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float v = in[i] * DSP_S16_SCALE;
+        v = v < -DSP_S16_SCALE ? -DSP_S16_SCALE : v > (float)INT16_MAX ? (float)INT16_MAX : v;
+        out[i] = (int16_t)lrintf(v);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// FIR on a dot product kernel, one aligned dot per output
+// ----------------------------------------------------------------------------
+
+template <int64_t (*DOT)(const int16_t*, const int16_t*, size_t)>
+static void fir_phased(dsp_fir_s16_t* fir, const int16_t* in, int16_t* out, size_t n) {
+    const size_t phaseMask = DSP_FIR_PHASES - 1;
+    while (n > 0) {
+        size_t block = n < fir->maxBlock ? n : fir->maxBlock;
+        memcpy(fir->history + fir->taps - 1, in, block * sizeof(int16_t));
+        for (size_t k = 0; k < block; k++) {
+            const int16_t* coeffs = fir->coeffs + (k & phaseMask) * fir->span;
+            out[k] = sat_s16(round_shift(DOT(fir->history + (k & ~phaseMask), coeffs, fir->span), DSP_FIR_SHIFT));
+        }
+        fir_keep_history(fir, block);
+        in += block;
+        out += block;
+        n -= block;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Unrolled scalar: ESP32, ESP32-C3/C6
+// ----------------------------------------------------------------------------
+
+static int64_t unrolled_dot_s16(const int16_t* a, const int16_t* b, size_t n) {
+    int64_t sum0 = 0;
+    int64_t sum1 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        sum0 += (int32_t)a[i] * b[i];
+        sum1 += (int32_t)a[i + 1] * b[i + 1];
+        sum0 += (int32_t)a[i + 2] * b[i + 2];
+        sum1 += (int32_t)a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        sum0 += (int32_t)a[i] * b[i];
+    }
+    return sum0 + sum1;
+}
+
+static void unrolled_add_sat_s16(const int16_t* a, const int16_t* b, int16_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        int32_t s0 = (int32_t)a[i] + b[i];
+        int32_t s1 = (int32_t)a[i + 1] + b[i + 1];
+        out[i] = sat_s16(s0);
+        out[i + 1] = sat_s16(s1);
+    }
+    if (i < n) {
+        out[i] = sat_s16((int32_t)a[i] + b[i]);
+    }
+}
+
+static void unrolled_gain_s16(const int16_t* in, int16_t* out, size_t n, int16_t gain) {
+    const int32_t round = 1 << (DSP_GAIN_SHIFT - 1);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        int32_t p0 = (int32_t)in[i] * gain + round;
+        int32_t p1 = (int32_t)in[i + 1] * gain + round;
+        out[i] = sat_s16(p0 >> DSP_GAIN_SHIFT);
+        out[i + 1] = sat_s16(p1 >> DSP_GAIN_SHIFT);
+    }
+    if (i < n) {
+        out[i] = sat_s16(((int32_t)in[i] * gain + round) >> DSP_GAIN_SHIFT);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ESP32-S3 PIE
+// ----------------------------------------------------------------------------
+
+#ifdef DSP_KERNELS_PIE
+
+static inline bool aligned16(const void* p) {
+    return ((uintptr_t)p & 15) == 0;
+}
+
+// Sum of groups * 8 products in ACCX; groups <= DSP_PIE_GROUPS
+static int64_t pie_dot_groups(const int16_t* a, const int16_t* b, size_t groups) {
+    uint32_t low;
+    uint32_t high;
+    __asm__ volatile(
+        "ee.zero.accx\n"
+        "1:\n"
+        "ee.vld.128.ip q0, %[a], 16\n"
+        "ee.vld.128.ip q1, %[b], 16\n"
+        "addi %[n], %[n], -1\n"
+        "ee.vmulas.s16.accx q0, q1\n"
+        "bnez %[n], 1b\n"
+        "rur.accx_0 %[low]\n"
+        "rur.accx_1 %[high]\n"
+        : [a] "+r"(a), [b] "+r"(b), [n] "+r"(groups), [low] "=r"(low), [high] "=r"(high)
+        :
+        : "memory");
+    return (int64_t)(((uint64_t)(int8_t)high << 32) | low);     // 40-bit two's complement
+}
+
+static int64_t pie_dot_s16(const int16_t* a, const int16_t* b, size_t n) {
+    int64_t sum = 0;
+    if (aligned16(a) && aligned16(b)) {
+        while (n >= DSP_FIR_PHASES) {
+            size_t groups = n / DSP_FIR_PHASES;
+            if (groups > DSP_PIE_GROUPS) {
+                groups = DSP_PIE_GROUPS;
+            }
+            sum += pie_dot_groups(a, b, groups);
+            a += groups * DSP_FIR_PHASES;
+            b += groups * DSP_FIR_PHASES;
+            n -= groups * DSP_FIR_PHASES;
+        }
+    }
+    return sum + unrolled_dot_s16(a, b, n);
+}
+
+static void pie_add_sat_s16(const int16_t* a, const int16_t* b, int16_t* out, size_t n) {
+    size_t groups = aligned16(a) && aligned16(b) && aligned16(out) ? n / DSP_FIR_PHASES : 0;
+    size_t done = groups * DSP_FIR_PHASES;
+    if (groups > 0) {
+        const int16_t* pa = a;
+        const int16_t* pb = b;
+        int16_t* po = out;
+        __asm__ volatile(
+            "1:\n"
+            "ee.vld.128.ip q0, %[a], 16\n"
+            "ee.vld.128.ip q1, %[b], 16\n"
+            "addi %[n], %[n], -1\n"
+            "ee.vadds.s16 q2, q0, q1\n"
+            "ee.vst.128.ip q2, %[o], 16\n"
+            "bnez %[n], 1b\n"
+            : [a] "+r"(pa), [b] "+r"(pb), [o] "+r"(po), [n] "+r"(groups)
+            :
+            : "memory");
+    }
+    unrolled_add_sat_s16(a + done, b + done, out + done, n - done);
+}
+
+#endif // DSP_KERNELS_PIE
+
+// ----------------------------------------------------------------------------
+// SSE2: x86-64 hosts
+// ----------------------------------------------------------------------------
+
+#ifdef DSP_KERNELS_SSE2
+
+static int64_t sse2_dot_s16(const int16_t* a, const int16_t* b, size_t n) {
+    // pmaddwd adds product pairs in 32 bits. Only (-32768)^2 twice
+    // overflows: 2^31 wraps to INT32_MIN, which a pair sum cannot
+    // otherwise reach. Count those and add 2^32 for each.
+    const __m128i wrapped = _mm_set1_epi32(INT32_MIN);
+    __m128i sum = _mm_setzero_si128();
+    __m128i wraps = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i pairs = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(a + i)),
+                                       _mm_loadu_si128((const __m128i*)(b + i)));
+        __m128i sign = _mm_srai_epi32(pairs, 31);
+        wraps = _mm_sub_epi32(wraps, _mm_cmpeq_epi32(pairs, wrapped));
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(pairs, sign));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(pairs, sign));
+    }
+    int64_t lanes[2];
+    int32_t counts[4];
+    _mm_storeu_si128((__m128i*)lanes, sum);
+    _mm_storeu_si128((__m128i*)counts, wraps);
+    int64_t total = lanes[0] + lanes[1];
+    total += ((int64_t)counts[0] + counts[1] + counts[2] + counts[3]) << 32;
+    return total + unrolled_dot_s16(a + i, b + i, n - i);
+}
+
+static void sse2_add_sat_s16(const int16_t* a, const int16_t* b, int16_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i sum = _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(a + i)),
+                                     _mm_loadu_si128((const __m128i*)(b + i)));
+        _mm_storeu_si128((__m128i*)(out + i), sum);
+    }
+    ref_add_sat_s16(a + i, b + i, out + i, n - i);
+}
+
+static void sse2_gain_s16(const int16_t* in, int16_t* out, size_t n, int16_t gain) {
+    const __m128i g = _mm_set1_epi16(gain);
+    const __m128i round = _mm_set1_epi32(1 << (DSP_GAIN_SHIFT - 1));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i low = _mm_mullo_epi16(x, g);
+        __m128i high = _mm_mulhi_epi16(x, g);
+        __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(low, high), round), DSP_GAIN_SHIFT);
+        __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(low, high), round), DSP_GAIN_SHIFT);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(p0, p1));
+    }
+    ref_gain_s16(in + i, out + i, n - i, gain);
+}
+
+static void sse2_s16_to_f32(const int16_t* in, float* out, size_t n) {
+    const __m128 scale = _mm_set1_ps(1.0f / DSP_S16_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+    ref_s16_to_f32(in + i, out + i, n - i);
+}
+
+static void sse2_f32_to_s16(const float* in, int16_t* out, size_t n) {
+    const __m128 scale = _mm_set1_ps(DSP_S16_SCALE);
+    const __m128 low = _mm_set1_ps(-DSP_S16_SCALE);
+    const __m128 high = _mm_set1_ps((float)INT16_MAX);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // Clamp first: cvtps2dq gives INT32_MIN for anything out of int32 range
+        __m128 v0 = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), high), low);
+        __m128 v1 = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), high), low);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(_mm_cvtps_epi32(v0), _mm_cvtps_epi32(v1)));
+    }
+    ref_f32_to_s16(in + i, out + i, n - i);
+}
+
+#endif // DSP_KERNELS_SSE2
+
+// ----------------------------------------------------------------------------
+// NEON: AArch64 hosts
+// ----------------------------------------------------------------------------
+
+#ifdef DSP_KERNELS_NEON
+
+static int64_t neon_dot_s16(const int16_t* a, const int16_t* b, size_t n) {
+    int64x2_t sum = vdupq_n_s64(0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(a + i);
+        int16x8_t y = vld1q_s16(b + i);
+        sum = vpadalq_s32(sum, vmull_s16(vget_low_s16(x), vget_low_s16(y)));
+        sum = vpadalq_s32(sum, vmull_high_s16(x, y));
+    }
+    return vaddvq_s64(sum) + unrolled_dot_s16(a + i, b + i, n - i);
+}
+
+static void neon_add_sat_s16(const int16_t* a, const int16_t* b, int16_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        vst1q_s16(out + i, vqaddq_s16(vld1q_s16(a + i), vld1q_s16(b + i)));
+    }
+    ref_add_sat_s16(a + i, b + i, out + i, n - i);
+}
+
+static void neon_gain_s16(const int16_t* in, int16_t* out, size_t n, int16_t gain) {
+    const int16x4_t g = vdup_n_s16(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        int32x4_t p0 = vrshrq_n_s32(vmull_s16(vget_low_s16(x), g), DSP_GAIN_SHIFT);
+        int32x4_t p1 = vrshrq_n_s32(vmull_s16(vget_high_s16(x), g), DSP_GAIN_SHIFT);
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(p0), vqmovn_s32(p1)));
+    }
+    ref_gain_s16(in + i, out + i, n - i, gain);
+}
+
+static void neon_s16_to_f32(const int16_t* in, float* out, size_t n) {
+    const float scale = 1.0f / DSP_S16_SCALE;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), scale));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(x)), scale));
+    }
+    ref_s16_to_f32(in + i, out + i, n - i);
+}
+
+static void neon_f32_to_s16(const float* in, int16_t* out, size_t n) {
+    const float32x4_t low = vdupq_n_f32(-DSP_S16_SCALE);
+    const float32x4_t high = vdupq_n_f32((float)INT16_MAX);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t v0 = vmaxq_f32(vminq_f32(vmulq_n_f32(vld1q_f32(in + i), DSP_S16_SCALE), high), low);
+        float32x4_t v1 = vmaxq_f32(vminq_f32(vmulq_n_f32(vld1q_f32(in + i + 4), DSP_S16_SCALE), high), low);
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(v0)), vqmovn_s32(vcvtnq_s32_f32(v1))));
+    }
+    ref_f32_to_s16(in + i, out + i, n - i);
+}
+
+#endif // DSP_KERNELS_NEON
+
+// ----------------------------------------------------------------------------
+// Sets and dispatch
+// ----------------------------------------------------------------------------
+
+static constexpr dsp_kernel_set_t SETS[] = {
+    {"reference", ref_dot_s16, ref_fir_s16, ref_add_sat_s16, ref_gain_s16, ref_s16_to_f32, ref_f32_to_s16},
+    {"unrolled", unrolled_dot_s16, fir_phased<unrolled_dot_s16>, unrolled_add_sat_s16, unrolled_gain_s16,
+     ref_s16_to_f32, ref_f32_to_s16},
+#if defined(DSP_KERNELS_PIE)
+    {"pie", pie_dot_s16, fir_phased<pie_dot_s16>, pie_add_sat_s16, unrolled_gain_s16, ref_s16_to_f32,
+     ref_f32_to_s16},
+#elif defined(DSP_KERNELS_SSE2)
+    {"sse2", sse2_dot_s16, fir_phased<sse2_dot_s16>, sse2_add_sat_s16, sse2_gain_s16, sse2_s16_to_f32,
+     sse2_f32_to_s16},
+#elif defined(DSP_KERNELS_NEON)
+    {"neon", neon_dot_s16, fir_phased<neon_dot_s16>, neon_add_sat_s16, neon_gain_s16, neon_s16_to_f32,
+     neon_f32_to_s16},
+#endif
+};
+
+static constexpr size_t SET_COUNT = sizeof(SETS) / sizeof(SETS[0]);
+static constexpr const dsp_kernel_set_t& ACTIVE = SETS[SET_COUNT - 1];
+
+int64_t dsp_dot_s16(const int16_t* a, const int16_t* b, size_t n) {
+    return ACTIVE.dot_s16(a, b, n);
+}
+
+void dsp_fir_s16(dsp_fir_s16_t* fir, const int16_t* in, int16_t* out, size_t n) {
+    ACTIVE.fir_s16(fir, in, out, n);
+}
+
+void dsp_add_sat_s16(const int16_t* a, const int16_t* b, int16_t* out, size_t n) {
+    ACTIVE.add_sat_s16(a, b, out, n);
+}
+
+void dsp_gain_s16(const int16_t* in, int16_t* out, size_t n, int16_t gain) {
+    ACTIVE.gain_s16(in, out, n, gain);
+}
+
+void dsp_s16_to_f32(const int16_t* in, float* out, size_t n) {
+    ACTIVE.s16_to_f32(in, out, n);
+}
+
+void dsp_f32_to_s16(const float* in, int16_t* out, size_t n) {
+    ACTIVE.f32_to_s16(in, out, n);
+}
+
+const char* dsp_kernels_impl(void) {
+    return ACTIVE.name;
+}
+
+size_t dsp_kernel_sets(const dsp_kernel_set_t** sets) {
+    *sets = SETS;
+    return SET_COUNT;
+}
+
+// ----------------------------------------------------------------------------
+// FIR set-up
+// ----------------------------------------------------------------------------
+
+bool dsp_fir_s16_init(dsp_fir_s16_t* fir, const int16_t* coeffs, size_t taps, size_t maxBlock) {
+    memset(fir, 0, sizeof(*fir));
+    if (taps == 0 || maxBlock == 0) {
+        return false;
+    }
+    // Output k reads span samples from index k & ~7, up to k + span
+    size_t span = (taps + DSP_FIR_PHASES - 1 + DSP_FIR_PHASES - 1) & ~(size_t)(DSP_FIR_PHASES - 1);
+    size_t history = (taps - 1 + maxBlock + span + DSP_FIR_PHASES - 1) & ~(size_t)(DSP_FIR_PHASES - 1);
+    fir->raw = new (std::nothrow) int16_t[DSP_FIR_PHASES * span + history + DSP_FIR_PHASES]();
+    if (!fir->raw) {
+        return false;
+    }
+    fir->coeffs = (int16_t*)(((uintptr_t)fir->raw + 15) & ~(uintptr_t)15);
+    fir->history = fir->coeffs + DSP_FIR_PHASES * span;
+    fir->taps = taps;
+    fir->span = span;
+    fir->maxBlock = maxBlock;
+    for (size_t phase = 0; phase < DSP_FIR_PHASES; phase++) {
+        for (size_t t = 0; t < taps; t++) {
+            fir->coeffs[phase * span + phase + t] = coeffs[taps - 1 - t];
+        }
+    }
+    return true;
+}
+
+void dsp_fir_s16_free(dsp_fir_s16_t* fir) {
+    delete[] fir->raw;
+    memset(fir, 0, sizeof(*fir));
+}
+
+// ----------------------------------------------------------------------------
+// Biquad
+// ----------------------------------------------------------------------------
+
+static int16_t to_q14(float value) {
+    float scaled = roundf(value * (float)(1 << DSP_BIQUAD_SHIFT));
+    return scaled >= (float)INT16_MAX ? INT16_MAX : scaled <= (float)INT16_MIN ? INT16_MIN : (int16_t)scaled;
+}
+
+void dsp_biquad_s16_set(dsp_biquad_s16_t* bq, float b0, float b1, float b2, float a1, float a2) {
+    memset(bq, 0, sizeof(*bq));
+    bq->b0 = to_q14(b0);
+    bq->b1 = to_q14(b1);
+    bq->b2 = to_q14(b2);
+    bq->a1 = to_q14(a1);
+    bq->a2 = to_q14(a2);
+}
+
+// RBJ audio EQ cookbook
+void dsp_biquad_s16_highpass(dsp_biquad_s16_t* bq, float cutoffHz, float sampleRate, float q) {
+    float w0 = 2.0f * (float)M_PI * cutoffHz / sampleRate;
+    float alpha = sinf(w0) / (2.0f * q);
+    float a0 = 1.0f + alpha;
+    float c = cosf(w0);
+    dsp_biquad_s16_set(bq, (1.0f + c) / 2.0f / a0, -(1.0f + c) / a0, (1.0f + c) / 2.0f / a0,
+                       -2.0f * c / a0, (1.0f - alpha) / a0);
+}
+
+void dsp_biquad_s16_lowpass(dsp_biquad_s16_t* bq, float cutoffHz, float sampleRate, float q) {
+    float w0 = 2.0f * (float)M_PI * cutoffHz / sampleRate;
+    float alpha = sinf(w0) / (2.0f * q);
+    float a0 = 1.0f + alpha;
+    float c = cosf(w0);
+    dsp_biquad_s16_set(bq, (1.0f - c) / 2.0f / a0, (1.0f - c) / a0, (1.0f - c) / 2.0f / a0,
+                       -2.0f * c / a0, (1.0f - alpha) / a0);
+}
+
+void dsp_biquad_s16(dsp_biquad_s16_t* bq, const int16_t* in, int16_t* out, size_t n) {
+    int32_t x1 = bq->x1, x2 = bq->x2, y1 = bq->y1, y2 = bq->y2;
+    for (size_t i = 0; i < n; i++) {
+        int32_t x = in[i];
+        // Five Q14 products can pass 2^31
+        int64_t sum = (int64_t)bq->b0 * x + (int64_t)bq->b1 * x1 + (int64_t)bq->b2 * x2
+                    - (int64_t)bq->a1 * y1 - (int64_t)bq->a2 * y2;
+        int16_t y = sat_s16(round_shift(sum, DSP_BIQUAD_SHIFT));
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        out[i] = y;
+    }
+    bq->x1 = (int16_t)x1;
+    bq->x2 = (int16_t)x2;
+    bq->y1 = (int16_t)y1;
+    bq->y2 = (int16_t)y2;
+}
@@ -0,0 +1,308 @@
+/**
+ * @file event_executor.cpp
+ * @brief Deferred event executor implementation
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/event_executor.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char* TAG = "EVENT_EXEC";
+
+static const char* const PRIORITY_NAMES[EVENT_PRIORITY_COUNT] = {"high", "normal", "low"};
+
+// Wait used by stop() for workers and post() calls to finish. stop() keeps
+// waiting past the timeout, since the queues cannot be deleted under them
+#define WORKER_EXIT_POLL_MS 10
+#define WORKER_EXIT_TIMEOUT_MS 1000
+
+EventExecutor::EventExecutor()
+    : m_config(defaultConfig())
+    , m_pending(NULL)
+    , m_running(false)
+    , m_activeWorkers(0)
+    , m_inFlight(0) {
+    for (int p = 0; p < EVENT_PRIORITY_COUNT; p++) {
+        m_queues[p] = NULL;
+    }
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        m_workers[i] = NULL;
+    }
+    resetStats();
+}
+
+EventExecutor::~EventExecutor() {
+    stop();
+}
+
+event_executor_config_t EventExecutor::defaultConfig() {
+    event_executor_config_t config = {};
+    config.worker_count = 2;
+    config.queue_depth[EVENT_PRIORITY_HIGH] = 8;
+    config.queue_depth[EVENT_PRIORITY_NORMAL] = 32;
+    config.queue_depth[EVENT_PRIORITY_LOW] = 8;
+    config.worker_stack_size = 4096;
+    config.worker_priority = 4;     // Above network tasks, below UI and audio
+    config.worker_core = 0;
+    return config;
+}
+
+bool EventExecutor::start(const event_executor_config_t& config) {
+    if (isRunning()) {
+        return true;
+    }
+
+    if (config.worker_count > MAX_WORKERS) {
+        ESP_LOGE(TAG, "Invalid worker count: %d", config.worker_count);
+        return false;
+    }
+
+    m_config = config;
+
+    UBaseType_t total_depth = 0;
+    for (int p = 0; p < EVENT_PRIORITY_COUNT; p++) {
+        m_queues[p] = xQueueCreate(config.queue_depth[p], sizeof(deferred_event_t));
+        if (!m_queues[p]) {
+            ESP_LOGE(TAG, "Failed to create %s priority queue", PRIORITY_NAMES[p]);
+            stop();
+            return false;
+        }
+        total_depth += config.queue_depth[p];
+    }
+
+    m_pending = xSemaphoreCreateCounting(total_depth + MAX_WORKERS, 0);
+    if (!m_pending) {
+        ESP_LOGE(TAG, "Failed to create pending semaphore");
+        stop();
+        return false;
+    }
+
+    m_running.store(true, std::memory_order_release);
+
+    for (uint8_t i = 0; i < config.worker_count; i++) {
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "EvtWorker%d", i);
+        BaseType_t result = xTaskCreatePinnedToCore(workerTask, name, config.worker_stack_size,
+                                                    this, config.worker_priority,
+                                                    &m_workers[i], config.worker_core);
+        if (result != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create worker %d", i);
+            stop();
+            return false;
+        }
+        m_activeWorkers.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ESP_LOGI(TAG, "Event executor started: %d workers, queue depths %d/%d/%d",
+             config.worker_count,
+             config.queue_depth[EVENT_PRIORITY_HIGH],
+             config.queue_depth[EVENT_PRIORITY_NORMAL],
+             config.queue_depth[EVENT_PRIORITY_LOW]);
+    return true;
+}
+
+void EventExecutor::stop() {
+    // Sequentially consistent with the m_inFlight increment in post(): either
+    // post() sees the flag cleared or this sees its call in flight
+    bool was_running = m_running.exchange(false);
+
+    // Wake every worker so it notices the stop flag and exits
+    if (was_running && m_pending) {
+        for (int i = 0; i < MAX_WORKERS; i++) {
+            xSemaphoreGive(m_pending);
+        }
+    }
+
+    // Workers and post() calls use the queues and m_pending until they are
+    // done, so wait for all of them however long a handler runs
+    int waited_ms = 0;
+    bool warned = false;
+    while (m_activeWorkers.load(std::memory_order_acquire) > 0 || m_inFlight.load() > 0) {
+        if (!warned && waited_ms >= WORKER_EXIT_TIMEOUT_MS) {
+            ESP_LOGW(TAG, "Workers still busy after %d ms, waiting for them to exit", WORKER_EXIT_TIMEOUT_MS);
+            warned = true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(WORKER_EXIT_POLL_MS));
+        waited_ms += WORKER_EXIT_POLL_MS;
+    }
+
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        m_workers[i] = NULL;
+    }
+
+    // Release events that were never dispatched
+    for (int p = 0; p < EVENT_PRIORITY_COUNT; p++) {
+        if (!m_queues[p]) {
+            continue;
+        }
+        deferred_event_t event;
+        while (xQueueReceive(m_queues[p], &event, 0) == pdPASS) {
+            releaseEvent(event);
+        }
+        vQueueDelete(m_queues[p]);
+        m_queues[p] = NULL;
+    }
+
+    if (m_pending) {
+        vSemaphoreDelete(m_pending);
+        m_pending = NULL;
+    }
+
+    if (was_running) {
+        ESP_LOGI(TAG, "Event executor stopped");
+    }
+}
+
+bool EventExecutor::post(event_priority_t priority, const EventHandler& handler,
+                         void* arg, event_release_fn_t release) {
+    deferred_event_t event;
+    event.handler = handler;
+    event.arg = arg;
+    event.release = release;
+    event.enqueued_us = esp_timer_get_time();
+
+    if (priority < 0 || priority >= EVENT_PRIORITY_COUNT || !handler.isSet()) {
+        releaseEvent(event);
+        return false;
+    }
+
+    // Hold stop() off the queues until this call returns
+    m_inFlight.fetch_add(1);
+    bool queued = m_running.load() && enqueue(priority, event);
+    m_inFlight.fetch_sub(1, std::memory_order_release);
+    if (!queued) {
+        releaseEvent(event);
+    }
+    return queued;
+}
+
+bool EventExecutor::enqueue(event_priority_t priority, const deferred_event_t& event) {
+    PriorityStats& stats = m_stats[priority];
+
+    // Never block the caller: this typically runs on the radio driver's thread
+    if (xQueueSend(m_queues[priority], &event, 0) != pdPASS) {
+        uint32_t dropped = stats.dropped.fetch_add(1, std::memory_order_relaxed) + 1;
+        // Log the first drop and then every 100th to avoid flooding the console
+        if (dropped == 1 || dropped % 100 == 0) {
+            ESP_LOGW(TAG, "%s priority queue full, dropped %u events so far",
+                     PRIORITY_NAMES[priority], (unsigned)dropped);
+        }
+        return false;
+    }
+
+    stats.posted.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t fill = (uint32_t)uxQueueMessagesWaiting(m_queues[priority]);
+    uint32_t high_water = stats.queueHighWater.load(std::memory_order_relaxed);
+    while (fill > high_water &&
+           !stats.queueHighWater.compare_exchange_weak(high_water, fill, std::memory_order_relaxed)) {
+    }
+
+    xSemaphoreGive(m_pending);
+    return true;
+}
+
+void EventExecutor::workerTask(void* pvParameters) {
+    EventExecutor* self = static_cast<EventExecutor*>(pvParameters);
+
+    while (true) {
+        xSemaphoreTake(self->m_pending, portMAX_DELAY);
+        if (!self->isRunning()) {
+            break;
+        }
+        self->runNext();
+    }
+
+    self->m_activeWorkers.fetch_sub(1, std::memory_order_release);
+    vTaskDelete(NULL);
+}
+
+size_t EventExecutor::runPending() {
+    size_t ran = 0;
+    m_inFlight.fetch_add(1);
+    while (m_running.load() && xSemaphoreTake(m_pending, 0) == pdTRUE) {
+        if (runNext()) {
+            ran++;
+        }
+    }
+    m_inFlight.fetch_sub(1, std::memory_order_release);
+    return ran;
+}
+
+// Caller holds one count of m_pending
+bool EventExecutor::runNext() {
+    deferred_event_t event;
+    for (int p = 0; p < EVENT_PRIORITY_COUNT; p++) {
+        if (xQueueReceive(m_queues[p], &event, 0) == pdPASS) {
+            dispatch((event_priority_t)p, event);
+            return true;
+        }
+    }
+    return false;
+}
+
+void EventExecutor::dispatch(event_priority_t priority, deferred_event_t& event) {
+    PriorityStats& stats = m_stats[priority];
+
+    int64_t delay = esp_timer_get_time() - event.enqueued_us;
+    uint32_t delay_us = delay > 0 ? (uint32_t)delay : 0;
+    stats.totalDelayUs.fetch_add(delay_us, std::memory_order_relaxed);
+    uint32_t max_delay = stats.maxDelayUs.load(std::memory_order_relaxed);
+    while (delay_us > max_delay &&
+           !stats.maxDelayUs.compare_exchange_weak(max_delay, delay_us, std::memory_order_relaxed)) {
+    }
+
+    event.handler(event.arg);
+    stats.executed.fetch_add(1, std::memory_order_relaxed);
+
+    releaseEvent(event);
+}
+
+void EventExecutor::releaseEvent(deferred_event_t& event) {
+    if (event.release && event.arg) {
+        event.release(event.arg);
+    }
+    event.arg = nullptr;
+}
+
+event_executor_stats_t EventExecutor::getStats(event_priority_t priority) const {
+    event_executor_stats_t result = {};
+    if (priority < 0 || priority >= EVENT_PRIORITY_COUNT) {
+        return result;
+    }
+
+    const PriorityStats& stats = m_stats[priority];
+    result.posted = stats.posted.load(std::memory_order_relaxed);
+    result.dropped = stats.dropped.load(std::memory_order_relaxed);
+    result.executed = stats.executed.load(std::memory_order_relaxed);
+    result.queue_high_water = stats.queueHighWater.load(std::memory_order_relaxed);
+    result.max_delay_us = stats.maxDelayUs.load(std::memory_order_relaxed);
+    uint64_t total = stats.totalDelayUs.load(std::memory_order_relaxed);
+    result.avg_delay_us = result.executed > 0 ? (uint32_t)(total / result.executed) : 0;
+    return result;
+}
+
+void EventExecutor::resetStats() {
+    for (int p = 0; p < EVENT_PRIORITY_COUNT; p++) {
+        m_stats[p].posted.store(0, std::memory_order_relaxed);
+        m_stats[p].dropped.store(0, std::memory_order_relaxed);
+        m_stats[p].executed.store(0, std::memory_order_relaxed);
+        m_stats[p].queueHighWater.store(0, std::memory_order_relaxed);
+        m_stats[p].totalDelayUs.store(0, std::memory_order_relaxed);
+        m_stats[p].maxDelayUs.store(0, std::memory_order_relaxed);
+    }
+}
+
+void EventExecutor::logStats() const {
+    for (int p = 0; p < EVENT_PRIORITY_COUNT; p++) {
+        event_executor_stats_t stats = getStats((event_priority_t)p);
+        ESP_LOGI(TAG, "%s: posted=%u dropped=%u executed=%u hwm=%u delay avg=%uus max=%uus",
+                 PRIORITY_NAMES[p], (unsigned)stats.posted, (unsigned)stats.dropped,
+                 (unsigned)stats.executed, (unsigned)stats.queue_high_water,
+                 (unsigned)stats.avg_delay_us, (unsigned)stats.max_delay_us);
+    }
+}
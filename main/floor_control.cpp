@@ -0,0 +1,629 @@
+/**
+ * @file floor_control.cpp
+ * @brief Distributed push-to-talk floor control for half-duplex voice
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/floor_control.h"
+#include "esp_log.h"
+#include <string.h>
+#include <algorithm>
+
+static const char* TAG = "FLOOR_CONTROL";
+
+// Frame header: magic, protocol version, frame type
+static const uint8_t FRAME_MAGIC[4] = {'A', 'F', 'L', 'R'};
+static const uint8_t PROTOCOL_VERSION = 1;
+static const size_t FRAME_HEADER_SIZE = 6;
+
+enum {
+    FRAME_REQUEST = 1,                      // Sender wants to talk
+    FRAME_TAKEN = 2,                        // Sender talks; carries its queue
+    FRAME_QUEUED = 3,                       // Holder to target: wait at this position
+    FRAME_GRANT = 4,                        // Holder to target: your turn; carries the rest of the queue
+    FRAME_RELEASE = 5                       // Holder: floor free
+};
+
+floor_config_t floor_default_config(void) {
+    floor_config_t config;
+    config.request_timeout_ms = 40;
+    config.request_attempts = 3;
+    config.taken_interval_ms = 500;
+    config.idle_timeout_ms = 1600;
+    config.grant_accept_ms = 3000;
+    config.max_talk_ms = 60000;
+    config.queue_slot_ms = 80;
+    return config;
+}
+
+// ============================================================================
+// FRAMES
+// ============================================================================
+
+static void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void put_id(std::vector<uint8_t>* out, const std::string& id) {
+    out->push_back((uint8_t)id.size());
+    out->insert(out->end(), id.begin(), id.end());
+}
+
+static uint32_t get_u32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static bool get_id(const uint8_t** cursor, const uint8_t* end, std::string* id) {
+    if (*cursor >= end) {
+        return false;
+    }
+    size_t length = **cursor;
+    if (length >= FLOOR_NODE_ID_LEN || (size_t)(end - *cursor) < 1 + length) {
+        return false;
+    }
+    id->assign((const char*)*cursor + 1, length);
+    *cursor += 1 + length;
+    return true;
+}
+
+bool FloorControl::isFloorFrame(const uint8_t* data, size_t length) {
+    return data && length >= FRAME_HEADER_SIZE && memcmp(data, FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0 &&
+           data[4] == PROTOCOL_VERSION;
+}
+
+bool FloorControl::send(uint8_t type, const std::string& target, uint8_t position,
+                        const std::vector<Request>* queue) {
+    const uint8_t header[FRAME_HEADER_SIZE] = {FRAME_MAGIC[0], FRAME_MAGIC[1], FRAME_MAGIC[2], FRAME_MAGIC[3],
+                                               PROTOCOL_VERSION, type};
+    std::vector<uint8_t> frame(header, header + sizeof(header));
+    frame.push_back(m_group);
+    frame.push_back(m_priority);
+    frame.push_back(position);
+    put_u32(&frame, m_token);
+    put_id(&frame, m_nodeId);
+    put_id(&frame, target);
+    size_t count = queue ? std::min(queue->size(), (size_t)FLOOR_MAX_QUEUE) : 0;
+    frame.push_back((uint8_t)count);
+    for (size_t i = 0; i < count; i++) {
+        frame.push_back((*queue)[i].priority);
+        put_u32(&frame, (*queue)[i].token);
+        put_id(&frame, (*queue)[i].nodeId);
+    }
+    m_stats.frames_sent++;
+    return m_send(frame);
+}
+
+bool FloorControl::decode(const uint8_t* data, size_t length, Frame* frame) {
+    if (!isFloorFrame(data, length) || length < FRAME_HEADER_SIZE + 7) {
+        return false;
+    }
+    const uint8_t* cursor = data + FRAME_HEADER_SIZE;
+    const uint8_t* end = data + length;
+    frame->type = data[5];
+    frame->group = cursor[0];
+    frame->priority = cursor[1];
+    frame->position = cursor[2];
+    frame->token = get_u32(cursor + 3);
+    cursor += 7;
+    if (!get_id(&cursor, end, &frame->sender) || !get_id(&cursor, end, &frame->target) || cursor >= end) {
+        return false;
+    }
+    size_t count = *cursor++;
+    if (count > FLOOR_MAX_QUEUE) {
+        return false;
+    }
+    frame->queue.resize(count);
+    for (Request& request : frame->queue) {
+        if (end - cursor < 5) {
+            return false;
+        }
+        request.priority = cursor[0];
+        request.token = get_u32(cursor + 1);
+        cursor += 5;
+        if (!get_id(&cursor, end, &request.nodeId)) {
+            return false;
+        }
+    }
+    return !frame->sender.empty();
+}
+
+// ============================================================================
+// LOCAL EVENTS
+// ============================================================================
+
+FloorControl::FloorControl(const std::string& nodeId, uint8_t priority, SendFunction send, TalkFunction talk,
+                           const floor_config_t& config, uint32_t seed)
+    : m_nodeId(nodeId.substr(0, FLOOR_NODE_ID_LEN - 1)),
+      m_priority(priority),
+      m_send(send),
+      m_talk(talk),
+      m_config(config),
+      m_random(seed ? seed : 1) {
+}
+
+uint32_t FloorControl::nextRandom() {
+    m_random = m_random * 1664525u + 1013904223u;
+    return m_random >> 8;
+}
+
+void FloorControl::setGroup(uint8_t group, uint32_t nowMs) {
+    if (group == m_group) {
+        return;
+    }
+    if (m_state == FLOOR_STATE_TALKING) {
+        m_talk(false);
+    }
+    if (m_state == FLOOR_STATE_TALKING || m_state == FLOOR_STATE_GRANTED) {
+        m_wantFloor = false;
+        passFloor(nowMs);                   // On the old group
+    }
+    m_group = group;
+    m_state = FLOOR_STATE_IDLE;
+    m_pttDown = false;
+    m_wantFloor = false;
+    m_keepRequest = false;
+    m_floorBusy = false;
+    m_requestAtMs = 0;
+    m_requestOnTaken = false;
+    m_talker.clear();
+    m_queuePosition = 0;
+    m_queue.clear();
+    m_grantTo.clear();
+    m_grantQueue.clear();
+}
+
+void FloorControl::pttDown(uint32_t nowMs) {
+    if (m_pttDown) {
+        return;
+    }
+    m_pttDown = true;
+    switch (m_state) {
+        case FLOOR_STATE_IDLE:
+            m_wantFloor = true;
+            m_floorBusy = false;
+            beginRequest(nowMs);
+            break;
+        case FLOOR_STATE_BUSY:
+            m_wantFloor = true;
+            m_keepRequest = true;
+            m_floorBusy = true;
+            beginRequest(nowMs);
+            break;
+        case FLOOR_STATE_GRANTED:
+            startTalking(nowMs);
+            break;
+        default:
+            break;                          // Asked already, or talking
+    }
+}
+
+void FloorControl::pttUp(uint32_t nowMs) {
+    if (!m_pttDown) {
+        return;
+    }
+    m_pttDown = false;
+    if (m_state == FLOOR_STATE_TALKING) {
+        m_talk(false);
+        passFloor(nowMs);
+    } else if (m_state == FLOOR_STATE_REQUESTING && !m_keepRequest) {
+        // A short press on a free floor: nothing to queue. Nodes that
+        // backed off from this request need not wait for it.
+        m_wantFloor = false;
+        m_state = FLOOR_STATE_IDLE;
+        send(FRAME_RELEASE, "", 0, nullptr);
+    }
+}
+
+void FloorControl::beginRequest(uint32_t nowMs) {
+    m_token = nextRandom();
+    m_attempts = 0;
+    m_requestAtMs = 0;
+    m_requestOnTaken = false;
+    sendRequest(nowMs);
+}
+
+void FloorControl::sendRequest(uint32_t nowMs) {
+    m_state = FLOOR_STATE_REQUESTING;
+    m_attempts++;
+    m_deadlineMs = nowMs + m_config.request_timeout_ms;
+    m_stats.requests++;
+    send(FRAME_REQUEST, m_talker, 0, nullptr);
+}
+
+void FloorControl::requestTimedOut(uint32_t nowMs) {
+    if (m_floorBusy) {
+        // The holder did not answer; its TAKEN list will tell us where we stand
+        queuedAt(0);
+    } else if (m_pttDown) {
+        startTalking(nowMs);
+    } else {
+        holdGranted(nowMs);
+    }
+}
+
+void FloorControl::startTalking(uint32_t nowMs) {
+    m_state = FLOOR_STATE_TALKING;
+    m_wantFloor = false;
+    m_keepRequest = false;
+    m_floorBusy = false;
+    m_requestAtMs = 0;
+    m_requestOnTaken = false;
+    m_talker.clear();
+    m_queuePosition = 0;
+    m_turnStartMs = nowMs;
+    m_deadlineMs = nowMs + m_config.taken_interval_ms;
+    m_stats.turns++;
+    m_talk(true);
+    send(FRAME_TAKEN, "", 0, &m_queue);
+}
+
+// Floor won while PTT is up: keep it a while for the user
+void FloorControl::holdGranted(uint32_t nowMs) {
+    m_state = FLOOR_STATE_GRANTED;
+    m_wantFloor = false;
+    m_keepRequest = false;
+    m_floorBusy = false;
+    m_talker.clear();
+    m_queuePosition = 0;
+    m_turnStartMs = nowMs;
+    m_deadlineMs = nowMs + m_config.taken_interval_ms;
+    send(FRAME_TAKEN, "", 0, &m_queue);
+}
+
+// The holder lets go: the head of the queue is next, or the floor is free
+void FloorControl::passFloor(uint32_t nowMs) {
+    m_grantTo.clear();
+    m_grantQueue.clear();
+    if (m_queue.empty()) {
+        send(FRAME_RELEASE, "", 0, nullptr);
+        m_state = FLOOR_STATE_IDLE;
+        m_talker.clear();
+        return;
+    }
+    Request next = m_queue.front();
+    m_grantQueue.assign(m_queue.begin() + 1, m_queue.end());
+    m_queue.clear();
+    m_grantTo = next.nodeId;
+    m_grantAttempts = 1;
+    m_deadlineMs = nowMs + m_config.request_timeout_ms;
+    send(FRAME_GRANT, next.nodeId, 0, &m_grantQueue);
+
+    setTalker(next.nodeId, next.priority, nowMs);
+    m_state = FLOOR_STATE_BUSY;
+    if (m_wantFloor) {
+        uint8_t position = 0;
+        for (size_t i = 0; i < m_grantQueue.size(); i++) {
+            if (m_grantQueue[i].nodeId == m_nodeId) {
+                position = (uint8_t)(i + 1);
+            }
+        }
+        queuedAt(position);
+    }
+}
+
+// Position (1 is next) of the request in the holder's queue; 0 if the queue is full
+uint8_t FloorControl::enqueue(const Request& request, bool front) {
+    m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(),
+                                 [&](const Request& queued) { return queued.nodeId == request.nodeId; }),
+                  m_queue.end());
+    if (m_queue.size() >= FLOOR_MAX_QUEUE) {
+        return 0;
+    }
+    auto it = m_queue.begin();
+    if (!front) {
+        while (it != m_queue.end() && it->priority >= request.priority) {
+            ++it;
+        }
+    }
+    it = m_queue.insert(it, request);
+    return (uint8_t)(it - m_queue.begin() + 1);
+}
+
+void FloorControl::setTalker(const std::string& nodeId, uint8_t priority, uint32_t nowMs) {
+    m_talker = nodeId;
+    m_talkerPriority = priority;
+    m_talkerHeardMs = nowMs;
+}
+
+void FloorControl::queuedAt(uint8_t position) {
+    if (m_state != FLOOR_STATE_QUEUED) {
+        m_stats.queued++;
+    }
+    m_state = FLOOR_STATE_QUEUED;
+    m_keepRequest = true;
+    m_floorBusy = true;
+    m_queuePosition = position;
+}
+
+// The talker released the floor or went silent
+void FloorControl::floorFree(uint32_t nowMs) {
+    m_talker.clear();
+    m_floorBusy = false;
+    m_requestOnTaken = false;
+    if (m_wantFloor) {
+        // Still queued, without a holder: queued nodes ask in queue order,
+        // unknown positions last
+        uint32_t slot = m_queuePosition ? m_queuePosition - 1 : FLOOR_MAX_QUEUE;
+        uint32_t jitter = nextRandom() % (m_config.queue_slot_ms / 2 + 1);
+        m_requestAtMs = (nowMs + slot * m_config.queue_slot_ms + jitter) | 1;
+        m_state = FLOOR_STATE_QUEUED;
+    } else {
+        m_state = FLOOR_STATE_IDLE;
+    }
+    m_queuePosition = 0;
+}
+
+bool FloorControl::outranks(uint8_t priority, uint32_t token, const std::string& nodeId) const {
+    if (priority != m_priority) {
+        return priority > m_priority;
+    }
+    if (token != m_token) {
+        return token > m_token;
+    }
+    return nodeId > m_nodeId;
+}
+
+// ============================================================================
+// FRAMES FROM OTHER NODES
+// ============================================================================
+
+void FloorControl::handleFrame(const uint8_t* data, size_t length, uint32_t nowMs) {
+    Frame frame;
+    if (!decode(data, length, &frame) || frame.group != m_group || frame.sender == m_nodeId) {
+        return;
+    }
+    m_stats.frames_received++;
+    if (frame.sender == m_talker) {
+        m_talkerHeardMs = nowMs;
+    }
+    switch (frame.type) {
+        case FRAME_REQUEST: onRequest(frame, nowMs); break;
+        case FRAME_TAKEN: onTaken(frame, nowMs); break;
+        case FRAME_QUEUED: onQueued(frame, nowMs); break;
+        case FRAME_GRANT: onGrant(frame, nowMs); break;
+        case FRAME_RELEASE: onRelease(frame, nowMs); break;
+        default: break;
+    }
+}
+
+void FloorControl::onRequest(const Frame& frame, uint32_t nowMs) {
+    Request request;
+    request.nodeId = frame.sender;
+    request.priority = frame.priority;
+    request.token = frame.token;
+
+    if (m_state == FLOOR_STATE_TALKING || m_state == FLOOR_STATE_GRANTED) {
+        if (frame.priority > m_priority) {
+            // Priority override: the requester talks now, this node waits if its user still does
+            ESP_LOGI(TAG, "Floor taken over by %s (priority %u)", frame.sender.c_str(), (unsigned)frame.priority);
+            m_stats.preempted++;
+            if (m_state == FLOOR_STATE_TALKING) {
+                m_talk(false);
+            }
+            enqueue(request, true);
+            m_wantFloor = m_pttDown;
+            if (m_wantFloor) {
+                Request self;
+                self.nodeId = m_nodeId;
+                self.priority = m_priority;
+                self.token = m_token;
+                enqueue(self, false);
+            }
+            passFloor(nowMs);
+            return;
+        }
+        uint8_t position = enqueue(request, false);
+        if (position) {
+            send(FRAME_QUEUED, request.nodeId, position, nullptr);
+        }
+    } else if (m_state == FLOOR_STATE_REQUESTING && !m_floorBusy) {
+        if (outranks(frame.priority, frame.token, frame.sender)) {
+            // Both asked for a free floor and the other wins: ask it once it talks
+            m_stats.contentions_lost++;
+            setTalker(frame.sender, frame.priority, nowMs);
+            m_requestOnTaken = true;
+            queuedAt(0);
+        } else {
+            // This node wins; make sure the other hears it
+            m_stats.requests++;
+            send(FRAME_REQUEST, "", 0, nullptr);
+        }
+    }
+}
+
+void FloorControl::onTaken(const Frame& frame, uint32_t nowMs) {
+    if (frame.sender == m_grantTo) {
+        m_grantTo.clear();
+        m_grantQueue.clear();
+    }
+
+    if (m_state == FLOOR_STATE_TALKING || m_state == FLOOR_STATE_GRANTED) {
+        // Both hold the floor: their requests crossed or were lost
+        m_stats.double_holds++;
+        if (!outranks(frame.priority, frame.token, frame.sender)) {
+            send(FRAME_TAKEN, "", 0, &m_queue);  // Tell it to yield
+            return;
+        }
+        ESP_LOGW(TAG, "%s holds the floor too; yielding", frame.sender.c_str());
+        if (m_state == FLOOR_STATE_TALKING) {
+            m_talk(false);
+        }
+        m_queue.clear();                    // Those nodes will ask the new holder
+        setTalker(frame.sender, frame.priority, nowMs);
+        m_state = FLOOR_STATE_BUSY;
+        if (m_pttDown) {
+            m_wantFloor = true;
+            m_keepRequest = true;
+            m_floorBusy = true;
+            beginRequest(nowMs);
+        }
+        return;
+    }
+
+    setTalker(frame.sender, frame.priority, nowMs);
+    if (!m_wantFloor) {
+        m_state = FLOOR_STATE_BUSY;
+        return;
+    }
+    m_keepRequest = true;
+    bool backingOff = m_requestAtMs != 0;
+    m_requestAtMs = 0;
+    if ((m_state == FLOOR_STATE_REQUESTING && !m_floorBusy) || m_requestOnTaken || backingOff) {
+        // Someone else got the floor first: get in its queue
+        m_floorBusy = true;
+        m_requestOnTaken = false;
+        m_attempts = 0;
+        sendRequest(nowMs);
+    } else if (m_state == FLOOR_STATE_QUEUED) {
+        uint8_t position = 0;
+        for (size_t i = 0; i < frame.queue.size(); i++) {
+            if (frame.queue[i].nodeId == m_nodeId) {
+                position = (uint8_t)(i + 1);
+            }
+        }
+        if (position) {
+            m_queuePosition = position;
+        } else if (frame.queue.size() < FLOOR_MAX_QUEUE) {
+            m_attempts = 0;                 // The holder lost the request
+            sendRequest(nowMs);
+        }
+    }
+}
+
+void FloorControl::onQueued(const Frame& frame, uint32_t nowMs) {
+    if (frame.target != m_nodeId || !m_wantFloor ||
+        (m_state != FLOOR_STATE_REQUESTING && m_state != FLOOR_STATE_QUEUED)) {
+        return;
+    }
+    setTalker(frame.sender, frame.priority, nowMs);
+    queuedAt(frame.position);
+}
+
+void FloorControl::onGrant(const Frame& frame, uint32_t nowMs) {
+    if (frame.target == m_nodeId) {
+        if (m_state == FLOOR_STATE_TALKING || m_state == FLOOR_STATE_GRANTED) {
+            return;                         // Repeat of a grant already taken
+        }
+        m_queue.clear();
+        for (const Request& request : frame.queue) {
+            if (request.nodeId != m_nodeId) {
+                m_queue.push_back(request);
+            }
+        }
+        if (m_pttDown) {
+            startTalking(nowMs);
+        } else if (m_wantFloor) {
+            holdGranted(nowMs);
+        } else {
+            // Nobody here wants it any more: the next one in line gets it
+            m_talker.clear();
+            passFloor(nowMs);
+        }
+        return;
+    }
+
+    if (m_state == FLOOR_STATE_TALKING || m_state == FLOOR_STATE_GRANTED) {
+        return;                             // Settled by TAKEN
+    }
+    setTalker(frame.target, frame.priority, nowMs);
+    if (!m_wantFloor) {
+        m_state = FLOOR_STATE_BUSY;
+        return;
+    }
+    uint8_t position = 0;
+    for (size_t i = 0; i < frame.queue.size(); i++) {
+        if (frame.queue[i].nodeId == m_nodeId) {
+            position = (uint8_t)(i + 1);
+        }
+    }
+    if (position) {
+        queuedAt(position);
+    } else {
+        m_floorBusy = true;
+        m_keepRequest = true;
+        m_requestAtMs = 0;
+        m_requestOnTaken = true;            // Ask the new holder once it talks
+        queuedAt(0);
+    }
+}
+
+void FloorControl::onRelease(const Frame& frame, uint32_t nowMs) {
+    if (!m_talker.empty() && frame.sender != m_talker) {
+        return;                             // Not the node we wait for
+    }
+    if (m_state == FLOOR_STATE_BUSY || m_state == FLOOR_STATE_QUEUED ||
+        (m_state == FLOOR_STATE_REQUESTING && m_floorBusy)) {
+        floorFree(nowMs);
+    }
+}
+
+// ============================================================================
+// TIMERS
+// ============================================================================
+
+void FloorControl::tick(uint32_t nowMs) {
+    if (m_requestAtMs && m_state == FLOOR_STATE_QUEUED && (int32_t)(nowMs - m_requestAtMs) >= 0) {
+        m_requestAtMs = 0;
+        m_floorBusy = false;
+        beginRequest(nowMs);
+    }
+
+    switch (m_state) {
+        case FLOOR_STATE_REQUESTING:
+            if ((int32_t)(nowMs - m_deadlineMs) >= 0) {
+                if (m_attempts < m_config.request_attempts) {
+                    sendRequest(nowMs);
+                } else {
+                    requestTimedOut(nowMs);
+                }
+            }
+            break;
+
+        case FLOOR_STATE_TALKING:
+            if (nowMs - m_turnStartMs >= m_config.max_talk_ms) {
+                ESP_LOGW(TAG, "Turn longer than %u ms; releasing the floor", (unsigned)m_config.max_talk_ms);
+                m_stats.talk_timeouts++;
+                m_talk(false);
+                passFloor(nowMs);
+            } else if ((int32_t)(nowMs - m_deadlineMs) >= 0) {
+                m_deadlineMs = nowMs + m_config.taken_interval_ms;
+                send(FRAME_TAKEN, "", 0, &m_queue);
+            }
+            break;
+
+        case FLOOR_STATE_GRANTED:
+            if (nowMs - m_turnStartMs >= m_config.grant_accept_ms) {
+                passFloor(nowMs);           // The user did not take it
+            } else if ((int32_t)(nowMs - m_deadlineMs) >= 0) {
+                m_deadlineMs = nowMs + m_config.taken_interval_ms;
+                send(FRAME_TAKEN, "", 0, &m_queue);
+            }
+            break;
+
+        case FLOOR_STATE_BUSY:
+        case FLOOR_STATE_QUEUED:
+            if (!m_grantTo.empty() && (int32_t)(nowMs - m_deadlineMs) >= 0) {
+                if (m_grantAttempts < m_config.request_attempts) {
+                    m_grantAttempts++;
+                    m_deadlineMs = nowMs + m_config.request_timeout_ms;
+                    send(FRAME_GRANT, m_grantTo, 0, &m_grantQueue);
+                } else {
+                    m_grantTo.clear();
+                    m_grantQueue.clear();
+                }
+            }
+            if (!m_talker.empty() && nowMs - m_talkerHeardMs > m_config.idle_timeout_ms) {
+                m_stats.holder_timeouts++;
+                floorFree(nowMs);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,254 @@
+/**
+ * @file floor_service.cpp
+ * @brief Push-to-talk floor control on FLOOR_PORT
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/floor_service.h"
+#include "include/config.h"
+#include "include/config_manager.h"
+#include "include/metrics_registry.h"
+#include "include/shared_data.h"
+#include "include/talkgroup.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+static const char* FLOOR_TAG = "FLOOR_SERVICE";
+
+#define FLOOR_MUTEX_TIMEOUT pdMS_TO_TICKS(20)
+
+// Work handed to the floor task
+typedef enum {
+    FLOOR_EVENT_FRAME = 0,                  // Floor frame for one of this node's groups
+    FLOOR_EVENT_PTT_DOWN,
+    FLOOR_EVENT_PTT_UP
+} floor_event_type_t;
+
+typedef struct {
+    floor_event_type_t type;
+    uint8_t* data;
+    uint16_t length;
+} floor_event_t;
+
+static FloorControl* s_floor = nullptr;     // Owned by the floor task
+static std::atomic<bool> s_running(false);
+static QueueHandle_t s_eventQueue = nullptr;
+static SemaphoreHandle_t s_statusMutex = nullptr;
+static floor_status_t s_status;             // Copies for other tasks, under s_statusMutex
+static floor_stats_t s_stats;
+static floor_stats_t s_published;           // Counters already added to the metrics registry
+static uint32_t s_pressMs = 0;              // PTT press not yet answered by the transmitter
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// ============================================================================
+// MESH AND AUDIO HOOKS
+// ============================================================================
+
+static void on_mesh_data(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    // Cheap check first: every voice frame passes through here too
+    if (data.size() <= TALKGROUP_HEADER_SIZE || data.size() > UINT16_MAX ||
+        !FloorControl::isFloorFrame(data.data() + TALKGROUP_HEADER_SIZE, data.size() - TALKGROUP_HEADER_SIZE)) {
+        return;
+    }
+    size_t length = 0;
+    const uint8_t* payload = talkgroup_accept(data.data(), data.size(), &length);
+    if (!payload) {
+        return;                             // Not one of this node's groups
+    }
+    floor_event_t event = {};
+    event.type = FLOOR_EVENT_FRAME;
+    event.data = (uint8_t*)malloc(length);
+    if (!event.data) {
+        return;
+    }
+    memcpy(event.data, payload, length);
+    event.length = (uint16_t)length;
+    if (xQueueSend(s_eventQueue, &event, 0) != pdTRUE) {
+        free(event.data);                   // Requests and TAKEN are repeated
+    }
+}
+
+static bool send_frame(const std::vector<uint8_t>& frame) {
+    std::vector<uint8_t> packet(TALKGROUP_HEADER_SIZE + frame.size());
+    memcpy(packet.data() + TALKGROUP_HEADER_SIZE, frame.data(), frame.size());
+    return talkgroup_send(TALKGROUP_KIND_FLOOR, packet.data(), packet.size(), FLOOR_PORT);
+}
+
+static void set_transmitter(bool talk) {
+    audio_command_t cmd = talk ? AUDIO_CMD_START_TX : AUDIO_CMD_STOP_TX;
+    if (send_audio_command(&cmd) != pdPASS) {
+        ESP_LOGE(FLOOR_TAG, "Audio command queue full, %s lost", talk ? "start" : "stop");
+    }
+    if (talk && s_pressMs) {
+        metrics_histogram_record(METRIC_FLOOR_PTT_LATENCY_MS, now_ms() - s_pressMs);
+        s_pressMs = 0;
+    }
+}
+
+static uint8_t configured_priority(void) {
+    int priority = FLOOR_PRIORITY_NORMAL;
+    config_manager_get_int("audio.ptt_priority", &priority);
+    if (priority < FLOOR_PRIORITY_NORMAL || priority > FLOOR_PRIORITY_EMERGENCY) {
+        priority = FLOOR_PRIORITY_NORMAL;
+    }
+    return (uint8_t)priority;
+}
+
+// ============================================================================
+// TASK
+// ============================================================================
+
+static bool create_floor(void) {
+    std::string nodeId = HaLowMeshManager::getInstance().getLocalPeerId();
+    if (nodeId.empty() || nodeId.size() >= FLOOR_NODE_ID_LEN) {
+        return false;                       // Radio not up yet
+    }
+    s_floor = new (std::nothrow) FloorControl(nodeId, configured_priority(), send_frame, set_transmitter,
+                                              floor_default_config(), esp_random());
+    if (!s_floor) {
+        ESP_LOGE(FLOOR_TAG, "Out of memory");
+        return false;
+    }
+    s_floor->setGroup(talkgroup_get_tx(), now_ms());
+    s_running.store(true);
+    ESP_LOGI(FLOOR_TAG, "Floor control up as %s", nodeId.c_str());
+    return true;
+}
+
+static void publish(void) {
+    const floor_stats_t& stats = s_floor->stats();
+    metrics_counter_add(METRIC_FLOOR_REQUESTS, stats.requests - s_published.requests);
+    metrics_counter_add(METRIC_FLOOR_TURNS, stats.turns - s_published.turns);
+    metrics_counter_add(METRIC_FLOOR_QUEUED, stats.queued - s_published.queued);
+    metrics_counter_add(METRIC_FLOOR_PREEMPTED, stats.preempted - s_published.preempted);
+    metrics_counter_add(METRIC_FLOOR_DOUBLE_HOLDS, stats.double_holds - s_published.double_holds);
+    s_published = stats;
+
+    if (xSemaphoreTake(s_statusMutex, FLOOR_MUTEX_TIMEOUT) != pdTRUE) {
+        return;                             // Next tick
+    }
+    s_status.state = s_floor->state();
+    s_status.group = s_floor->group();
+    s_status.queue_position = s_floor->queuePosition();
+    strncpy(s_status.talker, s_floor->talker().c_str(), sizeof(s_status.talker) - 1);
+    s_status.talker[sizeof(s_status.talker) - 1] = '\0';
+    s_stats = stats;
+    xSemaphoreGive(s_statusMutex);
+}
+
+static void handle_event(const floor_event_t& event, uint32_t nowMs) {
+    switch (event.type) {
+        case FLOOR_EVENT_FRAME:
+            s_floor->handleFrame(event.data, event.length, nowMs);
+            break;
+        case FLOOR_EVENT_PTT_DOWN:
+            s_pressMs = nowMs ? nowMs : 1;
+            s_floor->pttDown(nowMs);
+            break;
+        case FLOOR_EVENT_PTT_UP:
+            s_pressMs = 0;
+            s_floor->pttUp(nowMs);
+            break;
+    }
+}
+
+static void floor_task(void* pvParameters) {
+    for (;;) {
+        floor_event_t event;
+        bool received = xQueueReceive(s_eventQueue, &event, pdMS_TO_TICKS(FLOOR_SERVICE_TICK_MS)) == pdTRUE;
+        if (!s_floor && !create_floor()) {
+            if (received) {
+                free(event.data);
+            }
+            continue;
+        }
+
+        uint32_t nowMs = now_ms();
+        // Follow the TX group and priority set from the UI or the config
+        s_floor->setGroup(talkgroup_get_tx(), nowMs);
+        s_floor->setPriority(configured_priority());
+        if (received) {
+            handle_event(event, nowMs);
+            free(event.data);
+        }
+        s_floor->tick(nowMs);
+        publish();
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int floor_service_init(void) {
+    if (s_eventQueue) {
+        return 0;
+    }
+    s_statusMutex = xSemaphoreCreateMutex();
+    s_eventQueue = xQueueCreate(FLOOR_SERVICE_EVENT_QUEUE_DEPTH, sizeof(floor_event_t));
+    if (!s_statusMutex || !s_eventQueue) {
+        ESP_LOGE(FLOOR_TAG, "Out of memory");
+        return -1;
+    }
+
+    HaLowMeshManager::getInstance().addDataListener(DataCallback::fromFunction<on_mesh_data>());
+
+    if (xTaskCreatePinnedToCore(floor_task, "Floor", FLOOR_SERVICE_TASK_STACK_SIZE, NULL,
+                                FLOOR_SERVICE_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        ESP_LOGE(FLOOR_TAG, "Failed to create floor task");
+        return -1;
+    }
+
+    ESP_LOGI(FLOOR_TAG, "Floor service started on port %d", FLOOR_PORT);
+    return 0;
+}
+
+bool floor_service_ptt(bool pressed) {
+    if (!s_running.load()) {
+        return false;
+    }
+    floor_event_t event = {};
+    event.type = pressed ? FLOOR_EVENT_PTT_DOWN : FLOOR_EVENT_PTT_UP;
+    // A lost release would leave the transmitter keyed: wait for room
+    return xQueueSend(s_eventQueue, &event, portMAX_DELAY) == pdTRUE;
+}
+
+bool floor_service_get_status(floor_status_t* status) {
+    if (!s_running.load() || !status) {
+        return false;
+    }
+    if (xSemaphoreTake(s_statusMutex, FLOOR_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    *status = s_status;
+    xSemaphoreGive(s_statusMutex);
+    return true;
+}
+
+bool floor_service_get_stats(floor_stats_t* stats) {
+    if (!s_running.load() || !stats) {
+        return false;
+    }
+    if (xSemaphoreTake(s_statusMutex, FLOOR_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    *stats = s_stats;
+    xSemaphoreGive(s_statusMutex);
+    return true;
+}
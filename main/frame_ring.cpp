@@ -0,0 +1,100 @@
+/**
+ * @file frame_ring.cpp
+ * @brief Lock-free single-producer single-consumer ring of variable-size frames
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/frame_ring.h"
+#include <string.h>
+#include <new>
+
+#define FRAME_RING_LENGTH_SIZE 2
+
+FrameRing::FrameRing(size_t capacity)
+    : m_buffer(nullptr), m_mask(0), m_head(0), m_tail(0) {
+    size_t size = 16;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_buffer = new (std::nothrow) uint8_t[size];
+    m_mask = m_buffer ? size - 1 : 0;
+}
+
+FrameRing::~FrameRing() {
+    delete[] m_buffer;
+}
+
+void FrameRing::copyIn(size_t position, const void* data, size_t length) {
+    size_t start = position & m_mask;
+    size_t first = m_mask + 1 - start;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(m_buffer + start, data, first);
+    memcpy(m_buffer, (const uint8_t*)data + first, length - first);
+}
+
+void FrameRing::copyOut(size_t position, void* data, size_t length) const {
+    size_t start = position & m_mask;
+    size_t first = m_mask + 1 - start;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(data, m_buffer + start, first);
+    memcpy((uint8_t*)data + first, m_buffer, length - first);
+}
+
+bool FrameRing::push(const void* head, size_t headLength, const void* body, size_t bodyLength) {
+    size_t length = headLength + bodyLength;
+    if (!m_buffer || length > FRAME_RING_MAX_FRAME) {
+        return false;
+    }
+    size_t headIndex = m_head.load(std::memory_order_relaxed);
+    size_t tailIndex = m_tail.load(std::memory_order_acquire);
+    if (FRAME_RING_LENGTH_SIZE + length > capacity() - (headIndex - tailIndex)) {
+        return false;
+    }
+    uint8_t prefix[FRAME_RING_LENGTH_SIZE] = {(uint8_t)length, (uint8_t)(length >> 8)};
+    copyIn(headIndex, prefix, sizeof(prefix));
+    if (headLength) {
+        copyIn(headIndex + FRAME_RING_LENGTH_SIZE, head, headLength);
+    }
+    if (bodyLength) {
+        copyIn(headIndex + FRAME_RING_LENGTH_SIZE + headLength, body, bodyLength);
+    }
+    m_head.store(headIndex + FRAME_RING_LENGTH_SIZE + length, std::memory_order_release);
+    return true;
+}
+
+size_t FrameRing::peek() const {
+    size_t tailIndex = m_tail.load(std::memory_order_relaxed);
+    if (!m_buffer || m_head.load(std::memory_order_acquire) == tailIndex) {
+        return 0;
+    }
+    uint8_t prefix[FRAME_RING_LENGTH_SIZE];
+    copyOut(tailIndex, prefix, sizeof(prefix));
+    return prefix[0] | ((size_t)prefix[1] << 8);
+}
+
+size_t FrameRing::pop(void* out, size_t capacity) {
+    size_t tailIndex = m_tail.load(std::memory_order_relaxed);
+    if (!m_buffer || m_head.load(std::memory_order_acquire) == tailIndex) {
+        return 0;
+    }
+    uint8_t prefix[FRAME_RING_LENGTH_SIZE];
+    copyOut(tailIndex, prefix, sizeof(prefix));
+    size_t length = prefix[0] | ((size_t)prefix[1] << 8);
+    bool fits = length <= capacity;
+    if (fits) {
+        copyOut(tailIndex + FRAME_RING_LENGTH_SIZE, out, length);
+    }
+    m_tail.store(tailIndex + FRAME_RING_LENGTH_SIZE + length, std::memory_order_release);
+    return fits ? length : 0;
+}
+
+size_t FrameRing::used() const {
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+}
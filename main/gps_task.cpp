@@ -1,6 +1,8 @@
 #include "include/gps_task.h"
 #include "include/config.h"
+#include "include/board_profile.h"
 #include "include/shared_data.h"
+#include "include/power_service.h"
 #include "driver/uart.h"
 #include "esp_log.h"
 
@@ -28,7 +30,7 @@ void init_uart() {
     // We won't use a buffer for sending data.
     uart_driver_install(GPS_UART_NUM, RX_BUF_SIZE * 2, 0, 0, NULL, 0);
     uart_param_config(GPS_UART_NUM, &uart_config);
-    uart_set_pin(GPS_UART_NUM, PIN_GPS_TX, PIN_GPS_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    uart_set_pin(GPS_UART_NUM, Board::pin_gps_tx, Board::pin_gps_rx, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 }
 
 GPSData gps_get_data() {
@@ -48,7 +50,10 @@ void gpsTask(void *pvParameters) {
     bool last_valid_state = false;
 
     for (;;) {
-        const int rxBytes = uart_read_bytes(GPS_UART_NUM, data, RX_BUF_SIZE, 100 / portTICK_PERIOD_MS);
+        // Sentences wait in the driver's buffer, so reading them once a
+        // second when the map is not shown costs no fixes, only wakes
+        uint32_t timeout_ms = power_service_poll_ms(POWER_WAKE_GPS, 100);
+        const int rxBytes = uart_read_bytes(GPS_UART_NUM, data, RX_BUF_SIZE, timeout_ms / portTICK_PERIOD_MS);
         if (rxBytes > 0) {
             for (int i = 0; i < rxBytes; i++) {
                 if (gps.encode(data[i])) {
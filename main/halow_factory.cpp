@@ -0,0 +1,350 @@
+/**
+ * @file halow_factory.cpp
+ * @brief Factory for Wi-Fi HaLow implementations
+ *
+ * @author AirCom Development Team
+ * @version 2.0.0
+ * @date 2024
+ */
+
+#include "include/halow_factory.h"
+#include "esp_log.h"
+#include <algorithm>
+
+#ifdef ESP_PLATFORM
+#include "include/config_manager.h"
+#include "mm_iot_sdk_halow.h"
+#include "esp_idf_halow.h"
+#else
+#include "sim_halow.h"
+#endif
+
+static const char* TAG = "HALOW_FACTORY";
+
+// Registry names, as returned by IHaLow::getImplementationName()
+static const char* const IMPL_MM_IOT_SDK = "MM-IoT-SDK";
+static const char* const IMPL_HELTEC = "Heltec-HaLow";
+static const char* const IMPL_ESP_IDF = "ESP-IDF";
+static const char* const IMPL_SIM = "Sim-HaLow";
+
+// Hardware type strings
+static const char* const HW_XIAO_ESP32S3 = "XIAO_ESP32S3";
+static const char* const HW_XIAO_ESP32C3 = "XIAO_ESP32C3";
+static const char* const HW_XIAO_ESP32C6 = "XIAO_ESP32C6";
+static const char* const HW_HELTEC_HT_HC32 = "HELTEC_HT_HC32";
+static const char* const HW_HELTEC_HT_IT01 = "HELTEC_HT_IT01";
+static const char* const HW_HELTEC_GENERIC = "HELTEC_GENERIC";
+static const char* const HW_ESP32_GENERIC = "ESP32_GENERIC";
+static const char* const HW_LINUX_SIM = "LINUX_SIM";
+
+HaLowFactory& HaLowFactory::getInstance() {
+    static HaLowFactory instance;
+    return instance;
+}
+
+HaLowFactory::HaLowFactory() {
+    initializeBuiltInImplementations();
+}
+
+HaLowFactory::~HaLowFactory() {
+}
+
+void HaLowFactory::initializeBuiltInImplementations() {
+    registerImplementation({
+        IMPL_MM_IOT_SDK,
+        "MorseMicro MM-IoT-SDK on the FGH100M-H module",
+        {HW_XIAO_ESP32S3, HW_XIAO_ESP32C3, HW_XIAO_ESP32C6},
+        100,
+        true,
+        "https://github.com/MorseMicro/mm-iot-sdk"
+    });
+
+    registerImplementation({
+        IMPL_HELTEC,
+        "Heltec Automation HaLow SDK",
+        {HW_HELTEC_HT_HC32, HW_HELTEC_HT_IT01, HW_HELTEC_GENERIC},
+        90,
+        true,
+        "https://heltec.org"
+    });
+
+    registerImplementation({
+        IMPL_SIM,
+        "Simulated HaLow channel over loopback multicast (host builds)",
+        {HW_LINUX_SIM},
+        50,
+        false,
+        ""
+    });
+
+    // Standard 2.4 GHz Wi-Fi: lowest priority, used as the failover backend
+    registerImplementation({
+        IMPL_ESP_IDF,
+        "ESP-IDF standard Wi-Fi station with multicast peer discovery",
+        {HW_XIAO_ESP32S3, HW_XIAO_ESP32C3, HW_XIAO_ESP32C6,
+         HW_HELTEC_HT_HC32, HW_HELTEC_HT_IT01, HW_HELTEC_GENERIC, HW_ESP32_GENERIC},
+        10,
+        false,
+        ""
+    });
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createHaLow(const std::string& hardware_type,
+                                                  const std::string& preferred_sdk) {
+    std::string hardware = hardware_type.empty() ? autoDetectHardware() : hardware_type;
+
+    if (!preferred_sdk.empty()) {
+        if (testCompatibility(preferred_sdk, hardware) > 0) {
+            std::unique_ptr<IHaLow> halow = createByName(preferred_sdk);
+            if (halow) {
+                return halow;
+            }
+        }
+        ESP_LOGW(TAG, "Preferred implementation %s not usable on %s, choosing automatically",
+                 preferred_sdk.c_str(), hardware.c_str());
+    }
+
+    for (const std::string& name : getFailoverOrder(hardware)) {
+        std::unique_ptr<IHaLow> halow = createByName(name);
+        if (halow) {
+            return halow;
+        }
+    }
+
+    ESP_LOGE(TAG, "No HaLow implementation available for %s", hardware.c_str());
+    return nullptr;
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createOptimalHaLow() {
+    std::string hardware = autoDetectHardware();
+    ESP_LOGI(TAG, "Creating optimal HaLow implementation for %s", hardware.c_str());
+
+    if (hardware == HW_XIAO_ESP32S3) {
+        return createForXiaoESP32S3();
+    } else if (hardware == HW_XIAO_ESP32C3) {
+        return createForXiaoESP32C3();
+    } else if (hardware == HW_XIAO_ESP32C6) {
+        return createForXiaoESP32C6();
+    } else if (hardware == HW_HELTEC_HT_HC32) {
+        return createForHeltecHTHC32();
+    } else if (hardware == HW_HELTEC_HT_IT01) {
+        return createForHeltecHTIT01();
+    } else if (hardware == HW_HELTEC_GENERIC) {
+        return createForGenericHeltec();
+    } else if (hardware == HW_ESP32_GENERIC) {
+        return createForGenericESP32();
+    }
+    return createHaLow(hardware);
+}
+
+std::vector<std::string> HaLowFactory::getFailoverOrder(const std::string& hardware_type) {
+    std::string hardware = hardware_type.empty() ? autoDetectHardware() : hardware_type;
+
+    std::vector<const ImplementationEntry*> entries;
+    for (const auto& entry : m_implementations) {
+        const std::vector<std::string>& supported = entry.second.supported_hardware;
+        if (std::find(supported.begin(), supported.end(), hardware) != supported.end()) {
+            entries.push_back(&entry.second);
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const ImplementationEntry* a, const ImplementationEntry* b) {
+                         return a->priority > b->priority;
+                     });
+
+    std::vector<std::string> names;
+    for (const ImplementationEntry* entry : entries) {
+        names.push_back(entry->name);
+    }
+    return names;
+}
+
+std::vector<std::string> HaLowFactory::getAvailableImplementations() {
+    std::vector<std::string> names;
+    for (const auto& entry : m_implementations) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+std::vector<std::string> HaLowFactory::getSupportedImplementations(const std::string& hardware_type) {
+    return getFailoverOrder(hardware_type);
+}
+
+bool HaLowFactory::isHardwareSupported(const std::string& hardware_type) {
+    return !getFailoverOrder(hardware_type).empty();
+}
+
+const ImplementationEntry* HaLowFactory::getImplementationDetails(const std::string& implementation_name) {
+    auto it = m_implementations.find(implementation_name);
+    return it != m_implementations.end() ? &it->second : nullptr;
+}
+
+bool HaLowFactory::registerImplementation(const ImplementationEntry& entry) {
+    if (entry.name.empty()) {
+        ESP_LOGE(TAG, "Cannot register implementation without a name");
+        return false;
+    }
+    m_implementations[entry.name] = entry;
+    return true;
+}
+
+bool HaLowFactory::unregisterImplementation(const std::string& implementation_name) {
+    return m_implementations.erase(implementation_name) > 0;
+}
+
+std::string HaLowFactory::autoDetectHardware() {
+    if (!m_detectedHardware.empty()) {
+        return m_detectedHardware;
+    }
+
+#ifdef ESP_PLATFORM
+    switch (Board::platform) {
+        case HW_PLATFORM_XIAO_ESP32S3:   m_detectedHardware = HW_XIAO_ESP32S3; break;
+        case HW_PLATFORM_XIAO_ESP32C3:   m_detectedHardware = HW_XIAO_ESP32C3; break;
+        case HW_PLATFORM_XIAO_ESP32C6:   m_detectedHardware = HW_XIAO_ESP32C6; break;
+        case HW_PLATFORM_HELTEC_HT_HC32: m_detectedHardware = HW_HELTEC_HT_HC32; break;
+        case HW_PLATFORM_HELTEC_HT_IT01: m_detectedHardware = HW_HELTEC_HT_IT01; break;
+        case HW_PLATFORM_HELTEC_GENERIC: m_detectedHardware = HW_HELTEC_GENERIC; break;
+        default:                         m_detectedHardware = HW_ESP32_GENERIC; break;
+    }
+#else
+    m_detectedHardware = HW_LINUX_SIM;
+#endif
+
+    return m_detectedHardware;
+}
+
+std::string HaLowFactory::getRecommendedImplementation(const std::string& hardware_type) {
+    std::vector<std::string> order = getFailoverOrder(hardware_type);
+    return order.empty() ? std::string() : order.front();
+}
+
+int HaLowFactory::testCompatibility(const std::string& implementation, const std::string& hardware_type) {
+    const ImplementationEntry* entry = getImplementationDetails(implementation);
+    if (!entry) {
+        return 0;
+    }
+    const std::vector<std::string>& supported = entry->supported_hardware;
+    if (std::find(supported.begin(), supported.end(), hardware_type) == supported.end()) {
+        return 0;
+    }
+    if (implementation == getRecommendedImplementation(hardware_type)) {
+        return 100;
+    }
+    return std::max(1, std::min(99, (int)entry->priority));
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createByName(const std::string& implementation_name) {
+    if (implementation_name == IMPL_MM_IOT_SDK) {
+        return createMMIoTSDKHaLow();
+    } else if (implementation_name == IMPL_HELTEC) {
+        return createHeltecHaLow();
+    } else if (implementation_name == IMPL_ESP_IDF) {
+        return createEspIdfHaLow();
+    } else if (implementation_name == IMPL_SIM) {
+        return createSimHaLow();
+    }
+    ESP_LOGE(TAG, "Unknown HaLow implementation %s", implementation_name.c_str());
+    return nullptr;
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createMMIoTSDKHaLow() {
+#ifdef ESP_PLATFORM
+    // Boards without the FGH100M-H leave the SDK and its SPI transport out
+    if constexpr (Board::halow_module == BOARD_HALOW_FGH100M) {
+        return std::unique_ptr<IHaLow>(new MMIoTSDKHaLow());
+    } else {
+        ESP_LOGW(TAG, "%s is not compiled into this build", IMPL_MM_IOT_SDK);
+        return nullptr;
+    }
+#else
+    ESP_LOGW(TAG, "%s is only available on ESP32 targets", IMPL_MM_IOT_SDK);
+    return nullptr;
+#endif
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createHeltecHaLow() {
+    // The Heltec SDK is not part of this tree yet
+    ESP_LOGW(TAG, "%s is not compiled into this build", IMPL_HELTEC);
+    return nullptr;
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createEspIdfHaLow() {
+#ifdef ESP_PLATFORM
+    return std::unique_ptr<IHaLow>(new EspIdfHaLow());
+#else
+    ESP_LOGW(TAG, "%s is only available on ESP32 targets", IMPL_ESP_IDF);
+    return nullptr;
+#endif
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createSimHaLow() {
+#ifdef ESP_PLATFORM
+    ESP_LOGW(TAG, "%s is only available in host builds", IMPL_SIM);
+    return nullptr;
+#else
+    return std::unique_ptr<IHaLow>(new SimHaLow());
+#endif
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createGenericHaLow() {
+    return createHaLow(autoDetectHardware());
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createForXiaoESP32S3() {
+    return createHaLow(HW_XIAO_ESP32S3);
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createForXiaoESP32C3() {
+    return createHaLow(HW_XIAO_ESP32C3);
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createForXiaoESP32C6() {
+    return createHaLow(HW_XIAO_ESP32C6);
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createForHeltecHTHC32() {
+    return createHaLow(HW_HELTEC_HT_HC32);
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createForHeltecHTIT01() {
+    return createHaLow(HW_HELTEC_HT_IT01);
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createForGenericHeltec() {
+    return createHaLow(HW_HELTEC_GENERIC);
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createForGenericESP32() {
+    return createHaLow(HW_ESP32_GENERIC);
+}
+
+std::unique_ptr<IHaLow> HaLowFactory::createFromConfig(const std::string& config_name) {
+    return createHaLow("", config_name);
+}
+
+std::vector<HardwareCompatibility> getHardwareCompatibilityMatrix() {
+    HaLowFactory& factory = HaLowFactory::getInstance();
+    const char* const hardware[] = {
+        HW_XIAO_ESP32S3, HW_XIAO_ESP32C3, HW_XIAO_ESP32C6,
+        HW_HELTEC_HT_HC32, HW_HELTEC_HT_IT01, HW_HELTEC_GENERIC,
+        HW_ESP32_GENERIC, HW_LINUX_SIM
+    };
+
+    std::vector<HardwareCompatibility> matrix;
+    for (const char* type : hardware) {
+        HardwareCompatibility entry;
+        entry.hardware_type = type;
+        entry.compatible_implementations = factory.getSupportedImplementations(type);
+        std::string recommended = factory.getRecommendedImplementation(type);
+        if (!recommended.empty()) {
+            entry.recommended_implementations.push_back(recommended);
+        }
+        entry.notes = entry.compatible_implementations.size() > 1
+            ? "Fails over to " + entry.compatible_implementations.back()
+            : "No failover backend";
+        matrix.push_back(entry);
+    }
+    return matrix;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file history_service.cpp
+ * @brief Text message history in the SPIFFS storage partition
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/history_service.h"
+#include "include/metrics_registry.h"
+#include "include/ota_updater.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_spiffs.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+
+static const char* HISTORY_TAG = "HISTORY_SERVICE";
+
+#define HISTORY_MUTEX_TIMEOUT pdMS_TO_TICKS(200)
+
+// ============================================================================
+// LOG STORAGE: one file per segment and the index beside them on SPIFFS
+// ============================================================================
+
+class SpiffsHistoryStorage : public IHistoryStorage {
+public:
+    bool list(std::vector<uint16_t>* segments) override {
+        segments->clear();
+        DIR* dir = opendir(OTA_SPIFFS_BASE_PATH);
+        if (!dir) {
+            return false;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            unsigned id;
+            char extension[4];
+            if (sscanf(entry->d_name, HISTORY_SEGMENT_PREFIX "%4x.%3s", &id, extension) == 2 &&
+                strcmp(extension, "log") == 0) {
+                segments->push_back((uint16_t)id);
+            }
+        }
+        closedir(dir);
+        return true;
+    }
+
+    bool size(uint16_t segment, uint32_t* bytes) override {
+        FILE* file = fopen(path(segment), "rb");
+        if (!file) {
+            return false;
+        }
+        long end = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+        fclose(file);
+        *bytes = end > 0 ? (uint32_t)end : 0;
+        return end >= 0;
+    }
+
+    size_t read(uint16_t segment, uint32_t offset, uint8_t* out, size_t length) override {
+        FILE* file = fopen(path(segment), "rb");
+        if (!file) {
+            return 0;
+        }
+        size_t got = fseek(file, (long)offset, SEEK_SET) == 0 ? fread(out, 1, length, file) : 0;
+        fclose(file);
+        return got;
+    }
+
+    bool append(uint16_t segment, const uint8_t* data, size_t length) override {
+        FILE* file = fopen(path(segment), "ab");
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(data, 1, length, file) == length;
+        return fclose(file) == 0 && ok;
+    }
+
+    bool remove(uint16_t segment) override {
+        return ::remove(path(segment)) == 0;
+    }
+
+    bool loadIndex(std::vector<uint8_t>* index) override {
+        index->clear();
+        FILE* file = fopen(HISTORY_INDEX_PATH, "rb");
+        if (!file) {
+            // A save cut short after the old index was removed leaves a
+            // complete temporary file
+            if (rename(HISTORY_INDEX_TEMP_PATH, HISTORY_INDEX_PATH) != 0) {
+                return true;
+            }
+            file = fopen(HISTORY_INDEX_PATH, "rb");
+            if (!file) {
+                return false;
+            }
+        } else {
+            ::remove(HISTORY_INDEX_TEMP_PATH);  // Cut short before the switch
+        }
+        uint8_t buffer[256];
+        size_t length;
+        while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            index->insert(index->end(), buffer, buffer + length);
+        }
+        bool ok = !ferror(file);
+        fclose(file);
+        return ok;
+    }
+
+    // SPIFFS cannot rename over an existing file: write the new index
+    // aside, then remove the old one and move the new one in
+    bool saveIndex(const std::vector<uint8_t>& index) override {
+        FILE* file = fopen(HISTORY_INDEX_TEMP_PATH, "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(index.data(), 1, index.size(), file) == index.size();
+        if (fclose(file) != 0 || !ok) {
+            ::remove(HISTORY_INDEX_TEMP_PATH);
+            return false;
+        }
+        ::remove(HISTORY_INDEX_PATH);
+        return rename(HISTORY_INDEX_TEMP_PATH, HISTORY_INDEX_PATH) == 0;
+    }
+
+private:
+    const char* path(uint16_t segment) {
+        snprintf(m_path, sizeof(m_path), HISTORY_SEGMENT_PATH_FORMAT, segment);
+        return m_path;
+    }
+
+    char m_path[32];
+};
+
+static SpiffsHistoryStorage s_storage;
+static MessageHistory* s_history = nullptr;
+static SemaphoreHandle_t s_mutex = nullptr;
+static history_stats_t s_published;         // Counters already added to the metrics registry
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static bool mount_storage(void) {
+    if (esp_spiffs_mounted(OTA_SPIFFS_PARTITION)) {
+        return true;
+    }
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = OTA_SPIFFS_BASE_PATH,
+        .partition_label = OTA_SPIFFS_PARTITION,
+        .max_files = 4,
+        .format_if_mount_failed = true
+    };
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(HISTORY_TAG, "Cannot mount %s: %s", OTA_SPIFFS_PARTITION, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// The device key, made on first use
+static bool load_key(uint8_t* key) {
+#if !CONFIG_NVS_ENCRYPTION
+    ESP_LOGW(HISTORY_TAG, "NVS encryption is off: the history key is stored in the clear");
+#endif
+    nvs_handle_t handle;
+    if (nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGE(HISTORY_TAG, "Could not open NVS for the history key");
+        return false;
+    }
+    size_t length = HISTORY_KEY_SIZE;
+    esp_err_t err = nvs_get_blob(handle, "key", key, &length);
+    if (err == ESP_OK && length == HISTORY_KEY_SIZE) {
+        nvs_close(handle);
+        return true;
+    }
+    ESP_LOGI(HISTORY_TAG, "Creating the history key");
+    esp_fill_random(key, HISTORY_KEY_SIZE);
+    err = nvs_set_blob(handle, "key", key, HISTORY_KEY_SIZE);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(HISTORY_TAG, "Could not save the history key: %s", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+static bool open_history(void) {
+    if (!mount_storage()) {
+        return false;
+    }
+    uint8_t key[HISTORY_KEY_SIZE];
+    if (!load_key(key)) {
+        return false;
+    }
+    uint64_t seed = ((uint64_t)esp_random() << 32) | esp_random();
+    MessageHistory* history = new (std::nothrow) MessageHistory(&s_storage, key, seed, history_default_config());
+    memset(key, 0, sizeof(key));
+    if (!history) {
+        ESP_LOGE(HISTORY_TAG, "Out of memory");
+        return false;
+    }
+    uint32_t startMs = now_ms();
+    if (!history->load(startMs)) {
+        delete history;
+        return false;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_history = history;
+    s_published = history->stats();
+    xSemaphoreGive(s_mutex);
+    ESP_LOGI(HISTORY_TAG, "History ready in %u ms: %u messages, %u KB log", (unsigned)(now_ms() - startMs),
+             (unsigned)history->messages(), (unsigned)(history->logBytes() / 1024));
+    return true;
+}
+
+// ============================================================================
+// TASK
+// ============================================================================
+
+static void publish_metrics(void) {
+    const history_stats_t& stats = s_history->stats();
+    metrics_counter_add(METRIC_HISTORY_APPENDED, stats.appended - s_published.appended);
+    metrics_counter_add(METRIC_HISTORY_FLASH_BYTES,
+                        (stats.log_bytes_written - s_published.log_bytes_written) +
+                        (stats.checkpoint_bytes_written - s_published.checkpoint_bytes_written));
+    metrics_counter_add(METRIC_HISTORY_DROPPED, stats.messages_dropped - s_published.messages_dropped);
+    metrics_counter_add(METRIC_HISTORY_DAMAGED, stats.damaged - s_published.damaged);
+    metrics_gauge_set(METRIC_HISTORY_MESSAGES, (int32_t)s_history->messages());
+    s_published = stats;
+}
+
+static void history_task(void* pvParameters) {
+    if (!open_history()) {
+        ESP_LOGE(HISTORY_TAG, "History disabled");
+        vTaskDelete(NULL);
+        return;
+    }
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(HISTORY_SERVICE_TICK_MS));
+        if (xSemaphoreTake(s_mutex, HISTORY_MUTEX_TIMEOUT) != pdTRUE) {
+            continue;
+        }
+        s_history->tick(now_ms());
+        publish_metrics();
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int history_service_init(void) {
+    if (s_mutex) {
+        return 0;
+    }
+    s_mutex = xSemaphoreCreateMutex();
+    if (!s_mutex) {
+        ESP_LOGE(HISTORY_TAG, "Out of memory");
+        return -1;
+    }
+    if (xTaskCreatePinnedToCore(history_task, "History", HISTORY_SERVICE_TASK_STACK_SIZE, NULL,
+                                HISTORY_SERVICE_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        ESP_LOGE(HISTORY_TAG, "Failed to create history task");
+        return -1;
+    }
+    return 0;
+}
+
+bool history_service_append(const char* conversation, uint8_t direction, const char* text) {
+    if (!s_mutex || !conversation || !text || xSemaphoreTake(s_mutex, HISTORY_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool ok = s_history && s_history->append(conversation, direction, (uint32_t)time(NULL), text, now_ms());
+    xSemaphoreGive(s_mutex);
+    return ok;
+}
+
+size_t history_service_conversations(history_conversation_t* out, size_t max) {
+    if (!s_mutex || !out || xSemaphoreTake(s_mutex, HISTORY_MUTEX_TIMEOUT) != pdTRUE) {
+        return 0;
+    }
+    size_t count = s_history ? s_history->conversations(out, max) : 0;
+    xSemaphoreGive(s_mutex);
+    return count;
+}
+
+size_t history_service_page(const char* conversation, size_t skip, history_message_t* out, size_t max) {
+    if (!s_mutex || !conversation || !out || xSemaphoreTake(s_mutex, HISTORY_MUTEX_TIMEOUT) != pdTRUE) {
+        return 0;
+    }
+    size_t count = s_history ? s_history->page(conversation, skip, out, max) : 0;
+    xSemaphoreGive(s_mutex);
+    return count;
+}
+
+size_t history_service_count(const char* conversation) {
+    if (!s_mutex || !conversation || xSemaphoreTake(s_mutex, HISTORY_MUTEX_TIMEOUT) != pdTRUE) {
+        return 0;
+    }
+    size_t count = s_history ? s_history->count(conversation) : 0;
+    xSemaphoreGive(s_mutex);
+    return count;
+}
+
+void history_service_mark_read(const char* conversation) {
+    if (!s_mutex || !conversation || xSemaphoreTake(s_mutex, HISTORY_MUTEX_TIMEOUT) != pdTRUE) {
+        return;
+    }
+    if (s_history) {
+        s_history->markRead(conversation, now_ms());
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+bool history_service_get_stats(history_stats_t* stats, uint32_t* messages) {
+    if (!s_mutex || !stats || xSemaphoreTake(s_mutex, HISTORY_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool loaded = s_history != nullptr;
+    if (loaded) {
+        *stats = s_history->stats();
+        if (messages) {
+            *messages = (uint32_t)s_history->messages();
+        }
+    }
+    xSemaphoreGive(s_mutex);
+    return loaded;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file audio_pipeline.h
+ * @brief Audio stages joined by lock-free rings, run by lanes placed on cores
+ *
+ * The voice path is a set of stages: capture, DSP, encode and send on
+ * the way out; receive, jitter buffer, decode, sidetone, mix and playout
+ * on the way in. A stage reads frames from the stage it is fed by and hands
+ * frames on through a FrameRing, so a stage and its consumer need no
+ * lock even when they run on different cores. A stage may feed several
+ * others; each gets its own ring and a copy of every frame.
+ *
+ * Lanes run the stages: each lane is one task with its own core and
+ * priority, and runs its stages in id order once per tick. Which stage
+ * runs in which lane comes from a profile (audio_profile_t), so the same
+ * stages run as one task on a single-core chip and as a TX lane and an
+ * RX lane on a dual-core one.
+ *
+ * Every frame carries the time it entered the pipeline. Each stage
+ * keeps its run time and the latency of the frames it hands on, and each
+ * lane its busy time, which is that lane's load on its core.
+ *
+ * The class does no I/O and reads the time from the clock it is given,
+ * so the host simulation can run the firmware's pipeline in virtual time.
+ * Stages are added and the profile applied before any lane runs.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef AUDIO_PIPELINE_H
+#define AUDIO_PIPELINE_H
+
+#include "frame_ring.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUDIO_PIPELINE_MAX_STAGES 12
+#define AUDIO_PIPELINE_MAX_LANES 4
+#define AUDIO_PIPELINE_MAX_OUTPUTS 2        // Consumers of one stage
+#define AUDIO_PIPELINE_MAX_FRAME 1536       // Payload bytes
+
+#define AUDIO_STAGE_BIT(id) (1u << (id))
+
+class AudioPipeline;
+
+// Runs once per lane tick; returns the frames it handled, 0 if idle
+typedef int (*audio_stage_fn_t)(AudioPipeline& pipeline, int stage, void* ctx);
+
+/**
+ * @brief What travels with a frame through the rings
+ */
+typedef struct {
+    int64_t origin_us;                      ///< Captured or received
+    uint16_t length;                        ///< Payload bytes
+    uint8_t group;                          ///< Talkgroup
+    uint8_t flags;                          ///< Set by the stages
+} audio_frame_t;
+
+/**
+ * @brief One stage and its statistics since the last reset
+ */
+typedef struct {
+    const char* name;                       ///< nullptr: no stage with this id
+    audio_stage_fn_t fn;
+    void* ctx;
+    int input;                              ///< Stage that feeds this one; -1 for a source
+    int lane;
+    FrameRing* ring;                        ///< From input; nullptr for a source
+    std::atomic<uint32_t> queued;           ///< Frames in ring, written by the input stage
+    std::atomic<uint32_t> taken;            ///< ... and by this one
+    int outputs[AUDIO_PIPELINE_MAX_OUTPUTS];
+    int outputCount;
+
+    uint32_t runs;
+    uint32_t frames;                        ///< Handed on, or finished by a sink
+    uint32_t dropped;                       ///< A consumer's ring was full
+    uint32_t busyUs;
+    uint32_t maxRunUs;
+    uint64_t latencyUs;                     ///< Sum over frames, origin to hand-on
+    uint32_t maxLatencyUs;
+} audio_stage_t;
+
+/**
+ * @brief A lane: one task, the stages it runs, and its load
+ */
+typedef struct {
+    const char* name;
+    int core;
+    int priority;
+    uint32_t stages;                        ///< AUDIO_STAGE_BIT() of each stage it runs
+} audio_lane_config_t;
+
+typedef struct {
+    const char* name;
+    int lanes;
+    audio_lane_config_t lane[AUDIO_PIPELINE_MAX_LANES];
+} audio_profile_t;
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t busyUs;
+    uint32_t maxTickUs;
+    int64_t sinceUs;                        ///< Start of the statistics window
+} audio_lane_stats_t;
+
+class AudioPipeline {
+public:
+    typedef int64_t (*clock_fn_t)(void);
+
+    explicit AudioPipeline(clock_fn_t clock);
+    ~AudioPipeline();
+
+    AudioPipeline(const AudioPipeline&) = delete;
+    AudioPipeline& operator=(const AudioPipeline&) = delete;
+
+    /**
+     * @brief Add a stage
+     * @param input Stage whose frames it takes, -1 for a source; added first
+     * @param ringBytes Ring from the input; FrameRing rounds it up to a power of two
+     * @return false if the id is taken or out of range, the input is
+     *         missing or has all its consumers, or out of memory
+     */
+    bool add(int id, const char* name, audio_stage_fn_t fn, void* ctx, int input, size_t ringBytes);
+
+    /**
+     * @brief Place every stage in a lane
+     * @return false if a stage is in no lane or in two, a lane has no
+     *         stages, or two lanes share a core
+     */
+    bool configure(const audio_profile_t& profile);
+
+    const audio_profile_t& profile() const { return m_profile; }
+
+    /**
+     * @brief Run the lane's stages once, in id order
+     * @return Frames handled
+     */
+    int runLane(int lane);
+
+    // ---- For stage functions -------------------------------------------
+
+    /**
+     * @brief Take the oldest frame from the stage's input
+     * @return Payload length, 0 if none; data gets at most capacity bytes
+     */
+    size_t pop(int stage, audio_frame_t* frame, uint8_t* data, size_t capacity);
+
+    // Frames waiting at the stage's input
+    uint32_t depth(int stage) const;
+
+    /**
+     * @brief Hand a frame to every stage fed by this one
+     * @return false if a ring was full; that consumer misses the frame
+     */
+    bool push(int stage, const audio_frame_t& frame, const void* data);
+
+    // A sink finished a frame: counts it and its latency
+    void done(int stage, const audio_frame_t& frame);
+
+    int64_t now() const { return m_clock(); }
+
+    // ---- Statistics ----------------------------------------------------
+
+    const audio_stage_t& stage(int id) const { return m_stages[id]; }
+    const audio_lane_stats_t& laneStats(int lane) const { return m_lanes[lane]; }
+
+    // Busy share of the lane's window, in percent
+    uint32_t laneLoad(int lane) const;
+
+    // Start a new window for the lane and its stages; call from the lane
+    void resetStats(int lane);
+
+private:
+    void account(audio_stage_t& stage, const audio_frame_t& frame);
+
+    clock_fn_t m_clock;
+    audio_stage_t m_stages[AUDIO_PIPELINE_MAX_STAGES];
+    audio_profile_t m_profile;
+    audio_lane_stats_t m_lanes[AUDIO_PIPELINE_MAX_LANES];
+};
+
+// ============================================================================
+// THE FIRMWARE'S VOICE PATH
+// ============================================================================
+
+/**
+ * Stage ids, in run order within a lane: the TX chain, then the RX chain.
+ * Voice travels as 16-bit PCM, so encode only frames it behind the
+ * talkgroup header and decode only checks the length.
+ *
+ * Capture also feeds sidetone, in the RX lane, straight from the mic:
+ * while the PTT is held the speaker plays the operator's own voice,
+ * quietly, with received voice ducked under it.
+ */
+typedef enum {
+    AUDIO_STAGE_CAPTURE = 0,                ///< I2S or headset mic; PTT commands
+    AUDIO_STAGE_DSP,                        ///< Mic DC and rumble high-pass
+    AUDIO_STAGE_ENCODE,
+    AUDIO_STAGE_SEND,                       ///< Talkgroup send, recorder
+    AUDIO_STAGE_RECEIVE,                    ///< Voice socket, talkgroup filter, recorder
+    AUDIO_STAGE_JITTER,
+    AUDIO_STAGE_DECODE,
+    AUDIO_STAGE_SIDETONE,                   ///< Newest mic frame, scaled down for the mix
+    AUDIO_STAGE_MIX,                        ///< Live voice and sidetone, replay in the pauses, 'over' tone
+    AUDIO_STAGE_PLAYOUT,                    ///< I2S or headset
+    AUDIO_STAGE_COUNT
+} audio_stage_id_t;
+
+#define AUDIO_TX_STAGES \
+    (AUDIO_STAGE_BIT(AUDIO_STAGE_CAPTURE) | AUDIO_STAGE_BIT(AUDIO_STAGE_DSP) | \
+     AUDIO_STAGE_BIT(AUDIO_STAGE_ENCODE) | AUDIO_STAGE_BIT(AUDIO_STAGE_SEND))
+#define AUDIO_RX_STAGES \
+    (AUDIO_STAGE_BIT(AUDIO_STAGE_RECEIVE) | AUDIO_STAGE_BIT(AUDIO_STAGE_JITTER) | \
+     AUDIO_STAGE_BIT(AUDIO_STAGE_DECODE) | AUDIO_STAGE_BIT(AUDIO_STAGE_SIDETONE) | \
+     AUDIO_STAGE_BIT(AUDIO_STAGE_MIX) | AUDIO_STAGE_BIT(AUDIO_STAGE_PLAYOUT))
+
+#define AUDIO_FRAME_PCM 0x01                // 16 kHz 16-bit mono samples from I2S
+#define AUDIO_FRAME_LIVE 0x02               // Received voice, not a tone, replay or sidetone
+
+#define AUDIO_JITTER_PRIME_FRAMES 2         // Playout starts once this many are queued
+#define AUDIO_RX_MAX_LATENCY_US 120000      // The jitter buffer discards received frames older than this
+
+/**
+ * @brief Add the voice path's stages to an empty pipeline
+ * @param fns One function per audio_stage_id_t
+ * @param ctx Passed to each function; may be nullptr
+ */
+bool audio_pipeline_build(AudioPipeline* pipeline, const audio_stage_fn_t fns[AUDIO_STAGE_COUNT],
+                          void* const ctx[AUDIO_STAGE_COUNT]);
+
+/**
+ * @brief The lane layout for a chip with this many cores
+ *
+ * One core: a single lane. Two: TX on core 1 with the UI, RX on core 0
+ * above the network tasks, so capture never waits for playout. The
+ * sidetone ring is the one that crosses from the TX lane to the RX lane.
+ */
+const audio_profile_t& audio_pipeline_profile(int cores);
+
+#endif // AUDIO_PIPELINE_H
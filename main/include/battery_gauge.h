@@ -0,0 +1,125 @@
+/**
+ * @file battery_gauge.h
+ * @brief Battery charge and runtime estimate from voltage samples, and the charge levels
+ *
+ * The gauge turns calibrated ADC readings of the battery divider into a
+ * state of charge:
+ *
+ * - The terminal voltage sags under load by the current times the cell's
+ *   internal resistance. Each sample comes with the current the node drew
+ *   while it was taken (from the power manager's current model), and the
+ *   sag is added back to estimate the open-circuit voltage.
+ * - The open-circuit voltage is smoothed with an exponentially weighted
+ *   moving average (EWMA) and looked up in a single-cell LiPo discharge
+ *   table.
+ * - The remaining time is the remaining charge over an EWMA of the load
+ *   current.
+ *
+ * The charge level (NORMAL, LOW, CRITICAL) drops as soon as the charge
+ * falls below a threshold and recovers only hysteresis_percent above it,
+ * so a reading at the boundary does not flip the node's behaviour back
+ * and forth. Each level has a policy: how often the node beacons and sends
+ * CoT, how fast the UI may redraw, and the Opus encoder complexity.
+ *
+ * The class does no I/O and is not thread safe, so the host simulation can
+ * replay recorded discharge curves through it.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BATTERY_GAUGE_H
+#define BATTERY_GAUGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Charge level, fullest first
+ */
+typedef enum {
+    BATTERY_LEVEL_NORMAL = 0,
+    BATTERY_LEVEL_LOW,
+    BATTERY_LEVEL_CRITICAL,
+    BATTERY_LEVEL_COUNT
+} battery_level_t;
+
+/**
+ * @brief What the node does at one charge level
+ */
+typedef struct {
+    uint32_t beacon_ms;                     ///< Discovery beacon interval; 0 beacons on every network pass
+    uint32_t cot_ms;                        ///< CoT position report interval
+    uint32_t ui_frame_ms;                   ///< Shortest UI frame interval; 0 leaves it to the power policy
+    int codec_complexity;                   ///< Opus encoder complexity, 0 - 10
+} battery_policy_t;
+
+/**
+ * @brief Gauge configuration
+ */
+typedef struct {
+    float divider;                          ///< Battery voltage over ADC pin voltage
+    float internal_mohm;                    ///< Cell and wiring resistance, for the load sag
+    float voltage_alpha;                    ///< Weight of a new sample in the voltage average, 0 - 1
+    float current_alpha;                    ///< Weight of a new sample in the load average, 0 - 1
+    float capacity_mah;
+    float low_percent;                      ///< Below this the level is LOW
+    float critical_percent;                 ///< Below this the level is CRITICAL
+    float hysteresis_percent;               ///< Margin above a threshold before the level recovers
+    battery_policy_t policy[BATTERY_LEVEL_COUNT];
+} battery_gauge_config_t;
+
+/**
+ * @brief Gauge output
+ */
+typedef struct {
+    bool valid;                             ///< At least one sample taken
+    uint32_t battery_mv;                    ///< Last terminal voltage
+    uint32_t ocv_mv;                        ///< Smoothed open-circuit estimate
+    float percent;                          ///< State of charge, 0 - 100
+    float load_ma;                          ///< Smoothed load current
+    uint32_t minutes;                       ///< Remaining at the smoothed load
+    battery_level_t level;
+    uint32_t samples;
+    uint32_t level_changes;
+} battery_status_t;
+
+/**
+ * @brief Thresholds and policies for this firmware, with a 1500 mAh cell
+ *        on the XIAO's 1:2 divider
+ */
+battery_gauge_config_t battery_gauge_default_config(void);
+
+/**
+ * @brief State of charge of a resting single-cell LiPo, 0 - 100
+ */
+float battery_percent_from_ocv(uint32_t ocv_mv);
+
+const char* battery_level_name(battery_level_t level);
+
+class BatteryGauge {
+public:
+    explicit BatteryGauge(const battery_gauge_config_t& config);
+
+    /**
+     * @brief Add a reading
+     * @param pin_mv   Calibrated voltage at the ADC pin
+     * @param load_ma  Current the node drew while the sample was taken
+     * @return true if the level changed
+     */
+    bool addSample(uint32_t pin_mv, float load_ma);
+
+    const battery_status_t& status() const { return m_status; }
+    const battery_policy_t& policy() const { return m_config.policy[m_status.level]; }
+    const battery_gauge_config_t& config() const { return m_config; }
+
+private:
+    battery_level_t levelFor(float percent) const;
+
+    battery_gauge_config_t m_config;
+    battery_status_t m_status = {};
+    float m_ocv = 0.0f;
+};
+
+#endif // BATTERY_GAUGE_H
@@ -0,0 +1,60 @@
+/**
+ * @file battery_service.h
+ * @brief Battery fuel gauge and battery-aware rates
+ *
+ * A low-priority task samples the battery divider every
+ * BATTERY_SERVICE_SAMPLE_MS through the one-shot ADC driver, averaging
+ * BATTERY_SERVICE_OVERSAMPLE readings and converting them with the chip's
+ * calibration scheme (curve or line fitting) when one is available. The
+ * load current for each sample comes from the power manager's current
+ * model for the state the node is in. The readings feed a BatteryGauge
+ * (battery_gauge.h).
+ *
+ * When the charge level changes the service sets the Opus encoder
+ * complexity through LinkAdaptation, which only takes effect while the
+ * codec is running and is logged as not applied otherwise. The network,
+ * ATAK and UI tasks read battery_service_policy() for their beacon, CoT
+ * and frame intervals. The charge and remaining time go out in NodeInfo
+ * with every beacon.
+ *
+ * Boards without a battery pin (get_battery_adc_pin() < 0), and the host
+ * build, report no status and keep the NORMAL policy.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BATTERY_SERVICE_H
+#define BATTERY_SERVICE_H
+
+#include "battery_gauge.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Task and sampling
+#define BATTERY_SERVICE_TASK_STACK_SIZE (3 * 1024)
+#define BATTERY_SERVICE_TASK_PRIORITY 1
+#define BATTERY_SERVICE_SAMPLE_MS 5000
+#define BATTERY_SERVICE_OVERSAMPLE 16
+
+/**
+ * @brief Set up the ADC and start the sampling task
+ * @return 0 on success or without a battery pin, error code on failure
+ */
+int battery_service_init(void);
+
+/**
+ * @brief Gauge output
+ * @return false until the first sample, or without a battery pin
+ */
+bool battery_service_get_status(battery_status_t* status);
+
+battery_level_t battery_service_level(void);
+
+/**
+ * @brief Rates for the current charge level
+ */
+battery_policy_t battery_service_policy(void);
+
+#endif // BATTERY_SERVICE_H
@@ -0,0 +1,425 @@
+/**
+ * @file board_profile.h
+ * @brief Compile-time board profiles: pins, SPI host and DMA, buffer sizes, SoC features
+ *
+ * The board is chosen in menuconfig (AirCom -> Board, main/Kconfig.projbuild).
+ * It defaults to the XIAO board of the IDF target, and only boards built on
+ * that target are offered. Each board is a traits type whose members are
+ * constexpr, and Board is the selected one. Code reads Board::pin_i2s_bclk
+ * and the like directly, so there is no runtime platform switch.
+ * `if constexpr` on a feature such as Board::has_camera leaves a driver the
+ * board cannot use out of the image.
+ *
+ * SoC facts (cores, GPIO count, the ESP32-S3 vector unit, GDMA, SPI hosts)
+ * come from SocTraits. A board says which SoC it is built on, and
+ * static_asserts check its pins and SPI host against that SoC. Every
+ * profile, selected or not, is also checked for a GPIO given to two
+ * functions.
+ *
+ * Host builds select the XIAO ESP32S3 (host/CMakeLists.txt).
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BOARD_PROFILE_H
+#define BOARD_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/**
+ * @brief Hardware platform enumeration
+ */
+typedef enum {
+    HW_PLATFORM_UNKNOWN = 0,
+    HW_PLATFORM_XIAO_ESP32S3,
+    HW_PLATFORM_XIAO_ESP32C3,
+    HW_PLATFORM_XIAO_ESP32C6,
+    HW_PLATFORM_HELTEC_HT_HC32,
+    HW_PLATFORM_HELTEC_HT_IT01,
+    HW_PLATFORM_HELTEC_GENERIC,
+    HW_PLATFORM_ESP32_GENERIC,
+    HW_PLATFORM_MAX
+} hardware_platform_t;
+
+typedef enum {
+    BOARD_SOC_ESP32 = 0,
+    BOARD_SOC_ESP32S3,
+    BOARD_SOC_ESP32C3,
+    BOARD_SOC_ESP32C6
+} board_soc_t;
+
+typedef enum {
+    BOARD_HALOW_FGH100M = 0,                ///< Quectel FGH100M-H over SPI (MM-IoT-SDK)
+    BOARD_HALOW_HELTEC                      ///< Heltec HaLow module (Heltec SDK)
+} board_halow_module_t;
+
+// spi_host_device_t and spi_dma_chan_t values, kept as ints so host builds
+// need no driver headers
+#define BOARD_SPI2_HOST 1
+#define BOARD_SPI3_HOST 2
+#define BOARD_SPI_DMA_CH1 1
+#define BOARD_SPI_DMA_CH2 2
+#define BOARD_SPI_DMA_AUTO 3
+
+// ============================================================================
+// SOC TRAITS
+// ============================================================================
+
+template <board_soc_t SOC> struct SocTraits;
+
+template <> struct SocTraits<BOARD_SOC_ESP32> {
+    static constexpr board_soc_t soc = BOARD_SOC_ESP32;
+    static constexpr const char* soc_name = "esp32";
+    static constexpr int cores = 2;
+    static constexpr int gpio_count = 40;
+    static constexpr bool has_simd = false;
+    static constexpr bool has_gdma = false;         ///< Fixed DMA channels 1 and 2 for SPI
+    static constexpr int spi_hosts = 2;             ///< General purpose: SPI2 (HSPI), SPI3 (VSPI)
+};
+
+template <> struct SocTraits<BOARD_SOC_ESP32S3> {
+    static constexpr board_soc_t soc = BOARD_SOC_ESP32S3;
+    static constexpr const char* soc_name = "esp32s3";
+    static constexpr int cores = 2;
+    static constexpr int gpio_count = 49;
+    static constexpr bool has_simd = true;          ///< Xtensa PIE 128-bit vector instructions
+    static constexpr bool has_gdma = true;
+    static constexpr int spi_hosts = 2;
+};
+
+template <> struct SocTraits<BOARD_SOC_ESP32C3> {
+    static constexpr board_soc_t soc = BOARD_SOC_ESP32C3;
+    static constexpr const char* soc_name = "esp32c3";
+    static constexpr int cores = 1;
+    static constexpr int gpio_count = 22;
+    static constexpr bool has_simd = false;
+    static constexpr bool has_gdma = true;
+    static constexpr int spi_hosts = 1;             ///< SPI2 only
+};
+
+template <> struct SocTraits<BOARD_SOC_ESP32C6> {
+    static constexpr board_soc_t soc = BOARD_SOC_ESP32C6;
+    static constexpr const char* soc_name = "esp32c6";
+    static constexpr int cores = 1;
+    static constexpr int gpio_count = 31;
+    static constexpr bool has_simd = false;
+    static constexpr bool has_gdma = true;
+    static constexpr int spi_hosts = 1;
+};
+
+// ============================================================================
+// CAMERA CONNECTORS
+// ============================================================================
+
+struct CameraNone {
+    static constexpr bool has_camera = false;
+    static constexpr int cam_pin_pwdn = -1;
+    static constexpr int cam_pin_reset = -1;
+    static constexpr int cam_pin_xclk = -1;
+    static constexpr int cam_pin_siod = -1;
+    static constexpr int cam_pin_sioc = -1;
+    static constexpr int cam_pin_d[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    static constexpr int cam_pin_vsync = -1;
+    static constexpr int cam_pin_href = -1;
+    static constexpr int cam_pin_pclk = -1;
+    static constexpr int cam_fb_count = 0;
+};
+
+// XIAO ESP32S3 Sense camera connector, frame buffers in PSRAM
+struct CameraXiaoSense {
+    static constexpr bool has_camera = true;
+    static constexpr int cam_pin_pwdn = -1;
+    static constexpr int cam_pin_reset = -1;
+    static constexpr int cam_pin_xclk = 10;
+    static constexpr int cam_pin_siod = 40;
+    static constexpr int cam_pin_sioc = 39;
+    static constexpr int cam_pin_d[8] = {15, 17, 18, 16, 14, 12, 11, 48};    ///< D0..D7
+    static constexpr int cam_pin_vsync = 38;
+    static constexpr int cam_pin_href = 47;
+    static constexpr int cam_pin_pclk = 13;
+    static constexpr int cam_fb_count = 1;
+};
+
+// ============================================================================
+// BOARDS
+// ============================================================================
+
+// pin_gps_rx and pin_gps_tx are the ESP32's side: data from the GPS arrives
+// on pin_gps_rx. -1 means not fitted, for any pin but the HaLow, I2S and
+// OLED ones.
+
+struct BoardXiaoEsp32S3 : SocTraits<BOARD_SOC_ESP32S3>, CameraXiaoSense {
+    static constexpr hardware_platform_t platform = HW_PLATFORM_XIAO_ESP32S3;
+    static constexpr const char* name = "XIAO ESP32S3";
+
+    static constexpr int pin_oled_sda = 5;
+    static constexpr int pin_oled_scl = 6;
+    static constexpr int pin_i2s_bclk = 7;
+    static constexpr int pin_i2s_lrc = 8;
+    static constexpr int pin_i2s_din = 9;
+    static constexpr int pin_i2s_dout = 41;            ///< GPIO10 is the camera XCLK
+    static constexpr int pin_button_ptt = 3;
+    static constexpr int pin_button_up = 1;
+    static constexpr int pin_button_down = 2;
+    static constexpr int pin_button_select = 0;
+    static constexpr int pin_button_back = 45;         ///< Straps VDD_SPI low (3.3 V) when pressed at boot, the default
+    static constexpr int pin_gps_rx = 44;
+    static constexpr int pin_gps_tx = 43;
+    static constexpr int pin_led = 21;
+    static constexpr int pin_battery_adc = 4;
+
+    static constexpr board_halow_module_t halow_module = BOARD_HALOW_FGH100M;
+    static constexpr int pin_halow_mosi = 35;
+    static constexpr int pin_halow_miso = 37;
+    static constexpr int pin_halow_sclk = 36;
+    static constexpr int pin_halow_cs = 34;
+    static constexpr int pin_halow_reset = 33;
+    static constexpr int pin_halow_int = 42;           ///< GPIO38 is the camera VSYNC
+    static constexpr int halow_spi_host = BOARD_SPI2_HOST;
+    static constexpr int halow_spi_dma = BOARD_SPI_DMA_AUTO;
+    static constexpr size_t halow_spi_buffer = 4096;   ///< Each of two TX and one RX DMA buffers
+
+    static constexpr int i2s_dma_buf_count = 8;
+    static constexpr int i2s_dma_buf_len = 256;
+
+    static constexpr uint16_t display_width = 128;
+    static constexpr uint16_t display_height = 64;
+    static constexpr bool display_touch = false;
+};
+
+// Single core, no PSRAM: half-size SPI buffers leave internal RAM for the
+// codec and still hold a full-MTU link frame. GPIO11-19 belong to the flash
+// and USB, which leaves 13 pins: the HaLow module, I2S, the OLED and PTT
+// take them all, so there is no GPS, LED, battery ADC or menu buttons.
+struct BoardXiaoEsp32C3 : SocTraits<BOARD_SOC_ESP32C3>, CameraNone {
+    static constexpr hardware_platform_t platform = HW_PLATFORM_XIAO_ESP32C3;
+    static constexpr const char* name = "XIAO ESP32C3";
+
+    static constexpr int pin_oled_sda = 4;
+    static constexpr int pin_oled_scl = 20;
+    static constexpr int pin_i2s_bclk = 0;
+    static constexpr int pin_i2s_lrc = 1;
+    static constexpr int pin_i2s_din = 2;
+    static constexpr int pin_i2s_dout = 3;
+    static constexpr int pin_button_ptt = 21;
+    static constexpr int pin_button_up = -1;
+    static constexpr int pin_button_down = -1;
+    static constexpr int pin_button_select = -1;
+    static constexpr int pin_button_back = -1;
+    static constexpr int pin_gps_rx = -1;
+    static constexpr int pin_gps_tx = -1;
+    static constexpr int pin_led = -1;
+    static constexpr int pin_battery_adc = -1;
+
+    static constexpr board_halow_module_t halow_module = BOARD_HALOW_FGH100M;
+    static constexpr int pin_halow_mosi = 6;
+    static constexpr int pin_halow_miso = 7;
+    static constexpr int pin_halow_sclk = 8;
+    static constexpr int pin_halow_cs = 9;
+    static constexpr int pin_halow_reset = 10;
+    static constexpr int pin_halow_int = 5;
+    static constexpr int halow_spi_host = BOARD_SPI2_HOST;
+    static constexpr int halow_spi_dma = BOARD_SPI_DMA_AUTO;
+    static constexpr size_t halow_spi_buffer = 2048;
+
+    static constexpr int i2s_dma_buf_count = 8;
+    static constexpr int i2s_dma_buf_len = 256;
+
+    static constexpr uint16_t display_width = 128;
+    static constexpr uint16_t display_height = 64;
+    static constexpr bool display_touch = false;
+};
+
+struct BoardXiaoEsp32C6 : SocTraits<BOARD_SOC_ESP32C6>, CameraNone {
+    static constexpr hardware_platform_t platform = HW_PLATFORM_XIAO_ESP32C6;
+    static constexpr const char* name = "XIAO ESP32C6";
+
+    static constexpr int pin_oled_sda = 4;
+    static constexpr int pin_oled_scl = 5;
+    static constexpr int pin_i2s_bclk = 6;
+    static constexpr int pin_i2s_lrc = 7;
+    static constexpr int pin_i2s_din = 8;
+    static constexpr int pin_i2s_dout = 9;
+    static constexpr int pin_button_ptt = 3;
+    static constexpr int pin_button_up = 1;
+    static constexpr int pin_button_down = 2;
+    static constexpr int pin_button_select = 0;
+    static constexpr int pin_button_back = 11;
+    static constexpr int pin_gps_rx = 23;
+    static constexpr int pin_gps_tx = 24;
+    static constexpr int pin_led = 15;
+    static constexpr int pin_battery_adc = 10;
+
+    static constexpr board_halow_module_t halow_module = BOARD_HALOW_FGH100M;
+    static constexpr int pin_halow_mosi = 18;
+    static constexpr int pin_halow_miso = 19;
+    static constexpr int pin_halow_sclk = 20;
+    static constexpr int pin_halow_cs = 21;
+    static constexpr int pin_halow_reset = 22;
+    static constexpr int pin_halow_int = 17;
+    static constexpr int halow_spi_host = BOARD_SPI2_HOST;
+    static constexpr int halow_spi_dma = BOARD_SPI_DMA_AUTO;
+    static constexpr size_t halow_spi_buffer = 2048;
+
+    static constexpr int i2s_dma_buf_count = 8;
+    static constexpr int i2s_dma_buf_len = 256;
+
+    static constexpr uint16_t display_width = 128;
+    static constexpr uint16_t display_height = 64;
+    static constexpr bool display_touch = false;
+};
+
+// Heltec boards: the HaLow module sits on the VSPI IO_MUX pins, so SPI3
+// with its fixed DMA channel 2
+struct BoardHeltecGeneric : SocTraits<BOARD_SOC_ESP32>, CameraNone {
+    static constexpr hardware_platform_t platform = HW_PLATFORM_HELTEC_GENERIC;
+    static constexpr const char* name = "Heltec Generic";
+
+    static constexpr int pin_oled_sda = 4;
+    static constexpr int pin_oled_scl = 15;
+    static constexpr int pin_i2s_bclk = 26;
+    static constexpr int pin_i2s_lrc = 25;
+    static constexpr int pin_i2s_din = 33;
+    static constexpr int pin_i2s_dout = 32;
+    static constexpr int pin_button_ptt = 12;
+    static constexpr int pin_button_up = 13;
+    static constexpr int pin_button_down = 14;
+    static constexpr int pin_button_select = 0;
+    static constexpr int pin_button_back = 2;
+    static constexpr int pin_gps_rx = 34;
+    static constexpr int pin_gps_tx = 22;
+    static constexpr int pin_led = 21;
+    static constexpr int pin_battery_adc = 35;
+
+    static constexpr board_halow_module_t halow_module = BOARD_HALOW_HELTEC;
+    static constexpr int pin_halow_mosi = 23;
+    static constexpr int pin_halow_miso = 19;
+    static constexpr int pin_halow_sclk = 18;
+    static constexpr int pin_halow_cs = 5;
+    static constexpr int pin_halow_reset = 17;
+    static constexpr int pin_halow_int = 16;
+    static constexpr int halow_spi_host = BOARD_SPI3_HOST;
+    static constexpr int halow_spi_dma = BOARD_SPI_DMA_CH2;
+    static constexpr size_t halow_spi_buffer = 4096;
+
+    static constexpr int i2s_dma_buf_count = 8;
+    static constexpr int i2s_dma_buf_len = 256;
+
+    static constexpr uint16_t display_width = 128;
+    static constexpr uint16_t display_height = 64;
+    static constexpr bool display_touch = false;
+};
+
+struct BoardHeltecHtHc32 : BoardHeltecGeneric {
+    static constexpr hardware_platform_t platform = HW_PLATFORM_HELTEC_HT_HC32;
+    static constexpr const char* name = "Heltec HT-HC32";
+};
+
+struct BoardHeltecHtIt01 : BoardHeltecGeneric {
+    static constexpr hardware_platform_t platform = HW_PLATFORM_HELTEC_HT_IT01;
+    static constexpr const char* name = "Heltec HT-IT01";
+
+    static constexpr uint16_t display_width = 240;
+    static constexpr uint16_t display_height = 320;
+    static constexpr bool display_touch = true;
+};
+
+// ============================================================================
+// SELECTED BOARD
+// ============================================================================
+
+#if defined(CONFIG_AIRCOM_BOARD_XIAO_ESP32S3)
+typedef BoardXiaoEsp32S3 Board;
+#elif defined(CONFIG_AIRCOM_BOARD_XIAO_ESP32C3)
+typedef BoardXiaoEsp32C3 Board;
+#elif defined(CONFIG_AIRCOM_BOARD_XIAO_ESP32C6)
+typedef BoardXiaoEsp32C6 Board;
+#elif defined(CONFIG_AIRCOM_BOARD_HELTEC_HT_HC32)
+typedef BoardHeltecHtHc32 Board;
+#elif defined(CONFIG_AIRCOM_BOARD_HELTEC_HT_IT01)
+typedef BoardHeltecHtIt01 Board;
+#elif defined(CONFIG_AIRCOM_BOARD_HELTEC_GENERIC)
+typedef BoardHeltecGeneric Board;
+#else
+#error "No AirCom board selected: set AirCom -> Board in menuconfig"
+#endif
+
+/**
+ * @brief First GPIO a board gives to two functions, or -1 if all are distinct
+ *
+ * Covers every pin of the profile, the camera connector's included, and
+ * skips the -1 of pins that are not fitted.
+ */
+template <typename B> constexpr int board_shared_pin() {
+    const int pins[] = {
+        B::pin_oled_sda, B::pin_oled_scl,
+        B::pin_i2s_bclk, B::pin_i2s_lrc, B::pin_i2s_din, B::pin_i2s_dout,
+        B::pin_button_ptt, B::pin_button_up, B::pin_button_down, B::pin_button_select, B::pin_button_back,
+        B::pin_gps_rx, B::pin_gps_tx, B::pin_led, B::pin_battery_adc,
+        B::pin_halow_mosi, B::pin_halow_miso, B::pin_halow_sclk, B::pin_halow_cs,
+        B::pin_halow_reset, B::pin_halow_int,
+        B::cam_pin_pwdn, B::cam_pin_reset, B::cam_pin_xclk, B::cam_pin_siod, B::cam_pin_sioc,
+        B::cam_pin_d[0], B::cam_pin_d[1], B::cam_pin_d[2], B::cam_pin_d[3],
+        B::cam_pin_d[4], B::cam_pin_d[5], B::cam_pin_d[6], B::cam_pin_d[7],
+        B::cam_pin_vsync, B::cam_pin_href, B::cam_pin_pclk,
+    };
+    const size_t count = sizeof(pins) / sizeof(pins[0]);
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = i + 1; j < count; j++) {
+            if (pins[i] >= 0 && pins[i] == pins[j]) {
+                return pins[i];
+            }
+        }
+    }
+    return -1;
+}
+
+static_assert(board_shared_pin<BoardXiaoEsp32S3>() < 0, "XIAO ESP32S3 gives a GPIO to two functions");
+static_assert(board_shared_pin<BoardXiaoEsp32C3>() < 0, "XIAO ESP32C3 gives a GPIO to two functions");
+static_assert(board_shared_pin<BoardXiaoEsp32C6>() < 0, "XIAO ESP32C6 gives a GPIO to two functions");
+static_assert(board_shared_pin<BoardHeltecGeneric>() < 0, "Heltec boards give a GPIO to two functions");
+
+static constexpr bool board_pin_ok(int pin) {
+    return pin >= -1 && pin < Board::gpio_count;
+}
+
+static_assert(board_pin_ok(Board::pin_oled_sda) && board_pin_ok(Board::pin_oled_scl) &&
+              board_pin_ok(Board::pin_i2s_bclk) && board_pin_ok(Board::pin_i2s_lrc) &&
+              board_pin_ok(Board::pin_i2s_din) && board_pin_ok(Board::pin_i2s_dout) &&
+              board_pin_ok(Board::pin_button_ptt) && board_pin_ok(Board::pin_button_up) &&
+              board_pin_ok(Board::pin_button_down) && board_pin_ok(Board::pin_button_select) &&
+              board_pin_ok(Board::pin_button_back) && board_pin_ok(Board::pin_gps_rx) &&
+              board_pin_ok(Board::pin_gps_tx) && board_pin_ok(Board::pin_led) &&
+              board_pin_ok(Board::pin_battery_adc),
+              "Board pin outside the SoC's GPIO range");
+static_assert(board_pin_ok(Board::pin_halow_mosi) && board_pin_ok(Board::pin_halow_miso) &&
+              board_pin_ok(Board::pin_halow_sclk) && board_pin_ok(Board::pin_halow_cs) &&
+              board_pin_ok(Board::pin_halow_reset) && board_pin_ok(Board::pin_halow_int),
+              "HaLow pin outside the SoC's GPIO range");
+static_assert(Board::halow_spi_host >= BOARD_SPI2_HOST &&
+              Board::halow_spi_host < BOARD_SPI2_HOST + Board::spi_hosts,
+              "HaLow SPI host does not exist on this SoC");
+static_assert(!Board::has_gdma || Board::halow_spi_dma == BOARD_SPI_DMA_AUTO,
+              "SoCs with GDMA only take an automatically allocated SPI DMA channel");
+static_assert(!Board::has_camera || Board::soc == BOARD_SOC_ESP32S3,
+              "The camera driver needs the ESP32-S3's PSRAM and LCD_CAM");
+
+// The selected board has to match the chip the firmware is built for
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+static_assert(Board::soc == BOARD_SOC_ESP32S3, "Board is not an ESP32-S3 board");
+#elif defined(CONFIG_IDF_TARGET_ESP32C3)
+static_assert(Board::soc == BOARD_SOC_ESP32C3, "Board is not an ESP32-C3 board");
+#elif defined(CONFIG_IDF_TARGET_ESP32C6)
+static_assert(Board::soc == BOARD_SOC_ESP32C6, "Board is not an ESP32-C6 board");
+#elif defined(CONFIG_IDF_TARGET_ESP32)
+static_assert(Board::soc == BOARD_SOC_ESP32, "Board is not an ESP32 board");
+#endif
+
+#endif // BOARD_PROFILE_H
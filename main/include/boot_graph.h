@@ -0,0 +1,124 @@
+/**
+ * @file boot_graph.h
+ * @brief Boot stages, their dependencies and the boot timeline
+ *
+ * Start-up is a set of stages. Each stage is an init function plus the
+ * stages that must finish before it may start, given as a bit mask of
+ * stage ids. A stage can only depend on stages added before it, so the
+ * graph has no cycles. Workers take() any stage whose dependencies are
+ * done, run it and finish() it. Stages that do not depend on each other
+ * run side by side, and the lowest id goes first when several are ready,
+ * so the critical path should be numbered first.
+ *
+ * A stage that returns non-zero has failed. Every stage that depends on
+ * it, directly or not, is skipped rather than run against a
+ * half-initialised service. Lazy stages are not run at boot: request()
+ * marks one wanted, with the lazy stages it depends on, when the feature
+ * is first used.
+ *
+ * Each stage keeps its start and finish time and the core it ran on:
+ * the boot timeline.
+ *
+ * The class does no I/O, takes the time as an argument and is not thread
+ * safe, so the host simulation can schedule a modelled boot with it.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BOOT_GRAPH_H
+#define BOOT_GRAPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// One FreeRTOS event group bit per stage
+#define BOOT_MAX_STAGES 24
+
+#define BOOT_BIT(id) (1u << (id))
+
+typedef int (*boot_stage_fn_t)(void);
+
+typedef enum {
+    BOOT_STAGE_PENDING = 0,
+    BOOT_STAGE_RUNNING,
+    BOOT_STAGE_DONE,
+    BOOT_STAGE_FAILED,
+    BOOT_STAGE_SKIPPED                      ///< A dependency failed
+} boot_stage_state_t;
+
+/**
+ * @brief One stage and its place in the timeline
+ */
+typedef struct {
+    const char* name;                       ///< nullptr: no stage with this id
+    boot_stage_fn_t fn;
+    uint32_t deps;                          ///< BOOT_BIT() of each stage that must finish first
+    bool lazy;                              ///< Only run once requested
+    bool requested;
+    boot_stage_state_t state;
+    int result;
+    int64_t start_us;
+    int64_t end_us;
+    int core;
+} boot_stage_t;
+
+const char* boot_stage_state_name(boot_stage_state_t state);
+
+class BootGraph {
+public:
+    /**
+     * @brief Add a stage
+     * @return false if the id is taken or out of range, a dependency has
+     *         not been added yet, or an eager stage depends on a lazy one
+     */
+    bool add(int id, const char* name, boot_stage_fn_t fn, uint32_t deps, bool lazy = false);
+
+    /**
+     * @brief Start the lowest ready stage: wanted, pending, dependencies done
+     * @param among  BOOT_BIT() of the stages that may be taken
+     * @return Its id, or -1 if none is ready now
+     */
+    int take(int64_t now_us, int core, uint32_t among = ~0u);
+
+    /**
+     * @brief Record the result of a stage taken with take()
+     * @return BOOT_BIT() of the stage and of every stage skipped because it failed
+     */
+    uint32_t finish(int id, int result, int64_t now_us);
+
+    /**
+     * @brief Want a lazy stage and the lazy stages it depends on
+     * @return false for an unknown id
+     */
+    bool request(int id);
+
+    /**
+     * @brief Every wanted stage has finished, failed or been skipped
+     */
+    bool settled() const;
+
+    bool running() const { return m_running != 0; }
+
+    /**
+     * @brief BOOT_BIT() of the stage and everything it depends on, directly or not
+     */
+    uint32_t closure(int id) const;
+
+    uint32_t doneMask() const { return m_done; }
+    uint32_t endedMask() const { return m_ended; }
+    bool exists(int id) const { return id >= 0 && id < BOOT_MAX_STAGES && (m_present & BOOT_BIT(id)); }
+    const boot_stage_t& stage(int id) const { return m_stages[id]; }
+
+private:
+    bool wanted(const boot_stage_t& stage) const { return !stage.lazy || stage.requested; }
+
+    boot_stage_t m_stages[BOOT_MAX_STAGES] = {};
+    uint32_t m_present = 0;
+    uint32_t m_done = 0;                    ///< Finished with 0
+    uint32_t m_ended = 0;                   ///< Finished, failed or skipped
+    uint32_t m_running = 0;
+};
+
+#endif // BOOT_GRAPH_H
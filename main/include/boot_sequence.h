@@ -0,0 +1,110 @@
+/**
+ * @file boot_sequence.h
+ * @brief Parallel start-up from a stage graph, readiness waits and the boot timeline
+ *
+ * boot_sequence_build() lays out the firmware's stages and what each
+ * needs in a BootGraph (boot_graph.h); app_main supplies the init
+ * functions and hands the graph to boot_sequence_run(). The radio, the
+ * longest stage, waits only for its configuration. The flash-bound
+ * services start alongside it. The OTA image hash, which nothing waits
+ * for, is numbered last. BOOT_SEQUENCE_WORKERS tasks, one per
+ * core, run every stage whose dependencies are done. Each finished stage
+ * sets its bit in an event group:
+ *
+ * - Tasks that need a service wait for it with boot_wait() instead of
+ *   sleeping for a fixed time, and go on as soon as it is up.
+ * - Lazy stages (Bluetooth) run on the task that first needs them, via
+ *   boot_ensure().
+ *
+ * The audio task calls boot_voice_ready() once it can key up and play:
+ * I2S is running and the radio is up. That is the time-to-first-voice,
+ * the figure operators wait for after power-on. It is logged with the
+ * timeline of every stage (start, finish, core, result) and published as
+ * boot.voice_ready_ms. All times are measured from esp_timer start,
+ * early in the second-stage boot.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include "boot_graph.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Workers
+#define BOOT_SEQUENCE_WORKERS 2
+#define BOOT_SEQUENCE_WORKER_STACK_SIZE (6 * 1024)
+#define BOOT_SEQUENCE_WORKER_PRIORITY 5
+
+#define BOOT_WAIT_FOREVER UINT32_MAX
+
+/**
+ * @brief The firmware's stages, critical path to first voice first
+ */
+typedef enum {
+    BOOT_STAGE_NVS = 0,
+    BOOT_STAGE_CONFIG,
+    BOOT_STAGE_ERRORS,
+    BOOT_STAGE_EXECUTOR,
+    BOOT_STAGE_POWER,
+    BOOT_STAGE_RADIO,                       ///< HaLow mesh up; services add their mesh listeners as they start
+    BOOT_STAGE_SHARED_DATA,
+    BOOT_STAGE_STORAGE,                     ///< SPIFFS, mounted once for every service that uses it
+    BOOT_STAGE_TALKGROUP,
+    BOOT_STAGE_FLOOR,
+    BOOT_STAGE_OUTBOX,
+    BOOT_STAGE_TELEMETRY,
+    BOOT_STAGE_RECORDER,
+    BOOT_STAGE_HISTORY,
+    BOOT_STAGE_BATTERY,
+    BOOT_STAGE_TASKS,
+    BOOT_STAGE_CAMERA,                      ///< Receive path only; the sensor starts on first capture
+    BOOT_STAGE_OTA,                         ///< Hashes the running image; nothing waits for it
+    BOOT_STAGE_BLUETOOTH,                   ///< Lazy: when the Bluetooth screen first scans
+    BOOT_STAGE_COUNT
+} boot_stage_id_t;
+
+/**
+ * @brief Add the firmware's stages and their dependencies to a graph
+ * @param fns  Init function of each stage by boot_stage_id_t; a nullptr
+ *             stage does nothing (the host simulation models the time)
+ * @return false if the graph already has stages
+ */
+bool boot_sequence_build(BootGraph* graph, const boot_stage_fn_t fns[BOOT_STAGE_COUNT]);
+
+/**
+ * @brief Run every eager stage of the graph and wait until they have ended
+ * @return 0 if every stage succeeded, -1 if one failed or was skipped
+ */
+int boot_sequence_run(BootGraph* graph);
+
+/**
+ * @brief Block until the given stages have ended
+ * @param stages  BOOT_BIT() of each stage
+ * @return true if they all succeeded; also true before boot_sequence_run(),
+ *         when nothing is tracked
+ */
+bool boot_wait(uint32_t stages, uint32_t timeout_ms);
+
+/**
+ * @brief Run a lazy stage, and the lazy stages it needs, on this task
+ *        unless it has already run; wait if another task is running it
+ * @return The stage's result, or -1 if it was skipped or timed out
+ */
+int boot_ensure(int stage, uint32_t timeout_ms);
+
+/**
+ * @brief The node can transmit and play voice; logs time-to-first-voice
+ */
+void boot_voice_ready(void);
+
+/**
+ * @brief Time-to-first-voice in ms, 0 until boot_voice_ready()
+ */
+uint32_t boot_voice_ready_ms(void);
+
+#endif // BOOT_SEQUENCE_H
@@ -0,0 +1,115 @@
+/**
+ * @file bulk_service.h
+ * @brief Large payload delivery over the mesh on BULK_PORT
+ *
+ * One task owns BULK_PORT and runs every bulk transfer (bulk_transfer.h)
+ * of the node: a sender and a receiver per peer, and the multicast
+ * transfers that deliver one payload to several peers at once.
+ *
+ * Sending to a single peer is a unicast transfer. Sending to a group is a
+ * multicast transfer; peers that have not received everything when it ends
+ * are finished by unicast from where they stopped. A transfer that fails
+ * is offered again, with the same transfer ID so that nothing already
+ * received is sent twice, up to BULK_SERVICE_SEND_ATTEMPTS times.
+ * Transfers to a peer that is busy wait their turn.
+ *
+ * Received payloads are handed to the handler registered for their
+ * content type, first the preview prefix (if the sender marked one) and
+ * then the whole payload.
+ *
+ * All callbacks run on the bulk task and should return quickly.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BULK_SERVICE_H
+#define BULK_SERVICE_H
+
+#include "bulk_transfer.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Task and timing
+#define BULK_SERVICE_TASK_STACK_SIZE (6 * 1024)
+#define BULK_SERVICE_TASK_PRIORITY 2
+#define BULK_SERVICE_TICK_MS 10
+#define BULK_SERVICE_EVENT_QUEUE_DEPTH 64
+#define BULK_SERVICE_PEER_ID_LEN 40
+#define BULK_SERVICE_MAX_PEERS 16           // Receivers of one multicast
+#define BULK_SERVICE_MAX_QUEUED 4           // Transfers waiting per peer
+#define BULK_SERVICE_SEND_ATTEMPTS 3        // Offers of one payload to an unreachable peer
+#define BULK_SERVICE_RETRY_DELAY_MS 10000
+
+/**
+ * @brief Received payloads: the preview prefix (complete == false), then the whole payload
+ */
+typedef void (*bulk_receive_handler_t)(const char* peer_id, const uint8_t* data, size_t length, bool complete);
+
+/**
+ * @brief Progress of one payload towards one peer; elapsed times count from the send call
+ */
+struct BulkSendCallbacks {
+    std::function<void(const std::string& peer_id, uint32_t elapsed_ms)> onPreview;   ///< Preview prefix acknowledged
+    std::function<void(const std::string& peer_id, bool delivered, uint32_t elapsed_ms, uint32_t retransmits)> onDone;
+};
+
+/**
+ * @brief Bulk service counters
+ */
+typedef struct {
+    uint32_t transfers_sent;        ///< Per peer
+    uint32_t send_failures;         ///< Per peer, after every attempt
+    uint32_t transfers_received;
+    uint32_t multicasts;
+    uint32_t unicast_fallbacks;     ///< Peers finished by unicast after a multicast
+    uint32_t bytes_sent;            ///< Chunk frames, including retransmissions
+    uint32_t retransmits;
+    uint32_t nacks_suppressed;      ///< NACKs left unsent because another peer asked first
+    uint32_t last_transfer_ms;
+} bulk_service_stats_t;
+
+/**
+ * @brief Hand payloads of one content type (bulk_content_t) to a handler
+ */
+void bulk_service_set_handler(uint8_t content_type, bulk_receive_handler_t handler);
+
+/**
+ * @brief Initialize the bulk service: hook into the mesh manager and start the task
+ * @return 0 on success, error code on failure
+ */
+int bulk_service_init(void);
+
+/**
+ * @brief Send a payload to one peer
+ * @param preview_size Length of a prefix that is useful on its own; 0 if none
+ * @return Transfer ID, 0 if the service is not running or the queue is full
+ */
+uint32_t bulk_service_send(const std::string& peer_id, std::shared_ptr<const std::vector<uint8_t>> payload,
+                           uint8_t content_type, uint32_t preview_size, const BulkSendCallbacks& callbacks);
+
+/**
+ * @brief Send a payload to several peers with one multicast transfer
+ *
+ * Callbacks are made for each peer. With a single peer this is a unicast
+ * transfer.
+ *
+ * @return Transfer ID, 0 if the service is not running or the queue is full
+ */
+uint32_t bulk_service_multicast(const std::vector<std::string>& peer_ids,
+                                std::shared_ptr<const std::vector<uint8_t>> payload, uint8_t content_type,
+                                uint32_t preview_size, const BulkSendCallbacks& callbacks);
+
+/**
+ * @brief Get bulk service statistics
+ * @return false if the service is not running
+ */
+bool bulk_service_get_stats(bulk_service_stats_t* stats);
+
+#endif // BULK_SERVICE_H
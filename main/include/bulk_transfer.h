@@ -0,0 +1,405 @@
+/**
+ * @file bulk_transfer.h
+ * @brief Reliable transfer of large payloads over mesh datagrams
+ *
+ * The mesh offers datagrams only, a little under BULK_RADIO_MTU bytes each,
+ * any of which may be lost. A bulk transfer moves one payload of up to
+ * BULK_MAX_TRANSFER_SIZE (an image, a file, a map tile set) from a sender
+ * to one receiver or to a group, split into chunks that each fill one
+ * datagram:
+ *
+ * - OFFER  sender -> receivers: transfer ID, size, chunk size, content type
+ *          and the length of a prefix that is useful on its own (preview)
+ * - CHUNK  sender -> receivers: one chunk and its transmission number
+ * - ACK    receiver -> sender: every chunk below a cumulative index plus a
+ *          selective acknowledgement (SACK) bitmap of the chunks after it
+ * - NACK   receiver -> group: missing chunk ranges and the loss it has seen
+ *
+ * Unicast (BulkSender) is selective-repeat ARQ. Chunks go out in order, so
+ * the preview prefix arrives first, as many at a time as the congestion
+ * window allows. A chunk is sent again once a chunk sent after it has been
+ * acknowledged (it was lost). If no ACK makes progress for a retransmit
+ * timeout, the oldest chunk is sent again, or the whole window when
+ * nothing queues, since a lone resend is easily lost too. The timeout
+ * follows the measured round trip time (RFC 6298) and doubles while the
+ * peer is silent; a peer that still answers just lost a frame.
+ *
+ * The congestion window starts small and doubles each round trip (slow
+ * start), then grows by one chunk per round trip. The round trip time
+ * tells congestion from radio loss: once it rises well above the lowest
+ * seen (more than the receiver's ACK delay), frames are queueing, slow start ends and the window stops growing,
+ * so other traffic such as voice is not stuck behind a long queue. A loss
+ * while frames queue halves the window, once per round trip. A loss
+ * without a queue is the radio's doing; it only holds the window for a
+ * round trip, since shrinking it would not save a frame. A timeout drops
+ * the window to one chunk when queueing and halves it otherwise, never
+ * below the starting window, so that later losses are still found from
+ * the acknowledgements rather than by another timeout.
+ *
+ * Multicast (BulkMulticastSender) sends each chunk once to the whole
+ * group at a paced rate. At every poll (a repeated OFFER with the number
+ * of chunks sent so far) receivers that miss chunks answer with a NACK
+ * after a random delay, and stay quiet if another receiver has already
+ * asked for everything they miss. The sender merges all NACKs and sends
+ * each missing chunk once, however many receivers lost it. Receivers
+ * acknowledge completion individually. Receivers also report the loss
+ * they see; the rate falls when the worst receiver loses clearly more
+ * than the group usually does, and otherwise creeps up.
+ *
+ * Transfers resume: the receiver keeps a partial payload for
+ * receiver_keep_ms after the sender goes quiet. A sender that offers the
+ * same transfer ID again is told which chunks already arrived and sends
+ * only the rest. This works across modes, so a receiver that fell behind
+ * in a multicast can be finished by unicast.
+ *
+ * The classes hold protocol state only. They do no I/O except through the
+ * send functions, take the time as an argument and are not thread safe,
+ * so host tools can run them on simulated time.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef BULK_TRANSFER_H
+#define BULK_TRANSFER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BULK_RADIO_MTU 1472                 // HaLow IP MTU less IP and UDP headers
+#define BULK_CHUNK_OVERHEAD 18              // Frame and chunk header bytes
+#define BULK_DEFAULT_CHUNK_SIZE (BULK_RADIO_MTU - BULK_CHUNK_OVERHEAD)
+#define BULK_MAX_TRANSFER_SIZE (4 * 1024 * 1024)
+#define BULK_ACK_BITMAP_CHUNKS 256          // Chunks past the cumulative index an ACK covers
+#define BULK_NACK_MAX_RANGES 32
+#define BULK_MIN_RETRANSMIT_MS 200
+#define BULK_MAX_RETRANSMIT_MS 4000
+#define BULK_MIN_QUEUE_DELAY_MS 40          // Round trip rise that counts as queueing
+
+/**
+ * @brief Payload types; receivers hand payloads to the matching service
+ */
+typedef enum {
+    BULK_CONTENT_BINARY = 0,
+    BULK_CONTENT_JPEG = 1
+} bulk_content_t;
+
+/**
+ * @brief Transfer timing, windows and rates
+ */
+typedef struct {
+    uint16_t chunk_size;                ///< Payload bytes per chunk
+    uint16_t initial_window;            ///< Congestion window at the start, chunks
+    uint16_t max_window;                ///< Largest congestion window
+    uint16_t ack_every;                 ///< Receiver acknowledges after this many new chunks
+    uint32_t ack_delay_ms;              ///< ... or this long after an unacknowledged chunk
+    uint32_t retransmit_timeout_ms;     ///< Until the round trip time has been measured
+    uint32_t offer_interval_ms;         ///< Repeat the offer until the receiver answers
+    uint32_t sender_give_up_ms;         ///< Sender fails after this long without feedback
+    uint32_t receiver_keep_ms;          ///< Partial payloads kept for resume this long
+    uint32_t multicast_rate_kbps;       ///< Starting multicast rate
+    uint32_t multicast_min_rate_kbps;
+    uint32_t multicast_max_rate_kbps;
+    uint16_t multicast_loss_threshold;  ///< Per mille above the usual loss that slows the group
+    uint32_t poll_interval_ms;          ///< Multicast status polls
+    uint32_t nack_backoff_ms;           ///< Receivers spread their NACKs over this
+} bulk_config_t;
+
+/**
+ * @brief Default timing for the HaLow mesh
+ */
+bulk_config_t bulk_default_config(void);
+
+/**
+ * @brief Largest chunk that fits one datagram of the given size
+ */
+uint16_t bulk_chunk_size_for_mtu(size_t mtu);
+
+/**
+ * @brief What the sender offers
+ */
+struct BulkOffer {
+    uint32_t transfer_id;
+    uint32_t size;
+    uint16_t chunk_size;
+    uint8_t content_type;               ///< bulk_content_t
+    uint32_t preview_size;              ///< Useful prefix; 0 if none
+
+    uint32_t chunkCount() const {
+        return chunk_size ? (size + chunk_size - 1) / chunk_size : 0;
+    }
+};
+
+/**
+ * @brief True if a datagram is a bulk transfer frame
+ */
+bool bulk_is_frame(const uint8_t* data, size_t length);
+
+/**
+ * @brief Transfer ID of a bulk frame, 0 if it has none
+ */
+uint32_t bulk_frame_transfer_id(const uint8_t* data, size_t length);
+
+/**
+ * @brief True for a NACK, which every receiver in the group should see
+ */
+bool bulk_frame_is_nack(const uint8_t* data, size_t length);
+
+/**
+ * @brief Sending state
+ */
+typedef enum {
+    BULK_SEND_IDLE = 0,
+    BULK_SEND_OFFERING,         ///< Waiting for the receivers to answer the offer
+    BULK_SEND_SENDING,
+    BULK_SEND_COMPLETE,         ///< Every receiver has everything
+    BULK_SEND_FAILED            ///< Rejected, or no feedback for sender_give_up_ms
+} bulk_send_state_t;
+
+typedef struct {
+    uint32_t chunks_sent;
+    uint32_t retransmits;
+    uint32_t bytes_sent;
+    uint32_t acks_received;
+    uint32_t loss_events;           ///< Window or rate reductions after loss
+    uint32_t timeouts;
+} bulk_sender_stats_t;
+
+typedef struct {
+    uint32_t chunks_received;
+    uint32_t duplicates;
+    uint32_t acks_sent;
+    uint32_t nacks_sent;
+    uint32_t nacks_suppressed;      ///< Another receiver asked for the same chunks first
+    uint32_t transfers_completed;
+    uint32_t transfers_rejected;
+} bulk_receiver_stats_t;
+
+typedef std::function<bool(const std::vector<uint8_t>& frame)> BulkSendFunction;
+
+/**
+ * @brief Sends one payload to one receiver
+ */
+class BulkSender {
+public:
+    BulkSender(BulkSendFunction send, const bulk_config_t& config);
+
+    /**
+     * @brief Start (or resume) sending a payload
+     * @param payload Shared so one image can go to several peers at once
+     * @return false if the payload is empty or too large
+     */
+    bool start(uint32_t transferId, std::shared_ptr<const std::vector<uint8_t>> payload,
+               uint8_t contentType, uint32_t previewSize, uint32_t nowMs);
+
+    // ACKs for this transfer; other frames are ignored
+    void handleFrame(const uint8_t* data, size_t length, uint32_t nowMs);
+    void tick(uint32_t nowMs);
+
+    bulk_send_state_t state() const { return m_state; }
+    const BulkOffer& offer() const { return m_offer; }
+    uint32_t ackedBytes() const;         ///< Acknowledged prefix
+    uint32_t congestionWindow() const { return m_cwnd; }
+    uint32_t smoothedRttMs() const { return m_srttMs; }
+    uint32_t retransmitTimeoutMs() const { return m_rtoMs; }
+    const bulk_sender_stats_t& stats() const { return m_stats; }
+
+private:
+    bool sendOffer();
+    bool sendChunk(uint32_t index, uint32_t nowMs);
+    bool acked(uint32_t index) const { return (m_acked[index / 8] >> (index % 8)) & 1; }
+    bool resent(uint32_t index) const { return (m_resent[index / 8] >> (index % 8)) & 1; }
+    void onRttSample(uint32_t rttMs);
+    void onChunkAcked();
+    void onLoss(bool timeout, uint32_t inFlight);
+    void resetRetransmitTimeout();
+
+    BulkSendFunction m_send;
+    bulk_config_t m_config;
+    bulk_send_state_t m_state;
+    BulkOffer m_offer;
+    std::shared_ptr<const std::vector<uint8_t>> m_payload;
+
+    std::vector<uint8_t> m_acked;       // Bitmap
+    std::vector<uint8_t> m_resent;      // Bitmap; no round trip samples from these
+    std::vector<uint32_t> m_sentAtMs;
+    std::vector<uint32_t> m_sendSeq;    // Order of the latest send of each chunk
+    uint32_t m_nextSeq;
+    uint32_t m_highestAckedSeq;         // Anything sent before this and unacked is lost
+    uint32_t m_cumulative;              // All chunks below are acknowledged
+    uint32_t m_nextNew;                 // Lowest chunk never sent
+    uint32_t m_lastAckMs;
+    uint32_t m_nextOfferMs;
+
+    // Congestion control
+    uint32_t m_cwnd;                    // Chunks
+    uint32_t m_ssthresh;
+    uint32_t m_cwndCredit;              // Chunks acknowledged towards the next increase
+    uint32_t m_recoverySeq;             // No further reduction until this send is acknowledged
+    bool m_queueing;                    // Latest round trip shows a standing queue
+
+    // Round trip
+    uint32_t m_srttMs;                  // 0 until the first sample
+    uint32_t m_rttVarMs;
+    uint32_t m_minRttMs;
+    uint32_t m_rtoMs;
+    uint32_t m_rtoDeadlineMs;           // Resend the oldest chunk if no ACK progress by then
+    bool m_heardSinceTimeout;           // Any ACK since the last timeout; if not, back off
+    bulk_sender_stats_t m_stats;
+};
+
+/**
+ * @brief Sends one payload to a group of receivers at once
+ */
+class BulkMulticastSender {
+public:
+    /**
+     * @param send Sends a frame to the whole group
+     */
+    BulkMulticastSender(BulkSendFunction send, const bulk_config_t& config);
+
+    /**
+     * @brief Start sending a payload to the listed receivers
+     * @return false if the payload is empty or too large, or there are no receivers
+     */
+    bool start(uint32_t transferId, std::shared_ptr<const std::vector<uint8_t>> payload,
+               uint8_t contentType, uint32_t previewSize, const std::vector<std::string>& receivers,
+               uint32_t nowMs);
+
+    // ACKs and NACKs from receivers; other frames are ignored
+    void handleFrame(const std::string& peerId, const uint8_t* data, size_t length, uint32_t nowMs);
+    void tick(uint32_t nowMs);
+
+    bulk_send_state_t state() const { return m_state; }
+    const BulkOffer& offer() const { return m_offer; }
+    uint32_t rateKbps() const { return m_rateKbps; }
+
+    // Per receiver progress: contiguous bytes reported, and whether it has everything
+    uint32_t receivedBytes(const std::string& peerId) const;
+    bool receiverComplete(const std::string& peerId) const;
+    std::vector<std::string> incompleteReceivers() const;
+    const bulk_sender_stats_t& stats() const { return m_stats; }
+
+private:
+    struct Receiver {
+        uint32_t cumulative = 0;
+        uint16_t loss = 0;              // Smoothed per mille from its NACKs
+        bool lossReported = false;
+        bool answered = false;
+        bool complete = false;
+        bool rejected = false;
+    };
+
+    bool sendOffer();
+    bool sendChunk(uint32_t index, uint32_t nowMs);
+    void endRound();
+    bool allDone() const;
+
+    BulkSendFunction m_send;
+    bulk_config_t m_config;
+    bulk_send_state_t m_state;
+    BulkOffer m_offer;
+    std::shared_ptr<const std::vector<uint8_t>> m_payload;
+    std::map<std::string, Receiver> m_receivers;
+
+    std::vector<uint8_t> m_repair;      // Bitmap of chunks some receiver asked for
+    std::vector<uint32_t> m_sentAtMs;
+    uint32_t m_repairCount;
+    uint32_t m_nextNew;                 // Chunks below have been sent at least once
+    uint32_t m_txSeq;
+    uint32_t m_rateKbps;
+    int32_t m_budgetBytes;              // Pacing: bytes that may go out now
+    uint32_t m_lastTickMs;
+    uint32_t m_lastPollMs;              // NACKs answer the latest poll
+    uint32_t m_nextPollMs;
+    uint32_t m_offerDeadlineMs;
+    uint32_t m_lastFeedbackMs;
+    static const uint16_t LOSS_FLOOR_UNKNOWN = 0xFFFF;
+    uint16_t m_lossFloor;               // Per mille the group loses anyway; follows the lowest rounds
+    bulk_sender_stats_t m_stats;
+};
+
+/**
+ * @brief Receives payloads from one sender, unicast or multicast
+ */
+class BulkReceiver {
+public:
+    // Called once the preview prefix has arrived, and when the whole payload has
+    typedef std::function<void(const BulkOffer& offer, const uint8_t* data, size_t length)> PreviewCallback;
+    typedef std::function<void(const BulkOffer& offer, std::vector<uint8_t>& payload)> CompleteCallback;
+
+    /**
+     * @param send Sends a frame to the sender
+     * @param seed Randomizes NACK timing
+     */
+    BulkReceiver(BulkSendFunction send, const bulk_config_t& config, uint32_t seed = 1);
+
+    // Sends a frame to the group; needed to take part in multicast transfers
+    void setMulticastSend(BulkSendFunction send) { m_multicastSend = send; }
+    void setPreviewCallback(PreviewCallback callback) { m_onPreview = callback; }
+    void setCompleteCallback(CompleteCallback callback) { m_onComplete = callback; }
+
+    // OFFER, CHUNK and other receivers' NACK frames; other frames are ignored
+    void handleFrame(const uint8_t* data, size_t length, uint32_t nowMs);
+    void tick(uint32_t nowMs);
+
+    // Contiguous bytes received of a transfer in progress (0 if unknown)
+    uint32_t receivedBytes(uint32_t transferId) const;
+    bool active() const { return !m_sessions.empty(); }
+    const bulk_receiver_stats_t& stats() const { return m_stats; }
+
+private:
+    struct Session {
+        BulkOffer offer;
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> have;      // Bitmap
+        uint32_t count;
+        uint32_t cumulative;
+        uint32_t highest;               // One past the highest chunk received
+        uint16_t unacked;
+        bool ackDue;
+        bool previewed;
+        bool multicast;
+        bool previewReportDue;          // Multicast: tell the sender the preview arrived
+        uint32_t sentThrough;           // Multicast: chunks the sender says it has sent
+        uint32_t nackAtMs;              // Multicast: when to send a pending NACK
+        bool nackPending;
+        uint32_t firstUnackedMs;
+        uint32_t lastHeardMs;
+        // Transmission numbers seen since the last NACK, for the loss report
+        uint32_t lossFirstSeq;
+        uint32_t lossLastSeq;
+        uint32_t lossReceived;
+    };
+
+    void handleOffer(const uint8_t* body, size_t length, uint32_t nowMs);
+    void handleChunk(const uint8_t* body, size_t length, uint32_t nowMs);
+    void handleNack(const uint8_t* body, size_t length);
+    void sendAck(uint32_t transferId, Session* session, uint8_t flags);
+    void sendNack(uint32_t transferId, Session* session, uint8_t flags);
+    void scheduleNack(Session* session, uint32_t nowMs);
+    bool has(const Session& session, uint32_t index) const {
+        return (session.have[index / 8] >> (index % 8)) & 1;
+    }
+    bool completed(uint32_t transferId) const;
+    uint32_t nextRandom();
+
+    BulkSendFunction m_send;
+    BulkSendFunction m_multicastSend;
+    bulk_config_t m_config;
+    std::map<uint32_t, Session> m_sessions;
+    std::vector<uint32_t> m_completed;      // Recent transfer IDs, answered as complete
+    std::vector<uint32_t> m_completeAcks;   // Completed transfers to acknowledge on the next tick
+    PreviewCallback m_onPreview;
+    CompleteCallback m_onComplete;
+    uint32_t m_random;
+    bulk_receiver_stats_t m_stats;
+};
+
+#endif // BULK_TRANSFER_H
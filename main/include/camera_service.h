@@ -1,17 +1,158 @@
+/**
+ * @file camera_service.h
+ * @brief Capture images and send them over the mesh, preview first
+ *
+ * Pipeline:
+ *
+ *   capture    the camera writes a baseline JPEG into a PSRAM frame buffer
+ *   re-encode  jpeg_progressive.h rewrites it as a progressive JPEG with
+ *              the same pixels; its first scan is a 1/8 scale preview
+ *   send       through bulk_service.h: one multicast transfer to the whole
+ *              squad, or unicast to one peer; chunks go in order, so the
+ *              preview arrives in the first few KB
+ *
+ * Receivers get the preview prefix as soon as it is complete and the full
+ * image when the transfer ends, through the receive callback. A transfer
+ * interrupted by a link outage resumes from the chunks that arrived.
+ *
+ * The sender measures two latencies per peer from the start of the
+ * capture: until the peer has reported the preview prefix, and until it
+ * has reported the whole image. Both go to the metrics registry
+ * (camera.preview_latency_ms, camera.transfer_time_ms) and to
+ * camera_service_get_stats().
+ *
+ * Image sources: the board camera (XIAO ESP32S3 Sense connector) through
+ * esp32-camera, or any ICameraSource set with camera_service_set_source(),
+ * such as FileCameraSource, which serves a JPEG file and lets host builds
+ * run the pipeline without a sensor. Without a source the service only
+ * receives.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
 #ifndef CAMERA_SERVICE_H
 #define CAMERA_SERVICE_H
 
-// Camera Service - Stub Implementation
-// This is a placeholder for camera functionality
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Task and timing
+#define CAMERA_TASK_STACK_SIZE (6 * 1024)
+#define CAMERA_TASK_PRIORITY 2
+#define CAMERA_TICK_MS 100
+#define CAMERA_EVENT_QUEUE_DEPTH 4
+#define CAMERA_STREAM_INTERVAL_MS 10000     // Between captures while streaming
+#define CAMERA_MAX_PEERS 8                  // Peers an image is sent to at once
+#define CAMERA_PEER_ID_LEN 40
+
+// Sensor settings
+#define CAMERA_XCLK_FREQ_HZ 20000000
+#define CAMERA_JPEG_QUALITY 12              // esp32-camera scale, lower is better
+
+/**
+ * @brief Where captured JPEG frames come from
+ */
+class ICameraSource {
+public:
+    virtual ~ICameraSource() = default;
+
+    virtual bool begin() = 0;
+
+    // Capture one baseline JPEG and pass it to consume() while the frame is held
+    virtual bool capture(const std::function<void(const uint8_t* jpeg, size_t length)>& consume) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+/**
+ * @brief Serves the same JPEG file for every capture
+ */
+class FileCameraSource : public ICameraSource {
+public:
+    explicit FileCameraSource(const std::string& path) : m_path(path) {}
+
+    bool begin() override;
+    bool capture(const std::function<void(const uint8_t* jpeg, size_t length)>& consume) override;
+    const char* name() const override { return "file"; }
+
+private:
+    std::string m_path;
+    std::vector<uint8_t> m_jpeg;
+};
+
+/**
+ * @brief A captured image ready to send
+ */
+struct CameraImage {
+    std::shared_ptr<const std::vector<uint8_t>> jpeg;
+    uint32_t capture_bytes;         ///< Camera output size
+    uint32_t preview_bytes;         ///< Prefix holding the preview scan; 0 if not progressive
+    uint16_t width;
+    uint16_t height;
+    uint32_t capture_us;
+    uint32_t reencode_us;
+};
+
+/**
+ * @brief Camera service counters and latest timings
+ */
+typedef struct {
+    uint32_t captures;
+    uint32_t capture_failures;
+    uint32_t images_sent;           ///< Per peer
+    uint32_t send_failures;
+    uint32_t images_received;
+    uint32_t last_capture_bytes;
+    uint32_t last_image_bytes;      ///< After re-encoding
+    uint32_t last_preview_bytes;
+    uint32_t last_reencode_ms;
+    uint32_t last_preview_latency_ms;
+    uint32_t last_transfer_ms;
+    bool streaming;
+} camera_service_stats_t;
+
+/**
+ * @brief Received images: the preview prefix (complete == false), then the whole image
+ */
+typedef void (*camera_receive_callback_t)(const char* peer_id, const uint8_t* jpeg, size_t length, bool complete);
+
+/**
+ * @brief Capture and re-encode one image
+ * @return false if the capture failed
+ */
+bool camera_service_prepare_image(ICameraSource* source, CameraImage* image);
+
+/**
+ * @brief Use a different image source; call before camera_service_init()
+ */
+void camera_service_set_source(std::unique_ptr<ICameraSource> source);
+
+/**
+ * @brief Set the receive callback
+ */
+void camera_service_set_receive_callback(camera_receive_callback_t callback);
 
 /**
  * @brief Initialize the camera service
+ *
+ * Starts the bulk service and the camera task. The image source (the
+ * board camera unless one was set) is started by the first capture or
+ * stream, off the boot path; without a working source the service still
+ * receives images and further captures fail.
+ *
  * @return 0 on success, error code on failure
  */
 int camera_service_init(void);
 
 /**
- * @brief Start camera streaming
+ * @brief Start camera streaming: capture and send every CAMERA_STREAM_INTERVAL_MS
  * @return 0 on success, error code on failure
  */
 int camera_service_start_stream(void);
@@ -23,9 +164,21 @@ int camera_service_start_stream(void);
 int camera_service_stop_stream(void);
 
 /**
- * @brief Capture a single image
- * @return 0 on success, error code on failure
+ * @brief Capture a single image and send it to every mesh peer
+ * @return 0 if queued, error code on failure
  */
 int camera_service_capture_image(void);
 
-#endif // CAMERA_SERVICE_H
\ No newline at end of file
+/**
+ * @brief Capture a single image and send it to one peer
+ * @return 0 if queued, error code on failure
+ */
+int camera_service_send_image_to(const char* peer_id);
+
+/**
+ * @brief Get camera service statistics
+ * @return false if the service is not running
+ */
+bool camera_service_get_stats(camera_service_stats_t* stats);
+
+#endif // CAMERA_SERVICE_H
@@ -22,32 +22,19 @@
 #define VOICE_PORT 5000
 #define TEXT_PORT 5001
 #define ATAK_PORT 6969
+#define TELEMETRY_PORT 5002
+#define OTA_PORT 5003
+#define BULK_PORT 5004     // Images and other large payloads
+#define OUTBOX_PORT 5005   // Store-and-forward messages
+#define FLOOR_PORT 5006    // Push-to-talk floor control
 
 // =================================================================
-// Hardware Pin Assignments (Example Pins - MUST BE VERIFIED)
+// Hardware
 // =================================================================
-
-// I2C for OLED Display
-#define PIN_OLED_SDA 21
-#define PIN_OLED_SCL 22
-
-// I2S Audio
-#define PIN_I2S_BCLK 26
-#define PIN_I2S_LRC 25
-#define PIN_I2S_DIN 33  // Microphone In
-#define PIN_I2S_DOUT 32 // Speaker Out
-
-// Buttons
-#define PIN_BUTTON_PTT 4
-#define PIN_BUTTON_UP 5
-#define PIN_BUTTON_DOWN 18
-#define PIN_BUTTON_SELECT 19
-#define PIN_BUTTON_BACK 23
+// Pin assignments are per board: Board in board_profile.h
 
 // GPS Module UART
 #define GPS_UART_NUM UART_NUM_1
-#define PIN_GPS_RX 16
-#define PIN_GPS_TX 17
 #define GPS_BAUD_RATE 9600
 
 // =================================================================
@@ -18,7 +18,7 @@
 #include <string>
 #include <map>
 #include <vector>
-#include "xiao_esp32_config.h"
+#include "board_profile.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,21 +28,6 @@ extern "C" {
 // CONFIGURATION DATA TYPES
 // ============================================================================
 
-/**
- * @brief Hardware platform enumeration
- */
-typedef enum {
-    HW_PLATFORM_UNKNOWN = 0,
-    HW_PLATFORM_XIAO_ESP32S3,
-    HW_PLATFORM_XIAO_ESP32C3,
-    HW_PLATFORM_XIAO_ESP32C6,
-    HW_PLATFORM_HELTEC_HT_HC32,
-    HW_PLATFORM_HELTEC_HT_IT01,
-    HW_PLATFORM_HELTEC_GENERIC,
-    HW_PLATFORM_ESP32_GENERIC,
-    HW_PLATFORM_MAX
-} hardware_platform_t;
-
 /**
  * @brief Network configuration
  */
@@ -59,6 +44,8 @@ typedef struct {
     bool enable_encryption;
     std::string encryption_key;
     std::vector<std::string> allowed_peer_ids;
+    std::string fallback_ssid;          // Standard Wi-Fi network used if the HaLow radio fails (empty = same as ssid)
+    std::string fallback_password;
 } network_config_t;
 
 /**
@@ -74,6 +61,7 @@ typedef struct {
     bool enable_compression;
     bool enable_noise_reduction;
     uint32_t ptt_debounce_ms;
+    uint8_t ptt_priority;           // floor_priority_t: 1 normal, 2 leader, 3 emergency
 } audio_config_t;
 
 /**
@@ -146,7 +134,7 @@ typedef struct {
     int pin_led;
     int pin_battery_adc;
 
-    // Wi-Fi HaLow specific pins (from xiao_esp32_config.h)
+    // Wi-Fi HaLow module pins
     int pin_wifihalow_mosi;
     int pin_wifihalow_miso;
     int pin_wifihalow_sclk;
@@ -198,18 +186,20 @@ bool config_manager_reset_to_defaults(void);
 bool config_manager_validate(const aircom_config_t* config);
 
 /**
- * @brief Auto-detect hardware platform
+ * @brief Hardware platform the firmware was built for
  *
- * @return Detected hardware platform
+ * @return Board::platform (board_profile.h)
  */
 hardware_platform_t config_manager_detect_hardware(void);
 
 /**
  * @brief Get default configuration for specific hardware
  *
- * @param platform Hardware platform
+ * Pins and display come from the compiled-in board profile.
+ *
+ * @param platform Hardware platform; must be the one the firmware was built for
  * @param config Output configuration structure
- * @return true on success, false on failure
+ * @return true on success, false for any other platform
  */
 bool config_manager_get_defaults(hardware_platform_t platform, aircom_config_t* config);
 
@@ -222,6 +212,14 @@ bool config_manager_get_defaults(hardware_platform_t platform, aircom_config_t*
  */
 bool config_manager_get_string(const char* key, std::string* value);
 
+/**
+ * @brief Get a copy of the current network configuration
+ *
+ * @param network Output network configuration
+ * @return true on success, false if the configuration manager is not initialized
+ */
+bool config_manager_get_network_config(network_config_t* network);
+
 /**
  * @brief Set configuration value by key
  *
@@ -288,58 +286,6 @@ const char* config_manager_get_platform_name(hardware_platform_t platform);
  */
 bool config_manager_is_platform_supported(hardware_platform_t platform);
 
-// ============================================================================
-// PLATFORM-SPECIFIC CONFIGURATION FUNCTIONS
-// ============================================================================
-
-/**
- * @brief Get XIAO ESP32S3 specific configuration
- *
- * @param config Output configuration
- * @return true on success, false on failure
- */
-bool config_get_xiao_esp32s3_defaults(aircom_config_t* config);
-
-/**
- * @brief Get XIAO ESP32C3 specific configuration
- *
- * @param config Output configuration
- * @return true on success, false on failure
- */
-bool config_get_xiao_esp32c3_defaults(aircom_config_t* config);
-
-/**
- * @brief Get XIAO ESP32C6 specific configuration
- *
- * @param config Output configuration
- * @return true on success, false on failure
- */
-bool config_get_xiao_esp32c6_defaults(aircom_config_t* config);
-
-/**
- * @brief Get Heltec HT-HC32 specific configuration
- *
- * @param config Output configuration
- * @return true on success, false on failure
- */
-bool config_get_heltec_ht_hc32_defaults(aircom_config_t* config);
-
-/**
- * @brief Get Heltec HT-IT01 specific configuration
- *
- * @param config Output configuration
- * @return true on success, false on failure
- */
-bool config_get_heltec_ht_it01_defaults(aircom_config_t* config);
-
-/**
- * @brief Get generic Heltec configuration
- *
- * @param config Output configuration
- * @return true on success, false on failure
- */
-bool config_get_heltec_generic_defaults(aircom_config_t* config);
-
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,22 @@
+#ifndef COT_MESSAGE_H
+#define COT_MESSAGE_H
+
+// ============================================================================
+// CURSOR-ON-TARGET (CoT) MESSAGE HELPERS
+//
+// Building and parsing of the ATAK CoT XML carried in AirComPacket
+// cot_message payloads. Shared by atak_task (sender) and
+// atak_processor_task (receiver).
+// ============================================================================
+
+#include <string>
+#include "gps_task.h"
+
+// Build the CoT XML position report for this node from a GPS fix
+std::string generateCoT(const GPSData& gpsData);
+
+// Extract an attribute value from CoT XML. key includes the opening quote,
+// e.g. "lat=\"". Returns an empty string if the key is missing.
+std::string parse_cot_value(const std::string& cot, const char* key);
+
+#endif // COT_MESSAGE_H
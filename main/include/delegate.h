@@ -0,0 +1,316 @@
+/**
+ * @file delegate.h
+ * @brief Typed delegates and generation-counted listener tables
+ *
+ * A Delegate is a function pointer plus a context pointer. Binding a member
+ * function generates a tiny stub at compile time, so calling one is a
+ * single indirect call with no heap allocation and no exceptions.
+ *
+ * DelegateTable stores a fixed number of delegates in slots. Registration
+ * claims a free slot from an atomic bitmap in O(1) and returns a handle that
+ * carries the slot generation. Removing a delegate bumps the generation, so
+ * stale handles are rejected instead of calling into a destroyed object.
+ * Dispatch never takes a lock: each slot is read with a seqlock-style
+ * tag check and retried only if it changed underneath the reader.
+ *
+ * That check is not free. Reading a slot costs a tag load before and after
+ * the delegate fields, and an acquire fence on weakly ordered cores. On the
+ * host a dispatch through a table costs about the same as the
+ * SafeCallback chain it replaced; the gain is no heap allocation and no
+ * std::function, not speed. aircom_bench measures both
+ * (delegate/dispatch/*).
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef DELEGATE_H
+#define DELEGATE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+template<typename Signature>
+class Delegate;
+
+/**
+ * @brief Function pointer plus context, bound at compile time
+ */
+template<typename R, typename... Args>
+class Delegate<R(Args...)> {
+public:
+    using Stub = R (*)(void*, Args...);
+
+    constexpr Delegate() : m_context(nullptr), m_stub(nullptr) {}
+    constexpr Delegate(Stub stub, void* context) : m_context(context), m_stub(stub) {}
+
+    /**
+     * @brief Bind a free function
+     */
+    template<R (*Function)(Args...)>
+    static constexpr Delegate fromFunction() {
+        return Delegate(&functionStub<Function>, nullptr);
+    }
+
+    /**
+     * @brief Bind a member function to an object instance
+     */
+    template<typename T, R (T::*Method)(Args...)>
+    static constexpr Delegate fromMethod(T* instance) {
+        return Delegate(&methodStub<T, Method>, instance);
+    }
+
+    /**
+     * @brief Bind a const member function to an object instance
+     */
+    template<typename T, R (T::*Method)(Args...) const>
+    static constexpr Delegate fromMethod(const T* instance) {
+        return Delegate(&constMethodStub<T, Method>, const_cast<T*>(instance));
+    }
+
+    /**
+     * @brief Check if a target is bound
+     */
+    constexpr bool isSet() const { return m_stub != nullptr; }
+    constexpr explicit operator bool() const { return isSet(); }
+
+    R operator()(Args... args) const {
+        return m_stub(m_context, std::forward<Args>(args)...);
+    }
+
+    Stub stub() const { return m_stub; }
+    void* context() const { return m_context; }
+
+    constexpr bool operator==(const Delegate& other) const {
+        return m_stub == other.m_stub && m_context == other.m_context;
+    }
+
+private:
+    template<R (*Function)(Args...)>
+    static R functionStub(void*, Args... args) {
+        return Function(std::forward<Args>(args)...);
+    }
+
+    template<typename T, R (T::*Method)(Args...)>
+    static R methodStub(void* context, Args... args) {
+        return (static_cast<T*>(context)->*Method)(std::forward<Args>(args)...);
+    }
+
+    template<typename T, R (T::*Method)(Args...) const>
+    static R constMethodStub(void* context, Args... args) {
+        return (static_cast<const T*>(context)->*Method)(std::forward<Args>(args)...);
+    }
+
+    void* m_context;
+    Stub m_stub;
+};
+
+/**
+ * @brief Handle to a registered delegate: slot index plus slot generation
+ *
+ * A zero value is never issued and means "no registration".
+ */
+struct DelegateHandle {
+    uint32_t value;
+
+    constexpr DelegateHandle() : value(0) {}
+    constexpr explicit DelegateHandle(uint32_t raw) : value(raw) {}
+
+    constexpr bool isValid() const { return value != 0; }
+    constexpr uint32_t index() const { return value & 0xFFFFu; }
+    constexpr uint32_t generation() const { return value >> 16; }
+
+    static constexpr DelegateHandle make(uint32_t index, uint32_t generation) {
+        return DelegateHandle(((generation & 0xFFFFu) << 16) | (index & 0xFFFFu));
+    }
+};
+
+/**
+ * @brief Fixed-capacity table of delegates with O(1) registration and lock-free dispatch
+ *
+ * @tparam Signature Delegate signature, e.g. void(const std::string&, bool)
+ * @tparam Capacity  Number of slots (1-32)
+ */
+template<typename Signature, size_t Capacity>
+class DelegateTable;
+
+template<typename R, typename... Args, size_t Capacity>
+class DelegateTable<R(Args...), Capacity> {
+    static_assert(Capacity > 0 && Capacity <= 32, "DelegateTable supports 1-32 slots");
+
+public:
+    using DelegateType = Delegate<R(Args...)>;
+
+    DelegateTable()
+        : m_freeMask(Capacity == 32 ? 0xFFFFFFFFu : ((1u << Capacity) - 1u)) {
+        for (size_t i = 0; i < Capacity; ++i) {
+            m_slots[i].tag.store(0, std::memory_order_relaxed);
+            m_slots[i].context.store(nullptr, std::memory_order_relaxed);
+            m_slots[i].stub.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    DelegateTable(const DelegateTable&) = delete;
+    DelegateTable& operator=(const DelegateTable&) = delete;
+
+    /**
+     * @brief Register a delegate
+     * @param delegate Bound delegate
+     * @return Handle for later removal, or an invalid handle if the table is full
+     */
+    DelegateHandle add(const DelegateType& delegate) {
+        if (!delegate.isSet()) {
+            return DelegateHandle();
+        }
+
+        uint32_t mask = m_freeMask.load(std::memory_order_relaxed);
+        uint32_t index;
+        do {
+            if (mask == 0) {
+                return DelegateHandle();
+            }
+            index = static_cast<uint32_t>(__builtin_ctz(mask));
+        } while (!m_freeMask.compare_exchange_weak(mask, mask & ~(1u << index),
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_relaxed));
+
+        Slot& slot = m_slots[index];
+        // Generation lives in the upper bits of the tag; bit 0 marks a live slot.
+        // Generation 0 is skipped so that a handle value of 0 is never issued.
+        uint32_t generation = ((slot.tag.load(std::memory_order_relaxed) >> 1) + 1) & 0xFFFFu;
+        if (generation == 0) {
+            generation = 1;
+        }
+
+        slot.context.store(delegate.context(), std::memory_order_relaxed);
+        slot.stub.store(delegate.stub(), std::memory_order_relaxed);
+        slot.tag.store((generation << 1) | 1u, std::memory_order_release);
+
+        return DelegateHandle::make(index, generation);
+    }
+
+    /**
+     * @brief Remove a delegate; stale or foreign handles are ignored
+     *
+     * Does not wait for a dispatch that is already running on another core.
+     *
+     * @return true if the handle referred to a live registration
+     */
+    bool remove(DelegateHandle handle) {
+        if (!handle.isValid() || handle.index() >= Capacity) {
+            return false;
+        }
+
+        Slot& slot = m_slots[handle.index()];
+        uint32_t expected = (handle.generation() << 1) | 1u;
+        if (!slot.tag.compare_exchange_strong(expected, handle.generation() << 1,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_relaxed)) {
+            return false;
+        }
+
+        m_freeMask.fetch_or(1u << handle.index(), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Check if a handle still refers to a live registration
+     */
+    bool contains(DelegateHandle handle) const {
+        if (!handle.isValid() || handle.index() >= Capacity) {
+            return false;
+        }
+        return m_slots[handle.index()].tag.load(std::memory_order_acquire) ==
+               ((handle.generation() << 1) | 1u);
+    }
+
+    /**
+     * @brief Invoke a single registered delegate
+     * @return true if the handle was live and the delegate was called
+     */
+    bool invoke(DelegateHandle handle, Args... args) const {
+        if (!handle.isValid() || handle.index() >= Capacity) {
+            return false;
+        }
+
+        DelegateType target;
+        uint32_t tag = 0;
+        if (!snapshot(m_slots[handle.index()], &target, &tag) ||
+            tag != ((handle.generation() << 1) | 1u)) {
+            return false;
+        }
+
+        target(args...);
+        return true;
+    }
+
+    /**
+     * @brief Invoke every registered delegate in slot order
+     * @return Number of delegates called
+     */
+    size_t invokeAll(Args... args) const {
+        // Only claimed slots can be live; a slot claimed but not yet
+        // published fails the snapshot and is skipped
+        uint32_t used = ~m_freeMask.load(std::memory_order_acquire);
+        if (Capacity < 32) {
+            used &= (1u << Capacity) - 1u;
+        }
+        size_t called = 0;
+        while (used != 0) {
+            uint32_t i = static_cast<uint32_t>(__builtin_ctz(used));
+            used &= used - 1u;
+            DelegateType target;
+            uint32_t tag = 0;
+            if (snapshot(m_slots[i], &target, &tag)) {
+                target(args...);
+                ++called;
+            }
+        }
+        return called;
+    }
+
+    /**
+     * @brief Number of live registrations
+     */
+    size_t size() const {
+        uint32_t used = ~m_freeMask.load(std::memory_order_relaxed);
+        if (Capacity < 32) {
+            used &= (1u << Capacity) - 1u;
+        }
+        return static_cast<size_t>(__builtin_popcount(used));
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> tag;
+        std::atomic<void*> context;
+        std::atomic<typename DelegateType::Stub> stub;
+    };
+
+    // Seqlock-style read: the tag must be live and unchanged across the load of
+    // the delegate fields, otherwise the slot was recycled and we retry.
+    static bool snapshot(const Slot& slot, DelegateType* out, uint32_t* tag) {
+        for (;;) {
+            uint32_t before = slot.tag.load(std::memory_order_acquire);
+            if ((before & 1u) == 0) {
+                return false;
+            }
+            void* context = slot.context.load(std::memory_order_relaxed);
+            typename DelegateType::Stub stub = slot.stub.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.tag.load(std::memory_order_relaxed) == before) {
+                *out = DelegateType(stub, context);
+                *tag = before;
+                return true;
+            }
+        }
+    }
+
+    Slot m_slots[Capacity];
+    std::atomic<uint32_t> m_freeMask;
+};
+
+#endif // DELEGATE_H
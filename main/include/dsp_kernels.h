@@ -0,0 +1,131 @@
+/**
+ * @file dsp_kernels.h
+ * @brief Audio DSP kernels: dot product, FIR, biquad, saturating add, gain, int16/float conversion
+ *
+ * Each kernel is defined by its reference implementation (dsp_kernel_sets()
+ * entry 0). Every other implementation gives the same output bit for bit:
+ * the integer kernels round and saturate the same way and the dot product
+ * is exact, so the order of summation does not matter.
+ *
+ * The implementation is fixed at compile time by the target:
+ *
+ * - ESP32-S3: PIE 128-bit vector instructions for the dot product, the
+ *   FIR and the saturating add; the rest is scalar on the FPU
+ * - ESP32-C3/C6 and ESP32: the unrolled scalar set. The C3 and C6 have
+ *   no FPU, so the float conversions are software float there; keep audio
+ *   in int16 on them
+ * - Hosts: SSE2 on x86-64, NEON on AArch64
+ *
+ * PIE only loads aligned 16-byte vectors. The S3 kernels run vectors while
+ * every pointer is 16-byte aligned and do the rest, or everything, scalar.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DSP_GAIN_SHIFT 12
+#define DSP_GAIN_UNITY (1 << DSP_GAIN_SHIFT)   // Q12: gain 1.0; int16 reaches just under 8.0
+#define DSP_FIR_SHIFT 15                        // FIR taps are Q15
+#define DSP_BIQUAD_SHIFT 14                     // Biquad coefficients are Q14, in [-2, 2)
+#define DSP_FIR_PHASES 8                        // int16 lanes per 128-bit vector
+
+/**
+ * @brief FIR filter state
+ *
+ * The taps are kept reversed, DSP_FIR_PHASES times, each copy shifted one
+ * more sample and zero padded to a multiple of DSP_FIR_PHASES. Output k
+ * then reads the history from the aligned index k & ~7 with copy k & 7,
+ * so every load is aligned.
+ */
+typedef struct {
+    int16_t* coeffs;        // DSP_FIR_PHASES copies of span taps, 16-byte aligned
+    int16_t* history;       // taps - 1 past samples, then the block; 16-byte aligned
+    int16_t* raw;           // The allocation both point into
+    size_t taps;
+    size_t span;            // Padded length of one copy
+    size_t maxBlock;
+} dsp_fir_s16_t;
+
+// Biquad, direct form I; a0 is normalised to 1
+typedef struct {
+    int16_t b0, b1, b2, a1, a2;     // Q14
+    int16_t x1, x2, y1, y2;
+} dsp_biquad_s16_t;
+
+/**
+ * @brief One implementation of the kernels
+ *
+ * The dsp_* functions below call the build's implementation directly;
+ * this table is for checking and benchmarking them against each other.
+ */
+typedef struct {
+    const char* name;
+    int64_t (*dot_s16)(const int16_t* a, const int16_t* b, size_t n);
+    void (*fir_s16)(dsp_fir_s16_t* fir, const int16_t* in, int16_t* out, size_t n);
+    void (*add_sat_s16)(const int16_t* a, const int16_t* b, int16_t* out, size_t n);
+    void (*gain_s16)(const int16_t* in, int16_t* out, size_t n, int16_t gain);
+    void (*s16_to_f32)(const int16_t* in, float* out, size_t n);
+    void (*f32_to_s16)(const float* in, int16_t* out, size_t n);
+} dsp_kernel_set_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// sum(a[i] * b[i]), exact
+int64_t dsp_dot_s16(const int16_t* a, const int16_t* b, size_t n);
+
+/**
+ * @brief Set up a FIR filter with zeroed history
+ * @param coeffs Q15 taps, coeffs[0] applied to the newest sample
+ * @param maxBlock Most samples one dsp_fir_s16() call may take
+ * @return false if taps is 0 or out of memory
+ */
+bool dsp_fir_s16_init(dsp_fir_s16_t* fir, const int16_t* coeffs, size_t taps, size_t maxBlock);
+void dsp_fir_s16_free(dsp_fir_s16_t* fir);
+
+// out[k] = sat((sum coeffs[i] * x[k - i] + 2^14) >> 15); n <= maxBlock, in and out may be the same
+void dsp_fir_s16(dsp_fir_s16_t* fir, const int16_t* in, int16_t* out, size_t n);
+
+// Coefficients are converted to Q14 and clamped to [-2, 2); the history is cleared
+void dsp_biquad_s16_set(dsp_biquad_s16_t* bq, float b0, float b1, float b2, float a1, float a2);
+void dsp_biquad_s16_highpass(dsp_biquad_s16_t* bq, float cutoffHz, float sampleRate, float q);
+void dsp_biquad_s16_lowpass(dsp_biquad_s16_t* bq, float cutoffHz, float sampleRate, float q);
+
+/**
+ * @brief y = sat((b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2 + 2^13) >> 14)
+ *
+ * Recursive, so there is one implementation on every target.
+ */
+void dsp_biquad_s16(dsp_biquad_s16_t* bq, const int16_t* in, int16_t* out, size_t n);
+
+// out = sat(a + b)
+void dsp_add_sat_s16(const int16_t* a, const int16_t* b, int16_t* out, size_t n);
+
+// out = sat((in * gain + 2^11) >> 12); gain is Q12, DSP_GAIN_UNITY is 1.0
+void dsp_gain_s16(const int16_t* in, int16_t* out, size_t n, int16_t gain);
+
+// out = in / 32768
+void dsp_s16_to_f32(const int16_t* in, float* out, size_t n);
+
+// out = sat(in * 32768) rounded to nearest, ties to even; NaN gives an unspecified sample
+void dsp_f32_to_s16(const float* in, int16_t* out, size_t n);
+
+// Name of the implementation the dsp_* functions use
+const char* dsp_kernels_impl(void);
+
+// Every implementation in this build, the reference first and the one in use last
+size_t dsp_kernel_sets(const dsp_kernel_set_t** sets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DSP_KERNELS_H
@@ -0,0 +1,192 @@
+/**
+ * @file event_executor.h
+ * @brief Deferred event executor for radio and SDK callbacks
+ *
+ * SDK callbacks run on the radio driver's thread and must return quickly.
+ * Instead of doing work inline they post a DeferredEvent to the executor,
+ * which holds one bounded queue per priority level and drains them from a
+ * small pool of worker tasks, always taking the highest non-empty priority
+ * first. Posting never blocks: when a queue is full the event is dropped,
+ * its payload released and the drop counted.
+ *
+ * Ordering: events of the same priority are dequeued in FIFO order. With
+ * more than one worker, two events of the same priority may run at the
+ * same time, so handlers must protect their own shared state.
+ *
+ * An executor started with no workers only queues; its owner runs the
+ * events with runPending(). Host tools and tests, which never start the
+ * FreeRTOS scheduler, use it that way.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef EVENT_EXECUTOR_H
+#define EVENT_EXECUTOR_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdint.h>
+#include "delegate.h"
+
+/**
+ * @brief Event priority levels, highest first
+ */
+typedef enum {
+    EVENT_PRIORITY_HIGH = 0,    ///< Link state changes
+    EVENT_PRIORITY_NORMAL,      ///< Received data
+    EVENT_PRIORITY_LOW,         ///< Discovery and housekeeping
+    EVENT_PRIORITY_COUNT
+} event_priority_t;
+
+/**
+ * @brief Handler for a deferred event; receives the posted argument
+ */
+using EventHandler = Delegate<void(void*)>;
+
+/**
+ * @brief Releases an event argument after the handler ran or the event was dropped
+ */
+typedef void (*event_release_fn_t)(void* arg);
+
+/**
+ * @brief Queued event
+ */
+typedef struct {
+    EventHandler handler;           ///< Handler to run on a worker task
+    void* arg;                      ///< Handler argument (owned by the event)
+    event_release_fn_t release;     ///< Releases arg; may be NULL
+    int64_t enqueued_us;            ///< Enqueue timestamp for delay measurement
+} deferred_event_t;
+
+/**
+ * @brief Executor configuration
+ */
+typedef struct {
+    uint8_t worker_count;                           ///< Number of worker tasks (0: runPending() only)
+    uint16_t queue_depth[EVENT_PRIORITY_COUNT];     ///< Queue depth per priority
+    uint32_t worker_stack_size;                     ///< Worker stack size in bytes
+    UBaseType_t worker_priority;                    ///< FreeRTOS priority of workers
+    BaseType_t worker_core;                         ///< Core affinity (tskNO_AFFINITY for any)
+} event_executor_config_t;
+
+/**
+ * @brief Per-priority statistics
+ */
+typedef struct {
+    uint32_t posted;                ///< Events accepted into the queue
+    uint32_t dropped;               ///< Events rejected because the queue was full
+    uint32_t executed;              ///< Events whose handler ran
+    uint32_t queue_high_water;      ///< Highest observed queue fill level
+    uint32_t avg_delay_us;          ///< Mean enqueue-to-dispatch delay
+    uint32_t max_delay_us;          ///< Worst enqueue-to-dispatch delay
+} event_executor_stats_t;
+
+class EventExecutor {
+public:
+    // Maximum number of worker tasks
+    static constexpr uint8_t MAX_WORKERS = 4;
+
+    // Singleton access method
+    static EventExecutor& getInstance() {
+        static EventExecutor instance;
+        return instance;
+    }
+
+    // Deleted copy constructor and assignment operator for singleton
+    EventExecutor(const EventExecutor&) = delete;
+    void operator=(const EventExecutor&) = delete;
+
+    /**
+     * @brief Get the default configuration
+     */
+    static event_executor_config_t defaultConfig();
+
+    /**
+     * @brief Create the queues and start the worker pool
+     * @return true on success or if already running
+     */
+    bool start(const event_executor_config_t& config = defaultConfig());
+
+    /**
+     * @brief Stop the workers and release any events still queued
+     *
+     * Waits for running handlers and concurrent post() calls to finish
+     * before the queues are deleted, so it must not be called from a handler.
+     */
+    void stop();
+
+    /**
+     * @brief Check if the executor accepts events
+     */
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Post an event without blocking
+     *
+     * On failure (executor stopped or queue full) the argument is released
+     * immediately and the caller keeps no ownership.
+     *
+     * @return true if the event was queued
+     */
+    bool post(event_priority_t priority, const EventHandler& handler,
+              void* arg = nullptr, event_release_fn_t release = nullptr);
+
+    /**
+     * @brief Run queued events on the calling task, highest priority first
+     *
+     * Returns when the queues are empty or the executor stops.
+     *
+     * @return Number of events run
+     */
+    size_t runPending();
+
+    /**
+     * @brief Get statistics for one priority level
+     */
+    event_executor_stats_t getStats(event_priority_t priority) const;
+
+    /**
+     * @brief Reset all statistics
+     */
+    void resetStats();
+
+    /**
+     * @brief Log statistics for all priority levels
+     */
+    void logStats() const;
+
+private:
+    EventExecutor();
+    ~EventExecutor();
+
+    struct PriorityStats {
+        std::atomic<uint32_t> posted;
+        std::atomic<uint32_t> dropped;
+        std::atomic<uint32_t> executed;
+        std::atomic<uint32_t> queueHighWater;
+        std::atomic<uint64_t> totalDelayUs;
+        std::atomic<uint32_t> maxDelayUs;
+    };
+
+    static void workerTask(void* pvParameters);
+    bool enqueue(event_priority_t priority, const deferred_event_t& event);
+    bool runNext();
+    void dispatch(event_priority_t priority, deferred_event_t& event);
+    static void releaseEvent(deferred_event_t& event);
+
+    event_executor_config_t m_config;
+    QueueHandle_t m_queues[EVENT_PRIORITY_COUNT];
+    SemaphoreHandle_t m_pending;    ///< Counts queued events across all priorities
+    TaskHandle_t m_workers[MAX_WORKERS];
+    std::atomic<bool> m_running;
+    std::atomic<uint8_t> m_activeWorkers;
+    std::atomic<uint32_t> m_inFlight;   ///< post() and runPending() calls using the queues
+    PriorityStats m_stats[EVENT_PRIORITY_COUNT];
+};
+
+#endif // EVENT_EXECUTOR_H
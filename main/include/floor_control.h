@@ -0,0 +1,222 @@
+/**
+ * @file floor_control.h
+ * @brief Distributed push-to-talk floor control for half-duplex voice
+ *
+ * Only one node of a talkgroup talks at a time. There is no arbiter: the
+ * node that holds the floor answers for it, and the floor passes from
+ * holder to holder. The protocol follows off-network MCPTT floor control:
+ *
+ * - A node wanting to talk sends REQUEST and waits request_timeout_ms for
+ *   an answer, request_attempts times. If nobody answers, the floor is
+ *   free: it takes it, announces TAKEN and starts the transmitter.
+ * - The holder repeats TAKEN every taken_interval_ms while it talks; this
+ *   is what other nodes show as "talker busy". Without it for
+ *   idle_timeout_ms the floor is free again.
+ * - A REQUEST reaching the holder is queued, ordered by priority and then
+ *   arrival, and answered with QUEUED and the requester's position. When
+ *   the holder lets go it sends GRANT to the head of the queue with the
+ *   rest of the queue attached, so the queue moves with the floor. An
+ *   empty queue gives RELEASE.
+ * - A REQUEST of higher priority than the holder's (a leader's) takes the
+ *   floor at once: the holder stops talking and grants it the floor. If
+ *   its PTT is still pressed it queues itself to get the floor back.
+ * - Two nodes requesting a free floor at once hear each other's REQUEST;
+ *   the lower priority, then the lower random token, backs off and
+ *   requests again once the other announces TAKEN. Two nodes that both
+ *   took the floor (their requests were lost) settle it the same way on
+ *   the first TAKEN they hear from each other.
+ *
+ * PTT pressed while the floor is busy queues the request, and the request
+ * stays queued if PTT is released before the grant arrives. The granted
+ * node then holds the floor for grant_accept_ms for its user to press PTT
+ * again before passing it on. A press on a free floor that is released
+ * before the floor is won is dropped.
+ *
+ * Frames are sent to the whole talkgroup. The class holds protocol state
+ * only; it takes the time as an argument, does no I/O except through the
+ * send and talk functions and is not thread safe, so the host simulation
+ * can run many nodes in one process.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef FLOOR_CONTROL_H
+#define FLOOR_CONTROL_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLOOR_NODE_ID_LEN 40                // Including the terminator
+#define FLOOR_MAX_QUEUE 8                   // Requests queued behind the holder
+
+/**
+ * @brief Talk priority; a higher one takes the floor from a lower one
+ */
+typedef enum {
+    FLOOR_PRIORITY_NORMAL = 1,
+    FLOOR_PRIORITY_LEADER = 2,
+    FLOOR_PRIORITY_EMERGENCY = 3
+} floor_priority_t;
+
+/**
+ * @brief Floor state as this node sees it
+ */
+typedef enum {
+    FLOOR_STATE_IDLE = 0,                   ///< Nobody talking
+    FLOOR_STATE_BUSY,                       ///< Another node talking
+    FLOOR_STATE_REQUESTING,                 ///< Waiting for an answer to REQUEST
+    FLOOR_STATE_QUEUED,                     ///< Request waiting for the talker, or for its turn to ask
+    FLOOR_STATE_GRANTED,                    ///< Floor held, waiting for PTT
+    FLOOR_STATE_TALKING
+} floor_state_t;
+
+/**
+ * @brief Floor control timing
+ */
+typedef struct {
+    uint32_t request_timeout_ms;            ///< Wait for an answer to a REQUEST
+    uint8_t request_attempts;               ///< REQUESTs before taking a silent floor
+    uint32_t taken_interval_ms;             ///< TAKEN repeats while talking
+    uint32_t idle_timeout_ms;               ///< Silence after which a holder counts as gone
+    uint32_t grant_accept_ms;               ///< Granted floor held for the user to press PTT
+    uint32_t max_talk_ms;                   ///< Longest turn; the floor is released after it
+    uint32_t queue_slot_ms;                 ///< Backoff per queue position when the holder is lost
+} floor_config_t;
+
+/**
+ * @brief Floor control counters
+ */
+typedef struct {
+    uint32_t requests;                      ///< REQUEST frames sent, including repeats
+    uint32_t turns;                         ///< Times this node started talking
+    uint32_t queued;                        ///< Requests that had to wait
+    uint32_t preempted;                     ///< Turns cut short by a higher priority
+    uint32_t contentions_lost;              ///< Backed off from a simultaneous request
+    uint32_t double_holds;                  ///< Found another node also holding the floor
+    uint32_t holder_timeouts;               ///< Talkers that went silent without a release
+    uint32_t talk_timeouts;                 ///< Own turns ended by max_talk_ms
+    uint32_t frames_sent;
+    uint32_t frames_received;
+} floor_stats_t;
+
+/**
+ * @brief Default timing for a HaLow mesh
+ */
+floor_config_t floor_default_config(void);
+
+class FloorControl {
+public:
+    // Send one frame to every member of the talkgroup
+    typedef std::function<bool(const std::vector<uint8_t>& frame)> SendFunction;
+    // Start or stop the voice transmitter
+    typedef std::function<void(bool talk)> TalkFunction;
+
+    /**
+     * @param nodeId Unique name of this node, at most FLOOR_NODE_ID_LEN - 1 bytes
+     * @param seed   Random seed for request tokens and backoff
+     */
+    FloorControl(const std::string& nodeId, uint8_t priority, SendFunction send, TalkFunction talk,
+                 const floor_config_t& config, uint32_t seed);
+
+    // The talkgroup the floor belongs to. Changing it gives up the old floor.
+    void setGroup(uint8_t group, uint32_t nowMs);
+    void setPriority(uint8_t priority) { m_priority = priority; }
+
+    void pttDown(uint32_t nowMs);
+    void pttUp(uint32_t nowMs);
+
+    // Feed a floor frame from another node
+    void handleFrame(const uint8_t* data, size_t length, uint32_t nowMs);
+
+    // Repeats, timeouts and backoff. Call every 10 - 50 ms.
+    void tick(uint32_t nowMs);
+
+    floor_state_t state() const { return m_state; }
+    uint8_t group() const { return m_group; }
+    const std::string& talker() const { return m_talker; }  // Empty unless another node talks
+    uint8_t queuePosition() const { return m_queuePosition; } // 1 is next; 0 if unknown
+    size_t queueLength() const { return m_queue.size(); }   // Requests behind this node's turn
+    const floor_stats_t& stats() const { return m_stats; }
+
+    // True if the data is a floor frame (cheap check for routing)
+    static bool isFloorFrame(const uint8_t* data, size_t length);
+
+private:
+    struct Request {
+        std::string nodeId;
+        uint8_t priority = 0;
+        uint32_t token = 0;
+    };
+
+    struct Frame {
+        uint8_t type = 0;
+        uint8_t group = 0;
+        uint8_t priority = 0;
+        uint8_t position = 0;
+        uint32_t token = 0;
+        std::string sender;
+        std::string target;
+        std::vector<Request> queue;
+    };
+
+    bool send(uint8_t type, const std::string& target, uint8_t position, const std::vector<Request>* queue);
+    static bool decode(const uint8_t* data, size_t length, Frame* frame);
+    uint32_t nextRandom();
+
+    void beginRequest(uint32_t nowMs);
+    void sendRequest(uint32_t nowMs);
+    void requestTimedOut(uint32_t nowMs);
+    void startTalking(uint32_t nowMs);
+    void holdGranted(uint32_t nowMs);
+    void passFloor(uint32_t nowMs);
+    uint8_t enqueue(const Request& request, bool front);
+    void setTalker(const std::string& nodeId, uint8_t priority, uint32_t nowMs);
+    void queuedAt(uint8_t position);
+    void floorFree(uint32_t nowMs);
+    bool outranks(uint8_t priority, uint32_t token, const std::string& nodeId) const;
+
+    void onRequest(const Frame& frame, uint32_t nowMs);
+    void onTaken(const Frame& frame, uint32_t nowMs);
+    void onQueued(const Frame& frame, uint32_t nowMs);
+    void onGrant(const Frame& frame, uint32_t nowMs);
+    void onRelease(const Frame& frame, uint32_t nowMs);
+
+    std::string m_nodeId;
+    uint8_t m_priority;
+    SendFunction m_send;
+    TalkFunction m_talk;
+    floor_config_t m_config;
+    uint32_t m_random;
+
+    uint8_t m_group = 0;
+    floor_state_t m_state = FLOOR_STATE_IDLE;
+    bool m_pttDown = false;
+    bool m_wantFloor = false;               // A request is pending
+    bool m_keepRequest = false;             // The request outlives PTT release (it had to wait)
+    bool m_floorBusy = false;               // Another node holds the floor: never take it unasked
+    uint32_t m_token = 0;                   // Of the pending request
+    uint8_t m_attempts = 0;
+    uint32_t m_deadlineMs = 0;              // Next REQUEST, TAKEN or GRANT repeat
+    uint32_t m_requestAtMs = 0;             // Backoff: request at this time; 0 if none
+    bool m_requestOnTaken = false;          // Lost a contention: ask the winner once it talks
+
+    std::string m_talker;
+    uint8_t m_talkerPriority = 0;
+    uint32_t m_talkerHeardMs = 0;
+    uint8_t m_queuePosition = 0;
+
+    std::vector<Request> m_queue;           // Held by the floor holder
+    uint32_t m_turnStartMs = 0;
+    std::string m_grantTo;                  // GRANT sent, not yet confirmed by TAKEN
+    std::vector<Request> m_grantQueue;      // Sent with it
+    uint8_t m_grantAttempts = 0;
+
+    floor_stats_t m_stats = {};
+};
+
+#endif // FLOOR_CONTROL_H
@@ -0,0 +1,72 @@
+/**
+ * @file floor_service.h
+ * @brief Push-to-talk floor control on FLOOR_PORT
+ *
+ * One task drives the node's FloorControl (floor_control.h) for the TX
+ * talkgroup. The UI hands PTT presses and releases to it instead of
+ * keying the transmitter itself; the task starts and stops transmission
+ * through the audio command queue when the floor is won and given up.
+ * Floor frames travel as talkgroup frames of kind TALKGROUP_KIND_FLOOR,
+ * so they reach the members of the group only and are dropped by the
+ * talkgroup filter everywhere else.
+ *
+ * The floor control starts once the radio has an address. Until then
+ * floor_service_ptt() returns false and the caller keys the transmitter
+ * directly, as before.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef FLOOR_SERVICE_H
+#define FLOOR_SERVICE_H
+
+#include "floor_control.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Task and timing
+#define FLOOR_SERVICE_TASK_STACK_SIZE (4 * 1024)
+#define FLOOR_SERVICE_TASK_PRIORITY 4       // Above the UI: PTT latency is felt
+#define FLOOR_SERVICE_TICK_MS 10
+#define FLOOR_SERVICE_EVENT_QUEUE_DEPTH 16
+
+/**
+ * @brief What the UI shows about the floor
+ */
+typedef struct {
+    floor_state_t state;
+    uint8_t group;
+    uint8_t queue_position;                 ///< 1 is next; 0 if not queued or unknown
+    char talker[FLOOR_NODE_ID_LEN];         ///< Node talking, empty if none or this node
+} floor_status_t;
+
+/**
+ * @brief Initialize the floor service: hook into the mesh manager and start the task
+ *
+ * Call after talkgroup_init().
+ *
+ * @return 0 on success, error code on failure
+ */
+int floor_service_init(void);
+
+/**
+ * @brief Hand a PTT press or release to the floor control
+ * @return false if floor control is not running; the caller keys the transmitter itself
+ */
+bool floor_service_ptt(bool pressed);
+
+/**
+ * @brief Current floor state for the UI; lock-protected copy
+ * @return false if floor control is not running
+ */
+bool floor_service_get_status(floor_status_t* status);
+
+/**
+ * @brief Floor counters
+ * @return false if floor control is not running
+ */
+bool floor_service_get_stats(floor_stats_t* stats);
+
+#endif // FLOOR_SERVICE_H
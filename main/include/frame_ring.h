@@ -0,0 +1,67 @@
+/**
+ * @file frame_ring.h
+ * @brief Lock-free single-producer single-consumer ring of variable-size frames
+ *
+ * Hands frames from a real-time task to a slower one without a lock: the
+ * producer only writes the head index, the consumer only the tail, and
+ * each publishes with a release store that the other reads with acquire.
+ * A push that does not fit fails at once instead of waiting, so the
+ * producer never blocks on the consumer. Exactly one task may push and
+ * exactly one may pop.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_RING_MAX_FRAME 0xFFFF         // Frames carry a 16 bit length
+
+class FrameRing {
+public:
+    // Capacity in bytes, rounded up to a power of two; each frame takes two more
+    explicit FrameRing(size_t capacity);
+    ~FrameRing();
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    // False if the buffer could not be allocated
+    bool valid() const { return m_buffer != nullptr; }
+
+    /**
+     * @brief Producer: append one frame made of a head and a body, either may be empty
+     * @return false if it does not fit now; nothing is written
+     */
+    bool push(const void* head, size_t headLength, const void* body, size_t bodyLength);
+
+    /**
+     * @brief Consumer: take the oldest frame
+     * @return Its length; 0 if the ring is empty. A frame longer than
+     *         capacity is dropped and 0 returned.
+     */
+    size_t pop(void* out, size_t capacity);
+
+    // Consumer: length of the oldest frame, 0 if empty
+    size_t peek() const;
+
+    size_t capacity() const { return m_mask + 1; }
+    size_t used() const;                    // Approximate unless called by one side
+
+private:
+    void copyIn(size_t position, const void* data, size_t length);
+    void copyOut(size_t position, void* data, size_t length) const;
+
+    uint8_t* m_buffer;
+    size_t m_mask;
+    std::atomic<size_t> m_head;             // Written by the producer only
+    std::atomic<size_t> m_tail;             // Written by the consumer only
+};
+
+#endif // FRAME_RING_H
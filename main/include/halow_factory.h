@@ -55,6 +55,23 @@ public:
      */
     std::unique_ptr<IHaLow> createOptimalHaLow();
 
+    /**
+     * @brief Implementations to try for a hardware type, best first
+     *
+     * The first entry is the one createOptimalHaLow() picks; the rest are
+     * failover candidates (e.g. standard Wi-Fi) in descending priority.
+     * @param hardware_type Hardware type (auto-detected if empty)
+     * @return Vector of implementation names
+     */
+    std::vector<std::string> getFailoverOrder(const std::string& hardware_type = "");
+
+    /**
+     * @brief Create an implementation by registry name
+     * @param implementation_name Name from getFailoverOrder() or getAvailableImplementations()
+     * @return Unique pointer to the implementation, or nullptr if it is not part of this build
+     */
+    std::unique_ptr<IHaLow> createByName(const std::string& implementation_name);
+
     /**
      * @brief Get list of available implementations
      * @return Vector of implementation names
@@ -139,6 +156,7 @@ private:
     std::unique_ptr<IHaLow> createMMIoTSDKHaLow();
     std::unique_ptr<IHaLow> createHeltecHaLow();
     std::unique_ptr<IHaLow> createEspIdfHaLow();
+    std::unique_ptr<IHaLow> createSimHaLow();
     std::unique_ptr<IHaLow> createGenericHaLow();
 
     // Hardware-specific factory methods
@@ -16,19 +16,23 @@
 #include <cstdint>
 #include <vector>
 #include <string>
-#include <functional>
 #include <memory>
+#include "delegate.h"
 
 // Forward declarations
 struct HaLowNetworkInfo;
 struct HaLowPeerInfo;
 struct HaLowConfig;
 
-// Callback function types
-typedef std::function<void(const std::string& peer_id, bool connected)> ConnectionCallback;
-typedef std::function<void(const std::string& peer_id, const std::vector<uint8_t>& data)> DataCallback;
-typedef std::function<void(const std::vector<std::string>& peer_list)> DiscoveryCallback;
-typedef std::function<void(const std::string& event, void* data)> EventCallback;
+// Prefix of a sendRawCommand() response for a command the backend cannot carry out
+#define HALOW_RESULT_UNSUPPORTED "ERROR: unsupported"
+
+// Callback types: a function or a method bound to its object (delegate.h),
+// called directly from the radio's thread
+typedef Delegate<void(const std::string& peer_id, bool connected)> ConnectionCallback;
+typedef Delegate<void(const std::string& peer_id, const std::vector<uint8_t>& data)> DataCallback;
+typedef Delegate<void(const std::vector<std::string>& peer_list)> DiscoveryCallback;
+typedef Delegate<void(const std::string& event, void* data)> EventCallback;
 
 /**
  * @brief Wi-Fi HaLow network information structure
@@ -214,6 +218,11 @@ public:
 
     /**
      * @brief Send raw command to implementation (for debugging)
+     *
+     * Responses start with "OK" on success and "ERROR" on failure. A backend
+     * that knows a command but cannot carry it out answers with
+     * HALOW_RESULT_UNSUPPORTED, so callers can stop asking.
+     *
      * @param command Command string
      * @param params Command parameters
      * @return Response string
@@ -222,38 +231,37 @@ public:
 };
 
 /**
- * @brief Factory class for creating Wi-Fi HaLow implementations
+ * @brief Pin configuration structure
  */
-class HaLowFactory {
-public:
-    /**
-     * @brief Create Wi-Fi HaLow implementation based on hardware and preferences
-     * @param hardware_type Target hardware type
-     * @param preferred_sdk Preferred SDK (optional)
-     * @return Unique pointer to HaLow implementation
-     */
-    static std::unique_ptr<IHaLow> createHaLow(const std::string& hardware_type,
-                                             const std::string& preferred_sdk = "");
-
-    /**
-     * @brief Get list of available implementations
-     * @return Vector of implementation names
-     */
-    static std::vector<std::string> getAvailableImplementations();
-
-    /**
-     * @brief Check if hardware is supported by any implementation
-     * @param hardware_type Hardware type to check
-     * @return true if supported, false otherwise
-     */
-    static bool isHardwareSupported(const std::string& hardware_type);
-
-    /**
-     * @brief Get supported implementations for specific hardware
-     * @param hardware_type Hardware type
-     * @return Vector of implementation names
-     */
-    static std::vector<std::string> getSupportedImplementations(const std::string& hardware_type);
+struct PinConfig {
+    int spi_mosi;
+    int spi_miso;
+    int spi_sclk;
+    int spi_cs;
+    int spi_reset;
+    int spi_int;
+    int uart_tx;
+    int uart_rx;
+    int i2c_sda;
+    int i2c_scl;
+    int led_pin;
+    int button_pin;
+    int battery_adc;
+    int sd_cs;
+    int camera_d0;
+    int camera_d1;
+    int camera_d2;
+    int camera_d3;
+    int camera_d4;
+    int camera_d5;
+    int camera_d6;
+    int camera_d7;
+    int camera_pclk;
+    int camera_href;
+    int camera_vsync;
+    int camera_xclk;
+    int camera_sda;
+    int camera_scl;
 };
 
 /**
@@ -289,40 +297,6 @@ public:
     static uint32_t getHardwareFeatures(const std::string& hardware_type);
 };
 
-/**
- * @brief Pin configuration structure
- */
-struct PinConfig {
-    int spi_mosi;
-    int spi_miso;
-    int spi_sclk;
-    int spi_cs;
-    int spi_reset;
-    int spi_int;
-    int uart_tx;
-    int uart_rx;
-    int i2c_sda;
-    int i2c_scl;
-    int led_pin;
-    int button_pin;
-    int battery_adc;
-    int sd_cs;
-    int camera_d0;
-    int camera_d1;
-    int camera_d2;
-    int camera_d3;
-    int camera_d4;
-    int camera_d5;
-    int camera_d6;
-    int camera_d7;
-    int camera_pclk;
-    int camera_href;
-    int camera_vsync;
-    int camera_xclk;
-    int camera_sda;
-    int camera_scl;
-};
-
 /**
  * @brief Feature flags for hardware capabilities
  */
@@ -0,0 +1,91 @@
+/**
+ * @file halow_phy.h
+ * @brief 802.11ah (Wi-Fi HaLow) PHY rate and link budget tables
+ *
+ * Shared by the link adaptation controller, which picks an MCS and channel
+ * width from measured RSSI, and by the simulator, which turns the chosen
+ * MCS and width back into a link rate and a packet error rate.
+ *
+ * Rates are single spatial stream, long guard interval. Required SNR values
+ * are typical receiver figures for a 10% PER at 256-byte frames.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef HALOW_PHY_H
+#define HALOW_PHY_H
+
+#include <cstdint>
+#include <cmath>
+
+// Supported MCS indices (MCS 8/9 need 256-QAM and are not used; MCS 10 is
+// the 1 MHz duplicated-BPSK range extension mode)
+#define HALOW_MCS_MAX       7
+#define HALOW_MCS_RANGE_EXT 10
+
+// Noise figure assumed for the HaLow front end
+#define HALOW_NOISE_FIGURE_DB 6.0f
+
+/**
+ * @brief Index into the per-bandwidth tables, or -1 for an unsupported width
+ */
+constexpr int halow_bandwidth_index(uint8_t bandwidth_mhz) {
+    return bandwidth_mhz == 1 ? 0 :
+           bandwidth_mhz == 2 ? 1 :
+           bandwidth_mhz == 4 ? 2 :
+           bandwidth_mhz == 8 ? 3 : -1;
+}
+
+/**
+ * @brief PHY rate in kbps, or 0 if the MCS/bandwidth pair is not valid
+ */
+constexpr uint32_t halow_phy_rate_kbps(uint8_t mcs, uint8_t bandwidth_mhz) {
+    constexpr uint32_t rates[4][HALOW_MCS_MAX + 1] = {
+        {  300,  600,  900,  1200,  1800,  2400,  2700,  3000 },    // 1 MHz
+        {  650, 1300, 1950,  2600,  3900,  5200,  5850,  6500 },    // 2 MHz
+        { 1350, 2700, 4050,  5400,  8100, 10800, 12150, 13500 },    // 4 MHz
+        { 2925, 5850, 8775, 11700, 17550, 23400, 26325, 29250 }     // 8 MHz
+    };
+    return mcs == HALOW_MCS_RANGE_EXT ? (bandwidth_mhz == 1 ? 150 : 0) :
+           mcs > HALOW_MCS_MAX || halow_bandwidth_index(bandwidth_mhz) < 0 ? 0 :
+           rates[halow_bandwidth_index(bandwidth_mhz)][mcs];
+}
+
+/**
+ * @brief SNR in dB needed to decode the MCS
+ */
+constexpr float halow_min_snr_db(uint8_t mcs) {
+    constexpr float snr[HALOW_MCS_MAX + 1] = { 2.0f, 5.0f, 9.0f, 11.0f, 15.0f, 18.0f, 20.0f, 25.0f };
+    return mcs == HALOW_MCS_RANGE_EXT ? -1.0f : mcs > HALOW_MCS_MAX ? 99.0f : snr[mcs];
+}
+
+/**
+ * @brief Receiver noise floor in dBm for the channel width
+ *
+ * Thermal noise (-174 dBm/Hz) integrated over the channel plus the noise figure.
+ */
+inline float halow_noise_floor_dbm(uint8_t bandwidth_mhz) {
+    return -174.0f + 10.0f * log10f((float)bandwidth_mhz * 1e6f) + HALOW_NOISE_FIGURE_DB;
+}
+
+/**
+ * @brief Weakest RSSI in dBm at which the MCS/bandwidth pair still works
+ */
+inline float halow_sensitivity_dbm(uint8_t mcs, uint8_t bandwidth_mhz) {
+    return halow_noise_floor_dbm(bandwidth_mhz) + halow_min_snr_db(mcs);
+}
+
+/**
+ * @brief Approximate packet error rate at the given RSSI
+ *
+ * Logistic waterfall centred 1.5 dB below the required SNR, so PER is about 10%
+ * at sensitivity and falls off by roughly a decade per 1.5 dB above it.
+ */
+inline float halow_packet_error_rate(uint8_t mcs, uint8_t bandwidth_mhz, float rssi_dbm) {
+    float margin_db = rssi_dbm - halow_sensitivity_dbm(mcs, bandwidth_mhz) + 1.5f;
+    return 1.0f / (1.0f + expf(1.5f * margin_db));
+}
+
+#endif // HALOW_PHY_H
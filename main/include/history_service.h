@@ -0,0 +1,82 @@
+/**
+ * @file history_service.h
+ * @brief Text message history in the SPIFFS storage partition
+ *
+ * One low-priority task loads the node's MessageHistory (message_history.h)
+ * at start-up, which reads the saved index only, and afterwards deletes
+ * aged-out segments and saves the index in the background. Appends and
+ * page reads come from the UI under a mutex; an append is one small write
+ * to flash, a page one read per message shown.
+ *
+ * The log is encrypted under a device key generated on first use and kept
+ * in NVS. Production builds (sdkconfig.defaults.prod) turn on NVS
+ * encryption with its keys derived from an HMAC key in eFuse, burned on
+ * first boot, so on the ESP32-S3, C3 and C6 the key never lies in flash in
+ * the clear. Default builds, and the ESP32, which has no HMAC peripheral,
+ * encrypt NVS only with flash encryption; otherwise anyone with the board
+ * can read the key and the history, and a warning is logged at start-up. Erasing
+ * NVS makes the history unreadable, and it is then rebuilt empty.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef HISTORY_SERVICE_H
+#define HISTORY_SERVICE_H
+
+#include "message_history.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Task and timing
+#define HISTORY_SERVICE_TASK_STACK_SIZE (4 * 1024)
+#define HISTORY_SERVICE_TASK_PRIORITY 1
+#define HISTORY_SERVICE_TICK_MS 1000
+
+// Files in the storage partition
+#define HISTORY_SEGMENT_PATH_FORMAT "/spiffs/hist%04x.log"
+#define HISTORY_SEGMENT_PREFIX "hist"       // Segment names within the partition
+#define HISTORY_INDEX_PATH "/spiffs/hist.idx"
+#define HISTORY_INDEX_TEMP_PATH "/spiffs/hist.tmp"
+
+#define HISTORY_NVS_NAMESPACE "history"
+
+/**
+ * @brief Start the history task; the history is loaded in the background
+ * @return 0 on success, error code on failure
+ */
+int history_service_init(void);
+
+/**
+ * @brief Record a message sent or received
+ * @param conversation The other party's callsign
+ * @param direction    history_direction_t
+ * @return false if the history is not loaded yet or the message could not be stored
+ */
+bool history_service_append(const char* conversation, uint8_t direction, const char* text);
+
+/**
+ * @brief Conversations, most recently active first
+ * @return Number written to out
+ */
+size_t history_service_conversations(history_conversation_t* out, size_t max);
+
+/**
+ * @brief Messages of a conversation, newest first, read from flash
+ * @param skip Newest messages to pass over
+ * @return Number written to out
+ */
+size_t history_service_page(const char* conversation, size_t skip, history_message_t* out, size_t max);
+
+size_t history_service_count(const char* conversation);
+void history_service_mark_read(const char* conversation);
+
+/**
+ * @brief History counters and the number of messages kept
+ * @return false if the history is not loaded yet
+ */
+bool history_service_get_stats(history_stats_t* stats, uint32_t* messages);
+
+#endif // HISTORY_SERVICE_H
@@ -0,0 +1,83 @@
+/**
+ * @file jpeg_progressive.h
+ * @brief Lossless baseline to progressive JPEG re-encoding
+ *
+ * The camera produces baseline JPEG, which a receiver can only show once
+ * the last byte has arrived. This module rewrites it as a progressive
+ * JPEG with the same DCT coefficients, so the picture is unchanged, but
+ * the coefficients are sent in a different order:
+ *
+ *   scan 1   DC of every component   1/8 scale colour preview
+ *   scan 2   Y  AC 1-5               coarse luma detail
+ *   scan 3   Cb AC 1-63              full chroma
+ *   scan 4   Cr AC 1-63
+ *   scan 5   Y  AC 6-63              full luma detail
+ *
+ * The first scan usually takes a few KB. Any progressive decoder can show
+ * a preview from a prefix that ends after it (info.preview_bytes), with
+ * an EOI appended. Every scan gets Huffman tables built for its own
+ * statistics, which usually makes the file a little smaller than the
+ * camera's output.
+ *
+ * Input: 8-bit baseline or extended sequential Huffman JPEG, one or three
+ * components, any sampling factors, with or without restart markers.
+ * APPn, COM and DQT segments are copied through.
+ *
+ * The coefficients are held in memory while re-encoding, 128 bytes per
+ * 8x8 block (about 1.2 MB for a 4:2:2 VGA frame). They come from PSRAM
+ * when the board has it.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef JPEG_PROGRESSIVE_H
+#define JPEG_PROGRESSIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define JPEG_PROGRESSIVE_MAX_DIMENSION 4096
+
+/**
+ * @brief Re-encoding result
+ */
+typedef enum {
+    JPEG_PROGRESSIVE_OK = 0,
+    JPEG_PROGRESSIVE_ERR_FORMAT,        ///< Not a valid JPEG
+    JPEG_PROGRESSIVE_ERR_UNSUPPORTED,   ///< Progressive, arithmetic, 12-bit or unusual component layout
+    JPEG_PROGRESSIVE_ERR_NO_MEMORY
+} jpeg_progressive_status_t;
+
+/**
+ * @brief Details of the re-encoded image
+ */
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t components;
+    uint8_t scans;
+    uint32_t preview_bytes;         ///< Prefix that holds the DC scan
+    uint32_t size;                  ///< Total output size
+} jpeg_progressive_info_t;
+
+/**
+ * @brief Re-encode a baseline JPEG as progressive
+ * @param jpeg Baseline JPEG
+ * @param length Its size
+ * @param out Receives the progressive JPEG (replaces its contents)
+ * @param info Receives image details; may be NULL
+ * @return JPEG_PROGRESSIVE_OK or the reason the image was not re-encoded
+ */
+jpeg_progressive_status_t jpeg_progressive_encode(const uint8_t* jpeg, size_t length,
+                                                  std::vector<uint8_t>* out,
+                                                  jpeg_progressive_info_t* info);
+
+/**
+ * @brief Status name for logs
+ */
+const char* jpeg_progressive_status_name(jpeg_progressive_status_t status);
+
+#endif // JPEG_PROGRESSIVE_H
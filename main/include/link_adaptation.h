@@ -0,0 +1,234 @@
+/**
+ * @file link_adaptation.h
+ * @brief Closed-loop HaLow rate and voice codec adaptation
+ *
+ * The controller keeps an exponentially weighted moving average (EWMA) of
+ * RSSI and packet loss for every mesh link. From those it picks:
+ *
+ * - per link: the HaLow MCS and channel width, from a rate ladder built
+ *   out of the 802.11ah sensitivity tables (halow_phy.h)
+ * - per talker: the Opus bitrate and FEC strength of the local encoder,
+ *   from the worst link among the peers listening to us
+ *
+ * Hysteresis keeps the choices from flapping: a link steps down as soon as
+ * its RSSI falls below the sensitivity of the current rate or its loss
+ * exceeds loss_down_threshold, but only steps up one rung at a time, and
+ * only after the next rung has been reachable with rssi_margin_db to spare
+ * and loss below loss_up_threshold for up_hold_ms. After any change the
+ * link is left alone for min_dwell_ms and its loss average restarts, so a
+ * rate change is judged only on what was measured at the new rate.
+ *
+ * Rate changes go to the radio via IHaLow::sendRawCommand("set_link_rate",
+ * {peer_id, mcs, bandwidth_mhz}); codec changes go through
+ * audio_codec_reconfigure(). Both are applied outside the controller lock.
+ * A radio that answers HALOW_RESULT_UNSUPPORTED keeps its own rate control
+ * until the next setRadio(); audio adaptation carries on regardless.
+ * While the voice codec is not running (codecAdaptationSupported() is
+ * false) voice tiers are still tracked per link but not applied, and this
+ * is logged once.
+ *
+ * RSSI is polled from the radio's peer list on every tick(); loss comes
+ * from whichever layer counts frames, via reportLinkSample().
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef LINK_ADAPTATION_H
+#define LINK_ADAPTATION_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "halow_interface.h"
+#include "audio_codec.h"
+
+// Upper bound on rate ladder length (MCS 0-7 on four widths plus MCS 10)
+#define LINK_ADAPTATION_MAX_RUNGS 33
+
+/**
+ * @brief Radio rate for one link
+ */
+typedef struct {
+    uint8_t mcs;
+    uint8_t bandwidth_mhz;
+} link_rate_t;
+
+/**
+ * @brief Voice codec settings for one quality tier
+ */
+typedef struct {
+    int bitrate;                    ///< Opus target bitrate in bps
+    bool enable_fec;                ///< Opus in-band FEC
+    int packet_loss_perc;           ///< Expected loss handed to the encoder (FEC strength)
+} link_audio_profile_t;
+
+/**
+ * @brief Controller configuration
+ */
+typedef struct {
+    float ewma_alpha;               ///< Weight of a new sample, 0 - 1
+    float rssi_margin_db;           ///< Extra RSSI above sensitivity required to step up
+    float loss_up_threshold;        ///< Loss fraction below which a link may step up
+    float loss_down_threshold;      ///< Loss fraction above which a link steps down
+    uint32_t up_hold_ms;            ///< How long a link must qualify before stepping up
+    uint32_t min_dwell_ms;          ///< Minimum time between two changes on one link
+    uint32_t stale_ms;              ///< Links without samples for this long are forgotten
+    uint8_t max_bandwidth_mhz;      ///< Widest channel the network allows (1, 2, 4 or 8)
+    bool adapt_audio;               ///< Reconfigure the local Opus encoder
+} link_adaptation_config_t;
+
+/**
+ * @brief Snapshot of one link, for logging and the UI
+ */
+typedef struct {
+    std::string peer_id;
+    float rssi_dbm;                 ///< RSSI average
+    float loss;                     ///< Loss fraction average
+    link_rate_t rate;               ///< Current radio rate
+    uint32_t phy_rate_kbps;         ///< PHY rate of the current radio rate
+    uint8_t audio_tier;             ///< Index into the audio tier table, 0 = best
+    uint32_t rate_changes;          ///< Number of rate changes so far
+} link_adaptation_link_t;
+
+class LinkAdaptation {
+public:
+    static LinkAdaptation& getInstance() {
+        static LinkAdaptation instance;
+        return instance;
+    }
+
+    LinkAdaptation(const LinkAdaptation&) = delete;
+    void operator=(const LinkAdaptation&) = delete;
+
+    static link_adaptation_config_t defaultConfig();
+
+    /**
+     * @brief Apply a configuration; existing links are kept and re-clamped
+     */
+    bool configure(const link_adaptation_config_t& config);
+
+    /**
+     * @brief Radio that receives rate commands and supplies per-peer RSSI
+     *
+     * May be NULL; decisions are then still tracked but not applied.
+     */
+    void setRadio(IHaLow* radio);
+
+    /**
+     * @brief Report frame counts measured on a link since the previous report
+     *
+     * @param peer_id   Radio peer ID
+     * @param rssi_dbm  Latest RSSI, or 0 if unknown
+     * @param expected  Frames the peer sent (e.g. from sequence numbers)
+     * @param received  Frames that arrived
+     */
+    void reportLinkSample(const std::string& peer_id, int32_t rssi_dbm,
+                          uint32_t expected, uint32_t received);
+
+    /**
+     * @brief Report an RSSI reading without loss information
+     */
+    void reportRssi(const std::string& peer_id, int32_t rssi_dbm);
+
+    /**
+     * @brief Forget a link (peer disconnected)
+     */
+    void removeLink(const std::string& peer_id);
+
+    /**
+     * @brief Poll the radio for RSSI, re-evaluate every link and apply changes
+     *
+     * Call periodically, e.g. once per second.
+     */
+    void tick();
+
+    /**
+     * @brief Current rate for a link; the most robust rung if the link is unknown
+     */
+    link_rate_t getLinkRate(const std::string& peer_id) const;
+
+    /**
+     * @brief Codec settings currently applied to the local encoder
+     */
+    link_audio_profile_t getAudioProfile() const;
+
+    /**
+     * @brief Opus encoder complexity (0 - 10), kept across voice tier changes
+     *
+     * Set by the battery service; lower complexity costs quality but less CPU.
+     * Only saves anything while codecAdaptationSupported(); otherwise it is
+     * kept for when the codec comes up.
+     */
+    void setCodecComplexity(int complexity);
+
+    /**
+     * @brief True if voice tier and complexity changes reach a running encoder
+     *
+     * False while the codec is not initialized, e.g. on builds without libopus.
+     */
+    bool codecAdaptationSupported() const;
+
+    std::vector<link_adaptation_link_t> getLinks() const;
+
+    /**
+     * @brief Mean RSSI and loss over all links, for NetworkHealth reports
+     * @return false if there are no links
+     */
+    bool getAggregate(int32_t* rssi_dbm, uint32_t* loss_percent) const;
+
+    void logLinks() const;
+
+private:
+    LinkAdaptation();
+    ~LinkAdaptation();
+
+    struct LinkState {
+        float rssi;
+        float loss;
+        uint32_t rssiSamples;
+        uint32_t lossSamples;
+        uint8_t rung;               ///< Index into m_ladder
+        uint8_t audioTier;
+        int64_t lastSampleUs;
+        int64_t lastChangeUs;
+        int64_t upSinceUs;          ///< When the link first qualified to step up, 0 if not
+        int64_t audioUpSinceUs;
+        uint32_t rateChanges;
+        bool placed;                ///< Initial rung chosen from the first RSSI reading
+        bool rateDirty;             ///< Rate must be (re)sent to the radio
+    };
+
+    struct RateCommand {
+        std::string peerId;
+        link_rate_t rate;
+    };
+
+    void buildLadder();
+    LinkState& linkFor(const std::string& peer_id, int64_t now);
+    void updateRssi(LinkState& link, int32_t rssi_dbm);
+    bool evaluateRate(LinkState& link, int64_t now);
+    void evaluateAudioTier(LinkState& link, int64_t now);
+    float rungSensitivity(uint8_t rung) const;
+    void applyAudioTier(uint8_t tier);
+    bool codecRunning();            // Logs once when it is not
+
+    link_adaptation_config_t m_config;
+    SemaphoreHandle_t m_mutex;
+    IHaLow* m_radio;
+    bool m_rateControl;             // Cleared when the radio cannot set rates; reset by setRadio()
+
+    link_rate_t m_ladder[LINK_ADAPTATION_MAX_RUNGS];
+    uint8_t m_ladderSize;
+
+    std::map<std::string, LinkState> m_links;
+    uint8_t m_appliedAudioTier;
+    audio_codec_config_t m_codecConfig;
+    bool m_codecWarned;             // "Codec not running" was logged
+};
+
+#endif // LINK_ADAPTATION_H
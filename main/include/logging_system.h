@@ -310,8 +310,11 @@ void logging_system_clear_filters(void);
 // ============================================================================
 
 // These macros provide backward compatibility with existing ESP_LOGX calls
-// They automatically map to the new logging system
+// They automatically map to the new logging system. logging_system.cpp
+// writes its console output with the ESP-IDF macros themselves, so it
+// defines LOGGING_SYSTEM_IMPLEMENTATION to keep them.
 
+#ifndef LOGGING_SYSTEM_IMPLEMENTATION
 #undef ESP_LOGE
 #define ESP_LOGE(tag, format, ...) LOG_ERROR(tag, ERROR_NONE, format, ##__VA_ARGS__)
 #undef ESP_LOGW
@@ -322,6 +325,7 @@ void logging_system_clear_filters(void);
 #define ESP_LOGD(tag, format, ...) LOG_DEBUG(tag, format, ##__VA_ARGS__)
 #undef ESP_LOGV
 #define ESP_LOGV(tag, format, ...) LOG_VERBOSE(tag, format, ##__VA_ARGS__)
+#endif
 
 // Error context logging macros
 #define LOG_ERROR_CTX(component, category, code, message, context) \
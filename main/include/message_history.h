@@ -0,0 +1,235 @@
+/**
+ * @file message_history.h
+ * @brief Persistent, encrypted text message history with a per-conversation index
+ *
+ * Every message sent or received is appended to a log in flash
+ * (IHistoryStorage). The log is split into numbered segments of a few KB;
+ * a record is never rewritten, and old history goes a whole segment at a
+ * time: when the log has outgrown max_bytes, tick() deletes the oldest
+ * segment and drops its messages from the index. Nothing is ever copied.
+ *
+ * Each record is sealed with crypto_secretbox under a device key (the same
+ * primitive as messages on air), with a nonce made of a random prefix
+ * chosen at start-up and a counter, and carries a CRC-32 so that a record
+ * torn by power loss is recognised before it is decrypted.
+ *
+ * In RAM the history is only an index: per conversation, the location
+ * (segment, offset) of each message, oldest first, plus counters. Messages
+ * are read and decrypted from flash only when asked for, a page at a time.
+ * The index itself is saved, sealed the same way, as a checkpoint once
+ * enough log has been written since the last one or some time has passed;
+ * load() reads the checkpoint and decrypts only the records appended after
+ * it. Without a usable checkpoint it rebuilds the index from every
+ * segment.
+ *
+ * The class does no I/O except through the storage, takes the time as an
+ * argument and is not thread safe, so the host benchmark can drive it
+ * directly.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef MESSAGE_HISTORY_H
+#define MESSAGE_HISTORY_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_KEY_SIZE 32                 // crypto_secretbox_KEYBYTES
+#define HISTORY_NAME_LEN 40                 // Conversation name, including the terminator
+#define HISTORY_MAX_TEXT 200
+#define HISTORY_MAX_SEGMENT_BYTES 0xFFFF    // Offsets are 16 bits
+
+/**
+ * @brief Which way a message went
+ */
+typedef enum {
+    HISTORY_DIRECTION_RX = 0,
+    HISTORY_DIRECTION_TX = 1
+} history_direction_t;
+
+/**
+ * @brief Log size and checkpoint policy
+ */
+typedef struct {
+    uint32_t max_bytes;                     ///< Log kept; older segments are deleted
+    uint16_t segment_bytes;                 ///< A new segment is started beyond this
+    uint32_t checkpoint_bytes;              ///< Save the index once this much log is not in it
+    uint32_t checkpoint_ms;                 ///< ... or this long after the first change not in it
+} history_config_t;
+
+/**
+ * @brief History counters
+ */
+typedef struct {
+    uint32_t appended;
+    uint32_t rejected;                      ///< Invalid messages and failed writes
+    uint32_t log_bytes_written;
+    uint32_t pages_read;
+    uint32_t records_read;                  ///< Decrypted for pages
+    uint32_t bytes_read;                    ///< From storage, for pages and load
+    uint32_t damaged;                       ///< Records that failed their CRC or did not decrypt
+    uint32_t segments_dropped;
+    uint32_t messages_dropped;              ///< Aged out with their segment
+    uint32_t checkpoints;
+    uint32_t checkpoint_bytes_written;
+    uint32_t load_records;                  ///< Decrypted by the last load()
+} history_stats_t;
+
+/**
+ * @brief One message
+ */
+typedef struct {
+    uint8_t direction;                      ///< history_direction_t
+    uint32_t epoch_s;                       ///< Wall clock; small if the clock was not set
+    char text[HISTORY_MAX_TEXT + 1];
+} history_message_t;
+
+/**
+ * @brief One conversation
+ */
+typedef struct {
+    char name[HISTORY_NAME_LEN];            ///< The other party's callsign
+    uint32_t messages;
+    uint32_t unread;
+    uint32_t last_epoch_s;
+} history_conversation_t;
+
+/**
+ * @brief Default sizes for the SPIFFS storage partition
+ */
+history_config_t history_default_config(void);
+
+/**
+ * @brief Flash behind the history: numbered append-only segments and one index blob
+ *
+ * Segment numbers are 16 bits and wrap.
+ */
+class IHistoryStorage {
+public:
+    virtual ~IHistoryStorage() = default;
+
+    // Segments present, in any order
+    virtual bool list(std::vector<uint16_t>* segments) = 0;
+    // false if the segment does not exist
+    virtual bool size(uint16_t segment, uint32_t* bytes) = 0;
+    // Bytes read; short at the end of the segment
+    virtual size_t read(uint16_t segment, uint32_t offset, uint8_t* out, size_t length) = 0;
+    // Creates the segment if needed
+    virtual bool append(uint16_t segment, const uint8_t* data, size_t length) = 0;
+    virtual bool remove(uint16_t segment) = 0;
+
+    // An empty index if there is none
+    virtual bool loadIndex(std::vector<uint8_t>* index) = 0;
+    // Replace the index; the old one must survive a failure
+    virtual bool saveIndex(const std::vector<uint8_t>& index) = 0;
+};
+
+class MessageHistory {
+public:
+    /**
+     * @param storage Must outlive the history
+     * @param key     HISTORY_KEY_SIZE bytes; the same key must be used for every load
+     * @param seed    Random nonce prefix for this start-up
+     */
+    MessageHistory(IHistoryStorage* storage, const uint8_t* key, uint64_t seed, const history_config_t& config);
+    ~MessageHistory();
+
+    /**
+     * @brief Load the index; call once before anything else
+     * @return false if storage could not be read
+     */
+    bool load(uint32_t nowMs);
+
+    /**
+     * @brief Append a message to a conversation
+     * @param epochS Wall clock
+     * @return false if the message is invalid or could not be written
+     */
+    bool append(const std::string& conversation, uint8_t direction, uint32_t epochS, const std::string& text,
+                uint32_t nowMs);
+
+    /**
+     * @brief Conversations, most recently active first
+     * @return Number written to out
+     */
+    size_t conversations(history_conversation_t* out, size_t max) const;
+
+    size_t count(const std::string& conversation) const;
+
+    /**
+     * @brief Read messages of a conversation from flash, newest first
+     * @param skip Newest messages to pass over
+     * @return Number written to out; damaged records are left out
+     */
+    size_t page(const std::string& conversation, size_t skip, history_message_t* out, size_t max);
+
+    void markRead(const std::string& conversation, uint32_t nowMs);
+
+    // Delete aged-out segments and save the index when due. Call every 100 - 1000 ms.
+    void tick(uint32_t nowMs);
+
+    // Save the index now, for example before a restart
+    bool checkpoint();
+
+    uint32_t logBytes() const;
+    size_t messages() const { return m_messageCount; }
+    const history_stats_t& stats() const { return m_stats; }
+
+private:
+    struct Segment {
+        uint16_t id;
+        uint32_t bytes;                     // Valid records
+        bool sealed;                        // Damaged tail: no more appends
+    };
+
+    struct Conversation {
+        std::vector<uint32_t> locations;    // Segment << 16 | offset, oldest first
+        uint32_t unread = 0;
+        uint32_t lastEpochS = 0;
+        uint32_t lastOrder = 0;             // Append order of its newest message
+    };
+
+    void nextNonce(uint8_t* nonce);
+    bool seal(const uint8_t* nonce, const uint8_t* plain, size_t length, uint8_t* box);
+    bool open(const uint8_t* nonce, const uint8_t* box, size_t boxLength, std::vector<uint8_t>* plain);
+    bool makeRecord(const std::vector<uint8_t>& plain, std::vector<uint8_t>* record);
+    bool parseRecord(const uint8_t* data, size_t available, size_t* recordLength, std::vector<uint8_t>* plain);
+    void indexRecord(const std::string& conversation, uint8_t direction, uint32_t epochS, uint32_t location);
+    void forgetSegment(uint16_t id);
+    size_t scanSegment(Segment& segment, uint32_t from);
+    std::vector<uint8_t> encodeIndex() const;
+    bool decodeIndex(const std::vector<uint8_t>& blob);
+    void clear();
+    void rebuild();
+    bool catchUp();
+    void markDirty(uint32_t nowMs);
+    bool dropOldest();
+    bool readMessage(uint32_t location, history_message_t* out);
+
+    IHistoryStorage* m_storage;
+    uint8_t m_key[HISTORY_KEY_SIZE];
+    uint64_t m_noncePrefix;
+    uint32_t m_nonceCounter = 0;
+    history_config_t m_config;
+
+    std::deque<Segment> m_segments;         // Oldest first
+    std::map<std::string, Conversation> m_conversations;
+    size_t m_messageCount = 0;
+    uint32_t m_order = 0;
+
+    // Checkpoint state
+    uint32_t m_uncheckpointedBytes = 0;
+    bool m_dirty = false;
+    uint32_t m_dirtySinceMs = 0;
+
+    history_stats_t m_stats = {};
+};
+
+#endif // MESSAGE_HISTORY_H
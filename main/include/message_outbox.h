@@ -0,0 +1,268 @@
+/**
+ * @file message_outbox.h
+ * @brief Persistent store-and-forward outbox for messages to single peers
+ *
+ * A message for a peer that is out of range is kept until the peer comes
+ * back instead of being dropped. Every message goes into a log in flash
+ * (IOutboxStorage) before it is acknowledged to anyone, so it survives a
+ * restart. In RAM the outbox is indexed by destination and, per
+ * destination, by priority and age.
+ *
+ * Sending is driven by the neighbour table, not by timers. When a peer is
+ * seen (a connection event, discovery or any frame from it), the messages
+ * waiting for it are sent at once. Each DATA frame is acknowledged by the
+ * next hop; unacknowledged frames are repeated a few times while the peer
+ * stays in range, then wait for its next appearance.
+ *
+ * Custody transfer (DTN style): a message sent with OUTBOX_FLAG_CUSTODY may
+ * be handed to a neighbour that is a better carrier, one that has met the
+ * destination more recently than this node. The carrier stores it in its
+ * own log and acknowledges custody, and only then does this node delete
+ * its copy, so there is always exactly one stored copy. Nodes tell new
+ * neighbours whom they have met recently (SUMMARY frames); a message
+ * therefore moves towards where its destination was last seen, at most
+ * max_hops times.
+ *
+ * A destination acknowledges delivery to the node that handed the message
+ * over. With OUTBOX_FLAG_RECEIPT it also sends the origin a delivery
+ * receipt, itself a message that travels the same way, unless the origin
+ * was the node that delivered it and has its answer already.
+ *
+ * The log is append-only: a STORE record per message kept and a DELETE
+ * record per message gone. It is rewritten with only the live records
+ * when it has grown to twice their size. Message lifetimes count the time
+ * the node is running; after a restart they continue from the last
+ * rewrite.
+ *
+ * The class holds protocol state only; it does no I/O except through the
+ * storage and the send function, takes the time as an argument and is not
+ * thread safe, so the host simulation can run many nodes in one process.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef MESSAGE_OUTBOX_H
+#define MESSAGE_OUTBOX_H
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OUTBOX_MAX_PAYLOAD 1024
+#define OUTBOX_NODE_ID_LEN 40               // Including the terminator
+#define OUTBOX_SUMMARY_ENTRIES 16           // Encounters told to a new neighbour
+#define OUTBOX_MAX_NEIGHBOURS 32
+#define OUTBOX_MAX_ENCOUNTERS 64
+
+/**
+ * @brief Message priority; higher goes first
+ */
+typedef enum {
+    OUTBOX_PRIORITY_LOW = 0,
+    OUTBOX_PRIORITY_NORMAL,
+    OUTBOX_PRIORITY_HIGH,
+    OUTBOX_PRIORITY_URGENT
+} outbox_priority_t;
+
+// Message flags
+#define OUTBOX_FLAG_RECEIPT 0x01            // Tell the origin when it was delivered
+#define OUTBOX_FLAG_CUSTODY 0x02            // May be handed to a carrier
+#define OUTBOX_FLAG_IS_RECEIPT 0x04         // Internal: a delivery receipt
+
+/**
+ * @brief Outbox timing and limits
+ */
+typedef struct {
+    uint32_t ack_timeout_ms;                ///< Repeat an unacknowledged frame after this long
+    uint8_t attempts_per_contact;           ///< Sends of one message per peer appearance
+    uint8_t window;                         ///< DATA frames in flight per neighbour
+    uint32_t neighbour_timeout_ms;          ///< Silence after which a neighbour counts as gone
+    uint32_t summary_interval_ms;           ///< Encounter summaries to neighbours in range
+    uint32_t default_ttl_s;                 ///< Lifetime of a message
+    uint16_t max_messages;
+    uint32_t max_bytes;                     ///< Payload bytes held
+    uint8_t custody_percent;                ///< Share of the outbox other nodes' messages may fill
+    uint8_t max_hops;                       ///< Custody transfers per message
+    uint32_t carrier_margin_ms;             ///< How much more recently a carrier must have met the destination
+    uint32_t compact_min_bytes;             ///< Smallest log worth rewriting
+} outbox_config_t;
+
+/**
+ * @brief Outbox counters
+ */
+typedef struct {
+    uint32_t queued;                        ///< Own messages accepted
+    uint32_t rejected;                      ///< Own messages refused: outbox full or storage failed
+    uint32_t delivered;                     ///< Messages handed to their destination by this node
+    uint32_t received;                      ///< Messages for this node given to the application
+    uint32_t duplicates;                    ///< Messages for this node received again
+    uint32_t receipts;                      ///< Delivery confirmations of own messages
+    uint32_t custody_accepted;              ///< Messages taken on for other nodes
+    uint32_t custody_refused;
+    uint32_t custody_handed;                ///< Messages given to a carrier
+    uint32_t expired;
+    uint32_t data_sent;                     ///< DATA frames, including repeats
+    uint32_t retransmits;
+    uint32_t frames_sent;
+    uint32_t bytes_sent;
+    uint32_t log_writes;                    ///< Appends and rewrites
+    uint32_t log_bytes_written;
+    uint32_t log_compactions;
+} outbox_stats_t;
+
+/**
+ * @brief Default timing for a HaLow mesh
+ */
+outbox_config_t outbox_default_config(void);
+
+/**
+ * @brief Flash behind the outbox: one append-only log
+ */
+class IOutboxStorage {
+public:
+    virtual ~IOutboxStorage() = default;
+
+    // Whole log; an empty log if there is none yet
+    virtual bool load(std::vector<uint8_t>* log) = 0;
+    virtual bool append(const uint8_t* data, size_t length) = 0;
+    // Replace the log (compaction); the old log must survive a failure
+    virtual bool rewrite(const std::vector<uint8_t>& log) = 0;
+};
+
+class MessageOutbox {
+public:
+    // Send one frame to a neighbour; returns false if it could not be sent
+    typedef std::function<bool(const std::string& peerId, const std::vector<uint8_t>& frame)> SendFunction;
+    typedef std::function<void(const std::string& origin, const std::vector<uint8_t>& payload)> ReceiveFunction;
+    typedef std::function<void(const std::string& destination, uint32_t messageId)> ReceiptFunction;
+
+    /**
+     * @param nodeId  Address of this node, as used by the send function
+     * @param storage Log storage; must outlive the outbox
+     * @param seed    Random seed for the first message ID
+     */
+    MessageOutbox(const std::string& nodeId, IOutboxStorage* storage, SendFunction send,
+                  const outbox_config_t& config, uint32_t seed);
+
+    // Load the messages kept in storage. Call once before anything else.
+    bool begin(uint32_t nowMs);
+
+    void setReceiveCallback(ReceiveFunction callback) { m_onReceive = callback; }
+    void setReceiptCallback(ReceiptFunction callback) { m_onReceipt = callback; }
+
+    /**
+     * @brief Store a message for a peer and send it when the peer is in range
+     * @param ttlS Lifetime in seconds; 0 for the default
+     * @return Message ID, 0 if the outbox is full or the message invalid
+     */
+    uint32_t send(const std::string& destination, const uint8_t* data, size_t length, uint8_t priority,
+                  uint8_t flags, uint32_t ttlS, uint32_t nowMs);
+
+    // Neighbour table events
+    void peerUp(const std::string& peerId, uint32_t nowMs);
+    void peerDown(const std::string& peerId, uint32_t nowMs);
+
+    // Feed a received frame; the sender counts as in range
+    void handleFrame(const std::string& peerId, const uint8_t* data, size_t length, uint32_t nowMs);
+
+    // Repeat, expire and send what is due. Call every 50 - 200 ms.
+    void tick(uint32_t nowMs);
+
+    size_t pending() const { return m_messages.size(); }
+    size_t pendingFor(const std::string& destination) const;
+    bool isNeighbour(const std::string& peerId) const;
+    const outbox_stats_t& stats() const { return m_stats; }
+    const std::string& nodeId() const { return m_nodeId; }
+
+    // True if the data is an outbox frame (cheap check for routing)
+    static bool isOutboxFrame(const uint8_t* data, size_t length);
+
+private:
+    typedef std::pair<std::string, uint32_t> Key;   // Origin, message ID
+    typedef std::tuple<int, uint32_t, Key> Slot;    // Minus priority, arrival order, key
+
+    struct Message {
+        uint32_t id = 0;
+        std::string origin;
+        std::string destination;
+        uint8_t priority = 0;
+        uint8_t flags = 0;
+        uint8_t hops = 0;                   // Custody transfers left
+        uint32_t expiresAtMs = 0;
+        uint32_t order = 0;
+        std::vector<uint8_t> payload;
+        size_t recordBytes = 0;             // Size of its STORE record
+        // Transmission; not stored
+        std::string inFlightTo;
+        uint32_t sentAtMs = 0;
+        std::string triedPeer;
+        uint32_t triedContact = 0;
+        uint8_t attempts = 0;
+    };
+
+    struct Neighbour {
+        bool up = false;
+        uint32_t lastHeardMs = 0;
+        uint32_t contact = 0;               // Counts appearances
+        uint32_t nextSummaryMs = 0;
+        uint8_t inFlight = 0;
+        bool full = false;                  // Refused custody during this contact
+        std::map<std::string, uint32_t> metAtMs;    // From its summaries, in local time
+    };
+
+    bool store(Message& message, bool own);
+    void remove(const Key& key, uint32_t nowMs);
+    bool appendRecord(uint8_t type, const std::vector<uint8_t>& body);
+    void maybeCompact(uint32_t nowMs);
+    bool compact(uint32_t nowMs);
+    bool parseLog(const std::vector<uint8_t>& log, uint32_t nowMs, size_t* validBytes);
+
+    Neighbour& neighbour(const std::string& peerId, uint32_t nowMs);
+    void noteHeard(const std::string& peerId, uint32_t nowMs);
+    void startContact(const std::string& peerId, Neighbour& peer, uint32_t nowMs);
+    bool betterCarrier(const Neighbour& peer, const std::string& destination) const;
+    bool eligible(const Message& message, const std::string& peerId, const Neighbour& peer) const;
+    void sendDue(const std::string& peerId, Neighbour& peer, uint32_t nowMs);
+    bool sendData(const std::string& peerId, Neighbour& peer, Message& message, uint32_t nowMs);
+    void sendAck(const std::string& peerId, const Message& message, uint8_t status);
+    void sendSummary(const std::string& peerId, uint32_t nowMs);
+    bool sendFrame(const std::string& peerId, const std::vector<uint8_t>& frame);
+
+    void handleData(const std::string& peerId, const uint8_t* body, size_t length, uint32_t nowMs);
+    void handleAck(const std::string& peerId, const uint8_t* body, size_t length, uint32_t nowMs);
+    void handleSummary(const std::string& peerId, const uint8_t* body, size_t length, uint32_t nowMs);
+    void deliverLocal(const Message& message, const std::string& from, uint32_t nowMs);
+
+    size_t custodyBytes() const;
+    size_t heldBytes() const;
+
+    std::string m_nodeId;
+    IOutboxStorage* m_storage;
+    SendFunction m_send;
+    ReceiveFunction m_onReceive;
+    ReceiptFunction m_onReceipt;
+    outbox_config_t m_config;
+
+    std::map<Key, Message> m_messages;
+    std::map<std::string, std::set<Slot>> m_byDestination;
+    std::map<std::string, Neighbour> m_neighbours;
+    std::map<std::string, uint32_t> m_metAtMs;     // Own encounters
+    std::deque<Key> m_recentlyReceived;             // Duplicate filter for messages to this node
+    uint32_t m_nextId;
+    uint32_t m_nextOrder;
+    size_t m_logBytes;
+    size_t m_liveBytes;
+    bool m_loaded;
+    outbox_stats_t m_stats;
+};
+
+#endif // MESSAGE_OUTBOX_H
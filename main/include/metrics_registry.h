@@ -0,0 +1,314 @@
+/**
+ * @file metrics_registry.h
+ * @brief Unified metrics registry: counters, gauges and histograms
+ *
+ * Every metric has a compile-time ID generated from the tables below, so
+ * updating one is an array index plus a relaxed atomic operation; there are
+ * no locks, no lookups and no allocation on the hot path, and the update
+ * functions are safe from any task on either core.
+ *
+ * - Counters are monotonic and kept per core, each core's block on its own
+ *   cache line, and summed when read. They wrap at 2^32.
+ * - Gauges hold a single signed value (set, add or raise-to-max).
+ * - Histograms use HDR-style log buckets: exact below 8, then 8 linear
+ *   sub-buckets per power of two (at most 12.5% relative error) up to
+ *   METRICS_HISTOGRAM_MAX_VALUE. Count, percentiles and mean are derived from
+ *   the buckets; the maximum is exact.
+ *
+ * metrics_snapshot() copies everything at once for export, either as the
+ * compact binary format (metrics_encode()) or as text (metrics_format_text()).
+ *
+ * To add a metric, add a line at the end of the matching table. Names are
+ * "group.name" and are what the text export prints. The binary export is
+ * positional, so existing metrics keep their place; moving or removing one
+ * needs a new METRICS_FORMAT_VERSION.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef METRICS_REGISTRY_H
+#define METRICS_REGISTRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// METRIC TABLES
+// ============================================================================
+
+#define METRICS_COUNTERS(X) \
+    X(NET_MESSAGES_SENT,        "net.messages_sent") \
+    X(NET_MESSAGES_RECEIVED,    "net.messages_received") \
+    X(NET_BYTES_SENT,           "net.bytes_sent") \
+    X(NET_BYTES_RECEIVED,       "net.bytes_received") \
+    X(NET_CONNECTION_ATTEMPTS,  "net.connection_attempts") \
+    X(NET_CONNECTIONS_OK,       "net.connections_ok") \
+    X(NET_CONNECTIONS_FAILED,   "net.connections_failed") \
+    X(NET_TIMEOUT_ERRORS,       "net.timeout_errors") \
+    X(NET_ERRORS,               "net.errors") \
+    X(MEM_ALLOCATIONS,          "mem.allocations") \
+    X(MEM_DEALLOCATIONS,        "mem.deallocations") \
+    X(MEM_ALLOC_FAILURES,       "mem.alloc_failures") \
+    X(MEM_FRAGMENTATION_EVENTS, "mem.fragmentation_events") \
+    X(AUDIO_ENCODED_FRAMES,     "audio.encoded_frames") \
+    X(AUDIO_DECODED_FRAMES,     "audio.decoded_frames") \
+    X(AUDIO_ENCODE_ERRORS,      "audio.encode_errors") \
+    X(AUDIO_DECODE_ERRORS,      "audio.decode_errors") \
+    X(AUDIO_ENCODE_RETRIES,     "audio.encode_retries") \
+    X(AUDIO_DECODE_RETRIES,     "audio.decode_retries") \
+    X(AUDIO_PCM_BYTES_IN,       "audio.pcm_bytes_in") \
+    X(AUDIO_BYTES_ENCODED,      "audio.bytes_encoded") \
+    X(AUDIO_BYTES_DECODED,      "audio.bytes_decoded") \
+    X(LOG_ERRORS,               "log.errors") \
+    X(LOG_WARNINGS,             "log.warnings") \
+    X(LOG_INFO,                 "log.info") \
+    X(LOG_DEBUG,                "log.debug") \
+    X(LOG_VERBOSE,              "log.verbose") \
+    X(UI_FRAMES,                "ui.frames") \
+    X(UI_FRAME_OVERRUNS,        "ui.frame_overruns") \
+    X(CAMERA_CAPTURES,          "camera.captures") \
+    X(CAMERA_IMAGES_SENT,       "camera.images_sent") \
+    X(CAMERA_IMAGES_RECEIVED,   "camera.images_received") \
+    X(CAMERA_SEND_FAILURES,     "camera.send_failures") \
+    X(CAMERA_RETRANSMITS,       "camera.retransmits") \
+    X(BULK_TRANSFERS_SENT,      "bulk.transfers_sent") \
+    X(BULK_TRANSFERS_RECEIVED,  "bulk.transfers_received") \
+    X(BULK_SEND_FAILURES,       "bulk.send_failures") \
+    X(BULK_MULTICASTS,          "bulk.multicasts") \
+    X(BULK_UNICAST_FALLBACKS,   "bulk.unicast_fallbacks") \
+    X(BULK_RETRANSMITS,         "bulk.retransmits") \
+    X(BULK_BYTES_SENT,          "bulk.bytes_sent") \
+    X(OUTBOX_QUEUED,            "outbox.queued") \
+    X(OUTBOX_DELIVERED,         "outbox.delivered") \
+    X(OUTBOX_RECEIVED,          "outbox.received") \
+    X(OUTBOX_CUSTODY_ACCEPTED,  "outbox.custody_accepted") \
+    X(OUTBOX_CUSTODY_HANDED,    "outbox.custody_handed") \
+    X(OUTBOX_EXPIRED,           "outbox.expired") \
+    X(OUTBOX_FLASH_BYTES,       "outbox.flash_bytes") \
+    X(TALKGROUP_RX_ACCEPTED,    "talkgroup.rx_accepted") \
+    X(TALKGROUP_RX_DROPPED,     "talkgroup.rx_dropped") \
+    X(TALKGROUP_TX_MULTICAST,   "talkgroup.tx_multicast") \
+    X(TALKGROUP_TX_UNICAST,     "talkgroup.tx_unicast") \
+    X(TALKGROUP_TX_SUPPRESSED,  "talkgroup.tx_suppressed") \
+    X(FLOOR_REQUESTS,           "floor.requests") \
+    X(FLOOR_TURNS,              "floor.turns") \
+    X(FLOOR_QUEUED,             "floor.queued") \
+    X(FLOOR_PREEMPTED,          "floor.preempted") \
+    X(FLOOR_DOUBLE_HOLDS,       "floor.double_holds") \
+    X(RECORDER_VOICE_BYTES,     "recorder.voice_bytes") \
+    X(RECORDER_FLASH_BYTES,     "recorder.flash_bytes") \
+    X(RECORDER_DROPPED,         "recorder.dropped") \
+    X(HISTORY_APPENDED,         "history.appended") \
+    X(HISTORY_FLASH_BYTES,      "history.flash_bytes") \
+    X(HISTORY_DROPPED,          "history.dropped") \
+    X(HISTORY_DAMAGED,          "history.damaged") \
+    X(POWER_TRANSITIONS,        "power.transitions") \
+    X(POWER_WAKES,              "power.wakes") \
+    X(BATTERY_LEVEL_CHANGES,    "battery.level_changes") \
+    X(AUDIO_RING_DROPS,         "audio.ring_drops") \
+    X(AUDIO_RX_DISCARDED,       "audio.rx_discarded")
+
+#define METRICS_GAUGES(X) \
+    X(NET_LAST_ACTIVITY,        "net.last_activity") \
+    X(MEM_CURRENT_ALLOCATIONS,  "mem.current_allocations") \
+    X(MEM_CURRENT_BYTES,        "mem.current_bytes") \
+    X(MEM_PEAK_BYTES,           "mem.peak_bytes") \
+    X(MEM_LEAKS,                "mem.leaks") \
+    X(MEM_LAST_CLEANUP,         "mem.last_cleanup") \
+    X(OUTBOX_PENDING,           "outbox.pending") \
+    X(HISTORY_MESSAGES,         "history.messages") \
+    X(POWER_STATE,              "power.state") \
+    X(BATTERY_PERCENT,          "battery.percent") \
+    X(BATTERY_MV,               "battery.mv") \
+    X(BATTERY_MINUTES,          "battery.minutes") \
+    X(BATTERY_LEVEL,            "battery.level") \
+    X(BOOT_VOICE_READY_MS,      "boot.voice_ready_ms") \
+    X(BOOT_SETTLED_MS,          "boot.settled_ms") \
+    X(AUDIO_CORE0_LOAD_PCT,     "audio.core0_load_pct") \
+    X(AUDIO_CORE1_LOAD_PCT,     "audio.core1_load_pct")
+
+#define METRICS_HISTOGRAMS(X) \
+    X(MEM_ALLOCATION_SIZE,      "mem.allocation_size") \
+    X(AUDIO_ENCODE_TIME_US,     "audio.encode_time_us") \
+    X(AUDIO_DECODE_TIME_US,     "audio.decode_time_us") \
+    X(UI_FRAME_TIME_US,         "ui.frame_time_us") \
+    X(CAMERA_REENCODE_TIME_US,  "camera.reencode_time_us") \
+    X(CAMERA_PREVIEW_LATENCY_MS, "camera.preview_latency_ms") \
+    X(CAMERA_TRANSFER_TIME_MS,  "camera.transfer_time_ms") \
+    X(BULK_TRANSFER_TIME_MS,    "bulk.transfer_time_ms") \
+    X(FLOOR_PTT_LATENCY_MS,     "floor.ptt_latency_ms") \
+    X(AUDIO_TX_LATENCY_US,      "audio.tx_latency_us") \
+    X(AUDIO_RX_LATENCY_US,      "audio.rx_latency_us") \
+    X(AUDIO_SIDETONE_LATENCY_US, "audio.sidetone_latency_us") \
+    X(AUDIO_RELEASE_LATENCY_US, "audio.release_latency_us")
+
+#define METRICS_ENUM_ENTRY(id, name) METRIC_##id,
+
+typedef enum {
+    METRICS_COUNTERS(METRICS_ENUM_ENTRY)
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+typedef enum {
+    METRICS_GAUGES(METRICS_ENUM_ENTRY)
+    METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+typedef enum {
+    METRICS_HISTOGRAMS(METRICS_ENUM_ENTRY)
+    METRIC_HISTOGRAM_COUNT
+} metric_histogram_t;
+
+#undef METRICS_ENUM_ENTRY
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+#define METRICS_HISTOGRAM_SUB_BITS 3
+#define METRICS_HISTOGRAM_MAX_VALUE ((1u << 24) - 1)   // Larger values are clamped
+#define METRICS_HISTOGRAM_BUCKETS 176
+
+// Binary export format version (first byte after the magic)
+#define METRICS_FORMAT_VERSION 1
+
+// Worst-case encoded snapshot size
+#define METRICS_MAX_ENCODED_SIZE \
+    (10 + METRIC_COUNTER_COUNT * 4 + METRIC_GAUGE_COUNT * 4 + METRIC_HISTOGRAM_COUNT * 28)
+
+// ============================================================================
+// SNAPSHOT
+// ============================================================================
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;                   ///< Lower bound of the lowest non-empty bucket
+    uint32_t max;                   ///< Exact maximum
+    uint32_t mean;                  ///< Estimated from bucket midpoints
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+} metrics_histogram_summary_t;
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t counters[METRIC_COUNTER_COUNT];
+    int32_t gauges[METRIC_GAUGE_COUNT];
+    metrics_histogram_summary_t histograms[METRIC_HISTOGRAM_COUNT];
+} metrics_snapshot_t;
+
+// ============================================================================
+// UPDATE API (lock-free)
+// ============================================================================
+
+/**
+ * @brief Add to a counter on the calling core
+ */
+void metrics_counter_add(metric_counter_t id, uint32_t delta);
+
+/**
+ * @brief Add one to a counter
+ */
+void metrics_counter_inc(metric_counter_t id);
+
+/**
+ * @brief Set a gauge
+ */
+void metrics_gauge_set(metric_gauge_t id, int32_t value);
+
+/**
+ * @brief Add to a gauge (negative deltas decrement)
+ */
+void metrics_gauge_add(metric_gauge_t id, int32_t delta);
+
+/**
+ * @brief Raise a gauge to value if value is higher
+ */
+void metrics_gauge_max(metric_gauge_t id, int32_t value);
+
+/**
+ * @brief Record one value in a histogram
+ */
+void metrics_histogram_record(metric_histogram_t id, uint32_t value);
+
+// ============================================================================
+// READ AND EXPORT API
+// ============================================================================
+
+/**
+ * @brief Current counter value, summed over all cores
+ */
+uint32_t metrics_counter_get(metric_counter_t id);
+
+/**
+ * @brief Current gauge value
+ */
+int32_t metrics_gauge_get(metric_gauge_t id);
+
+/**
+ * @brief Summarize a histogram
+ */
+void metrics_histogram_get(metric_histogram_t id, metrics_histogram_summary_t* summary);
+
+/**
+ * @brief Reset individual metrics to zero
+ *
+ * Updates racing with a reset may be kept or lost.
+ */
+void metrics_counter_reset(metric_counter_t id);
+void metrics_gauge_reset(metric_gauge_t id);
+void metrics_histogram_reset(metric_histogram_t id);
+
+/**
+ * @brief Metric names ("group.name")
+ */
+const char* metrics_counter_name(metric_counter_t id);
+const char* metrics_gauge_name(metric_gauge_t id);
+const char* metrics_histogram_name(metric_histogram_t id);
+
+/**
+ * @brief Copy all metrics
+ */
+void metrics_snapshot(metrics_snapshot_t* snapshot);
+
+/**
+ * @brief Encode a snapshot into the compact binary format
+ *
+ * Layout, little endian:
+ *   'M' 'X' version u8 | timestamp_ms u32 | counter_count u8 | gauge_count u8 |
+ *   histogram_count u8 | counters u32[] | gauges i32[] |
+ *   per histogram: count, min, max, mean, p50, p90, p99 (u32 each)
+ *
+ * Metrics appear in table order; the counts let a reader built against an
+ * older table skip entries it does not know.
+ *
+ * @return Encoded length, or 0 if the buffer is too small
+ */
+size_t metrics_encode(const metrics_snapshot_t* snapshot, uint8_t* buffer, size_t buffer_size);
+
+/**
+ * @brief Format a snapshot as text, one "name value" line per metric
+ *
+ * Histograms are printed as "name count=N mean=N p50=N p90=N p99=N max=N".
+ * @return Characters written (excluding the terminator); output is
+ *         truncated at a line boundary if the buffer is too small
+ */
+size_t metrics_format_text(const metrics_snapshot_t* snapshot, char* buffer, size_t buffer_size);
+
+/**
+ * @brief Log all non-zero metrics
+ */
+void metrics_log(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_REGISTRY_H
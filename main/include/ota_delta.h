@@ -0,0 +1,162 @@
+/**
+ * @file ota_delta.h
+ * @brief Binary delta format for firmware updates against the running image
+ *
+ * A delta rebuilds a new firmware image from the image a node is running,
+ * so only the differences travel over the mesh. It follows bsdiff: the new
+ * image is described as regions that are (almost) found in the old image
+ * plus literal bytes that are not. A region found with a few changed bytes,
+ * typically code whose branch targets and data pointers moved, is stored as
+ * the byte-wise difference against the old bytes, which is mostly zeros.
+ * The op stream is then LZSS compressed (as heatshrink does) with a window
+ * small enough to decode on the node, which turns those zeros into a few
+ * bytes.
+ *
+ * File layout (little endian):
+ *
+ *   header   "ADLT", version, flags, reserved[2], old_size u32, new_size u32
+ *   body     op stream, LZSS compressed if OTA_DELTA_FLAG_LZSS is set
+ *
+ * Ops, with varint (LEB128) lengths and offsets:
+ *
+ *   COPY  offset len         new = old[offset .. offset+len)
+ *   DIFF  offset len bytes   new[i] = old[offset+i] + bytes[i]
+ *   ADD   len bytes          new = bytes
+ *   END
+ *
+ * Patching streams: the patcher takes the delta in pieces of any size,
+ * reads the old image through a callback and hands the new image to a
+ * write callback in order, so it can feed esp_ota_write() directly with
+ * about 5 KB of state.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define OTA_DELTA_MAGIC "ADLT"
+#define OTA_DELTA_VERSION 1
+#define OTA_DELTA_HEADER_SIZE 16
+#define OTA_DELTA_FLAG_LZSS 0x01
+
+// LZSS parameters: 4 KB window, matches of 3 to 273 bytes
+#define OTA_DELTA_LZSS_WINDOW 4096
+#define OTA_DELTA_LZSS_MIN_MATCH 3
+
+/**
+ * @brief Delta header fields
+ */
+typedef struct {
+    uint8_t version;
+    uint8_t flags;
+    uint32_t old_size;              ///< Size of the image the delta applies to
+    uint32_t new_size;              ///< Size of the image it produces
+} ota_delta_header_t;
+
+/**
+ * @brief Patcher status
+ */
+typedef enum {
+    OTA_DELTA_OK = 0,               ///< Input consumed, more expected
+    OTA_DELTA_DONE,                 ///< END reached, all output written
+    OTA_DELTA_ERR_FORMAT,           ///< Bad header or op
+    OTA_DELTA_ERR_RANGE,            ///< Op outside the old or new image
+    OTA_DELTA_ERR_READ,             ///< Old image read failed
+    OTA_DELTA_ERR_WRITE             ///< Output write failed
+} ota_delta_status_t;
+
+// Old image reader and new image writer; return false on I/O error
+typedef bool (*ota_delta_read_fn)(void* ctx, uint32_t offset, uint8_t* data, size_t length);
+typedef bool (*ota_delta_write_fn)(void* ctx, const uint8_t* data, size_t length);
+
+/**
+ * @brief Build a delta that turns old_image into new_image
+ * @param compress LZSS compress the op stream
+ * @return false if an image is larger than the format allows
+ */
+bool ota_delta_encode(const uint8_t* old_image, size_t old_size,
+                      const uint8_t* new_image, size_t new_size,
+                      std::vector<uint8_t>* delta, bool compress = true);
+
+/**
+ * @brief Parse a delta header
+ * @return false if the data is not a delta of a supported version
+ */
+bool ota_delta_parse_header(const uint8_t* data, size_t length, ota_delta_header_t* header);
+
+/**
+ * @brief Streaming delta patcher
+ *
+ * Call feed() with consecutive pieces of the delta until it returns
+ * OTA_DELTA_DONE or an error. The write callback only ever sees whole new
+ * image bytes in order, so a failed patch leaves a truncated output that
+ * the caller discards (esp_ota_abort()).
+ */
+class OtaDeltaPatcher {
+public:
+    OtaDeltaPatcher(ota_delta_read_fn readOld, ota_delta_write_fn writeNew, void* ctx);
+
+    ota_delta_status_t feed(const uint8_t* data, size_t length);
+
+    const ota_delta_header_t& header() const { return m_header; }
+    uint32_t bytesWritten() const { return m_written; }
+
+private:
+    enum OpState {
+        STATE_CODE,
+        STATE_OFFSET,
+        STATE_LENGTH,
+        STATE_BODY,
+        STATE_END
+    };
+
+    ota_delta_status_t decompressByte(uint8_t byte);
+    ota_delta_status_t opByte(uint8_t byte);
+    ota_delta_status_t emit(uint8_t byte);
+    ota_delta_status_t startBody();
+    ota_delta_status_t flush();
+    bool oldByte(uint32_t offset, uint8_t* byte);
+
+    ota_delta_read_fn m_readOld;
+    ota_delta_write_fn m_writeNew;
+    void* m_ctx;
+
+    // Header
+    uint8_t m_headerBytes[OTA_DELTA_HEADER_SIZE];
+    size_t m_headerFill;
+    ota_delta_header_t m_header;
+
+    // LZSS decoder: flag byte, bits left in it, partial match token
+    uint8_t m_window[OTA_DELTA_LZSS_WINDOW];
+    uint32_t m_windowPos;
+    uint8_t m_flags;
+    uint8_t m_flagBits;
+    uint8_t m_token[3];
+    uint8_t m_tokenFill;
+
+    // Op parser
+    OpState m_state;
+    uint8_t m_op;
+    uint32_t m_varint;
+    uint8_t m_varintShift;
+    uint32_t m_offset;
+    uint32_t m_remaining;
+
+    // Old image read cache and new image write buffer
+    uint8_t m_oldCache[256];
+    uint32_t m_oldCacheStart;
+    uint32_t m_oldCacheLength;
+    uint8_t m_out[1024];
+    size_t m_outFill;
+    uint32_t m_written;
+    bool m_done;
+};
+
+#endif // OTA_DELTA_H
@@ -0,0 +1,281 @@
+/**
+ * @file ota_mesh.h
+ * @brief Peer-to-peer distribution of firmware deltas over the mesh
+ *
+ * One node seeds an update: a manifest plus a delta (ota_delta.h) against
+ * the firmware the squad is running. The delta is cut into fixed-size
+ * chunks and spreads through the mesh in the style of Deluge:
+ *
+ * - ANNOUNCE  holders broadcast the manifest and a bitmap of the chunks
+ *             they have, on a Trickle-like timer that starts fast and
+ *             backs off while nobody asks for anything
+ * - REQUEST   a node missing chunks names the holder that has most of a
+ *             window of up to 32 chunks and broadcasts a request for them
+ * - CHUNK     the holder broadcasts each requested chunk with a CRC-32, so
+ *             every node that still needs it takes it from the same frame
+ *
+ * Requests are suppressed while chunks are already flowing, so nodes that
+ * need the same window share one transfer. Any node holding a chunk can
+ * serve it, including nodes that are still fetching, which carries the
+ * update across multiple hops.
+ *
+ * Manifests are signed with Ed25519 by the release key (ota_delta_tool
+ * --key), and frames travel unencrypted, so a node checks the signature
+ * against the public key built into its firmware before it adopts,
+ * resumes or seeds an update; nothing is fetched for a manifest that does
+ * not verify. The chunks need no signature of their own: the signed
+ * manifest carries the delta's hash. A failed check makes the node skip
+ * unverified manifests for announce_min_ms, so forged announces cannot
+ * keep it busy verifying.
+ *
+ * Only nodes whose running image matches the manifest's base hash fetch
+ * an update; a delta is useless to anyone else. The bitmap and manifest
+ * are saved through the chunk store every few chunks so an interrupted
+ * transfer resumes where it stopped. When every chunk is in, the delta's
+ * SHA-256 is checked and the completion callback applies it.
+ *
+ * The distributor is the mesh's lowest traffic class: it sends nothing
+ * for foreground_holdoff_ms after any other mesh traffic was seen, and
+ * chunks are paced by a token bucket at serve_rate_bps.
+ *
+ * The class holds protocol state only; it does no I/O except through the
+ * store and the send function, takes the time as an argument and is not
+ * thread safe, so the host simulation can run many nodes in one process.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef OTA_MESH_H
+#define OTA_MESH_H
+
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OTA_SHA256_SIZE 32
+#define OTA_SIGNATURE_SIZE 64                       // Ed25519
+#define OTA_PUBLIC_KEY_SIZE 32
+#define OTA_SECRET_KEY_SIZE 64                      // Seed, then public key
+#define OTA_MANIFEST_VERSION_LEN 16
+#define OTA_MANIFEST_SIGNED_SIZE (4 + OTA_MANIFEST_VERSION_LEN + 12 + 2 + 3 * OTA_SHA256_SIZE)
+#define OTA_MANIFEST_ENCODED_SIZE (OTA_MANIFEST_SIGNED_SIZE + OTA_SIGNATURE_SIZE)
+#define OTA_MESH_DEFAULT_CHUNK_SIZE 1024
+#define OTA_MESH_REQUEST_SPAN 32
+
+/**
+ * @brief Update description, as stored on the seed node and announced
+ */
+struct OtaManifest {
+    uint32_t update_id;                             ///< First four bytes of the delta hash
+    char version[OTA_MANIFEST_VERSION_LEN];         ///< Target firmware version, NUL padded
+    uint32_t base_size;                             ///< Image the delta applies to
+    uint32_t target_size;                           ///< Image the delta produces
+    uint32_t delta_size;
+    uint16_t chunk_size;
+    uint8_t base_sha256[OTA_SHA256_SIZE];
+    uint8_t target_sha256[OTA_SHA256_SIZE];
+    uint8_t delta_sha256[OTA_SHA256_SIZE];
+    uint8_t signature[OTA_SIGNATURE_SIZE];          ///< Over the fields above, as encoded
+
+    uint32_t chunkCount() const {
+        return chunk_size ? (delta_size + chunk_size - 1) / chunk_size : 0;
+    }
+};
+
+// Manifest wire and file format (fixed size, little endian)
+void ota_manifest_encode(const OtaManifest& manifest, std::vector<uint8_t>* out);
+bool ota_manifest_decode(const uint8_t* data, size_t length, OtaManifest* manifest);
+
+// Build the manifest for a delta made by ota_delta_encode()
+bool ota_manifest_create(const uint8_t* base, size_t base_size,
+                         const uint8_t* target, size_t target_size,
+                         const std::vector<uint8_t>& delta, const char* version,
+                         uint16_t chunk_size, OtaManifest* manifest);
+
+// Sign a manifest with the release key; verify it against the trusted key
+bool ota_manifest_sign(OtaManifest* manifest, const uint8_t secretKey[OTA_SECRET_KEY_SIZE]);
+bool ota_manifest_verify(const OtaManifest& manifest, const uint8_t publicKey[OTA_PUBLIC_KEY_SIZE]);
+
+// SHA-256 and CRC-32 helpers shared with the updater
+void ota_sha256(const uint8_t* data, size_t length, uint8_t digest[OTA_SHA256_SIZE]);
+uint32_t ota_crc32(const uint8_t* data, size_t length);
+
+/**
+ * @brief Where received delta chunks and transfer progress are kept
+ */
+class IOtaChunkStore {
+public:
+    virtual ~IOtaChunkStore() = default;
+
+    // Prepare to receive the update, discarding any other stored update
+    virtual bool begin(const OtaManifest& manifest) = 0;
+    virtual bool writeChunk(uint32_t index, const uint8_t* data, size_t length) = 0;
+    // Read delta bytes (chunks are stored at index * chunk_size)
+    virtual bool read(uint32_t offset, uint8_t* data, size_t length) = 0;
+
+    // Progress survives restarts
+    virtual bool saveProgress(const OtaManifest& manifest, const std::vector<uint8_t>& bitmap) = 0;
+    virtual bool loadProgress(OtaManifest* manifest, std::vector<uint8_t>* bitmap) = 0;
+};
+
+/**
+ * @brief Distributor timing and pacing
+ */
+typedef struct {
+    uint32_t announce_min_ms;           ///< Announce interval after something changed
+    uint32_t announce_max_ms;           ///< Interval it doubles up to while nothing does
+    uint32_t request_quiet_ms;          ///< Chunk silence before this node asks for more
+    uint32_t request_timeout_ms;        ///< Ask again if a request got no answer
+    uint32_t peer_timeout_ms;           ///< Forget holders not heard for this long
+    uint32_t serve_rate_bps;            ///< Chunk bytes per second this node may send
+    uint32_t foreground_holdoff_ms;     ///< Silence after other mesh traffic
+    uint8_t request_window;             ///< Chunks asked for at once (<= 32)
+    uint16_t save_every;                ///< Chunks between progress saves
+} ota_mesh_config_t;
+
+/**
+ * @brief Distributor state
+ */
+typedef enum {
+    OTA_MESH_IDLE = 0,          ///< No update for this node's firmware known
+    OTA_MESH_FETCHING,          ///< Collecting chunks
+    OTA_MESH_COMPLETE           ///< Whole delta stored and verified; serving it
+} ota_mesh_state_t;
+
+/**
+ * @brief Distributor counters
+ */
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t bytes_sent;
+    uint32_t announces_sent;
+    uint32_t requests_sent;
+    uint32_t requests_suppressed;       ///< Requests deferred because chunks were flowing
+    uint32_t chunks_sent;
+    uint32_t chunks_received;           ///< New chunks stored
+    uint32_t chunks_duplicate;          ///< Chunks heard that this node already had
+    uint32_t chunks_bad;                ///< CRC mismatches and store failures
+    uint32_t verify_failures;           ///< Complete deltas that failed the hash check
+    uint32_t signature_failures;        ///< Manifests not signed by the trusted key
+} ota_mesh_stats_t;
+
+/**
+ * @brief Default timing for a HaLow mesh
+ */
+ota_mesh_config_t ota_mesh_default_config(void);
+
+class OtaMeshNode {
+public:
+    // Broadcast one frame; returns false if it could not be sent
+    typedef std::function<bool(const std::vector<uint8_t>& frame)> SendFunction;
+    typedef std::function<void(const OtaManifest& manifest)> CompleteFunction;
+
+    /**
+     * @param nodeId        Name this node announces itself under (at most
+     *                      255 bytes); requests name the holder they are for
+     * @param runningSha256 Hash of the running image; selects which updates apply
+     * @param trustedKey    Public key that update manifests must be signed with
+     * @param store         Chunk store; must outlive the node
+     * @param seed          Random seed for timer jitter
+     */
+    OtaMeshNode(const std::string& nodeId, const uint8_t runningSha256[OTA_SHA256_SIZE],
+                const uint8_t trustedKey[OTA_PUBLIC_KEY_SIZE], IOtaChunkStore* store, SendFunction send,
+                const ota_mesh_config_t& config, uint32_t seed);
+
+    // Continue a transfer saved in the store. A complete delta whose target
+    // is the running image (this node already updated) is served as well.
+    bool resume(uint32_t nowMs);
+
+    // Start serving an update whose whole delta is already in the store;
+    // false if the manifest is not signed by the trusted key
+    bool seed(const OtaManifest& manifest, uint32_t nowMs);
+
+    void setCompleteCallback(CompleteFunction callback) { m_onComplete = callback; }
+
+    // Feed a received frame
+    void handleFrame(const uint8_t* data, size_t length, uint32_t nowMs);
+
+    // Other mesh traffic was seen or sent; stay quiet for a while
+    void noteForegroundTraffic(uint32_t nowMs);
+
+    // Refuse an update (e.g. the patch failed to apply) and stop serving it
+    void reject(uint32_t updateId);
+
+    // Send due announces, requests and chunks. Call every 10 - 50 ms.
+    void tick(uint32_t nowMs);
+
+    ota_mesh_state_t state() const { return m_state; }
+    const OtaManifest& manifest() const { return m_manifest; }
+    uint32_t chunksHave() const { return m_have; }
+    const ota_mesh_stats_t& stats() const { return m_stats; }
+    const std::string& nodeId() const { return m_nodeId; }
+
+    // True if the data is a distributor frame (cheap check for routing)
+    static bool isOtaFrame(const uint8_t* data, size_t length);
+
+private:
+    struct Holder {
+        std::vector<uint8_t> bitmap;
+        uint32_t have;
+        uint32_t lastHeardMs;
+    };
+
+    void adopt(const OtaManifest& manifest, uint32_t nowMs);
+    bool verified(const OtaManifest& manifest);
+    void handleAnnounce(const uint8_t* body, size_t length, uint32_t nowMs);
+    void handleRequest(const uint8_t* body, size_t length, uint32_t nowMs);
+    void handleChunk(const uint8_t* body, size_t length, uint32_t nowMs);
+    void checkComplete(uint32_t nowMs);
+
+    void sendAnnounce();
+    bool sendRequest(uint32_t nowMs);
+    bool serveChunk(uint32_t index);
+    bool send(uint8_t type, const std::vector<uint8_t>& body);
+    void resetAnnounceTimer(uint32_t nowMs);
+
+    bool has(uint32_t index) const { return (m_bitmap[index / 8] >> (index % 8)) & 1; }
+    uint32_t jitter(uint32_t ms);
+
+    std::string m_nodeId;
+    uint8_t m_runningSha256[OTA_SHA256_SIZE];
+    uint8_t m_trustedKey[OTA_PUBLIC_KEY_SIZE];
+    IOtaChunkStore* m_store;
+    SendFunction m_send;
+    CompleteFunction m_onComplete;
+    ota_mesh_config_t m_config;
+    std::mt19937 m_rng;
+
+    ota_mesh_state_t m_state;
+    OtaManifest m_manifest;
+    std::vector<uint8_t> m_bitmap;
+    uint32_t m_have;
+    uint32_t m_unsaved;
+    std::vector<uint32_t> m_rejected;
+    std::map<std::string, Holder> m_holders;
+
+    // Timers (absolute ms)
+    uint32_t m_announceIntervalMs;
+    uint32_t m_nextAnnounceMs;
+    uint32_t m_nextRequestMs;
+    uint32_t m_holdoffUntilMs;
+    uint32_t m_requestCursor;           // Request window to look at first
+    uint32_t m_verifyAfterMs;           // Unverified manifests are skipped until then
+    bool m_verifyHeld;
+
+    // Serving: requested chunks in arrival order, token bucket in bytes
+    std::vector<uint32_t> m_serveQueue;
+    std::vector<uint8_t> m_queued;
+    double m_tokens;
+    uint32_t m_lastTickMs;
+    bool m_clockStarted;
+
+    ota_mesh_stats_t m_stats;
+};
+
+#endif // OTA_MESH_H
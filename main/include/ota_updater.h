@@ -1,25 +1,107 @@
+/**
+ * @file ota_updater.h
+ * @brief Mesh-distributed delta firmware updates with A/B partitions
+ *
+ * Updates travel between nodes instead of from a server. A seed node holds
+ * a delta against the squad's running firmware and a manifest, both made
+ * on a workstation with the host tool ota_delta_tool and uploaded to the
+ * SPIFFS storage partition as /spiffs/ota.delta and /spiffs/ota.manifest.
+ * Every node whose running image matches the manifest's base hash fetches
+ * the delta over the mesh (ota_mesh.h) into the same file, at the lowest
+ * priority on the channel, and then serves it on to others.
+ *
+ * When the delta is complete and verified, the updater patches it against
+ * the running partition straight into the passive OTA partition with
+ * esp_ota_write(), checks the SHA-256 of the result against the manifest,
+ * lets esp_ota_end() validate the image (and its signature when signed
+ * app verification is enabled) and selects it for the next boot. The
+ * switch happens at the next restart or ota_updater_perform_update().
+ *
+ * Rollback: a freshly updated image boots in the pending-verify state. It
+ * is marked valid once the mesh link comes up; if that has not happened
+ * within OTA_VERIFY_TIMEOUT_MS the updater marks it invalid and reboots,
+ * and the bootloader returns to the previous image.
+ *
+ * Transfer progress is kept in NVS, so a node that loses power mid-way
+ * resumes with the chunks it already has.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
 #ifndef OTA_UPDATER_H
 #define OTA_UPDATER_H
 
-// OTA Updater Service - Stub Implementation
-// This is a placeholder for the OTA (Over-The-Air) update functionality
+#include <stdbool.h>
+#include <stdint.h>
+
+// Task and timing
+#define OTA_TASK_STACK_SIZE (6 * 1024)
+#define OTA_TASK_PRIORITY 1                 // Lowest application priority
+#define OTA_TICK_MS 50
+#define OTA_FRAME_QUEUE_DEPTH 16
+#define OTA_VERIFY_TIMEOUT_MS 120000        // New image must reach the mesh within this
+
+// Files on the storage partition
+#define OTA_SPIFFS_BASE_PATH "/spiffs"
+#define OTA_SPIFFS_PARTITION "storage"
+#define OTA_DELTA_PATH OTA_SPIFFS_BASE_PATH "/ota.delta"
+#define OTA_MANIFEST_PATH OTA_SPIFFS_BASE_PATH "/ota.manifest"
+
+/**
+ * @brief Updater state
+ */
+typedef enum {
+    OTA_UPDATER_IDLE = 0,           ///< No update for this firmware known
+    OTA_UPDATER_FETCHING,           ///< Collecting delta chunks from the mesh
+    OTA_UPDATER_APPLYING,           ///< Writing the new image to the passive partition
+    OTA_UPDATER_READY,              ///< New image selected for the next boot
+    OTA_UPDATER_FAILED              ///< Patch or image check failed; still serving the delta
+} ota_updater_state_t;
+
+/**
+ * @brief Updater status snapshot
+ */
+typedef struct {
+    ota_updater_state_t state;
+    uint32_t update_id;
+    char version[16];               ///< Target firmware version
+    uint32_t chunks_have;
+    uint32_t chunks_total;
+    uint32_t delta_size;            ///< Bytes that travel over the mesh
+    uint32_t target_size;           ///< Size of the image they rebuild
+    uint32_t bytes_sent;            ///< Distributor frames sent by this node
+    bool pending_verify;            ///< Running a new image that is not yet confirmed
+} ota_updater_status_t;
 
 /**
  * @brief Initialize the OTA updater service
+ *
+ * Mounts the storage partition, resumes or seeds a stored update, hooks
+ * the distributor into the mesh manager and starts the OTA task. Call
+ * before the network task brings the radio up.
+ *
  * @return 0 on success, error code on failure
  */
 int ota_updater_init(void);
 
 /**
  * @brief Check for available firmware updates
- * @return 0 if check successful, error code on failure
+ * @return 1 if an update is being fetched or is ready, 0 if none, negative on error
  */
 int ota_updater_check_for_updates(void);
 
 /**
- * @brief Perform firmware update if available
- * @return 0 if update successful, error code on failure
+ * @brief Restart into the updated image
+ * @return Does not return on success; error code if no update is ready
  */
 int ota_updater_perform_update(void);
 
-#endif // OTA_UPDATER_H
\ No newline at end of file
+/**
+ * @brief Get the current updater status
+ * @return false if the updater is not running
+ */
+bool ota_updater_get_status(ota_updater_status_t* status);
+
+#endif // OTA_UPDATER_H
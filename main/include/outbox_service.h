@@ -0,0 +1,77 @@
+/**
+ * @file outbox_service.h
+ * @brief Store-and-forward messages to single peers on OUTBOX_PORT
+ *
+ * One task drives the node's MessageOutbox (message_outbox.h) and its log
+ * in the SPIFFS storage partition; senders reach it under a mutex. A
+ * message sent here is written to flash at once and sent when its
+ * destination, or a node that can carry it there, is in range. The neighbour table is fed from the mesh
+ * manager's peer events and every frame received, and checked against the
+ * radio's peer list every few seconds in case an event was missed.
+ *
+ * Callbacks run on the outbox task and should return quickly.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef OUTBOX_SERVICE_H
+#define OUTBOX_SERVICE_H
+
+#include "message_outbox.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Task and timing
+#define OUTBOX_SERVICE_TASK_STACK_SIZE (6 * 1024)
+#define OUTBOX_SERVICE_TASK_PRIORITY 2
+#define OUTBOX_SERVICE_TICK_MS 100
+#define OUTBOX_SERVICE_EVENT_QUEUE_DEPTH 32
+#define OUTBOX_SERVICE_RECONCILE_MS 5000    // Radio peer list against the neighbour table
+
+// Log file in the storage partition
+#define OUTBOX_LOG_PATH "/spiffs/outbox.log"
+#define OUTBOX_LOG_TEMP_PATH "/spiffs/outbox.tmp"
+
+/**
+ * @brief A message for this node arrived
+ */
+typedef void (*outbox_receive_handler_t)(const char* origin, const uint8_t* data, size_t length);
+
+/**
+ * @brief A message sent with OUTBOX_FLAG_RECEIPT reached its destination
+ */
+typedef void (*outbox_receipt_handler_t)(const char* destination, uint32_t message_id);
+
+/**
+ * @brief Initialize the outbox service: hook into the mesh manager and start the task
+ *
+ * The stored messages are loaded once the radio has an address.
+ *
+ * @return 0 on success, error code on failure
+ */
+int outbox_service_init(void);
+
+/**
+ * @brief Register the message and receipt handlers; either may be NULL
+ */
+void outbox_service_set_handlers(outbox_receive_handler_t receive, outbox_receipt_handler_t receipt);
+
+/**
+ * @brief Queue a message for a peer
+ * @param priority outbox_priority_t
+ * @param flags    OUTBOX_FLAG_RECEIPT and OUTBOX_FLAG_CUSTODY
+ * @return Message ID, 0 if the service is not running, the outbox is full or the message invalid
+ */
+uint32_t outbox_service_send(const char* destination, const uint8_t* data, size_t length, uint8_t priority,
+                             uint8_t flags);
+
+/**
+ * @brief Get outbox counters and the number of messages held
+ * @return false if the outbox is not loaded yet
+ */
+bool outbox_service_get_stats(outbox_stats_t* stats, uint32_t* pending);
+
+#endif // OUTBOX_SERVICE_H
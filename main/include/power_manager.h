@@ -0,0 +1,199 @@
+/**
+ * @file power_manager.h
+ * @brief Activity states, per-state power policy and wake accounting
+ *
+ * The node is in one of four activity states, worked out from what the
+ * tasks report:
+ *
+ * - TRANSMITTING while the transmitter is keyed.
+ * - LISTENING for listen_hold_ms after voice was heard, user_hold_ms
+ *   after a button press and data_hold_ms after a text or data frame.
+ *   The user may key up or answer at any moment, so the radio stays
+ *   awake and the tasks poll at full rate.
+ * - NAVIGATING while the map is shown: the GPS is read often and the
+ *   screen redrawn, but nothing needs real-time audio.
+ * - IDLE otherwise.
+ *
+ * Each state has a policy: the CPU frequency range for dynamic frequency
+ * scaling, whether light sleep is allowed, how often the HaLow radio
+ * wakes to receive (0: always awake; otherwise the TWT or listen
+ * interval), and the poll interval of each polling task. Every task wake
+ * is counted against the state it happened in, and the time spent in
+ * each state is kept, so the estimate below can be checked against what
+ * the tasks really did.
+ *
+ * Current cannot be measured on the host. power_estimate_current_ma()
+ * turns a policy, a wake rate and a current model of the board into an
+ * average current, from which the battery life in each state follows.
+ *
+ * The class does no I/O, takes the time as an argument and is not thread
+ * safe, so the host simulation can drive it directly.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Activity state, lowest power first
+ */
+typedef enum {
+    POWER_STATE_IDLE = 0,
+    POWER_STATE_NAVIGATING,
+    POWER_STATE_LISTENING,
+    POWER_STATE_TRANSMITTING,
+    POWER_STATE_COUNT
+} power_state_t;
+
+/**
+ * @brief What the tasks report
+ */
+typedef enum {
+    POWER_ACTIVITY_TRANSMIT = 0,            ///< Held: transmitter keyed
+    POWER_ACTIVITY_NAVIGATE,                ///< Held: map shown
+    POWER_ACTIVITY_VOICE,                   ///< Event: voice frame received
+    POWER_ACTIVITY_USER,                    ///< Event: button pressed
+    POWER_ACTIVITY_DATA,                    ///< Event: text or data frame received
+    POWER_ACTIVITY_COUNT
+} power_activity_t;
+
+/**
+ * @brief Who woke the CPU
+ */
+typedef enum {
+    POWER_WAKE_UI = 0,
+    POWER_WAKE_AUDIO,
+    POWER_WAKE_NETWORK,
+    POWER_WAKE_GPS,
+    POWER_WAKE_RADIO,                       ///< Radio service period or received frame
+    POWER_WAKE_MANAGER,                     ///< The power task's own tick
+    POWER_WAKE_COUNT
+} power_wake_source_t;
+
+/**
+ * @brief How the node runs in one state
+ */
+typedef struct {
+    uint16_t cpu_max_mhz;
+    uint16_t cpu_min_mhz;                   ///< DFS floor when no PM lock is held
+    bool light_sleep;                       ///< Sleep between task wakes
+    uint32_t radio_wake_ms;                 ///< Radio receive interval; 0 keeps it awake
+    uint32_t poll_ms[POWER_WAKE_COUNT];     ///< Task poll interval; 0 for the radio, which is not polled
+} power_policy_t;
+
+/**
+ * @brief State hold times and the policy of each state
+ */
+typedef struct {
+    uint32_t listen_hold_ms;                ///< LISTENING after the last voice frame
+    uint32_t user_hold_ms;                  ///< ... after the last button press
+    uint32_t data_hold_ms;                  ///< ... after the last data frame
+    power_policy_t policy[POWER_STATE_COUNT];
+} power_config_t;
+
+/**
+ * @brief Board current model, per part, in mA unless stated
+ *
+ * Typical ESP32-S3 and HaLow module figures; replace with bench
+ * measurements of a board when available.
+ */
+typedef struct {
+    float cpu_ma_per_mhz;                   ///< Active CPU, above cpu_base_ma
+    float cpu_base_ma;                      ///< Active CPU at 0 MHz (clock tree, RAM)
+    float cpu_idle_fraction;                ///< Current of an idle (WFI) CPU relative to active
+    float light_sleep_ma;                   ///< Chip in light sleep
+    float wake_uc;                          ///< Charge per light sleep wake (exit and entry), uC
+    float radio_rx_ma;                      ///< HaLow module awake, receiving
+    float radio_tx_ma;                      ///< HaLow module transmitting
+    float radio_doze_ma;                    ///< HaLow module between service periods
+    uint32_t radio_window_ms;               ///< Awake time per service period
+    float display_ma;
+    float gps_ma;
+    float audio_ma;                         ///< Codec and amplifier, when audio runs
+    float battery_mah;
+} power_current_model_t;
+
+/**
+ * @brief Power counters
+ */
+typedef struct {
+    uint32_t time_ms[POWER_STATE_COUNT];
+    uint32_t entries[POWER_STATE_COUNT];
+    uint32_t wakes[POWER_STATE_COUNT];
+    uint32_t wakes_by_source[POWER_WAKE_COUNT];
+    uint32_t transitions;
+} power_stats_t;
+
+/**
+ * @brief Hold times and per-state policy for the task layout of this firmware
+ */
+power_config_t power_default_config(void);
+
+/**
+ * @brief A current model for an XIAO ESP32-S3 with a HaLow module, display and GPS
+ */
+power_current_model_t power_default_current_model(void);
+
+const char* power_state_name(power_state_t state);
+
+/**
+ * @brief CPU wakes per second a policy causes by polling alone
+ */
+float power_policy_wakes_per_second(const power_policy_t& policy);
+
+/**
+ * @brief Average current in a state
+ * @param policy         The state's policy
+ * @param cpu_busy       Share of time the CPU runs (0 - 1)
+ * @param wakes_per_s    CPU wakes per second, measured or power_policy_wakes_per_second()
+ * @param transmitting   Radio and audio are sending
+ * @param audio          Audio path running
+ */
+float power_estimate_current_ma(const power_current_model_t& model, const power_policy_t& policy, float cpu_busy,
+                                float wakes_per_s, bool transmitting, bool audio);
+
+class PowerManager {
+public:
+    explicit PowerManager(const power_config_t& config);
+
+    // Held activities (TRANSMIT, NAVIGATE)
+    void setActive(power_activity_t activity, bool active, uint32_t nowMs);
+    // Event activities (VOICE, USER, DATA)
+    void pulse(power_activity_t activity, uint32_t nowMs);
+
+    /**
+     * @brief Re-evaluate the state and account the time since the last update
+     * @return true if the state changed
+     */
+    bool update(uint32_t nowMs);
+
+    // Count a CPU wake against the current state
+    void noteWake(power_wake_source_t source, uint32_t count = 1);
+
+    power_state_t state() const { return m_state; }
+    const power_policy_t& policy() const { return m_config.policy[m_state]; }
+    const power_config_t& config() const { return m_config; }
+    uint32_t pollMs(power_wake_source_t source) const;
+    const power_stats_t& stats() const { return m_stats; }
+
+private:
+    power_state_t evaluate(uint32_t nowMs) const;
+    bool recent(power_activity_t activity, uint32_t holdMs, uint32_t nowMs) const;
+
+    power_config_t m_config;
+    power_state_t m_state = POWER_STATE_IDLE;
+    bool m_held[POWER_ACTIVITY_COUNT] = {};
+    bool m_seen[POWER_ACTIVITY_COUNT] = {};
+    uint32_t m_lastMs[POWER_ACTIVITY_COUNT] = {};
+    bool m_started = false;
+    uint32_t m_lastUpdateMs = 0;
+    power_stats_t m_stats = {};
+};
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,78 @@
+/**
+ * @file power_service.h
+ * @brief Dynamic frequency scaling, light sleep and radio duty cycling by activity
+ *
+ * One low-priority task runs the node's PowerManager (power_manager.h).
+ * The tasks report activity (PTT, voice and data received, button
+ * presses, the map shown) and ask power_service_poll_ms() how long to
+ * wait before their next poll; that call also counts their wake. On a
+ * change of state the task applies the new state's policy:
+ *
+ * - esp_pm_configure() with the state's CPU frequency range and light
+ *   sleep setting. Light sleep needs CONFIG_PM_ENABLE and
+ *   CONFIG_FREERTOS_USE_TICKLESS_IDLE (sdkconfig.defaults); without them
+ *   the CPU stays at its boot frequency and only the polling changes.
+ * - The radio's receive interval through HaLowMeshManager: a TWT service
+ *   period or listen interval where the backend supports one. The
+ *   MM-IoT-SDK backend does not, and its radio stays awake.
+ *
+ * The audio task brackets each frame with power_service_rt_begin() and
+ * power_service_rt_end(), which hold PM locks so the codec runs at full
+ * clock and I2S is never stopped by light sleep mid-frame.
+ *
+ * Reporting and polling are lock-free and safe from any task.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef POWER_SERVICE_H
+#define POWER_SERVICE_H
+
+#include "power_manager.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Task and timing
+#define POWER_SERVICE_TASK_STACK_SIZE (3 * 1024)
+#define POWER_SERVICE_TASK_PRIORITY 2
+#define POWER_SERVICE_TICK_MS 250          // Until the first state is applied; then per policy
+
+/**
+ * @brief Start the power task in IDLE. Call before the polling tasks start.
+ * @return 0 on success, error code on failure
+ */
+int power_service_init(void);
+
+/**
+ * @brief Set a held activity (POWER_ACTIVITY_TRANSMIT, POWER_ACTIVITY_NAVIGATE)
+ */
+void power_service_set_active(power_activity_t activity, bool active);
+
+/**
+ * @brief Report an event activity (POWER_ACTIVITY_VOICE, _USER, _DATA)
+ */
+void power_service_pulse(power_activity_t activity);
+
+/**
+ * @brief Count a wake of the calling task and return its poll interval for the current state
+ * @param fallback_ms Returned before the service runs, or for sources the policy does not poll
+ */
+uint32_t power_service_poll_ms(power_wake_source_t source, uint32_t fallback_ms);
+
+/**
+ * @brief Hold the CPU at full clock and out of light sleep for a real-time section
+ */
+void power_service_rt_begin(void);
+void power_service_rt_end(void);
+
+power_state_t power_service_state(void);
+
+/**
+ * @brief Power counters
+ * @return false if the service is not running
+ */
+bool power_service_get_stats(power_stats_t* stats);
+
+#endif // POWER_SERVICE_H
@@ -0,0 +1,93 @@
+/**
+ * @file recorder_service.h
+ * @brief Voice recorder and instant replay in the SPIFFS storage partition
+ *
+ * The audio lanes hand every voice frame they play or send to
+ * recorder_service_capture(), which copies it into a lock-free ring in RAM,
+ * one per direction, and returns; it never waits and never touches flash.
+ * A low-priority task drains the rings into the node's VoiceRecorder
+ * (voice_recorder.h), which writes whole 4 KB blocks to a ring file of
+ * fixed size. If the task falls behind, frames are dropped from the
+ * recording, never from the audio path.
+ *
+ * Voice received while the PTT is held is heard but not recorded: the
+ * recorder holds one transmission at a time, and interleaving the two
+ * would cut both into single frames.
+ *
+ * Replay runs the other way: the task reads the chosen transmission back
+ * into another ring that the audio mix stage plays from when no live
+ * voice arrives.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef RECORDER_SERVICE_H
+#define RECORDER_SERVICE_H
+
+#include "voice_recorder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Task and timing
+#define RECORDER_SERVICE_TASK_STACK_SIZE (4 * 1024)
+#define RECORDER_SERVICE_TASK_PRIORITY 1    // Below everything that is heard or seen
+#define RECORDER_SERVICE_TICK_MS 50
+#define RECORDER_CAPTURE_RING_SIZE (8 * 1024) // Per direction: a quarter second of 16 kHz PCM
+#define RECORDER_REPLAY_RING_SIZE (8 * 1024)
+
+// Ring file in the storage partition
+#define RECORDER_FILE_PATH "/spiffs/voice.rec"
+#define RECORDER_BLOCKS 64                  // 256 KB
+#define RECORDER_MIN_BLOCKS 8
+#define RECORDER_SPIFFS_RESERVE (384 * 1024) // Left free for OTA staging, the outbox and message history
+
+/**
+ * @brief Open the ring file and start the task
+ * @return 0 on success, error code on failure
+ */
+int recorder_service_init(void);
+
+/**
+ * @brief Record a voice frame; never blocks
+ *
+ * One task per direction: the lane that sends TX frames, the one that
+ * receives RX frames.
+ * @param direction voice_direction_t
+ * @param talker    Sending node for received frames, NULL for own
+ */
+void recorder_service_capture(uint8_t direction, uint8_t group, const char* talker, const uint8_t* frame,
+                              size_t length);
+
+/**
+ * @brief Next frame of the replay in progress. Audio mix stage only; never blocks.
+ * @return Frame length, 0 if there is none now
+ */
+size_t recorder_service_replay_frame(uint8_t* out, size_t capacity);
+
+/**
+ * @brief Most recent transmissions, newest first
+ * @return Number written to out
+ */
+size_t recorder_service_list(voice_transmission_t* out, size_t max);
+
+/**
+ * @brief Replay a transmission from recorder_service_list(); replaces a replay in progress
+ */
+bool recorder_service_replay(uint32_t id);
+void recorder_service_stop_replay(void);
+
+/**
+ * @brief Transmission being replayed, 0 if none; lock-free
+ */
+uint32_t recorder_service_replaying(void);
+
+/**
+ * @brief Recorder counters and frames dropped because the task fell behind
+ * @return false if the recorder is not running
+ */
+bool recorder_service_get_stats(voice_recorder_stats_t* stats, uint32_t* dropped);
+
+#endif // RECORDER_SERVICE_H
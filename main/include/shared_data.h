@@ -13,6 +13,8 @@
 struct MeshNodeInfo {
     std::string callsign; // Will be extracted from discovery JSON
     std::string ipAddress;
+    int battery_level = -1;   // Percent from the node's last beacon; -1 unknown
+    uint32_t battery_minutes = 0;
 };
 
 // Structure to hold tactical info about a teammate
@@ -0,0 +1,142 @@
+/**
+ * @file talkgroup.h
+ * @brief Talkgroups: group-addressed voice and position data
+ *
+ * Voice frames and CoT broadcasts start with a 4 byte header naming the
+ * talkgroup they belong to: a 2 byte magic, the header version and frame
+ * kind in one byte, and the group. The 16 bit magic keeps a headerless
+ * frame from an older node from passing for a header (1 in 65536 rather
+ * than 1 in 256); a header with another version is dropped. A node listens to a set of groups and sends on
+ * one of them, the TX group. Frames for groups the node is not in are
+ * dropped on receive right after the header, before anything is decoded,
+ * decrypted or played, by a lookup in a 256 bit membership bitmap that is
+ * read without a lock.
+ *
+ * Group 0 is the all-call group: every node is in it, and frames without a
+ * header (from nodes older than this) count as all-call.
+ *
+ * Every node multicasts its membership bitmap every
+ * TALKGROUP_ANNOUNCE_INTERVAL_MS and soon after it changes. From these
+ * announcements a sender knows where a group's members are: it unicasts
+ * to them when there are only a few, so the mesh forwards the frames along
+ * the paths to the members only instead of flooding them to every node,
+ * and sends nothing when every reachable peer has announced and none is a
+ * member. Otherwise, and always for all-call, it multicasts.
+ *
+ * Subscriptions and the TX group are kept in NVS.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef TALKGROUP_H
+#define TALKGROUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TALKGROUP_COUNT 256
+#define TALKGROUP_ALL 0                     // All-call; every node is a member
+#define TALKGROUP_UI_GROUPS 16              // Groups offered on the talkgroup screen
+
+#define TALKGROUP_HEADER_SIZE 4              // Group is the last byte
+#define TALKGROUP_BITMAP_SIZE (TALKGROUP_COUNT / 8)
+
+#define TALKGROUP_ANNOUNCE_INTERVAL_MS 30000
+#define TALKGROUP_ANNOUNCE_DELAY_MS 1000    // After a membership change
+#define TALKGROUP_PEER_TIMEOUT_MS 95000     // Three missed announcements
+#define TALKGROUP_UNICAST_MAX 2             // Members reached by unicast rather than multicast
+#define TALKGROUP_MAX_PEERS 32
+
+/**
+ * @brief What a talkgroup frame carries
+ */
+typedef enum {
+    TALKGROUP_KIND_VOICE = 1,
+    TALKGROUP_KIND_DATA = 2,                // CoT and other group data
+    TALKGROUP_KIND_ANNOUNCE = 3,            // Membership bitmap
+    TALKGROUP_KIND_FLOOR = 4                // Push-to-talk floor control; kinds go up to 15
+} talkgroup_kind_t;
+
+/**
+ * @brief Talkgroup counters
+ */
+typedef struct {
+    uint32_t rx_accepted;           ///< Frames for a group this node is in
+    uint32_t rx_dropped;            ///< Frames dropped by the filter
+    uint32_t tx_multicast;
+    uint32_t tx_unicast;            ///< Frames, one per member
+    uint32_t tx_suppressed;         ///< Frames not sent: no member in reach
+    uint32_t announces_sent;
+    uint32_t announces_received;
+    uint32_t known_peers;           ///< Peers whose membership is known
+} talkgroup_stats_t;
+
+/**
+ * @brief Load the memberships and hook into the mesh manager
+ *
+ * Call during startup, before the radio is up.
+ */
+bool talkgroup_init(void);
+
+/**
+ * @brief Send membership announcements when due. Call every 100 - 1000 ms.
+ */
+void talkgroup_tick(void);
+
+/**
+ * @brief Listen to a group, or stop listening (not to all-call or the TX group)
+ */
+bool talkgroup_join(uint8_t group);
+bool talkgroup_leave(uint8_t group);
+
+/**
+ * @brief Send on a group; joins it if needed
+ */
+bool talkgroup_set_tx(uint8_t group);
+uint8_t talkgroup_get_tx(void);
+
+/**
+ * @brief Whether this node is in a group; lock-free
+ */
+bool talkgroup_is_member(uint8_t group);
+
+/**
+ * @brief Receive filter: the payload of a frame for one of this node's groups
+ *
+ * Frames without a talkgroup header are all-call and returned whole.
+ *
+ * @param payload_length Set to the payload length
+ * @return Start of the payload, NULL if the frame is to be dropped
+ */
+const uint8_t* talkgroup_accept(const uint8_t* frame, size_t length, size_t* payload_length);
+
+/**
+ * @brief Write the header for a frame
+ * @return TALKGROUP_HEADER_SIZE, 0 if out is too small or kind is over 15
+ */
+size_t talkgroup_write_header(uint8_t kind, uint8_t group, uint8_t* out, size_t out_size);
+
+/**
+ * @brief Send a frame to the members of the TX group
+ *
+ * The frame starts with TALKGROUP_HEADER_SIZE bytes left free for the
+ * header, which is written here, followed by the payload; senders read or
+ * pack their payload in place to save a copy. Picks unicast to each
+ * member, multicast, or nothing, as described above.
+ *
+ * @param length Header and payload
+ * @return false if the frame is shorter than the header or the radio refused it
+ */
+bool talkgroup_send(uint8_t kind, uint8_t* frame, size_t length, uint16_t port);
+
+/**
+ * @brief Reachable peers known to be in a group
+ */
+size_t talkgroup_member_count(uint8_t group);
+
+bool talkgroup_get_stats(talkgroup_stats_t* stats);
+
+#endif // TALKGROUP_H
@@ -0,0 +1,150 @@
+/**
+ * @file telemetry_service.h
+ * @brief Per-task CPU, stack, queue depth and heap telemetry
+ *
+ * The telemetry task samples the scheduler every TELEMETRY_SAMPLE_INTERVAL_MS:
+ *
+ * - CPU load per task, from the FreeRTOS run-time counters
+ *   (uxTaskGetSystemState), as the share of all cores since the last sample
+ * - stack high-water mark per task, against its registered stack size
+ * - fill level and sampled high-water mark of every registered queue
+ * - free, minimum-ever free and largest free heap block
+ *
+ * Every sample replaces the local snapshot (telemetry_get_snapshot()).
+ * Every TELEMETRY_MESH_INTERVAL_MS the snapshot is logged, one line per task,
+ * encoded into a compact binary packet (telemetry_encode()) and multicast on
+ * TELEMETRY_PORT, so stack sizes and priorities can be tuned from data
+ * collected across the whole team.
+ *
+ * Per-task CPU load needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (see sdkconfig.defaults). Without
+ * them only the registered tasks are reported, with stack usage but no CPU
+ * figures.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef TELEMETRY_SERVICE_H
+#define TELEMETRY_SERVICE_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_MAX_TASKS 32
+#define TELEMETRY_MAX_QUEUES 8
+#define TELEMETRY_NAME_LEN 16
+
+#define TELEMETRY_SAMPLE_INTERVAL_MS 5000
+#define TELEMETRY_MESH_INTERVAL_MS 60000
+
+// Binary snapshot format version (first byte after the magic)
+#define TELEMETRY_FORMAT_VERSION 1
+
+// Worst-case encoded snapshot size
+#define TELEMETRY_MAX_ENCODED_SIZE \
+    (24 + TELEMETRY_MAX_TASKS * (TELEMETRY_NAME_LEN + 9) + TELEMETRY_MAX_QUEUES * (TELEMETRY_NAME_LEN + 7))
+
+/**
+ * @brief One task in a snapshot
+ */
+typedef struct {
+    char name[TELEMETRY_NAME_LEN];
+    uint8_t priority;               ///< Current priority
+    int8_t core;                    ///< Core affinity, -1 for either core
+    uint16_t cpu_permille;          ///< Share of total CPU time since the previous sample, 0-1000
+    uint32_t stack_free_min;        ///< Stack high-water mark: least free stack ever, bytes
+    uint32_t stack_size;            ///< Registered stack size in bytes, 0 if unknown
+} telemetry_task_t;
+
+/**
+ * @brief One queue in a snapshot
+ */
+typedef struct {
+    char name[TELEMETRY_NAME_LEN];
+    uint16_t waiting;               ///< Items in the queue at sample time
+    uint16_t capacity;
+    uint16_t high_water;            ///< Most items seen at any sample
+} telemetry_queue_t;
+
+/**
+ * @brief System snapshot
+ */
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t largest_free_block;
+    uint16_t idle_permille;         ///< Idle share of total CPU time, 0-1000
+    uint8_t task_count;
+    uint8_t queue_count;
+    telemetry_task_t tasks[TELEMETRY_MAX_TASKS];
+    telemetry_queue_t queues[TELEMETRY_MAX_QUEUES];
+} telemetry_snapshot_t;
+
+/**
+ * @brief Initialize the telemetry service
+ * @return true on success, false on failure
+ */
+bool telemetry_init(void);
+
+/**
+ * @brief Register a task so its stack usage can be shown against its size
+ *
+ * Without run-time stats support only registered tasks are reported.
+ * @param handle Task handle
+ * @param stack_size Stack size the task was created with, in bytes
+ * @return false if the registry is full or the handle is NULL
+ */
+bool telemetry_register_task(TaskHandle_t handle, uint32_t stack_size);
+
+/**
+ * @brief Register a queue whose fill level should be reported
+ * @param name Short name (truncated to TELEMETRY_NAME_LEN - 1)
+ * @param queue Queue handle
+ * @return false if the registry is full or the handle is NULL
+ */
+bool telemetry_register_queue(const char* name, QueueHandle_t queue);
+
+/**
+ * @brief Take a sample now and store it as the latest snapshot
+ */
+void telemetry_sample(void);
+
+/**
+ * @brief Copy the latest snapshot
+ * @return false if no sample has been taken yet
+ */
+bool telemetry_get_snapshot(telemetry_snapshot_t* snapshot);
+
+/**
+ * @brief Encode a snapshot into the compact binary format
+ *
+ * Layout, little endian:
+ *   'T' 'M' version u8 | uptime_s u32 | free_heap u32 | min_free_heap u32 |
+ *   largest_free_block u32 | idle_permille u16 | task_count u8 | queue_count u8 |
+ *   per task:  name_len u8, name, priority u8, core i8, cpu_permille u16,
+ *              stack_free_min u16, stack_size u16 (bytes, saturated) |
+ *   per queue: name_len u8, name, waiting u16, capacity u16, high_water u16
+ *
+ * @return Encoded length, or 0 if the buffer is too small
+ */
+size_t telemetry_encode(const telemetry_snapshot_t* snapshot, uint8_t* buffer, size_t buffer_size);
+
+/**
+ * @brief Log the latest snapshot
+ */
+void telemetry_log_snapshot(void);
+
+/**
+ * @brief Telemetry task: samples, logs and publishes snapshots
+ * @param pvParameters Task parameters (unused)
+ */
+void telemetry_task(void* pvParameters);
+
+#endif // TELEMETRY_SERVICE_H
@@ -0,0 +1,218 @@
+/**
+ * @file voice_recorder.h
+ * @brief Rolling recording of received and sent voice for instant replay
+ *
+ * Voice frames are recorded as they travel on the mesh, without decoding
+ * or re-encoding, into a ring of fixed-size blocks in flash
+ * (IVoiceStorage). Frames are grouped into transmissions: a transmission
+ * is one talker and direction without a pause longer than gap_ms. Each
+ * starts with a START record naming the talker, talkgroup and wall clock
+ * time; FRAME records hold the frames and their offset into it.
+ *
+ * Records collect in a block buffer in RAM that is written as a whole
+ * when full, so flash sees block-sized writes only. A partly filled block
+ * is written, padded, after idle_flush_ms without frames, which bounds
+ * what a power loss can lose; it is the only padding. When the ring is
+ * full the oldest block is overwritten, and the transmissions that
+ * started in it leave the index.
+ *
+ * The index of transmissions, newest last, is kept in RAM and rebuilt
+ * from the blocks by load(). Every block carries a sequence number, the
+ * transmission still going at its start and a CRC; torn or foreign
+ * blocks are skipped.
+ *
+ * The class does no I/O except through the storage, takes the time as an
+ * argument and is not thread safe, so the host simulation can drive it
+ * directly.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#ifndef VOICE_RECORDER_H
+#define VOICE_RECORDER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VOICE_RECORDER_BLOCK_SIZE 4096      // One flash erase block
+#define VOICE_RECORDER_BLOCK_HEADER_SIZE 20
+#define VOICE_RECORDER_TALKER_LEN 40        // Including the terminator
+#define VOICE_RECORDER_MAX_FRAME 1500
+#define VOICE_RECORDER_MAX_INDEX 64         // Transmissions kept in the index
+
+/**
+ * @brief Which way a recorded transmission went
+ */
+typedef enum {
+    VOICE_DIRECTION_RX = 0,
+    VOICE_DIRECTION_TX = 1
+} voice_direction_t;
+
+/**
+ * @brief Recorder timing
+ */
+typedef struct {
+    uint32_t gap_ms;                        ///< Pause that ends a transmission
+    uint32_t idle_flush_ms;                 ///< Write a partly filled block after this long without frames
+} voice_recorder_config_t;
+
+/**
+ * @brief Recorder counters
+ */
+typedef struct {
+    uint32_t frames;                        ///< Frames recorded
+    uint32_t voice_bytes;                   ///< Their payload bytes
+    uint32_t rejected;                      ///< Frames too long to record
+    uint32_t transmissions;
+    uint32_t blocks_written;
+    uint32_t flash_bytes;                   ///< Bytes written to storage
+    uint32_t padded_flushes;                ///< Blocks written before they were full
+    uint32_t evicted;                       ///< Transmissions overwritten
+    uint32_t write_errors;
+    uint32_t replays;
+} voice_recorder_stats_t;
+
+/**
+ * @brief One recorded transmission
+ */
+typedef struct {
+    uint32_t id;
+    uint8_t direction;                      ///< voice_direction_t
+    uint8_t group;                          ///< Talkgroup
+    uint32_t epoch_s;                       ///< Wall clock at its start; small if the clock was not set
+    uint32_t duration_ms;                   ///< Offset of its last frame
+    uint32_t frames;
+    uint32_t bytes;
+    char talker[VOICE_RECORDER_TALKER_LEN]; ///< Empty for this node's own transmissions
+} voice_transmission_t;
+
+/**
+ * @brief Default timing
+ */
+voice_recorder_config_t voice_recorder_default_config(void);
+
+/**
+ * @brief Flash behind the recorder: a ring of VOICE_RECORDER_BLOCK_SIZE blocks
+ */
+class IVoiceStorage {
+public:
+    virtual ~IVoiceStorage() = default;
+
+    virtual size_t blockCount() const = 0;
+    virtual bool readBlock(size_t index, uint8_t* block) = 0;
+    virtual bool writeBlock(size_t index, const uint8_t* block) = 0;
+};
+
+class VoiceRecorder {
+public:
+    // The storage must outlive the recorder
+    VoiceRecorder(IVoiceStorage* storage, const voice_recorder_config_t& config);
+
+    /**
+     * @brief Rebuild the index from storage; recording continues after the newest block
+     * @return Number of transmissions found
+     */
+    size_t load();
+
+    /**
+     * @brief Record one voice frame
+     * @param talker Sending node for RX, empty for TX
+     * @param epochS Wall clock, stored with the start of a transmission
+     * @return false if the frame was too long or the block could not be written
+     */
+    bool addFrame(uint8_t direction, uint8_t group, const std::string& talker, uint32_t nowMs, uint32_t epochS,
+                  const uint8_t* data, size_t length);
+
+    // Idle flush. Call every 50 - 500 ms.
+    void tick(uint32_t nowMs);
+
+    // Write the partly filled block now, for example before a restart
+    bool flush();
+
+    /**
+     * @brief Most recent transmissions, newest first
+     * @return Number written to out
+     */
+    size_t recent(voice_transmission_t* out, size_t max) const;
+
+    /**
+     * @brief Play a transmission back; replaces a replay in progress
+     * @return false if it is not (or no longer) recorded
+     */
+    bool startReplay(uint32_t id);
+    void stopReplay() { m_replayId = 0; }
+    bool replaying() const { return m_replayId != 0; }
+    uint32_t replayId() const { return m_replayId; }
+
+    /**
+     * @brief Next frame of the replay, in recording order
+     * @param offsetMs Set to the frame's offset into the transmission
+     * @return Frame length; 0 when the replay has ended
+     */
+    size_t nextReplayFrame(uint8_t* out, size_t capacity, uint32_t* offsetMs);
+
+    size_t blockCount() const { return m_blockCount; }
+    const voice_recorder_stats_t& stats() const { return m_stats; }
+
+private:
+    struct Entry {
+        voice_transmission_t info;
+        uint32_t firstSeq;                  // Block with its START record
+        uint16_t firstOffset;               // START record's offset in the block
+        uint32_t startMs;                   // Recording time of the first frame
+    };
+
+    struct Record {
+        uint8_t type = 0;
+        uint32_t id = 0;                    // START
+        uint8_t direction = 0;
+        uint8_t group = 0;
+        uint32_t epochS = 0;
+        std::string talker;
+        uint32_t offsetMs = 0;              // FRAME
+        const uint8_t* data = nullptr;
+        uint16_t length = 0;
+    };
+
+    bool writeBlock();
+    bool room(size_t length) const;
+    Entry* startTransmission(uint8_t direction, uint8_t group, const std::string& talker, uint32_t nowMs,
+                             uint32_t epochS);
+    void evictBefore(uint32_t seq);
+    Entry* find(uint32_t id);
+    bool loadReplayBlock(uint32_t seq);
+    static bool parseBlock(const uint8_t* block, uint32_t* seq, uint32_t* openId, uint16_t* used);
+    static size_t parseRecord(const uint8_t* records, uint16_t used, uint16_t offset, Record* record);
+
+    IVoiceStorage* m_storage;
+    voice_recorder_config_t m_config;
+    size_t m_blockCount;
+
+    // Block being filled
+    std::vector<uint8_t> m_block;
+    uint16_t m_used = 0;                    // Record bytes in it
+    uint32_t m_seq = 1;                     // Its sequence number; 0 is never used
+    uint32_t m_openId = 0;                  // Transmission going on at its start
+
+    std::deque<Entry> m_index;              // Oldest first
+    uint32_t m_nextId = 1;
+    uint32_t m_currentId = 0;               // Transmission being recorded
+    uint32_t m_lastFrameMs = 0;
+
+    // Replay cursor
+    uint32_t m_replayId = 0;
+    uint32_t m_replaySeq = 0;
+    uint16_t m_replayOffset = 0;
+    bool m_replayNewBlock = false;          // Check that the transmission goes on in this block
+    std::vector<uint8_t> m_replayBlock;
+    uint32_t m_replayLoadedSeq = 0;         // Block in m_replayBlock, 0 if none
+
+    voice_recorder_stats_t m_stats = {};
+};
+
+#endif // VOICE_RECORDER_H
@@ -0,0 +1,933 @@
+/**
+ * @file jpeg_progressive.cpp
+ * @brief Lossless baseline to progressive JPEG re-encoding
+ *
+ * Decodes the Huffman layer of the camera's baseline JPEG into quantized
+ * DCT coefficients, without dequantizing or transforming anything, and
+ * writes them back out as spectral-selection progressive scans (ITU-T
+ * T.81 Annex G) with per-scan optimal Huffman tables (Annex K.2).
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/jpeg_progressive.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// Markers
+static const uint8_t MARKER_SOF0 = 0xC0;
+static const uint8_t MARKER_SOF1 = 0xC1;
+static const uint8_t MARKER_SOF2 = 0xC2;
+static const uint8_t MARKER_DHT = 0xC4;
+static const uint8_t MARKER_RST0 = 0xD0;
+static const uint8_t MARKER_SOI = 0xD8;
+static const uint8_t MARKER_EOI = 0xD9;
+static const uint8_t MARKER_SOS = 0xDA;
+static const uint8_t MARKER_DQT = 0xDB;
+static const uint8_t MARKER_DRI = 0xDD;
+static const uint8_t MARKER_APP0 = 0xE0;
+static const uint8_t MARKER_APP15 = 0xEF;
+static const uint8_t MARKER_COM = 0xFE;
+
+static const int MAX_COMPONENTS = 3;
+static const int MAX_DC_CATEGORY = 11;      // 8-bit precision
+static const int MAX_AC_CATEGORY = 10;
+static const int MAX_DC_VALUE = 1024;
+static const uint32_t MAX_EOBRUN = 0x7FFF;
+
+static uint16_t get_u16be(const uint8_t* data) {
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+static void put_u16be(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back((uint8_t)(value >> 8));
+    out->push_back((uint8_t)value);
+}
+
+static int bit_count(uint32_t value) {
+    return value ? 32 - __builtin_clz(value) : 0;
+}
+
+// ============================================================================
+// HUFFMAN TABLES
+// ============================================================================
+
+struct DecodeTable {
+    bool defined;
+    uint8_t lookLength[256];        // Codes up to 8 bits, indexed by the next byte
+    uint8_t lookValue[256];
+    int32_t maxCode[17];            // Longest code of each length, -1 if none
+    int32_t valueOffset[17];
+    uint8_t values[256];
+};
+
+static bool build_decode_table(const uint8_t bits[17], const uint8_t* values, int count, DecodeTable* table) {
+    memset(table, 0, sizeof(*table));
+    memcpy(table->values, values, count);
+    int32_t code = 0;
+    int index = 0;
+    for (int length = 1; length <= 16; length++) {
+        table->valueOffset[length] = index - code;
+        for (int i = 0; i < bits[length]; i++) {
+            if (length <= 8) {
+                int first = code << (8 - length);
+                for (int fill = 0; fill < (1 << (8 - length)); fill++) {
+                    table->lookLength[first + fill] = (uint8_t)length;
+                    table->lookValue[first + fill] = values[index];
+                }
+            }
+            code++;
+            index++;
+        }
+        if (code > (1 << length)) {
+            return false;               // Over-subscribed
+        }
+        table->maxCode[length] = bits[length] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table->defined = true;
+    return true;
+}
+
+struct EncodeTable {
+    uint16_t code[256];
+    uint8_t size[256];
+    uint8_t bits[17];
+    uint8_t values[256];
+    int count;
+};
+
+// Code lengths for the given symbol frequencies, limited to 16 bits
+// (T.81 K.2, the procedure libjpeg uses for optimized tables)
+static void build_encode_table(const uint32_t frequencies[257], EncodeTable* table) {
+    uint32_t freq[257];
+    memcpy(freq, frequencies, sizeof(freq));
+    freq[256] = 1;                      // Reserved so no code is all ones
+
+    int codeSize[257] = {0};
+    int others[257];
+    std::fill(others, others + 257, -1);
+    for (;;) {
+        int c1 = -1;
+        uint32_t lowest = UINT32_MAX;
+        for (int i = 0; i <= 256; i++) {
+            if (freq[i] && freq[i] <= lowest) {
+                lowest = freq[i];
+                c1 = i;
+            }
+        }
+        int c2 = -1;
+        lowest = UINT32_MAX;
+        for (int i = 0; i <= 256; i++) {
+            if (freq[i] && freq[i] <= lowest && i != c1) {
+                lowest = freq[i];
+                c2 = i;
+            }
+        }
+        if (c2 < 0) {
+            break;
+        }
+        freq[c1] += freq[c2];
+        freq[c2] = 0;
+        codeSize[c1]++;
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            codeSize[c1]++;
+        }
+        others[c1] = c2;
+        codeSize[c2]++;
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            codeSize[c2]++;
+        }
+    }
+
+    int lengths[258] = {0};
+    int longest = 0;
+    for (int i = 0; i <= 256; i++) {
+        if (codeSize[i]) {
+            lengths[codeSize[i]]++;
+            longest = std::max(longest, codeSize[i]);
+        }
+    }
+    for (int i = longest; i > 16; i--) {
+        while (lengths[i] > 0) {
+            int j = i - 2;
+            while (lengths[j] == 0) {
+                j--;
+            }
+            lengths[i] -= 2;
+            lengths[i - 1]++;
+            lengths[j + 1] += 2;
+            lengths[j]--;
+        }
+    }
+    int last = 16;
+    while (lengths[last] == 0) {
+        last--;
+    }
+    lengths[last]--;                    // Drop the reserved symbol
+
+    memset(table, 0, sizeof(*table));
+    for (int i = 1; i <= 16; i++) {
+        table->bits[i] = (uint8_t)lengths[i];
+    }
+    for (int size = 1; size <= longest; size++) {
+        for (int symbol = 0; symbol < 256; symbol++) {
+            if (codeSize[symbol] == size) {
+                table->values[table->count++] = (uint8_t)symbol;
+            }
+        }
+    }
+
+    uint16_t code = 0;
+    int index = 0;
+    for (int length = 1; length <= 16; length++) {
+        for (int i = 0; i < table->bits[length]; i++) {
+            uint8_t symbol = table->values[index++];
+            table->code[symbol] = code++;
+            table->size[symbol] = (uint8_t)length;
+        }
+        code <<= 1;
+    }
+}
+
+// ============================================================================
+// BIT I/O
+// ============================================================================
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t length, size_t pos)
+        : m_data(data), m_length(length), m_pos(pos), m_acc(0), m_count(0), m_marker(false) {}
+
+    uint32_t get(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        fill();
+        uint32_t value = m_acc >> (32 - n);
+        m_acc <<= n;
+        m_count -= n;
+        return value;
+    }
+
+    int decode(const DecodeTable& table) {
+        fill();
+        uint32_t look = m_acc >> 24;
+        if (table.lookLength[look]) {
+            int length = table.lookLength[look];
+            m_acc <<= length;
+            m_count -= length;
+            return table.lookValue[look];
+        }
+        for (int length = 9; length <= 16; length++) {
+            int32_t code = (int32_t)(m_acc >> (32 - length));
+            if (code <= table.maxCode[length]) {
+                m_acc <<= length;
+                m_count -= length;
+                return table.values[code + table.valueOffset[length]];
+            }
+        }
+        return -1;
+    }
+
+    // Drop the partial byte and step over RSTn
+    bool restart() {
+        m_acc = 0;
+        m_count = 0;
+        if (m_pos + 1 >= m_length || m_data[m_pos] != 0xFF || (m_data[m_pos + 1] & 0xF8) != MARKER_RST0) {
+            return false;
+        }
+        m_pos += 2;
+        m_marker = false;
+        return true;
+    }
+
+    // Position of the marker that ends the entropy-coded data
+    size_t end() const {
+        size_t pos = m_pos;
+        while (pos + 1 < m_length &&
+               !(m_data[pos] == 0xFF && m_data[pos + 1] != 0x00 && (m_data[pos + 1] & 0xF8) != MARKER_RST0)) {
+            pos++;
+        }
+        return pos;
+    }
+
+private:
+    // Keep at least 25 bits; past a marker or the end, feed zeros
+    void fill() {
+        while (m_count <= 24) {
+            uint32_t byte = 0;
+            if (!m_marker && m_pos < m_length) {
+                byte = m_data[m_pos];
+                if (byte == 0xFF) {
+                    if (m_pos + 1 < m_length && m_data[m_pos + 1] == 0x00) {
+                        m_pos += 2;
+                    } else {
+                        m_marker = true;
+                        byte = 0;
+                    }
+                } else {
+                    m_pos++;
+                }
+            }
+            m_acc |= byte << (24 - m_count);
+            m_count += 8;
+        }
+    }
+
+    const uint8_t* m_data;
+    size_t m_length;
+    size_t m_pos;
+    uint32_t m_acc;
+    int m_count;
+    bool m_marker;
+};
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>* out) : m_out(out), m_acc(0), m_count(0) {}
+
+    void put(uint32_t value, int n) {
+        m_acc = (m_acc << n) | (value & ((1u << n) - 1));
+        m_count += n;
+        while (m_count >= 8) {
+            uint8_t byte = (uint8_t)(m_acc >> (m_count - 8));
+            m_out->push_back(byte);
+            if (byte == 0xFF) {
+                m_out->push_back(0x00);
+            }
+            m_count -= 8;
+        }
+        m_acc &= (1u << m_count) - 1;
+    }
+
+    // Pad the last byte with ones
+    void flush() {
+        if (m_count > 0) {
+            put(0x7F, 8 - m_count);
+        }
+    }
+
+private:
+    std::vector<uint8_t>* m_out;
+    uint32_t m_acc;
+    int m_count;
+};
+
+// ============================================================================
+// TRANSCODER
+// ============================================================================
+
+namespace {
+
+struct Component {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t tq;
+    uint32_t blocksW;               // Blocks that cover the image
+    uint32_t blocksH;
+    uint32_t paddedW;               // Rounded up to whole MCUs
+    uint32_t paddedH;
+    int16_t* coefficients;          // 64 per block, zigzag order
+
+    int16_t* block(uint32_t x, uint32_t y) const {
+        return coefficients + ((size_t)y * paddedW + x) * 64;
+    }
+};
+
+struct Segment {
+    size_t offset;                  // Marker byte
+    size_t length;                  // Marker, length field and payload
+};
+
+// Counts symbols on the first pass over a scan and writes them on the second
+struct ScanEmitter {
+    BitWriter* writer;              // NULL while counting
+    uint32_t dcFreq[2][257];
+    uint32_t acFreq[257];
+    EncodeTable dc[2];
+    EncodeTable ac;
+
+    void dcSymbol(int table, int symbol) {
+        if (writer) {
+            writer->put(dc[table].code[symbol], dc[table].size[symbol]);
+        } else {
+            dcFreq[table][symbol]++;
+        }
+    }
+    void acSymbol(int symbol) {
+        if (writer) {
+            writer->put(ac.code[symbol], ac.size[symbol]);
+        } else {
+            acFreq[symbol]++;
+        }
+    }
+    void bits(uint32_t value, int n) {
+        if (writer && n) {
+            writer->put(value, n);
+        }
+    }
+};
+
+class Transcoder {
+public:
+    Transcoder(const uint8_t* data, size_t length)
+        : m_data(data), m_length(length), m_width(0), m_height(0), m_componentCount(0),
+          m_mcusX(0), m_mcusY(0), m_restartInterval(0), m_scansDecoded(0), m_coefficients(nullptr) {
+        memset(m_components, 0, sizeof(m_components));
+        memset(m_dcTables, 0, sizeof(m_dcTables));
+        memset(m_acTables, 0, sizeof(m_acTables));
+    }
+
+    ~Transcoder() {
+        if (m_coefficients) {
+            heap_caps_free(m_coefficients);
+        }
+    }
+
+    jpeg_progressive_status_t decode();
+    void encode(std::vector<uint8_t>* out, jpeg_progressive_info_t* info);
+
+private:
+    jpeg_progressive_status_t parseFrame(const uint8_t* p, size_t length);
+    jpeg_progressive_status_t parseHuffman(const uint8_t* p, size_t length);
+    jpeg_progressive_status_t decodeScan(const uint8_t* p, size_t length, size_t* pos);
+    bool decodeBlock(BitReader* reader, const DecodeTable& dc, const DecodeTable& ac, int* pred, int16_t* block);
+
+    void encodeDcScan(ScanEmitter* emitter);
+    void encodeAcScan(ScanEmitter* emitter, const Component& component, int ss, int se);
+    void writeSegment(std::vector<uint8_t>* out, const Segment& segment);
+    void writeHuffman(std::vector<uint8_t>* out, int tableClass, int id, const EncodeTable& table);
+
+    const uint8_t* m_data;
+    size_t m_length;
+    uint16_t m_width;
+    uint16_t m_height;
+    int m_componentCount;
+    Component m_components[MAX_COMPONENTS];
+    uint32_t m_mcusX;
+    uint32_t m_mcusY;
+    uint16_t m_restartInterval;
+    int m_scansDecoded;
+    DecodeTable m_dcTables[4];
+    DecodeTable m_acTables[4];
+    std::vector<Segment> m_kept;    // APPn, COM and DQT, copied to the output
+    int16_t* m_coefficients;
+};
+
+jpeg_progressive_status_t Transcoder::decode() {
+    if (m_length < 4 || m_data[0] != 0xFF || m_data[1] != MARKER_SOI) {
+        return JPEG_PROGRESSIVE_ERR_FORMAT;
+    }
+    size_t pos = 2;
+    for (;;) {
+        if (pos >= m_length || m_data[pos] != 0xFF) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        while (pos < m_length && m_data[pos] == 0xFF) {
+            pos++;                      // Fill bytes
+        }
+        if (pos >= m_length) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        size_t markerPos = pos - 1;
+        uint8_t marker = m_data[pos++];
+        if (marker == MARKER_EOI) {
+            break;
+        }
+        if ((marker & 0xF8) == MARKER_RST0 || marker == 0x01) {
+            continue;                   // No payload
+        }
+        if (pos + 2 > m_length) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        size_t length = get_u16be(m_data + pos);
+        if (length < 2 || pos + length > m_length) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        const uint8_t* payload = m_data + pos + 2;
+        size_t payloadLength = length - 2;
+        pos += length;
+
+        jpeg_progressive_status_t status = JPEG_PROGRESSIVE_OK;
+        if (marker == MARKER_SOF0 || marker == MARKER_SOF1) {
+            status = m_componentCount ? JPEG_PROGRESSIVE_ERR_FORMAT : parseFrame(payload, payloadLength);
+        } else if (marker >= MARKER_SOF2 && marker <= 0xCF && marker != MARKER_DHT) {
+            // Progressive, lossless, hierarchical or arithmetic coded
+            status = JPEG_PROGRESSIVE_ERR_UNSUPPORTED;
+        } else if (marker == MARKER_DHT) {
+            status = parseHuffman(payload, payloadLength);
+        } else if (marker == MARKER_DRI) {
+            if (payloadLength < 2) {
+                return JPEG_PROGRESSIVE_ERR_FORMAT;
+            }
+            m_restartInterval = get_u16be(payload);
+        } else if (marker == MARKER_SOS) {
+            status = decodeScan(payload, payloadLength, &pos);
+        } else if (marker == MARKER_DQT || (marker >= MARKER_APP0 && marker <= MARKER_APP15) || marker == MARKER_COM) {
+            m_kept.push_back({markerPos, length + 2});
+        }
+        if (status != JPEG_PROGRESSIVE_OK) {
+            return status;
+        }
+    }
+    return m_scansDecoded ? JPEG_PROGRESSIVE_OK : JPEG_PROGRESSIVE_ERR_FORMAT;
+}
+
+jpeg_progressive_status_t Transcoder::parseFrame(const uint8_t* p, size_t length) {
+    if (length < 6) {
+        return JPEG_PROGRESSIVE_ERR_FORMAT;
+    }
+    if (p[0] != 8) {
+        return JPEG_PROGRESSIVE_ERR_UNSUPPORTED;
+    }
+    m_height = get_u16be(p + 1);
+    m_width = get_u16be(p + 3);
+    int count = p[5];
+    if (m_width == 0 || m_height == 0) {
+        return m_height == 0 ? JPEG_PROGRESSIVE_ERR_UNSUPPORTED : JPEG_PROGRESSIVE_ERR_FORMAT;    // DNL
+    }
+    if (m_width > JPEG_PROGRESSIVE_MAX_DIMENSION || m_height > JPEG_PROGRESSIVE_MAX_DIMENSION ||
+        (count != 1 && count != 3)) {
+        return JPEG_PROGRESSIVE_ERR_UNSUPPORTED;
+    }
+    if (length < 6 + 3 * (size_t)count) {
+        return JPEG_PROGRESSIVE_ERR_FORMAT;
+    }
+
+    int hMax = 1;
+    int vMax = 1;
+    for (int i = 0; i < count; i++) {
+        Component& component = m_components[i];
+        component.id = p[6 + 3 * i];
+        component.h = p[7 + 3 * i] >> 4;
+        component.v = p[7 + 3 * i] & 0x0F;
+        component.tq = p[8 + 3 * i];
+        if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.tq > 3) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        hMax = std::max(hMax, (int)component.h);
+        vMax = std::max(vMax, (int)component.v);
+    }
+    m_mcusX = (m_width + 8 * hMax - 1) / (8 * hMax);
+    m_mcusY = (m_height + 8 * vMax - 1) / (8 * vMax);
+
+    size_t blocks = 0;
+    for (int i = 0; i < count; i++) {
+        Component& component = m_components[i];
+        component.blocksW = ((m_width * component.h + hMax - 1) / hMax + 7) / 8;
+        component.blocksH = ((m_height * component.v + vMax - 1) / vMax + 7) / 8;
+        if (count == 1) {
+            component.paddedW = component.blocksW;
+            component.paddedH = component.blocksH;
+        } else {
+            component.paddedW = m_mcusX * component.h;
+            component.paddedH = m_mcusY * component.v;
+        }
+        blocks += (size_t)component.paddedW * component.paddedH;
+    }
+
+    size_t bytes = blocks * 64 * sizeof(int16_t);
+    m_coefficients = (int16_t*)heap_caps_calloc(1, bytes, MALLOC_CAP_SPIRAM);
+    if (!m_coefficients) {
+        m_coefficients = (int16_t*)heap_caps_calloc(1, bytes, MALLOC_CAP_8BIT);
+    }
+    if (!m_coefficients) {
+        return JPEG_PROGRESSIVE_ERR_NO_MEMORY;
+    }
+    int16_t* next = m_coefficients;
+    for (int i = 0; i < count; i++) {
+        m_components[i].coefficients = next;
+        next += (size_t)m_components[i].paddedW * m_components[i].paddedH * 64;
+    }
+    m_componentCount = count;
+    return JPEG_PROGRESSIVE_OK;
+}
+
+jpeg_progressive_status_t Transcoder::parseHuffman(const uint8_t* p, size_t length) {
+    while (length > 0) {
+        if (length < 17) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        int tableClass = p[0] >> 4;
+        int id = p[0] & 0x0F;
+        if (tableClass > 1 || id > 3) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        uint8_t bits[17] = {0};
+        int count = 0;
+        for (int i = 1; i <= 16; i++) {
+            bits[i] = p[i];
+            count += bits[i];
+        }
+        if (count > 256 || length < 17 + (size_t)count) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        DecodeTable* table = tableClass == 0 ? &m_dcTables[id] : &m_acTables[id];
+        if (!build_decode_table(bits, p + 17, count, table)) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        p += 17 + count;
+        length -= 17 + count;
+    }
+    return JPEG_PROGRESSIVE_OK;
+}
+
+bool Transcoder::decodeBlock(BitReader* reader, const DecodeTable& dc, const DecodeTable& ac,
+                             int* pred, int16_t* block) {
+    int category = reader->decode(dc);
+    if (category < 0 || category > MAX_DC_CATEGORY) {
+        return false;
+    }
+    int diff = 0;
+    if (category) {
+        diff = (int)reader->get(category);
+        if (diff < (1 << (category - 1))) {
+            diff -= (1 << category) - 1;
+        }
+    }
+    *pred += diff;
+    if (*pred > MAX_DC_VALUE || *pred < -MAX_DC_VALUE) {
+        return false;
+    }
+    block[0] = (int16_t)*pred;
+
+    for (int k = 1; k < 64;) {
+        int symbol = reader->decode(ac);
+        if (symbol < 0) {
+            return false;
+        }
+        int run = symbol >> 4;
+        int size = symbol & 0x0F;
+        if (size == 0) {
+            if (run != 15) {
+                break;                  // EOB
+            }
+            k += 16;
+            continue;
+        }
+        k += run;
+        if (k > 63 || size > MAX_AC_CATEGORY) {
+            return false;
+        }
+        int value = (int)reader->get(size);
+        if (value < (1 << (size - 1))) {
+            value -= (1 << size) - 1;
+        }
+        block[k++] = (int16_t)value;
+    }
+    return true;
+}
+
+jpeg_progressive_status_t Transcoder::decodeScan(const uint8_t* p, size_t length, size_t* pos) {
+    if (!m_componentCount || length < 1) {
+        return JPEG_PROGRESSIVE_ERR_FORMAT;
+    }
+    int count = p[0];
+    if (count < 1 || count > m_componentCount || length < 4 + 2 * (size_t)count) {
+        return JPEG_PROGRESSIVE_ERR_FORMAT;
+    }
+    Component* components[MAX_COMPONENTS];
+    const DecodeTable* dc[MAX_COMPONENTS];
+    const DecodeTable* ac[MAX_COMPONENTS];
+    for (int i = 0; i < count; i++) {
+        uint8_t id = p[1 + 2 * i];
+        uint8_t tables = p[2 + 2 * i];
+        components[i] = nullptr;
+        for (int c = 0; c < m_componentCount; c++) {
+            if (m_components[c].id == id) {
+                components[i] = &m_components[c];
+            }
+        }
+        if (!components[i] || (tables >> 4) > 3 || (tables & 0x0F) > 3) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+        dc[i] = &m_dcTables[tables >> 4];
+        ac[i] = &m_acTables[tables & 0x0F];
+        if (!dc[i]->defined || !ac[i]->defined) {
+            return JPEG_PROGRESSIVE_ERR_FORMAT;
+        }
+    }
+    const uint8_t* spectral = p + 1 + 2 * count;
+    if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0) {
+        return JPEG_PROGRESSIVE_ERR_FORMAT;     // Sequential scans cover everything
+    }
+
+    BitReader reader(m_data, m_length, *pos);
+    int pred[MAX_COMPONENTS] = {0};
+    uint32_t units = 0;
+    auto nextUnit = [&]() {
+        if (m_restartInterval && units > 0 && units % m_restartInterval == 0) {
+            memset(pred, 0, sizeof(pred));
+            if (!reader.restart()) {
+                return false;
+            }
+        }
+        units++;
+        return true;
+    };
+
+    if (count == 1) {
+        // Non-interleaved: one block per unit, image blocks only
+        Component& component = *components[0];
+        for (uint32_t y = 0; y < component.blocksH; y++) {
+            for (uint32_t x = 0; x < component.blocksW; x++) {
+                if (!nextUnit() || !decodeBlock(&reader, *dc[0], *ac[0], &pred[0], component.block(x, y))) {
+                    return JPEG_PROGRESSIVE_ERR_FORMAT;
+                }
+            }
+        }
+    } else {
+        for (uint32_t my = 0; my < m_mcusY; my++) {
+            for (uint32_t mx = 0; mx < m_mcusX; mx++) {
+                if (!nextUnit()) {
+                    return JPEG_PROGRESSIVE_ERR_FORMAT;
+                }
+                for (int i = 0; i < count; i++) {
+                    Component& component = *components[i];
+                    for (int v = 0; v < component.v; v++) {
+                        for (int h = 0; h < component.h; h++) {
+                            int16_t* block = component.block(mx * component.h + h, my * component.v + v);
+                            if (!decodeBlock(&reader, *dc[i], *ac[i], &pred[i], block)) {
+                                return JPEG_PROGRESSIVE_ERR_FORMAT;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    *pos = reader.end();
+    m_scansDecoded++;
+    return JPEG_PROGRESSIVE_OK;
+}
+
+// ----------------------------------------------------------------------------
+// Progressive output
+// ----------------------------------------------------------------------------
+
+// DC first scan, all components interleaved; chroma shares table 1
+void Transcoder::encodeDcScan(ScanEmitter* emitter) {
+    int pred[MAX_COMPONENTS] = {0};
+    auto encodeBlock = [&](int index, const int16_t* block) {
+        int diff = block[0] - pred[index];
+        pred[index] = block[0];
+        int category = bit_count((uint32_t)std::abs(diff));
+        emitter->dcSymbol(index == 0 ? 0 : 1, category);
+        emitter->bits((uint32_t)(diff < 0 ? diff - 1 : diff), category);
+    };
+
+    if (m_componentCount == 1) {
+        const Component& component = m_components[0];
+        for (uint32_t y = 0; y < component.blocksH; y++) {
+            for (uint32_t x = 0; x < component.blocksW; x++) {
+                encodeBlock(0, component.block(x, y));
+            }
+        }
+        return;
+    }
+    for (uint32_t my = 0; my < m_mcusY; my++) {
+        for (uint32_t mx = 0; mx < m_mcusX; mx++) {
+            for (int i = 0; i < m_componentCount; i++) {
+                const Component& component = m_components[i];
+                for (int v = 0; v < component.v; v++) {
+                    for (int h = 0; h < component.h; h++) {
+                        encodeBlock(i, component.block(mx * component.h + h, my * component.v + v));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// AC first scan for one component (T.81 G.1.2.2), runs of empty bands as EOBRUN
+void Transcoder::encodeAcScan(ScanEmitter* emitter, const Component& component, int ss, int se) {
+    uint32_t eobRun = 0;
+    auto flushEobRun = [&]() {
+        if (eobRun) {
+            int n = bit_count(eobRun) - 1;
+            emitter->acSymbol(n << 4);
+            emitter->bits(eobRun, n);
+            eobRun = 0;
+        }
+    };
+
+    for (uint32_t y = 0; y < component.blocksH; y++) {
+        for (uint32_t x = 0; x < component.blocksW; x++) {
+            const int16_t* block = component.block(x, y);
+            int run = 0;
+            for (int k = ss; k <= se; k++) {
+                int value = block[k];
+                if (value == 0) {
+                    run++;
+                    continue;
+                }
+                flushEobRun();
+                while (run > 15) {
+                    emitter->acSymbol(0xF0);
+                    run -= 16;
+                }
+                int size = bit_count((uint32_t)std::abs(value));
+                emitter->acSymbol((run << 4) | size);
+                emitter->bits((uint32_t)(value < 0 ? value - 1 : value), size);
+                run = 0;
+            }
+            if (run > 0 && ++eobRun == MAX_EOBRUN) {
+                flushEobRun();
+            }
+        }
+    }
+    flushEobRun();
+}
+
+void Transcoder::writeSegment(std::vector<uint8_t>* out, const Segment& segment) {
+    out->push_back(0xFF);
+    out->insert(out->end(), m_data + segment.offset + 1, m_data + segment.offset + segment.length);
+}
+
+void Transcoder::writeHuffman(std::vector<uint8_t>* out, int tableClass, int id, const EncodeTable& table) {
+    out->push_back(0xFF);
+    out->push_back(MARKER_DHT);
+    put_u16be(out, (uint16_t)(2 + 1 + 16 + table.count));
+    out->push_back((uint8_t)((tableClass << 4) | id));
+    out->insert(out->end(), table.bits + 1, table.bits + 17);
+    out->insert(out->end(), table.values, table.values + table.count);
+}
+
+void Transcoder::encode(std::vector<uint8_t>* out, jpeg_progressive_info_t* info) {
+    out->clear();
+    out->reserve(m_length + m_length / 8);
+    out->push_back(0xFF);
+    out->push_back(MARKER_SOI);
+    for (const Segment& segment : m_kept) {
+        writeSegment(out, segment);
+    }
+
+    out->push_back(0xFF);
+    out->push_back(MARKER_SOF2);
+    put_u16be(out, (uint16_t)(8 + 3 * m_componentCount));
+    out->push_back(8);
+    put_u16be(out, m_height);
+    put_u16be(out, m_width);
+    out->push_back((uint8_t)m_componentCount);
+    for (int i = 0; i < m_componentCount; i++) {
+        out->push_back(m_components[i].id);
+        out->push_back((uint8_t)((m_components[i].h << 4) | m_components[i].v));
+        out->push_back(m_components[i].tq);
+    }
+
+    // Scan script: component (-1 = all), spectral band
+    struct ScanSpec {
+        int component;
+        int ss;
+        int se;
+    };
+    static const ScanSpec COLOUR_SCANS[] = {{-1, 0, 0}, {0, 1, 5}, {1, 1, 63}, {2, 1, 63}, {0, 6, 63}};
+    static const ScanSpec GREY_SCANS[] = {{-1, 0, 0}, {0, 1, 5}, {0, 6, 63}};
+    const ScanSpec* scans = m_componentCount == 3 ? COLOUR_SCANS : GREY_SCANS;
+    const int scanCount = m_componentCount == 3 ? 5 : 3;
+
+    ScanEmitter* emitter = new ScanEmitter();
+    uint32_t previewBytes = 0;
+    for (int s = 0; s < scanCount; s++) {
+        const ScanSpec& scan = scans[s];
+        memset(emitter, 0, sizeof(*emitter));
+
+        // Pass 1: symbol statistics, pass 2: write with tables built from them
+        if (scan.component < 0) {
+            encodeDcScan(emitter);
+            build_encode_table(emitter->dcFreq[0], &emitter->dc[0]);
+            writeHuffman(out, 0, 0, emitter->dc[0]);
+            if (m_componentCount > 1) {
+                build_encode_table(emitter->dcFreq[1], &emitter->dc[1]);
+                writeHuffman(out, 0, 1, emitter->dc[1]);
+            }
+        } else {
+            encodeAcScan(emitter, m_components[scan.component], scan.ss, scan.se);
+            build_encode_table(emitter->acFreq, &emitter->ac);
+            writeHuffman(out, 1, 0, emitter->ac);
+        }
+
+        out->push_back(0xFF);
+        out->push_back(MARKER_SOS);
+        if (scan.component < 0) {
+            put_u16be(out, (uint16_t)(6 + 2 * m_componentCount));
+            out->push_back((uint8_t)m_componentCount);
+            for (int i = 0; i < m_componentCount; i++) {
+                out->push_back(m_components[i].id);
+                out->push_back(i == 0 ? 0x00 : 0x10);
+            }
+        } else {
+            put_u16be(out, 8);
+            out->push_back(1);
+            out->push_back(m_components[scan.component].id);
+            out->push_back(0x00);
+        }
+        out->push_back((uint8_t)scan.ss);
+        out->push_back((uint8_t)scan.se);
+        out->push_back(0x00);                   // No successive approximation
+
+        BitWriter writer(out);
+        emitter->writer = &writer;
+        if (scan.component < 0) {
+            encodeDcScan(emitter);
+        } else {
+            encodeAcScan(emitter, m_components[scan.component], scan.ss, scan.se);
+        }
+        writer.flush();
+        if (s == 0) {
+            previewBytes = (uint32_t)out->size();
+        }
+    }
+    delete emitter;
+
+    out->push_back(0xFF);
+    out->push_back(MARKER_EOI);
+
+    if (info) {
+        info->width = m_width;
+        info->height = m_height;
+        info->components = (uint8_t)m_componentCount;
+        info->scans = (uint8_t)scanCount;
+        info->preview_bytes = previewBytes;
+        info->size = (uint32_t)out->size();
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+jpeg_progressive_status_t jpeg_progressive_encode(const uint8_t* jpeg, size_t length,
+                                                  std::vector<uint8_t>* out,
+                                                  jpeg_progressive_info_t* info) {
+    if (!jpeg || !out) {
+        return JPEG_PROGRESSIVE_ERR_FORMAT;
+    }
+    Transcoder* transcoder = new Transcoder(jpeg, length);
+    jpeg_progressive_status_t status = transcoder->decode();
+    if (status == JPEG_PROGRESSIVE_OK) {
+        transcoder->encode(out, info);
+    }
+    delete transcoder;
+    return status;
+}
+
+const char* jpeg_progressive_status_name(jpeg_progressive_status_t status) {
+    switch (status) {
+        case JPEG_PROGRESSIVE_OK:                return "ok";
+        case JPEG_PROGRESSIVE_ERR_FORMAT:        return "malformed JPEG";
+        case JPEG_PROGRESSIVE_ERR_UNSUPPORTED:   return "unsupported JPEG";
+        case JPEG_PROGRESSIVE_ERR_NO_MEMORY:     return "out of memory";
+        default:                                 return "unknown";
+    }
+}
@@ -0,0 +1,546 @@
+/**
+ * @file link_adaptation.cpp
+ * @brief Closed-loop HaLow rate and voice codec adaptation
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/link_adaptation.h"
+#include "include/halow_phy.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+
+static const char* TAG = "LINK_ADAPT";
+
+/**
+ * Voice tiers, best first. A link uses the first tier whose max_loss covers
+ * its loss average; the local encoder follows the worst link.
+ */
+static const struct {
+    float max_loss;
+    link_audio_profile_t profile;
+} AUDIO_TIERS[] = {
+    { 0.01f, { 24000, false,  0 } },
+    { 0.05f, { 20000, true,   5 } },
+    { 0.12f, { 16000, true,  12 } },
+    { 1.00f, { 12000, true,  25 } },
+};
+static const uint8_t AUDIO_TIER_COUNT = sizeof(AUDIO_TIERS) / sizeof(AUDIO_TIERS[0]);
+static const uint8_t AUDIO_TIER_NONE = 0xFF;
+
+// A link returns to a better voice tier only once its loss is below half of
+// that tier's limit
+#define AUDIO_TIER_UP_FACTOR 0.5f
+
+static const uint8_t BANDWIDTHS_MHZ[] = { 1, 2, 4, 8 };
+
+LinkAdaptation::LinkAdaptation()
+    : m_config(defaultConfig())
+    , m_mutex(xSemaphoreCreateMutex())
+    , m_radio(NULL)
+    , m_rateControl(true)
+    , m_ladderSize(0)
+    , m_appliedAudioTier(AUDIO_TIER_NONE)
+    , m_codecConfig(AUDIO_CODEC_DEFAULT_CONFIG)
+    , m_codecWarned(false) {
+    buildLadder();
+}
+
+LinkAdaptation::~LinkAdaptation() {
+    if (m_mutex) {
+        vSemaphoreDelete(m_mutex);
+    }
+}
+
+link_adaptation_config_t LinkAdaptation::defaultConfig() {
+    link_adaptation_config_t config = {};
+    config.ewma_alpha = 0.25f;
+    config.rssi_margin_db = 3.0f;
+    config.loss_up_threshold = 0.02f;
+    config.loss_down_threshold = 0.10f;
+    config.up_hold_ms = 3000;
+    config.min_dwell_ms = 2000;
+    config.stale_ms = 60000;
+    config.max_bandwidth_mhz = 2;   // Matches the default HaLowConfig bandwidth
+    config.adapt_audio = true;
+    return config;
+}
+
+bool LinkAdaptation::configure(const link_adaptation_config_t& config) {
+    if (config.ewma_alpha <= 0.0f || config.ewma_alpha > 1.0f ||
+        config.loss_up_threshold >= config.loss_down_threshold ||
+        halow_bandwidth_index(config.max_bandwidth_mhz) < 0) {
+        ESP_LOGE(TAG, "Invalid link adaptation configuration");
+        return false;
+    }
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    m_config = config;
+    buildLadder();
+    // The ladder may have changed shape; re-place every link from its RSSI
+    for (auto& entry : m_links) {
+        LinkState& link = entry.second;
+        if (link.rung >= m_ladderSize) {
+            link.rung = m_ladderSize - 1;
+        }
+        link.placed = false;
+        link.upSinceUs = 0;
+        link.rateDirty = true;
+    }
+    xSemaphoreGive(m_mutex);
+
+    ESP_LOGI(TAG, "Configured: %d rate rungs up to %d MHz, alpha %.2f, loss %.0f%%/%.0f%%",
+             m_ladderSize, config.max_bandwidth_mhz, config.ewma_alpha,
+             config.loss_up_threshold * 100.0f, config.loss_down_threshold * 100.0f);
+    return true;
+}
+
+void LinkAdaptation::setRadio(IHaLow* radio) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    m_radio = radio;
+    m_rateControl = true;
+    // A new radio knows nothing about our earlier choices
+    for (auto& entry : m_links) {
+        entry.second.rateDirty = true;
+    }
+    xSemaphoreGive(m_mutex);
+}
+
+void LinkAdaptation::buildLadder() {
+    // Every valid MCS/width pair the network allows, sorted by PHY rate
+    link_rate_t candidates[LINK_ADAPTATION_MAX_RUNGS];
+    uint8_t count = 0;
+    candidates[count++] = { HALOW_MCS_RANGE_EXT, 1 };
+    for (uint8_t bandwidth : BANDWIDTHS_MHZ) {
+        if (bandwidth > m_config.max_bandwidth_mhz) {
+            break;
+        }
+        for (uint8_t mcs = 0; mcs <= HALOW_MCS_MAX; mcs++) {
+            candidates[count++] = { mcs, bandwidth };
+        }
+    }
+    for (uint8_t i = 1; i < count; i++) {
+        link_rate_t key = candidates[i];
+        uint32_t key_rate = halow_phy_rate_kbps(key.mcs, key.bandwidth_mhz);
+        int j = i - 1;
+        while (j >= 0 && halow_phy_rate_kbps(candidates[j].mcs, candidates[j].bandwidth_mhz) > key_rate) {
+            candidates[j + 1] = candidates[j];
+            j--;
+        }
+        candidates[j + 1] = key;
+    }
+
+    // Keep a pair only if it is more robust than every faster pair, so each
+    // rung up trades sensitivity for rate
+    uint8_t keep[LINK_ADAPTATION_MAX_RUNGS];
+    uint8_t kept = 0;
+    float best_sensitivity = 0.0f;
+    for (int i = count - 1; i >= 0; i--) {
+        float sensitivity = halow_sensitivity_dbm(candidates[i].mcs, candidates[i].bandwidth_mhz);
+        if (kept == 0 || sensitivity < best_sensitivity) {
+            keep[kept++] = (uint8_t)i;
+            best_sensitivity = sensitivity;
+        }
+    }
+
+    m_ladderSize = 0;
+    for (int i = kept - 1; i >= 0; i--) {
+        m_ladder[m_ladderSize++] = candidates[keep[i]];
+    }
+}
+
+float LinkAdaptation::rungSensitivity(uint8_t rung) const {
+    return halow_sensitivity_dbm(m_ladder[rung].mcs, m_ladder[rung].bandwidth_mhz);
+}
+
+LinkAdaptation::LinkState& LinkAdaptation::linkFor(const std::string& peer_id, int64_t now) {
+    auto it = m_links.find(peer_id);
+    if (it == m_links.end()) {
+        LinkState state = {};
+        state.rung = 0;             // Most robust until we hear how strong the peer is
+        state.lastChangeUs = now;
+        state.rateDirty = true;
+        it = m_links.emplace(peer_id, state).first;
+        ESP_LOGI(TAG, "Tracking link to %s", peer_id.c_str());
+    }
+    it->second.lastSampleUs = now;
+    return it->second;
+}
+
+void LinkAdaptation::updateRssi(LinkState& link, int32_t rssi_dbm) {
+    if (rssi_dbm >= 0) {
+        return;                     // 0 means unknown; real readings are negative dBm
+    }
+    if (link.rssiSamples == 0) {
+        link.rssi = (float)rssi_dbm;
+    } else {
+        link.rssi += m_config.ewma_alpha * ((float)rssi_dbm - link.rssi);
+    }
+    link.rssiSamples++;
+}
+
+void LinkAdaptation::reportLinkSample(const std::string& peer_id, int32_t rssi_dbm,
+                                      uint32_t expected, uint32_t received) {
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    LinkState& link = linkFor(peer_id, now);
+    updateRssi(link, rssi_dbm);
+    if (expected > 0) {
+        float sample = received >= expected ? 0.0f : (float)(expected - received) / (float)expected;
+        if (link.lossSamples == 0) {
+            link.loss = sample;
+        } else {
+            link.loss += m_config.ewma_alpha * (sample - link.loss);
+        }
+        link.lossSamples++;
+    }
+    xSemaphoreGive(m_mutex);
+}
+
+void LinkAdaptation::reportRssi(const std::string& peer_id, int32_t rssi_dbm) {
+    reportLinkSample(peer_id, rssi_dbm, 0, 0);
+}
+
+void LinkAdaptation::removeLink(const std::string& peer_id) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    m_links.erase(peer_id);
+    xSemaphoreGive(m_mutex);
+}
+
+bool LinkAdaptation::evaluateRate(LinkState& link, int64_t now) {
+    if (link.rssiSamples == 0) {
+        return false;
+    }
+
+    // First reading: go straight to the fastest rung with margin to spare
+    if (!link.placed) {
+        link.placed = true;
+        uint8_t target = 0;
+        for (uint8_t r = 0; r < m_ladderSize; r++) {
+            if (rungSensitivity(r) + m_config.rssi_margin_db <= link.rssi) {
+                target = r;
+            }
+        }
+        if (target != link.rung) {
+            link.rung = target;
+            link.lastChangeUs = now;
+            link.rateChanges++;
+            return true;
+        }
+        return false;
+    }
+
+    if (now - link.lastChangeUs < (int64_t)m_config.min_dwell_ms * 1000) {
+        return false;
+    }
+
+    bool weak = link.rssi < rungSensitivity(link.rung);
+    bool lossy = link.lossSamples > 0 && link.loss > m_config.loss_down_threshold;
+    if ((weak || lossy) && link.rung > 0) {
+        uint8_t target = 0;
+        for (uint8_t r = 0; r < m_ladderSize; r++) {
+            if (rungSensitivity(r) <= link.rssi) {
+                target = r;
+            }
+        }
+        if (target >= link.rung) {
+            target = link.rung - 1;     // RSSI looks fine but frames are lost: back off one rung
+        }
+        link.rung = target;
+        link.lastChangeUs = now;
+        link.upSinceUs = 0;
+        link.lossSamples = 0;
+        link.rateChanges++;
+        return true;
+    }
+
+    bool clean = link.lossSamples == 0 || link.loss < m_config.loss_up_threshold;
+    bool headroom = link.rung + 1 < m_ladderSize &&
+                    rungSensitivity(link.rung + 1) + m_config.rssi_margin_db <= link.rssi;
+    if (!clean || !headroom) {
+        link.upSinceUs = 0;
+        return false;
+    }
+    if (link.upSinceUs == 0) {
+        link.upSinceUs = now;
+        return false;
+    }
+    if (now - link.upSinceUs < (int64_t)m_config.up_hold_ms * 1000) {
+        return false;
+    }
+
+    link.rung++;
+    link.lastChangeUs = now;
+    link.upSinceUs = 0;
+    link.lossSamples = 0;
+    link.rateChanges++;
+    return true;
+}
+
+void LinkAdaptation::evaluateAudioTier(LinkState& link, int64_t now) {
+    if (link.lossSamples == 0) {
+        return;
+    }
+
+    uint8_t target = 0;
+    while (target < AUDIO_TIER_COUNT - 1 && link.loss > AUDIO_TIERS[target].max_loss) {
+        target++;
+    }
+
+    if (target > link.audioTier) {
+        link.audioTier = target;
+        link.audioUpSinceUs = 0;
+        return;
+    }
+
+    if (link.audioTier == 0 ||
+        link.loss >= AUDIO_TIERS[link.audioTier - 1].max_loss * AUDIO_TIER_UP_FACTOR) {
+        link.audioUpSinceUs = 0;
+        return;
+    }
+    if (link.audioUpSinceUs == 0) {
+        link.audioUpSinceUs = now;
+    } else if (now - link.audioUpSinceUs >= (int64_t)m_config.up_hold_ms * 1000) {
+        link.audioTier--;
+        link.audioUpSinceUs = 0;
+    }
+}
+
+void LinkAdaptation::tick() {
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    IHaLow* radio = m_radio;
+    xSemaphoreGive(m_mutex);
+
+    // Query the radio without holding our lock; it takes its own
+    std::vector<HaLowPeerInfo> peers;
+    if (radio && radio->isInitialized()) {
+        peers = radio->getConnectedPeers();
+    }
+
+    std::vector<RateCommand> commands;
+    uint8_t worst_tier = AUDIO_TIER_NONE;
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    for (const HaLowPeerInfo& peer : peers) {
+        updateRssi(linkFor(peer.peer_id, now), peer.rssi);
+    }
+
+    for (auto it = m_links.begin(); it != m_links.end();) {
+        LinkState& link = it->second;
+        if (now - link.lastSampleUs > (int64_t)m_config.stale_ms * 1000) {
+            ESP_LOGI(TAG, "Link to %s went stale", it->first.c_str());
+            it = m_links.erase(it);
+            continue;
+        }
+
+        uint8_t old_rung = link.rung;
+        if (evaluateRate(link, now)) {
+            const link_rate_t& from = m_ladder[old_rung];
+            const link_rate_t& to = m_ladder[link.rung];
+            ESP_LOGI(TAG, "%s: MCS%d/%dMHz -> MCS%d/%dMHz (RSSI %.1f dBm, loss %.1f%%)",
+                     it->first.c_str(), from.mcs, from.bandwidth_mhz, to.mcs, to.bandwidth_mhz,
+                     link.rssi, link.loss * 100.0f);
+            link.rateDirty = true;
+        }
+        if (link.rateDirty && radio && m_rateControl) {
+            commands.push_back({ it->first, m_ladder[link.rung] });
+            link.rateDirty = false;
+        }
+
+        evaluateAudioTier(link, now);
+        if (link.lossSamples > 0 && (worst_tier == AUDIO_TIER_NONE || link.audioTier > worst_tier)) {
+            worst_tier = link.audioTier;
+        }
+        ++it;
+    }
+    bool adapt_audio = m_config.adapt_audio;
+    xSemaphoreGive(m_mutex);
+
+    for (const RateCommand& command : commands) {
+        char mcs[4];
+        char bandwidth[4];
+        snprintf(mcs, sizeof(mcs), "%u", command.rate.mcs);
+        snprintf(bandwidth, sizeof(bandwidth), "%u", command.rate.bandwidth_mhz);
+        std::string result = radio->sendRawCommand("set_link_rate", { command.peerId, mcs, bandwidth });
+        if (result.compare(0, sizeof(HALOW_RESULT_UNSUPPORTED) - 1, HALOW_RESULT_UNSUPPORTED) == 0) {
+            // Leave rates to the radio instead of retrying on every tick
+            ESP_LOGW(TAG, "Radio has no rate control, link rates left to it: %s", result.c_str());
+            xSemaphoreTake(m_mutex, portMAX_DELAY);
+            if (m_radio == radio) {
+                m_rateControl = false;
+            }
+            xSemaphoreGive(m_mutex);
+            break;
+        }
+        if (result.compare(0, 5, "ERROR") == 0) {
+            ESP_LOGW(TAG, "Radio rejected rate for %s: %s", command.peerId.c_str(), result.c_str());
+            xSemaphoreTake(m_mutex, portMAX_DELAY);
+            auto it = m_links.find(command.peerId);
+            if (it != m_links.end()) {
+                it->second.rateDirty = true;
+            }
+            xSemaphoreGive(m_mutex);
+        }
+    }
+
+    if (adapt_audio && worst_tier != AUDIO_TIER_NONE) {
+        applyAudioTier(worst_tier);
+    }
+}
+
+void LinkAdaptation::applyAudioTier(uint8_t tier) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    if (tier == m_appliedAudioTier) {
+        xSemaphoreGive(m_mutex);
+        return;
+    }
+    audio_codec_config_t config = m_codecConfig;
+    xSemaphoreGive(m_mutex);
+
+    if (!codecRunning()) {
+        return;                     // Applied once the codec comes up
+    }
+
+    const link_audio_profile_t& profile = AUDIO_TIERS[tier].profile;
+    config.bitrate = profile.bitrate;
+    config.enable_fec = profile.enable_fec;
+    config.packet_loss_perc = profile.packet_loss_perc;
+
+    int result = audio_codec_reconfigure(&config);
+    if (result != AUDIO_CODEC_OK) {
+        ESP_LOGW(TAG, "Codec reconfigure to tier %d failed: %d", tier, result);
+        return;
+    }
+
+    // Only the tier's fields; the complexity may have changed meanwhile
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    m_codecConfig.bitrate = config.bitrate;
+    m_codecConfig.enable_fec = config.enable_fec;
+    m_codecConfig.packet_loss_perc = config.packet_loss_perc;
+    m_appliedAudioTier = tier;
+    xSemaphoreGive(m_mutex);
+
+    ESP_LOGI(TAG, "Voice tier %d: %d bps, FEC %s, expected loss %d%%",
+             tier, profile.bitrate, profile.enable_fec ? "on" : "off", profile.packet_loss_perc);
+}
+
+void LinkAdaptation::setCodecComplexity(int complexity) {
+    complexity = complexity < 0 ? 0 : complexity > 10 ? 10 : complexity;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    if (complexity == m_codecConfig.complexity) {
+        xSemaphoreGive(m_mutex);
+        return;
+    }
+    // Kept even if the codec is not up; every later reconfigure carries it
+    m_codecConfig.complexity = complexity;
+    audio_codec_config_t config = m_codecConfig;
+    xSemaphoreGive(m_mutex);
+
+    if (!codecRunning()) {
+        return;
+    }
+    int result = audio_codec_reconfigure(&config);
+    if (result != AUDIO_CODEC_OK) {
+        ESP_LOGW(TAG, "Codec complexity %d failed: %d", complexity, result);
+        return;
+    }
+    ESP_LOGI(TAG, "Codec complexity %d", complexity);
+}
+
+bool LinkAdaptation::codecAdaptationSupported() const {
+    return audio_codec_is_ready();
+}
+
+bool LinkAdaptation::codecRunning() {
+    if (audio_codec_is_ready()) {
+        return true;
+    }
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    bool warned = m_codecWarned;
+    m_codecWarned = true;
+    xSemaphoreGive(m_mutex);
+    if (!warned) {
+        ESP_LOGW(TAG, "Voice codec not running: voice tiers are tracked but not applied");
+    }
+    return false;
+}
+
+link_rate_t LinkAdaptation::getLinkRate(const std::string& peer_id) const {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    auto it = m_links.find(peer_id);
+    link_rate_t rate = m_ladder[it != m_links.end() ? it->second.rung : 0];
+    xSemaphoreGive(m_mutex);
+    return rate;
+}
+
+link_audio_profile_t LinkAdaptation::getAudioProfile() const {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    link_audio_profile_t profile;
+    profile.bitrate = m_codecConfig.bitrate;
+    profile.enable_fec = m_codecConfig.enable_fec;
+    profile.packet_loss_perc = m_codecConfig.packet_loss_perc;
+    xSemaphoreGive(m_mutex);
+    return profile;
+}
+
+std::vector<link_adaptation_link_t> LinkAdaptation::getLinks() const {
+    std::vector<link_adaptation_link_t> links;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    links.reserve(m_links.size());
+    for (const auto& entry : m_links) {
+        const LinkState& state = entry.second;
+        link_adaptation_link_t link;
+        link.peer_id = entry.first;
+        link.rssi_dbm = state.rssi;
+        link.loss = state.loss;
+        link.rate = m_ladder[state.rung];
+        link.phy_rate_kbps = halow_phy_rate_kbps(link.rate.mcs, link.rate.bandwidth_mhz);
+        link.audio_tier = state.audioTier;
+        link.rate_changes = state.rateChanges;
+        links.push_back(link);
+    }
+    xSemaphoreGive(m_mutex);
+    return links;
+}
+
+bool LinkAdaptation::getAggregate(int32_t* rssi_dbm, uint32_t* loss_percent) const {
+    float rssi_sum = 0.0f;
+    float loss_sum = 0.0f;
+    uint32_t rssi_count = 0;
+    uint32_t loss_count = 0;
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    for (const auto& entry : m_links) {
+        if (entry.second.rssiSamples > 0) {
+            rssi_sum += entry.second.rssi;
+            rssi_count++;
+        }
+        if (entry.second.lossSamples > 0) {
+            loss_sum += entry.second.loss;
+            loss_count++;
+        }
+    }
+    xSemaphoreGive(m_mutex);
+
+    if (rssi_dbm) {
+        *rssi_dbm = rssi_count > 0 ? (int32_t)(rssi_sum / rssi_count) : 0;
+    }
+    if (loss_percent) {
+        *loss_percent = loss_count > 0 ? (uint32_t)(loss_sum * 100.0f / loss_count + 0.5f) : 0;
+    }
+    return rssi_count > 0 || loss_count > 0;
+}
+
+void LinkAdaptation::logLinks() const {
+    for (const link_adaptation_link_t& link : getLinks()) {
+        ESP_LOGI(TAG, "%s: RSSI %.1f dBm, loss %.1f%%, MCS%d/%dMHz (%u kbps), voice tier %d, %u changes",
+                 link.peer_id.c_str(), link.rssi_dbm, link.loss * 100.0f,
+                 link.rate.mcs, link.rate.bandwidth_mhz, (unsigned)link.phy_rate_kbps,
+                 link.audio_tier, (unsigned)link.rate_changes);
+    }
+}
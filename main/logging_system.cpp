@@ -10,7 +10,10 @@
  * @date 2024
  */
 
+// The console output below uses the ESP-IDF ESP_LOGx macros themselves
+#define LOGGING_SYSTEM_IMPLEMENTATION
 #include "logging_system.h"
+#include "metrics_registry.h"
 #include "esp_log.h"
 #include <string>
 #include <map>
@@ -34,7 +37,7 @@ static bool g_console_output = true;
 static bool g_file_output = false;
 static bool g_network_output = false;
 
-// Component statistics
+// Per-component statistics (totals per level are in the metrics registry)
 static std::map<std::string, std::map<log_level_t, uint32_t>> g_component_stats;
 
 // Helper functions
@@ -160,6 +163,7 @@ void logging_system_log_error(const char* component, error_code_t code, const ch
 
     // Update statistics
     g_component_stats[component][LOG_LEVEL_ERROR]++;
+    metrics_counter_inc(METRIC_LOG_ERRORS);
 }
 
 void logging_system_log_warning(const char* component, const char* message,
@@ -179,6 +183,7 @@ void logging_system_log_warning(const char* component, const char* message,
     }
 
     g_component_stats[component][LOG_LEVEL_WARNING]++;
+    metrics_counter_inc(METRIC_LOG_WARNINGS);
 }
 
 void logging_system_log_info(const char* component, const char* message,
@@ -198,6 +203,7 @@ void logging_system_log_info(const char* component, const char* message,
     }
 
     g_component_stats[component][LOG_LEVEL_INFO]++;
+    metrics_counter_inc(METRIC_LOG_INFO);
 }
 
 void logging_system_log_debug(const char* component, const char* message,
@@ -217,6 +223,7 @@ void logging_system_log_debug(const char* component, const char* message,
     }
 
     g_component_stats[component][LOG_LEVEL_DEBUG]++;
+    metrics_counter_inc(METRIC_LOG_DEBUG);
 }
 
 void logging_system_log_verbose(const char* component, const char* message,
@@ -236,6 +243,7 @@ void logging_system_log_verbose(const char* component, const char* message,
     }
 
     g_component_stats[component][LOG_LEVEL_VERBOSE]++;
+    metrics_counter_inc(METRIC_LOG_VERBOSE);
 }
 
 // Output control functions
@@ -40,17 +40,29 @@
 #include "include/audio_task.h"
 #include "include/shared_data.h"
 #include "include/error_handling.h"
+#include "include/event_executor.h"
 #include "include/network_task.h"
 #include "include/atak_processor_task.h"
 #include "include/network_health_task.h"
 #include "include/ota_updater.h"
 #include "include/camera_service.h"
+#include "include/outbox_service.h"
+#include "include/talkgroup.h"
+#include "include/floor_service.h"
+#include "include/recorder_service.h"
+#include "include/history_service.h"
+#include "include/power_service.h"
+#include "include/battery_service.h"
+#include "include/boot_sequence.h"
 #include "include/config_manager.h"
 
 #include "../components/aircom_proto/AirCom.pb-c.h"
 #include "crypto.h"
 #include "nvs_flash.h"
 #include "include/bt_audio.h"
+#include "include/telemetry_service.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "esp_spiffs.h"
 
 
 
@@ -69,18 +81,17 @@ static TaskHandle_t uiTaskHandle = NULL;
 static TaskHandle_t audioTaskHandle = NULL;
 static TaskHandle_t gpsTaskHandle = NULL;
 static TaskHandle_t networkHealthTaskHandle = NULL;
+static TaskHandle_t telemetryTaskHandle = NULL;
 
+// ============================================================================
+// BOOT STAGES
+// ============================================================================
+//
+// The optional services log their own failures and the node runs without
+// them, as it always has, so their stages do not fail. A stage that fails
+// skips every stage that depends on it.
 
-
-
-
-
-
-void app_main(void)
-{
-    ESP_LOGI(MAIN_TAG, "Welcome to Project AirCom (ESP-IDF)!");
-
-    // Initialize NVS
+static int stage_nvs(void) {
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
       ESP_ERROR_CHECK(nvs_flash_erase());
@@ -91,27 +102,137 @@ void app_main(void)
                     "Failed to initialize NVS", __FILE__, __LINE__, __func__, NULL, 0);
     }
     ESP_ERROR_CHECK(ret);
+    return 0;
+}
 
-    // Initialize shared data structures (like queues)
-    shared_data_init();
+// Radio credentials and platform defaults, before any task uses them
+static int stage_config(void) {
+    if (!config_manager_init()) {
+        ESP_LOGE(MAIN_TAG, "Failed to initialize configuration manager, using built-in defaults");
+    }
+    return 0;
+}
 
-    // Initialize error handling system
+static int stage_errors(void) {
     if (!error_handling_init()) {
         ESP_LOGE(MAIN_TAG, "Failed to initialize error handling system");
-        return;
+        return -1;
     }
+    return 0;
+}
 
-    // Initialize Bluetooth audio
-    bt_audio_init();
+// The deferred event executor, before any radio callbacks can fire
+static int stage_executor(void) {
+    if (!EventExecutor::getInstance().start()) {
+        error_report(ERROR_CATEGORY_SYSTEM, ERROR_TASK_CREATION,
+                    "Failed to start event executor", __FILE__, __LINE__, __func__, NULL, 0);
+    }
+    return 0;
+}
 
-    // Initialize OTA Updater Service
-    ota_updater_init();
+// Activity states, DFS, light sleep and radio duty cycling; before the
+// polling tasks, which ask it how long to wait
+static int stage_power(void) {
+    power_service_init();
+    return 0;
+}
+
+// The longest stage: the services that listen to the mesh start alongside it
+static int stage_radio(void) {
+    return HaLowMeshManager::getInstance().begin() ? 0 : -1;
+}
+
+// Queues shared between the tasks
+static int stage_shared_data(void) {
+    shared_data_init();
+    return 0;
+}
+
+// One mount for the outbox, recorder, history and OTA store, which would
+// otherwise race to mount the partition from parallel stages
+static int stage_storage(void) {
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = OTA_SPIFFS_BASE_PATH,
+        .partition_label = OTA_SPIFFS_PARTITION,
+        .max_files = 4,
+        .format_if_mount_failed = true
+    };
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(MAIN_TAG, "Cannot mount %s: %s", OTA_SPIFFS_PARTITION, esp_err_to_name(err));
+    }
+    return 0;
+}
+
+// Talkgroup memberships, before voice and ATAK traffic starts
+static int stage_talkgroup(void) {
+    talkgroup_init();
+    return 0;
+}
+
+// Push-to-talk floor control for the TX talkgroup
+static int stage_floor(void) {
+    floor_service_init();
+    return 0;
+}
+
+// Store-and-forward outbox for text messages
+static int stage_outbox(void) {
+    outbox_service_init();
+    return 0;
+}
+
+// Per-task CPU, stack and queue telemetry
+static int stage_telemetry(void) {
+    if (telemetry_init()) {
+        telemetry_register_queue("ui_update", ui_update_queue);
+        telemetry_register_queue("outgoing_msg", outgoing_message_queue);
+        telemetry_register_queue("audio_command", audio_command_queue);
+        telemetry_register_queue("incoming_msg", incoming_message_queue);
+    }
+    return 0;
+}
+
+// Rolling voice recording for instant replay
+static int stage_recorder(void) {
+    recorder_service_init();
+    return 0;
+}
 
-    // Initialize Camera Service
-    // In a real app, you might only initialize this if a camera is detected or enabled in config
+// Encrypted text message history in flash
+static int stage_history(void) {
+    history_service_init();
+    return 0;
+}
+
+// Fuel gauge; lowers beacon, CoT, UI and codec rates as the charge drops
+static int stage_battery(void) {
+    battery_service_init();
+    return 0;
+}
+
+// Receives images; the sensor itself starts on the first capture
+static int stage_camera(void) {
     camera_service_init();
+    return 0;
+}
+
+// Hashes the running image and opens the update store; nothing waits for it
+static int stage_ota(void) {
+    ota_updater_init();
+    return 0;
+}
 
-    // Create FreeRTOS tasks
+// Lazy: the controller and HFP take the better part of a second and most
+// sessions never pair a headset
+static int stage_bluetooth(void) {
+    bt_audio_init();
+    return 0;
+}
+
+// The tasks start before the radio is up; those that need it wait for
+// BOOT_STAGE_RADIO themselves
+static int stage_tasks(void) {
     ESP_LOGI(MAIN_TAG, "Creating tasks...");
 
     // Optimized task scheduling for real-time performance
@@ -160,22 +281,64 @@ void app_main(void)
                     "Failed to create UI task", __FILE__, __LINE__, __func__, NULL, 0);
     }
 
-    result = xTaskCreatePinnedToCore(audioTask, "Audio", STACK_SIZE_DEFAULT, NULL, 10, &audioTaskHandle, 1); // Optimized audio priority for timing guarantees
+    result = xTaskCreatePinnedToCore(audioTask, "Audio", STACK_SIZE_DEFAULT, NULL, 10, &audioTaskHandle, 1); // Starts the audio lanes, then ends
     if (result != pdPASS) {
         error_report(ERROR_CATEGORY_SYSTEM, ERROR_TASK_CREATION,
                     "Failed to create Audio task", __FILE__, __LINE__, __func__, NULL, 0);
     }
 
+    result = xTaskCreatePinnedToCore(telemetry_task, "Telemetry", STACK_SIZE_DEFAULT, NULL, 1, &telemetryTaskHandle, 0);
+    if (result != pdPASS) {
+        error_report(ERROR_CATEGORY_SYSTEM, ERROR_TASK_CREATION,
+                    "Failed to create Telemetry task", __FILE__, __LINE__, __func__, NULL, 0);
+    }
+
     ESP_LOGI(MAIN_TAG, "All tasks created with optimized real-time scheduling.");
+    return 0;
+}
 
-    // Performance monitoring - log current task priorities
-    ESP_LOGI(MAIN_TAG, "Task Priority Summary:");
-    ESP_LOGI(MAIN_TAG, "  Network/Network tasks: Priority 3");
-    ESP_LOGI(MAIN_TAG, "  ATAK tasks: Priority 2-3");
-    ESP_LOGI(MAIN_TAG, "  GPS task: Priority 4");
-    ESP_LOGI(MAIN_TAG, "  UI task: Priority 8 (optimized for responsiveness)");
-    ESP_LOGI(MAIN_TAG, "  Audio task: Priority 10 (optimized for timing guarantees)");
+void app_main(void)
+{
+    ESP_LOGI(MAIN_TAG, "Welcome to Project AirCom (ESP-IDF)!");
+
+    // Stages run as soon as what they need is up, on a worker per core
+    boot_stage_fn_t stages[BOOT_STAGE_COUNT] = {};
+    stages[BOOT_STAGE_NVS] = stage_nvs;
+    stages[BOOT_STAGE_CONFIG] = stage_config;
+    stages[BOOT_STAGE_ERRORS] = stage_errors;
+    stages[BOOT_STAGE_EXECUTOR] = stage_executor;
+    stages[BOOT_STAGE_POWER] = stage_power;
+    stages[BOOT_STAGE_RADIO] = stage_radio;
+    stages[BOOT_STAGE_SHARED_DATA] = stage_shared_data;
+    stages[BOOT_STAGE_STORAGE] = stage_storage;
+    stages[BOOT_STAGE_TALKGROUP] = stage_talkgroup;
+    stages[BOOT_STAGE_FLOOR] = stage_floor;
+    stages[BOOT_STAGE_OUTBOX] = stage_outbox;
+    stages[BOOT_STAGE_TELEMETRY] = stage_telemetry;
+    stages[BOOT_STAGE_RECORDER] = stage_recorder;
+    stages[BOOT_STAGE_HISTORY] = stage_history;
+    stages[BOOT_STAGE_BATTERY] = stage_battery;
+    stages[BOOT_STAGE_TASKS] = stage_tasks;
+    stages[BOOT_STAGE_CAMERA] = stage_camera;
+    stages[BOOT_STAGE_OTA] = stage_ota;
+    stages[BOOT_STAGE_BLUETOOTH] = stage_bluetooth;
+
+    static BootGraph graph;
+    boot_sequence_build(&graph, stages);
+    if (boot_sequence_run(&graph) != 0) {
+        ESP_LOGE(MAIN_TAG, "Boot finished with failed stages, see the timeline above");
+    }
+
+    // Report stack usage against the size each task was created with;
+    // the audio task ends once its lanes run and registers them itself
+    TaskHandle_t taskHandles[] = {
+        networkTaskHandle, tcpServerTaskHandle, atakTaskHandle, atakProcessorTaskHandle,
+        networkHealthTaskHandle, gpsTaskHandle, uiTaskHandle, telemetryTaskHandle
+    };
+    for (TaskHandle_t handle : taskHandles) {
+        telemetry_register_task(handle, STACK_SIZE_DEFAULT);
+    }
 
-    // Monitor task stack usage for performance validation
-    ESP_LOGI(MAIN_TAG, "Performance monitoring enabled - check logs for timing violations");
+    ESP_LOGI(MAIN_TAG, "Telemetry: CPU, stack and queue snapshot every %d s, published every %d s on port %d",
+             TELEMETRY_SAMPLE_INTERVAL_MS / 1000, TELEMETRY_MESH_INTERVAL_MS / 1000, TELEMETRY_PORT);
 }
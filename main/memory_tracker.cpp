@@ -11,13 +11,16 @@
  */
 
 #include "memory_tracker.h"
+#include "metrics_registry.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
 #include <time.h>
 #include <inttypes.h>
+#include <stdint.h>
 
 static const char* TAG = "MEMORY_TRACKER";
 
@@ -25,7 +28,6 @@ static const char* TAG = "MEMORY_TRACKER";
 static bool g_memory_tracking_enabled = false;
 static memory_allocation_t g_allocations[MEMORY_TRACKER_MAX_ALLOCATIONS];
 static uint32_t g_allocation_count = 0;
-static memory_stats_t g_memory_stats = {0};
 static TaskHandle_t g_monitoring_task = NULL;
 
 // Internal helper functions
@@ -34,7 +36,7 @@ static uint32_t get_current_timestamp(void) {
 }
 
 static uint32_t get_current_thread_id(void) {
-    return (uint32_t)xTaskGetCurrentTaskHandle();
+    return (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
 }
 
 static int find_allocation_index(void* ptr) {
@@ -82,10 +84,18 @@ bool memory_tracker_init(void) {
     }
 
     memset(g_allocations, 0, sizeof(g_allocations));
-    memset(&g_memory_stats, 0, sizeof(g_memory_stats));
     g_allocation_count = 0;
 
-    g_memory_stats.last_cleanup_timestamp = get_current_timestamp();
+    metrics_counter_reset(METRIC_MEM_ALLOCATIONS);
+    metrics_counter_reset(METRIC_MEM_DEALLOCATIONS);
+    metrics_counter_reset(METRIC_MEM_ALLOC_FAILURES);
+    metrics_counter_reset(METRIC_MEM_FRAGMENTATION_EVENTS);
+    metrics_gauge_reset(METRIC_MEM_CURRENT_ALLOCATIONS);
+    metrics_gauge_reset(METRIC_MEM_CURRENT_BYTES);
+    metrics_gauge_reset(METRIC_MEM_PEAK_BYTES);
+    metrics_gauge_reset(METRIC_MEM_LEAKS);
+    metrics_histogram_reset(METRIC_MEM_ALLOCATION_SIZE);
+    metrics_gauge_set(METRIC_MEM_LAST_CLEANUP, (int32_t)get_current_timestamp());
     g_memory_tracking_enabled = true;
 
     ESP_LOGI(TAG, "Memory tracker initialized");
@@ -138,20 +148,18 @@ void memory_tracker_track_allocation(void* ptr, size_t size, const char* file, i
 #endif
 
     // Update statistics
-    g_memory_stats.total_allocations++;
-    g_memory_stats.current_allocations++;
-    g_memory_stats.current_memory_usage += size;
-
-    if (g_memory_stats.current_memory_usage > g_memory_stats.peak_memory_usage) {
-        g_memory_stats.peak_memory_usage = g_memory_stats.current_memory_usage;
-    }
+    metrics_counter_inc(METRIC_MEM_ALLOCATIONS);
+    metrics_histogram_record(METRIC_MEM_ALLOCATION_SIZE, (uint32_t)size);
+    metrics_gauge_add(METRIC_MEM_CURRENT_ALLOCATIONS, 1);
+    metrics_gauge_add(METRIC_MEM_CURRENT_BYTES, (int32_t)size);
+    metrics_gauge_max(METRIC_MEM_PEAK_BYTES, metrics_gauge_get(METRIC_MEM_CURRENT_BYTES));
 
     // Check usage limits
     int usage_level = memory_tracker_check_usage_limits(80, 95);
     if (usage_level > 0) {
         ESP_LOGW(TAG, "Memory usage at %s level (%zu bytes)",
                 usage_level == 1 ? "warning" : "critical",
-                g_memory_stats.current_memory_usage);
+                (size_t)metrics_gauge_get(METRIC_MEM_CURRENT_BYTES));
     }
 }
 
@@ -170,9 +178,9 @@ void memory_tracker_track_deallocation(void* ptr, const char* file, int line) {
     memory_allocation_t* alloc = &g_allocations[index];
 
     // Update statistics
-    g_memory_stats.total_deallocations++;
-    g_memory_stats.current_allocations--;
-    g_memory_stats.current_memory_usage -= alloc->size;
+    metrics_counter_inc(METRIC_MEM_DEALLOCATIONS);
+    metrics_gauge_add(METRIC_MEM_CURRENT_ALLOCATIONS, -1);
+    metrics_gauge_add(METRIC_MEM_CURRENT_BYTES, -(int32_t)alloc->size);
 
     // Mark as freed
     alloc->is_freed = true;
@@ -181,7 +189,15 @@ void memory_tracker_track_deallocation(void* ptr, const char* file, int line) {
 bool memory_tracker_get_stats(memory_stats_t* stats) {
     if (!stats) return false;
 
-    memcpy(stats, &g_memory_stats, sizeof(memory_stats_t));
+    stats->total_allocations = metrics_counter_get(METRIC_MEM_ALLOCATIONS);
+    stats->total_deallocations = metrics_counter_get(METRIC_MEM_DEALLOCATIONS);
+    stats->current_allocations = (uint32_t)metrics_gauge_get(METRIC_MEM_CURRENT_ALLOCATIONS);
+    stats->peak_memory_usage = (size_t)metrics_gauge_get(METRIC_MEM_PEAK_BYTES);
+    stats->current_memory_usage = (size_t)metrics_gauge_get(METRIC_MEM_CURRENT_BYTES);
+    stats->memory_leaks = (uint32_t)metrics_gauge_get(METRIC_MEM_LEAKS);
+    stats->allocation_failures = metrics_counter_get(METRIC_MEM_ALLOC_FAILURES);
+    stats->fragmentation_count = metrics_counter_get(METRIC_MEM_FRAGMENTATION_EVENTS);
+    stats->last_cleanup_timestamp = (uint32_t)metrics_gauge_get(METRIC_MEM_LAST_CLEANUP);
     return true;
 }
 
@@ -208,7 +224,7 @@ uint32_t memory_tracker_detect_leaks(void) {
         }
     }
 
-    g_memory_stats.memory_leaks = leak_count;
+    metrics_gauge_set(METRIC_MEM_LEAKS, (int32_t)leak_count);
     return leak_count;
 }
 
@@ -268,7 +284,7 @@ void memory_tracker_cleanup_old_records(uint32_t max_age_seconds) {
         ESP_LOGI(TAG, "Cleaned up %u old memory records", cleaned);
     }
 
-    g_memory_stats.last_cleanup_timestamp = current_time;
+    metrics_gauge_set(METRIC_MEM_LAST_CLEANUP, (int32_t)current_time);
 }
 
 int memory_tracker_check_usage_limits(uint8_t warning_threshold, uint8_t critical_threshold) {
@@ -279,7 +295,7 @@ int memory_tracker_check_usage_limits(uint8_t warning_threshold, uint8_t critica
         return 0; // Cannot determine usage
     }
 
-    uint8_t usage_percentage = (g_memory_stats.current_memory_usage * 100) / total_heap;
+    uint8_t usage_percentage = ((size_t)metrics_gauge_get(METRIC_MEM_CURRENT_BYTES) * 100) / total_heap;
 
     if (usage_percentage >= critical_threshold) {
         return 2; // Critical
@@ -350,7 +366,7 @@ void memory_tracker_print_leaks(void) {
 
 // Monitoring task function
 static void memory_monitoring_task(void* pvParameters) {
-    uint32_t interval_seconds = (uint32_t)pvParameters;
+    uint32_t interval_seconds = (uint32_t)(uintptr_t)pvParameters;
 
     ESP_LOGI(TAG, "Memory monitoring task started (interval: %u seconds)", interval_seconds);
 
@@ -392,7 +408,7 @@ bool memory_tracker_start_monitoring(uint32_t interval_seconds) {
     if (xTaskCreate(memory_monitoring_task,
                    "MemoryMonitor",
                    2048,
-                   (void*)interval_seconds,
+                   (void*)(uintptr_t)interval_seconds,
                    1,
                    &g_monitoring_task) != pdPASS) {
         ESP_LOGE(TAG, "Failed to create memory monitoring task");
@@ -0,0 +1,666 @@
+/**
+ * @file message_history.cpp
+ * @brief Persistent, encrypted text message history with a per-conversation index
+ *
+ * Log record, little endian:
+ *   box length u16, nonce (12 bytes), box, crc u32 (over everything before it)
+ * The box is crypto_secretbox over:
+ *   direction, epoch u32, name length, name, text length, text
+ * Index blob:
+ *   magic u32, nonce (12 bytes), box length u32, box, crc u32
+ * with the box over:
+ *   version, append order u32, segment count u16, per segment (id u16,
+ *   bytes u32, sealed), conversation count u16, per conversation (name
+ *   length, name, unread u32, last epoch u32, last order u32, message
+ *   count u32, locations u32 each)
+ * Nonces are the stored 12 bytes padded with zeros.
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/message_history.h"
+#include "include/ota_mesh.h"
+#include "esp_log.h"
+#include "sodium.h"
+#include <string.h>
+#include <algorithm>
+
+static const char* TAG = "MESSAGE_HISTORY";
+
+#define HISTORY_INDEX_MAGIC 0x58494841u     // "AHIX"
+#define HISTORY_INDEX_VERSION 1
+#define HISTORY_NONCE_SIZE 12
+#define HISTORY_RECORD_HEADER 14            // Box length and nonce
+#define HISTORY_RECORD_OVERHEAD (HISTORY_RECORD_HEADER + crypto_secretbox_MACBYTES + 4)
+#define HISTORY_PLAIN_FIXED 7               // Without the name and text
+#define HISTORY_MAX_PLAIN (HISTORY_PLAIN_FIXED + HISTORY_NAME_LEN - 1 + HISTORY_MAX_TEXT)
+#define HISTORY_MAX_RECORD (HISTORY_RECORD_OVERHEAD + HISTORY_MAX_PLAIN)
+
+history_config_t history_default_config(void) {
+    history_config_t config;
+    config.max_bytes = 64 * 1024;
+    config.segment_bytes = 8 * 1024;
+    config.checkpoint_bytes = 8 * 1024;
+    config.checkpoint_ms = 10 * 60 * 1000;
+    return config;
+}
+
+static void put_u16(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back((uint8_t)value);
+    out->push_back((uint8_t)(value >> 8));
+}
+
+static void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint16_t get_u16(const uint8_t* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static uint32_t location_of(uint16_t segment, uint32_t offset) {
+    return ((uint32_t)segment << 16) | offset;
+}
+
+static uint16_t segment_of(uint32_t location) {
+    return (uint16_t)(location >> 16);
+}
+
+// Bounds-checked reader for the index
+class Cursor {
+public:
+    Cursor(const uint8_t* data, size_t length) : m_at(data), m_end(data + length) {}
+
+    bool ok() const { return m_ok; }
+    bool done() const { return m_at == m_end; }
+
+    uint8_t u8() { return take(1) ? m_at[-1] : 0; }
+    uint16_t u16() { return take(2) ? get_u16(m_at - 2) : 0; }
+    uint32_t u32() { return take(4) ? get_u32(m_at - 4) : 0; }
+
+    std::string text(size_t length) {
+        return take(length) ? std::string((const char*)m_at - length, length) : std::string();
+    }
+
+private:
+    bool take(size_t length) {
+        if (!m_ok || (size_t)(m_end - m_at) < length) {
+            m_ok = false;
+            return false;
+        }
+        m_at += length;
+        return true;
+    }
+
+    const uint8_t* m_at;
+    const uint8_t* m_end;
+    bool m_ok = true;
+};
+
+// Fields of a record's plaintext
+struct Plain {
+    uint8_t direction;
+    uint32_t epochS;
+    std::string conversation;
+    std::string text;
+};
+
+static bool decode_plain(const std::vector<uint8_t>& plain, Plain* out) {
+    Cursor cursor(plain.data(), plain.size());
+    out->direction = cursor.u8();
+    out->epochS = cursor.u32();
+    out->conversation = cursor.text(cursor.u8());
+    out->text = cursor.text(cursor.u8());
+    return cursor.ok() && cursor.done() && !out->conversation.empty();
+}
+
+MessageHistory::MessageHistory(IHistoryStorage* storage, const uint8_t* key, uint64_t seed,
+                               const history_config_t& config)
+    : m_storage(storage), m_noncePrefix(seed), m_config(config) {
+    memcpy(m_key, key, sizeof(m_key));
+    if (m_config.segment_bytes < HISTORY_MAX_RECORD) {
+        m_config.segment_bytes = HISTORY_MAX_RECORD;
+    }
+}
+
+MessageHistory::~MessageHistory() {
+    volatile uint8_t* key = m_key;
+    for (size_t i = 0; i < sizeof(m_key); i++) {
+        key[i] = 0;
+    }
+}
+
+// ============================================================================
+// SEALING
+// ============================================================================
+
+// Stored nonce: the start-up prefix and a counter, never repeated under one key
+void MessageHistory::nextNonce(uint8_t* nonce) {
+    for (int i = 0; i < 8; i++) {
+        nonce[i] = (uint8_t)(m_noncePrefix >> (8 * i));
+    }
+    uint32_t counter = m_nonceCounter++;
+    for (int i = 0; i < 4; i++) {
+        nonce[8 + i] = (uint8_t)(counter >> (8 * i));
+    }
+}
+
+bool MessageHistory::seal(const uint8_t* nonce, const uint8_t* plain, size_t length, uint8_t* box) {
+    uint8_t full[crypto_secretbox_NONCEBYTES] = {};
+    memcpy(full, nonce, HISTORY_NONCE_SIZE);
+    return crypto_secretbox_easy(box, plain, length, full, m_key) == 0;
+}
+
+bool MessageHistory::open(const uint8_t* nonce, const uint8_t* box, size_t boxLength, std::vector<uint8_t>* plain) {
+    if (boxLength < crypto_secretbox_MACBYTES) {
+        return false;
+    }
+    uint8_t full[crypto_secretbox_NONCEBYTES] = {};
+    memcpy(full, nonce, HISTORY_NONCE_SIZE);
+    plain->resize(boxLength - crypto_secretbox_MACBYTES);
+    // The output may not be empty for the library
+    uint8_t none;
+    return crypto_secretbox_open_easy(plain->empty() ? &none : plain->data(), box, boxLength, full, m_key) == 0;
+}
+
+// Whole log record from its plaintext
+bool MessageHistory::makeRecord(const std::vector<uint8_t>& plain, std::vector<uint8_t>* record) {
+    size_t boxLength = plain.size() + crypto_secretbox_MACBYTES;
+    record->clear();
+    record->reserve(HISTORY_RECORD_OVERHEAD + plain.size());
+    put_u16(record, (uint16_t)boxLength);
+    record->resize(HISTORY_RECORD_HEADER + boxLength);
+    nextNonce(record->data() + 2);
+    if (!seal(record->data() + 2, plain.data(), plain.size(), record->data() + HISTORY_RECORD_HEADER)) {
+        return false;
+    }
+    put_u32(record, ota_crc32(record->data(), record->size()));
+    return true;
+}
+
+// Frame and decrypt the record at data. Returns false if it is not a whole
+// record (end of the log or a torn write); a whole record that does not
+// decrypt leaves plain empty.
+bool MessageHistory::parseRecord(const uint8_t* data, size_t available, size_t* recordLength,
+                                 std::vector<uint8_t>* plain) {
+    if (available < HISTORY_RECORD_OVERHEAD) {
+        return false;
+    }
+    size_t boxLength = get_u16(data);
+    if (boxLength < crypto_secretbox_MACBYTES || boxLength > HISTORY_MAX_PLAIN + crypto_secretbox_MACBYTES) {
+        return false;
+    }
+    *recordLength = HISTORY_RECORD_HEADER + boxLength + 4;
+    if (*recordLength > available ||
+        get_u32(data + HISTORY_RECORD_HEADER + boxLength) != ota_crc32(data, HISTORY_RECORD_HEADER + boxLength)) {
+        return false;
+    }
+    if (!open(data + 2, data + HISTORY_RECORD_HEADER, boxLength, plain)) {
+        plain->clear();
+        m_stats.damaged++;
+    }
+    return true;
+}
+
+// ============================================================================
+// INDEX
+// ============================================================================
+
+void MessageHistory::indexRecord(const std::string& conversation, uint8_t direction, uint32_t epochS,
+                                 uint32_t location) {
+    Conversation& entry = m_conversations[conversation];
+    entry.locations.push_back(location);
+    if (direction == HISTORY_DIRECTION_RX) {
+        entry.unread++;
+    } else {
+        entry.unread = 0;                   // Answering reads the conversation
+    }
+    if (epochS) {
+        entry.lastEpochS = epochS;
+    }
+    entry.lastOrder = ++m_order;
+    m_messageCount++;
+}
+
+// Drop a segment's messages from the index
+void MessageHistory::forgetSegment(uint16_t id) {
+    for (auto it = m_conversations.begin(); it != m_conversations.end();) {
+        std::vector<uint32_t>& locations = it->second.locations;
+        size_t before = locations.size();
+        locations.erase(std::remove_if(locations.begin(), locations.end(),
+                                       [id](uint32_t location) { return segment_of(location) == id; }),
+                        locations.end());
+        size_t dropped = before - locations.size();
+        m_messageCount -= dropped;
+        m_stats.messages_dropped += dropped;
+        if (it->second.unread > locations.size()) {
+            it->second.unread = locations.size();
+        }
+        it = locations.empty() ? m_conversations.erase(it) : std::next(it);
+    }
+}
+
+// Index the records of a segment from an offset on; stops at the first
+// record that is not whole
+size_t MessageHistory::scanSegment(Segment& segment, uint32_t from) {
+    uint32_t size = 0;
+    if (!m_storage->size(segment.id, &size) || size <= from) {
+        segment.bytes = from;
+        return 0;
+    }
+    size = std::min<uint32_t>(size, HISTORY_MAX_SEGMENT_BYTES + HISTORY_MAX_RECORD);
+    std::vector<uint8_t> data(size - from);
+    size_t length = m_storage->read(segment.id, from, data.data(), data.size());
+    m_stats.bytes_read += length;
+
+    size_t offset = 0;
+    size_t records = 0;
+    std::vector<uint8_t> plain;
+    Plain fields;
+    size_t recordLength = 0;
+    while (parseRecord(data.data() + offset, length - offset, &recordLength, &plain)) {
+        if (!plain.empty() && decode_plain(plain, &fields)) {
+            indexRecord(fields.conversation, fields.direction, fields.epochS,
+                        location_of(segment.id, from + offset));
+            records++;
+        }
+        offset += recordLength;
+    }
+    segment.bytes = from + offset;
+    if (segment.bytes < size) {
+        ESP_LOGW(TAG, "Segment %04x: %u damaged bytes at its end", segment.id, (unsigned)(size - segment.bytes));
+        segment.sealed = true;
+        m_stats.damaged++;
+    }
+    m_stats.load_records += records;
+    return records;
+}
+
+std::vector<uint8_t> MessageHistory::encodeIndex() const {
+    std::vector<uint8_t> out;
+    out.push_back(HISTORY_INDEX_VERSION);
+    put_u32(&out, m_order);
+    put_u16(&out, (uint16_t)m_segments.size());
+    for (const Segment& segment : m_segments) {
+        put_u16(&out, segment.id);
+        put_u32(&out, segment.bytes);
+        out.push_back(segment.sealed ? 1 : 0);
+    }
+    put_u16(&out, (uint16_t)m_conversations.size());
+    for (const auto& entry : m_conversations) {
+        const Conversation& conversation = entry.second;
+        out.push_back((uint8_t)entry.first.size());
+        out.insert(out.end(), entry.first.begin(), entry.first.end());
+        put_u32(&out, conversation.unread);
+        put_u32(&out, conversation.lastEpochS);
+        put_u32(&out, conversation.lastOrder);
+        put_u32(&out, (uint32_t)conversation.locations.size());
+        for (uint32_t location : conversation.locations) {
+            put_u32(&out, location);
+        }
+    }
+    return out;
+}
+
+bool MessageHistory::decodeIndex(const std::vector<uint8_t>& blob) {
+    static const size_t HEADER = 4 + HISTORY_NONCE_SIZE + 4;
+    if (blob.size() < HEADER + 4 || get_u32(blob.data()) != HISTORY_INDEX_MAGIC ||
+        get_u32(blob.data() + blob.size() - 4) != ota_crc32(blob.data(), blob.size() - 4)) {
+        return false;
+    }
+    size_t boxLength = get_u32(blob.data() + 4 + HISTORY_NONCE_SIZE);
+    std::vector<uint8_t> plain;
+    if (boxLength != blob.size() - HEADER - 4 ||
+        !open(blob.data() + 4, blob.data() + HEADER, boxLength, &plain)) {
+        return false;
+    }
+
+    Cursor cursor(plain.data(), plain.size());
+    if (cursor.u8() != HISTORY_INDEX_VERSION) {
+        return false;
+    }
+    m_order = cursor.u32();
+    size_t segments = cursor.u16();
+    for (size_t i = 0; i < segments && cursor.ok(); i++) {
+        Segment segment;
+        segment.id = cursor.u16();
+        segment.bytes = cursor.u32();
+        segment.sealed = cursor.u8() != 0;
+        m_segments.push_back(segment);
+    }
+    size_t conversations = cursor.u16();
+    for (size_t i = 0; i < conversations && cursor.ok(); i++) {
+        std::string name = cursor.text(cursor.u8());
+        Conversation conversation;
+        conversation.unread = cursor.u32();
+        conversation.lastEpochS = cursor.u32();
+        conversation.lastOrder = cursor.u32();
+        uint32_t count = cursor.u32();
+        if (!cursor.ok() || count > plain.size() / 4) {
+            return false;
+        }
+        conversation.locations.reserve(count);
+        for (uint32_t j = 0; j < count; j++) {
+            conversation.locations.push_back(cursor.u32());
+        }
+        m_messageCount += count;
+        m_conversations[name] = std::move(conversation);
+    }
+    return cursor.ok() && cursor.done();
+}
+
+void MessageHistory::clear() {
+    m_segments.clear();
+    m_conversations.clear();
+    m_messageCount = 0;
+    m_order = 0;
+}
+
+// Index every segment found, oldest first. Segment numbers wrap: the oldest
+// is the one after the widest gap in the numbering.
+void MessageHistory::rebuild() {
+    clear();
+    m_stats.load_records = 0;
+    std::vector<uint16_t> ids;
+    if (!m_storage->list(&ids) || ids.empty()) {
+        return;
+    }
+    std::sort(ids.begin(), ids.end());
+    size_t first = 0;
+    uint32_t widest = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        uint32_t gap = (uint16_t)(ids[(i + 1) % ids.size()] - ids[i]);
+        if (gap == 0) {
+            gap = 0x10000;                  // A single segment
+        }
+        if (gap > widest) {
+            widest = gap;
+            first = (i + 1) % ids.size();
+        }
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+        Segment segment = {ids[(first + i) % ids.size()], 0, false};
+        m_segments.push_back(segment);
+        scanSegment(m_segments.back(), 0);
+    }
+    // Nothing known about what was read before
+    for (auto& entry : m_conversations) {
+        entry.second.unread = 0;
+    }
+}
+
+// Check a checkpoint against the segments present and index what was
+// appended after it. Returns false if storage does not match it.
+bool MessageHistory::catchUp() {
+    if (m_segments.empty()) {
+        // Segments started after an empty checkpoint
+        std::vector<uint16_t> ids;
+        return m_storage->list(&ids) && ids.empty();
+    }
+    for (auto it = m_segments.begin(); it != m_segments.end();) {
+        uint32_t size = 0;
+        if (!m_storage->size(it->id, &size)) {
+            // Deleted after the checkpoint was saved
+            forgetSegment(it->id);
+            it = m_segments.erase(it);
+            continue;
+        }
+        if (size < it->bytes) {
+            return false;
+        }
+        if (size > it->bytes && !it->sealed) {
+            if (&*it != &m_segments.back()) {
+                return false;               // Only the newest segment grows
+            }
+            scanSegment(*it, it->bytes);
+        }
+        ++it;
+    }
+    // Segments started after the checkpoint
+    uint32_t size = 0;
+    while (!m_segments.empty() && m_storage->size((uint16_t)(m_segments.back().id + 1), &size)) {
+        Segment segment = {(uint16_t)(m_segments.back().id + 1), 0, false};
+        m_segments.push_back(segment);
+        scanSegment(m_segments.back(), 0);
+    }
+    return true;
+}
+
+bool MessageHistory::load(uint32_t nowMs) {
+    if (sodium_init() < 0) {
+        ESP_LOGE(TAG, "Crypto library not available");
+        return false;
+    }
+    clear();
+    m_stats.load_records = 0;
+    std::vector<uint8_t> blob;
+    if (!m_storage->loadIndex(&blob)) {
+        ESP_LOGE(TAG, "Cannot read the history index");
+        return false;
+    }
+    m_stats.bytes_read += blob.size();
+
+    bool fromCheckpoint = !blob.empty() && decodeIndex(blob) && catchUp();
+    if (!fromCheckpoint) {
+        if (!blob.empty()) {
+            ESP_LOGW(TAG, "History index unusable, rebuilding it from the log");
+        }
+        rebuild();
+    }
+    if (m_stats.load_records || (!fromCheckpoint && !m_segments.empty())) {
+        // Saved by the first tick, so that the next start need not read
+        // these records again and this one is not held up by the write
+        markDirty(nowMs);
+        m_uncheckpointedBytes = m_config.checkpoint_bytes;
+    }
+    ESP_LOGI(TAG, "History loaded: %u messages in %u conversations, %u records read",
+             (unsigned)m_messageCount, (unsigned)m_conversations.size(), (unsigned)m_stats.load_records);
+    return true;
+}
+
+bool MessageHistory::checkpoint() {
+    std::vector<uint8_t> plain = encodeIndex();
+    std::vector<uint8_t> blob;
+    blob.reserve(4 + HISTORY_NONCE_SIZE + 4 + plain.size() + crypto_secretbox_MACBYTES + 4);
+    put_u32(&blob, HISTORY_INDEX_MAGIC);
+    blob.resize(4 + HISTORY_NONCE_SIZE);
+    nextNonce(blob.data() + 4);
+    put_u32(&blob, (uint32_t)(plain.size() + crypto_secretbox_MACBYTES));
+    size_t boxAt = blob.size();
+    blob.resize(boxAt + plain.size() + crypto_secretbox_MACBYTES);
+    uint8_t none = 0;
+    if (!seal(blob.data() + 4, plain.empty() ? &none : plain.data(), plain.size(), blob.data() + boxAt)) {
+        return false;
+    }
+    put_u32(&blob, ota_crc32(blob.data(), blob.size()));
+    if (!m_storage->saveIndex(blob)) {
+        ESP_LOGE(TAG, "Saving the history index of %u bytes failed", (unsigned)blob.size());
+        return false;
+    }
+    m_dirty = false;
+    m_uncheckpointedBytes = 0;
+    m_stats.checkpoints++;
+    m_stats.checkpoint_bytes_written += blob.size();
+    return true;
+}
+
+// ============================================================================
+// MESSAGES
+// ============================================================================
+
+void MessageHistory::markDirty(uint32_t nowMs) {
+    if (!m_dirty) {
+        m_dirty = true;
+        m_dirtySinceMs = nowMs;
+    }
+}
+
+bool MessageHistory::append(const std::string& conversation, uint8_t direction, uint32_t epochS,
+                            const std::string& text, uint32_t nowMs) {
+    if (conversation.empty() || conversation.size() >= HISTORY_NAME_LEN || text.size() > HISTORY_MAX_TEXT ||
+        direction > HISTORY_DIRECTION_TX) {
+        m_stats.rejected++;
+        return false;
+    }
+    std::vector<uint8_t> plain;
+    plain.reserve(HISTORY_PLAIN_FIXED + conversation.size() + text.size());
+    plain.push_back(direction);
+    put_u32(&plain, epochS);
+    plain.push_back((uint8_t)conversation.size());
+    plain.insert(plain.end(), conversation.begin(), conversation.end());
+    plain.push_back((uint8_t)text.size());
+    plain.insert(plain.end(), text.begin(), text.end());
+
+    std::vector<uint8_t> record;
+    if (!makeRecord(plain, &record)) {
+        m_stats.rejected++;
+        return false;
+    }
+
+    if (m_segments.empty() || m_segments.back().sealed ||
+        m_segments.back().bytes + record.size() > m_config.segment_bytes) {
+        Segment segment = {(uint16_t)(m_segments.empty() ? 0 : m_segments.back().id + 1), 0, false};
+        // A leftover file with this number would be read as part of it
+        uint32_t size = 0;
+        if (m_storage->size(segment.id, &size) && !m_storage->remove(segment.id)) {
+            m_stats.rejected++;
+            return false;
+        }
+        m_segments.push_back(segment);
+        markDirty(nowMs);
+    }
+    Segment& segment = m_segments.back();
+    if (!m_storage->append(segment.id, record.data(), record.size())) {
+        ESP_LOGE(TAG, "Append of %u bytes to segment %04x failed", (unsigned)record.size(), segment.id);
+        segment.sealed = true;              // It may hold part of the record
+        m_stats.rejected++;
+        return false;
+    }
+    indexRecord(conversation, direction, epochS, location_of(segment.id, segment.bytes));
+    segment.bytes += record.size();
+    m_uncheckpointedBytes += record.size();
+    markDirty(nowMs);
+    m_stats.appended++;
+    m_stats.log_bytes_written += record.size();
+    return true;
+}
+
+size_t MessageHistory::conversations(history_conversation_t* out, size_t max) const {
+    std::vector<std::map<std::string, Conversation>::const_iterator> order;
+    order.reserve(m_conversations.size());
+    for (auto it = m_conversations.begin(); it != m_conversations.end(); ++it) {
+        order.push_back(it);
+    }
+    std::sort(order.begin(), order.end(), [](const std::map<std::string, Conversation>::const_iterator& a,
+                                             const std::map<std::string, Conversation>::const_iterator& b) {
+        return a->second.lastOrder > b->second.lastOrder;
+    });
+    size_t count = std::min(max, order.size());
+    for (size_t i = 0; i < count; i++) {
+        history_conversation_t& entry = out[i];
+        memset(&entry, 0, sizeof(entry));
+        strncpy(entry.name, order[i]->first.c_str(), sizeof(entry.name) - 1);
+        entry.messages = order[i]->second.locations.size();
+        entry.unread = order[i]->second.unread;
+        entry.last_epoch_s = order[i]->second.lastEpochS;
+    }
+    return count;
+}
+
+size_t MessageHistory::count(const std::string& conversation) const {
+    auto it = m_conversations.find(conversation);
+    return it == m_conversations.end() ? 0 : it->second.locations.size();
+}
+
+bool MessageHistory::readMessage(uint32_t location, history_message_t* out) {
+    uint8_t data[HISTORY_MAX_RECORD];
+    size_t length = m_storage->read(segment_of(location), location & 0xFFFF, data, sizeof(data));
+    m_stats.bytes_read += length;
+    std::vector<uint8_t> plain;
+    Plain fields;
+    size_t recordLength = 0;
+    if (!parseRecord(data, length, &recordLength, &plain)) {
+        m_stats.damaged++;
+        return false;
+    }
+    if (plain.empty() || !decode_plain(plain, &fields)) {
+        return false;
+    }
+    out->direction = fields.direction;
+    out->epoch_s = fields.epochS;
+    memcpy(out->text, fields.text.data(), fields.text.size());
+    out->text[fields.text.size()] = '\0';
+    m_stats.records_read++;
+    return true;
+}
+
+size_t MessageHistory::page(const std::string& conversation, size_t skip, history_message_t* out, size_t max) {
+    auto it = m_conversations.find(conversation);
+    if (it == m_conversations.end()) {
+        return 0;
+    }
+    const std::vector<uint32_t>& locations = it->second.locations;
+    size_t count = 0;
+    for (size_t i = skip; i < locations.size() && count < max; i++) {
+        if (readMessage(locations[locations.size() - 1 - i], &out[count])) {
+            count++;
+        }
+    }
+    m_stats.pages_read++;
+    return count;
+}
+
+void MessageHistory::markRead(const std::string& conversation, uint32_t nowMs) {
+    auto it = m_conversations.find(conversation);
+    if (it != m_conversations.end() && it->second.unread) {
+        it->second.unread = 0;
+        markDirty(nowMs);
+    }
+}
+
+// ============================================================================
+// BACKGROUND WORK
+// ============================================================================
+
+uint32_t MessageHistory::logBytes() const {
+    uint32_t bytes = 0;
+    for (const Segment& segment : m_segments) {
+        bytes += segment.bytes;
+    }
+    return bytes;
+}
+
+bool MessageHistory::dropOldest() {
+    uint16_t id = m_segments.front().id;
+    if (!m_storage->remove(id)) {
+        ESP_LOGW(TAG, "Cannot delete history segment %04x", id);
+        return false;
+    }
+    forgetSegment(id);
+    m_segments.pop_front();
+    m_stats.segments_dropped++;
+    return true;
+}
+
+void MessageHistory::tick(uint32_t nowMs) {
+    // The log may pass its size by up to a segment between ticks
+    bool dropped = false;
+    while (m_segments.size() > 1 && logBytes() > m_config.max_bytes && dropOldest()) {
+        dropped = true;
+    }
+    if (dropped) {
+        markDirty(nowMs);
+    }
+    if (m_dirty && (m_uncheckpointedBytes >= m_config.checkpoint_bytes ||
+                    (int32_t)(nowMs - m_dirtySinceMs) >= (int32_t)m_config.checkpoint_ms)) {
+        checkpoint();
+    }
+}
@@ -0,0 +1,844 @@
+/**
+ * @file message_outbox.cpp
+ * @brief Persistent store-and-forward outbox for messages to single peers
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/message_outbox.h"
+#include "include/ota_mesh.h"
+#include "esp_log.h"
+#include <string.h>
+#include <algorithm>
+
+static const char* TAG = "MESSAGE_OUTBOX";
+
+// Frame header: magic, protocol version, frame type
+static const uint8_t FRAME_MAGIC[4] = {'A', 'M', 'S', 'G'};
+static const uint8_t PROTOCOL_VERSION = 1;
+static const size_t FRAME_HEADER_SIZE = 6;
+
+enum {
+    FRAME_DATA = 1,
+    FRAME_ACK = 2,
+    FRAME_SUMMARY = 3
+};
+
+// ACK status
+enum {
+    ACK_DELIVERED = 1,                      // This node is the destination
+    ACK_CUSTODY = 2,                        // Stored; the sender may delete its copy
+    ACK_REFUSED = 3                         // Not stored; keep it
+};
+
+// Log records: type, body length, body, CRC-32 of all three
+enum {
+    RECORD_STORE = 1,
+    RECORD_DELETE = 2
+};
+static const size_t RECORD_OVERHEAD = 7;
+
+static const size_t MESSAGE_FIXED_SIZE = 15;        // Body without the IDs and payload
+static const size_t RECENTLY_RECEIVED = 64;
+static const uint32_t MAX_TTL_S = 7 * 24 * 3600;
+
+static bool is_due(uint32_t nowMs, uint32_t deadlineMs) {
+    return (int32_t)(nowMs - deadlineMs) >= 0;
+}
+
+static void put_u16(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back((uint8_t)value);
+    out->push_back((uint8_t)(value >> 8));
+}
+
+static void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void put_id(std::vector<uint8_t>* out, const std::string& id) {
+    out->push_back((uint8_t)id.size());
+    out->insert(out->end(), id.begin(), id.end());
+}
+
+static uint16_t get_u16(const uint8_t* data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Reads a length-prefixed node ID and advances the cursor
+static bool get_id(const uint8_t** cursor, const uint8_t* end, std::string* id) {
+    if (*cursor >= end) {
+        return false;
+    }
+    size_t length = **cursor;
+    if (length == 0 || length >= OUTBOX_NODE_ID_LEN || (size_t)(end - *cursor) < 1 + length) {
+        return false;
+    }
+    id->assign((const char*)*cursor + 1, length);
+    *cursor += 1 + length;
+    return true;
+}
+
+static std::vector<uint8_t> make_frame(uint8_t type, size_t bodyReserve) {
+    std::vector<uint8_t> frame;
+    frame.reserve(FRAME_HEADER_SIZE + bodyReserve);
+    for (uint8_t byte : FRAME_MAGIC) {
+        frame.push_back(byte);
+    }
+    frame.push_back(PROTOCOL_VERSION);
+    frame.push_back(type);
+    return frame;
+}
+
+static uint32_t remaining_ttl_s(uint32_t expiresAtMs, uint32_t nowMs) {
+    int32_t remainingMs = (int32_t)(expiresAtMs - nowMs);
+    return remainingMs > 1000 ? (uint32_t)remainingMs / 1000 : 1;
+}
+
+outbox_config_t outbox_default_config(void) {
+    outbox_config_t config;
+    config.ack_timeout_ms = 1500;
+    config.attempts_per_contact = 4;
+    config.window = 4;
+    config.neighbour_timeout_ms = 30000;
+    config.summary_interval_ms = 20000;
+    config.default_ttl_s = 24 * 3600;
+    config.max_messages = 64;
+    config.max_bytes = 32 * 1024;
+    config.custody_percent = 50;
+    config.max_hops = 6;
+    config.carrier_margin_ms = 30000;
+    config.compact_min_bytes = 4096;
+    return config;
+}
+
+bool MessageOutbox::isOutboxFrame(const uint8_t* data, size_t length) {
+    return data && length >= FRAME_HEADER_SIZE && memcmp(data, FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0 &&
+           data[4] == PROTOCOL_VERSION;
+}
+
+// Same layout in DATA frames and STORE records
+static void encode_message(uint32_t id, const std::string& origin, const std::string& destination,
+                           uint8_t priority, uint8_t flags, uint8_t hops, uint32_t ttlS,
+                           const std::vector<uint8_t>& payload, std::vector<uint8_t>* out) {
+    put_u32(out, id);
+    out->push_back(priority);
+    out->push_back(flags);
+    out->push_back(hops);
+    put_u32(out, ttlS);
+    put_id(out, origin);
+    put_id(out, destination);
+    put_u16(out, (uint16_t)payload.size());
+    out->insert(out->end(), payload.begin(), payload.end());
+}
+
+MessageOutbox::MessageOutbox(const std::string& nodeId, IOutboxStorage* storage, SendFunction send,
+                             const outbox_config_t& config, uint32_t seed)
+    : m_nodeId(nodeId), m_storage(storage), m_send(send), m_config(config),
+      m_nextId(seed * 2654435761u), m_nextOrder(0), m_logBytes(0), m_liveBytes(0), m_loaded(false),
+      m_stats() {
+    m_config.window = std::max(m_config.window, (uint8_t)1);
+    m_config.attempts_per_contact = std::max(m_config.attempts_per_contact, (uint8_t)1);
+}
+
+// ============================================================================
+// LOG
+// ============================================================================
+
+bool MessageOutbox::appendRecord(uint8_t type, const std::vector<uint8_t>& body) {
+    std::vector<uint8_t> record;
+    record.reserve(RECORD_OVERHEAD + body.size());
+    record.push_back(type);
+    put_u16(&record, (uint16_t)body.size());
+    record.insert(record.end(), body.begin(), body.end());
+    put_u32(&record, ota_crc32(record.data(), record.size()));
+    if (!m_storage->append(record.data(), record.size())) {
+        ESP_LOGE(TAG, "Log append of %u bytes failed", (unsigned)record.size());
+        return false;
+    }
+    m_logBytes += record.size();
+    m_stats.log_writes++;
+    m_stats.log_bytes_written += record.size();
+    return true;
+}
+
+bool MessageOutbox::parseLog(const std::vector<uint8_t>& log, uint32_t nowMs, size_t* validBytes) {
+    size_t offset = 0;
+    while (offset + RECORD_OVERHEAD <= log.size()) {
+        const uint8_t* record = log.data() + offset;
+        size_t bodyLength = get_u16(record + 1);
+        size_t recordLength = RECORD_OVERHEAD + bodyLength;
+        if (offset + recordLength > log.size() ||
+            get_u32(record + 3 + bodyLength) != ota_crc32(record, 3 + bodyLength)) {
+            break;                          // Torn write at power loss
+        }
+        const uint8_t* body = record + 3;
+        const uint8_t* end = body + bodyLength;
+
+        if (record[0] == RECORD_STORE && bodyLength >= MESSAGE_FIXED_SIZE) {
+            Message message;
+            const uint8_t* cursor = body + 11;
+            if (get_id(&cursor, end, &message.origin) && get_id(&cursor, end, &message.destination) &&
+                end - cursor >= 2 && (size_t)(end - cursor - 2) == get_u16(cursor)) {
+                message.id = get_u32(body);
+                message.priority = body[4];
+                message.flags = body[5];
+                message.hops = body[6];
+                message.expiresAtMs = nowMs + std::min(get_u32(body + 7), MAX_TTL_S) * 1000;
+                message.payload.assign(cursor + 2, end);
+                message.recordBytes = recordLength;
+                message.order = m_nextOrder++;
+                Key key(message.origin, message.id);
+                auto old = m_messages.find(key);
+                if (old != m_messages.end()) {
+                    m_liveBytes -= old->second.recordBytes;
+                    m_byDestination[old->second.destination].erase(
+                        Slot(-(int)old->second.priority, old->second.order, key));
+                }
+                m_byDestination[message.destination].insert(Slot(-(int)message.priority, message.order, key));
+                m_liveBytes += recordLength;
+                m_messages[key] = std::move(message);
+            }
+        } else if (record[0] == RECORD_DELETE && bodyLength >= 6) {
+            std::string origin;
+            const uint8_t* cursor = body + 4;
+            if (get_id(&cursor, end, &origin)) {
+                auto it = m_messages.find(Key(origin, get_u32(body)));
+                if (it != m_messages.end()) {
+                    m_liveBytes -= it->second.recordBytes;
+                    m_byDestination[it->second.destination].erase(Slot(-(int)it->second.priority,
+                                                                        it->second.order, it->first));
+                    m_messages.erase(it);
+                }
+            }
+        }
+        offset += recordLength;
+    }
+    for (auto it = m_byDestination.begin(); it != m_byDestination.end();) {
+        it = it->second.empty() ? m_byDestination.erase(it) : std::next(it);
+    }
+    *validBytes = offset;
+    return offset == log.size();
+}
+
+// Rewrite the log with the live messages only, at their remaining lifetime
+bool MessageOutbox::compact(uint32_t nowMs) {
+    std::vector<uint8_t> log;
+    std::vector<uint8_t> body;
+    std::vector<size_t> sizes;
+    for (const auto& entry : m_messages) {
+        const Message& message = entry.second;
+        body.clear();
+        encode_message(message.id, message.origin, message.destination, message.priority, message.flags,
+                       message.hops, remaining_ttl_s(message.expiresAtMs, nowMs), message.payload, &body);
+        size_t start = log.size();
+        log.push_back(RECORD_STORE);
+        put_u16(&log, (uint16_t)body.size());
+        log.insert(log.end(), body.begin(), body.end());
+        put_u32(&log, ota_crc32(log.data() + start, log.size() - start));
+        sizes.push_back(log.size() - start);
+    }
+    if (!m_storage->rewrite(log)) {
+        ESP_LOGE(TAG, "Log rewrite of %u bytes failed", (unsigned)log.size());
+        return false;
+    }
+    size_t index = 0;
+    for (auto& entry : m_messages) {
+        entry.second.recordBytes = sizes[index++];
+    }
+    m_logBytes = log.size();
+    m_liveBytes = log.size();
+    m_stats.log_writes++;
+    m_stats.log_bytes_written += log.size();
+    m_stats.log_compactions++;
+    return true;
+}
+
+void MessageOutbox::maybeCompact(uint32_t nowMs) {
+    if (m_logBytes >= m_config.compact_min_bytes && m_logBytes > 2 * m_liveBytes) {
+        compact(nowMs);
+    }
+}
+
+bool MessageOutbox::begin(uint32_t nowMs) {
+    std::vector<uint8_t> log;
+    if (!m_storage->load(&log)) {
+        ESP_LOGE(TAG, "Cannot read the outbox log");
+        return false;
+    }
+    size_t validBytes = 0;
+    bool clean = parseLog(log, nowMs, &validBytes);
+    m_logBytes = validBytes;
+    m_loaded = true;
+    if (!clean) {
+        ESP_LOGW(TAG, "Dropping %u damaged bytes at the end of the outbox log", (unsigned)(log.size() - validBytes));
+    }
+    if (!clean || (m_logBytes >= m_config.compact_min_bytes && m_logBytes > 2 * m_liveBytes)) {
+        compact(nowMs);
+    }
+    while (m_nextId == 0 || m_messages.count(Key(m_nodeId, m_nextId))) {
+        m_nextId++;
+    }
+    ESP_LOGI(TAG, "Outbox loaded: %u messages, %u byte log", (unsigned)m_messages.size(), (unsigned)m_logBytes);
+    return true;
+}
+
+// ============================================================================
+// MESSAGES
+// ============================================================================
+
+size_t MessageOutbox::heldBytes() const {
+    size_t bytes = 0;
+    for (const auto& entry : m_messages) {
+        bytes += entry.second.payload.size();
+    }
+    return bytes;
+}
+
+size_t MessageOutbox::custodyBytes() const {
+    size_t bytes = 0;
+    for (const auto& entry : m_messages) {
+        if (entry.second.origin != m_nodeId) {
+            bytes += entry.second.payload.size();
+        }
+    }
+    return bytes;
+}
+
+// Into the log first, then the index; other nodes' messages get a share only
+bool MessageOutbox::store(Message& message, bool own) {
+    if (m_messages.size() >= m_config.max_messages ||
+        heldBytes() + message.payload.size() > m_config.max_bytes ||
+        (!own && custodyBytes() + message.payload.size() > m_config.max_bytes * m_config.custody_percent / 100)) {
+        return false;
+    }
+    std::vector<uint8_t> body;
+    encode_message(message.id, message.origin, message.destination, message.priority, message.flags,
+                   message.hops, remaining_ttl_s(message.expiresAtMs, message.sentAtMs), message.payload, &body);
+    if (!appendRecord(RECORD_STORE, body)) {
+        return false;
+    }
+    message.recordBytes = RECORD_OVERHEAD + body.size();
+    message.order = m_nextOrder++;
+    message.sentAtMs = 0;
+    m_liveBytes += message.recordBytes;
+
+    Key key(message.origin, message.id);
+    m_byDestination[message.destination].insert(Slot(-(int)message.priority, message.order, key));
+    m_messages[key] = message;
+    return true;
+}
+
+void MessageOutbox::remove(const Key& key, uint32_t nowMs) {
+    auto it = m_messages.find(key);
+    if (it == m_messages.end()) {
+        return;
+    }
+    Message& message = it->second;
+    std::vector<uint8_t> body;
+    put_u32(&body, message.id);
+    put_id(&body, message.origin);
+    // If this fails the message comes back after a restart and is sent
+    // twice; the destination drops the duplicate
+    appendRecord(RECORD_DELETE, body);
+
+    if (!message.inFlightTo.empty()) {
+        auto peer = m_neighbours.find(message.inFlightTo);
+        if (peer != m_neighbours.end() && peer->second.inFlight) {
+            peer->second.inFlight--;
+        }
+    }
+    auto slots = m_byDestination.find(message.destination);
+    if (slots != m_byDestination.end()) {
+        slots->second.erase(Slot(-(int)message.priority, message.order, key));
+        if (slots->second.empty()) {
+            m_byDestination.erase(slots);
+        }
+    }
+    m_liveBytes -= std::min(m_liveBytes, message.recordBytes);
+    m_messages.erase(it);
+    maybeCompact(nowMs);
+}
+
+uint32_t MessageOutbox::send(const std::string& destination, const uint8_t* data, size_t length, uint8_t priority,
+                             uint8_t flags, uint32_t ttlS, uint32_t nowMs) {
+    if (!m_loaded || destination.empty() || destination.size() >= OUTBOX_NODE_ID_LEN || destination == m_nodeId ||
+        !data || length == 0 || length > OUTBOX_MAX_PAYLOAD) {
+        m_stats.rejected++;
+        return 0;
+    }
+    Message message;
+    message.id = m_nextId;
+    message.origin = m_nodeId;
+    message.destination = destination;
+    message.priority = std::min(priority, (uint8_t)OUTBOX_PRIORITY_URGENT);
+    message.flags = flags & (OUTBOX_FLAG_RECEIPT | OUTBOX_FLAG_CUSTODY);
+    message.hops = m_config.max_hops;
+    message.expiresAtMs = nowMs + std::min(ttlS ? ttlS : m_config.default_ttl_s, MAX_TTL_S) * 1000;
+    message.sentAtMs = nowMs;               // Reference time for the stored lifetime
+    message.payload.assign(data, data + length);
+    if (!store(message, true)) {
+        ESP_LOGW(TAG, "Outbox full, message to %s refused", destination.c_str());
+        m_stats.rejected++;
+        return 0;
+    }
+    m_stats.queued++;
+    do {
+        m_nextId++;
+    } while (m_nextId == 0 || m_messages.count(Key(m_nodeId, m_nextId)));
+
+    auto peer = m_neighbours.find(destination);
+    if (peer != m_neighbours.end() && peer->second.up) {
+        sendDue(destination, peer->second, nowMs);
+    }
+    return message.id;
+}
+
+size_t MessageOutbox::pendingFor(const std::string& destination) const {
+    auto it = m_byDestination.find(destination);
+    return it == m_byDestination.end() ? 0 : it->second.size();
+}
+
+// ============================================================================
+// NEIGHBOURS
+// ============================================================================
+
+bool MessageOutbox::isNeighbour(const std::string& peerId) const {
+    auto it = m_neighbours.find(peerId);
+    return it != m_neighbours.end() && it->second.up;
+}
+
+MessageOutbox::Neighbour& MessageOutbox::neighbour(const std::string& peerId, uint32_t nowMs) {
+    auto it = m_neighbours.find(peerId);
+    if (it != m_neighbours.end()) {
+        return it->second;
+    }
+    // Make room: forget the peer heard from least recently, preferably one out of range
+    if (m_neighbours.size() >= OUTBOX_MAX_NEIGHBOURS) {
+        auto oldest = m_neighbours.begin();
+        for (auto n = m_neighbours.begin(); n != m_neighbours.end(); ++n) {
+            if (n->second.up != oldest->second.up ? !n->second.up
+                                                  : (int32_t)(n->second.lastHeardMs - oldest->second.lastHeardMs) < 0) {
+                oldest = n;
+            }
+        }
+        for (auto& entry : m_messages) {
+            if (entry.second.inFlightTo == oldest->first) {
+                entry.second.inFlightTo.clear();
+            }
+        }
+        m_neighbours.erase(oldest);
+    }
+    Neighbour& peer = m_neighbours[peerId];
+    peer.lastHeardMs = nowMs;
+    return peer;
+}
+
+void MessageOutbox::noteHeard(const std::string& peerId, uint32_t nowMs) {
+    if (peerId.empty() || peerId.size() >= OUTBOX_NODE_ID_LEN || peerId == m_nodeId) {
+        return;
+    }
+    Neighbour& peer = neighbour(peerId, nowMs);
+    peer.lastHeardMs = nowMs;
+
+    if (m_metAtMs.size() >= OUTBOX_MAX_ENCOUNTERS && !m_metAtMs.count(peerId)) {
+        auto oldest = m_metAtMs.begin();
+        for (auto it = m_metAtMs.begin(); it != m_metAtMs.end(); ++it) {
+            if ((int32_t)(it->second - oldest->second) < 0) {
+                oldest = it;
+            }
+        }
+        m_metAtMs.erase(oldest);
+    }
+    m_metAtMs[peerId] = nowMs;
+
+    if (!peer.up) {
+        startContact(peerId, peer, nowMs);
+    }
+}
+
+// The peer (re)appeared: everything waiting for it gets fresh attempts
+void MessageOutbox::startContact(const std::string& peerId, Neighbour& peer, uint32_t nowMs) {
+    peer.up = true;
+    peer.contact++;
+    peer.full = false;
+    peer.inFlight = 0;
+    ESP_LOGD(TAG, "%s in range, %u messages waiting for it", peerId.c_str(), (unsigned)pendingFor(peerId));
+    sendSummary(peerId, nowMs);
+    sendDue(peerId, peer, nowMs);
+}
+
+void MessageOutbox::peerUp(const std::string& peerId, uint32_t nowMs) {
+    noteHeard(peerId, nowMs);
+}
+
+void MessageOutbox::peerDown(const std::string& peerId, uint32_t nowMs) {
+    auto it = m_neighbours.find(peerId);
+    if (it == m_neighbours.end() || !it->second.up) {
+        return;
+    }
+    it->second.up = false;
+    it->second.inFlight = 0;
+    for (auto& entry : m_messages) {
+        if (entry.second.inFlightTo == peerId) {
+            entry.second.inFlightTo.clear();
+        }
+    }
+    m_metAtMs[peerId] = nowMs;
+}
+
+bool MessageOutbox::betterCarrier(const Neighbour& peer, const std::string& destination) const {
+    auto theirs = peer.metAtMs.find(destination);
+    if (theirs == peer.metAtMs.end()) {
+        return false;
+    }
+    auto ours = m_metAtMs.find(destination);
+    return ours == m_metAtMs.end() || (int32_t)(theirs->second - ours->second) > (int32_t)m_config.carrier_margin_ms;
+}
+
+bool MessageOutbox::eligible(const Message& message, const std::string& peerId, const Neighbour& peer) const {
+    return message.inFlightTo.empty() &&
+           !(message.triedPeer == peerId && message.triedContact == peer.contact &&
+             message.attempts >= m_config.attempts_per_contact);
+}
+
+// Fill the neighbour's window: its own messages first, then messages it
+// can carry closer to their destination
+void MessageOutbox::sendDue(const std::string& peerId, Neighbour& peer, uint32_t nowMs) {
+    while (peer.up && peer.inFlight < m_config.window) {
+        Message* next = nullptr;
+        auto direct = m_byDestination.find(peerId);
+        if (direct != m_byDestination.end()) {
+            for (const Slot& slot : direct->second) {
+                Message& message = m_messages[std::get<2>(slot)];
+                if (eligible(message, peerId, peer)) {
+                    next = &message;
+                    break;
+                }
+            }
+        }
+        if (!next && !peer.full) {
+            const Slot* best = nullptr;
+            for (const auto& entry : m_byDestination) {
+                if (entry.first == peerId || isNeighbour(entry.first) || !betterCarrier(peer, entry.first)) {
+                    continue;
+                }
+                for (const Slot& slot : entry.second) {
+                    const Message& message = m_messages[std::get<2>(slot)];
+                    if ((message.flags & OUTBOX_FLAG_CUSTODY) && message.hops > 0 &&
+                        eligible(message, peerId, peer)) {
+                        if (!best || slot < *best) {
+                            best = &slot;
+                        }
+                        break;
+                    }
+                }
+            }
+            if (best) {
+                next = &m_messages[std::get<2>(*best)];
+            }
+        }
+        if (!next || !sendData(peerId, peer, *next, nowMs)) {
+            return;
+        }
+    }
+}
+
+bool MessageOutbox::sendFrame(const std::string& peerId, const std::vector<uint8_t>& frame) {
+    if (!m_send(peerId, frame)) {
+        return false;
+    }
+    m_stats.frames_sent++;
+    m_stats.bytes_sent += frame.size();
+    return true;
+}
+
+bool MessageOutbox::sendData(const std::string& peerId, Neighbour& peer, Message& message, uint32_t nowMs) {
+    if (message.triedPeer != peerId || message.triedContact != peer.contact) {
+        message.triedPeer = peerId;
+        message.triedContact = peer.contact;
+        message.attempts = 0;
+    }
+    std::vector<uint8_t> frame = make_frame(FRAME_DATA, MESSAGE_FIXED_SIZE + 2 * OUTBOX_NODE_ID_LEN +
+                                                        message.payload.size());
+    encode_message(message.id, message.origin, message.destination, message.priority, message.flags,
+                   message.hops, remaining_ttl_s(message.expiresAtMs, nowMs), message.payload, &frame);
+    if (!sendFrame(peerId, frame)) {
+        return false;
+    }
+    if (message.attempts++) {
+        m_stats.retransmits++;
+    }
+    message.inFlightTo = peerId;
+    message.sentAtMs = nowMs;
+    peer.inFlight++;
+    m_stats.data_sent++;
+    return true;
+}
+
+void MessageOutbox::sendAck(const std::string& peerId, const Message& message, uint8_t status) {
+    std::vector<uint8_t> frame = make_frame(FRAME_ACK, 6 + message.origin.size());
+    put_u32(&frame, message.id);
+    frame.push_back(status);
+    put_id(&frame, message.origin);
+    sendFrame(peerId, frame);
+}
+
+// Whom this node has met and how long ago, most recent first
+void MessageOutbox::sendSummary(const std::string& peerId, uint32_t nowMs) {
+    std::vector<std::pair<uint32_t, const std::string*>> encounters;
+    for (const auto& entry : m_metAtMs) {
+        if (entry.first != peerId) {
+            uint32_t ageMs = isNeighbour(entry.first) ? 0 : nowMs - entry.second;
+            encounters.push_back(std::make_pair(ageMs, &entry.first));
+        }
+    }
+    std::sort(encounters.begin(), encounters.end());
+    size_t count = std::min(encounters.size(), (size_t)OUTBOX_SUMMARY_ENTRIES);
+
+    std::vector<uint8_t> frame = make_frame(FRAME_SUMMARY, 1 + count * (3 + OUTBOX_NODE_ID_LEN));
+    frame.push_back((uint8_t)count);
+    for (size_t i = 0; i < count; i++) {
+        put_u16(&frame, (uint16_t)std::min(encounters[i].first / 1000, (uint32_t)UINT16_MAX));
+        put_id(&frame, *encounters[i].second);
+    }
+    sendFrame(peerId, frame);
+    m_neighbours[peerId].nextSummaryMs = nowMs + m_config.summary_interval_ms;
+}
+
+// ============================================================================
+// RECEIVING
+// ============================================================================
+
+void MessageOutbox::handleFrame(const std::string& peerId, const uint8_t* data, size_t length, uint32_t nowMs) {
+    if (!m_loaded || !isOutboxFrame(data, length)) {
+        return;
+    }
+    noteHeard(peerId, nowMs);
+    if (!isNeighbour(peerId)) {
+        return;                             // Invalid peer ID
+    }
+    const uint8_t* body = data + FRAME_HEADER_SIZE;
+    size_t bodyLength = length - FRAME_HEADER_SIZE;
+    switch (data[5]) {
+        case FRAME_DATA:
+            handleData(peerId, body, bodyLength, nowMs);
+            break;
+        case FRAME_ACK:
+            handleAck(peerId, body, bodyLength, nowMs);
+            break;
+        case FRAME_SUMMARY:
+            handleSummary(peerId, body, bodyLength, nowMs);
+            break;
+        default:
+            break;
+    }
+}
+
+void MessageOutbox::handleData(const std::string& peerId, const uint8_t* body, size_t length, uint32_t nowMs) {
+    if (length < MESSAGE_FIXED_SIZE) {
+        return;
+    }
+    Message message;
+    const uint8_t* end = body + length;
+    const uint8_t* cursor = body + 11;
+    if (!get_id(&cursor, end, &message.origin) || !get_id(&cursor, end, &message.destination) ||
+        end - cursor < 2 || (size_t)(end - cursor - 2) != get_u16(cursor) ||
+        (size_t)(end - cursor - 2) > OUTBOX_MAX_PAYLOAD) {
+        return;
+    }
+    message.id = get_u32(body);
+    message.priority = std::min(body[4], (uint8_t)OUTBOX_PRIORITY_URGENT);
+    message.flags = body[5];
+    message.hops = body[6];
+    message.expiresAtMs = nowMs + std::min(get_u32(body + 7), MAX_TTL_S) * 1000;
+    message.sentAtMs = nowMs;
+    message.payload.assign(cursor + 2, end);
+    Key key(message.origin, message.id);
+
+    if (message.destination == m_nodeId) {
+        if (std::find(m_recentlyReceived.begin(), m_recentlyReceived.end(), key) != m_recentlyReceived.end()) {
+            m_stats.duplicates++;           // Our ACK was lost
+        } else {
+            m_recentlyReceived.push_back(key);
+            if (m_recentlyReceived.size() > RECENTLY_RECEIVED) {
+                m_recentlyReceived.pop_front();
+            }
+            deliverLocal(message, peerId, nowMs);
+        }
+        sendAck(peerId, message, ACK_DELIVERED);
+        return;
+    }
+
+    // Custody: already ours (our ACK was lost), or take it on if there is room
+    if (m_messages.count(key)) {
+        sendAck(peerId, message, ACK_CUSTODY);
+        return;
+    }
+    if (!(message.flags & OUTBOX_FLAG_CUSTODY) || message.hops == 0) {
+        sendAck(peerId, message, ACK_REFUSED);
+        return;
+    }
+    message.hops--;
+    if (!store(message, false)) {
+        m_stats.custody_refused++;
+        sendAck(peerId, message, ACK_REFUSED);
+        return;
+    }
+    m_stats.custody_accepted++;
+    sendAck(peerId, message, ACK_CUSTODY);
+    ESP_LOGD(TAG, "Carrying %s's message %08x for %s", message.origin.c_str(), (unsigned)message.id,
+             message.destination.c_str());
+}
+
+void MessageOutbox::deliverLocal(const Message& message, const std::string& from, uint32_t nowMs) {
+    if (message.flags & OUTBOX_FLAG_IS_RECEIPT) {
+        if (message.payload.size() >= 4) {
+            m_stats.receipts++;
+            if (m_onReceipt) {
+                m_onReceipt(message.origin, get_u32(message.payload.data()));
+            }
+        }
+        return;
+    }
+    m_stats.received++;
+    if (m_onReceive) {
+        m_onReceive(message.origin, message.payload);
+    }
+
+    // The origin that handed it over directly learns from the ACK
+    if ((message.flags & OUTBOX_FLAG_RECEIPT) && from != message.origin) {
+        Message receipt;
+        receipt.id = m_nextId;
+        receipt.origin = m_nodeId;
+        receipt.destination = message.origin;
+        receipt.priority = message.priority;
+        receipt.flags = OUTBOX_FLAG_IS_RECEIPT | (message.flags & OUTBOX_FLAG_CUSTODY);
+        receipt.hops = m_config.max_hops;
+        receipt.expiresAtMs = nowMs + m_config.default_ttl_s * 1000;
+        receipt.sentAtMs = nowMs;
+        put_u32(&receipt.payload, message.id);
+        if (store(receipt, true)) {
+            do {
+                m_nextId++;
+            } while (m_nextId == 0 || m_messages.count(Key(m_nodeId, m_nextId)));
+        }
+    }
+}
+
+void MessageOutbox::handleAck(const std::string& peerId, const uint8_t* body, size_t length, uint32_t nowMs) {
+    if (length < 6) {
+        return;
+    }
+    std::string origin;
+    const uint8_t* cursor = body + 5;
+    if (!get_id(&cursor, body + length, &origin)) {
+        return;
+    }
+    Key key(origin, get_u32(body));
+    auto it = m_messages.find(key);
+    Neighbour& peer = m_neighbours[peerId];
+    if (it == m_messages.end()) {
+        return;                             // Already settled by an earlier ACK
+    }
+    Message& message = it->second;
+    if (message.inFlightTo == peerId) {
+        message.inFlightTo.clear();
+        if (peer.inFlight) {
+            peer.inFlight--;
+        }
+    }
+
+    uint8_t status = body[4];
+    if (status == ACK_DELIVERED) {
+        m_stats.delivered++;
+        if (message.origin == m_nodeId && (message.flags & OUTBOX_FLAG_RECEIPT) &&
+            !(message.flags & OUTBOX_FLAG_IS_RECEIPT)) {
+            m_stats.receipts++;
+            if (m_onReceipt) {
+                m_onReceipt(message.destination, message.id);
+            }
+        }
+        remove(key, nowMs);
+    } else if (status == ACK_CUSTODY) {
+        m_stats.custody_handed++;
+        ESP_LOGD(TAG, "Message %08x for %s handed to %s", (unsigned)message.id, message.destination.c_str(),
+                 peerId.c_str());
+        remove(key, nowMs);
+    } else {
+        peer.full = true;                   // No more custody offers this contact
+    }
+    sendDue(peerId, peer, nowMs);
+}
+
+void MessageOutbox::handleSummary(const std::string& peerId, const uint8_t* body, size_t length, uint32_t nowMs) {
+    if (length < 1) {
+        return;
+    }
+    Neighbour& peer = m_neighbours[peerId];
+    peer.metAtMs.clear();
+    const uint8_t* cursor = body + 1;
+    const uint8_t* end = body + length;
+    for (size_t i = 0; i < body[0] && i < OUTBOX_SUMMARY_ENTRIES && end - cursor >= 2; i++) {
+        uint32_t ageMs = get_u16(cursor) * 1000u;
+        cursor += 2;
+        std::string id;
+        if (!get_id(&cursor, end, &id)) {
+            break;
+        }
+        if (id != m_nodeId) {
+            peer.metAtMs[id] = nowMs - ageMs;
+        }
+    }
+    sendDue(peerId, peer, nowMs);
+}
+
+// ============================================================================
+// TIMERS
+// ============================================================================
+
+void MessageOutbox::tick(uint32_t nowMs) {
+    if (!m_loaded) {
+        return;
+    }
+    std::vector<Key> expired;
+    for (auto& entry : m_messages) {
+        Message& message = entry.second;
+        if (is_due(nowMs, message.expiresAtMs)) {
+            expired.push_back(entry.first);
+        } else if (!message.inFlightTo.empty() && is_due(nowMs, message.sentAtMs + m_config.ack_timeout_ms)) {
+            auto peer = m_neighbours.find(message.inFlightTo);
+            if (peer != m_neighbours.end() && peer->second.inFlight) {
+                peer->second.inFlight--;
+            }
+            message.inFlightTo.clear();
+        }
+    }
+    for (const Key& key : expired) {
+        ESP_LOGW(TAG, "Message %08x from %s to %s expired", (unsigned)key.second, key.first.c_str(),
+                 m_messages[key].destination.c_str());
+        m_stats.expired++;
+        remove(key, nowMs);
+    }
+
+    for (auto& entry : m_neighbours) {
+        Neighbour& peer = entry.second;
+        if (peer.up && is_due(nowMs, peer.lastHeardMs + m_config.neighbour_timeout_ms)) {
+            peerDown(entry.first, nowMs);
+        }
+        if (!peer.up) {
+            continue;
+        }
+        if (is_due(nowMs, peer.nextSummaryMs)) {
+            sendSummary(entry.first, nowMs);
+        }
+        sendDue(entry.first, peer, nowMs);
+    }
+}
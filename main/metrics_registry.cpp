@@ -0,0 +1,376 @@
+/**
+ * @file metrics_registry.cpp
+ * @brief Unified metrics registry implementation
+ *
+ * Builds for ESP-IDF and for the host (aircom_bench); on the host
+ * there is a single "core".
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/metrics_registry.h"
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#define METRICS_CORES portNUM_PROCESSORS
+#define METRICS_CORE_ID() ((int)xPortGetCoreID())
+#else
+#include <chrono>
+#define METRICS_CORES 1
+#define METRICS_CORE_ID() 0
+#endif
+
+#define METRICS_CACHE_LINE 64
+
+static const char* METRICS_TAG = "METRICS";
+
+static_assert(METRICS_HISTOGRAM_BUCKETS ==
+              ((24 - METRICS_HISTOGRAM_SUB_BITS) + 1) << METRICS_HISTOGRAM_SUB_BITS,
+              "Bucket count must cover values up to METRICS_HISTOGRAM_MAX_VALUE");
+
+// ============================================================================
+// STORAGE
+// ============================================================================
+
+// One block of counters per core, on separate cache lines so the cores never
+// write to the same line
+struct alignas(METRICS_CACHE_LINE) CoreCounters {
+    std::atomic<uint32_t> value[METRIC_COUNTER_COUNT];
+};
+
+struct Histogram {
+    std::atomic<uint32_t> buckets[METRICS_HISTOGRAM_BUCKETS];
+    std::atomic<uint32_t> max;
+};
+
+static CoreCounters s_counters[METRICS_CORES];
+static std::atomic<int32_t> s_gauges[METRIC_GAUGE_COUNT];
+static Histogram s_histograms[METRIC_HISTOGRAM_COUNT];
+
+#define METRICS_NAME_ENTRY(id, name) name,
+
+static const char* const s_counter_names[] = { METRICS_COUNTERS(METRICS_NAME_ENTRY) };
+static const char* const s_gauge_names[] = { METRICS_GAUGES(METRICS_NAME_ENTRY) };
+static const char* const s_histogram_names[] = { METRICS_HISTOGRAMS(METRICS_NAME_ENTRY) };
+
+#undef METRICS_NAME_ENTRY
+
+// ============================================================================
+// HISTOGRAM BUCKETS
+// ============================================================================
+
+#define SUB_BUCKETS (1u << METRICS_HISTOGRAM_SUB_BITS)
+
+static inline uint32_t bucket_index(uint32_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    if (value > METRICS_HISTOGRAM_MAX_VALUE) {
+        value = METRICS_HISTOGRAM_MAX_VALUE;
+    }
+    uint32_t exponent = 31 - __builtin_clz(value);
+    uint32_t shift = exponent - METRICS_HISTOGRAM_SUB_BITS;
+    uint32_t sub = (value >> shift) & (SUB_BUCKETS - 1);
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+static inline uint32_t bucket_lower(uint32_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    uint32_t shift = index / SUB_BUCKETS - 1;
+    return (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+static inline uint32_t bucket_width(uint32_t index) {
+    return index < SUB_BUCKETS ? 1 : 1u << (index / SUB_BUCKETS - 1);
+}
+
+// ============================================================================
+// UPDATE API
+// ============================================================================
+
+void metrics_counter_add(metric_counter_t id, uint32_t delta) {
+    s_counters[METRICS_CORE_ID()].value[id].fetch_add(delta, std::memory_order_relaxed);
+}
+
+void metrics_counter_inc(metric_counter_t id) {
+    s_counters[METRICS_CORE_ID()].value[id].fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics_gauge_set(metric_gauge_t id, int32_t value) {
+    s_gauges[id].store(value, std::memory_order_relaxed);
+}
+
+void metrics_gauge_add(metric_gauge_t id, int32_t delta) {
+    s_gauges[id].fetch_add(delta, std::memory_order_relaxed);
+}
+
+void metrics_gauge_max(metric_gauge_t id, int32_t value) {
+    int32_t current = s_gauges[id].load(std::memory_order_relaxed);
+    while (value > current &&
+           !s_gauges[id].compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void metrics_histogram_record(metric_histogram_t id, uint32_t value) {
+    Histogram& histogram = s_histograms[id];
+    histogram.buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t current = histogram.max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !histogram.max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// ============================================================================
+// READ API
+// ============================================================================
+
+uint32_t metrics_counter_get(metric_counter_t id) {
+    uint32_t total = 0;
+    for (int core = 0; core < METRICS_CORES; core++) {
+        total += s_counters[core].value[id].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int32_t metrics_gauge_get(metric_gauge_t id) {
+    return s_gauges[id].load(std::memory_order_relaxed);
+}
+
+void metrics_histogram_get(metric_histogram_t id, metrics_histogram_summary_t* summary) {
+    if (!summary) {
+        return;
+    }
+    memset(summary, 0, sizeof(*summary));
+
+    const Histogram& histogram = s_histograms[id];
+    uint32_t counts[METRICS_HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+    uint64_t weighted = 0;
+    for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        counts[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+        weighted += (uint64_t)counts[i] * (bucket_lower(i) + bucket_width(i) / 2);
+    }
+    if (total == 0) {
+        return;
+    }
+
+    uint32_t max = histogram.max.load(std::memory_order_relaxed);
+    summary->count = (uint32_t)total;
+    summary->max = max;
+    summary->mean = (uint32_t)(weighted / total);
+
+    // Percentiles report the bucket midpoint, never above the exact maximum
+    const uint64_t p50_rank = (total * 50 + 99) / 100;
+    const uint64_t p90_rank = (total * 90 + 99) / 100;
+    const uint64_t p99_rank = (total * 99 + 99) / 100;
+    uint64_t seen = 0;
+    bool have_min = false;
+    for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        if (!have_min) {
+            summary->min = bucket_lower(i);
+            have_min = true;
+        }
+        uint64_t before = seen;
+        seen += counts[i];
+        uint32_t midpoint = bucket_lower(i) + bucket_width(i) / 2;
+        if (midpoint > max) {
+            midpoint = max;
+        }
+        if (before < p50_rank && seen >= p50_rank) summary->p50 = midpoint;
+        if (before < p90_rank && seen >= p90_rank) summary->p90 = midpoint;
+        if (before < p99_rank && seen >= p99_rank) summary->p99 = midpoint;
+    }
+}
+
+void metrics_counter_reset(metric_counter_t id) {
+    for (int core = 0; core < METRICS_CORES; core++) {
+        s_counters[core].value[id].store(0, std::memory_order_relaxed);
+    }
+}
+
+void metrics_gauge_reset(metric_gauge_t id) {
+    s_gauges[id].store(0, std::memory_order_relaxed);
+}
+
+void metrics_histogram_reset(metric_histogram_t id) {
+    Histogram& histogram = s_histograms[id];
+    for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        histogram.buckets[i].store(0, std::memory_order_relaxed);
+    }
+    histogram.max.store(0, std::memory_order_relaxed);
+}
+
+const char* metrics_counter_name(metric_counter_t id) {
+    return id < METRIC_COUNTER_COUNT ? s_counter_names[id] : "?";
+}
+
+const char* metrics_gauge_name(metric_gauge_t id) {
+    return id < METRIC_GAUGE_COUNT ? s_gauge_names[id] : "?";
+}
+
+const char* metrics_histogram_name(metric_histogram_t id) {
+    return id < METRIC_HISTOGRAM_COUNT ? s_histogram_names[id] : "?";
+}
+
+// ============================================================================
+// EXPORT
+// ============================================================================
+
+static uint32_t now_ms(void) {
+#ifdef ESP_PLATFORM
+    return (uint32_t)(esp_timer_get_time() / 1000);
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void metrics_snapshot(metrics_snapshot_t* snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    snapshot->timestamp_ms = now_ms();
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        snapshot->counters[i] = metrics_counter_get((metric_counter_t)i);
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        snapshot->gauges[i] = metrics_gauge_get((metric_gauge_t)i);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        metrics_histogram_get((metric_histogram_t)i, &snapshot->histograms[i]);
+    }
+}
+
+static size_t put_u32(uint8_t* buffer, size_t offset, uint32_t value) {
+    buffer[offset] = (uint8_t)value;
+    buffer[offset + 1] = (uint8_t)(value >> 8);
+    buffer[offset + 2] = (uint8_t)(value >> 16);
+    buffer[offset + 3] = (uint8_t)(value >> 24);
+    return offset + 4;
+}
+
+size_t metrics_encode(const metrics_snapshot_t* snapshot, uint8_t* buffer, size_t buffer_size) {
+    if (!snapshot || !buffer || buffer_size < METRICS_MAX_ENCODED_SIZE) {
+        return 0;
+    }
+
+    size_t offset = 0;
+    buffer[offset++] = 'M';
+    buffer[offset++] = 'X';
+    buffer[offset++] = METRICS_FORMAT_VERSION;
+    offset = put_u32(buffer, offset, snapshot->timestamp_ms);
+    buffer[offset++] = METRIC_COUNTER_COUNT;
+    buffer[offset++] = METRIC_GAUGE_COUNT;
+    buffer[offset++] = METRIC_HISTOGRAM_COUNT;
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        offset = put_u32(buffer, offset, snapshot->counters[i]);
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        offset = put_u32(buffer, offset, (uint32_t)snapshot->gauges[i]);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const metrics_histogram_summary_t& h = snapshot->histograms[i];
+        offset = put_u32(buffer, offset, h.count);
+        offset = put_u32(buffer, offset, h.min);
+        offset = put_u32(buffer, offset, h.max);
+        offset = put_u32(buffer, offset, h.mean);
+        offset = put_u32(buffer, offset, h.p50);
+        offset = put_u32(buffer, offset, h.p90);
+        offset = put_u32(buffer, offset, h.p99);
+    }
+
+    return offset;
+}
+
+// Append one line; false (and nothing written) if it does not fit
+static bool append_line(char* buffer, size_t buffer_size, size_t* length, const char* format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static bool append_line(char* buffer, size_t buffer_size, size_t* length, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *length, buffer_size - *length, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= buffer_size - *length) {
+        buffer[*length] = '\0';
+        return false;
+    }
+    *length += (size_t)written;
+    return true;
+}
+
+size_t metrics_format_text(const metrics_snapshot_t* snapshot, char* buffer, size_t buffer_size) {
+    if (!snapshot || !buffer || buffer_size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+
+    size_t length = 0;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        if (!append_line(buffer, buffer_size, &length, "%s %u\n",
+                         s_counter_names[i], (unsigned)snapshot->counters[i])) {
+            return length;
+        }
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        if (!append_line(buffer, buffer_size, &length, "%s %d\n",
+                         s_gauge_names[i], (int)snapshot->gauges[i])) {
+            return length;
+        }
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const metrics_histogram_summary_t& h = snapshot->histograms[i];
+        if (!append_line(buffer, buffer_size, &length, "%s count=%u mean=%u p50=%u p90=%u p99=%u max=%u\n",
+                         s_histogram_names[i], (unsigned)h.count, (unsigned)h.mean, (unsigned)h.p50,
+                         (unsigned)h.p90, (unsigned)h.p99, (unsigned)h.max)) {
+            return length;
+        }
+    }
+    return length;
+}
+
+void metrics_log(void) {
+    static metrics_snapshot_t snapshot;
+    metrics_snapshot(&snapshot);
+
+#ifdef ESP_PLATFORM
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        if (snapshot.counters[i]) {
+            ESP_LOGI(METRICS_TAG, "%s %u", s_counter_names[i], (unsigned)snapshot.counters[i]);
+        }
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        if (snapshot.gauges[i]) {
+            ESP_LOGI(METRICS_TAG, "%s %d", s_gauge_names[i], (int)snapshot.gauges[i]);
+        }
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const metrics_histogram_summary_t& h = snapshot.histograms[i];
+        if (h.count) {
+            ESP_LOGI(METRICS_TAG, "%s count=%u mean=%u p50=%u p90=%u p99=%u max=%u",
+                     s_histogram_names[i], (unsigned)h.count, (unsigned)h.mean, (unsigned)h.p50,
+                     (unsigned)h.p90, (unsigned)h.p99, (unsigned)h.max);
+        }
+    }
+#else
+    static char text[4096];
+    metrics_format_text(&snapshot, text, sizeof(text));
+    printf("[%s]\n%s", METRICS_TAG, text);
+#endif
+}
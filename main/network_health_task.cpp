@@ -2,6 +2,8 @@
 #include "include/config.h"
 #include "include/network_utils.h"
 #include "include/error_handling.h"
+#include "include/link_adaptation.h"
+#include "include/boot_sequence.h"
 #include "HaLowMeshManager.h"
 #include "AirCom.pb-c.h"
 #include "esp_log.h"
@@ -10,18 +12,43 @@
 static const char* TAG = "NET_HEALTH_TASK";
 
 #define HEALTH_BROADCAST_INTERVAL_MS 30000 // Broadcast every 30 seconds
+#define LINK_ADAPTATION_TICK_MS 1000       // Re-evaluate link rates every second
 
 void network_health_task(void *pvParameters) {
     ESP_LOGI(TAG, "Network Health Task started");
 
-    // Allow time for the main network task to initialize the mesh
-    vTaskDelay(pdMS_TO_TICKS(10000));
+    // Start as soon as the radio stage has ended; if it failed,
+    // checkRadioHealth() below tries the other backends
+    boot_wait(BOOT_BIT(BOOT_STAGE_RADIO), BOOT_WAIT_FOREVER);
+
+    LinkAdaptation& linkAdaptation = LinkAdaptation::getInstance();
+    linkAdaptation.configure(LinkAdaptation::defaultConfig());
+    HaLowMeshManager& meshManager = HaLowMeshManager::getInstance();
+
+    TickType_t lastBroadcast = xTaskGetTickCount() - pdMS_TO_TICKS(HEALTH_BROADCAST_INTERVAL_MS);
 
     for (;;) {
-        HaLowMeshManager& meshManager = HaLowMeshManager::getInstance();
+        vTaskDelay(pdMS_TO_TICKS(LINK_ADAPTATION_TICK_MS));
+
+        // Replace a failed radio before adapting rates on it
+        meshManager.checkRadioHealth();
+
+        // Close the loop on link quality every tick; the broadcast is much rarer
+        linkAdaptation.tick();
+
+        if (xTaskGetTickCount() - lastBroadcast < pdMS_TO_TICKS(HEALTH_BROADCAST_INTERVAL_MS)) {
+            continue;
+        }
+        lastBroadcast = xTaskGetTickCount();
+
+        HaLowFailoverStats failover = meshManager.getFailoverStats();
+        ESP_LOGI(TAG, "Radio %s: %u failovers, reconnect last %u ms / max %u ms / avg %u ms, %u cached",
+                 failover.activeBackend.c_str(), (unsigned)failover.failovers,
+                 (unsigned)failover.lastReconnectMs, (unsigned)failover.maxReconnectMs,
+                 (unsigned)failover.avgReconnectMs, (unsigned)failover.cachedMessages);
+
         if (!meshManager.get_connection_status()) {
             ESP_LOGW(TAG, "HaLow mesh is not connected. Skipping health broadcast.");
-            vTaskDelay(pdMS_TO_TICKS(HEALTH_BROADCAST_INTERVAL_MS));
             continue;
         }
 
@@ -39,10 +66,13 @@ void network_health_task(void *pvParameters) {
         sprintf(uid, "ESP32-%02x%02x%02x", mac[3], mac[4], mac[5]);
         packet.from_node = uid;
 
-        // In a real implementation, we would iterate through connected peers
-        // and get the specific RSSI for each link. For this skeleton, we'll
-        // just broadcast a placeholder value.
-        health_info.rssi = meshManager.get_rssi(); // Assuming a general RSSI for now
+        // Averages over all links tracked by the link adaptation controller
+        int32_t rssi = 0;
+        uint32_t loss_percent = 0;
+        linkAdaptation.getAggregate(&rssi, &loss_percent);
+        health_info.rssi = rssi;
+        health_info.packet_loss = loss_percent;
+        linkAdaptation.logLinks();
 
         // 2. Serialize the packet to a byte buffer.
         size_t packed_size = air_com_packet__get_packed_size(&packet);
@@ -50,21 +80,18 @@ void network_health_task(void *pvParameters) {
         if (buffer == NULL) {
             ESP_LOGE(TAG, "Failed to allocate buffer for health packet");
             log_message(LOG_LEVEL_ERROR, "Failed to allocate buffer for health packet");
-            vTaskDelay(pdMS_TO_TICKS(HEALTH_BROADCAST_INTERVAL_MS));
             continue;
         }
         air_com_packet__pack(&packet, buffer);
 
         // 3. Broadcast the serialized packet using network utilities.
         // We use the same discovery port for simplicity.
-        ESP_LOGI(TAG, "Broadcasting network health packet (RSSI: %d)", health_info.rssi);
+        ESP_LOGI(TAG, "Broadcasting network health packet (RSSI: %d, loss: %u%%)",
+                 health_info.rssi, (unsigned)health_info.packet_loss);
         if (!broadcast_udp_packet(buffer, packed_size, MESH_DISCOVERY_PORT)) {
             ESP_LOGE(TAG, "Failed to broadcast health packet");
             log_message(LOG_LEVEL_ERROR, "Failed to broadcast health packet");
         }
         free(buffer);
-
-        // 4. Wait for the next interval.
-        vTaskDelay(pdMS_TO_TICKS(HEALTH_BROADCAST_INTERVAL_MS));
     }
 }
@@ -20,11 +20,18 @@
 #include "include/network_utils.h"
 #include "include/error_handling.h"
 #include "include/crypto.h"
+#include "include/outbox_service.h"
+#include "include/talkgroup.h"
+#include "include/power_service.h"
+#include "include/battery_service.h"
+#include "include/boot_sequence.h"
 #include "HaLowManager/include/HaLowMeshManager.h"
 #include "logging_system.h"
 #include "lwip/sockets.h"
 #include "esp_efuse.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
+#include <map>
 
 
 // Define mutex timeout constants locally (should be in shared_data.h)
@@ -34,6 +41,48 @@
 
 static const char* NETWORK_TASK_TAG = "NETWORK_TASK";
 
+// Battery state from each peer's last beacon, by source address
+struct PeerBattery {
+    uint32_t level;
+    uint32_t minutes;
+};
+static std::map<std::string, PeerBattery> s_peerBattery;
+
+/**
+ * @brief Decrypt an encrypted AirComPacket and queue a text message for the UI
+ */
+static void handle_encrypted_text(const std::vector<uint8_t>& received_data) {
+    std::string decrypted_payload = decrypt_message(received_data);
+    if (decrypted_payload.empty()) {
+        LOG_NETWORK_ERROR(ERROR_CRYPTO_DECRYPT, "Failed to decrypt message or empty payload");
+        return;
+    }
+    AirComPacket *packet = air_com_packet__unpack(NULL, decrypted_payload.size(), (const uint8_t*)decrypted_payload.c_str());
+    if (!packet) {
+        LOG_NETWORK_ERROR(ERROR_INVALID_PARAMETER, "Failed to unpack protobuf packet");
+        return;
+    }
+    if (packet->payload_variant_case == AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE) {
+        ESP_LOGI(NETWORK_TASK_TAG, "Received Text Message: '%s'", packet->text_message->text);
+        incoming_message_t received_msg;
+        received_msg.sender_callsign = packet->from_node;
+        received_msg.message_text = packet->text_message->text;
+        xQueueSend(incoming_message_queue, &received_msg, (TickType_t)0);
+        power_service_pulse(POWER_ACTIVITY_DATA);
+    }
+    air_com_packet__free_unpacked(packet, NULL);
+}
+
+// Text messages that arrive through the store-and-forward outbox
+static void on_outbox_message(const char* origin, const uint8_t* data, size_t length) {
+    ESP_LOGI(NETWORK_TASK_TAG, "Outbox message of %d bytes from %s", (int)length, origin);
+    handle_encrypted_text(std::vector<uint8_t>(data, data + length));
+}
+
+static void on_outbox_receipt(const char* destination, uint32_t message_id) {
+    ESP_LOGI(NETWORK_TASK_TAG, "Message %08x delivered to %s", (unsigned)message_id, destination);
+}
+
 // ============================================================================
 // NETWORK TASK IMPLEMENTATION
 // ============================================================================
@@ -54,43 +103,62 @@ void networkTask(void *pvParameters) {
         return;
     }
 
-    // Initialize the HaLow Mesh Manager
+    // The radio comes up in its boot stage, alongside the other services
     HaLowMeshManager& meshManager = HaLowMeshManager::getInstance();
-    meshManager.begin();
+    if (!boot_wait(BOOT_BIT(BOOT_STAGE_RADIO), BOOT_WAIT_FOREVER)) {
+        ESP_LOGE(NETWORK_TASK_TAG, "No radio at boot; the health task will retry the backends");
+    }
+    outbox_service_set_handlers(on_outbox_message, on_outbox_receipt);
 
     // Main task loop
+    int64_t last_beacon_us = 0;
     for (;;) {
-        ESP_LOGI(NETWORK_TASK_TAG, "Broadcasting discovery packet...");
-
-        // 1. Create a NodeInfo packet to broadcast our presence.
-        AirComPacket packet = AIR_COM_PACKET__INIT;
-        NodeInfo node_info = NODE_INFO__INIT;
-
-        packet.payload_variant_case = AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO;
-        packet.node_info = &node_info;
-
-        node_info.callsign = (char*)CALLSIGN;
-        uint8_t mac[6];
-        esp_read_mac(mac, ESP_MAC_WIFI_STA);
-        char uid[32];
-        sprintf(uid, "ESP32-%02x%02x%02x", mac[3], mac[4], mac[5]);
-        node_info.node_id = uid;
-
-        // 2. Serialize the packet to a byte buffer.
-        size_t packed_size = air_com_packet__get_packed_size(&packet);
-        uint8_t *buffer = (uint8_t *)malloc(packed_size);
-        if (buffer == NULL) {
-            LOG_NETWORK_ERROR(ERROR_MEMORY_ALLOCATION, "Failed to allocate buffer for protobuf packet");
-            vTaskDelay(pdMS_TO_TICKS(1000)); // Wait before retry
-            continue;
-        }
-        air_com_packet__pack(&packet, buffer);
+        // The beacon slows down as the battery runs low
+        int64_t now_us = esp_timer_get_time();
+        uint32_t beacon_ms = battery_service_policy().beacon_ms;
+        bool beacon_due = last_beacon_us == 0 || now_us - last_beacon_us >= (int64_t)beacon_ms * 1000;
+        if (beacon_due) {
+            ESP_LOGI(NETWORK_TASK_TAG, "Broadcasting discovery packet...");
+            last_beacon_us = now_us;
+
+            // 1. Create a NodeInfo packet to broadcast our presence.
+            AirComPacket packet = AIR_COM_PACKET__INIT;
+            NodeInfo node_info = NODE_INFO__INIT;
+
+            packet.payload_variant_case = AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO;
+            packet.node_info = &node_info;
+
+            node_info.callsign = (char*)CALLSIGN;
+            uint8_t mac[6];
+            esp_read_mac(mac, ESP_MAC_WIFI_STA);
+            char uid[32];
+            sprintf(uid, "ESP32-%02x%02x%02x", mac[3], mac[4], mac[5]);
+            node_info.node_id = uid;
+
+            // Charge and runtime for team leads; 0 is "unknown", so a flat
+            // battery reports 1%
+            battery_status_t battery;
+            if (battery_service_get_status(&battery)) {
+                node_info.battery_level = battery.percent < 1.0f ? 1 : (uint32_t)(battery.percent + 0.5f);
+                node_info.battery_minutes = battery.minutes;
+            }
 
-        // 3. Broadcast the serialized packet using network utilities
-        if (!broadcast_udp_packet(buffer, packed_size, MESH_DISCOVERY_PORT)) {
-            LOG_NETWORK_ERROR(ERROR_SOCKET_SEND, "Failed to broadcast discovery packet");
+            // 2. Serialize the packet to a byte buffer.
+            size_t packed_size = air_com_packet__get_packed_size(&packet);
+            uint8_t *buffer = (uint8_t *)malloc(packed_size);
+            if (buffer == NULL) {
+                LOG_NETWORK_ERROR(ERROR_MEMORY_ALLOCATION, "Failed to allocate buffer for protobuf packet");
+                vTaskDelay(pdMS_TO_TICKS(1000)); // Wait before retry
+                continue;
+            }
+            air_com_packet__pack(&packet, buffer);
+
+            // 3. Broadcast the serialized packet using network utilities
+            if (!broadcast_udp_packet(buffer, packed_size, MESH_DISCOVERY_PORT)) {
+                LOG_NETWORK_ERROR(ERROR_SOCKET_SEND, "Failed to broadcast discovery packet");
+            }
+            free(buffer);
         }
-        free(buffer);
 
         // 4. Listen for incoming UDP packets (for discovery and health)
         uint8_t rx_buffer[512];
@@ -100,9 +168,16 @@ void networkTask(void *pvParameters) {
             AirComPacket *received_packet = air_com_packet__unpack(NULL, len, rx_buffer);
             if (received_packet) {
                 if (received_packet->payload_variant_case == AIR_COM_PACKET__PAYLOAD_VARIANT_NODE_INFO) {
-                    // This is a discovery packet from another node.
-                    // In a real implementation, we would add this to our peer list.
-                    ESP_LOGI(NETWORK_TASK_TAG, "Received NodeInfo from %s (Callsign: %s)", received_packet->from_node, received_packet->node_info->callsign);
+                    // This is a discovery packet from another node; its
+                    // battery state goes into the contact list below.
+                    const NodeInfo* info = received_packet->node_info;
+                    ESP_LOGI(NETWORK_TASK_TAG, "Received NodeInfo from %s (Callsign: %s, battery %u%%)",
+                             received_packet->from_node, info->callsign, (unsigned)info->battery_level);
+                    if (info->battery_level) {
+                        s_peerBattery[source_ip] = { info->battery_level, info->battery_minutes };
+                    } else {
+                        s_peerBattery.erase(source_ip);
+                    }
                 } else if (received_packet->payload_variant_case == AIR_COM_PACKET__PAYLOAD_VARIANT_NETWORK_HEALTH) {
                     // This is a health packet.
                     ESP_LOGI(NETWORK_TASK_TAG, "Received NetworkHealth from %s (RSSI: %d)", received_packet->from_node, received_packet->network_health->rssi);
@@ -124,6 +199,11 @@ void networkTask(void *pvParameters) {
                 MeshNodeInfo newNode;
                 newNode.callsign = "CONTACT-" + std::to_string(g_contact_list.size() + 1);
                 newNode.ipAddress = node.ipAddress;
+                auto battery = s_peerBattery.find(node.ipAddress);
+                if (battery != s_peerBattery.end()) {
+                    newNode.battery_level = (int)battery->second.level;
+                    newNode.battery_minutes = battery->second.minutes;
+                }
                 g_contact_list.push_back(newNode);
             }
             xSemaphoreGive(g_contact_list_mutex);
@@ -140,13 +220,20 @@ void networkTask(void *pvParameters) {
         if (xQueueReceive(outgoing_message_queue, &out_msg, (TickType_t)0) == pdPASS) {
             ESP_LOGI(NETWORK_TASK_TAG, "Dequeued a message to send to %s", out_msg.target_ip);
 
-            // Use network utilities to send TCP message
-            if (!send_tcp_message_default(out_msg.target_ip, out_msg.encrypted_payload)) {
-                LOG_NETWORK_ERROR(ERROR_SOCKET_SEND, "Failed to send TCP message to %s", out_msg.target_ip);
+            // Stored and sent whenever the target, or a node that can carry
+            // the message to it, is in range
+            if (!outbox_service_send(out_msg.target_ip, out_msg.encrypted_payload.data(),
+                                     out_msg.encrypted_payload.size(), OUTBOX_PRIORITY_NORMAL,
+                                     OUTBOX_FLAG_RECEIPT | OUTBOX_FLAG_CUSTODY)) {
+                LOG_NETWORK_ERROR(ERROR_SOCKET_SEND, "Outbox refused message to %s", out_msg.target_ip);
             }
         }
 
-        vTaskDelay(pdMS_TO_TICKS(100)); // Shorten delay to be more responsive to outgoing messages
+        // Talkgroup membership announcements and peer expiry
+        talkgroup_tick();
+
+        // 100 ms while someone may be sending; longer when the node is idle
+        vTaskDelay(pdMS_TO_TICKS(power_service_poll_ms(POWER_WAKE_NETWORK, 100)));
     }
 }
 
@@ -165,6 +252,9 @@ void tcp_server_task(void *pvParameters) {
         return;
     }
 
+    // Sockets need the network interface the radio stage brings up
+    boot_wait(BOOT_BIT(BOOT_STAGE_RADIO), BOOT_WAIT_FOREVER);
+
     char rx_buffer[1024];
     char addr_str[128];
     int addr_family = AF_INET;
@@ -231,25 +321,7 @@ void tcp_server_task(void *pvParameters) {
         } else {
             ESP_LOGI(NETWORK_TASK_TAG, "Received %d bytes", received_data.size());
 
-            // Decrypt and unpack the message
-            std::string decrypted_payload = decrypt_message(received_data);
-            if (!decrypted_payload.empty()) {
-                AirComPacket *packet = air_com_packet__unpack(NULL, decrypted_payload.size(), (const uint8_t*)decrypted_payload.c_str());
-                if (packet) {
-                    if (packet->payload_variant_case == AIR_COM_PACKET__PAYLOAD_VARIANT_TEXT_MESSAGE) {
-                        ESP_LOGI(NETWORK_TASK_TAG, "Received Text Message: '%s'", packet->text_message->text);
-                        incoming_message_t received_msg;
-                        received_msg.sender_callsign = packet->from_node;
-                        received_msg.message_text = packet->text_message->text;
-                        xQueueSend(incoming_message_queue, &received_msg, (TickType_t)0);
-                    }
-                    air_com_packet__free_unpacked(packet, NULL);
-                } else {
-                    LOG_NETWORK_ERROR(ERROR_INVALID_PARAMETER, "Failed to unpack protobuf packet");
-                }
-            } else {
-                LOG_NETWORK_ERROR(ERROR_CRYPTO_DECRYPT, "Failed to decrypt message or empty payload");
-            }
+            handle_encrypted_text(received_data);
         }
 
         // Ensure socket is always closed
@@ -13,6 +13,7 @@
 
 #include "include/network_utils.h"
 #include "include/error_handling.h"
+#include "include/metrics_registry.h"
 
 // ESP-IDF includes
 #include "esp_system.h"
@@ -29,13 +30,12 @@
 #include <netdb.h>
 #include <ifaddrs.h>
 #include <net/if.h>
+#include <sys/ioctl.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
 #include <sys/time.h>
 
-// Global network statistics
-static network_stats_t g_network_stats = {0};
 static network_status_t g_network_status = NETWORK_STATUS_DISCONNECTED;
 static bool g_debug_enabled = false;
 
@@ -49,12 +49,9 @@ static bool is_valid_ip_format(const char* ip);
  */
 bool network_utils_init(void) {
     // Reset statistics
-    memset(&g_network_stats, 0, sizeof(network_stats_t));
+    network_reset_stats();
     g_network_status = NETWORK_STATUS_DISCONNECTED;
 
-    // Mark initialization time
-    g_network_stats.last_activity_timestamp = (uint32_t)time(NULL);
-
     LOG_NETWORK_INFO("Network utilities initialized successfully");
     return true;
 }
@@ -78,13 +75,13 @@ void network_utils_deinit(void) {
 bool send_tcp_message(const char* host_ip, const std::vector<uint8_t>& payload, int max_retries) {
     if (!host_ip || payload.empty() || max_retries < 0) {
         LOG_NETWORK_ERROR(ERROR_INVALID_PARAMETER, "Invalid parameters for send_tcp_message");
-        g_network_stats.network_errors++;
+        metrics_counter_inc(METRIC_NET_ERRORS);
         return false;
     }
 
     if (!is_valid_ip_format(host_ip)) {
         LOG_NETWORK_ERROR(ERROR_INVALID_ADDRESS, "Invalid IP address format: %s", host_ip);
-        g_network_stats.network_errors++;
+        metrics_counter_inc(METRIC_NET_ERRORS);
         return false;
     }
 
@@ -95,7 +92,7 @@ bool send_tcp_message(const char* host_ip, const std::vector<uint8_t>& payload,
 
     if (inet_pton(AF_INET, host_ip, &server_addr.sin_addr) <= 0) {
         LOG_NETWORK_ERROR(ERROR_INVALID_ADDRESS, "Invalid IP address: %s", host_ip);
-        g_network_stats.network_errors++;
+        metrics_counter_inc(METRIC_NET_ERRORS);
         return false;
     }
 
@@ -103,13 +100,13 @@ bool send_tcp_message(const char* host_ip, const std::vector<uint8_t>& payload,
     int attempt = 0;
 
     while (attempt <= max_retries && !success) {
-        g_network_stats.total_messages_sent++;
-        g_network_stats.connection_attempts++;
+        metrics_counter_inc(METRIC_NET_MESSAGES_SENT);
+        metrics_counter_inc(METRIC_NET_CONNECTION_ATTEMPTS);
 
         int sock = create_tcp_socket();
         if (sock < 0) {
             LOG_NETWORK_ERROR(ERROR_SOCKET_CREATE, "Failed to create TCP socket (attempt %d)", attempt + 1);
-            g_network_stats.network_errors++;
+            metrics_counter_inc(METRIC_NET_ERRORS);
             attempt++;
             if (attempt <= max_retries) {
                 sleep(NETWORK_RETRY_DELAY_MS / 1000);
@@ -127,8 +124,8 @@ bool send_tcp_message(const char* host_ip, const std::vector<uint8_t>& payload,
         if (connect_result < 0) {
             LOG_NETWORK_ERROR(ERROR_SOCKET_CONNECT, "Connection failed (attempt %d): %s", attempt + 1, strerror(errno));
             close(sock);
-            g_network_stats.failed_connections++;
-            g_network_stats.timeout_errors++;
+            metrics_counter_inc(METRIC_NET_CONNECTIONS_FAILED);
+            metrics_counter_inc(METRIC_NET_TIMEOUT_ERRORS);
             attempt++;
             if (attempt <= max_retries) {
                 sleep(NETWORK_RETRY_DELAY_MS / 1000);
@@ -136,9 +133,9 @@ bool send_tcp_message(const char* host_ip, const std::vector<uint8_t>& payload,
             continue;
         }
 
-        g_network_stats.successful_connections++;
+        metrics_counter_inc(METRIC_NET_CONNECTIONS_OK);
         g_network_status = NETWORK_STATUS_CONNECTED;
-        g_network_stats.last_activity_timestamp = (uint32_t)time(NULL);
+        metrics_gauge_set(METRIC_NET_LAST_ACTIVITY, (int32_t)time(NULL));
 
         // Send data with timeout
         size_t total_sent = 0;
@@ -150,12 +147,12 @@ bool send_tcp_message(const char* host_ip, const std::vector<uint8_t>& payload,
             if (sent < 0) {
                 LOG_NETWORK_ERROR(ERROR_SOCKET_SEND, "Send failed: %s", strerror(errno));
                 close(sock);
-                g_network_stats.network_errors++;
+                metrics_counter_inc(METRIC_NET_ERRORS);
                 success = false;
                 break;
             }
             total_sent += sent;
-            g_network_stats.total_bytes_sent += sent;
+            metrics_counter_add(METRIC_NET_BYTES_SENT, (uint32_t)sent);
         }
 
         if (total_sent == data_size) {
@@ -202,7 +199,7 @@ bool broadcast_udp_packet(const uint8_t* payload, size_t payload_size, uint16_t
     int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (sock < 0) {
         LOG_NETWORK_ERROR(ERROR_SOCKET_CREATE, "Failed to create UDP socket: %s", strerror(errno));
-        g_network_stats.network_errors++;
+        metrics_counter_inc(METRIC_NET_ERRORS);
         return false;
     }
 
@@ -240,7 +237,7 @@ bool broadcast_udp_packet(const uint8_t* payload, size_t payload_size, uint16_t
             }
         } else {
             total_sent += sent;
-            g_network_stats.total_bytes_sent += sent;
+            metrics_counter_add(METRIC_NET_BYTES_SENT, (uint32_t)sent);
             if (g_debug_enabled) {
                 LOG_NETWORK_DEBUG("UDP broadcast sent %d bytes", sent);
             }
@@ -250,11 +247,11 @@ bool broadcast_udp_packet(const uint8_t* payload, size_t payload_size, uint16_t
     close(sock);
 
     if (total_sent == payload_size) {
-        g_network_stats.total_messages_sent++;
-        g_network_stats.last_activity_timestamp = (uint32_t)time(NULL);
+        metrics_counter_inc(METRIC_NET_MESSAGES_SENT);
+        metrics_gauge_set(METRIC_NET_LAST_ACTIVITY, (int32_t)time(NULL));
         return true;
     } else {
-        g_network_stats.network_errors++;
+        metrics_counter_inc(METRIC_NET_ERRORS);
         return false;
     }
 }
@@ -307,7 +304,17 @@ bool is_network_available(void) {
  */
 bool network_get_stats(network_stats_t* stats) {
     if (!stats) return false;
-    memcpy(stats, &g_network_stats, sizeof(network_stats_t));
+    stats->total_messages_sent = metrics_counter_get(METRIC_NET_MESSAGES_SENT);
+    stats->total_messages_received = metrics_counter_get(METRIC_NET_MESSAGES_RECEIVED);
+    stats->total_bytes_sent = metrics_counter_get(METRIC_NET_BYTES_SENT);
+    stats->total_bytes_received = metrics_counter_get(METRIC_NET_BYTES_RECEIVED);
+    stats->connection_attempts = metrics_counter_get(METRIC_NET_CONNECTION_ATTEMPTS);
+    stats->successful_connections = metrics_counter_get(METRIC_NET_CONNECTIONS_OK);
+    stats->failed_connections = metrics_counter_get(METRIC_NET_CONNECTIONS_FAILED);
+    stats->timeout_errors = metrics_counter_get(METRIC_NET_TIMEOUT_ERRORS);
+    stats->network_errors = metrics_counter_get(METRIC_NET_ERRORS);
+    stats->last_activity_timestamp = (uint32_t)metrics_gauge_get(METRIC_NET_LAST_ACTIVITY);
+    stats->current_status = g_network_status;
     return true;
 }
 
@@ -315,8 +322,16 @@ bool network_get_stats(network_stats_t* stats) {
  * @brief Reset network statistics
  */
 void network_reset_stats(void) {
-    memset(&g_network_stats, 0, sizeof(network_stats_t));
-    g_network_stats.last_activity_timestamp = (uint32_t)time(NULL);
+    metrics_counter_reset(METRIC_NET_MESSAGES_SENT);
+    metrics_counter_reset(METRIC_NET_MESSAGES_RECEIVED);
+    metrics_counter_reset(METRIC_NET_BYTES_SENT);
+    metrics_counter_reset(METRIC_NET_BYTES_RECEIVED);
+    metrics_counter_reset(METRIC_NET_CONNECTION_ATTEMPTS);
+    metrics_counter_reset(METRIC_NET_CONNECTIONS_OK);
+    metrics_counter_reset(METRIC_NET_CONNECTIONS_FAILED);
+    metrics_counter_reset(METRIC_NET_TIMEOUT_ERRORS);
+    metrics_counter_reset(METRIC_NET_ERRORS);
+    metrics_gauge_set(METRIC_NET_LAST_ACTIVITY, (int32_t)time(NULL));
 }
 
 /**
@@ -331,7 +346,7 @@ network_status_t network_get_status(void) {
  */
 void network_set_status(network_status_t status) {
     g_network_status = status;
-    g_network_stats.last_activity_timestamp = (uint32_t)time(NULL);
+    metrics_gauge_set(METRIC_NET_LAST_ACTIVITY, (int32_t)time(NULL));
 }
 
 /**
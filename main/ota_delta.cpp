@@ -0,0 +1,457 @@
+/**
+ * @file ota_delta.cpp
+ * @brief bsdiff-style delta encoder and streaming LZSS patcher
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/ota_delta.h"
+#include <string.h>
+#include <algorithm>
+
+enum {
+    OP_END = 0,
+    OP_COPY = 1,
+    OP_DIFF = 2,
+    OP_ADD = 3
+};
+
+// Encoder tuning
+static const size_t MATCH_HASH_BYTES = 8;       // Bytes hashed to find a match candidate
+static const size_t MATCH_MIN = 12;             // Exact bytes needed to start a region
+static const size_t MATCH_GIVE_UP = 64;         // Stop extending after this many bytes without gain
+static const uint32_t MATCH_HASH_BITS = 20;
+static const size_t LZSS_MAX_MATCH = 18 + 255;
+static const uint32_t LZSS_HASH_BITS = 14;
+static const int LZSS_MAX_CHAIN = 48;
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+static void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void put_varint(std::vector<uint8_t>* out, uint32_t value) {
+    while (value >= 0x80) {
+        out->push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back((uint8_t)value);
+}
+
+static uint32_t block_hash(const uint8_t* data, uint32_t bits) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return (uint32_t)((value * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static size_t exact_length(const uint8_t* a, const uint8_t* b, size_t limit) {
+    size_t n = 0;
+    while (n < limit && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+static void emit_literals(std::vector<uint8_t>* ops, const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    ops->push_back(OP_ADD);
+    put_varint(ops, (uint32_t)length);
+    ops->insert(ops->end(), data, data + length);
+}
+
+// Build the uncompressed op stream
+static void encode_ops(const uint8_t* old_image, size_t old_size,
+                       const uint8_t* new_image, size_t new_size,
+                       std::vector<uint8_t>* ops) {
+    // Latest old position for each hashed 8-byte block
+    std::vector<int32_t> table;
+    if (old_size >= MATCH_HASH_BYTES) {
+        table.assign((size_t)1 << MATCH_HASH_BITS, -1);
+        for (size_t pos = 0; pos + MATCH_HASH_BYTES <= old_size; pos++) {
+            table[block_hash(old_image + pos, MATCH_HASH_BITS)] = (int32_t)pos;
+        }
+    }
+
+    size_t literal_start = 0;
+    size_t pos = 0;
+    int64_t last_displacement = 0;      // old - new position of the previous region
+    while (pos < new_size) {
+        // Candidates: where the previous region would continue, and the hash hit
+        size_t best_old = 0;
+        size_t best_length = 0;
+        int64_t candidates[2] = {(int64_t)pos + last_displacement, -1};
+        if (!table.empty() && pos + MATCH_HASH_BYTES <= new_size) {
+            candidates[1] = table[block_hash(new_image + pos, MATCH_HASH_BITS)];
+        }
+        for (int64_t candidate : candidates) {
+            if (candidate < 0 || (size_t)candidate >= old_size) {
+                continue;
+            }
+            size_t limit = std::min(old_size - (size_t)candidate, new_size - pos);
+            size_t length = exact_length(old_image + candidate, new_image + pos, limit);
+            if (length > best_length) {
+                best_length = length;
+                best_old = (size_t)candidate;
+            }
+        }
+
+        if (best_length < MATCH_MIN) {
+            pos++;
+            continue;
+        }
+
+        // Extend past mismatches while at least half of the bytes still
+        // match (score = 2 * matches - length, kept at its maximum)
+        size_t limit = std::min(old_size - best_old, new_size - pos);
+        size_t length = best_length;
+        long score = (long)best_length;
+        long best_score = score;
+        bool has_diff = false;
+        bool diff_in_best = false;
+        for (size_t i = best_length; i < limit && i - length < MATCH_GIVE_UP; i++) {
+            if (old_image[best_old + i] == new_image[pos + i]) {
+                score++;
+            } else {
+                score--;
+                has_diff = true;
+            }
+            if (score > best_score) {
+                best_score = score;
+                length = i + 1;
+                diff_in_best = has_diff;
+            }
+        }
+
+        emit_literals(ops, new_image + literal_start, pos - literal_start);
+        ops->push_back(diff_in_best ? OP_DIFF : OP_COPY);
+        put_varint(ops, (uint32_t)best_old);
+        put_varint(ops, (uint32_t)length);
+        if (diff_in_best) {
+            for (size_t i = 0; i < length; i++) {
+                ops->push_back((uint8_t)(new_image[pos + i] - old_image[best_old + i]));
+            }
+        }
+
+        last_displacement = (int64_t)best_old - (int64_t)pos;
+        pos += length;
+        literal_start = pos;
+    }
+    emit_literals(ops, new_image + literal_start, new_size - literal_start);
+    ops->push_back(OP_END);
+}
+
+// LZSS: groups of eight items behind a flag byte (bit set = literal). A
+// match is two bytes, distance - 1 in 12 bits and length - 3 in 4 bits;
+// length code 15 adds a byte for lengths 18 to 273.
+static void lzss_compress(const std::vector<uint8_t>& input, std::vector<uint8_t>* out) {
+    const size_t size = input.size();
+    const uint8_t* data = input.data();
+    std::vector<int32_t> head((size_t)1 << LZSS_HASH_BITS, -1);
+    std::vector<int32_t> chain(size, -1);
+
+    auto hash3 = [data](size_t at) {
+        uint32_t value = data[at] | (data[at + 1] << 8) | (data[at + 2] << 16);
+        return (value * 2654435761u) >> (32 - LZSS_HASH_BITS);
+    };
+    auto insert = [&](size_t at) {
+        if (at + OTA_DELTA_LZSS_MIN_MATCH <= size) {
+            uint32_t h = hash3(at);
+            chain[at] = head[h];
+            head[h] = (int32_t)at;
+        }
+    };
+
+    size_t flag_at = 0;
+    int flag_bit = 8;
+    size_t pos = 0;
+    while (pos < size) {
+        if (flag_bit == 8) {
+            flag_at = out->size();
+            out->push_back(0);
+            flag_bit = 0;
+        }
+
+        size_t best_length = 0;
+        size_t best_distance = 0;
+        if (pos + OTA_DELTA_LZSS_MIN_MATCH <= size) {
+            size_t limit = std::min(size - pos, LZSS_MAX_MATCH);
+            int32_t candidate = head[hash3(pos)];
+            for (int depth = 0; candidate >= 0 && depth < LZSS_MAX_CHAIN; depth++) {
+                size_t distance = pos - (size_t)candidate;
+                if (distance > OTA_DELTA_LZSS_WINDOW) {
+                    break;
+                }
+                size_t length = exact_length(data + candidate, data + pos, limit);
+                if (length > best_length) {
+                    best_length = length;
+                    best_distance = distance;
+                    if (length == limit) {
+                        break;
+                    }
+                }
+                candidate = chain[candidate];
+            }
+        }
+
+        if (best_length >= OTA_DELTA_LZSS_MIN_MATCH) {
+            size_t code = std::min(best_length - OTA_DELTA_LZSS_MIN_MATCH, (size_t)15);
+            out->push_back((uint8_t)(best_distance - 1));
+            out->push_back((uint8_t)((((best_distance - 1) >> 8) << 4) | code));
+            if (code == 15) {
+                out->push_back((uint8_t)(best_length - 18));
+            }
+            for (size_t i = 0; i < best_length; i++) {
+                insert(pos + i);
+            }
+            pos += best_length;
+        } else {
+            (*out)[flag_at] |= (uint8_t)(1 << flag_bit);
+            out->push_back(data[pos]);
+            insert(pos);
+            pos++;
+        }
+        flag_bit++;
+    }
+}
+
+bool ota_delta_encode(const uint8_t* old_image, size_t old_size,
+                      const uint8_t* new_image, size_t new_size,
+                      std::vector<uint8_t>* delta, bool compress) {
+    if (old_size > INT32_MAX || new_size > INT32_MAX) {
+        return false;
+    }
+
+    std::vector<uint8_t> ops;
+    encode_ops(old_image, old_size, new_image, new_size, &ops);
+
+    delta->assign(OTA_DELTA_MAGIC, OTA_DELTA_MAGIC + 4);
+    delta->push_back(OTA_DELTA_VERSION);
+    delta->push_back(compress ? OTA_DELTA_FLAG_LZSS : 0);
+    delta->push_back(0);
+    delta->push_back(0);
+    put_u32(delta, (uint32_t)old_size);
+    put_u32(delta, (uint32_t)new_size);
+    if (compress) {
+        lzss_compress(ops, delta);
+    } else {
+        delta->insert(delta->end(), ops.begin(), ops.end());
+    }
+    return true;
+}
+
+bool ota_delta_parse_header(const uint8_t* data, size_t length, ota_delta_header_t* header) {
+    if (length < OTA_DELTA_HEADER_SIZE || memcmp(data, OTA_DELTA_MAGIC, 4) != 0 ||
+        data[4] != OTA_DELTA_VERSION) {
+        return false;
+    }
+    header->version = data[4];
+    header->flags = data[5];
+    header->old_size = data[8] | (data[9] << 8) | (data[10] << 16) | ((uint32_t)data[11] << 24);
+    header->new_size = data[12] | (data[13] << 8) | (data[14] << 16) | ((uint32_t)data[15] << 24);
+    return true;
+}
+
+// ============================================================================
+// PATCHER
+// ============================================================================
+
+OtaDeltaPatcher::OtaDeltaPatcher(ota_delta_read_fn readOld, ota_delta_write_fn writeNew, void* ctx)
+    : m_readOld(readOld), m_writeNew(writeNew), m_ctx(ctx),
+      m_headerFill(0), m_header(),
+      m_windowPos(0), m_flags(0), m_flagBits(0), m_tokenFill(0),
+      m_state(STATE_CODE), m_op(OP_END), m_varint(0), m_varintShift(0), m_offset(0), m_remaining(0),
+      m_oldCacheStart(0), m_oldCacheLength(0), m_outFill(0), m_written(0), m_done(false) {
+}
+
+ota_delta_status_t OtaDeltaPatcher::feed(const uint8_t* data, size_t length) {
+    size_t i = 0;
+    while (m_headerFill < OTA_DELTA_HEADER_SIZE && i < length) {
+        m_headerBytes[m_headerFill++] = data[i++];
+        if (m_headerFill == OTA_DELTA_HEADER_SIZE &&
+            !ota_delta_parse_header(m_headerBytes, OTA_DELTA_HEADER_SIZE, &m_header)) {
+            return OTA_DELTA_ERR_FORMAT;
+        }
+    }
+
+    for (; i < length; i++) {
+        if (m_done) {
+            return OTA_DELTA_ERR_FORMAT;    // Data after END
+        }
+        ota_delta_status_t status = (m_header.flags & OTA_DELTA_FLAG_LZSS)
+            ? decompressByte(data[i]) : opByte(data[i]);
+        if (status != OTA_DELTA_OK) {
+            return status;
+        }
+    }
+    return m_done ? OTA_DELTA_DONE : OTA_DELTA_OK;
+}
+
+ota_delta_status_t OtaDeltaPatcher::decompressByte(uint8_t byte) {
+    if (m_flagBits == 0) {
+        m_flags = byte;
+        m_flagBits = 8;
+        return OTA_DELTA_OK;
+    }
+
+    uint32_t length;
+    uint32_t distance;
+    if (m_flags & 1) {
+        m_window[m_windowPos++ % OTA_DELTA_LZSS_WINDOW] = byte;
+        m_flags >>= 1;
+        m_flagBits--;
+        return opByte(byte);
+    }
+
+    m_token[m_tokenFill++] = byte;
+    if (m_tokenFill < 2 || (m_tokenFill == 2 && (m_token[1] & 0x0F) == 15)) {
+        return OTA_DELTA_OK;
+    }
+    distance = (m_token[0] | ((m_token[1] >> 4) << 8)) + 1;
+    length = (m_token[1] & 0x0F) + OTA_DELTA_LZSS_MIN_MATCH;
+    if (m_tokenFill == 3) {
+        length = 18 + m_token[2];
+    }
+    m_tokenFill = 0;
+    m_flags >>= 1;
+    m_flagBits--;
+    if (distance > m_windowPos) {
+        return OTA_DELTA_ERR_FORMAT;
+    }
+
+    for (uint32_t n = 0; n < length; n++) {
+        uint8_t value = m_window[(m_windowPos - distance) % OTA_DELTA_LZSS_WINDOW];
+        m_window[m_windowPos++ % OTA_DELTA_LZSS_WINDOW] = value;
+        ota_delta_status_t status = opByte(value);
+        if (status != OTA_DELTA_OK) {
+            return status;
+        }
+    }
+    return OTA_DELTA_OK;
+}
+
+ota_delta_status_t OtaDeltaPatcher::opByte(uint8_t byte) {
+    switch (m_state) {
+    case STATE_CODE:
+        m_op = byte;
+        m_varint = 0;
+        m_varintShift = 0;
+        if (byte == OP_END) {
+            m_state = STATE_END;
+            m_done = true;
+            ota_delta_status_t status = flush();
+            if (status != OTA_DELTA_OK) {
+                return status;
+            }
+            return m_written == m_header.new_size ? OTA_DELTA_OK : OTA_DELTA_ERR_RANGE;
+        }
+        if (byte == OP_COPY || byte == OP_DIFF) {
+            m_state = STATE_OFFSET;
+        } else if (byte == OP_ADD) {
+            m_state = STATE_LENGTH;
+        } else {
+            return OTA_DELTA_ERR_FORMAT;
+        }
+        return OTA_DELTA_OK;
+
+    case STATE_OFFSET:
+    case STATE_LENGTH:
+        if (m_varintShift > 28) {
+            return OTA_DELTA_ERR_FORMAT;
+        }
+        m_varint |= (uint32_t)(byte & 0x7F) << m_varintShift;
+        m_varintShift += 7;
+        if (byte & 0x80) {
+            return OTA_DELTA_OK;
+        }
+        if (m_state == STATE_OFFSET) {
+            m_offset = m_varint;
+            m_varint = 0;
+            m_varintShift = 0;
+            m_state = STATE_LENGTH;
+            return OTA_DELTA_OK;
+        }
+        m_remaining = m_varint;
+        return startBody();
+
+    case STATE_BODY: {
+        uint8_t value = byte;
+        if (m_op == OP_DIFF) {
+            uint8_t old_value;
+            if (!oldByte(m_offset++, &old_value)) {
+                return OTA_DELTA_ERR_READ;
+            }
+            value = (uint8_t)(old_value + byte);
+        }
+        ota_delta_status_t status = emit(value);
+        if (status == OTA_DELTA_OK && --m_remaining == 0) {
+            m_state = STATE_CODE;
+        }
+        return status;
+    }
+
+    case STATE_END:
+    default:
+        return OTA_DELTA_ERR_FORMAT;
+    }
+}
+
+ota_delta_status_t OtaDeltaPatcher::startBody() {
+    if ((uint64_t)m_written + m_remaining > m_header.new_size) {
+        return OTA_DELTA_ERR_RANGE;
+    }
+    if (m_op != OP_ADD && (uint64_t)m_offset + m_remaining > m_header.old_size) {
+        return OTA_DELTA_ERR_RANGE;
+    }
+
+    if (m_op == OP_COPY) {
+        while (m_remaining > 0) {
+            uint8_t value;
+            if (!oldByte(m_offset++, &value)) {
+                return OTA_DELTA_ERR_READ;
+            }
+            ota_delta_status_t status = emit(value);
+            if (status != OTA_DELTA_OK) {
+                return status;
+            }
+            m_remaining--;
+        }
+    }
+    m_state = m_remaining > 0 ? STATE_BODY : STATE_CODE;
+    return OTA_DELTA_OK;
+}
+
+bool OtaDeltaPatcher::oldByte(uint32_t offset, uint8_t* byte) {
+    if (offset < m_oldCacheStart || offset >= m_oldCacheStart + m_oldCacheLength) {
+        uint32_t length = std::min((uint32_t)sizeof(m_oldCache), m_header.old_size - offset);
+        if (!m_readOld(m_ctx, offset, m_oldCache, length)) {
+            return false;
+        }
+        m_oldCacheStart = offset;
+        m_oldCacheLength = length;
+    }
+    *byte = m_oldCache[offset - m_oldCacheStart];
+    return true;
+}
+
+ota_delta_status_t OtaDeltaPatcher::emit(uint8_t byte) {
+    m_out[m_outFill++] = byte;
+    m_written++;
+    return m_outFill == sizeof(m_out) ? flush() : OTA_DELTA_OK;
+}
+
+ota_delta_status_t OtaDeltaPatcher::flush() {
+    if (m_outFill > 0 && !m_writeNew(m_ctx, m_out, m_outFill)) {
+        return OTA_DELTA_ERR_WRITE;
+    }
+    m_outFill = 0;
+    return OTA_DELTA_OK;
+}
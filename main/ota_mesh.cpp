@@ -0,0 +1,693 @@
+/**
+ * @file ota_mesh.cpp
+ * @brief Peer-to-peer firmware delta distribution
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/ota_mesh.h"
+#include "include/ota_delta.h"
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+#include "sodium.h"
+#include <string.h>
+#include <algorithm>
+
+static const char* TAG = "OTA_MESH";
+
+// Frame header: magic, protocol version, frame type
+static const uint8_t FRAME_MAGIC[4] = {'A', 'O', 'T', 'A'};
+static const uint8_t PROTOCOL_VERSION = 2;      // 2: signed manifests
+static const size_t FRAME_HEADER_SIZE = 6;
+
+enum {
+    FRAME_ANNOUNCE = 1,
+    FRAME_REQUEST = 2,
+    FRAME_CHUNK = 3
+};
+
+static const size_t CHUNK_HEADER_SIZE = 12;     // update_id, index, crc32
+
+// Wrap-safe "now is at or past the deadline"
+static bool is_due(uint32_t nowMs, uint32_t deadlineMs) {
+    return (int32_t)(nowMs - deadlineMs) >= 0;
+}
+
+static void put_u16(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back((uint8_t)value);
+    out->push_back((uint8_t)(value >> 8));
+}
+
+static void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint16_t get_u16(const uint8_t* data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// ============================================================================
+// HASHES
+// ============================================================================
+
+void ota_sha256(const uint8_t* data, size_t length, uint8_t digest[OTA_SHA256_SIZE]) {
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, data, length);
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+}
+
+uint32_t ota_crc32(const uint8_t* data, size_t length) {
+    // IEEE 802.3 polynomial, one nibble at a time
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+// ============================================================================
+// MANIFEST
+// ============================================================================
+
+void ota_manifest_encode(const OtaManifest& manifest, std::vector<uint8_t>* out) {
+    put_u32(out, manifest.update_id);
+    out->insert(out->end(), manifest.version, manifest.version + OTA_MANIFEST_VERSION_LEN);
+    put_u32(out, manifest.base_size);
+    put_u32(out, manifest.target_size);
+    put_u32(out, manifest.delta_size);
+    put_u16(out, manifest.chunk_size);
+    out->insert(out->end(), manifest.base_sha256, manifest.base_sha256 + OTA_SHA256_SIZE);
+    out->insert(out->end(), manifest.target_sha256, manifest.target_sha256 + OTA_SHA256_SIZE);
+    out->insert(out->end(), manifest.delta_sha256, manifest.delta_sha256 + OTA_SHA256_SIZE);
+    out->insert(out->end(), manifest.signature, manifest.signature + OTA_SIGNATURE_SIZE);
+}
+
+bool ota_manifest_decode(const uint8_t* data, size_t length, OtaManifest* manifest) {
+    if (length < OTA_MANIFEST_ENCODED_SIZE) {
+        return false;
+    }
+    manifest->update_id = get_u32(data);
+    data += 4;
+    memcpy(manifest->version, data, OTA_MANIFEST_VERSION_LEN);
+    manifest->version[OTA_MANIFEST_VERSION_LEN - 1] = '\0';
+    data += OTA_MANIFEST_VERSION_LEN;
+    manifest->base_size = get_u32(data);
+    manifest->target_size = get_u32(data + 4);
+    manifest->delta_size = get_u32(data + 8);
+    manifest->chunk_size = get_u16(data + 12);
+    data += 14;
+    memcpy(manifest->base_sha256, data, OTA_SHA256_SIZE);
+    memcpy(manifest->target_sha256, data + OTA_SHA256_SIZE, OTA_SHA256_SIZE);
+    memcpy(manifest->delta_sha256, data + 2 * OTA_SHA256_SIZE, OTA_SHA256_SIZE);
+    memcpy(manifest->signature, data + 3 * OTA_SHA256_SIZE, OTA_SIGNATURE_SIZE);
+    return manifest->chunk_size > 0 && manifest->delta_size > 0;
+}
+
+bool ota_manifest_create(const uint8_t* base, size_t base_size,
+                         const uint8_t* target, size_t target_size,
+                         const std::vector<uint8_t>& delta, const char* version,
+                         uint16_t chunk_size, OtaManifest* manifest) {
+    if (delta.empty() || chunk_size == 0) {
+        return false;
+    }
+    *manifest = OtaManifest();
+    strncpy(manifest->version, version, OTA_MANIFEST_VERSION_LEN - 1);
+    manifest->base_size = (uint32_t)base_size;
+    manifest->target_size = (uint32_t)target_size;
+    manifest->delta_size = (uint32_t)delta.size();
+    manifest->chunk_size = chunk_size;
+    ota_sha256(base, base_size, manifest->base_sha256);
+    ota_sha256(target, target_size, manifest->target_sha256);
+    ota_sha256(delta.data(), delta.size(), manifest->delta_sha256);
+    manifest->update_id = get_u32(manifest->delta_sha256);
+    return true;
+}
+
+bool ota_manifest_sign(OtaManifest* manifest, const uint8_t secretKey[OTA_SECRET_KEY_SIZE]) {
+    std::vector<uint8_t> encoded;
+    ota_manifest_encode(*manifest, &encoded);
+    return crypto_sign_detached(manifest->signature, nullptr, encoded.data(), OTA_MANIFEST_SIGNED_SIZE,
+                                secretKey) == 0;
+}
+
+bool ota_manifest_verify(const OtaManifest& manifest, const uint8_t publicKey[OTA_PUBLIC_KEY_SIZE]) {
+    std::vector<uint8_t> encoded;
+    ota_manifest_encode(manifest, &encoded);
+    return crypto_sign_verify_detached(manifest.signature, encoded.data(), OTA_MANIFEST_SIGNED_SIZE,
+                                       publicKey) == 0;
+}
+
+// ============================================================================
+// DISTRIBUTOR
+// ============================================================================
+
+ota_mesh_config_t ota_mesh_default_config(void) {
+    ota_mesh_config_t config;
+    config.announce_min_ms = 1000;
+    config.announce_max_ms = 32000;
+    config.request_quiet_ms = 250;
+    config.request_timeout_ms = 2000;
+    config.peer_timeout_ms = 120000;
+    config.serve_rate_bps = 16000;
+    config.foreground_holdoff_ms = 1000;
+    config.request_window = 16;
+    config.save_every = 16;
+    return config;
+}
+
+OtaMeshNode::OtaMeshNode(const std::string& nodeId, const uint8_t runningSha256[OTA_SHA256_SIZE],
+                         const uint8_t trustedKey[OTA_PUBLIC_KEY_SIZE], IOtaChunkStore* store, SendFunction send,
+                         const ota_mesh_config_t& config, uint32_t seed)
+    : m_nodeId(nodeId), m_store(store), m_send(send), m_config(config), m_rng(seed),
+      m_state(OTA_MESH_IDLE), m_manifest(), m_have(0), m_unsaved(0),
+      m_announceIntervalMs(config.announce_min_ms), m_nextAnnounceMs(0), m_nextRequestMs(0),
+      m_holdoffUntilMs(0), m_requestCursor(0), m_verifyAfterMs(0), m_verifyHeld(false),
+      m_tokens(0), m_lastTickMs(0), m_clockStarted(false), m_stats() {
+    memcpy(m_runningSha256, runningSha256, OTA_SHA256_SIZE);
+    memcpy(m_trustedKey, trustedKey, OTA_PUBLIC_KEY_SIZE);
+    if (m_config.request_window == 0 || m_config.request_window > OTA_MESH_REQUEST_SPAN) {
+        m_config.request_window = OTA_MESH_REQUEST_SPAN;
+    }
+}
+
+bool OtaMeshNode::isOtaFrame(const uint8_t* data, size_t length) {
+    return length >= FRAME_HEADER_SIZE && memcmp(data, FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0;
+}
+
+uint32_t OtaMeshNode::jitter(uint32_t ms) {
+    // Uniform in [ms/2, ms], as Trickle does
+    std::uniform_int_distribution<uint32_t> dist(ms / 2, ms);
+    return dist(m_rng);
+}
+
+bool OtaMeshNode::verified(const OtaManifest& manifest) {
+    if (ota_manifest_verify(manifest, m_trustedKey)) {
+        return true;
+    }
+    m_stats.signature_failures++;
+    ESP_LOGW(TAG, "Update %08x is not signed by the trusted key, ignored", (unsigned)manifest.update_id);
+    return false;
+}
+
+void OtaMeshNode::resetAnnounceTimer(uint32_t nowMs) {
+    if (m_announceIntervalMs > m_config.announce_min_ms) {
+        m_announceIntervalMs = m_config.announce_min_ms;
+        m_nextAnnounceMs = nowMs + jitter(m_announceIntervalMs);
+    }
+}
+
+bool OtaMeshNode::resume(uint32_t nowMs) {
+    OtaManifest manifest;
+    std::vector<uint8_t> bitmap;
+    if (!m_store->loadProgress(&manifest, &bitmap) || bitmap.size() != (manifest.chunkCount() + 7) / 8) {
+        return false;
+    }
+
+    bool forUs = memcmp(manifest.base_sha256, m_runningSha256, OTA_SHA256_SIZE) == 0;
+    bool applied = memcmp(manifest.target_sha256, m_runningSha256, OTA_SHA256_SIZE) == 0;
+    if ((!forUs && !applied) || !verified(manifest)) {
+        return false;
+    }
+
+    m_manifest = manifest;
+    m_bitmap = bitmap;
+    m_have = 0;
+    for (uint32_t i = 0; i < manifest.chunkCount(); i++) {
+        m_have += has(i) ? 1 : 0;
+    }
+    m_holders.clear();
+    m_serveQueue.clear();
+    m_queued.assign(m_bitmap.size(), 0);
+
+    if (m_have == manifest.chunkCount()) {
+        // Already verified before it was saved complete
+        m_state = OTA_MESH_COMPLETE;
+        ESP_LOGI(TAG, "Serving update %08x (%s, %u chunks)", (unsigned)manifest.update_id,
+                 manifest.version, (unsigned)m_have);
+    } else if (forUs) {
+        m_state = OTA_MESH_FETCHING;
+        m_nextRequestMs = nowMs + jitter(m_config.request_quiet_ms);
+        ESP_LOGI(TAG, "Resuming update %08x at %u/%u chunks", (unsigned)manifest.update_id,
+                 (unsigned)m_have, (unsigned)manifest.chunkCount());
+    } else {
+        m_state = OTA_MESH_IDLE;
+        return false;
+    }
+    m_announceIntervalMs = m_config.announce_min_ms;
+    m_nextAnnounceMs = nowMs + jitter(m_announceIntervalMs);
+    return true;
+}
+
+bool OtaMeshNode::seed(const OtaManifest& manifest, uint32_t nowMs) {
+    if (manifest.chunkCount() == 0 || !verified(manifest)) {
+        return false;
+    }
+    m_manifest = manifest;
+    m_bitmap.assign((manifest.chunkCount() + 7) / 8, 0);
+    for (uint32_t i = 0; i < manifest.chunkCount(); i++) {
+        m_bitmap[i / 8] |= (uint8_t)(1 << (i % 8));
+    }
+    m_have = manifest.chunkCount();
+    m_queued.assign(m_bitmap.size(), 0);
+    m_serveQueue.clear();
+    m_state = OTA_MESH_COMPLETE;
+    m_store->saveProgress(m_manifest, m_bitmap);
+
+    m_announceIntervalMs = m_config.announce_min_ms;
+    m_nextAnnounceMs = nowMs + jitter(m_announceIntervalMs);
+    ESP_LOGI(TAG, "Seeding update %08x (%s): %u byte delta for a %u byte image in %u chunks",
+             (unsigned)manifest.update_id, manifest.version, (unsigned)manifest.delta_size,
+             (unsigned)manifest.target_size, (unsigned)m_have);
+    return true;
+}
+
+void OtaMeshNode::adopt(const OtaManifest& manifest, uint32_t nowMs) {
+    if (!m_store->begin(manifest)) {
+        ESP_LOGE(TAG, "Chunk store cannot take update %08x (%u bytes)",
+                 (unsigned)manifest.update_id, (unsigned)manifest.delta_size);
+        reject(manifest.update_id);
+        return;
+    }
+    m_manifest = manifest;
+    m_bitmap.assign((manifest.chunkCount() + 7) / 8, 0);
+    m_queued.assign(m_bitmap.size(), 0);
+    m_serveQueue.clear();
+    m_have = 0;
+    m_unsaved = 0;
+    m_requestCursor = 0;
+    m_holders.clear();
+    m_state = OTA_MESH_FETCHING;
+    m_store->saveProgress(m_manifest, m_bitmap);
+    m_nextRequestMs = nowMs + jitter(m_config.request_quiet_ms);
+    ESP_LOGI(TAG, "Fetching update %08x (%s): %u chunks", (unsigned)manifest.update_id,
+             manifest.version, (unsigned)manifest.chunkCount());
+}
+
+void OtaMeshNode::reject(uint32_t updateId) {
+    if (std::find(m_rejected.begin(), m_rejected.end(), updateId) == m_rejected.end()) {
+        m_rejected.push_back(updateId);
+    }
+    if (m_state != OTA_MESH_IDLE && m_manifest.update_id == updateId) {
+        m_state = OTA_MESH_IDLE;
+        m_serveQueue.clear();
+        m_holders.clear();
+    }
+}
+
+void OtaMeshNode::noteForegroundTraffic(uint32_t nowMs) {
+    m_holdoffUntilMs = nowMs + m_config.foreground_holdoff_ms;
+}
+
+// ----------------------------------------------------------------------------
+// Receive
+// ----------------------------------------------------------------------------
+
+void OtaMeshNode::handleFrame(const uint8_t* data, size_t length, uint32_t nowMs) {
+    if (!isOtaFrame(data, length) || data[4] != PROTOCOL_VERSION) {
+        return;
+    }
+    const uint8_t* body = data + FRAME_HEADER_SIZE;
+    size_t bodyLength = length - FRAME_HEADER_SIZE;
+    switch (data[5]) {
+    case FRAME_ANNOUNCE:
+        handleAnnounce(body, bodyLength, nowMs);
+        break;
+    case FRAME_REQUEST:
+        handleRequest(body, bodyLength, nowMs);
+        break;
+    case FRAME_CHUNK:
+        handleChunk(body, bodyLength, nowMs);
+        break;
+    default:
+        break;
+    }
+}
+
+void OtaMeshNode::handleAnnounce(const uint8_t* body, size_t length, uint32_t nowMs) {
+    // Holder ID, manifest, complete flag, chunk count, bitmap
+    if (length < 1 || length < 1 + (size_t)body[0]) {
+        return;
+    }
+    std::string from((const char*)body + 1, body[0]);
+    body += 1 + from.size();
+    length -= 1 + from.size();
+
+    OtaManifest manifest;
+    if (from.empty() || from == m_nodeId || length < OTA_MANIFEST_ENCODED_SIZE + 5 ||
+        !ota_manifest_decode(body, length, &manifest)) {
+        return;
+    }
+    if (std::find(m_rejected.begin(), m_rejected.end(), manifest.update_id) != m_rejected.end()) {
+        return;
+    }
+
+    if (m_state == OTA_MESH_IDLE) {
+        if (memcmp(manifest.base_sha256, m_runningSha256, OTA_SHA256_SIZE) != 0) {
+            return;     // Delta is for other firmware
+        }
+        // Verified once, before anything is stored or requested
+        if (m_verifyHeld && !is_due(nowMs, m_verifyAfterMs)) {
+            return;
+        }
+        m_verifyHeld = !verified(manifest);
+        if (m_verifyHeld) {
+            m_verifyAfterMs = nowMs + m_config.announce_min_ms;
+            return;
+        }
+        adopt(manifest, nowMs);
+        if (m_state == OTA_MESH_IDLE) {
+            return;
+        }
+    }
+    if (manifest.update_id != m_manifest.update_id) {
+        return;
+    }
+
+    // Holder's bitmap: omitted when it has everything
+    const uint8_t* tail = body + OTA_MANIFEST_ENCODED_SIZE;
+    bool complete = tail[0] != 0;
+    uint32_t have = get_u32(tail + 1);
+    Holder& holder = m_holders[from];
+    holder.lastHeardMs = nowMs;
+    holder.have = have;
+    if (complete) {
+        holder.bitmap.assign(m_bitmap.size(), 0xFF);
+        holder.have = m_manifest.chunkCount();
+    } else if (length >= OTA_MANIFEST_ENCODED_SIZE + 5 + m_bitmap.size()) {
+        holder.bitmap.assign(tail + 5, tail + 5 + m_bitmap.size());
+    } else {
+        m_holders.erase(from);
+        return;
+    }
+
+    // A peer that lacks chunks we hold should hear from us soon
+    for (size_t i = 0; i < m_bitmap.size(); i++) {
+        if (m_bitmap[i] & ~holder.bitmap[i]) {
+            resetAnnounceTimer(nowMs);
+            break;
+        }
+    }
+}
+
+void OtaMeshNode::handleRequest(const uint8_t* body, size_t length, uint32_t nowMs) {
+    if (m_state == OTA_MESH_IDLE || length < 5 || get_u32(body) != m_manifest.update_id) {
+        return;
+    }
+    size_t idLength = body[4];
+    if (length < 5 + idLength + 8) {
+        return;
+    }
+    std::string holder((const char*)body + 5, idLength);
+    uint32_t first = get_u32(body + 5 + idLength);
+    uint32_t mask = get_u32(body + 9 + idLength);
+    const uint32_t count = m_manifest.chunkCount();
+
+    if (holder == m_nodeId) {
+        for (uint32_t bit = 0; bit < OTA_MESH_REQUEST_SPAN; bit++) {
+            uint32_t index = first + bit;
+            if (!(mask & (1u << bit)) || index >= count || !has(index)) {
+                continue;
+            }
+            if (!(m_queued[index / 8] & (1 << (index % 8)))) {
+                m_queued[index / 8] |= (uint8_t)(1 << (index % 8));
+                m_serveQueue.push_back(index);
+            }
+        }
+        return;
+    }
+
+    // Someone else asked for chunks we also miss: wait for them to go by
+    if (m_state == OTA_MESH_FETCHING) {
+        for (uint32_t bit = 0; bit < OTA_MESH_REQUEST_SPAN; bit++) {
+            uint32_t index = first + bit;
+            if ((mask & (1u << bit)) && index < count && !has(index)) {
+                uint32_t later = nowMs + m_config.request_quiet_ms;
+                if (!is_due(m_nextRequestMs, later)) {
+                    m_nextRequestMs = later;
+                    m_stats.requests_suppressed++;
+                }
+                break;
+            }
+        }
+    }
+}
+
+void OtaMeshNode::handleChunk(const uint8_t* body, size_t length, uint32_t nowMs) {
+    if (m_state == OTA_MESH_IDLE || length < CHUNK_HEADER_SIZE || get_u32(body) != m_manifest.update_id) {
+        return;
+    }
+    uint32_t index = get_u32(body + 4);
+    uint32_t crc = get_u32(body + 8);
+    const uint8_t* data = body + CHUNK_HEADER_SIZE;
+    size_t dataLength = length - CHUNK_HEADER_SIZE;
+
+    // Chunks are flowing; hold our own requests until they stop
+    if (m_state == OTA_MESH_FETCHING) {
+        uint32_t later = nowMs + m_config.request_quiet_ms;
+        if (!is_due(m_nextRequestMs, later)) {
+            m_nextRequestMs = later;
+        }
+    }
+
+    const uint32_t count = m_manifest.chunkCount();
+    if (index >= count) {
+        m_stats.chunks_bad++;
+        return;
+    }
+    if (has(index)) {
+        m_stats.chunks_duplicate++;
+        return;
+    }
+    size_t expected = index + 1 < count ? m_manifest.chunk_size
+                                        : m_manifest.delta_size - index * m_manifest.chunk_size;
+    if (dataLength != expected || ota_crc32(data, dataLength) != crc ||
+        !m_store->writeChunk(index, data, dataLength)) {
+        m_stats.chunks_bad++;
+        return;
+    }
+
+    m_bitmap[index / 8] |= (uint8_t)(1 << (index % 8));
+    m_have++;
+    m_stats.chunks_received++;
+    if (++m_unsaved >= m_config.save_every) {
+        m_store->saveProgress(m_manifest, m_bitmap);
+        m_unsaved = 0;
+    }
+    checkComplete(nowMs);
+}
+
+void OtaMeshNode::checkComplete(uint32_t nowMs) {
+    if (m_state != OTA_MESH_FETCHING || m_have < m_manifest.chunkCount()) {
+        return;
+    }
+
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    uint8_t block[512];
+    bool readOk = true;
+    for (uint32_t offset = 0; offset < m_manifest.delta_size && readOk; offset += sizeof(block)) {
+        size_t n = std::min((size_t)(m_manifest.delta_size - offset), sizeof(block));
+        readOk = m_store->read(offset, block, n);
+        mbedtls_sha256_update(&ctx, block, n);
+    }
+    uint8_t digest[OTA_SHA256_SIZE];
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+
+    if (!readOk || memcmp(digest, m_manifest.delta_sha256, OTA_SHA256_SIZE) != 0) {
+        // A chunk passed its CRC but the whole does not match: start over
+        ESP_LOGE(TAG, "Update %08x failed verification, fetching again", (unsigned)m_manifest.update_id);
+        m_stats.verify_failures++;
+        std::fill(m_bitmap.begin(), m_bitmap.end(), 0);
+        m_have = 0;
+        m_store->saveProgress(m_manifest, m_bitmap);
+        return;
+    }
+
+    m_state = OTA_MESH_COMPLETE;
+    m_store->saveProgress(m_manifest, m_bitmap);
+    m_unsaved = 0;
+    resetAnnounceTimer(nowMs);
+    ESP_LOGI(TAG, "Update %08x complete and verified", (unsigned)m_manifest.update_id);
+    if (m_onComplete) {
+        m_onComplete(m_manifest);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Send
+// ----------------------------------------------------------------------------
+
+bool OtaMeshNode::send(uint8_t type, const std::vector<uint8_t>& body) {
+    std::vector<uint8_t> frame;
+    frame.reserve(FRAME_HEADER_SIZE + body.size());
+    frame.insert(frame.end(), FRAME_MAGIC, FRAME_MAGIC + sizeof(FRAME_MAGIC));
+    frame.push_back(PROTOCOL_VERSION);
+    frame.push_back(type);
+    frame.insert(frame.end(), body.begin(), body.end());
+    if (!m_send(frame)) {
+        return false;
+    }
+    m_stats.frames_sent++;
+    m_stats.bytes_sent += frame.size();
+    return true;
+}
+
+void OtaMeshNode::sendAnnounce() {
+    std::vector<uint8_t> body;
+    body.push_back((uint8_t)m_nodeId.size());
+    body.insert(body.end(), m_nodeId.begin(), m_nodeId.end());
+    ota_manifest_encode(m_manifest, &body);
+    bool complete = m_have == m_manifest.chunkCount();
+    body.push_back(complete ? 1 : 0);
+    put_u32(&body, m_have);
+    if (!complete) {
+        body.insert(body.end(), m_bitmap.begin(), m_bitmap.end());
+    }
+    if (send(FRAME_ANNOUNCE, body)) {
+        m_stats.announces_sent++;
+    }
+}
+
+bool OtaMeshNode::sendRequest(uint32_t nowMs) {
+    const uint32_t count = m_manifest.chunkCount();
+    for (auto it = m_holders.begin(); it != m_holders.end();) {
+        if (is_due(nowMs, it->second.lastHeardMs + m_config.peer_timeout_ms)) {
+            it = m_holders.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (m_holders.empty()) {
+        return false;
+    }
+
+    // Walk the windows from the cursor; ask the holder that covers most of
+    // the first window anyone can help with
+    const uint32_t windows = (count + OTA_MESH_REQUEST_SPAN - 1) / OTA_MESH_REQUEST_SPAN;
+    for (uint32_t scanned = 0; scanned < windows; scanned++) {
+        uint32_t first = ((m_requestCursor + scanned) % windows) * OTA_MESH_REQUEST_SPAN;
+
+        const std::string* best = nullptr;
+        uint32_t bestMask = 0;
+        int bestCount = 0;
+        for (const auto& entry : m_holders) {
+            uint32_t mask = 0;
+            int wanted = 0;
+            for (uint32_t bit = 0; bit < OTA_MESH_REQUEST_SPAN && wanted < m_config.request_window; bit++) {
+                uint32_t index = first + bit;
+                if (index >= count) {
+                    break;
+                }
+                bool holderHas = (entry.second.bitmap[index / 8] >> (index % 8)) & 1;
+                if (!has(index) && holderHas) {
+                    mask |= 1u << bit;
+                    wanted++;
+                }
+            }
+            // Ties go to a random holder so requests spread over them
+            if (wanted > bestCount || (wanted == bestCount && wanted > 0 && (m_rng() & 1))) {
+                best = &entry.first;
+                bestMask = mask;
+                bestCount = wanted;
+            }
+        }
+        if (!best) {
+            continue;
+        }
+
+        std::vector<uint8_t> body;
+        put_u32(&body, m_manifest.update_id);
+        body.push_back((uint8_t)best->size());
+        body.insert(body.end(), best->begin(), best->end());
+        put_u32(&body, first);
+        put_u32(&body, bestMask);
+        if (!send(FRAME_REQUEST, body)) {
+            return false;
+        }
+        m_stats.requests_sent++;
+        m_requestCursor = first / OTA_MESH_REQUEST_SPAN + 1;
+        return true;
+    }
+    return false;
+}
+
+bool OtaMeshNode::serveChunk(uint32_t index) {
+    uint32_t offset = index * m_manifest.chunk_size;
+    size_t length = std::min((uint32_t)m_manifest.chunk_size, m_manifest.delta_size - offset);
+    std::vector<uint8_t> data(length);
+    if (!m_store->read(offset, data.data(), length)) {
+        ESP_LOGE(TAG, "Cannot read chunk %u", (unsigned)index);
+        return false;
+    }
+
+    std::vector<uint8_t> body;
+    body.reserve(CHUNK_HEADER_SIZE + length);
+    put_u32(&body, m_manifest.update_id);
+    put_u32(&body, index);
+    put_u32(&body, ota_crc32(data.data(), length));
+    body.insert(body.end(), data.begin(), data.end());
+    if (!send(FRAME_CHUNK, body)) {
+        return false;
+    }
+    m_stats.chunks_sent++;
+    return true;
+}
+
+void OtaMeshNode::tick(uint32_t nowMs) {
+    // Token bucket for chunk frames, holding at most two frames' worth
+    const double frameCost = FRAME_HEADER_SIZE + CHUNK_HEADER_SIZE + m_manifest.chunk_size;
+    if (m_clockStarted) {
+        m_tokens += (double)(uint32_t)(nowMs - m_lastTickMs) * m_config.serve_rate_bps / 1000.0;
+        m_tokens = std::min(m_tokens, 2 * frameCost);
+    }
+    m_lastTickMs = nowMs;
+    m_clockStarted = true;
+
+    if (m_state == OTA_MESH_IDLE || !is_due(nowMs, m_holdoffUntilMs)) {
+        return;
+    }
+
+    // Requested chunks first, at the paced rate
+    while (!m_serveQueue.empty() && m_tokens >= frameCost) {
+        uint32_t index = m_serveQueue.front();
+        m_serveQueue.erase(m_serveQueue.begin());
+        m_queued[index / 8] &= (uint8_t)~(1 << (index % 8));
+        if (!serveChunk(index)) {
+            break;
+        }
+        m_tokens -= frameCost;
+    }
+    if (!m_serveQueue.empty()) {
+        return;
+    }
+
+    if (m_have > 0 && is_due(nowMs, m_nextAnnounceMs)) {
+        sendAnnounce();
+        m_announceIntervalMs = std::min(m_announceIntervalMs * 2, m_config.announce_max_ms);
+        m_nextAnnounceMs = nowMs + jitter(m_announceIntervalMs);
+    }
+
+    if (m_state == OTA_MESH_FETCHING && is_due(nowMs, m_nextRequestMs)) {
+        bool sent = sendRequest(nowMs);
+        m_nextRequestMs = nowMs + (sent ? m_config.request_timeout_ms : jitter(m_config.request_quiet_ms));
+    }
+}
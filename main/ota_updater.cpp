@@ -1,25 +1,584 @@
+/**
+ * @file ota_updater.cpp
+ * @brief Mesh-distributed delta firmware updates with A/B partitions
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
 #include "include/ota_updater.h"
+#include "include/ota_delta.h"
+#include "include/ota_mesh.h"
+#include "include/config.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_spiffs.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include <algorithm>
+#include <atomic>
 #include <stdio.h>
+#include <string.h>
+#include <new>
+
+static const char* OTA_TAG = "OTA_UPDATER";
+
+#define OTA_NVS_NAMESPACE "aircom_ota"
+#define OTA_STATUS_MUTEX_TIMEOUT pdMS_TO_TICKS(100)
+#define OTA_APPLY_BLOCK_SIZE 1024
+
+#ifndef CONFIG_AIRCOM_OTA_PUBLIC_KEY
+#define CONFIG_AIRCOM_OTA_PUBLIC_KEY ""
+#endif
+
+// Received distributor frame handed from the executor to the OTA task
+typedef struct {
+    uint8_t* data;
+    uint16_t length;
+} ota_frame_t;
+
+// ============================================================================
+// CHUNK STORE: delta file on SPIFFS, progress in NVS
+// ============================================================================
+
+class SpiffsOtaStore : public IOtaChunkStore {
+public:
+    SpiffsOtaStore() : m_file(nullptr) {}
+    ~SpiffsOtaStore() override { close(); }
+
+    bool begin(const OtaManifest& manifest) override {
+        close();
+        size_t total = 0;
+        size_t used = 0;
+        esp_spiffs_info(OTA_SPIFFS_PARTITION, &total, &used);
+        // The old delta is replaced, so its space counts as free
+        FILE* old = fopen(OTA_DELTA_PATH, "rb");
+        if (old) {
+            fseek(old, 0, SEEK_END);
+            long oldSize = ftell(old);
+            fclose(old);
+            used -= std::min(used, (size_t)std::max(oldSize, 0L));
+        }
+        if (manifest.delta_size > total - used) {
+            ESP_LOGE(OTA_TAG, "Delta of %u bytes does not fit in %u free bytes",
+                     (unsigned)manifest.delta_size, (unsigned)(total - used));
+            return false;
+        }
+
+        // Pre-size the file so chunks can be written in any order
+        FILE* file = fopen(OTA_DELTA_PATH, "wb");
+        if (!file) {
+            return false;
+        }
+        uint8_t blank[256];
+        memset(blank, 0xFF, sizeof(blank));
+        for (uint32_t written = 0; written < manifest.delta_size; written += sizeof(blank)) {
+            size_t n = std::min((size_t)(manifest.delta_size - written), sizeof(blank));
+            if (fwrite(blank, 1, n, file) != n) {
+                fclose(file);
+                return false;
+            }
+        }
+        fclose(file);
+        m_chunkSize = manifest.chunk_size;
+        return open();
+    }
+
+    bool writeChunk(uint32_t index, const uint8_t* data, size_t length) override {
+        if (!open() || fseek(m_file, (long)index * m_chunkSize, SEEK_SET) != 0 ||
+            fwrite(data, 1, length, m_file) != length) {
+            return false;
+        }
+        return fflush(m_file) == 0;
+    }
 
-static const char* TAG = "OTA_UPDATER";
+    bool read(uint32_t offset, uint8_t* data, size_t length) override {
+        return open() && fseek(m_file, (long)offset, SEEK_SET) == 0 &&
+               fread(data, 1, length, m_file) == length;
+    }
 
-// OTA Updater Service - Stub Implementation
-// This is a placeholder for the OTA (Over-The-Air) update functionality
+    bool saveProgress(const OtaManifest& manifest, const std::vector<uint8_t>& bitmap) override {
+        std::vector<uint8_t> encoded;
+        ota_manifest_encode(manifest, &encoded);
+        nvs_handle_t handle;
+        if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+            return false;
+        }
+        esp_err_t err = nvs_set_blob(handle, "manifest", encoded.data(), encoded.size());
+        if (err == ESP_OK) {
+            err = nvs_set_blob(handle, "bitmap", bitmap.data(), bitmap.size());
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+        m_chunkSize = manifest.chunk_size;
+        return err == ESP_OK;
+    }
+
+    bool loadProgress(OtaManifest* manifest, std::vector<uint8_t>* bitmap) override {
+        nvs_handle_t handle;
+        if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+            return false;
+        }
+        uint8_t encoded[OTA_MANIFEST_ENCODED_SIZE];
+        size_t length = sizeof(encoded);
+        bool ok = nvs_get_blob(handle, "manifest", encoded, &length) == ESP_OK &&
+                  ota_manifest_decode(encoded, length, manifest);
+        if (ok) {
+            length = 0;
+            ok = nvs_get_blob(handle, "bitmap", nullptr, &length) == ESP_OK;
+            bitmap->resize(length);
+            ok = ok && nvs_get_blob(handle, "bitmap", bitmap->data(), &length) == ESP_OK;
+        }
+        nvs_close(handle);
+        if (ok) {
+            m_chunkSize = manifest->chunk_size;
+        }
+        return ok;
+    }
+
+private:
+    bool open() {
+        if (!m_file) {
+            m_file = fopen(OTA_DELTA_PATH, "r+b");
+        }
+        return m_file != nullptr;
+    }
+
+    void close() {
+        if (m_file) {
+            fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+    FILE* m_file;
+    uint32_t m_chunkSize = OTA_MESH_DEFAULT_CHUNK_SIZE;
+};
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static SpiffsOtaStore* s_store = nullptr;
+static OtaMeshNode* s_node = nullptr;
+static QueueHandle_t s_frameQueue = nullptr;
+static SemaphoreHandle_t s_statusMutex = nullptr;
+static ota_updater_status_t s_status;
+static std::atomic<bool> s_applyPending(false);
+static std::atomic<uint32_t> s_foregroundMs(0);
+static bool s_pendingVerify = false;
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void set_state(ota_updater_state_t state) {
+    if (xSemaphoreTake(s_statusMutex, OTA_STATUS_MUTEX_TIMEOUT) == pdTRUE) {
+        s_status.state = state;
+        xSemaphoreGive(s_statusMutex);
+    }
+}
+
+static void update_status(void) {
+    if (xSemaphoreTake(s_statusMutex, OTA_STATUS_MUTEX_TIMEOUT) != pdTRUE) {
+        return;
+    }
+    const OtaManifest& manifest = s_node->manifest();
+    if (s_status.state != OTA_UPDATER_APPLYING && s_status.state != OTA_UPDATER_READY &&
+        s_status.state != OTA_UPDATER_FAILED) {
+        s_status.state = s_node->state() == OTA_MESH_FETCHING ? OTA_UPDATER_FETCHING : OTA_UPDATER_IDLE;
+    }
+    s_status.update_id = manifest.update_id;
+    memcpy(s_status.version, manifest.version, sizeof(s_status.version));
+    s_status.chunks_have = s_node->chunksHave();
+    s_status.chunks_total = manifest.chunkCount();
+    s_status.delta_size = manifest.delta_size;
+    s_status.target_size = manifest.target_size;
+    s_status.bytes_sent = s_node->stats().bytes_sent;
+    s_status.pending_verify = s_pendingVerify;
+    xSemaphoreGive(s_statusMutex);
+}
+
+// ============================================================================
+// APPLY
+// ============================================================================
+
+typedef struct {
+    const esp_partition_t* running;
+    esp_ota_handle_t handle;
+    mbedtls_sha256_context sha;
+} apply_context_t;
+
+static bool read_running(void* ctx, uint32_t offset, uint8_t* data, size_t length) {
+    apply_context_t* apply = (apply_context_t*)ctx;
+    return esp_partition_read(apply->running, offset, data, length) == ESP_OK;
+}
+
+static bool write_target(void* ctx, const uint8_t* data, size_t length) {
+    apply_context_t* apply = (apply_context_t*)ctx;
+    mbedtls_sha256_update(&apply->sha, data, length);
+    return esp_ota_write(apply->handle, data, length) == ESP_OK;
+}
+
+/**
+ * @brief Patch the stored delta into the passive partition and select it
+ */
+static bool apply_update(const OtaManifest& manifest) {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    const esp_partition_t* target = esp_ota_get_next_update_partition(NULL);
+    if (!running || !target || manifest.target_size > target->size) {
+        ESP_LOGE(OTA_TAG, "No OTA partition for a %u byte image", (unsigned)manifest.target_size);
+        return false;
+    }
+
+    apply_context_t apply;
+    apply.running = running;
+    if (esp_ota_begin(target, manifest.target_size, &apply.handle) != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "esp_ota_begin failed on %s", target->label);
+        return false;
+    }
+    mbedtls_sha256_init(&apply.sha);
+    mbedtls_sha256_starts(&apply.sha, 0);
+
+    OtaDeltaPatcher* patcher = new (std::nothrow) OtaDeltaPatcher(read_running, write_target, &apply);
+    uint8_t* block = (uint8_t*)malloc(OTA_APPLY_BLOCK_SIZE);
+    ota_delta_status_t status = OTA_DELTA_ERR_FORMAT;
+    if (patcher && block) {
+        int64_t startUs = esp_timer_get_time();
+        status = OTA_DELTA_OK;
+        for (uint32_t offset = 0; offset < manifest.delta_size && status == OTA_DELTA_OK; offset += OTA_APPLY_BLOCK_SIZE) {
+            size_t n = std::min((size_t)(manifest.delta_size - offset), (size_t)OTA_APPLY_BLOCK_SIZE);
+            status = s_store->read(offset, block, n) ? patcher->feed(block, n) : OTA_DELTA_ERR_READ;
+            taskYIELD();
+        }
+        ESP_LOGI(OTA_TAG, "Patched %u bytes into %s in %lld ms", (unsigned)patcher->bytesWritten(),
+                 target->label, (long long)((esp_timer_get_time() - startUs) / 1000));
+        if (status == OTA_DELTA_DONE && patcher->header().old_size != manifest.base_size) {
+            status = OTA_DELTA_ERR_RANGE;
+        }
+    }
+    delete patcher;
+    free(block);
+
+    uint8_t digest[OTA_SHA256_SIZE];
+    mbedtls_sha256_finish(&apply.sha, digest);
+    mbedtls_sha256_free(&apply.sha);
+
+    if (status != OTA_DELTA_DONE || memcmp(digest, manifest.target_sha256, OTA_SHA256_SIZE) != 0) {
+        ESP_LOGE(OTA_TAG, "Patch failed (status %d) or produced the wrong image", (int)status);
+        esp_ota_abort(apply.handle);
+        return false;
+    }
+
+    // esp_ota_end() validates the image, including its signature when
+    // CONFIG_SECURE_SIGNED_APPS_NO_SECURE_BOOT or secure boot is enabled
+    esp_err_t err = esp_ota_end(apply.handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Image rejected: %s", esp_err_to_name(err));
+        return false;
+    }
+    err = esp_ota_set_boot_partition(target);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Cannot select %s for boot: %s", target->label, esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(OTA_TAG, "Firmware %s ready in %s, active after restart", manifest.version, target->label);
+    return true;
+}
+
+// ============================================================================
+// MESH HOOKS
+// ============================================================================
+
+static void on_mesh_data(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (!OtaMeshNode::isOtaFrame(data.data(), data.size())) {
+        s_foregroundMs.store(now_ms() | 1);
+        return;
+    }
+    if (data.size() > UINT16_MAX) {
+        return;
+    }
+    ota_frame_t frame;
+    frame.data = (uint8_t*)malloc(data.size());
+    if (!frame.data) {
+        return;
+    }
+    memcpy(frame.data, data.data(), data.size());
+    frame.length = (uint16_t)data.size();
+    if (xQueueSend(s_frameQueue, &frame, 0) != pdTRUE) {
+        free(frame.data);   // Lowest priority traffic: drop rather than wait
+    }
+}
+
+static void on_mesh_send(uint16_t port, size_t size) {
+    if (port != OTA_PORT) {
+        s_foregroundMs.store(now_ms() | 1);
+    }
+}
+
+static bool send_frame(const std::vector<uint8_t>& frame) {
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    // Never park distributor frames in the offline cache
+    if (!mesh.get_connection_status()) {
+        return false;
+    }
+    return mesh.sendUdpMulticast(frame.data(), frame.size(), OTA_PORT);
+}
+
+// ============================================================================
+// TASK
+// ============================================================================
+
+static void check_pending_verify(int64_t bootUs) {
+    if (!s_pendingVerify) {
+        return;
+    }
+    if (HaLowMeshManager::getInstance().get_connection_status()) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        s_pendingVerify = false;
+        ESP_LOGI(OTA_TAG, "New firmware reached the mesh, marked valid");
+    } else if (esp_timer_get_time() - bootUs > (int64_t)OTA_VERIFY_TIMEOUT_MS * 1000) {
+        ESP_LOGE(OTA_TAG, "New firmware did not reach the mesh in %d s, rolling back", OTA_VERIFY_TIMEOUT_MS / 1000);
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+}
+
+static void ota_task(void* pvParameters) {
+    int64_t bootUs = esp_timer_get_time();
+    for (;;) {
+        ota_frame_t frame;
+        if (xQueueReceive(s_frameQueue, &frame, pdMS_TO_TICKS(OTA_TICK_MS)) == pdTRUE) {
+            s_node->handleFrame(frame.data, frame.length, now_ms());
+            free(frame.data);
+        }
+
+        uint32_t foreground = s_foregroundMs.exchange(0);
+        if (foreground) {
+            s_node->noteForegroundTraffic(foreground);
+        }
+        s_node->tick(now_ms());
+
+        if (s_applyPending.exchange(false)) {
+            set_state(OTA_UPDATER_APPLYING);
+            OtaManifest manifest = s_node->manifest();
+            set_state(apply_update(manifest) ? OTA_UPDATER_READY : OTA_UPDATER_FAILED);
+        }
+
+        check_pending_verify(bootUs);
+        update_status();
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+static bool mount_storage(void) {
+    if (esp_spiffs_mounted(OTA_SPIFFS_PARTITION)) {
+        return true;
+    }
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = OTA_SPIFFS_BASE_PATH,
+        .partition_label = OTA_SPIFFS_PARTITION,
+        .max_files = 4,
+        .format_if_mount_failed = true
+    };
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Cannot mount %s: %s", OTA_SPIFFS_PARTITION, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// Seed from an uploaded manifest unless that update is already in progress
+static void seed_from_storage(uint32_t nowMs) {
+    FILE* file = fopen(OTA_MANIFEST_PATH, "rb");
+    if (!file) {
+        return;
+    }
+    uint8_t encoded[OTA_MANIFEST_ENCODED_SIZE];
+    size_t length = fread(encoded, 1, sizeof(encoded), file);
+    fclose(file);
+
+    OtaManifest manifest;
+    if (!ota_manifest_decode(encoded, length, &manifest)) {
+        ESP_LOGE(OTA_TAG, "%s is not a valid manifest", OTA_MANIFEST_PATH);
+        return;
+    }
+    if (s_node->state() == OTA_MESH_COMPLETE && s_node->manifest().update_id == manifest.update_id) {
+        return;
+    }
+
+    // Check the uploaded delta before offering it to the squad
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    uint8_t block[512];
+    uint32_t total = 0;
+    file = fopen(OTA_DELTA_PATH, "rb");
+    while (file && (length = fread(block, 1, sizeof(block), file)) > 0) {
+        mbedtls_sha256_update(&sha, block, length);
+        total += length;
+    }
+    if (file) {
+        fclose(file);
+    }
+    uint8_t digest[OTA_SHA256_SIZE];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (total != manifest.delta_size || memcmp(digest, manifest.delta_sha256, OTA_SHA256_SIZE) != 0) {
+        ESP_LOGE(OTA_TAG, "%s does not match %s, not seeding", OTA_DELTA_PATH, OTA_MANIFEST_PATH);
+        return;
+    }
+    s_node->seed(manifest, nowMs);
+}
+
+// Trusted manifest key from Kconfig: exactly 64 hex characters
+static bool parse_public_key(const char* hex, uint8_t key[OTA_PUBLIC_KEY_SIZE]) {
+    if (strlen(hex) != 2 * OTA_PUBLIC_KEY_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < 2 * OTA_PUBLIC_KEY_SIZE; i++) {
+        char c = hex[i];
+        int nibble = (c >= '0' && c <= '9') ? c - '0'
+                   : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                   : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (nibble < 0) {
+            return false;
+        }
+        key[i / 2] = (uint8_t)((i % 2) ? (key[i / 2] | nibble) : (nibble << 4));
+    }
+    return true;
+}
 
 int ota_updater_init(void) {
-    printf("[%s] OTA updater initialized (stub implementation)\n", TAG);
-    // TODO: Implement actual OTA initialization
+    if (s_node) {
+        return 0;
+    }
+    memset(&s_status, 0, sizeof(s_status));
+
+    uint8_t trustedKey[OTA_PUBLIC_KEY_SIZE];
+    if (!parse_public_key(CONFIG_AIRCOM_OTA_PUBLIC_KEY, trustedKey)) {
+        ESP_LOGE(OTA_TAG, "CONFIG_AIRCOM_OTA_PUBLIC_KEY is not set to a 64-character hex key, mesh OTA disabled");
+        return -1;
+    }
+
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    if (!running) {
+        ESP_LOGE(OTA_TAG, "Cannot find the running partition");
+        return -1;
+    }
+    esp_ota_img_states_t imageState;
+    if (esp_ota_get_state_partition(running, &imageState) == ESP_OK &&
+        imageState == ESP_OTA_IMG_PENDING_VERIFY) {
+        s_pendingVerify = true;
+        ESP_LOGW(OTA_TAG, "Running new firmware from %s, awaiting confirmation", running->label);
+    }
+
+    uint8_t runningSha[OTA_SHA256_SIZE];
+    if (esp_partition_get_sha256(running, runningSha) != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Cannot hash the running image");
+        return -1;
+    }
+
+    if (!mount_storage()) {
+        return -1;
+    }
+
+    s_statusMutex = xSemaphoreCreateMutex();
+    s_frameQueue = xQueueCreate(OTA_FRAME_QUEUE_DEPTH, sizeof(ota_frame_t));
+    s_store = new (std::nothrow) SpiffsOtaStore();
+    if (!s_statusMutex || !s_frameQueue || !s_store) {
+        ESP_LOGE(OTA_TAG, "Out of memory");
+        return -1;
+    }
+
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    char nodeId[32];
+    snprintf(nodeId, sizeof(nodeId), "ESP32-%02x%02x%02x", mac[3], mac[4], mac[5]);
+
+    s_node = new (std::nothrow) OtaMeshNode(nodeId, runningSha, trustedKey, s_store, send_frame,
+                                            ota_mesh_default_config(), esp_random());
+    if (!s_node) {
+        ESP_LOGE(OTA_TAG, "Out of memory");
+        return -1;
+    }
+    s_node->setCompleteCallback([](const OtaManifest& manifest) {
+        s_applyPending.store(true);
+    });
+
+    uint32_t nowMs = now_ms();
+    s_node->resume(nowMs);
+    seed_from_storage(nowMs);
+    if (s_node->state() == OTA_MESH_COMPLETE &&
+        memcmp(s_node->manifest().base_sha256, runningSha, OTA_SHA256_SIZE) == 0) {
+        // A complete delta for this firmware (seeded here, or fetched before
+        // the last restart) has not been applied yet
+        s_applyPending.store(true);
+    }
+
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    mesh.addDataListener(DataCallback::fromFunction<on_mesh_data>());
+    mesh.addSendListener(HaLowMeshManager::SendListener::fromFunction<on_mesh_send>());
+
+    update_status();
+    if (xTaskCreatePinnedToCore(ota_task, "OTA", OTA_TASK_STACK_SIZE, NULL, OTA_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        ESP_LOGE(OTA_TAG, "Failed to create OTA task");
+        return -1;
+    }
+
+    ESP_LOGI(OTA_TAG, "OTA updater running from %s as %s", running->label, nodeId);
     return 0;
 }
 
 int ota_updater_check_for_updates(void) {
-    printf("[%s] Checking for firmware updates (stub implementation)\n", TAG);
-    // TODO: Implement actual update check
+    ota_updater_status_t status;
+    if (!ota_updater_get_status(&status)) {
+        return -1;
+    }
+    if (status.state == OTA_UPDATER_FETCHING || status.state == OTA_UPDATER_APPLYING ||
+        status.state == OTA_UPDATER_READY) {
+        ESP_LOGI(OTA_TAG, "Update %s: %u/%u chunks", status.version,
+                 (unsigned)status.chunks_have, (unsigned)status.chunks_total);
+        return 1;
+    }
     return 0;
 }
 
 int ota_updater_perform_update(void) {
-    printf("[%s] Performing firmware update (stub implementation)\n", TAG);
-    // TODO: Implement actual update process
+    ota_updater_status_t status;
+    if (!ota_updater_get_status(&status) || status.state != OTA_UPDATER_READY) {
+        ESP_LOGW(OTA_TAG, "No firmware update ready");
+        return -1;
+    }
+    ESP_LOGI(OTA_TAG, "Restarting into firmware %s", status.version);
+    esp_restart();
     return 0;
-}
\ No newline at end of file
+}
+
+bool ota_updater_get_status(ota_updater_status_t* status) {
+    if (!s_statusMutex || !status) {
+        return false;
+    }
+    if (xSemaphoreTake(s_statusMutex, OTA_STATUS_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    *status = s_status;
+    xSemaphoreGive(s_statusMutex);
+    return true;
+}
@@ -0,0 +1,357 @@
+/**
+ * @file outbox_service.cpp
+ * @brief Store-and-forward messages to single peers on OUTBOX_PORT
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/outbox_service.h"
+#include "include/config.h"
+#include "include/metrics_registry.h"
+#include "include/ota_updater.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_spiffs.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+static const char* OUTBOX_TAG = "OUTBOX_SERVICE";
+
+#define OUTBOX_MUTEX_TIMEOUT pdMS_TO_TICKS(500)
+
+// Work handed to the outbox task
+typedef enum {
+    OUTBOX_EVENT_FRAME = 0,                 // Outbox frame from a peer
+    OUTBOX_EVENT_PEER_UP,
+    OUTBOX_EVENT_PEER_DOWN
+} outbox_event_type_t;
+
+typedef struct {
+    outbox_event_type_t type;
+    char peer_id[OUTBOX_NODE_ID_LEN];
+    uint8_t* data;
+    uint16_t length;
+} outbox_event_t;
+
+// ============================================================================
+// LOG STORAGE: one append-only file on SPIFFS
+// ============================================================================
+
+class SpiffsOutboxStorage : public IOutboxStorage {
+public:
+    bool load(std::vector<uint8_t>* log) override {
+        log->clear();
+        FILE* file = fopen(OUTBOX_LOG_PATH, "rb");
+        if (!file) {
+            // A rewrite that was cut short after the old log was removed
+            // leaves a complete temporary file
+            if (rename(OUTBOX_LOG_TEMP_PATH, OUTBOX_LOG_PATH) != 0) {
+                return true;
+            }
+            file = fopen(OUTBOX_LOG_PATH, "rb");
+            if (!file) {
+                return false;
+            }
+        } else {
+            remove(OUTBOX_LOG_TEMP_PATH);   // Cut short before the switch
+        }
+        uint8_t buffer[256];
+        size_t length;
+        while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            log->insert(log->end(), buffer, buffer + length);
+        }
+        bool ok = !ferror(file);
+        fclose(file);
+        return ok;
+    }
+
+    bool append(const uint8_t* data, size_t length) override {
+        FILE* file = fopen(OUTBOX_LOG_PATH, "ab");
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(data, 1, length, file) == length;
+        return fclose(file) == 0 && ok;
+    }
+
+    // SPIFFS cannot rename over an existing file: write the new log aside,
+    // then remove the old one and move the new one in
+    bool rewrite(const std::vector<uint8_t>& log) override {
+        FILE* file = fopen(OUTBOX_LOG_TEMP_PATH, "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = log.empty() || fwrite(log.data(), 1, log.size(), file) == log.size();
+        if (fclose(file) != 0 || !ok) {
+            remove(OUTBOX_LOG_TEMP_PATH);
+            return false;
+        }
+        remove(OUTBOX_LOG_PATH);
+        return rename(OUTBOX_LOG_TEMP_PATH, OUTBOX_LOG_PATH) == 0;
+    }
+};
+
+static SpiffsOutboxStorage s_storage;
+static MessageOutbox* s_outbox = nullptr;
+static SemaphoreHandle_t s_outboxMutex = nullptr;
+static QueueHandle_t s_eventQueue = nullptr;
+static std::atomic<outbox_receive_handler_t> s_receiveHandler(nullptr);
+static std::atomic<outbox_receipt_handler_t> s_receiptHandler(nullptr);
+static outbox_stats_t s_published;          // Counters already added to the metrics registry
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static bool mount_storage(void) {
+    if (esp_spiffs_mounted(OTA_SPIFFS_PARTITION)) {
+        return true;
+    }
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = OTA_SPIFFS_BASE_PATH,
+        .partition_label = OTA_SPIFFS_PARTITION,
+        .max_files = 4,
+        .format_if_mount_failed = true
+    };
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(OUTBOX_TAG, "Cannot mount %s: %s", OTA_SPIFFS_PARTITION, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// MESH HOOKS
+// ============================================================================
+
+static void queue_event(outbox_event_type_t type, const std::string& peer_id, const std::vector<uint8_t>* data) {
+    if (peer_id.empty() || peer_id.size() >= OUTBOX_NODE_ID_LEN) {
+        return;
+    }
+    outbox_event_t event = {};
+    event.type = type;
+    strncpy(event.peer_id, peer_id.c_str(), sizeof(event.peer_id) - 1);
+    if (data) {
+        event.data = (uint8_t*)malloc(data->size());
+        if (!event.data) {
+            return;
+        }
+        memcpy(event.data, data->data(), data->size());
+        event.length = (uint16_t)data->size();
+    }
+    if (xQueueSend(s_eventQueue, &event, 0) != pdTRUE) {
+        free(event.data);                   // The sender repeats what was not acknowledged
+    }
+}
+
+static void on_mesh_data(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (MessageOutbox::isOutboxFrame(data.data(), data.size()) && data.size() <= UINT16_MAX) {
+        queue_event(OUTBOX_EVENT_FRAME, peer_id, &data);
+    }
+}
+
+static void on_mesh_peer(const std::string& peer_id, bool reachable) {
+    queue_event(reachable ? OUTBOX_EVENT_PEER_UP : OUTBOX_EVENT_PEER_DOWN, peer_id, nullptr);
+}
+
+// Frames are repeated by the outbox; keep them out of the offline cache
+static bool send_frame(const std::string& peer_id, const std::vector<uint8_t>& frame) {
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    return mesh.get_connection_status() && mesh.sendUdpUnicast(peer_id, frame.data(), frame.size(), OUTBOX_PORT);
+}
+
+// ============================================================================
+// TASK
+// ============================================================================
+
+static void publish_metrics(void) {
+    const outbox_stats_t& stats = s_outbox->stats();
+    metrics_counter_add(METRIC_OUTBOX_QUEUED, stats.queued - s_published.queued);
+    metrics_counter_add(METRIC_OUTBOX_DELIVERED, stats.delivered - s_published.delivered);
+    metrics_counter_add(METRIC_OUTBOX_RECEIVED, stats.received - s_published.received);
+    metrics_counter_add(METRIC_OUTBOX_CUSTODY_ACCEPTED, stats.custody_accepted - s_published.custody_accepted);
+    metrics_counter_add(METRIC_OUTBOX_CUSTODY_HANDED, stats.custody_handed - s_published.custody_handed);
+    metrics_counter_add(METRIC_OUTBOX_EXPIRED, stats.expired - s_published.expired);
+    metrics_counter_add(METRIC_OUTBOX_FLASH_BYTES, stats.log_bytes_written - s_published.log_bytes_written);
+    metrics_gauge_set(METRIC_OUTBOX_PENDING, (int32_t)s_outbox->pending());
+    s_published = stats;
+}
+
+static bool load_outbox(void) {
+    std::string nodeId = HaLowMeshManager::getInstance().getLocalPeerId();
+    if (nodeId.empty() || nodeId.size() >= OUTBOX_NODE_ID_LEN) {
+        return false;                       // Radio not up yet
+    }
+    MessageOutbox* outbox = new (std::nothrow) MessageOutbox(nodeId, &s_storage, send_frame,
+                                                             outbox_default_config(), esp_random());
+    if (!outbox) {
+        ESP_LOGE(OUTBOX_TAG, "Out of memory");
+        return false;
+    }
+    outbox->setReceiveCallback([](const std::string& origin, const std::vector<uint8_t>& payload) {
+        outbox_receive_handler_t handler = s_receiveHandler.load();
+        if (handler) {
+            handler(origin.c_str(), payload.data(), payload.size());
+        }
+    });
+    outbox->setReceiptCallback([](const std::string& destination, uint32_t messageId) {
+        outbox_receipt_handler_t handler = s_receiptHandler.load();
+        if (handler) {
+            handler(destination.c_str(), messageId);
+        }
+    });
+
+    xSemaphoreTake(s_outboxMutex, portMAX_DELAY);
+    bool loaded = outbox->begin(now_ms());
+    if (loaded) {
+        s_outbox = outbox;
+        s_published = outbox->stats();
+    }
+    xSemaphoreGive(s_outboxMutex);
+    if (!loaded) {
+        delete outbox;
+        return false;
+    }
+    ESP_LOGI(OUTBOX_TAG, "Outbox of %s ready, %u messages waiting", nodeId.c_str(), (unsigned)outbox->pending());
+    return true;
+}
+
+// Catch connections and departures whose events were lost
+static void reconcile_neighbours(uint32_t nowMs) {
+    // Peers that have gone without an event time out in the outbox
+    for (const std::string& peerId : HaLowMeshManager::getInstance().getReachablePeers()) {
+        if (!s_outbox->isNeighbour(peerId)) {
+            s_outbox->peerUp(peerId, nowMs);
+        }
+    }
+}
+
+static void handle_event(const outbox_event_t& event, uint32_t nowMs) {
+    std::string peerId(event.peer_id);
+    switch (event.type) {
+        case OUTBOX_EVENT_FRAME:
+            s_outbox->handleFrame(peerId, event.data, event.length, nowMs);
+            break;
+        case OUTBOX_EVENT_PEER_UP:
+            s_outbox->peerUp(peerId, nowMs);
+            break;
+        case OUTBOX_EVENT_PEER_DOWN:
+            s_outbox->peerDown(peerId, nowMs);
+            break;
+    }
+}
+
+static void outbox_task(void* pvParameters) {
+    if (!mount_storage()) {
+        ESP_LOGE(OUTBOX_TAG, "No storage, outbox disabled");
+        vTaskDelete(NULL);
+        return;
+    }
+    uint32_t nextReconcileMs = 0;
+    for (;;) {
+        outbox_event_t event;
+        bool received = xQueueReceive(s_eventQueue, &event, pdMS_TO_TICKS(OUTBOX_SERVICE_TICK_MS)) == pdTRUE;
+        if (!s_outbox && !load_outbox()) {
+            if (received) {
+                free(event.data);
+            }
+            continue;
+        }
+
+        if (xSemaphoreTake(s_outboxMutex, OUTBOX_MUTEX_TIMEOUT) != pdTRUE) {
+            if (received) {
+                free(event.data);
+            }
+            continue;
+        }
+        uint32_t nowMs = now_ms();
+        if (received) {
+            handle_event(event, nowMs);
+            free(event.data);
+        }
+        if ((int32_t)(nowMs - nextReconcileMs) >= 0) {
+            nextReconcileMs = nowMs + OUTBOX_SERVICE_RECONCILE_MS;
+            reconcile_neighbours(nowMs);
+        }
+        s_outbox->tick(nowMs);
+        publish_metrics();
+        xSemaphoreGive(s_outboxMutex);
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int outbox_service_init(void) {
+    if (s_eventQueue) {
+        return 0;
+    }
+    s_outboxMutex = xSemaphoreCreateMutex();
+    s_eventQueue = xQueueCreate(OUTBOX_SERVICE_EVENT_QUEUE_DEPTH, sizeof(outbox_event_t));
+    if (!s_outboxMutex || !s_eventQueue) {
+        ESP_LOGE(OUTBOX_TAG, "Out of memory");
+        return -1;
+    }
+
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    mesh.addDataListener(DataCallback::fromFunction<on_mesh_data>());
+    mesh.addPeerListener(HaLowMeshManager::PeerListener::fromFunction<on_mesh_peer>());
+
+    if (xTaskCreatePinnedToCore(outbox_task, "Outbox", OUTBOX_SERVICE_TASK_STACK_SIZE, NULL,
+                                OUTBOX_SERVICE_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        ESP_LOGE(OUTBOX_TAG, "Failed to create outbox task");
+        return -1;
+    }
+
+    ESP_LOGI(OUTBOX_TAG, "Outbox service started on port %d", OUTBOX_PORT);
+    return 0;
+}
+
+void outbox_service_set_handlers(outbox_receive_handler_t receive, outbox_receipt_handler_t receipt) {
+    s_receiveHandler.store(receive);
+    s_receiptHandler.store(receipt);
+}
+
+uint32_t outbox_service_send(const char* destination, const uint8_t* data, size_t length, uint8_t priority,
+                             uint8_t flags) {
+    if (!s_outboxMutex || !destination) {
+        return 0;
+    }
+    if (xSemaphoreTake(s_outboxMutex, OUTBOX_MUTEX_TIMEOUT) != pdTRUE) {
+        return 0;
+    }
+    uint32_t messageId = s_outbox ? s_outbox->send(destination, data, length, priority, flags, 0, now_ms()) : 0;
+    xSemaphoreGive(s_outboxMutex);
+    return messageId;
+}
+
+bool outbox_service_get_stats(outbox_stats_t* stats, uint32_t* pending) {
+    if (!s_outboxMutex || !stats) {
+        return false;
+    }
+    if (xSemaphoreTake(s_outboxMutex, OUTBOX_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool loaded = s_outbox != nullptr;
+    if (loaded) {
+        *stats = s_outbox->stats();
+        if (pending) {
+            *pending = (uint32_t)s_outbox->pending();
+        }
+    }
+    xSemaphoreGive(s_outboxMutex);
+    return loaded;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file power_manager.cpp
+ * @brief Activity states, per-state power policy and wake accounting
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/power_manager.h"
+#include <string.h>
+
+power_config_t power_default_config(void) {
+    power_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.listen_hold_ms = 10000;
+    config.user_hold_ms = 15000;
+    config.data_hold_ms = 5000;
+
+    // Nothing going on: slow clock, light sleep between wakes, the radio
+    // wakes once a second for buffered traffic. GPS sentences arriving
+    // during light sleep are lost, which only delays the next fix.
+    power_policy_t& idle = config.policy[POWER_STATE_IDLE];
+    idle.cpu_max_mhz = 160;
+    idle.cpu_min_mhz = 40;
+    idle.light_sleep = true;
+    idle.radio_wake_ms = 1000;
+    idle.poll_ms[POWER_WAKE_UI] = 100;      // Buttons are polled; 100 ms stays responsive
+    idle.poll_ms[POWER_WAKE_AUDIO] = 100;
+    idle.poll_ms[POWER_WAKE_NETWORK] = 1000;
+    idle.poll_ms[POWER_WAKE_GPS] = 1000;
+    idle.poll_ms[POWER_WAKE_MANAGER] = 1000; // Reports that raise the state wake it at once
+
+    // Map shown: the GPS UART must keep receiving, which light sleep
+    // would stop, but the radio can still doze
+    power_policy_t& navigating = config.policy[POWER_STATE_NAVIGATING];
+    navigating.cpu_max_mhz = 160;
+    navigating.cpu_min_mhz = 40;
+    navigating.light_sleep = false;
+    navigating.radio_wake_ms = 500;
+    navigating.poll_ms[POWER_WAKE_UI] = 100;
+    navigating.poll_ms[POWER_WAKE_AUDIO] = 100;
+    navigating.poll_ms[POWER_WAKE_NETWORK] = 500;
+    navigating.poll_ms[POWER_WAKE_GPS] = 250;
+    navigating.poll_ms[POWER_WAKE_MANAGER] = 1000;
+
+    // Voice or a user about: full rate, radio always awake. The audio
+    // task holds a PM lock while it works on a frame, so the clock is at
+    // its maximum for the codec whatever the DFS floor.
+    power_policy_t& listening = config.policy[POWER_STATE_LISTENING];
+    listening.cpu_max_mhz = 240;
+    listening.cpu_min_mhz = 80;
+    listening.light_sleep = false;
+    listening.radio_wake_ms = 0;
+    listening.poll_ms[POWER_WAKE_UI] = 33;
+    listening.poll_ms[POWER_WAKE_AUDIO] = 20;
+    listening.poll_ms[POWER_WAKE_NETWORK] = 100;
+    listening.poll_ms[POWER_WAKE_GPS] = 1000;
+    listening.poll_ms[POWER_WAKE_MANAGER] = 250;  // Notices the hold times running out
+
+    power_policy_t& transmitting = config.policy[POWER_STATE_TRANSMITTING];
+    transmitting = listening;
+    transmitting.cpu_min_mhz = 160;
+    return config;
+}
+
+power_current_model_t power_default_current_model(void) {
+    power_current_model_t model;
+    model.cpu_ma_per_mhz = 0.145f;          // ESP32-S3: ~23 mA at 80 MHz, ~46 mA at 240 MHz
+    model.cpu_base_ma = 11.5f;
+    model.cpu_idle_fraction = 0.7f;
+    model.light_sleep_ma = 0.24f;
+    model.wake_uc = 20.0f;                  // ~1 ms at 20 mA to leave and re-enter light sleep
+    model.radio_rx_ma = 35.0f;
+    model.radio_tx_ma = 210.0f;
+    model.radio_doze_ma = 0.35f;
+    model.radio_window_ms = 8;
+    model.display_ma = 8.0f;
+    model.gps_ma = 25.0f;
+    model.audio_ma = 15.0f;
+    model.battery_mah = 1500.0f;
+    return model;
+}
+
+const char* power_state_name(power_state_t state) {
+    switch (state) {
+        case POWER_STATE_IDLE: return "idle";
+        case POWER_STATE_NAVIGATING: return "navigating";
+        case POWER_STATE_LISTENING: return "listening";
+        case POWER_STATE_TRANSMITTING: return "transmitting";
+        default: return "?";
+    }
+}
+
+float power_policy_wakes_per_second(const power_policy_t& policy) {
+    float wakes = 0.0f;
+    for (int source = 0; source < POWER_WAKE_COUNT; source++) {
+        if (policy.poll_ms[source] > 0) {
+            wakes += 1000.0f / policy.poll_ms[source];
+        }
+    }
+    if (policy.radio_wake_ms > 0) {
+        wakes += 1000.0f / policy.radio_wake_ms;
+    }
+    return wakes;
+}
+
+float power_estimate_current_ma(const power_current_model_t& model, const power_policy_t& policy, float cpu_busy,
+                                float wakes_per_s, bool transmitting, bool audio) {
+    cpu_busy = cpu_busy < 0.0f ? 0.0f : cpu_busy > 1.0f ? 1.0f : cpu_busy;
+
+    // Busy time runs at the maximum clock; between wakes the CPU sleeps or
+    // waits for interrupts at the DFS floor
+    float active_ma = model.cpu_base_ma + model.cpu_ma_per_mhz * policy.cpu_max_mhz;
+    float waiting_ma = policy.light_sleep ?
+        model.light_sleep_ma :
+        (model.cpu_base_ma + model.cpu_ma_per_mhz * policy.cpu_min_mhz) * model.cpu_idle_fraction;
+    float cpu_ma = cpu_busy * active_ma + (1.0f - cpu_busy) * waiting_ma;
+    if (policy.light_sleep) {
+        cpu_ma += wakes_per_s * model.wake_uc / 1000.0f;
+    }
+
+    // Voice on air takes about a quarter of the time at the usual MCS;
+    // the rest of the time the module listens
+    float radio_ma;
+    if (transmitting) {
+        radio_ma = 0.25f * model.radio_tx_ma + 0.75f * model.radio_rx_ma;
+    } else if (policy.radio_wake_ms == 0) {
+        radio_ma = model.radio_rx_ma;
+    } else {
+        float awake = (float)model.radio_window_ms / policy.radio_wake_ms;
+        awake = awake > 1.0f ? 1.0f : awake;
+        radio_ma = awake * model.radio_rx_ma + (1.0f - awake) * model.radio_doze_ma;
+    }
+
+    return cpu_ma + radio_ma + model.display_ma + model.gps_ma + (audio ? model.audio_ma : 0.0f);
+}
+
+// ============================================================================
+// STATE MACHINE
+// ============================================================================
+
+PowerManager::PowerManager(const power_config_t& config)
+    : m_config(config) {
+}
+
+void PowerManager::setActive(power_activity_t activity, bool active, uint32_t nowMs) {
+    if (activity >= POWER_ACTIVITY_COUNT) {
+        return;
+    }
+    m_held[activity] = active;
+    m_seen[activity] = true;
+    m_lastMs[activity] = nowMs;
+}
+
+void PowerManager::pulse(power_activity_t activity, uint32_t nowMs) {
+    if (activity >= POWER_ACTIVITY_COUNT) {
+        return;
+    }
+    m_seen[activity] = true;
+    m_lastMs[activity] = nowMs;
+}
+
+bool PowerManager::recent(power_activity_t activity, uint32_t holdMs, uint32_t nowMs) const {
+    return m_seen[activity] && nowMs - m_lastMs[activity] < holdMs;
+}
+
+power_state_t PowerManager::evaluate(uint32_t nowMs) const {
+    if (m_held[POWER_ACTIVITY_TRANSMIT]) {
+        return POWER_STATE_TRANSMITTING;
+    }
+    if (recent(POWER_ACTIVITY_VOICE, m_config.listen_hold_ms, nowMs) ||
+        recent(POWER_ACTIVITY_USER, m_config.user_hold_ms, nowMs) ||
+        recent(POWER_ACTIVITY_DATA, m_config.data_hold_ms, nowMs)) {
+        return POWER_STATE_LISTENING;
+    }
+    if (m_held[POWER_ACTIVITY_NAVIGATE]) {
+        return POWER_STATE_NAVIGATING;
+    }
+    return POWER_STATE_IDLE;
+}
+
+bool PowerManager::update(uint32_t nowMs) {
+    if (!m_started) {
+        m_started = true;
+        m_lastUpdateMs = nowMs;
+        m_stats.entries[m_state]++;
+    }
+    m_stats.time_ms[m_state] += nowMs - m_lastUpdateMs;
+    m_lastUpdateMs = nowMs;
+
+    power_state_t next = evaluate(nowMs);
+    if (next == m_state) {
+        return false;
+    }
+    m_state = next;
+    m_stats.transitions++;
+    m_stats.entries[next]++;
+    return true;
+}
+
+void PowerManager::noteWake(power_wake_source_t source, uint32_t count) {
+    if (source >= POWER_WAKE_COUNT) {
+        return;
+    }
+    m_stats.wakes[m_state] += count;
+    m_stats.wakes_by_source[source] += count;
+}
+
+uint32_t PowerManager::pollMs(power_wake_source_t source) const {
+    return source < POWER_WAKE_COUNT ? m_config.policy[m_state].poll_ms[source] : 0;
+}
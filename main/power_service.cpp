@@ -0,0 +1,215 @@
+/**
+ * @file power_service.cpp
+ * @brief Dynamic frequency scaling, light sleep and radio duty cycling by activity
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/power_service.h"
+#include "include/metrics_registry.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <new>
+
+static const char* POWER_TAG = "POWER_SERVICE";
+
+static PowerManager* s_manager = nullptr;
+static power_config_t s_config;             // Read without a lock; fixed once the task runs
+static TaskHandle_t s_task = NULL;
+static std::atomic<uint8_t> s_state(POWER_STATE_IDLE);
+
+// Reports from the tasks, taken over by the power task on its next tick
+static std::atomic<bool> s_held[POWER_ACTIVITY_COUNT];
+static std::atomic<uint32_t> s_pulseMs[POWER_ACTIVITY_COUNT];  // Time + 1; 0 when taken
+static std::atomic<uint32_t> s_wakes[POWER_WAKE_COUNT];
+
+// Counters copied out by the power task for power_service_get_stats()
+static portMUX_TYPE s_statsLock = portMUX_INITIALIZER_UNLOCKED;
+static power_stats_t s_stats;
+static uint32_t s_publishedTransitions = 0;
+static uint32_t s_publishedWakes = 0;
+
+static esp_pm_lock_handle_t s_rtFreqLock = NULL;
+static esp_pm_lock_handle_t s_rtSleepLock = NULL;
+static bool s_pmSupported = true;
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void apply_policy(power_state_t state) {
+    const power_policy_t& policy = s_config.policy[state];
+    if (s_pmSupported) {
+        esp_pm_config_t pm = {
+            .max_freq_mhz = policy.cpu_max_mhz,
+            .min_freq_mhz = policy.cpu_min_mhz,
+            .light_sleep_enable = policy.light_sleep
+        };
+        esp_err_t err = esp_pm_configure(&pm);
+        if (err == ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGW(POWER_TAG, "Power management not enabled in this build; only polling follows the state");
+            s_pmSupported = false;
+        } else if (err != ESP_OK) {
+            ESP_LOGW(POWER_TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        }
+    }
+    HaLowMeshManager::getInstance().setRadioWakeInterval(policy.radio_wake_ms);
+    ESP_LOGI(POWER_TAG, "%s: CPU %u-%u MHz%s, radio %s", power_state_name(state),
+             (unsigned)policy.cpu_min_mhz, (unsigned)policy.cpu_max_mhz,
+             policy.light_sleep ? ", light sleep" : "",
+             policy.radio_wake_ms ? "duty cycled" : "awake");
+}
+
+// ============================================================================
+// TASK
+// ============================================================================
+
+static void take_reports(bool* held) {
+    for (int activity = 0; activity < POWER_ACTIVITY_COUNT; activity++) {
+        bool active = s_held[activity].load();
+        if (active != held[activity]) {
+            held[activity] = active;
+            s_manager->setActive((power_activity_t)activity, active, now_ms());
+        }
+        uint32_t pulse = s_pulseMs[activity].exchange(0);
+        if (pulse != 0) {
+            s_manager->pulse((power_activity_t)activity, pulse - 1);
+        }
+    }
+    for (int source = 0; source < POWER_WAKE_COUNT; source++) {
+        uint32_t wakes = s_wakes[source].exchange(0);
+        if (wakes > 0) {
+            s_manager->noteWake((power_wake_source_t)source, wakes);
+        }
+    }
+}
+
+static void publish(void) {
+    const power_stats_t& stats = s_manager->stats();
+    uint32_t wakes = 0;
+    for (int state = 0; state < POWER_STATE_COUNT; state++) {
+        wakes += stats.wakes[state];
+    }
+    metrics_counter_add(METRIC_POWER_TRANSITIONS, stats.transitions - s_publishedTransitions);
+    metrics_counter_add(METRIC_POWER_WAKES, wakes - s_publishedWakes);
+    metrics_gauge_set(METRIC_POWER_STATE, (int32_t)s_manager->state());
+    s_publishedTransitions = stats.transitions;
+    s_publishedWakes = wakes;
+
+    portENTER_CRITICAL(&s_statsLock);
+    s_stats = stats;
+    portEXIT_CRITICAL(&s_statsLock);
+}
+
+static void power_task(void* pvParameters) {
+    bool held[POWER_ACTIVITY_COUNT] = {};
+    s_manager->update(now_ms());
+    apply_policy(s_manager->state());
+
+    for (;;) {
+        // Reports that may raise the state wake the task at once
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(power_service_poll_ms(POWER_WAKE_MANAGER, POWER_SERVICE_TICK_MS)));
+        take_reports(held);
+        if (s_manager->update(now_ms())) {
+            s_state = (uint8_t)s_manager->state();
+            apply_policy(s_manager->state());
+        }
+        publish();
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int power_service_init(void) {
+    if (s_manager) {
+        return 0;
+    }
+    s_config = power_default_config();
+    s_manager = new (std::nothrow) PowerManager(s_config);
+    if (!s_manager) {
+        ESP_LOGE(POWER_TAG, "Out of memory");
+        return -1;
+    }
+
+    // Without CONFIG_PM_ENABLE the locks are not supported and stay NULL
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "rt_freq", &s_rtFreqLock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "rt_sleep", &s_rtSleepLock) != ESP_OK) {
+        ESP_LOGW(POWER_TAG, "PM locks unavailable; real-time sections run unguarded");
+    }
+
+    if (xTaskCreatePinnedToCore(power_task, "Power", POWER_SERVICE_TASK_STACK_SIZE, NULL,
+                                POWER_SERVICE_TASK_PRIORITY, &s_task, 0) != pdPASS) {
+        ESP_LOGE(POWER_TAG, "Failed to create power task");
+        return -1;
+    }
+    return 0;
+}
+
+void power_service_set_active(power_activity_t activity, bool active) {
+    if (activity >= POWER_ACTIVITY_COUNT || s_held[activity].exchange(active) == active) {
+        return;
+    }
+    if (s_task) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void power_service_pulse(power_activity_t activity) {
+    if (activity >= POWER_ACTIVITY_COUNT) {
+        return;
+    }
+    s_pulseMs[activity] = now_ms() + 1;
+    // Only a node not yet listening needs to change state now
+    if (s_task && s_state.load() < POWER_STATE_LISTENING) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+uint32_t power_service_poll_ms(power_wake_source_t source, uint32_t fallback_ms) {
+    if (source >= POWER_WAKE_COUNT) {
+        return fallback_ms;
+    }
+    s_wakes[source]++;
+    if (!s_task) {
+        return fallback_ms;
+    }
+    uint32_t poll = s_config.policy[s_state.load()].poll_ms[source];
+    return poll ? poll : fallback_ms;
+}
+
+void power_service_rt_begin(void) {
+    if (s_rtFreqLock && s_rtSleepLock) {
+        esp_pm_lock_acquire(s_rtSleepLock);
+        esp_pm_lock_acquire(s_rtFreqLock);
+    }
+}
+
+void power_service_rt_end(void) {
+    if (s_rtFreqLock && s_rtSleepLock) {
+        esp_pm_lock_release(s_rtFreqLock);
+        esp_pm_lock_release(s_rtSleepLock);
+    }
+}
+
+power_state_t power_service_state(void) {
+    return (power_state_t)s_state.load();
+}
+
+bool power_service_get_stats(power_stats_t* stats) {
+    if (!s_task || !stats) {
+        return false;
+    }
+    portENTER_CRITICAL(&s_statsLock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_statsLock);
+    return true;
+}
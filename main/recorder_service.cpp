@@ -0,0 +1,361 @@
+/**
+ * @file recorder_service.cpp
+ * @brief Voice recorder and instant replay in the SPIFFS storage partition
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/recorder_service.h"
+#include "include/frame_ring.h"
+#include "include/metrics_registry.h"
+#include "include/ota_updater.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_spiffs.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+
+static const char* RECORDER_TAG = "RECORDER_SERVICE";
+
+#define RECORDER_MUTEX_TIMEOUT pdMS_TO_TICKS(200)
+
+// Capture ring frame head: direction, group, talker length, uptime ms u32,
+// epoch s u32, talker; the voice frame follows
+#define RECORDER_CAPTURE_HEAD_SIZE 11
+#define RECORDER_REPLAY_HEAD_SIZE 4         // Replay generation u32
+
+// ============================================================================
+// RING FILE
+// ============================================================================
+
+class SpiffsVoiceStorage : public IVoiceStorage {
+public:
+    bool open(size_t blocks) {
+        size_t size = blocks * VOICE_RECORDER_BLOCK_SIZE;
+        m_file = fopen(RECORDER_FILE_PATH, "r+b");
+        if (m_file && fseek(m_file, 0, SEEK_END) == 0 && (size_t)ftell(m_file) == size) {
+            m_blocks = blocks;
+            return true;
+        }
+        if (m_file) {
+            fclose(m_file);
+        }
+        // First start or a different size: lay the whole ring out once, so
+        // later writes never grow the file
+        m_file = fopen(RECORDER_FILE_PATH, "w+b");
+        if (!m_file) {
+            return false;
+        }
+        uint8_t* zero = new (std::nothrow) uint8_t[VOICE_RECORDER_BLOCK_SIZE]();
+        bool ok = zero != nullptr;
+        for (size_t i = 0; ok && i < blocks; i++) {
+            ok = fwrite(zero, 1, VOICE_RECORDER_BLOCK_SIZE, m_file) == VOICE_RECORDER_BLOCK_SIZE;
+        }
+        delete[] zero;
+        if (!ok || fflush(m_file) != 0) {
+            fclose(m_file);
+            m_file = nullptr;
+            remove(RECORDER_FILE_PATH);
+            return false;
+        }
+        m_blocks = blocks;
+        return true;
+    }
+
+    size_t blockCount() const override { return m_blocks; }
+
+    bool readBlock(size_t index, uint8_t* block) override {
+        return fseek(m_file, (long)(index * VOICE_RECORDER_BLOCK_SIZE), SEEK_SET) == 0 &&
+               fread(block, 1, VOICE_RECORDER_BLOCK_SIZE, m_file) == VOICE_RECORDER_BLOCK_SIZE;
+    }
+
+    bool writeBlock(size_t index, const uint8_t* block) override {
+        return fseek(m_file, (long)(index * VOICE_RECORDER_BLOCK_SIZE), SEEK_SET) == 0 &&
+               fwrite(block, 1, VOICE_RECORDER_BLOCK_SIZE, m_file) == VOICE_RECORDER_BLOCK_SIZE &&
+               fflush(m_file) == 0;
+    }
+
+private:
+    FILE* m_file = nullptr;
+    size_t m_blocks = 0;
+};
+
+static SpiffsVoiceStorage s_storage;
+static VoiceRecorder* s_recorder = nullptr;
+static SemaphoreHandle_t s_mutex = nullptr;
+static FrameRing* s_captureRings[2] = {};   // Per voice_direction_t: its audio lane -> recorder task
+static FrameRing* s_replayRing = nullptr;   // Recorder task -> audio task
+static std::atomic<uint32_t> s_dropped(0);
+static std::atomic<uint32_t> s_replayGeneration(0); // Replay frames of older generations are skipped
+static std::atomic<uint32_t> s_replayingId(0);      // For the UI, without the mutex
+static uint8_t s_replayFrame[RECORDER_REPLAY_HEAD_SIZE + VOICE_RECORDER_MAX_FRAME];
+static size_t s_replayPending = 0;          // Frame in s_replayFrame waiting for ring space
+static voice_recorder_stats_t s_published;  // Counters already added to the metrics registry
+static uint32_t s_publishedDropped = 0;
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static bool mount_storage(void) {
+    if (esp_spiffs_mounted(OTA_SPIFFS_PARTITION)) {
+        return true;
+    }
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = OTA_SPIFFS_BASE_PATH,
+        .partition_label = OTA_SPIFFS_PARTITION,
+        .max_files = 4,
+        .format_if_mount_failed = true
+    };
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(RECORDER_TAG, "Cannot mount %s: %s", OTA_SPIFFS_PARTITION, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// Blocks that fit beside what other users of the partition need
+static size_t ring_blocks(void) {
+    size_t total = 0, used = 0;
+    if (esp_spiffs_info(OTA_SPIFFS_PARTITION, &total, &used) != ESP_OK) {
+        return 0;
+    }
+    FILE* file = fopen(RECORDER_FILE_PATH, "rb");
+    if (file) {
+        if (fseek(file, 0, SEEK_END) == 0) {
+            long size = ftell(file);
+            used -= size > 0 && (size_t)size <= used ? (size_t)size : 0;  // Its own space is free to it
+        }
+        fclose(file);
+    }
+    size_t free = total > used + RECORDER_SPIFFS_RESERVE ? total - used - RECORDER_SPIFFS_RESERVE : 0;
+    size_t blocks = free / VOICE_RECORDER_BLOCK_SIZE;
+    return blocks < RECORDER_BLOCKS ? blocks : RECORDER_BLOCKS;
+}
+
+static bool open_recorder(void) {
+    if (!mount_storage()) {
+        return false;
+    }
+    size_t blocks = ring_blocks();
+    if (blocks < RECORDER_MIN_BLOCKS) {
+        ESP_LOGE(RECORDER_TAG, "Not enough storage for the recorder (%u blocks)", (unsigned)blocks);
+        return false;
+    }
+    if (!s_storage.open(blocks)) {
+        ESP_LOGE(RECORDER_TAG, "Cannot open %s", RECORDER_FILE_PATH);
+        return false;
+    }
+    VoiceRecorder* recorder = new (std::nothrow) VoiceRecorder(&s_storage, voice_recorder_default_config());
+    if (!recorder) {
+        ESP_LOGE(RECORDER_TAG, "Out of memory");
+        return false;
+    }
+    size_t found = recorder->load();
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_recorder = recorder;
+    xSemaphoreGive(s_mutex);
+    ESP_LOGI(RECORDER_TAG, "Recorder ready: %u KB ring, %u transmissions kept",
+             (unsigned)(blocks * VOICE_RECORDER_BLOCK_SIZE / 1024), (unsigned)found);
+    return true;
+}
+
+// ============================================================================
+// TASK
+// ============================================================================
+
+static void drain_capture(void) {
+    static uint8_t frame[RECORDER_CAPTURE_HEAD_SIZE + VOICE_RECORDER_TALKER_LEN + VOICE_RECORDER_MAX_FRAME];
+    for (FrameRing* ring : s_captureRings) {
+        size_t length;
+        while ((length = ring->pop(frame, sizeof(frame))) > 0) {
+            size_t talkerLength = frame[2];
+            size_t head = RECORDER_CAPTURE_HEAD_SIZE + talkerLength;
+            if (length <= head) {
+                continue;
+            }
+            uint32_t capturedMs, epochS;
+            memcpy(&capturedMs, frame + 3, sizeof(capturedMs));
+            memcpy(&epochS, frame + 7, sizeof(epochS));
+            std::string talker((const char*)frame + RECORDER_CAPTURE_HEAD_SIZE, talkerLength);
+            s_recorder->addFrame(frame[0], frame[1], talker, capturedMs, epochS, frame + head, length - head);
+        }
+    }
+}
+
+// Read the replay ahead until its ring is full
+static void fill_replay(void) {
+    while (s_recorder->replaying() || s_replayPending) {
+        if (!s_replayPending) {
+            uint32_t generation = s_replayGeneration.load();
+            size_t length = s_recorder->nextReplayFrame(s_replayFrame + RECORDER_REPLAY_HEAD_SIZE,
+                                                        VOICE_RECORDER_MAX_FRAME, NULL);
+            if (!length) {
+                break;
+            }
+            memcpy(s_replayFrame, &generation, sizeof(generation));
+            s_replayPending = RECORDER_REPLAY_HEAD_SIZE + length;
+        }
+        if (!s_replayRing->push(s_replayFrame, s_replayPending, NULL, 0)) {
+            break;
+        }
+        s_replayPending = 0;
+    }
+}
+
+static void publish_metrics(void) {
+    const voice_recorder_stats_t& stats = s_recorder->stats();
+    uint32_t dropped = s_dropped.load();
+    metrics_counter_add(METRIC_RECORDER_VOICE_BYTES, stats.voice_bytes - s_published.voice_bytes);
+    metrics_counter_add(METRIC_RECORDER_FLASH_BYTES, stats.flash_bytes - s_published.flash_bytes);
+    metrics_counter_add(METRIC_RECORDER_DROPPED, dropped - s_publishedDropped);
+    s_published = stats;
+    s_publishedDropped = dropped;
+}
+
+static void recorder_task(void* pvParameters) {
+    if (!open_recorder()) {
+        ESP_LOGE(RECORDER_TAG, "Recorder disabled");
+        vTaskDelete(NULL);
+        return;
+    }
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(RECORDER_SERVICE_TICK_MS));
+        if (xSemaphoreTake(s_mutex, RECORDER_MUTEX_TIMEOUT) != pdTRUE) {
+            continue;
+        }
+        drain_capture();
+        s_recorder->tick(now_ms());
+        fill_replay();
+        s_replayingId.store(s_recorder->replayId());
+        publish_metrics();
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int recorder_service_init(void) {
+    if (s_mutex) {
+        return 0;
+    }
+    s_mutex = xSemaphoreCreateMutex();
+    for (FrameRing*& ring : s_captureRings) {
+        ring = new (std::nothrow) FrameRing(RECORDER_CAPTURE_RING_SIZE);
+    }
+    s_replayRing = new (std::nothrow) FrameRing(RECORDER_REPLAY_RING_SIZE);
+    bool rings = s_captureRings[0] && s_captureRings[0]->valid() && s_captureRings[1] && s_captureRings[1]->valid();
+    if (!s_mutex || !rings || !s_replayRing || !s_replayRing->valid()) {
+        ESP_LOGE(RECORDER_TAG, "Out of memory");
+        return -1;
+    }
+    if (xTaskCreatePinnedToCore(recorder_task, "Recorder", RECORDER_SERVICE_TASK_STACK_SIZE, NULL,
+                                RECORDER_SERVICE_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        ESP_LOGE(RECORDER_TAG, "Failed to create recorder task");
+        return -1;
+    }
+    return 0;
+}
+
+void recorder_service_capture(uint8_t direction, uint8_t group, const char* talker, const uint8_t* frame,
+                              size_t length) {
+    FrameRing* ring = direction < 2 ? s_captureRings[direction] : nullptr;
+    if (!ring || !length) {
+        return;
+    }
+    uint8_t head[RECORDER_CAPTURE_HEAD_SIZE + VOICE_RECORDER_TALKER_LEN];
+    size_t talkerLength = talker ? strnlen(talker, VOICE_RECORDER_TALKER_LEN - 1) : 0;
+    uint32_t capturedMs = now_ms();
+    uint32_t epochS = (uint32_t)time(NULL);
+    head[0] = direction;
+    head[1] = group;
+    head[2] = (uint8_t)talkerLength;
+    memcpy(head + 3, &capturedMs, sizeof(capturedMs));
+    memcpy(head + 7, &epochS, sizeof(epochS));
+    memcpy(head + RECORDER_CAPTURE_HEAD_SIZE, talker, talkerLength);
+    if (!ring->push(head, RECORDER_CAPTURE_HEAD_SIZE + talkerLength, frame, length)) {
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t recorder_service_replay_frame(uint8_t* out, size_t capacity) {
+    if (!s_replayRing) {
+        return 0;
+    }
+    uint8_t frame[RECORDER_REPLAY_HEAD_SIZE + VOICE_RECORDER_MAX_FRAME];
+    size_t length;
+    while ((length = s_replayRing->pop(frame, sizeof(frame))) > 0) {
+        uint32_t generation;
+        memcpy(&generation, frame, sizeof(generation));
+        if (generation != s_replayGeneration.load() || length - RECORDER_REPLAY_HEAD_SIZE > capacity) {
+            continue;                       // From a replay since stopped
+        }
+        memcpy(out, frame + RECORDER_REPLAY_HEAD_SIZE, length - RECORDER_REPLAY_HEAD_SIZE);
+        return length - RECORDER_REPLAY_HEAD_SIZE;
+    }
+    return 0;
+}
+
+size_t recorder_service_list(voice_transmission_t* out, size_t max) {
+    if (!s_mutex || !out || xSemaphoreTake(s_mutex, RECORDER_MUTEX_TIMEOUT) != pdTRUE) {
+        return 0;
+    }
+    size_t count = s_recorder ? s_recorder->recent(out, max) : 0;
+    xSemaphoreGive(s_mutex);
+    return count;
+}
+
+bool recorder_service_replay(uint32_t id) {
+    if (!s_mutex || xSemaphoreTake(s_mutex, RECORDER_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    s_replayGeneration.fetch_add(1);
+    s_replayPending = 0;
+    bool started = s_recorder && s_recorder->startReplay(id);
+    s_replayingId.store(started ? id : 0);
+    xSemaphoreGive(s_mutex);
+    return started;
+}
+
+void recorder_service_stop_replay(void) {
+    if (!s_mutex || xSemaphoreTake(s_mutex, RECORDER_MUTEX_TIMEOUT) != pdTRUE) {
+        return;
+    }
+    s_replayGeneration.fetch_add(1);
+    s_replayPending = 0;
+    if (s_recorder) {
+        s_recorder->stopReplay();
+    }
+    s_replayingId.store(0);
+    xSemaphoreGive(s_mutex);
+}
+
+uint32_t recorder_service_replaying(void) {
+    return s_replayingId.load();
+}
+
+bool recorder_service_get_stats(voice_recorder_stats_t* stats, uint32_t* dropped) {
+    if (!s_mutex || !stats || xSemaphoreTake(s_mutex, RECORDER_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool running = s_recorder != nullptr;
+    if (running) {
+        *stats = s_recorder->stats();
+        if (dropped) {
+            *dropped = s_dropped.load();
+        }
+    }
+    xSemaphoreGive(s_mutex);
+    return running;
+}
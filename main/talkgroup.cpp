@@ -0,0 +1,399 @@
+/**
+ * @file talkgroup.cpp
+ * @brief Talkgroups: group-addressed voice and position data
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/talkgroup.h"
+#include "include/config.h"
+#include "include/metrics_registry.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <atomic>
+#include <map>
+#include <string.h>
+
+static const char* TALKGROUP_TAG = "TALKGROUP";
+
+// Header: magic (2 bytes), version (high nibble) and kind (low nibble), group
+#define TALKGROUP_MAGIC_0 0xA7
+#define TALKGROUP_MAGIC_1 0x47
+#define TALKGROUP_VERSION 2
+#define TALKGROUP_NVS_NAMESPACE "aircom_tg"
+
+typedef struct {
+    uint8_t members[TALKGROUP_BITMAP_SIZE];
+    uint32_t last_seen_ms;
+} talkgroup_peer_t;
+
+// This node's groups. Read on every received frame, so kept as words that
+// can be tested without the mutex; written under it.
+static std::atomic<uint32_t> s_members[TALKGROUP_COUNT / 32];
+static std::atomic<uint8_t> s_txGroup(TALKGROUP_ALL);
+
+static SemaphoreHandle_t s_mutex = nullptr;
+static std::map<std::string, talkgroup_peer_t> s_peers;     // Under s_mutex
+static std::atomic<bool> s_peersComplete(false);            // Every reachable peer has announced
+static uint32_t s_nextAnnounceMs = 0;                        // Under s_mutex
+static uint32_t s_dirtyMs = 0;                               // Under s_mutex; 0 when saved
+
+static std::atomic<uint32_t> s_rxAccepted(0);
+static std::atomic<uint32_t> s_rxDropped(0);
+static std::atomic<uint32_t> s_txMulticast(0);
+static std::atomic<uint32_t> s_txUnicast(0);
+static std::atomic<uint32_t> s_txSuppressed(0);
+static std::atomic<uint32_t> s_announcesSent(0);
+static std::atomic<uint32_t> s_announcesReceived(0);
+
+static talkgroup_stats_t s_published = {};                 // Counters last added to the metrics
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static bool has_magic(const uint8_t* frame) {
+    return frame[0] == TALKGROUP_MAGIC_0 && frame[1] == TALKGROUP_MAGIC_1;
+}
+
+static bool bitmap_test(const uint8_t* bitmap, uint8_t group) {
+    return (bitmap[group >> 3] >> (group & 7)) & 1;
+}
+
+static void members_snapshot(uint8_t* bitmap) {
+    for (size_t word = 0; word < TALKGROUP_COUNT / 32; word++) {
+        uint32_t bits = s_members[word].load(std::memory_order_relaxed);
+        for (size_t byte = 0; byte < 4; byte++) {
+            bitmap[word * 4 + byte] = (uint8_t)(bits >> (byte * 8));
+        }
+    }
+}
+
+static void set_member(uint8_t group, bool member) {
+    uint32_t mask = 1u << (group & 31);
+    if (member) {
+        s_members[group >> 5].fetch_or(mask, std::memory_order_relaxed);
+    } else {
+        s_members[group >> 5].fetch_and(~mask, std::memory_order_relaxed);
+    }
+}
+
+// ============================================================================
+// PERSISTENCE
+// ============================================================================
+
+static void load_memberships(void) {
+    nvs_handle_t handle;
+    if (nvs_open(TALKGROUP_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;                             // Nothing saved yet
+    }
+    uint8_t bitmap[TALKGROUP_BITMAP_SIZE];
+    size_t length = sizeof(bitmap);
+    if (nvs_get_blob(handle, "members", bitmap, &length) == ESP_OK && length == sizeof(bitmap)) {
+        for (size_t group = 0; group < TALKGROUP_COUNT; group++) {
+            set_member((uint8_t)group, bitmap_test(bitmap, (uint8_t)group));
+        }
+    }
+    uint8_t tx = TALKGROUP_ALL;
+    if (nvs_get_u8(handle, "tx", &tx) == ESP_OK) {
+        s_txGroup.store(tx);
+        set_member(tx, true);
+    }
+    nvs_close(handle);
+    set_member(TALKGROUP_ALL, true);
+}
+
+static void save_memberships(void) {
+    uint8_t bitmap[TALKGROUP_BITMAP_SIZE];
+    members_snapshot(bitmap);
+    nvs_handle_t handle;
+    if (nvs_open(TALKGROUP_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGW(TALKGROUP_TAG, "Could not open NVS to save talkgroups");
+        return;
+    }
+    esp_err_t err = nvs_set_blob(handle, "members", bitmap, sizeof(bitmap));
+    if (err == ESP_OK) {
+        err = nvs_set_u8(handle, "tx", s_txGroup.load());
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TALKGROUP_TAG, "Could not save talkgroups: %s", esp_err_to_name(err));
+    }
+}
+
+// Announce and save shortly after a change; a burst of UI presses costs one of each
+static void membership_changed(void) {
+    if (!s_mutex) {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_dirtyMs = now_ms() | 1;
+    s_nextAnnounceMs = s_dirtyMs + TALKGROUP_ANNOUNCE_DELAY_MS;
+    xSemaphoreGive(s_mutex);
+}
+
+// ============================================================================
+// ANNOUNCEMENTS
+// ============================================================================
+
+static void on_mesh_data(const std::string& peer_id, const std::vector<uint8_t>& data) {
+    if (data.size() != TALKGROUP_HEADER_SIZE + TALKGROUP_BITMAP_SIZE || !has_magic(data.data()) ||
+        data[2] != ((TALKGROUP_VERSION << 4) | TALKGROUP_KIND_ANNOUNCE)) {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    auto it = s_peers.find(peer_id);
+    if (it == s_peers.end() && s_peers.size() >= TALKGROUP_MAX_PEERS) {
+        xSemaphoreGive(s_mutex);
+        return;                             // Treated as unknown: traffic to it is multicast
+    }
+    talkgroup_peer_t& peer = s_peers[peer_id];
+    memcpy(peer.members, data.data() + TALKGROUP_HEADER_SIZE, TALKGROUP_BITMAP_SIZE);
+    peer.last_seen_ms = now_ms();
+    xSemaphoreGive(s_mutex);
+    s_announcesReceived.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void send_announce(void) {
+    uint8_t frame[TALKGROUP_HEADER_SIZE + TALKGROUP_BITMAP_SIZE];
+    talkgroup_write_header(TALKGROUP_KIND_ANNOUNCE, TALKGROUP_ALL, frame, sizeof(frame));
+    members_snapshot(frame + TALKGROUP_HEADER_SIZE);
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+    if (mesh.get_connection_status() && mesh.sendUdpMulticast(frame, sizeof(frame), MESH_DISCOVERY_PORT)) {
+        s_announcesSent.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Only the tick calls this
+static void publish_metrics(void) {
+    talkgroup_stats_t stats;
+    stats.rx_accepted = s_rxAccepted.load();
+    stats.rx_dropped = s_rxDropped.load();
+    stats.tx_multicast = s_txMulticast.load();
+    stats.tx_unicast = s_txUnicast.load();
+    stats.tx_suppressed = s_txSuppressed.load();
+    metrics_counter_add(METRIC_TALKGROUP_RX_ACCEPTED, stats.rx_accepted - s_published.rx_accepted);
+    metrics_counter_add(METRIC_TALKGROUP_RX_DROPPED, stats.rx_dropped - s_published.rx_dropped);
+    metrics_counter_add(METRIC_TALKGROUP_TX_MULTICAST, stats.tx_multicast - s_published.tx_multicast);
+    metrics_counter_add(METRIC_TALKGROUP_TX_UNICAST, stats.tx_unicast - s_published.tx_unicast);
+    metrics_counter_add(METRIC_TALKGROUP_TX_SUPPRESSED, stats.tx_suppressed - s_published.tx_suppressed);
+    s_published = stats;
+}
+
+bool talkgroup_init(void) {
+    if (s_mutex) {
+        return true;
+    }
+    s_mutex = xSemaphoreCreateMutex();
+    if (!s_mutex) {
+        ESP_LOGE(TALKGROUP_TAG, "Failed to create talkgroup mutex");
+        return false;
+    }
+    set_member(TALKGROUP_ALL, true);
+    load_memberships();
+    HaLowMeshManager::getInstance().addDataListener(DataCallback::fromFunction<on_mesh_data>());
+    s_nextAnnounceMs = now_ms() + TALKGROUP_ANNOUNCE_DELAY_MS;
+    ESP_LOGI(TALKGROUP_TAG, "Talkgroups ready, sending on group %u", (unsigned)s_txGroup.load());
+    return true;
+}
+
+void talkgroup_tick(void) {
+    if (!s_mutex) {
+        return;
+    }
+    uint32_t nowMs = now_ms();
+    // Outside the mutex: the radio takes its own
+    std::vector<std::string> reachable = HaLowMeshManager::getInstance().getReachablePeers();
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (auto it = s_peers.begin(); it != s_peers.end();) {
+        if ((int32_t)(nowMs - it->second.last_seen_ms) > TALKGROUP_PEER_TIMEOUT_MS) {
+            it = s_peers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    bool complete = true;
+    for (const std::string& peerId : reachable) {
+        if (s_peers.find(peerId) == s_peers.end()) {
+            complete = false;
+            break;
+        }
+    }
+    s_peersComplete.store(complete);
+
+    bool save = s_dirtyMs != 0 && (int32_t)(nowMs - s_dirtyMs) >= TALKGROUP_ANNOUNCE_DELAY_MS;
+    if (save) {
+        s_dirtyMs = 0;
+    }
+    bool announce = (int32_t)(nowMs - s_nextAnnounceMs) >= 0;
+    if (announce) {
+        s_nextAnnounceMs = nowMs + TALKGROUP_ANNOUNCE_INTERVAL_MS;
+    }
+    xSemaphoreGive(s_mutex);
+
+    if (save) {
+        save_memberships();
+    }
+    if (announce) {
+        send_announce();
+    }
+    publish_metrics();
+}
+
+// ============================================================================
+// MEMBERSHIP
+// ============================================================================
+
+bool talkgroup_join(uint8_t group) {
+    if (!talkgroup_is_member(group)) {
+        set_member(group, true);
+        membership_changed();
+    }
+    return true;
+}
+
+bool talkgroup_leave(uint8_t group) {
+    if (group == TALKGROUP_ALL || group == s_txGroup.load()) {
+        return false;
+    }
+    if (talkgroup_is_member(group)) {
+        set_member(group, false);
+        membership_changed();
+    }
+    return true;
+}
+
+bool talkgroup_set_tx(uint8_t group) {
+    set_member(group, true);
+    if (s_txGroup.exchange(group) != group) {
+        ESP_LOGI(TALKGROUP_TAG, "Sending on group %u", (unsigned)group);
+        membership_changed();
+    }
+    return true;
+}
+
+uint8_t talkgroup_get_tx(void) {
+    return s_txGroup.load();
+}
+
+bool talkgroup_is_member(uint8_t group) {
+    return (s_members[group >> 5].load(std::memory_order_relaxed) >> (group & 31)) & 1;
+}
+
+// ============================================================================
+// FRAMES
+// ============================================================================
+
+const uint8_t* talkgroup_accept(const uint8_t* frame, size_t length, size_t* payload_length) {
+    if (length < TALKGROUP_HEADER_SIZE || !has_magic(frame)) {
+        // No header: all-call from a node without talkgroups
+        s_rxAccepted.fetch_add(1, std::memory_order_relaxed);
+        *payload_length = length;
+        return frame;
+    }
+    if ((frame[2] >> 4) != TALKGROUP_VERSION || (frame[2] & 0x0F) == TALKGROUP_KIND_ANNOUNCE ||
+        !talkgroup_is_member(frame[3])) {
+        s_rxDropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    s_rxAccepted.fetch_add(1, std::memory_order_relaxed);
+    *payload_length = length - TALKGROUP_HEADER_SIZE;
+    return frame + TALKGROUP_HEADER_SIZE;
+}
+
+size_t talkgroup_write_header(uint8_t kind, uint8_t group, uint8_t* out, size_t out_size) {
+    if (out_size < TALKGROUP_HEADER_SIZE || kind > 0x0F) {
+        return 0;
+    }
+    out[0] = TALKGROUP_MAGIC_0;
+    out[1] = TALKGROUP_MAGIC_1;
+    out[2] = (uint8_t)((TALKGROUP_VERSION << 4) | kind);
+    out[3] = group;
+    return TALKGROUP_HEADER_SIZE;
+}
+
+bool talkgroup_send(uint8_t kind, uint8_t* frame, size_t length, uint16_t port) {
+    uint8_t group = s_txGroup.load();
+    if (!talkgroup_write_header(kind, group, frame, length)) {
+        return false;
+    }
+    HaLowMeshManager& mesh = HaLowMeshManager::getInstance();
+
+    std::string members[TALKGROUP_UNICAST_MAX];
+    size_t memberCount = 0;
+    bool many = false;
+    if (group != TALKGROUP_ALL && s_mutex) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        for (const auto& peer : s_peers) {
+            if (bitmap_test(peer.second.members, group)) {
+                if (memberCount == TALKGROUP_UNICAST_MAX) {
+                    many = true;
+                    break;
+                }
+                members[memberCount++] = peer.first;
+            }
+        }
+        xSemaphoreGive(s_mutex);
+    }
+
+    if (group == TALKGROUP_ALL || many || (memberCount == 0 && !s_peersComplete.load())) {
+        // All-call, too many members to send to one by one, or peers
+        // whose groups are not known yet
+        s_txMulticast.fetch_add(1, std::memory_order_relaxed);
+        return mesh.sendUdpMulticast(frame, length, port);
+    }
+    if (memberCount == 0) {
+        s_txSuppressed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    // The mesh routes each copy along the path to that member only
+    bool sent = true;
+    for (size_t i = 0; i < memberCount; i++) {
+        sent = mesh.sendUdpUnicast(members[i], frame, length, port) && sent;
+        s_txUnicast.fetch_add(1, std::memory_order_relaxed);
+    }
+    return sent;
+}
+
+size_t talkgroup_member_count(uint8_t group) {
+    if (!s_mutex) {
+        return 0;
+    }
+    size_t count = 0;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (const auto& peer : s_peers) {
+        count += bitmap_test(peer.second.members, group);
+    }
+    xSemaphoreGive(s_mutex);
+    return count;
+}
+
+bool talkgroup_get_stats(talkgroup_stats_t* stats) {
+    if (!stats) {
+        return false;
+    }
+    stats->rx_accepted = s_rxAccepted.load();
+    stats->rx_dropped = s_rxDropped.load();
+    stats->tx_multicast = s_txMulticast.load();
+    stats->tx_unicast = s_txUnicast.load();
+    stats->tx_suppressed = s_txSuppressed.load();
+    stats->announces_sent = s_announcesSent.load();
+    stats->announces_received = s_announcesReceived.load();
+    stats->known_peers = 0;
+    if (s_mutex) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        stats->known_peers = (uint32_t)s_peers.size();
+        xSemaphoreGive(s_mutex);
+    }
+    return true;
+}
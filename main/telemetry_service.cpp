@@ -0,0 +1,397 @@
+/**
+ * @file telemetry_service.cpp
+ * @brief Per-task CPU, stack, queue depth and heap telemetry
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/telemetry_service.h"
+#include "include/config.h"
+#include "include/metrics_registry.h"
+#include "HaLowManager/include/HaLowMeshManager.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <string.h>
+
+static const char* TELEMETRY_TAG = "TELEMETRY";
+
+#ifndef portNUM_PROCESSORS
+#define portNUM_PROCESSORS 1
+#endif
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+#define TELEMETRY_RUN_TIME_STATS 1
+#else
+#define TELEMETRY_RUN_TIME_STATS 0
+#endif
+
+// System tasks (IDLE, ipc, esp_timer, Wi-Fi, lwIP, ...) are included too
+#define TELEMETRY_STATUS_CAPACITY 48
+#define TELEMETRY_MUTEX_TIMEOUT pdMS_TO_TICKS(100)
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t stack_size;
+} registered_task_t;
+
+typedef struct {
+    char name[TELEMETRY_NAME_LEN];
+    QueueHandle_t queue;
+    uint16_t high_water;
+} registered_queue_t;
+
+static SemaphoreHandle_t s_mutex = NULL;
+static registered_task_t s_tasks[TELEMETRY_MAX_TASKS];
+static uint8_t s_task_count = 0;
+static registered_queue_t s_queues[TELEMETRY_MAX_QUEUES];
+static uint8_t s_queue_count = 0;
+
+static telemetry_snapshot_t s_snapshot;
+static bool s_have_snapshot = false;
+
+#if TELEMETRY_RUN_TIME_STATS
+// Run-time counters from the previous sample, keyed by task number
+typedef struct {
+    UBaseType_t task_number;
+    uint32_t run_time;
+} run_time_entry_t;
+
+static TaskStatus_t s_status[TELEMETRY_STATUS_CAPACITY];
+static run_time_entry_t s_prev_run_time[TELEMETRY_STATUS_CAPACITY];
+static uint8_t s_prev_count = 0;
+static uint32_t s_prev_total_run_time = 0;
+#endif
+
+bool telemetry_init(void) {
+    if (s_mutex) {
+        return true;
+    }
+    s_mutex = xSemaphoreCreateMutex();
+    if (!s_mutex) {
+        ESP_LOGE(TELEMETRY_TAG, "Failed to create telemetry mutex");
+        return false;
+    }
+#if !TELEMETRY_RUN_TIME_STATS
+    ESP_LOGW(TELEMETRY_TAG, "FreeRTOS run-time stats disabled; reporting registered tasks without CPU load");
+#endif
+    return true;
+}
+
+bool telemetry_register_task(TaskHandle_t handle, uint32_t stack_size) {
+    if (!handle || !s_mutex || xSemaphoreTake(s_mutex, TELEMETRY_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool registered = s_task_count < TELEMETRY_MAX_TASKS;
+    if (registered) {
+        s_tasks[s_task_count].handle = handle;
+        s_tasks[s_task_count].stack_size = stack_size;
+        s_task_count++;
+    }
+    xSemaphoreGive(s_mutex);
+    return registered;
+}
+
+bool telemetry_register_queue(const char* name, QueueHandle_t queue) {
+    if (!queue || !name || !s_mutex || xSemaphoreTake(s_mutex, TELEMETRY_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool registered = s_queue_count < TELEMETRY_MAX_QUEUES;
+    if (registered) {
+        registered_queue_t* entry = &s_queues[s_queue_count++];
+        strncpy(entry->name, name, TELEMETRY_NAME_LEN - 1);
+        entry->name[TELEMETRY_NAME_LEN - 1] = '\0';
+        entry->queue = queue;
+        entry->high_water = 0;
+    }
+    xSemaphoreGive(s_mutex);
+    return registered;
+}
+
+static uint32_t registered_stack_size(TaskHandle_t handle) {
+    for (uint8_t i = 0; i < s_task_count; i++) {
+        if (s_tasks[i].handle == handle) {
+            return s_tasks[i].stack_size;
+        }
+    }
+    return 0;
+}
+
+static void copy_name(char* dest, const char* src) {
+    strncpy(dest, src ? src : "?", TELEMETRY_NAME_LEN - 1);
+    dest[TELEMETRY_NAME_LEN - 1] = '\0';
+}
+
+#if TELEMETRY_RUN_TIME_STATS
+static void sample_tasks(telemetry_snapshot_t* snapshot) {
+    uint32_t total_run_time = 0;
+    UBaseType_t count = uxTaskGetSystemState(s_status, TELEMETRY_STATUS_CAPACITY, &total_run_time);
+    if (count == 0) {
+        ESP_LOGW(TELEMETRY_TAG, "More than %d tasks, raise TELEMETRY_STATUS_CAPACITY", TELEMETRY_STATUS_CAPACITY);
+        snapshot->task_count = 0;
+        return;
+    }
+
+    // Run time is counted on one time base shared by all cores
+    uint64_t capacity = (uint64_t)(uint32_t)(total_run_time - s_prev_total_run_time) * portNUM_PROCESSORS;
+    bool first_sample = s_prev_total_run_time == 0;
+    uint32_t idle_permille = 0;
+
+    run_time_entry_t current[TELEMETRY_STATUS_CAPACITY];
+    uint16_t cpu_permille[TELEMETRY_STATUS_CAPACITY];
+    uint8_t order[TELEMETRY_STATUS_CAPACITY];
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t& status = s_status[i];
+        uint32_t run_time = (uint32_t)status.ulRunTimeCounter;
+        current[i].task_number = status.xTaskNumber;
+        current[i].run_time = run_time;
+
+        uint32_t previous = run_time;
+        if (!first_sample) {
+            previous = 0;   // Task created since the last sample
+            for (uint8_t p = 0; p < s_prev_count; p++) {
+                if (s_prev_run_time[p].task_number == status.xTaskNumber) {
+                    previous = s_prev_run_time[p].run_time;
+                    break;
+                }
+            }
+        }
+        uint32_t permille = capacity ? (uint32_t)((uint64_t)(run_time - previous) * 1000 / capacity) : 0;
+        permille = std::min<uint32_t>(permille, 1000);
+
+        if (strncmp(status.pcTaskName, "IDLE", 4) == 0) {
+            idle_permille += permille;
+        }
+
+        cpu_permille[i] = (uint16_t)permille;
+        order[i] = (uint8_t)i;
+    }
+
+    memcpy(s_prev_run_time, current, count * sizeof(run_time_entry_t));
+    s_prev_count = (uint8_t)count;
+    s_prev_total_run_time = total_run_time;
+
+    // Busiest tasks first, ranked over every task in the system before the
+    // list is cut to fit, so a busy task late in the status array is kept
+    UBaseType_t kept = std::min<UBaseType_t>(count, TELEMETRY_MAX_TASKS);
+    std::partial_sort(order, order + kept, order + count,
+                      [&cpu_permille](uint8_t a, uint8_t b) {
+                          return cpu_permille[a] > cpu_permille[b];
+                      });
+
+    for (UBaseType_t i = 0; i < kept; i++) {
+        const TaskStatus_t& status = s_status[order[i]];
+        telemetry_task_t* task = &snapshot->tasks[i];
+        copy_name(task->name, status.pcTaskName);
+        task->priority = (uint8_t)status.uxCurrentPriority;
+#if configTASKLIST_INCLUDE_COREID
+        task->core = status.xCoreID == tskNO_AFFINITY ? -1 : (int8_t)status.xCoreID;
+#else
+        task->core = -1;
+#endif
+        task->cpu_permille = cpu_permille[order[i]];
+        // ESP-IDF counts stack in bytes
+        task->stack_free_min = status.usStackHighWaterMark;
+        task->stack_size = registered_stack_size(status.xHandle);
+    }
+
+    snapshot->task_count = (uint8_t)kept;
+    snapshot->idle_permille = (uint16_t)std::min<uint32_t>(idle_permille, 1000);
+}
+#else
+static void sample_tasks(telemetry_snapshot_t* snapshot) {
+    for (uint8_t i = 0; i < s_task_count; i++) {
+        telemetry_task_t* task = &snapshot->tasks[i];
+        copy_name(task->name, pcTaskGetName(s_tasks[i].handle));
+        task->priority = (uint8_t)uxTaskPriorityGet(s_tasks[i].handle);
+        task->core = -1;
+        task->cpu_permille = 0;
+        task->stack_free_min = uxTaskGetStackHighWaterMark(s_tasks[i].handle);
+        task->stack_size = s_tasks[i].stack_size;
+    }
+    snapshot->task_count = s_task_count;
+    snapshot->idle_permille = 0;
+}
+#endif
+
+void telemetry_sample(void) {
+    if (!s_mutex || xSemaphoreTake(s_mutex, TELEMETRY_MUTEX_TIMEOUT) != pdTRUE) {
+        return;
+    }
+
+    telemetry_snapshot_t* snapshot = &s_snapshot;
+    snapshot->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    snapshot->free_heap = esp_get_free_heap_size();
+    snapshot->min_free_heap = esp_get_minimum_free_heap_size();
+    snapshot->largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    sample_tasks(snapshot);
+
+    for (uint8_t i = 0; i < s_queue_count; i++) {
+        registered_queue_t* entry = &s_queues[i];
+        telemetry_queue_t* queue = &snapshot->queues[i];
+        UBaseType_t waiting = uxQueueMessagesWaiting(entry->queue);
+        entry->high_water = std::max<uint16_t>(entry->high_water, (uint16_t)waiting);
+
+        memcpy(queue->name, entry->name, TELEMETRY_NAME_LEN);
+        queue->waiting = (uint16_t)waiting;
+        queue->capacity = (uint16_t)(waiting + uxQueueSpacesAvailable(entry->queue));
+        queue->high_water = entry->high_water;
+    }
+    snapshot->queue_count = s_queue_count;
+
+    s_have_snapshot = true;
+    xSemaphoreGive(s_mutex);
+}
+
+bool telemetry_get_snapshot(telemetry_snapshot_t* snapshot) {
+    if (!snapshot || !s_mutex || xSemaphoreTake(s_mutex, TELEMETRY_MUTEX_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool available = s_have_snapshot;
+    if (available) {
+        *snapshot = s_snapshot;
+    }
+    xSemaphoreGive(s_mutex);
+    return available;
+}
+
+static size_t put_u8(uint8_t* buffer, size_t offset, uint8_t value) {
+    buffer[offset] = value;
+    return offset + 1;
+}
+
+static size_t put_u16(uint8_t* buffer, size_t offset, uint32_t value) {
+    value = std::min<uint32_t>(value, 0xFFFF);
+    buffer[offset] = (uint8_t)value;
+    buffer[offset + 1] = (uint8_t)(value >> 8);
+    return offset + 2;
+}
+
+static size_t put_u32(uint8_t* buffer, size_t offset, uint32_t value) {
+    offset = put_u16(buffer, offset, value & 0xFFFF);
+    return put_u16(buffer, offset, value >> 16);
+}
+
+static size_t put_name(uint8_t* buffer, size_t offset, const char* name) {
+    size_t length = strnlen(name, TELEMETRY_NAME_LEN - 1);
+    offset = put_u8(buffer, offset, (uint8_t)length);
+    memcpy(buffer + offset, name, length);
+    return offset + length;
+}
+
+size_t telemetry_encode(const telemetry_snapshot_t* snapshot, uint8_t* buffer, size_t buffer_size) {
+    if (!snapshot || !buffer || buffer_size < TELEMETRY_MAX_ENCODED_SIZE) {
+        return 0;
+    }
+
+    size_t offset = 0;
+    offset = put_u8(buffer, offset, 'T');
+    offset = put_u8(buffer, offset, 'M');
+    offset = put_u8(buffer, offset, TELEMETRY_FORMAT_VERSION);
+    offset = put_u32(buffer, offset, snapshot->uptime_s);
+    offset = put_u32(buffer, offset, snapshot->free_heap);
+    offset = put_u32(buffer, offset, snapshot->min_free_heap);
+    offset = put_u32(buffer, offset, snapshot->largest_free_block);
+    offset = put_u16(buffer, offset, snapshot->idle_permille);
+    offset = put_u8(buffer, offset, snapshot->task_count);
+    offset = put_u8(buffer, offset, snapshot->queue_count);
+
+    for (uint8_t i = 0; i < snapshot->task_count; i++) {
+        const telemetry_task_t* task = &snapshot->tasks[i];
+        offset = put_name(buffer, offset, task->name);
+        offset = put_u8(buffer, offset, task->priority);
+        offset = put_u8(buffer, offset, (uint8_t)task->core);
+        offset = put_u16(buffer, offset, task->cpu_permille);
+        offset = put_u16(buffer, offset, task->stack_free_min);
+        offset = put_u16(buffer, offset, task->stack_size);
+    }
+
+    for (uint8_t i = 0; i < snapshot->queue_count; i++) {
+        const telemetry_queue_t* queue = &snapshot->queues[i];
+        offset = put_name(buffer, offset, queue->name);
+        offset = put_u16(buffer, offset, queue->waiting);
+        offset = put_u16(buffer, offset, queue->capacity);
+        offset = put_u16(buffer, offset, queue->high_water);
+    }
+
+    return offset;
+}
+
+void telemetry_log_snapshot(void) {
+    static telemetry_snapshot_t snapshot;
+    if (!telemetry_get_snapshot(&snapshot)) {
+        return;
+    }
+
+    ESP_LOGI(TELEMETRY_TAG, "Uptime %us, heap free %u (min %u, largest block %u), idle %u.%u%%",
+             (unsigned)snapshot.uptime_s, (unsigned)snapshot.free_heap, (unsigned)snapshot.min_free_heap,
+             (unsigned)snapshot.largest_free_block,
+             snapshot.idle_permille / 10, snapshot.idle_permille % 10);
+
+    for (uint8_t i = 0; i < snapshot.task_count; i++) {
+        const telemetry_task_t& task = snapshot.tasks[i];
+        if (task.stack_size) {
+            ESP_LOGI(TELEMETRY_TAG, "  %-15s prio %2u core %2d cpu %3u.%u%% stack %u/%u used",
+                     task.name, task.priority, task.core, task.cpu_permille / 10, task.cpu_permille % 10,
+                     (unsigned)(task.stack_size - std::min(task.stack_free_min, task.stack_size)),
+                     (unsigned)task.stack_size);
+        } else {
+            ESP_LOGI(TELEMETRY_TAG, "  %-15s prio %2u core %2d cpu %3u.%u%% stack %u free",
+                     task.name, task.priority, task.core, task.cpu_permille / 10, task.cpu_permille % 10,
+                     (unsigned)task.stack_free_min);
+        }
+    }
+
+    for (uint8_t i = 0; i < snapshot.queue_count; i++) {
+        const telemetry_queue_t& queue = snapshot.queues[i];
+        ESP_LOGI(TELEMETRY_TAG, "  queue %-15s %u/%u (peak %u)",
+                 queue.name, queue.waiting, queue.capacity, queue.high_water);
+    }
+}
+
+void telemetry_task(void* pvParameters) {
+    static telemetry_snapshot_t snapshot;
+    static uint8_t packet[TELEMETRY_MAX_ENCODED_SIZE];
+    static metrics_snapshot_t metrics;
+    static uint8_t metricsPacket[METRICS_MAX_ENCODED_SIZE];
+
+    ESP_LOGI(TELEMETRY_TAG, "Telemetry task started");
+    telemetry_sample();     // Baseline for the first CPU figures
+
+    TickType_t lastPublish = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_SAMPLE_INTERVAL_MS));
+        telemetry_sample();
+
+        if (xTaskGetTickCount() - lastPublish < pdMS_TO_TICKS(TELEMETRY_MESH_INTERVAL_MS)) {
+            continue;
+        }
+        lastPublish = xTaskGetTickCount();
+
+        telemetry_log_snapshot();
+        metrics_log();
+
+        // Stale telemetry is not worth caching while the mesh is down
+        HaLowMeshManager& meshManager = HaLowMeshManager::getInstance();
+        if (!meshManager.get_connection_status() || !telemetry_get_snapshot(&snapshot)) {
+            continue;
+        }
+        size_t length = telemetry_encode(&snapshot, packet, sizeof(packet));
+        if (length > 0) {
+            meshManager.sendUdpMulticast(packet, length, TELEMETRY_PORT);
+        }
+
+        // Registry metrics share the port; receivers tell them apart by magic
+        metrics_snapshot(&metrics);
+        length = metrics_encode(&metrics, metricsPacket, sizeof(metricsPacket));
+        if (length > 0) {
+            meshManager.sendUdpMulticast(metricsPacket, length, TELEMETRY_PORT);
+        }
+    }
+}
@@ -1,12 +1,23 @@
 #include "include/ui_task.h"
 #include "include/config.h"
+#include "include/board_profile.h"
 #include "include/button_handler.h"
 #include "include/shared_data.h"
 #include "include/gps_task.h"
+#include "include/metrics_registry.h"
+#include "include/talkgroup.h"
+#include "include/floor_service.h"
+#include "include/recorder_service.h"
+#include "include/history_service.h"
+#include "include/power_service.h"
+#include "include/battery_service.h"
+#include "include/boot_sequence.h"
 #include "bt_audio.h"
 #include "esp_log.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
+#include <string.h>
+#include <time.h>
 
 // U8g2 C-style includes
 #include "u8g2.h"
@@ -22,6 +33,8 @@ typedef enum {
     UI_STATE_CHAT,
     UI_STATE_MAP,
     UI_STATE_BLUETOOTH,
+    UI_STATE_TALKGROUP,
+    UI_STATE_REPLAY,
     // Add other states like settings, etc.
 } ui_state_t;
 
@@ -29,6 +42,8 @@ static u8g2_t u8g2; // a structure which contains all the data for one display
 static ui_state_t current_ui_state = UI_STATE_MAIN;
 static int selected_contact_index = 0;
 static int selected_bt_menu_index = 0;
+static int selected_talkgroup = 0;
+static int selected_replay = 0;
 static std::string selected_contact_callsign = "";
 
 // Text entry variables
@@ -40,7 +55,26 @@ static int current_char_index = 0;
 // Static variables to hold the data for the UI
 static bool gps_lock_status = false;
 static uint8_t team_contact_count = 0;
-static std::vector<incoming_message_t> message_history;
+static floor_status_t floor_status = {};
+static bool ptt_via_floor = false; // The press went to floor control, so must the release
+static bool back_armed = false;    // BACK went down on the main screen
+static bool back_held = false;     // ... and was held long enough to toggle the status
+
+#define UI_REPLAY_ENTRIES 16
+#define UI_REPLAY_ROWS 3
+#define UI_REPLAY_POLL_MS 500
+static voice_transmission_t replay_list[UI_REPLAY_ENTRIES];
+static size_t replay_count = 0;
+static uint32_t replaying_id = 0;
+
+// The chat screen shows one page of the conversation, read from flash when it changes
+#define UI_CHAT_ROWS 3
+static history_message_t chat_page[UI_CHAT_ROWS];
+static size_t chat_page_count = 0;
+static size_t chat_skip = 0;               // Newer messages scrolled past
+
+// Bluetooth starts on the first scan; the controller and HFP take up to a second
+#define UI_BT_START_TIMEOUT_MS 3000
 
 // UI timing configuration for optimized responsiveness
 #define UI_TARGET_FRAME_RATE 30  // Reduced from 50fps to 30fps for better performance
@@ -48,6 +82,11 @@ static std::vector<incoming_message_t> message_history;
 #define UI_MAX_FRAME_TIME_MS 50  // Maximum time allowed for one frame
 #define UI_INPUT_PROCESSING_MS 2 // Dedicated time for input processing
 
+// Read the page of the open conversation and count it as read
+static void load_chat_page() {
+    chat_page_count = history_service_page(selected_contact_callsign.c_str(), chat_skip, chat_page, UI_CHAT_ROWS);
+    history_service_mark_read(selected_contact_callsign.c_str());
+}
 
 // Placeholder drawing functions for each state
 static void drawMainScreen() {
@@ -55,18 +94,112 @@ static void drawMainScreen() {
     u8g2_SetFont(&u8g2, u8g2_font_ncenB08_tr);
     u8g2_DrawStr(&u8g2, 0, 12, "Callsign: " CALLSIGN);
 
-    sprintf(buf, "Teammates: %d", team_contact_count);
+    // While the floor is in use it takes the teammates line
+    switch (floor_status.state) {
+        case FLOOR_STATE_BUSY:
+            snprintf(buf, sizeof(buf), "Busy: %s", floor_status.talker);
+            break;
+        case FLOOR_STATE_REQUESTING:
+            snprintf(buf, sizeof(buf), "Requesting...");
+            break;
+        case FLOOR_STATE_QUEUED:
+            if (floor_status.queue_position) {
+                snprintf(buf, sizeof(buf), "Queued #%u", (unsigned)floor_status.queue_position);
+            } else {
+                snprintf(buf, sizeof(buf), "Queued");
+            }
+            break;
+        case FLOOR_STATE_GRANTED:
+            snprintf(buf, sizeof(buf), "Your turn: press PTT");
+            break;
+        case FLOOR_STATE_TALKING:
+            snprintf(buf, sizeof(buf), "TX");
+            break;
+        default:
+            snprintf(buf, sizeof(buf), "Teammates: %d", team_contact_count);
+            break;
+    }
     u8g2_DrawStr(&u8g2, 0, 24, buf);
 
     sprintf(buf, "GPS: %s", gps_lock_status ? "Locked" : "No Lock");
     u8g2_DrawStr(&u8g2, 0, 36, buf);
 
+    battery_status_t battery;
+    if (battery_service_get_status(&battery)) {
+        snprintf(buf, sizeof(buf), "%s%.0f%%", battery.level == BATTERY_LEVEL_NORMAL ? "" : "!",
+                 battery.percent);
+        u8g2_DrawStr(&u8g2, 96, 36, buf);
+    }
+
     HaLowMeshManager& meshManager = HaLowMeshManager::getInstance();
     bool isConnected = meshManager.get_connection_status();
     sprintf(buf, "Status: %s", isConnected ? "Online" : "Offline");
     u8g2_DrawStr(&u8g2, 0, 48, buf);
 
-    u8g2_DrawStr(&u8g2, 0, 60, "v Sel| ^ BT| < Status");
+    sprintf(buf, "TG %u", (unsigned)talkgroup_get_tx());
+    u8g2_DrawStr(&u8g2, 90, 48, buf);
+
+    u8g2_DrawStr(&u8g2, 0, 60, "Sel Con|^BT|vTG|<Rec");
+}
+
+#define UI_TALKGROUP_ROWS 3
+
+// Each group is off, monitored (RX) or the one we talk on (TX)
+static void drawTalkgroupScreen() {
+    char buf[30];
+    u8g2_SetFont(&u8g2, u8g2_font_ncenB08_tr);
+    u8g2_DrawStr(&u8g2, 10, 10, "--- Talkgroups ---");
+
+    int first = selected_talkgroup - UI_TALKGROUP_ROWS + 1;
+    if (first < 0) first = 0;
+    for (int row = 0; row < UI_TALKGROUP_ROWS; ++row) {
+        int group = first + row;
+        const char* mode = group == talkgroup_get_tx() ? "TX"
+                         : talkgroup_is_member(group) ? "RX" : "-";
+        if (group == TALKGROUP_ALL) {
+            sprintf(buf, "All call    %s", mode);
+        } else {
+            sprintf(buf, "Group %-2d    %s  (%u)", group, mode, (unsigned)talkgroup_member_count(group));
+        }
+        if (group == selected_talkgroup) {
+            u8g2_DrawStr(&u8g2, 0, 22 + row * 12, ">");
+        }
+        u8g2_DrawStr(&u8g2, 10, 22 + row * 12, buf);
+    }
+
+    u8g2_DrawStr(&u8g2, 0, 60, "Sel Mode| < Back");
+}
+
+// Newest transmission first; the one playing is marked
+static void drawReplayScreen() {
+    char buf[32];
+    u8g2_SetFont(&u8g2, u8g2_font_ncenB08_tr);
+    u8g2_DrawStr(&u8g2, 10, 10, "--- Replay ---");
+
+    if (replay_count == 0) {
+        u8g2_DrawStr(&u8g2, 10, 34, "No recordings");
+    }
+    int first = selected_replay - UI_REPLAY_ROWS + 1;
+    if (first < 0) first = 0;
+    for (int row = 0; row < UI_REPLAY_ROWS && (size_t)(first + row) < replay_count; ++row) {
+        const voice_transmission_t& entry = replay_list[first + row];
+        char when[8] = "--:--";
+        time_t start = (time_t)entry.epoch_s;
+        struct tm local;
+        if (start > 1600000000 && localtime_r(&start, &local)) { // Clock was set
+            strftime(when, sizeof(when), "%H:%M", &local);
+        }
+        snprintf(buf, sizeof(buf), "%s %.15s %lus", when, entry.talker[0] ? entry.talker : "Me",
+                 (unsigned long)((entry.duration_ms + 999) / 1000));
+        if (first + row == selected_replay) {
+            u8g2_DrawStr(&u8g2, 0, 22 + row * 12, entry.id == replaying_id ? "*" : ">");
+        } else if (entry.id == replaying_id) {
+            u8g2_DrawStr(&u8g2, 0, 22 + row * 12, "*");
+        }
+        u8g2_DrawStr(&u8g2, 8, 22 + row * 12, buf);
+    }
+
+    u8g2_DrawStr(&u8g2, 0, 60, replaying_id ? "Sel Stop| < Back" : "Sel Play| < Back");
 }
 
 static void drawBluetoothScreen() {
@@ -105,6 +238,11 @@ static void drawContactsScreen() {
                     u8g2_DrawStr(&u8g2, 0, 22 + i * 12, ">");
                 }
                 u8g2_DrawStr(&u8g2, 10, 22 + i * 12, g_contact_list[i].callsign.c_str());
+                if (g_contact_list[i].battery_level >= 0) {
+                    char battery[8];
+                    snprintf(battery, sizeof(battery), "%d%%", g_contact_list[i].battery_level);
+                    u8g2_DrawStr(&u8g2, 100, 22 + i * 12, battery);
+                }
             }
         }
         xSemaphoreGive(g_contact_list_mutex);
@@ -121,9 +259,11 @@ static void drawChatScreen() {
     u8g2_SetFont(&u8g2, u8g2_font_ncenB08_tr);
     u8g2_DrawStr(&u8g2, 0, 10, buf);
 
-    // Display message history
-    for (size_t i = 0; i < message_history.size(); ++i) {
-        u8g2_DrawStr(&u8g2, 0, 22 + i * 10, message_history[i].message_text.c_str());
+    // Conversation page, oldest at the top; own messages are marked
+    for (size_t i = 0; i < chat_page_count; ++i) {
+        const history_message_t& message = chat_page[chat_page_count - 1 - i];
+        snprintf(buf, sizeof(buf), "%s%s", message.direction == HISTORY_DIRECTION_TX ? ">" : "", message.text);
+        u8g2_DrawStr(&u8g2, 0, 22 + i * 10, buf);
     }
 
     // Draw the new message being composed
@@ -176,8 +316,8 @@ void uiTask(void *pvParameters) {
 
     // 1. Initialize the U8g2 HAL
     u8g2_esp32_hal_t u8g2_esp32_hal = U8G2_ESP32_HAL_DEFAULT;
-    u8g2_esp32_hal.bus.i2c.sda = (gpio_num_t)PIN_OLED_SDA;
-    u8g2_esp32_hal.bus.i2c.scl = (gpio_num_t)PIN_OLED_SCL;
+    u8g2_esp32_hal.bus.i2c.sda = (gpio_num_t)Board::pin_oled_sda;
+    u8g2_esp32_hal.bus.i2c.scl = (gpio_num_t)Board::pin_oled_scl;
     u8g2_esp32_hal_init(u8g2_esp32_hal);
 
     // 2. Choose the appropriate setup function for the display
@@ -201,12 +341,14 @@ void uiTask(void *pvParameters) {
 
     // Performance monitoring variables
     uint32_t frame_count = 0;
+    uint32_t last_logged_frame_count = 0;
     uint64_t last_frame_time = esp_timer_get_time();
     bool force_redraw = true; // Force initial draw
 
     // Main UI loop with optimized timing and responsiveness
     for (;;) {
         uint64_t frame_start_time = esp_timer_get_time();
+        bool frame_drawn = false;
 
         // Phase 1: High-priority input processing and critical updates
         uint64_t input_start = esp_timer_get_time();
@@ -226,30 +368,59 @@ void uiTask(void *pvParameters) {
 
         incoming_message_t incoming_msg;
         if (xQueueReceive(incoming_message_queue, &incoming_msg, (TickType_t)0) == pdPASS) {
-            message_history.push_back(incoming_msg);
-            if (message_history.size() > 4) {
-                message_history.erase(message_history.begin());
+            history_service_append(incoming_msg.sender_callsign.c_str(), HISTORY_DIRECTION_RX,
+                                   incoming_msg.message_text.c_str());
+            if (current_ui_state == UI_STATE_CHAT && incoming_msg.sender_callsign == selected_contact_callsign) {
+                chat_skip = 0;
+                load_chat_page();
+                force_redraw = true; // New message requires redraw
             }
-            force_redraw = true; // New message requires redraw
         }
 
         // Process button inputs with high priority
         buttons_read();
+        for (int button = 0; button < NUM_BUTTONS; button++) {
+            if (is_button_just_pressed((button_id_t)button)) {
+                power_service_pulse(POWER_ACTIVITY_USER);
+                break;
+            }
+        }
 
-        // Critical buttons (PTT) get immediate processing
+        // Critical buttons (PTT) get immediate processing. Floor control
+        // keys the transmitter once the floor is ours; without it (radio
+        // not up yet) PTT keys it directly.
         if (is_button_just_pressed(BUTTON_PTT)) {
-            ESP_LOGI(TAG, "PTT Pressed - Start TX");
-            audio_command_t cmd = AUDIO_CMD_START_TX;
-            xQueueSend(audio_command_queue, &cmd, portMAX_DELAY); // Blocking send for critical commands
+            ptt_via_floor = floor_service_ptt(true);
+            if (ptt_via_floor) {
+                ESP_LOGI(TAG, "PTT Pressed - Request floor");
+            } else {
+                ESP_LOGI(TAG, "PTT Pressed - Start TX");
+                audio_command_t cmd = AUDIO_CMD_START_TX;
+                xQueueSend(audio_command_queue, &cmd, portMAX_DELAY); // Blocking send for critical commands
+            }
             taskYIELD(); // Yield immediately after critical command
         }
         if (is_button_just_released(BUTTON_PTT)) {
-            ESP_LOGI(TAG, "PTT Released - Stop TX");
-            audio_command_t cmd = AUDIO_CMD_STOP_TX;
-            xQueueSend(audio_command_queue, &cmd, portMAX_DELAY); // Blocking send for critical commands
+            if (ptt_via_floor) {
+                ESP_LOGI(TAG, "PTT Released - Release floor");
+                floor_service_ptt(false);
+            } else {
+                ESP_LOGI(TAG, "PTT Released - Stop TX");
+                audio_command_t cmd = AUDIO_CMD_STOP_TX;
+                xQueueSend(audio_command_queue, &cmd, portMAX_DELAY); // Blocking send for critical commands
+            }
             taskYIELD(); // Yield immediately after critical command
         }
 
+        floor_status_t new_floor_status;
+        if (floor_service_get_status(&new_floor_status) &&
+            (new_floor_status.state != floor_status.state ||
+             new_floor_status.queue_position != floor_status.queue_position ||
+             strcmp(new_floor_status.talker, floor_status.talker) != 0)) {
+            floor_status = new_floor_status;
+            force_redraw = true; // Talker busy and queue changes show at once
+        }
+
         // Process other button inputs
         bool input_processed = false;
         if (is_button_just_pressed(BUTTON_UP) || is_button_just_pressed(BUTTON_DOWN) ||
@@ -266,13 +437,36 @@ void uiTask(void *pvParameters) {
                         current_ui_state = UI_STATE_BLUETOOTH;
                         input_processed = true;
                     }
+                    if (is_button_just_pressed(BUTTON_DOWN)) {
+                        current_ui_state = UI_STATE_TALKGROUP;
+                        input_processed = true;
+                    }
+                    if (is_button_just_pressed(BUTTON_BACK)) {
+                        back_armed = true; // Tap or hold is decided below
+                    }
+                    break;
+
+                case UI_STATE_REPLAY:
                     if (is_button_just_pressed(BUTTON_BACK)) {
-                        HaLowMeshManager& meshManager = HaLowMeshManager::getInstance();
-                        bool currentStatus = meshManager.get_connection_status();
-                        meshManager.setConnectionStatus(!currentStatus);
-                        if (!currentStatus) {
-                            meshManager.sendCachedMessages();
+                        current_ui_state = UI_STATE_MAIN;
+                        input_processed = true;
+                    }
+                    if (is_button_just_pressed(BUTTON_UP)) {
+                        if (selected_replay > 0) selected_replay--;
+                        input_processed = true;
+                    }
+                    if (is_button_just_pressed(BUTTON_DOWN)) {
+                        if ((size_t)selected_replay + 1 < replay_count) selected_replay++;
+                        input_processed = true;
+                    }
+                    if (is_button_just_pressed(BUTTON_SELECT) && (size_t)selected_replay < replay_count) {
+                        uint32_t id = replay_list[selected_replay].id;
+                        if (id == replaying_id) {
+                            recorder_service_stop_replay();
+                        } else {
+                            recorder_service_replay(id);
                         }
+                        replaying_id = recorder_service_replaying();
                         input_processed = true;
                     }
                     break;
@@ -300,7 +494,11 @@ void uiTask(void *pvParameters) {
                     }
                     if (is_button_just_pressed(BUTTON_SELECT)) {
                         if (selected_bt_menu_index == 0) {
-                            bt_audio_start_discovery();
+                            if (boot_ensure(BOOT_STAGE_BLUETOOTH, UI_BT_START_TIMEOUT_MS) == 0) {
+                                bt_audio_start_discovery();
+                            } else {
+                                ESP_LOGW(TAG, "Bluetooth did not start");
+                            }
                         } else {
                             const auto& devices = bt_audio_get_discovered_devices();
                             int device_index = selected_bt_menu_index - 1;
@@ -312,6 +510,34 @@ void uiTask(void *pvParameters) {
                     }
                     break;
 
+                case UI_STATE_TALKGROUP:
+                    if (is_button_just_pressed(BUTTON_BACK)) {
+                        current_ui_state = UI_STATE_MAIN;
+                        input_processed = true;
+                    }
+                    if (is_button_just_pressed(BUTTON_UP)) {
+                        if (selected_talkgroup > 0) selected_talkgroup--;
+                        input_processed = true;
+                    }
+                    if (is_button_just_pressed(BUTTON_DOWN)) {
+                        if (selected_talkgroup < TALKGROUP_UI_GROUPS - 1) selected_talkgroup++;
+                        input_processed = true;
+                    }
+                    if (is_button_just_pressed(BUTTON_SELECT)) {
+                        // Off -> RX -> TX -> off; after TX the node talks on all-call again
+                        uint8_t group = (uint8_t)selected_talkgroup;
+                        if (group == talkgroup_get_tx()) {
+                            talkgroup_set_tx(TALKGROUP_ALL);
+                            if (group != TALKGROUP_ALL) talkgroup_leave(group);
+                        } else if (talkgroup_is_member(group)) {
+                            talkgroup_set_tx(group);
+                        } else {
+                            talkgroup_join(group);
+                        }
+                        input_processed = true;
+                    }
+                    break;
+
                 case UI_STATE_CONTACTS:
                     if (is_button_just_pressed(BUTTON_BACK)) {
                         current_ui_state = UI_STATE_MAIN;
@@ -333,6 +559,8 @@ void uiTask(void *pvParameters) {
                             if (!g_contact_list.empty() && (size_t)selected_contact_index < g_contact_list.size()) {
                                 selected_contact_callsign = g_contact_list[selected_contact_index].callsign;
                                 current_ui_state = UI_STATE_CHAT;
+                                chat_skip = 0;
+                                load_chat_page();
                             }
                             xSemaphoreGive(g_contact_list_mutex);
                         }
@@ -350,7 +578,14 @@ void uiTask(void *pvParameters) {
                         }
                         input_processed = true;
                     }
-                    if (is_button_just_pressed(BUTTON_UP)) {
+                    // With nothing typed, up and down scroll the conversation
+                    if (current_message.empty() && is_button_just_pressed(BUTTON_UP)) {
+                        if (chat_skip + UI_CHAT_ROWS < history_service_count(selected_contact_callsign.c_str())) {
+                            chat_skip++;
+                            load_chat_page();
+                        }
+                        input_processed = true;
+                    } else if (is_button_just_pressed(BUTTON_UP)) {
                         current_char_index++;
                         if (current_char_index >= sizeof(charset) - 1) current_char_index = 0;
                         if (text_entry_cursor_pos < current_message.length()) {
@@ -358,7 +593,13 @@ void uiTask(void *pvParameters) {
                         }
                         input_processed = true;
                     }
-                    if (is_button_just_pressed(BUTTON_DOWN)) {
+                    if (current_message.empty() && is_button_just_pressed(BUTTON_DOWN)) {
+                        if (chat_skip > 0) {
+                            chat_skip--;
+                            load_chat_page();
+                        }
+                        input_processed = true;
+                    } else if (is_button_just_pressed(BUTTON_DOWN)) {
                         current_char_index--;
                         if (current_char_index < 0) current_char_index = sizeof(charset) - 2;
                         if (text_entry_cursor_pos < current_message.length()) {
@@ -390,14 +631,19 @@ void uiTask(void *pvParameters) {
                             free(buffer);
 
                             outgoing_message_t out_msg;
+                            bool queued = false;
                             if (xSemaphoreTake(g_contact_list_mutex, (TickType_t)10) == pdTRUE) {
                                 if (!g_contact_list.empty() && (size_t)selected_contact_index < g_contact_list.size()) {
                                     strncpy(out_msg.target_ip, g_contact_list[selected_contact_index].ipAddress.c_str(), sizeof(out_msg.target_ip) - 1);
                                     out_msg.encrypted_payload = encrypted_payload;
-                                    xQueueSend(outgoing_message_queue, &out_msg, (TickType_t)0);
+                                    queued = xQueueSend(outgoing_message_queue, &out_msg, (TickType_t)0) == pdPASS;
                                 }
                                 xSemaphoreGive(g_contact_list_mutex);
                             }
+                            if (queued) {
+                                history_service_append(selected_contact_callsign.c_str(), HISTORY_DIRECTION_TX,
+                                                       current_message.c_str());
+                            }
 
                             current_message = "";
                             text_entry_cursor_pos = 0;
@@ -409,6 +655,44 @@ void uiTask(void *pvParameters) {
             }
         }
 
+        // BACK on the main screen: a tap opens the replay list, a hold
+        // toggles the online status
+        if (back_armed) {
+            if (!back_held && is_button_long_pressed(BUTTON_BACK)) {
+                back_held = true;
+                HaLowMeshManager& meshManager = HaLowMeshManager::getInstance();
+                bool currentStatus = meshManager.get_connection_status();
+                meshManager.setConnectionStatus(!currentStatus);
+                if (!currentStatus) {
+                    meshManager.sendCachedMessages();
+                }
+                input_processed = true;
+            }
+            if (is_button_just_released(BUTTON_BACK)) {
+                if (!back_held && current_ui_state == UI_STATE_MAIN) {
+                    replay_count = recorder_service_list(replay_list, UI_REPLAY_ENTRIES);
+                    replaying_id = recorder_service_replaying();
+                    selected_replay = 0;
+                    current_ui_state = UI_STATE_REPLAY;
+                }
+                back_armed = false;
+                back_held = false;
+                input_processed = true;
+            }
+        }
+
+        // The replay marker goes when the replay ends
+        static uint64_t last_replay_poll = 0;
+        if (current_ui_state == UI_STATE_REPLAY &&
+            esp_timer_get_time() - last_replay_poll > UI_REPLAY_POLL_MS * 1000ULL) {
+            last_replay_poll = esp_timer_get_time();
+            uint32_t id = recorder_service_replaying();
+            if (id != replaying_id) {
+                replaying_id = id;
+                force_redraw = true;
+            }
+        }
+
         uint64_t input_time = esp_timer_get_time() - input_start;
         if (input_time > (UI_INPUT_PROCESSING_MS * 1000)) {
             ESP_LOGD(TAG, "Input processing took %llu us", input_time);
@@ -437,6 +721,12 @@ void uiTask(void *pvParameters) {
                     case UI_STATE_BLUETOOTH:
                         drawBluetoothScreen();
                         break;
+                    case UI_STATE_TALKGROUP:
+                        drawTalkgroupScreen();
+                        break;
+                    case UI_STATE_REPLAY:
+                        drawReplayScreen();
+                        break;
                 }
             } while (u8g2_NextPage(&u8g2));
 
@@ -446,12 +736,23 @@ void uiTask(void *pvParameters) {
             }
 
             force_redraw = false;
+            frame_drawn = true;
             frame_count++;
+            metrics_counter_inc(METRIC_UI_FRAMES);
         }
 
         // Phase 3: Frame timing and system responsiveness
         uint64_t frame_time = esp_timer_get_time() - frame_start_time;
-        uint64_t target_frame_time = UI_FRAME_INTERVAL_MS * 1000;
+        power_service_set_active(POWER_ACTIVITY_NAVIGATE, current_ui_state == UI_STATE_MAP);
+        uint32_t frame_interval_ms = power_service_poll_ms(POWER_WAKE_UI, UI_FRAME_INTERVAL_MS);
+        uint32_t battery_frame_ms = battery_service_policy().ui_frame_ms;
+        if (battery_frame_ms > frame_interval_ms) {
+            frame_interval_ms = battery_frame_ms;
+        }
+        uint64_t target_frame_time = (uint64_t)frame_interval_ms * 1000;
+        if (frame_drawn) {
+            metrics_histogram_record(METRIC_UI_FRAME_TIME_US, (uint32_t)frame_time);
+        }
 
         if (frame_time < target_frame_time) {
             uint32_t sleep_ticks = pdMS_TO_TICKS((target_frame_time - frame_time) / 1000);
@@ -460,6 +761,7 @@ void uiTask(void *pvParameters) {
             }
         } else {
             // Frame took too long, yield to other tasks
+            metrics_counter_inc(METRIC_UI_FRAME_OVERRUNS);
             ESP_LOGD(TAG, "UI frame overrun: %llu us", frame_time);
             taskYIELD();
         }
@@ -469,13 +771,18 @@ void uiTask(void *pvParameters) {
             taskYIELD();
         }
 
-        // Performance monitoring
-        if (frame_count % 100 == 0) {
+        // Performance monitoring, every 100 drawn frames
+        if (frame_count - last_logged_frame_count >= 100) {
             uint64_t now = esp_timer_get_time();
             uint64_t elapsed = now - last_frame_time;
-            float fps = 100.0f / (elapsed / 1000000.0f);
-            ESP_LOGI(TAG, "UI Performance: %.1f fps, avg frame time: %llu us", fps, elapsed / 100);
+            float fps = (frame_count - last_logged_frame_count) / (elapsed / 1000000.0f);
+            metrics_histogram_summary_t frame_stats;
+            metrics_histogram_get(METRIC_UI_FRAME_TIME_US, &frame_stats);
+            ESP_LOGI(TAG, "UI Performance: %.1f fps, frame time mean %u us, p99 %u us, max %u us, %u overruns",
+                     fps, (unsigned)frame_stats.mean, (unsigned)frame_stats.p99, (unsigned)frame_stats.max,
+                     (unsigned)metrics_counter_get(METRIC_UI_FRAME_OVERRUNS));
             last_frame_time = now;
+            last_logged_frame_count = frame_count;
         }
     }
 }
@@ -0,0 +1,417 @@
+/**
+ * @file voice_recorder.cpp
+ * @brief Rolling recording of received and sent voice for instant replay
+ *
+ * Block layout, little endian:
+ *   magic u32, crc u32 (over everything after it up to the end of the
+ *   records), sequence u32, open transmission u32, record bytes u16,
+ *   reserved u16, records, zero padding.
+ * Records:
+ *   START: type, id u32, direction, group, epoch u32, talker length, talker
+ *   FRAME: type, length u16, offset ms u32, frame
+ *
+ * @author AirCom Development Team
+ * @version 1.0.0
+ * @date 2024
+ */
+
+#include "include/voice_recorder.h"
+#include "include/ota_mesh.h"
+#include <string.h>
+#include <algorithm>
+
+#define RECORDER_MAGIC 0x42525641u          // "AVRB"
+#define RECORDER_RECORD_START 1
+#define RECORDER_RECORD_FRAME 2
+#define RECORDER_START_SIZE 12              // Without the talker
+#define RECORDER_FRAME_SIZE 7               // Without the frame
+
+voice_recorder_config_t voice_recorder_default_config(void) {
+    voice_recorder_config_t config;
+    config.gap_ms = 1000;
+    config.idle_flush_ms = 5000;
+    return config;
+}
+
+static void put_u16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint16_t get_u16(const uint8_t* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+VoiceRecorder::VoiceRecorder(IVoiceStorage* storage, const voice_recorder_config_t& config)
+    : m_storage(storage), m_config(config), m_blockCount(storage->blockCount()),
+      m_block(VOICE_RECORDER_BLOCK_SIZE, 0), m_replayBlock(VOICE_RECORDER_BLOCK_SIZE, 0) {
+}
+
+// ============================================================================
+// BLOCKS
+// ============================================================================
+
+bool VoiceRecorder::parseBlock(const uint8_t* block, uint32_t* seq, uint32_t* openId, uint16_t* used) {
+    if (get_u32(block) != RECORDER_MAGIC) {
+        return false;
+    }
+    uint16_t length = get_u16(block + 16);
+    if (length > VOICE_RECORDER_BLOCK_SIZE - VOICE_RECORDER_BLOCK_HEADER_SIZE ||
+        get_u32(block + 4) != ota_crc32(block + 8, VOICE_RECORDER_BLOCK_HEADER_SIZE - 8 + length)) {
+        return false;                       // Torn write
+    }
+    *seq = get_u32(block + 8);
+    *openId = get_u32(block + 12);
+    *used = length;
+    return *seq != 0;
+}
+
+size_t VoiceRecorder::parseRecord(const uint8_t* records, uint16_t used, uint16_t offset, Record* record) {
+    if (offset >= used) {
+        return 0;
+    }
+    const uint8_t* in = records + offset;
+    size_t left = used - offset;
+    record->type = in[0];
+    if (record->type == RECORDER_RECORD_START) {
+        if (left < RECORDER_START_SIZE || left < (size_t)RECORDER_START_SIZE + in[11]) {
+            return 0;
+        }
+        record->id = get_u32(in + 1);
+        record->direction = in[5];
+        record->group = in[6];
+        record->epochS = get_u32(in + 7);
+        record->talker.assign((const char*)in + RECORDER_START_SIZE, in[11]);
+        return RECORDER_START_SIZE + in[11];
+    }
+    if (record->type == RECORDER_RECORD_FRAME) {
+        if (left < RECORDER_FRAME_SIZE || left < (size_t)RECORDER_FRAME_SIZE + get_u16(in + 1)) {
+            return 0;
+        }
+        record->length = get_u16(in + 1);
+        record->offsetMs = get_u32(in + 3);
+        record->data = in + RECORDER_FRAME_SIZE;
+        return RECORDER_FRAME_SIZE + record->length;
+    }
+    return 0;
+}
+
+bool VoiceRecorder::room(size_t length) const {
+    return VOICE_RECORDER_BLOCK_HEADER_SIZE + m_used + length <= VOICE_RECORDER_BLOCK_SIZE;
+}
+
+bool VoiceRecorder::writeBlock() {
+    uint8_t* block = m_block.data();
+    memset(block + VOICE_RECORDER_BLOCK_HEADER_SIZE + m_used, 0,
+           VOICE_RECORDER_BLOCK_SIZE - VOICE_RECORDER_BLOCK_HEADER_SIZE - m_used);
+    put_u32(block, RECORDER_MAGIC);
+    put_u32(block + 8, m_seq);
+    put_u32(block + 12, m_openId);
+    put_u16(block + 16, m_used);
+    put_u16(block + 18, 0);
+    put_u32(block + 4, ota_crc32(block + 8, VOICE_RECORDER_BLOCK_HEADER_SIZE - 8 + m_used));
+
+    bool ok = m_storage->writeBlock(m_seq % m_blockCount, block);
+    if (ok) {
+        m_stats.blocks_written++;
+        m_stats.flash_bytes += VOICE_RECORDER_BLOCK_SIZE;
+    } else {
+        m_stats.write_errors++;             // The block is lost; recording goes on
+    }
+
+    // Writing sequence n overwrote n - blockCount
+    if (m_seq > m_blockCount) {
+        uint32_t oldest = m_seq - (uint32_t)m_blockCount + 1;
+        evictBefore(oldest);
+        if (m_replayId && m_replaySeq < oldest) {
+            stopReplay();
+        }
+    }
+    m_seq++;
+    m_used = 0;
+    m_openId = m_currentId;
+    return ok;
+}
+
+void VoiceRecorder::evictBefore(uint32_t seq) {
+    while (!m_index.empty() && m_index.front().firstSeq < seq) {
+        if (m_index.front().info.id == m_currentId) {
+            m_currentId = 0;                // Longer than the ring: the rest starts anew
+        }
+        m_index.pop_front();
+        m_stats.evicted++;
+    }
+}
+
+VoiceRecorder::Entry* VoiceRecorder::find(uint32_t id) {
+    // The one asked for is nearly always the newest
+    for (auto it = m_index.rbegin(); it != m_index.rend(); ++it) {
+        if (it->info.id == id) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+VoiceRecorder::Entry* VoiceRecorder::startTransmission(uint8_t direction, uint8_t group, const std::string& talker,
+                                                        uint32_t nowMs, uint32_t epochS) {
+    if (m_index.size() >= VOICE_RECORDER_MAX_INDEX) {
+        m_index.pop_front();
+        m_stats.evicted++;
+    }
+    Entry entry = {};
+    entry.info.id = m_nextId++;
+    entry.info.direction = direction;
+    entry.info.group = group;
+    entry.info.epoch_s = epochS;
+    size_t talkerLength = std::min(talker.size(), (size_t)VOICE_RECORDER_TALKER_LEN - 1);
+    memcpy(entry.info.talker, talker.data(), talkerLength);
+    entry.firstSeq = m_seq;
+    entry.firstOffset = m_used;
+    entry.startMs = nowMs;
+    m_index.push_back(entry);
+    m_currentId = entry.info.id;
+    m_stats.transmissions++;
+
+    uint8_t* out = m_block.data() + VOICE_RECORDER_BLOCK_HEADER_SIZE + m_used;
+    out[0] = RECORDER_RECORD_START;
+    put_u32(out + 1, entry.info.id);
+    out[5] = direction;
+    out[6] = group;
+    put_u32(out + 7, epochS);
+    out[11] = (uint8_t)talkerLength;
+    memcpy(out + RECORDER_START_SIZE, talker.data(), talkerLength);
+    m_used += RECORDER_START_SIZE + talkerLength;
+    return &m_index.back();
+}
+
+bool VoiceRecorder::addFrame(uint8_t direction, uint8_t group, const std::string& talker, uint32_t nowMs,
+                             uint32_t epochS, const uint8_t* data, size_t length) {
+    if (length == 0 || length > VOICE_RECORDER_MAX_FRAME) {
+        m_stats.rejected++;
+        return false;
+    }
+    bool ok = true;
+    size_t frameSize = RECORDER_FRAME_SIZE + length;
+    Entry* current = m_currentId ? find(m_currentId) : nullptr;
+    if (current && (current->info.direction != direction || current->info.group != group ||
+                    nowMs - m_lastFrameMs > m_config.gap_ms ||
+                    strncmp(current->info.talker, talker.c_str(), VOICE_RECORDER_TALKER_LEN - 1) != 0)) {
+        current = nullptr;
+        m_currentId = 0;
+    }
+    if (current && !room(frameSize)) {
+        ok = writeBlock();
+        current = m_currentId ? find(m_currentId) : nullptr;
+    }
+    if (!current) {
+        size_t startSize = RECORDER_START_SIZE + std::min(talker.size(), (size_t)VOICE_RECORDER_TALKER_LEN - 1);
+        if (!room(startSize + frameSize)) {
+            ok = writeBlock() && ok;
+        }
+        current = startTransmission(direction, group, talker, nowMs, epochS);
+    }
+
+    uint32_t offsetMs = nowMs - current->startMs;
+    uint8_t* out = m_block.data() + VOICE_RECORDER_BLOCK_HEADER_SIZE + m_used;
+    out[0] = RECORDER_RECORD_FRAME;
+    put_u16(out + 1, (uint16_t)length);
+    put_u32(out + 3, offsetMs);
+    memcpy(out + RECORDER_FRAME_SIZE, data, length);
+    m_used += frameSize;
+
+    current->info.duration_ms = offsetMs;
+    current->info.frames++;
+    current->info.bytes += length;
+    m_stats.frames++;
+    m_stats.voice_bytes += length;
+    m_lastFrameMs = nowMs;
+    return ok;
+}
+
+void VoiceRecorder::tick(uint32_t nowMs) {
+    if (m_used && nowMs - m_lastFrameMs >= m_config.idle_flush_ms) {
+        flush();
+    }
+}
+
+bool VoiceRecorder::flush() {
+    if (!m_used) {
+        return true;
+    }
+    m_stats.padded_flushes++;
+    return writeBlock();
+}
+
+// ============================================================================
+// INDEX
+// ============================================================================
+
+size_t VoiceRecorder::load() {
+    m_index.clear();
+    m_currentId = 0;
+    m_used = 0;
+    m_openId = 0;
+    m_replayId = 0;
+
+    std::vector<uint32_t> seqs;
+    uint8_t* block = m_replayBlock.data();
+    for (size_t i = 0; i < m_blockCount; i++) {
+        uint32_t seq, openId;
+        uint16_t used;
+        if (m_storage->readBlock(i, block) && parseBlock(block, &seq, &openId, &used) && seq % m_blockCount == i) {
+            seqs.push_back(seq);
+        }
+    }
+    std::sort(seqs.begin(), seqs.end());
+
+    for (uint32_t seq : seqs) {
+        uint32_t openId;
+        uint16_t used;
+        if (!m_storage->readBlock(seq % m_blockCount, block) || !parseBlock(block, &seq, &openId, &used)) {
+            continue;
+        }
+        const uint8_t* records = block + VOICE_RECORDER_BLOCK_HEADER_SIZE;
+        Entry* current = openId ? find(openId) : nullptr;
+        Record record;
+        uint16_t offset = 0;
+        while (size_t length = parseRecord(records, used, offset, &record)) {
+            if (record.type == RECORDER_RECORD_START) {
+                if (m_index.size() >= VOICE_RECORDER_MAX_INDEX) {
+                    m_index.pop_front();
+                }
+                Entry entry = {};
+                entry.info.id = record.id;
+                entry.info.direction = record.direction;
+                entry.info.group = record.group;
+                entry.info.epoch_s = record.epochS;
+                memcpy(entry.info.talker, record.talker.data(),
+                       std::min(record.talker.size(), (size_t)VOICE_RECORDER_TALKER_LEN - 1));
+                entry.firstSeq = seq;
+                entry.firstOffset = offset;
+                m_index.push_back(entry);
+                current = &m_index.back();
+                m_nextId = std::max(m_nextId, record.id + 1);
+            } else if (current) {
+                current->info.duration_ms = record.offsetMs;
+                current->info.frames++;
+                current->info.bytes += record.length;
+            }
+            offset += length;
+        }
+    }
+    if (!seqs.empty()) {
+        m_seq = seqs.back() + 1;
+    }
+    m_replayLoadedSeq = 0;
+    return m_index.size();
+}
+
+size_t VoiceRecorder::recent(voice_transmission_t* out, size_t max) const {
+    size_t count = 0;
+    for (auto it = m_index.rbegin(); it != m_index.rend() && count < max; ++it) {
+        out[count++] = it->info;
+    }
+    return count;
+}
+
+// ============================================================================
+// REPLAY
+// ============================================================================
+
+bool VoiceRecorder::startReplay(uint32_t id) {
+    Entry* entry = find(id);
+    if (!entry) {
+        return false;
+    }
+    m_replayId = id;
+    m_replaySeq = entry->firstSeq;
+    m_replayOffset = entry->firstOffset;
+    m_replayNewBlock = false;
+    m_stats.replays++;
+    return true;
+}
+
+bool VoiceRecorder::loadReplayBlock(uint32_t seq) {
+    if (m_replayLoadedSeq == seq) {
+        return true;
+    }
+    uint32_t found, openId;
+    uint16_t used;
+    if (!m_storage->readBlock(seq % m_blockCount, m_replayBlock.data()) ||
+        !parseBlock(m_replayBlock.data(), &found, &openId, &used) || found != seq) {
+        m_replayLoadedSeq = 0;
+        return false;                       // Lost to a write error or overwritten
+    }
+    m_replayLoadedSeq = seq;
+    return true;
+}
+
+size_t VoiceRecorder::nextReplayFrame(uint8_t* out, size_t capacity, uint32_t* offsetMs) {
+    while (m_replayId) {
+        const uint8_t* records;
+        uint16_t used;
+        uint32_t openId;
+        if (m_replaySeq == m_seq) {
+            // Not written yet: the block being filled
+            records = m_block.data() + VOICE_RECORDER_BLOCK_HEADER_SIZE;
+            used = m_used;
+            openId = m_openId;
+        } else if (m_replaySeq < m_seq && loadReplayBlock(m_replaySeq)) {
+            uint32_t seq;
+            parseBlock(m_replayBlock.data(), &seq, &openId, &used);
+            records = m_replayBlock.data() + VOICE_RECORDER_BLOCK_HEADER_SIZE;
+        } else {
+            break;
+        }
+
+        if (m_replayNewBlock) {
+            m_replayNewBlock = false;
+            if (openId != m_replayId) {
+                break;                      // It ended with the previous block
+            }
+        }
+        Record record;
+        size_t length = parseRecord(records, used, m_replayOffset, &record);
+        if (!length) {
+            if (m_replaySeq == m_seq) {
+                break;                      // Caught up with the recording
+            }
+            m_replaySeq++;
+            m_replayOffset = 0;
+            m_replayNewBlock = true;
+            continue;
+        }
+        m_replayOffset += length;
+        if (record.type == RECORDER_RECORD_START) {
+            if (record.id != m_replayId) {
+                break;                      // The next transmission
+            }
+            continue;
+        }
+        if (record.length > capacity) {
+            continue;
+        }
+        memcpy(out, record.data, record.length);
+        if (offsetMs) {
+            *offsetMs = record.offsetMs;
+        }
+        return record.length;
+    }
+    stopReplay();
+    return 0;
+}
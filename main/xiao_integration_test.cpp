@@ -16,9 +16,14 @@
 #include "mm_iot_sdk.h"
 #include "HaLowMeshManager.h"
 #include "include/config.h"
+#include "include/dsp_kernels.h"
 #include "driver/spi_common.h"
+#include "esp_cpu.h"
+#include <string.h>
+#include <new>
 
 static const char* XIAO_TEST_TAG = "XIAO_INTEGRATION_TEST";
+static volatile int64_t bench_sink_dot;    // Keeps the timed dot product
 
 /**
  * @brief Test XIAO ESP32 board configuration
@@ -27,22 +32,22 @@ bool test_xiao_board_config(void) {
     ESP_LOGI(XIAO_TEST_TAG, "Testing XIAO ESP32 board configuration...");
 
     // Test board type detection
-    ESP_LOGI(XIAO_TEST_TAG, "Board type: %s (ID: %d)", XIAO_BOARD_TYPE, XIAO_BOARD_TYPE_ID);
+    ESP_LOGI(XIAO_TEST_TAG, "Board type: %s (%s)", Board::name, Board::soc_name);
 
     // Test pin configuration
     ESP_LOGI(XIAO_TEST_TAG, "SPI Configuration:");
-    ESP_LOGI(XIAO_TEST_TAG, "  - MOSI: %d", get_spi_mosi_pin());
-    ESP_LOGI(XIAO_TEST_TAG, "  - MISO: %d", get_spi_miso_pin());
-    ESP_LOGI(XIAO_TEST_TAG, "  - SCLK: %d", get_spi_sclk_pin());
-    ESP_LOGI(XIAO_TEST_TAG, "  - CS: %d", get_spi_cs_pin());
-    ESP_LOGI(XIAO_TEST_TAG, "  - RESET: %d", get_spi_reset_pin());
-    ESP_LOGI(XIAO_TEST_TAG, "  - INT: %d", get_spi_int_pin());
+    ESP_LOGI(XIAO_TEST_TAG, "  - MOSI: %d", Board::pin_halow_mosi);
+    ESP_LOGI(XIAO_TEST_TAG, "  - MISO: %d", Board::pin_halow_miso);
+    ESP_LOGI(XIAO_TEST_TAG, "  - SCLK: %d", Board::pin_halow_sclk);
+    ESP_LOGI(XIAO_TEST_TAG, "  - CS: %d", Board::pin_halow_cs);
+    ESP_LOGI(XIAO_TEST_TAG, "  - RESET: %d", Board::pin_halow_reset);
+    ESP_LOGI(XIAO_TEST_TAG, "  - INT: %d", Board::pin_halow_int);
 
     // Test other peripherals
     ESP_LOGI(XIAO_TEST_TAG, "Other Peripherals:");
-    ESP_LOGI(XIAO_TEST_TAG, "  - LED: %d", get_led_pin());
-    ESP_LOGI(XIAO_TEST_TAG, "  - Button: %d", get_button_pin());
-    ESP_LOGI(XIAO_TEST_TAG, "  - Battery ADC: %d", get_battery_adc_pin());
+    ESP_LOGI(XIAO_TEST_TAG, "  - LED: %d", Board::pin_led);
+    ESP_LOGI(XIAO_TEST_TAG, "  - Button: %d", Board::pin_button_select);
+    ESP_LOGI(XIAO_TEST_TAG, "  - Battery ADC: %d", Board::pin_battery_adc);
 
     ESP_LOGI(XIAO_TEST_TAG, "XIAO ESP32 board configuration test passed");
     return true;
@@ -113,11 +118,10 @@ bool test_spi_configuration(void) {
     ESP_LOGI(XIAO_TEST_TAG, "Testing SPI configuration for FGH100M-H module...");
 
     // Check SPI configuration constants
-    ESP_LOGI(XIAO_TEST_TAG, "SPI Host: %d", FGH100M_SPI_HOST);
+    ESP_LOGI(XIAO_TEST_TAG, "SPI Host: %d", Board::halow_spi_host);
     ESP_LOGI(XIAO_TEST_TAG, "SPI Clock Speed: %d Hz", FGH100M_SPI_CLOCK_SPEED);
     ESP_LOGI(XIAO_TEST_TAG, "SPI Mode: %d", FGH100M_SPI_MODE);
-    ESP_LOGI(XIAO_TEST_TAG, "Max TX Buffer: %d bytes", FGH100M_MAX_TX_BUFFER);
-    ESP_LOGI(XIAO_TEST_TAG, "Max RX Buffer: %d bytes", FGH100M_MAX_RX_BUFFER);
+    ESP_LOGI(XIAO_TEST_TAG, "DMA Buffers: %d bytes", (int)Board::halow_spi_buffer);
 
     // Check timing constants
     ESP_LOGI(XIAO_TEST_TAG, "Reset Delay: %d ms", FGH100M_RESET_DELAY);
@@ -126,8 +130,8 @@ bool test_spi_configuration(void) {
     ESP_LOGI(XIAO_TEST_TAG, "Command Timeout: %d ms", FGH100M_COMMAND_TIMEOUT);
 
     // Verify SPI pins are properly configured
-    if (get_spi_mosi_pin() < 0 || get_spi_miso_pin() < 0 ||
-        get_spi_sclk_pin() < 0 || get_spi_cs_pin() < 0) {
+    if (Board::pin_halow_mosi < 0 || Board::pin_halow_miso < 0 ||
+        Board::pin_halow_sclk < 0 || Board::pin_halow_cs < 0) {
         ESP_LOGE(XIAO_TEST_TAG, "SPI pins not properly configured");
         return false;
     }
@@ -136,6 +140,94 @@ bool test_spi_configuration(void) {
     return true;
 }
 
+/**
+ * @brief DSP kernels: every implementation on this SoC against the reference, and cycles per sample
+ *
+ * host/dsp/dsp_bench covers the edge cases on the host; this runs the
+ * target's own sets (PIE on the S3) on a 20 ms frame.
+ */
+bool test_dsp_kernels(void) {
+    ESP_LOGI(XIAO_TEST_TAG, "Testing DSP kernels (%s)...", dsp_kernels_impl());
+
+    const size_t n = 320;
+    const size_t taps = 32;
+    int16_t* buffers = new (std::nothrow) int16_t[5 * n + 8];
+    if (!buffers) {
+        ESP_LOGE(XIAO_TEST_TAG, "No memory for the DSP test");
+        return false;
+    }
+    int16_t* a = (int16_t*)(((uintptr_t)buffers + 15) & ~(uintptr_t)15);
+    int16_t* b = a + n;
+    int16_t* want = b + n;
+    int16_t* out = want + n;
+    int16_t coeffs[taps];
+    uint32_t seed = 1;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1664525 + 1013904223;
+        a[i] = (int16_t)(seed >> 16);
+        b[i] = i & 1 ? INT16_MIN : (int16_t)(seed >> 8);       // Saturates and wraps pair sums
+    }
+    for (size_t i = 0; i < taps; i++) {
+        coeffs[i] = (int16_t)(a[i] / 4);
+    }
+
+    const dsp_kernel_set_t* sets;
+    size_t count = dsp_kernel_sets(&sets);
+    bool passed = true;
+    int64_t dot = sets[0].dot_s16(a, b, n);
+    dsp_fir_s16_t fir;
+    for (size_t s = 0; s < count && passed; s++) {
+        const dsp_kernel_set_t& set = sets[s];
+        passed = set.dot_s16(a, b, n) == dot;
+        passed = passed && set.dot_s16(a + 1, b + 1, n - 1) == sets[0].dot_s16(a + 1, b + 1, n - 1);  // Unaligned
+
+        sets[0].add_sat_s16(a, b, want, n);
+        set.add_sat_s16(a, b, out, n);
+        passed = passed && memcmp(want, out, n * sizeof(int16_t)) == 0;
+
+        sets[0].gain_s16(a, want, n, 3 * DSP_GAIN_UNITY);
+        set.gain_s16(a, out, n, 3 * DSP_GAIN_UNITY);
+        passed = passed && memcmp(want, out, n * sizeof(int16_t)) == 0;
+
+        dsp_fir_s16_t reference;
+        if (!dsp_fir_s16_init(&reference, coeffs, taps, n) || !dsp_fir_s16_init(&fir, coeffs, taps, n)) {
+            ESP_LOGE(XIAO_TEST_TAG, "No memory for the FIR test");
+            dsp_fir_s16_free(&reference);
+            delete[] buffers;
+            return false;
+        }
+        sets[0].fir_s16(&reference, a, want, n);
+        dsp_fir_s16_free(&reference);
+        uint32_t start = esp_cpu_get_cycle_count();
+        set.fir_s16(&fir, a, out, n);
+        uint32_t firCycles = esp_cpu_get_cycle_count() - start;
+        dsp_fir_s16_free(&fir);
+        passed = passed && memcmp(want, out, n * sizeof(int16_t)) == 0;
+
+        start = esp_cpu_get_cycle_count();
+        bench_sink_dot = set.dot_s16(a, b, n);
+        uint32_t dotCycles = esp_cpu_get_cycle_count() - start;
+        start = esp_cpu_get_cycle_count();
+        set.add_sat_s16(a, b, out, n);
+        uint32_t addCycles = esp_cpu_get_cycle_count() - start;
+        start = esp_cpu_get_cycle_count();
+        set.gain_s16(a, out, n, 3 * DSP_GAIN_UNITY);
+        uint32_t gainCycles = esp_cpu_get_cycle_count() - start;
+
+        ESP_LOGI(XIAO_TEST_TAG, "  - %-9s cycles/sample: dot %.2f, fir(%u) %.2f, add %.2f, gain %.2f%s", set.name,
+                 (double)dotCycles / n, (unsigned)taps, (double)firCycles / n, (double)addCycles / n,
+                 (double)gainCycles / n, passed ? "" : " -- differs from the reference");
+    }
+    delete[] buffers;
+
+    if (!passed) {
+        ESP_LOGE(XIAO_TEST_TAG, "DSP kernels are not bit-exact");
+        return false;
+    }
+    ESP_LOGI(XIAO_TEST_TAG, "DSP kernels test passed");
+    return true;
+}
+
 /**
  * @brief Run all integration tests
  */
@@ -164,6 +256,11 @@ bool run_xiao_integration_tests(void) {
         all_tests_passed = false;
     }
 
+    // Test 5: DSP kernels
+    if (!test_dsp_kernels()) {
+        all_tests_passed = false;
+    }
+
     if (all_tests_passed) {
         ESP_LOGI(XIAO_TEST_TAG, "All XIAO ESP32 integration tests passed!");
     } else {